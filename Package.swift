@@ -134,7 +134,6 @@ let package = Package(
                 "src/extensions/advanced_tables.c",
                 "src/extensions/html_markdown.c",
                 "src/extensions/fenced_divs.c",
-                "src/extensions/table_html_postprocess.c",
                 "src/extensions/inline_footnotes.c",
                 "src/extensions/highlight.c",
                 "src/extensions/insert.c",
@@ -145,6 +144,17 @@ let package = Package(
                 "src/extensions/citations.c",
                 "src/extensions/index.c",
                 "src/extensions/syntax_highlight.c",
+                "src/extensions/hashtags.c",
+                "src/extensions/proofreader.c",
+                "src/preprocess.c",
+                "src/html_rewriter.c",
+                "src/feature_scan.c",
+                "src/attr_pool.c",
+                "src/parser_lock.c",
+                "src/chunk_split.c",
+                "src/session.c",
+                "src/render_cache.c",
+                "src/stats.c",
                 "src/pretty_html.c",
                 "src/buffer.c",
                 "src/parser.c",
@@ -18,6 +18,12 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <limits.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 static char *read_file(const char *filename, size_t *len);
 
@@ -90,6 +96,7 @@ typedef struct apex_cli_option_mask {
     bool base_directory;
     bool bibliography;
     bool csl_file;
+    bool bibliography_cache_dir;
     bool suppress_bibliography;
     bool link_citations;
     bool show_tooltips;
@@ -205,6 +212,7 @@ static void apex_cli_restore_argv_options(apex_options *opts,
         opts->csl_file = snap->csl_file;
         opts->enable_citations = snap->enable_citations;
     }
+    if (m->bibliography_cache_dir) opts->bibliography_cache_dir = snap->bibliography_cache_dir;
     if (m->suppress_bibliography) opts->suppress_bibliography = snap->suppress_bibliography;
     if (m->link_citations) opts->link_citations = snap->link_citations;
     if (m->show_tooltips) opts->show_tooltips = snap->show_tooltips;
@@ -436,18 +444,49 @@ static char *apex_cli_find_global_config(void) {
     return out;
 }
 
+/* Git work tree root containing dir, found by walking up to a .git entry;
+ * for directories other than the current one, where git can't be asked */
+static char *apex_cli_git_root_of(const char *dir) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s", dir);
+    size_t len = strlen(path);
+    while (len > 1 && path[len - 1] == '/') path[--len] = '\0';
+    for (;;) {
+        char probe[1100];
+        struct stat st;
+        snprintf(probe, sizeof(probe), "%s/.git", len == 1 && path[0] == '/' ? "" : path);
+        if (stat(probe, &st) == 0) return strdup(path);
+        char *slash = strrchr(path, '/');
+        if (!slash) return NULL;
+        if (slash == path) {
+            if (path[1] == '\0') return NULL;
+            path[1] = '\0';
+            len = 1;
+        } else {
+            *slash = '\0';
+            len = (size_t)(slash - path);
+        }
+    }
+}
+
 /* Determine project-scoped config path:
  *   - CWD/.apex/config.yml
  *   - base_directory/.apex/config.yml (if set)
  *   - <git repo root>/.apex/config.yml (if inside work tree, and different from base_directory)
  * The first existing file in this order wins. Returns malloc'd string or NULL.
+ * work_dir stands in for the CWD when set (a daemon client's directory).
  */
-static char *apex_cli_find_project_config(const apex_options *options) {
+static char *apex_cli_find_project_config_in(const char *work_dir, const apex_options *options) {
     char cwd[1024];
     cwd[0] = '\0';
+    if (work_dir) {
+        snprintf(cwd, sizeof(cwd), "%s", work_dir);
+    } else if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        cwd[0] = '\0';
+    }
 
     /* 1. CWD/.apex/config.yml */
-    if (getcwd(cwd, sizeof(cwd)) != NULL && cwd[0] != '\0') {
+    if (cwd[0] != '\0') {
         char path[1200];
         snprintf(path, sizeof(path), "%s/.apex/config.yml", cwd);
         FILE *fp = fopen(path, "r");
@@ -477,7 +516,7 @@ static char *apex_cli_find_project_config(const apex_options *options) {
     }
 
     /* 3. <git repo root>/.apex/config.yml, if CWD is inside the work tree */
-    char *git_root = apex_cli_git_toplevel();
+    char *git_root = work_dir ? (cwd[0] ? apex_cli_git_root_of(cwd) : NULL) : apex_cli_git_toplevel();
     if (git_root && git_root[0] != '\0' && cwd[0] != '\0') {
         size_t root_len = strlen(git_root);
         if (strncmp(cwd, git_root, root_len) == 0 &&
@@ -509,6 +548,10 @@ static char *apex_cli_find_project_config(const apex_options *options) {
     return NULL;
 }
 
+static char *apex_cli_find_project_config(const apex_options *options) {
+    return apex_cli_find_project_config_in(NULL, options);
+}
+
 /* ------------------------------------------------------------------------- */
 /* Local helpers for listing installed plugins                               */
 /*                                                                           */
@@ -852,7 +895,8 @@ static void apex_cli_print_info(FILE *out,
     cli_free_installed_plugins(installed_head);
 }
 
-/* Profiling helpers (same as in apex.c) */
+/* Profiling helpers for the CLI's own steps (APEX_PROFILE); conversion
+ * stages are timed by the library through apex_options.stats */
 static double get_time_ms(void) {
     struct timeval tv;
     gettimeofday(&tv, NULL);
@@ -978,13 +1022,15 @@ static void print_usage(const char *program_name) {
     fprintf(stderr, "Project homepage: https://github.com/ApexMarkdown/apex\n\n");
     fprintf(stderr, "Usage: %s [options] [file]\n", program_name);
     fprintf(stderr, "       %s --combine [files...]\n", program_name);
-    fprintf(stderr, "       %s --mmd-merge [index files...]\n\n", program_name);
+    fprintf(stderr, "       %s --mmd-merge [index files...]\n", program_name);
+    fprintf(stderr, "       %s [options] --output-dir DIR [-j N] [files or directories...]\n\n", program_name);
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  --accept               Accept all Critic Markup changes (apply edits)\n");
     fprintf(stderr, "  --[no-]alpha-lists     Support alpha list markers (a., b., c. and A., B., C.)\n");
     fprintf(stderr, "  --[no-]autolink        Enable autolinking of URLs and email addresses\n");
     fprintf(stderr, "  --base-dir DIR         Base directory for resolving relative paths (for images, includes, wiki links)\n");
     fprintf(stderr, "  --bibliography FILE     Bibliography file (BibTeX, CSL JSON, or CSL YAML) - can be used multiple times\n");
+    fprintf(stderr, "  --bibliography-cache DIR  Keep parsed bibliographies in DIR and reuse them while the files are unchanged\n");
     fprintf(stderr, "  --captions POSITION    Table caption position: above or below (default: below)\n");
     fprintf(stderr, "  --code-highlight TOOL  Use external tool for syntax highlighting (pygments, skylighting, shiki, or abbreviations p, s, sh)\n");
     fprintf(stderr, "  --code-highlight-theme THEME  Theme/style name for external syntax highlighters (tool-specific)\n");
@@ -1052,6 +1098,19 @@ static void print_usage(const char *program_name) {
     fprintf(stderr, "  --[no-]emoji-autocorrect  Enable/disable emoji name autocorrect (enabled by default in unified mode)\n");
     fprintf(stderr, "  --obfuscate-emails     Obfuscate email links/text using HTML entities\n");
     fprintf(stderr, "  -o, --output FILE      Write output to FILE instead of stdout\n");
+    fprintf(stderr, "  --output-dir DIR       Batch mode: convert every input file (directories are searched for Markdown\n");
+    fprintf(stderr, "                         files) into DIR, mirroring directory structure\n");
+    fprintf(stderr, "  -j, --jobs N           Number of parallel conversions in batch mode (default: one per CPU)\n");
+    fprintf(stderr, "  --parse-threads N      Parse large documents in up to N pieces concurrently (default: off)\n");
+    fprintf(stderr, "  --cache-dir DIR        Reuse output from DIR for unchanged inputs, options and included files\n");
+    fprintf(stderr, "  --cache-size SIZE      Size limit for --cache-dir, e.g. 512M (default: 256M)\n");
+    fprintf(stderr, "  --cache-stats          Print cache hits and misses to stderr\n");
+    fprintf(stderr, "  --profile-json         Print per-stage timings, sizes and cmark allocation counts to stderr as JSON\n");
+    fprintf(stderr, "  --daemon               Serve conversions on a Unix socket, keeping configuration, plugins\n");
+    fprintf(stderr, "                         and bibliography loaded (see --socket, --jobs)\n");
+    fprintf(stderr, "  --socket PATH          Daemon socket (default: $APEX_SOCKET, else a per-user path). When set,\n");
+    fprintf(stderr, "                         simple conversions are forwarded to a running daemon\n");
+    fprintf(stderr, "  --daemon-status        Print the daemon's pid and number of documents converted\n");
     fprintf(stderr, "  --[no-]progress          Show progress indicator during processing (enabled by default for TTY)\n");
     fprintf(stderr, "  --plugins              Enable external/plugin processing\n");
     fprintf(stderr, "  --pretty               Pretty-print HTML with indentation and whitespace\n");
@@ -1975,174 +2034,1741 @@ static int apex_cli_combine_from_summary(const char *summary_path, FILE *out) {
     return 0;
 }
 
-int main(int argc, char *argv[]) {
-    /* Initialize progress reporting */
-    init_progress();
+/**
+ * Load metadata from:
+ *   - Global config:   $XDG_CONFIG_HOME/apex/config.yml or ~/.config/apex/config.yml
+ *   - Project config:  project_config_path (NULL for none)
+ *   - Explicit --meta-file (if provided)
+ *
+ * These are merged (global < project < explicit); the result is later merged
+ * with document and command-line metadata. Returns NULL if there is none.
+ */
+static apex_metadata_item *apex_cli_load_config_metadata_at(const char *project_config_path,
+                                                            const char *meta_file) {
+    PROFILE_START(metadata_file_load);
+    apex_metadata_item *file_metadata = NULL;
+    apex_metadata_item *global_config_meta = NULL;
+    apex_metadata_item *project_config_meta = NULL;
+    apex_metadata_item *explicit_file_meta = NULL;
 
-    apex_options options = apex_options_default();
-    apex_options cli_options_snapshot;
-    apex_cli_option_mask cli_opt_mask = {0};
-    bool plugins_cli_override = false;
-    bool plugins_cli_value = false;
-    bool list_plugins = false;
-    bool list_themes = false;
-    bool cli_info = false;
-    bool cli_extract_meta = false;
-    const char *extract_meta_value_key = NULL;
-    const char *install_plugin_id = NULL;
-    const char *uninstall_plugin_id = NULL;
-    bool list_filters = false;
-    const char *uninstall_filter_id = NULL;
+    char *global_config_path = apex_cli_find_global_config();
 
-    /* Filter install (AST filters) */
-    const char *install_filter_id = NULL;
-    const char *input_file = NULL;
-    const char *output_file = NULL;
-    const char *meta_file = NULL;
-    apex_metadata_item *cmdline_metadata = NULL;
-    char *allocated_base_dir = NULL;      /* Track if we allocated base_directory */
-    char *allocated_input_file_path = NULL;  /* Track if we allocate input_file_path */
+    if (global_config_path) {
+        global_config_meta = apex_load_metadata_from_file(global_config_path);
+        if (!global_config_meta) {
+            fprintf(stderr, "Warning: Could not load metadata from global config '%s'\n", global_config_path);
+        }
+    }
 
-    /* Combine mode: concatenate Markdown files (with includes expanded) */
-    bool combine_mode = false;
-    char **combine_files = NULL;
-    size_t combine_file_count = 0;
-    size_t combine_file_capacity = 0;
+    if (project_config_path) {
+        project_config_meta = apex_load_metadata_from_file(project_config_path);
+        if (!project_config_meta) {
+            fprintf(stderr, "Warning: Could not load metadata from project config '%s'\n", project_config_path);
+        }
+    }
 
-    /* mmd-merge mode: emulate MultiMarkdown mmd_merge.pl behavior */
-    bool mmd_merge_mode = false;
-    char **mmd_merge_files = NULL;
-    size_t mmd_merge_file_count = 0;
-    size_t mmd_merge_file_capacity = 0;
+    if (meta_file) {
+        explicit_file_meta = apex_load_metadata_from_file(meta_file);
+        if (!explicit_file_meta) {
+            fprintf(stderr, "Warning: Could not load metadata from file '%s'\n", meta_file);
+        }
+    }
 
-    /* Bibliography files (NULL-terminated array) */
-    char **bibliography_files = NULL;
-    size_t bibliography_count = 0;
-    size_t bibliography_capacity = 4;
+    if (global_config_meta || project_config_meta || explicit_file_meta) {
+        file_metadata = apex_merge_metadata(
+            global_config_meta,
+            project_config_meta,
+            explicit_file_meta,
+            NULL
+        );
+    }
 
-    /* Stylesheet files (NULL-terminated array) */
-    char **stylesheet_files = NULL;
-    size_t stylesheet_count = 0;
-    size_t stylesheet_capacity = 4;
+    if (global_config_meta) apex_free_metadata(global_config_meta);
+    if (project_config_meta) apex_free_metadata(project_config_meta);
+    if (explicit_file_meta) apex_free_metadata(explicit_file_meta);
+    if (global_config_path) free(global_config_path);
 
-    /* Script tags (NULL-terminated array of raw <script> HTML snippets) */
-    char **script_tags = NULL;
-    size_t script_tag_count = 0;
-    size_t script_tag_capacity = 4;
+    PROFILE_END(metadata_file_load);
 
-    /* AST filters (Pandoc-style JSON filters) configured from CLI */
-    char   **ast_filter_names = NULL;   /* Filter names from --filter (resolved in config dir) */
-    size_t   ast_filter_name_count = 0;
-    size_t   ast_filter_name_capacity = 4;
-    bool     run_all_filters_dir = false;  /* --filters */
-    bool     ast_filters_strict = true;    /* default strict mode; --no-strict-filters disables */
+    return file_metadata;
+}
 
-    /* Lua filters: explicit script paths run via 'lua <script>' */
-    char   **lua_filter_paths = NULL;
-    size_t   lua_filter_count = 0;
-    size_t   lua_filter_capacity = 4;
+/* Config metadata with the project config found from CWD, base_directory
+ * or the git root */
+static apex_metadata_item *apex_cli_load_config_metadata(const apex_options *options,
+                                                         const char *meta_file) {
+    char *project_config_path = apex_cli_find_project_config(options);
+    apex_metadata_item *file_metadata = apex_cli_load_config_metadata_at(project_config_path, meta_file);
+    free(project_config_path);
+    return file_metadata;
+}
 
-    /* Optional fixed-width wrapping for terminal output */
-    int width_override = 0;
+/**
+ * Merge config, document and command-line metadata (in that priority order)
+ * and inject the result into the document as YAML front matter.
+ * doc_metadata_out and merged_out receive the document's own metadata and the
+ * merged set (NULL when there is none; caller frees). Returns the new document
+ * (length in *out_len), or NULL when the original should be used as is.
+ */
+static char *apex_cli_inject_metadata(const char *markdown, size_t input_len, apex_mode_t mode,
+                                      apex_metadata_item *file_metadata,
+                                      apex_metadata_item *cmdline_metadata,
+                                      apex_metadata_item **doc_metadata_out,
+                                      apex_metadata_item **merged_out,
+                                      size_t *out_len) {
+    /* Extract document metadata to merge with external sources
+     * We'll extract it here and then inject the merged result */
+    PROFILE_START(metadata_extract_cli);
+    apex_metadata_item *doc_metadata = NULL;
+    size_t doc_metadata_end = 0;
 
-    /* Pagination for terminal/terminal256 output */
-    bool paginate_cli = false;
-    bool paginate_symbols_cli = false;
-    bool no_paginate_cli = false;
+    if (mode == APEX_MODE_MULTIMARKDOWN ||
+        mode == APEX_MODE_KRAMDOWN ||
+        apex_mode_is_unified_family(mode)) {
+        /* Make a copy to extract metadata without modifying original */
+        char *doc_copy = malloc(input_len + 1);
+        if (doc_copy) {
+            memcpy(doc_copy, markdown, input_len);
+            doc_copy[input_len] = '\0';
+            char *doc_ptr = doc_copy;
+            doc_metadata = apex_extract_metadata(&doc_ptr);
+            if (doc_metadata) {
+                /* Calculate where metadata ended in original */
+                doc_metadata_end = doc_ptr - doc_copy;
+            }
+            free(doc_copy);
+        }
+    }
+    PROFILE_END(metadata_extract_cli);
 
-    /* Terminal inline images: --no-terminal-images / --terminal-image-width N */
-    bool no_terminal_images_cli = false;
-    int terminal_image_width_cli = -1; /* -1 = use options default */
+    /* Merge metadata in priority order: file -> document -> command-line */
+    PROFILE_START(metadata_merge);
+    apex_metadata_item *merged_metadata = NULL;
+    if (file_metadata || doc_metadata || cmdline_metadata) {
+        merged_metadata = apex_merge_metadata(
+            file_metadata,
+            doc_metadata,
+            cmdline_metadata,
+            NULL
+        );
+    }
+    PROFILE_END(metadata_merge);
 
-    /* Parse command-line arguments */
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
-            print_usage(argv[0]);
-            return 0;
-        } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--version") == 0) {
-            print_version();
-            return 0;
-        } else if (strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--info") == 0) {
-            cli_info = true;
-        } else if (strcmp(argv[i], "--extract-meta") == 0) {
-            cli_extract_meta = true;
-        } else if (strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "--extract-meta-value") == 0) {
-            if (++i >= argc) {
-                fprintf(stderr, "Error: --extract-meta-value requires a KEY argument\n");
-                return 1;
-            }
-            extract_meta_value_key = argv[i];
-        } else if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--mode") == 0) {
-            if (++i >= argc) {
-                fprintf(stderr, "Error: --mode requires an argument\n");
-                return 1;
-            }
-            cli_opt_mask.mode = true;
-            if (strcmp(argv[i], "commonmark") == 0) {
-                options = apex_options_for_mode(APEX_MODE_COMMONMARK);
-            } else if (strcmp(argv[i], "gfm") == 0) {
-                options = apex_options_for_mode(APEX_MODE_GFM);
-            } else if (strcmp(argv[i], "mmd") == 0 || strcmp(argv[i], "multimarkdown") == 0) {
-                options = apex_options_for_mode(APEX_MODE_MULTIMARKDOWN);
-            } else if (strcmp(argv[i], "kramdown") == 0) {
-                options = apex_options_for_mode(APEX_MODE_KRAMDOWN);
-            } else if (strcmp(argv[i], "unified") == 0) {
-                options = apex_options_for_mode(APEX_MODE_UNIFIED);
-            } else if (strcmp(argv[i], "quarto") == 0) {
-                options = apex_options_for_mode(APEX_MODE_QUARTO);
+    /* Build enhanced markdown with merged metadata as YAML front matter */
+    PROFILE_START(metadata_yaml_build);
+    char *enhanced_markdown = NULL;
+    size_t enhanced_len = input_len;
+
+    if (merged_metadata) {
+        bool has_existing_metadata = (doc_metadata_end > 0);
+        size_t metadata_start_pos = 0;
+        size_t metadata_end_pos = doc_metadata_end;
+
+        char *yaml_buf = NULL;
+        size_t yaml_sz = 0;
+        FILE *ym = open_memstream(&yaml_buf, &yaml_sz);
+        if (ym) {
+            fprintf(ym, "---\n");
+            apex_metadata_fprint_yaml_mapping(ym, merged_metadata);
+            fprintf(ym, "---\n");
+            fclose(ym);
+        }
+
+        if (yaml_buf && yaml_sz > 0) {
+            size_t yaml_pos = yaml_sz;
+
+            if (has_existing_metadata) {
+                /* Replace existing metadata */
+                size_t before_len = metadata_start_pos;
+                size_t after_len = input_len - metadata_end_pos;
+                enhanced_len = before_len + yaml_pos + after_len;
+                enhanced_markdown = malloc(enhanced_len + 1);
+                if (enhanced_markdown) {
+                    if (before_len > 0) {
+                        memcpy(enhanced_markdown, markdown, before_len);
+                    }
+                    memcpy(enhanced_markdown + before_len, yaml_buf, yaml_pos);
+                    if (after_len > 0) {
+                        memcpy(enhanced_markdown + before_len + yaml_pos, markdown + metadata_end_pos, after_len);
+                    }
+                    enhanced_markdown[enhanced_len] = '\0';
+                }
             } else {
-                fprintf(stderr, "Error: Unknown mode '%s'\n", argv[i]);
-                return 1;
-            }
-        } else if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--to") == 0) {
-            if (++i >= argc) {
-                fprintf(stderr, "Error: --to requires an argument\n");
-                return 1;
+                /* Prepend metadata */
+                enhanced_len = yaml_pos + input_len;
+                enhanced_markdown = malloc(enhanced_len + 1);
+                if (enhanced_markdown) {
+                    memcpy(enhanced_markdown, yaml_buf, yaml_pos);
+                    memcpy(enhanced_markdown + yaml_pos, markdown, input_len);
+                    enhanced_markdown[enhanced_len] = '\0';
+                }
             }
-            cli_opt_mask.output_format = true;
-            if (strcmp(argv[i], "html") == 0) {
-                options.output_format = APEX_OUTPUT_HTML;
-            } else if (strcmp(argv[i], "xhtml") == 0) {
-                /* Alias for -t html --xhtml */
-                cli_opt_mask.xhtml = true;
-                cli_opt_mask.strict_xhtml = true;
-                options.output_format = APEX_OUTPUT_HTML;
-                options.xhtml = true;
-                options.strict_xhtml = false;
-            } else if (strcmp(argv[i], "strict-xhtml") == 0) {
-                /* Alias for -t html --strict-xhtml */
-                cli_opt_mask.xhtml = true;
-                cli_opt_mask.strict_xhtml = true;
-                options.output_format = APEX_OUTPUT_HTML;
-                options.strict_xhtml = true;
-                options.xhtml = false;
-            } else if (strcmp(argv[i], "json") == 0) {
-                options.output_format = APEX_OUTPUT_JSON;
-            } else if (strcmp(argv[i], "json-filtered") == 0 || strcmp(argv[i], "ast-json") == 0 || strcmp(argv[i], "ast") == 0) {
-                options.output_format = APEX_OUTPUT_JSON_FILTERED;
-            } else if (strcmp(argv[i], "markdown") == 0 || strcmp(argv[i], "md") == 0) {
-                options.output_format = APEX_OUTPUT_MARKDOWN;
-            } else if (strcmp(argv[i], "mmd") == 0) {
-                options.output_format = APEX_OUTPUT_MMD;
-            } else if (strcmp(argv[i], "commonmark") == 0 || strcmp(argv[i], "cmark") == 0) {
-                options.output_format = APEX_OUTPUT_COMMONMARK;
-            } else if (strcmp(argv[i], "kramdown") == 0) {
-                options.output_format = APEX_OUTPUT_KRAMDOWN;
-            } else if (strcmp(argv[i], "gfm") == 0) {
-                options.output_format = APEX_OUTPUT_GFM;
-            } else if (strcmp(argv[i], "terminal") == 0 || strcmp(argv[i], "cli") == 0) {
-                options.output_format = APEX_OUTPUT_TERMINAL;
-            } else if (strcmp(argv[i], "terminal256") == 0) {
-                options.output_format = APEX_OUTPUT_TERMINAL256;
-            } else if (strcmp(argv[i], "man") == 0) {
-                options.output_format = APEX_OUTPUT_MAN;
-            } else if (strcmp(argv[i], "man-html") == 0) {
-                options.output_format = APEX_OUTPUT_MAN_HTML;
-            } else if (strcmp(argv[i], "toc") == 0) {
-                options.output_format = APEX_OUTPUT_TOC;
-            } else if (strcmp(argv[i], "rtf") == 0) {
-                options.output_format = APEX_OUTPUT_RTF;
-            } else {
+            free(yaml_buf);
+        }
+    }
+    PROFILE_END(metadata_yaml_build);
+
+    *doc_metadata_out = doc_metadata;
+    *merged_out = merged_metadata;
+    *out_len = enhanced_len;
+    return enhanced_markdown;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Batch mode (--output-dir, --jobs)                                         */
+/*                                                                           */
+/* Converts many inputs on a pool of worker threads. Configuration, plugins, */
+/* extensions and bibliography are loaded once into a shared apex_converter; */
+/* documents with their own metadata get per-document options instead.     */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    char *input_path;   /* Markdown file to convert */
+    char *output_path;  /* Destination inside the output directory */
+    apex_metadata_item *config_metadata;  /* Config of the file's own directory, or NULL for the batch's */
+    bool owns_config;   /* config_metadata is freed with this item (others in the directory share it) */
+} apex_cli_batch_item;
+
+typedef struct {
+    apex_cli_batch_item *items;
+    size_t count;
+    size_t capacity;
+} apex_cli_batch_list;
+
+#define APEX_CLI_DIR_BUCKETS 64
+#define APEX_CLI_DIR_CONVERTERS_MAX 1024
+
+/* Converter set up for one base directory, so the bibliography and project
+ * plugins it loads resolve from that directory as in single-file mode */
+typedef struct apex_cli_dir_converter {
+    char *dir;
+    apex_converter *converter;
+    struct apex_cli_dir_converter *next;
+} apex_cli_dir_converter;
+
+typedef struct {
+    const apex_cli_batch_list *list;
+    apex_options argv_options;          /* Options before any metadata */
+    apex_options base_options;          /* argv + config/command-line metadata */
+    const apex_cli_option_mask *mask;
+    apex_converter *converter;          /* Shared by all workers */
+    apex_cli_dir_converter *dir_converters[APEX_CLI_DIR_BUCKETS];  /* Keyed by base directory */
+    size_t dir_converter_count;
+    apex_render_cache *cache;           /* --cache-dir, or NULL */
+    apex_metadata_item *file_metadata;
+    apex_metadata_item *cmdline_metadata;
+    apex_metadata_item *shared_metadata;
+    bool plugins_cli_override;
+    bool plugins_cli_value;
+    bool explicit_base_directory;
+    bool profile_json;                  /* --profile-json */
+
+    pthread_mutex_t lock;
+    size_t next;                        /* Next unclaimed item */
+    size_t failed;
+} apex_cli_batch;
+
+/* Per-document overrides sent by a daemon client */
+typedef struct {
+    const char *input_path;             /* Source file, or NULL for stdin */
+    const char *cwd;                    /* Client working directory (config lookup, stdin base) */
+    const char *format;                 /* -t name, or NULL for the daemon's */
+    int standalone;                     /* -1 keeps the daemon's setting */
+    int pretty;
+    const char *title;
+    bool status;                        /* Query the daemon instead of converting */
+} apex_cli_request;
+
+static bool apex_cli_is_markdown_file(const char *name) {
+    static const char *const exts[] = { ".md", ".markdown", ".mdown", ".mkd", ".mkdn", ".mmd", NULL };
+    const char *dot = strrchr(name, '.');
+    if (!dot) return false;
+    for (size_t i = 0; exts[i]; i++) {
+        if (strcasecmp(dot, exts[i]) == 0) return true;
+    }
+    return false;
+}
+
+/* File extension for converted output */
+static const char *apex_cli_output_extension(apex_output_format_t format) {
+    switch (format) {
+        case APEX_OUTPUT_JSON:
+        case APEX_OUTPUT_JSON_FILTERED:
+            return ".json";
+        case APEX_OUTPUT_MARKDOWN:
+        case APEX_OUTPUT_MMD:
+        case APEX_OUTPUT_COMMONMARK:
+        case APEX_OUTPUT_KRAMDOWN:
+        case APEX_OUTPUT_GFM:
+        case APEX_OUTPUT_TOC:
+            return ".md";
+        case APEX_OUTPUT_TERMINAL:
+        case APEX_OUTPUT_TERMINAL256:
+            return ".txt";
+        case APEX_OUTPUT_MAN:
+            return ".1";
+        case APEX_OUTPUT_RTF:
+            return ".rtf";
+        case APEX_OUTPUT_HTML:
+        case APEX_OUTPUT_MAN_HTML:
+        default:
+            return ".html";
+    }
+}
+
+/* output_dir/relative with the Markdown extension replaced */
+static char *apex_cli_batch_output_path(const char *output_dir, const char *relative,
+                                        const char *ext) {
+    const char *dot = strrchr(relative, '.');
+    const char *slash = strrchr(relative, '/');
+    size_t stem_len = (dot && (!slash || dot > slash)) ? (size_t)(dot - relative) : strlen(relative);
+    size_t len = strlen(output_dir) + 1 + stem_len + strlen(ext) + 1;
+    char *path = malloc(len);
+    if (!path) return NULL;
+    snprintf(path, len, "%s/%.*s%s", output_dir, (int)stem_len, relative, ext);
+    return path;
+}
+
+static bool apex_cli_batch_add(apex_cli_batch_list *list, const char *input_path,
+                               const char *output_dir, const char *relative, const char *ext) {
+    if (list->count >= list->capacity) {
+        size_t new_cap = list->capacity ? list->capacity * 2 : 64;
+        apex_cli_batch_item *tmp = realloc(list->items, new_cap * sizeof(*tmp));
+        if (!tmp) return false;
+        list->items = tmp;
+        list->capacity = new_cap;
+    }
+    apex_cli_batch_item *item = &list->items[list->count];
+    memset(item, 0, sizeof(*item));
+    item->input_path = strdup(input_path);
+    item->output_path = apex_cli_batch_output_path(output_dir, relative, ext);
+    if (!item->input_path || !item->output_path) {
+        free(item->input_path);
+        free(item->output_path);
+        return false;
+    }
+    list->count++;
+    return true;
+}
+
+/* Recursively queue Markdown files under dir; rel_prefix mirrors the tree */
+static bool apex_cli_batch_collect_dir(apex_cli_batch_list *list, const char *dir,
+                                       const char *rel_prefix, const char *output_dir,
+                                       const char *ext) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "Error: Cannot open directory '%s'\n", dir);
+        return false;
+    }
+    bool ok = true;
+    struct dirent *ent;
+    while (ok && (ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+        char path[PATH_MAX];
+        char rel[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (rel_prefix[0]) {
+            snprintf(rel, sizeof(rel), "%s/%s", rel_prefix, ent->d_name);
+        } else {
+            snprintf(rel, sizeof(rel), "%s", ent->d_name);
+        }
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            ok = apex_cli_batch_collect_dir(list, path, rel, output_dir, ext);
+        } else if (S_ISREG(st.st_mode) && apex_cli_is_markdown_file(ent->d_name)) {
+            ok = apex_cli_batch_add(list, path, output_dir, rel, ext);
+        }
+    }
+    closedir(d);
+    return ok;
+}
+
+static int apex_cli_batch_item_cmp(const void *a, const void *b) {
+    return strcmp(((const apex_cli_batch_item *)a)->input_path,
+                  ((const apex_cli_batch_item *)b)->input_path);
+}
+
+static void apex_cli_batch_list_free(apex_cli_batch_list *list) {
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->items[i].input_path);
+        free(list->items[i].output_path);
+        if (list->items[i].owns_config) apex_free_metadata(list->items[i].config_metadata);
+    }
+    free(list->items);
+}
+
+static int apex_cli_batch_output_cmp(const void *a, const void *b) {
+    return strcmp((*(const apex_cli_batch_item *const *)a)->output_path,
+                  (*(const apex_cli_batch_item *const *)b)->output_path);
+}
+
+/**
+ * Report inputs that map to the same output file (a/readme.md and
+ * b/readme.md given as files). Returns false if there are any.
+ */
+static bool apex_cli_batch_check_collisions(const apex_cli_batch_list *list) {
+    const apex_cli_batch_item **sorted = malloc(list->count * sizeof(*sorted));
+    if (!sorted) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    for (size_t i = 0; i < list->count; i++) {
+        sorted[i] = &list->items[i];
+    }
+    qsort(sorted, list->count, sizeof(*sorted), apex_cli_batch_output_cmp);
+
+    bool ok = true;
+    for (size_t i = 1; i < list->count; i++) {
+        if (strcmp(sorted[i - 1]->output_path, sorted[i]->output_path) == 0) {
+            fprintf(stderr, "Error: '%s' and '%s' would both be written to '%s'\n",
+                    sorted[i - 1]->input_path, sorted[i]->input_path, sorted[i]->output_path);
+            ok = false;
+        }
+    }
+    free(sorted);
+    return ok;
+}
+
+/* mkdir -p for the directory part of path */
+static bool apex_cli_make_parent_dirs(const char *path) {
+    char buf[PATH_MAX];
+    if (snprintf(buf, sizeof(buf), "%s", path) >= (int)sizeof(buf)) return false;
+    char *slash = strrchr(buf, '/');
+    if (!slash || slash == buf) return true;
+    *slash = '\0';
+    for (char *p = buf + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(buf, 0755) != 0 && errno != EEXIST) return false;
+            *p = '/';
+        }
+    }
+    return mkdir(buf, 0755) == 0 || errno == EEXIST;
+}
+
+/* Directory containing path, or NULL for the current directory */
+static char *apex_cli_parent_dir(const char *path) {
+    const char *slash = strrchr(path, '/');
+    if (!slash) return NULL;
+    if (slash == path) return strdup("/");
+    size_t len = (size_t)(slash - path);
+    char *dir = malloc(len + 1);
+    if (!dir) return NULL;
+    memcpy(dir, path, len);
+    dir[len] = '\0';
+    return dir;
+}
+
+/**
+ * Single-file mode looks for .apex/config.yml in the input's directory when
+ * the working directory has none. Give each file whose directory resolves
+ * to another project config than the batch's that config's metadata, so a
+ * batch converts every file as a single run would. Files of one directory
+ * share the metadata.
+ */
+static void apex_cli_batch_resolve_configs(apex_cli_batch_list *list, const apex_options *options,
+                                           const char *meta_file) {
+    char *batch_config = apex_cli_find_project_config(options);
+    char *prev_dir = NULL;
+    apex_metadata_item *prev_metadata = NULL;
+
+    for (size_t i = 0; i < list->count; i++) {
+        apex_cli_batch_item *item = &list->items[i];
+        char *dir = apex_cli_parent_dir(item->input_path);
+        if (!dir) continue;  /* Current directory: the batch's own config */
+        if (prev_dir && strcmp(dir, prev_dir) == 0) {
+            item->config_metadata = prev_metadata;
+            free(dir);
+            continue;
+        }
+        free(prev_dir);
+        prev_dir = dir;
+        prev_metadata = NULL;
+
+        apex_options dir_options = *options;
+        dir_options.base_directory = dir;
+        char *config = apex_cli_find_project_config(&dir_options);
+        if (config && (!batch_config || strcmp(config, batch_config) != 0)) {
+            prev_metadata = apex_cli_load_config_metadata_at(config, meta_file);
+            item->owns_config = prev_metadata != NULL;
+        }
+        item->config_metadata = prev_metadata;
+        free(config);
+    }
+    free(prev_dir);
+    free(batch_config);
+}
+
+static bool apex_cli_set_output_format(apex_options *options, const char *name);
+
+/**
+ * --profile-json: write one line {"file": ..., "stats": {...}} to stderr.
+ * The line goes out in one call so concurrent batch workers don't mix.
+ */
+static void apex_cli_print_profile(const char *path, const apex_stats *stats) {
+    char *json = apex_stats_to_json(stats);
+    if (!json) return;
+    size_t path_len = path ? strlen(path) : 0;
+    size_t cap = path_len * 6 + strlen(json) + 32;
+    char *line = malloc(cap);
+    if (line) {
+        size_t used = (size_t)snprintf(line, cap, "{\"file\":");
+        if (path) {
+            line[used++] = '"';
+            for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+                if (*p == '"' || *p == '\\') {
+                    line[used++] = '\\';
+                    line[used++] = (char)*p;
+                } else if (*p < 0x20) {
+                    used += (size_t)snprintf(line + used, cap - used, "\\u%04x", *p);
+                } else {
+                    line[used++] = (char)*p;
+                }
+            }
+            line[used++] = '"';
+        } else {
+            used += (size_t)snprintf(line + used, cap - used, "null");
+        }
+        snprintf(line + used, cap - used, ",\"stats\":%s}\n", json);
+        fputs(line, stderr);
+        free(line);
+    }
+    apex_free_string(json);
+}
+
+static size_t apex_cli_dir_bucket(const char *dir) {
+    size_t h = 5381;
+    for (const unsigned char *p = (const unsigned char *)dir; *p; p++) h = h * 33 + *p;
+    return h % APEX_CLI_DIR_BUCKETS;
+}
+
+/**
+ * Converter whose base directory is dir, created on first use from the
+ * batch's options. NULL dir is the batch's own converter, and so is any
+ * directory past APEX_CLI_DIR_CONVERTERS_MAX; the library then loads the
+ * directory-dependent parts per document.
+ */
+static const apex_converter *apex_cli_batch_converter_for(apex_cli_batch *batch, const char *dir) {
+    if (!dir) return batch->converter;
+    size_t bucket = apex_cli_dir_bucket(dir);
+
+    pthread_mutex_lock(&batch->lock);
+    for (apex_cli_dir_converter *e = batch->dir_converters[bucket]; e; e = e->next) {
+        if (strcmp(e->dir, dir) == 0) {
+            pthread_mutex_unlock(&batch->lock);
+            return e->converter;
+        }
+    }
+    bool full = batch->dir_converter_count >= APEX_CLI_DIR_CONVERTERS_MAX;
+    pthread_mutex_unlock(&batch->lock);
+    if (full) return batch->converter;
+
+    /* Load outside the lock; a worker that raced us to it keeps its own */
+    apex_cli_dir_converter *entry = calloc(1, sizeof(*entry));
+    if (!entry || !(entry->dir = strdup(dir))) {
+        free(entry);
+        return batch->converter;
+    }
+    apex_options dir_options = batch->base_options;
+    dir_options.base_directory = entry->dir;
+    entry->converter = apex_converter_new(&dir_options);
+    if (!entry->converter) {
+        free(entry->dir);
+        free(entry);
+        return batch->converter;
+    }
+
+    pthread_mutex_lock(&batch->lock);
+    for (apex_cli_dir_converter *e = batch->dir_converters[bucket]; e; e = e->next) {
+        if (strcmp(e->dir, dir) == 0) {
+            pthread_mutex_unlock(&batch->lock);
+            apex_converter_free(entry->converter);
+            free(entry->dir);
+            free(entry);
+            return e->converter;
+        }
+    }
+    entry->next = batch->dir_converters[bucket];
+    batch->dir_converters[bucket] = entry;
+    batch->dir_converter_count++;
+    pthread_mutex_unlock(&batch->lock);
+    return entry->converter;
+}
+
+/**
+ * Convert one document with the batch's shared setup. config_metadata
+ * replaces the batch's config metadata when the document's directory has
+ * its own (NULL otherwise), and request (may be NULL) carries daemon client
+ * overrides. Returns the output (free with apex_free_string) and its
+ * length, or NULL on failure.
+ */
+static char *apex_cli_batch_convert(apex_cli_batch *batch, const char *markdown, size_t input_len,
+                                    const char *input_path, apex_metadata_item *config_metadata,
+                                    const apex_cli_request *request, size_t *out_len) {
+    apex_metadata_item *doc_metadata = NULL;
+    apex_metadata_item *merged_metadata = NULL;
+    size_t enhanced_len = input_len;
+    char *enhanced_markdown = apex_cli_inject_metadata(markdown, input_len, batch->base_options.mode,
+                                                       config_metadata ? config_metadata : batch->file_metadata,
+                                                       batch->cmdline_metadata,
+                                                       &doc_metadata, &merged_metadata,
+                                                       &enhanced_len);
+    const char *final_markdown = enhanced_markdown ? enhanced_markdown : markdown;
+    size_t final_len = enhanced_markdown ? enhanced_len : input_len;
+
+    /* Same per-document options as single-file mode */
+    apex_options opts = batch->base_options;
+    bool own_options = doc_metadata || config_metadata;
+    if (own_options) {
+        opts = batch->argv_options;
+        if (merged_metadata) apex_apply_metadata_to_options(merged_metadata, &opts);
+        apex_cli_restore_argv_options(&opts, &batch->argv_options, batch->mask);
+        if (batch->plugins_cli_override) {
+            opts.enable_plugins = batch->plugins_cli_value;
+        }
+    }
+    if (request) {
+        if (request->format) apex_cli_set_output_format(&opts, request->format);
+        if (request->standalone >= 0) opts.standalone = request->standalone != 0;
+        if (request->pretty >= 0) opts.pretty = request->pretty != 0;
+        if (request->title) opts.document_title = request->title;
+    }
+    if (opts.output_format == APEX_OUTPUT_MAN || opts.output_format == APEX_OUTPUT_MAN_HTML) {
+        opts.enable_smart_typography = false;
+    }
+
+    char *base_dir = NULL;
+    if (!batch->explicit_base_directory) {
+        if (input_path) {
+            base_dir = apex_cli_parent_dir(input_path);
+            opts.base_directory = base_dir;
+        } else if (request && request->cwd) {
+            opts.base_directory = request->cwd;
+        }
+    }
+    opts.input_file_path = input_path;
+
+    apex_stats stats;
+    if (batch->profile_json) opts.stats = &stats;
+
+    /* One converter per base directory. Documents whose metadata or config
+     * changed the options still use it; the library loads only the parts
+     * set up from options that differ (bibliography, plugins, tables) */
+    const apex_converter *converter = batch->explicit_base_directory
+                                          ? batch->converter
+                                          : apex_cli_batch_converter_for(batch, opts.base_directory);
+    char *output;
+    if (batch->cache) {
+        output = apex_render_cache_convert(batch->cache, converter, final_markdown, final_len, &opts);
+    } else if (converter) {
+        output = apex_converter_convert_with_options(converter, final_markdown, final_len, &opts);
+    } else {
+        output = apex_markdown_to_html(final_markdown, final_len, &opts);
+    }
+
+    if (output) {
+        bool is_terminal_output = (opts.output_format == APEX_OUTPUT_TERMINAL ||
+                                   opts.output_format == APEX_OUTPUT_TERMINAL256);
+        *out_len = is_terminal_output ? apex_terminal_output_length() : strlen(output);
+        if (*out_len == 0) {
+            *out_len = strlen(output);
+        }
+        if (batch->profile_json) apex_cli_print_profile(input_path, &stats);
+    }
+
+    free(base_dir);
+    if (enhanced_markdown) free(enhanced_markdown);
+    if (doc_metadata) apex_free_metadata(doc_metadata);
+    if (merged_metadata) apex_free_metadata(merged_metadata);
+    return output;
+}
+
+static bool apex_cli_batch_convert_one(apex_cli_batch *batch, const apex_cli_batch_item *item) {
+    size_t input_len = 0;
+    char *markdown = read_file(item->input_path, &input_len);
+    if (!markdown) return false;
+
+    size_t output_len = 0;
+    char *output = apex_cli_batch_convert(batch, markdown, input_len, item->input_path,
+                                          item->config_metadata, NULL, &output_len);
+
+    bool ok = false;
+    if (!output) {
+        fprintf(stderr, "Error: %s: Conversion failed\n", item->input_path);
+    } else {
+        FILE *fp = NULL;
+        if (apex_cli_make_parent_dirs(item->output_path)) {
+            fp = fopen(item->output_path, "w");
+        }
+        if (!fp) {
+            fprintf(stderr, "Error: %s: Cannot open output file '%s'\n",
+                    item->input_path, item->output_path);
+        } else {
+            ok = fwrite(output, 1, output_len, fp) == output_len;
+            if (fclose(fp) != 0) ok = false;
+            if (!ok) {
+                fprintf(stderr, "Error: %s: Cannot write '%s'\n", item->input_path, item->output_path);
+            }
+        }
+        apex_free_string(output);
+    }
+
+    free(markdown);
+    return ok;
+}
+
+/* Worker: claim the next unconverted file until the list is drained, so
+ * idle threads always pick up the remaining work */
+static void *apex_cli_batch_worker(void *arg) {
+    apex_cli_batch *batch = (apex_cli_batch *)arg;
+    for (;;) {
+        pthread_mutex_lock(&batch->lock);
+        size_t index = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+        if (index >= batch->list->count) break;
+
+        if (!apex_cli_batch_convert_one(batch, &batch->list->items[index])) {
+            pthread_mutex_lock(&batch->lock);
+            batch->failed++;
+            pthread_mutex_unlock(&batch->lock);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Load configuration and metadata shared by every document and create the
+ * converter. Used by batch mode and the daemon.
+ */
+static bool apex_cli_batch_setup(apex_cli_batch *batch, const apex_options *options,
+                                 const char *meta_file, apex_metadata_item *cmdline_metadata,
+                                 const apex_cli_option_mask *mask,
+                                 bool plugins_cli_override, bool plugins_cli_value) {
+    memset(batch, 0, sizeof(*batch));
+    batch->argv_options = *options;
+    batch->mask = mask;
+    batch->cmdline_metadata = cmdline_metadata;
+    batch->plugins_cli_override = plugins_cli_override;
+    batch->plugins_cli_value = plugins_cli_value;
+    batch->explicit_base_directory = options->base_directory != NULL;
+
+    batch->file_metadata = apex_cli_load_config_metadata(options, meta_file);
+    if (batch->file_metadata || cmdline_metadata) {
+        batch->shared_metadata = apex_merge_metadata(batch->file_metadata, cmdline_metadata, NULL);
+    }
+    batch->base_options = batch->argv_options;
+    if (batch->shared_metadata) {
+        apex_apply_metadata_to_options(batch->shared_metadata, &batch->base_options);
+        apex_cli_restore_argv_options(&batch->base_options, &batch->argv_options, mask);
+    }
+    if (plugins_cli_override) {
+        batch->base_options.enable_plugins = plugins_cli_value;
+    }
+    if (batch->base_options.output_format == APEX_OUTPUT_MAN ||
+        batch->base_options.output_format == APEX_OUTPUT_MAN_HTML) {
+        batch->base_options.enable_smart_typography = false;
+    }
+
+    batch->converter = apex_converter_new(&batch->base_options);
+    if (!batch->converter) {
+        if (batch->shared_metadata) apex_free_metadata(batch->shared_metadata);
+        if (batch->file_metadata) apex_free_metadata(batch->file_metadata);
+        return false;
+    }
+    pthread_mutex_init(&batch->lock, NULL);
+    return true;
+}
+
+static void apex_cli_batch_teardown(apex_cli_batch *batch) {
+    pthread_mutex_destroy(&batch->lock);
+    for (size_t i = 0; i < APEX_CLI_DIR_BUCKETS; i++) {
+        apex_cli_dir_converter *e = batch->dir_converters[i];
+        while (e) {
+            apex_cli_dir_converter *next = e->next;
+            apex_converter_free(e->converter);
+            free(e->dir);
+            free(e);
+            e = next;
+        }
+    }
+    apex_converter_free(batch->converter);
+    if (batch->shared_metadata) apex_free_metadata(batch->shared_metadata);
+    if (batch->file_metadata) apex_free_metadata(batch->file_metadata);
+}
+
+/**
+ * Convert every input (files, or directories searched recursively for
+ * Markdown files) into output_dir using jobs worker threads (0 = one per
+ * CPU). Per-file failures are reported and counted without stopping the
+ * batch. Returns the process exit code.
+ */
+static int apex_cli_run_batch(apex_options *options, char **inputs, size_t input_count,
+                              const char *output_dir, int jobs, const char *meta_file,
+                              apex_metadata_item *cmdline_metadata,
+                              const apex_cli_option_mask *mask,
+                              bool plugins_cli_override, bool plugins_cli_value,
+                              apex_render_cache *cache, bool profile_json) {
+    const char *ext = apex_cli_output_extension(options->output_format);
+
+    apex_cli_batch_list list = {0};
+    size_t missing = 0;
+    for (size_t i = 0; i < input_count; i++) {
+        struct stat st;
+        if (stat(inputs[i], &st) != 0) {
+            fprintf(stderr, "Error: Cannot open file '%s'\n", inputs[i]);
+            missing++;
+            continue;
+        }
+        bool ok;
+        if (S_ISDIR(st.st_mode)) {
+            ok = apex_cli_batch_collect_dir(&list, inputs[i], "", output_dir, ext);
+        } else {
+            const char *slash = strrchr(inputs[i], '/');
+            ok = apex_cli_batch_add(&list, inputs[i], output_dir, slash ? slash + 1 : inputs[i], ext);
+        }
+        if (!ok) {
+            apex_cli_batch_list_free(&list);
+            return 1;
+        }
+    }
+    if (list.count == 0) {
+        fprintf(stderr, "Error: No Markdown files found\n");
+        apex_cli_batch_list_free(&list);
+        return 1;
+    }
+    qsort(list.items, list.count, sizeof(list.items[0]), apex_cli_batch_item_cmp);
+    if (!apex_cli_batch_check_collisions(&list)) {
+        apex_cli_batch_list_free(&list);
+        return 1;
+    }
+    if (!options->base_directory) {
+        apex_cli_batch_resolve_configs(&list, options, meta_file);
+    }
+
+    apex_cli_batch batch;
+    if (!apex_cli_batch_setup(&batch, options, meta_file, cmdline_metadata, mask,
+                              plugins_cli_override, plugins_cli_value)) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        apex_cli_batch_list_free(&list);
+        return 1;
+    }
+    batch.list = &list;
+    batch.cache = cache;
+    batch.profile_json = profile_json;
+
+    if (jobs <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus > 0 ? (int)cpus : 1;
+    }
+    if ((size_t)jobs > list.count) {
+        jobs = (int)list.count;
+    }
+
+    PROFILE_START(batch_convert);
+    pthread_t *threads = malloc((size_t)jobs * sizeof(pthread_t));
+    int started = 0;
+    if (threads) {
+        for (; started < jobs; started++) {
+            if (pthread_create(&threads[started], NULL, apex_cli_batch_worker, &batch) != 0) break;
+        }
+    }
+    /* No threads available: convert on this one */
+    if (started == 0) {
+        apex_cli_batch_worker(&batch);
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    free(threads);
+    PROFILE_END(batch_convert);
+
+    size_t failed = batch.failed + missing;
+    if (failed > 0) {
+        fprintf(stderr, "Converted %zu of %zu files (%zu failed)\n",
+                list.count - batch.failed, list.count + missing, failed);
+    }
+
+    apex_cli_batch_teardown(&batch);
+    apex_cli_batch_list_free(&list);
+    return failed > 0 ? 1 : 0;
+}
+
+/**
+ * Apply an output format name as given to -t. Returns false for unknown
+ * names and leaves options unchanged.
+ */
+static bool apex_cli_set_output_format(apex_options *options, const char *name) {
+    static const struct {
+        const char *name;
+        apex_output_format_t format;
+    } formats[] = {
+        { "html", APEX_OUTPUT_HTML },
+        { "json", APEX_OUTPUT_JSON },
+        { "json-filtered", APEX_OUTPUT_JSON_FILTERED },
+        { "ast-json", APEX_OUTPUT_JSON_FILTERED },
+        { "ast", APEX_OUTPUT_JSON_FILTERED },
+        { "markdown", APEX_OUTPUT_MARKDOWN },
+        { "md", APEX_OUTPUT_MARKDOWN },
+        { "mmd", APEX_OUTPUT_MMD },
+        { "commonmark", APEX_OUTPUT_COMMONMARK },
+        { "cmark", APEX_OUTPUT_COMMONMARK },
+        { "kramdown", APEX_OUTPUT_KRAMDOWN },
+        { "gfm", APEX_OUTPUT_GFM },
+        { "terminal", APEX_OUTPUT_TERMINAL },
+        { "cli", APEX_OUTPUT_TERMINAL },
+        { "terminal256", APEX_OUTPUT_TERMINAL256 },
+        { "man", APEX_OUTPUT_MAN },
+        { "man-html", APEX_OUTPUT_MAN_HTML },
+        { "toc", APEX_OUTPUT_TOC },
+        { "rtf", APEX_OUTPUT_RTF },
+    };
+
+    if (strcmp(name, "xhtml") == 0) {
+        /* Alias for -t html --xhtml */
+        options->output_format = APEX_OUTPUT_HTML;
+        options->xhtml = true;
+        options->strict_xhtml = false;
+        return true;
+    }
+    if (strcmp(name, "strict-xhtml") == 0) {
+        /* Alias for -t html --strict-xhtml */
+        options->output_format = APEX_OUTPUT_HTML;
+        options->strict_xhtml = true;
+        options->xhtml = false;
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        if (strcmp(name, formats[i].name) == 0) {
+            options->output_format = formats[i].format;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Daemon mode (--daemon, --socket)                                          */
+/*                                                                           */
+/* A long-running process that keeps the batch setup (configuration,        */
+/* plugins, extensions, bibliography, highlighter) warm and converts        */
+/* documents sent over a Unix domain socket. Every message is a frame: a    */
+/* 4-byte big-endian length followed by that many bytes.                    */
+/*                                                                           */
+/*   request:  header frame ("key=value" lines), markdown frame              */
+/*   response: status frame ("ok" or "error MESSAGE"), output frame          */
+/*                                                                           */
+/* Header keys: file, cwd, to, standalone, pretty, title, status. Values    */
+/* can't contain line breaks. A connection may carry any number of         */
+/* requests.                                                                */
+/* ------------------------------------------------------------------------- */
+
+#define APEX_CLI_MAX_FRAME ((size_t)64 << 20)   /* Markdown and output */
+#define APEX_CLI_MAX_HEADER ((size_t)64 << 10)  /* Header and status frames */
+#define APEX_CLI_IDLE_TIMEOUT_SEC 60
+
+/* Config metadata of a project config other than the daemon's own */
+typedef struct apex_cli_daemon_config {
+    char *path;
+    apex_metadata_item *metadata;
+    struct apex_cli_daemon_config *next;
+} apex_cli_daemon_config;
+
+typedef struct {
+    apex_cli_batch *batch;
+    const char *meta_file;              /* --meta-file, merged into every config */
+    char *config_path;                  /* Project config the batch setup loaded */
+    apex_cli_daemon_config *configs;    /* Other project configs seen so far */
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    int *pending;                       /* Accepted connections not yet served */
+    size_t pending_count;
+    size_t pending_capacity;
+    size_t served;                      /* Documents converted, for status requests */
+} apex_cli_daemon;
+
+static char apex_cli_daemon_socket[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+/* Socket path: --socket, then $APEX_SOCKET, then a per-user default */
+static const char *apex_cli_socket_path(const char *explicit_path, char *buf, size_t size) {
+    if (explicit_path && *explicit_path) return explicit_path;
+    const char *env = getenv("APEX_SOCKET");
+    if (env && *env) return env;
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) {
+        snprintf(buf, size, "%s/apex.sock", runtime);
+    } else {
+        snprintf(buf, size, "/tmp/apex-%ld.sock", (long)getuid());
+    }
+    return buf;
+}
+
+static bool apex_cli_write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool apex_cli_read_all(int fd, void *data, size_t len) {
+    char *p = data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool apex_cli_send_frame(int fd, const char *data, size_t len) {
+    unsigned char header[4] = {
+        (unsigned char)(len >> 24), (unsigned char)(len >> 16),
+        (unsigned char)(len >> 8), (unsigned char)len
+    };
+    return len <= APEX_CLI_MAX_FRAME && apex_cli_write_all(fd, header, 4) &&
+           apex_cli_write_all(fd, data, len);
+}
+
+/* Returns a NUL-terminated frame of at most max bytes (free with free), or
+ * NULL on EOF or error */
+static char *apex_cli_recv_frame(int fd, size_t max, size_t *len) {
+    unsigned char header[4];
+    if (!apex_cli_read_all(fd, header, 4)) return NULL;
+    size_t n = ((size_t)header[0] << 24) | ((size_t)header[1] << 16) |
+               ((size_t)header[2] << 8) | (size_t)header[3];
+    if (n > max) return NULL;
+    char *data = malloc(n + 1);
+    if (!data) return NULL;
+    if (!apex_cli_read_all(fd, data, n)) {
+        free(data);
+        return NULL;
+    }
+    data[n] = '\0';
+    *len = n;
+    return data;
+}
+
+/* Parse a request header in place; returns an error message or NULL */
+static const char *apex_cli_parse_request(char *header, apex_cli_request *request) {
+    memset(request, 0, sizeof(*request));
+    request->standalone = -1;
+    request->pretty = -1;
+
+    char *save = NULL;
+    for (char *line = strtok_r(header, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        char *eq = strchr(line, '=');
+        if (!eq) return "malformed header";
+        *eq = '\0';
+        const char *value = eq + 1;
+        if (strcmp(line, "file") == 0) {
+            request->input_path = value;
+        } else if (strcmp(line, "cwd") == 0) {
+            request->cwd = value;
+        } else if (strcmp(line, "to") == 0) {
+            apex_options probe = apex_options_default();
+            if (!apex_cli_set_output_format(&probe, value)) return "unknown output format";
+            request->format = value;
+        } else if (strcmp(line, "standalone") == 0) {
+            request->standalone = atoi(value) != 0;
+        } else if (strcmp(line, "pretty") == 0) {
+            request->pretty = atoi(value) != 0;
+        } else if (strcmp(line, "title") == 0) {
+            request->title = value;
+        } else if (strcmp(line, "status") == 0) {
+            request->status = atoi(value) != 0;
+        } else {
+            return "unknown header key";
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Config metadata for a request, resolved as a single run in the client's
+ * directory would: from the client's working directory, the input file's
+ * directory and the git root (see apex_cli_batch_resolve_configs). NULL
+ * when that finds no config or the daemon's own. Each config file is
+ * loaded once.
+ */
+static apex_metadata_item *apex_cli_daemon_config_for(apex_cli_daemon *daemon,
+                                                      const apex_cli_request *request) {
+    const apex_cli_batch *batch = daemon->batch;
+    char *dir = request->input_path ? apex_cli_parent_dir(request->input_path) : NULL;
+    apex_options dir_options = batch->argv_options;
+    if (!batch->explicit_base_directory) dir_options.base_directory = dir;
+    const char *work_dir = request->cwd ? request->cwd : (dir ? dir : "/");
+    char *config = apex_cli_find_project_config_in(work_dir, &dir_options);
+    free(dir);
+    if (!config || (daemon->config_path && strcmp(config, daemon->config_path) == 0)) {
+        free(config);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&daemon->lock);
+    apex_cli_daemon_config *entry = daemon->configs;
+    while (entry && strcmp(entry->path, config) != 0) entry = entry->next;
+    if (!entry) {
+        entry = calloc(1, sizeof(*entry));
+        if (entry) {
+            entry->path = config;
+            config = NULL;
+            entry->metadata = apex_cli_load_config_metadata_at(entry->path, daemon->meta_file);
+            entry->next = daemon->configs;
+            daemon->configs = entry;
+        }
+    }
+    pthread_mutex_unlock(&daemon->lock);
+    free(config);
+    return entry ? entry->metadata : NULL;
+}
+
+/* Answer requests on one connection until the client hangs up */
+static void apex_cli_daemon_serve(apex_cli_daemon *daemon, int fd) {
+    for (;;) {
+        size_t header_len = 0;
+        size_t markdown_len = 0;
+        char *header = apex_cli_recv_frame(fd, APEX_CLI_MAX_HEADER, &header_len);
+        if (!header) break;
+        char *markdown = apex_cli_recv_frame(fd, APEX_CLI_MAX_FRAME, &markdown_len);
+        if (!markdown) {
+            free(header);
+            break;
+        }
+
+        apex_cli_request request;
+        const char *error = apex_cli_parse_request(header, &request);
+        char *output = NULL;
+        size_t output_len = 0;
+        if (!error && request.status) {
+            pthread_mutex_lock(&daemon->lock);
+            size_t served = daemon->served;
+            pthread_mutex_unlock(&daemon->lock);
+            output = malloc(64);
+            if (output) {
+                output_len = (size_t)snprintf(output, 64, "pid=%ld served=%zu\n", (long)getpid(), served);
+            } else {
+                error = "out of memory";
+            }
+        } else if (!error) {
+            apex_metadata_item *config_metadata = apex_cli_daemon_config_for(daemon, &request);
+            output = apex_cli_batch_convert(daemon->batch, markdown, markdown_len,
+                                            request.input_path, config_metadata, &request, &output_len);
+            if (!output) {
+                error = "conversion failed";
+            } else if (output_len > APEX_CLI_MAX_FRAME) {
+                error = "output too large";
+                apex_free_string(output);
+                output = NULL;
+            } else {
+                pthread_mutex_lock(&daemon->lock);
+                daemon->served++;
+                pthread_mutex_unlock(&daemon->lock);
+            }
+        }
+
+        char status[128];
+        snprintf(status, sizeof(status), error ? "error %s" : "ok", error);
+        bool sent = apex_cli_send_frame(fd, status, strlen(status)) &&
+                    apex_cli_send_frame(fd, output ? output : "", output ? output_len : 0);
+
+        apex_free_string(output);
+        free(markdown);
+        free(header);
+        if (!sent) break;
+    }
+}
+
+static void *apex_cli_daemon_worker(void *arg) {
+    apex_cli_daemon *daemon = (apex_cli_daemon *)arg;
+    for (;;) {
+        pthread_mutex_lock(&daemon->lock);
+        while (daemon->pending_count == 0) {
+            pthread_cond_wait(&daemon->ready, &daemon->lock);
+        }
+        int fd = daemon->pending[0];
+        memmove(daemon->pending, daemon->pending + 1, --daemon->pending_count * sizeof(int));
+        pthread_mutex_unlock(&daemon->lock);
+
+        apex_cli_daemon_serve(daemon, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+static bool apex_cli_daemon_enqueue(apex_cli_daemon *daemon, int fd) {
+    pthread_mutex_lock(&daemon->lock);
+    if (daemon->pending_count == daemon->pending_capacity) {
+        size_t cap = daemon->pending_capacity ? daemon->pending_capacity * 2 : 64;
+        int *tmp = realloc(daemon->pending, cap * sizeof(int));
+        if (!tmp) {
+            pthread_mutex_unlock(&daemon->lock);
+            return false;
+        }
+        daemon->pending = tmp;
+        daemon->pending_capacity = cap;
+    }
+    daemon->pending[daemon->pending_count++] = fd;
+    pthread_cond_signal(&daemon->ready);
+    pthread_mutex_unlock(&daemon->lock);
+    return true;
+}
+
+static void apex_cli_daemon_stop(int sig) {
+    (void)sig;
+    unlink(apex_cli_daemon_socket);
+    _exit(0);
+}
+
+/* Bind the listening socket, replacing a stale socket file */
+static int apex_cli_daemon_listen(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0) {
+        bool running = connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        close(probe);
+        if (running) {
+            fprintf(stderr, "Error: A daemon is already listening on %s\n", path);
+            return -1;
+        }
+    }
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot create socket: %s\n", strerror(errno));
+        return -1;
+    }
+    mode_t old_mask = umask(077);
+    int bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_mask);
+    if (bound != 0 || listen(fd, 64) != 0) {
+        fprintf(stderr, "Error: Cannot listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Run the conversion daemon on socket_path with jobs worker threads
+ * (0 = one per CPU). Only returns on a setup or accept error.
+ */
+static int apex_cli_run_daemon(apex_options *options, const char *socket_path, int jobs,
+                               const char *meta_file, apex_metadata_item *cmdline_metadata,
+                               const apex_cli_option_mask *mask,
+                               bool plugins_cli_override, bool plugins_cli_value,
+                               apex_render_cache *cache) {
+    apex_cli_batch batch;
+    if (!apex_cli_batch_setup(&batch, options, meta_file, cmdline_metadata, mask,
+                              plugins_cli_override, plugins_cli_value)) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return 1;
+    }
+    batch.cache = cache;
+
+    int listen_fd = apex_cli_daemon_listen(socket_path);
+    if (listen_fd < 0) {
+        apex_cli_batch_teardown(&batch);
+        return 1;
+    }
+    snprintf(apex_cli_daemon_socket, sizeof(apex_cli_daemon_socket), "%s", socket_path);
+    signal(SIGINT, apex_cli_daemon_stop);
+    signal(SIGTERM, apex_cli_daemon_stop);
+    signal(SIGPIPE, SIG_IGN);
+
+    apex_cli_daemon daemon = { .batch = &batch, .meta_file = meta_file };
+    daemon.config_path = apex_cli_find_project_config(options);
+    pthread_mutex_init(&daemon.lock, NULL);
+    pthread_cond_init(&daemon.ready, NULL);
+
+    if (jobs <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus > 0 ? (int)cpus : 1;
+    }
+    int started = 0;
+    for (; started < jobs; started++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, apex_cli_daemon_worker, &daemon) != 0) break;
+        pthread_detach(thread);
+    }
+    if (started == 0) {
+        fprintf(stderr, "Error: Cannot start worker threads\n");
+        close(listen_fd);
+        unlink(socket_path);
+        apex_cli_batch_teardown(&batch);
+        return 1;
+    }
+
+    fprintf(stderr, "apex: daemon listening on %s (%d workers)\n", socket_path, started);
+
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            fprintf(stderr, "Error: accept failed: %s\n", strerror(errno));
+            break;
+        }
+        /* Don't let an idle client hold a worker forever */
+        struct timeval timeout = { APEX_CLI_IDLE_TIMEOUT_SEC, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (!apex_cli_daemon_enqueue(&daemon, fd)) close(fd);
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    /* Detached workers may still hold connections; leave shared state to process exit */
+    return 1;
+}
+
+/**
+ * Open a temporary file beside output_file to write the output into. It
+ * replaces output_file only in apex_cli_output_commit() once everything
+ * was written, so a failed run leaves an existing file untouched. Returns
+ * NULL after printing an error.
+ */
+static FILE *apex_cli_output_open(const char *output_file, char **tmp_path_out) {
+    size_t path_len = strlen(output_file);
+    char *tmp_path = malloc(path_len + 8);
+    if (!tmp_path) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    memcpy(tmp_path, output_file, path_len);
+    memcpy(tmp_path + path_len, ".XXXXXX", 8);
+
+    int fd = mkstemp(tmp_path);
+    FILE *out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!out) {
+        fprintf(stderr, "Error: Cannot open output file '%s'\n", output_file);
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmp_path);
+        }
+        free(tmp_path);
+        return NULL;
+    }
+    /* mkstemp creates the file 0600; give it the mode fopen() would */
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd, 0666 & ~mask);
+    *tmp_path_out = tmp_path;
+    return out;
+}
+
+/**
+ * Close a file from apex_cli_output_open() and, if rc is 0 and the writes
+ * succeeded, move it over output_file; otherwise remove it. Frees
+ * tmp_path. Returns 0 on success, -1 after printing an error.
+ */
+static int apex_cli_output_commit(FILE *out, char *tmp_path, const char *output_file, int rc) {
+    bool write_failed = ferror(out) != 0;
+    if (fclose(out) != 0) write_failed = true;
+    if (rc == 0 && write_failed) {
+        fprintf(stderr, "Error: Cannot write output file '%s': %s\n", output_file, strerror(errno));
+        rc = -1;
+    }
+    if (rc == 0 && rename(tmp_path, output_file) != 0) {
+        fprintf(stderr, "Error: Cannot replace output file '%s': %s\n", output_file, strerror(errno));
+        rc = -1;
+    }
+    if (rc != 0) unlink(tmp_path);
+    free(tmp_path);
+    return rc;
+}
+
+/* Header values are single lines */
+static bool apex_cli_header_value_ok(const char *value) {
+    return !value || !strpbrk(value, "\r\n");
+}
+
+/**
+ * Thin client: forward the conversion to a running daemon when --socket or
+ * $APEX_SOCKET names one and the command line only uses options a request
+ * can carry. --daemon-status asks the daemon for its pid and the number of
+ * documents it has converted. Returns the exit code, or -1 to convert
+ * locally instead.
+ */
+static int apex_cli_run_client(int argc, char *argv[]) {
+    const char *socket_opt = NULL;
+    const char *input_file = NULL;
+    const char *output_file = NULL;
+    apex_cli_request request = { .standalone = -1, .pretty = -1 };
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(arg, "--socket") == 0 && has_value) {
+            socket_opt = argv[++i];
+        } else if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) && has_value) {
+            output_file = argv[++i];
+        } else if ((strcmp(arg, "-t") == 0 || strcmp(arg, "--to") == 0) && has_value) {
+            request.format = argv[++i];
+        } else if (strcmp(arg, "-s") == 0 || strcmp(arg, "--standalone") == 0) {
+            request.standalone = 1;
+        } else if (strcmp(arg, "--pretty") == 0) {
+            request.pretty = 1;
+        } else if (strcmp(arg, "--title") == 0 && has_value) {
+            request.title = argv[++i];
+        } else if (strcmp(arg, "--daemon-status") == 0) {
+            request.status = true;
+        } else if (arg[0] != '-' && !input_file) {
+            input_file = arg;
+        } else {
+            /* Anything else needs the full local command line handling */
+            return -1;
+        }
+    }
+
+    const char *env = getenv("APEX_SOCKET");
+    if (!socket_opt && !(env && *env) && !request.status) return -1;
+    if (!apex_cli_header_value_ok(request.format) || !apex_cli_header_value_ok(request.title)) return -1;
+    if (request.format) {
+        apex_options probe = apex_options_default();
+        if (!apex_cli_set_output_format(&probe, request.format)) return -1;
+        /* Terminal output depends on the client's terminal */
+        if (probe.output_format == APEX_OUTPUT_TERMINAL ||
+            probe.output_format == APEX_OUTPUT_TERMINAL256) {
+            return -1;
+        }
+    }
+
+    char path_buf[PATH_MAX];
+    const char *socket_path = apex_cli_socket_path(socket_opt, path_buf, sizeof(path_buf));
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) return -1;
+    strcpy(addr.sun_path, socket_path);
+
+    /* The daemon resolves paths, so send them absolute. Paths it can't be
+     * sent (line breaks) or inputs over the frame limit convert locally. */
+    char resolved[PATH_MAX];
+    char cwd[PATH_MAX];
+    bool have_cwd = false;
+    if (request.status) {
+        input_file = NULL;
+    } else if (input_file) {
+        struct stat st;
+        if (!realpath(input_file, resolved) || !apex_cli_header_value_ok(resolved) ||
+            stat(resolved, &st) != 0 || (size_t)st.st_size > APEX_CLI_MAX_FRAME) {
+            return -1;
+        }
+    }
+    /* The daemon looks for the project config from here, as a local run would */
+    if (!request.status && getcwd(cwd, sizeof(cwd))) {
+        if (!apex_cli_header_value_ok(cwd)) return -1;
+        have_cwd = true;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        if (request.status) {
+            fprintf(stderr, "Error: No daemon listening on %s\n", socket_path);
+            return 1;
+        }
+        /* No daemon running: convert locally */
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    size_t input_len = 0;
+    char *markdown;
+    if (request.status) {
+        markdown = strdup("");
+    } else if (input_file) {
+        markdown = read_file(input_file, &input_len);
+    } else {
+        markdown = read_stdin(&input_len);
+    }
+    if (!markdown) {
+        close(fd);
+        return input_file ? -1 : 1;
+    }
+    if (input_len > APEX_CLI_MAX_FRAME) {
+        /* stdin is consumed, so it can't be handed to a local conversion */
+        fprintf(stderr, "Error: Input is larger than the daemon accepts (%zu MB)\n",
+                APEX_CLI_MAX_FRAME >> 20);
+        free(markdown);
+        close(fd);
+        return 1;
+    }
+
+    size_t header_cap = 3 * PATH_MAX + (request.title ? strlen(request.title) : 0) + 128;
+    char *header = malloc(header_cap);
+    int rc = 1;
+    if (header) {
+        size_t n = 0;
+        if (request.status) {
+            n += (size_t)snprintf(header + n, header_cap - n, "status=1\n");
+        } else if (input_file) {
+            n += (size_t)snprintf(header + n, header_cap - n, "file=%s\n", resolved);
+        }
+        if (have_cwd) n += (size_t)snprintf(header + n, header_cap - n, "cwd=%s\n", cwd);
+        if (request.format) n += (size_t)snprintf(header + n, header_cap - n, "to=%s\n", request.format);
+        if (request.standalone >= 0) n += (size_t)snprintf(header + n, header_cap - n, "standalone=1\n");
+        if (request.pretty >= 0) n += (size_t)snprintf(header + n, header_cap - n, "pretty=1\n");
+        if (request.title) n += (size_t)snprintf(header + n, header_cap - n, "title=%s\n", request.title);
+
+        size_t status_len = 0;
+        size_t output_len = 0;
+        char *status = NULL;
+        char *output = NULL;
+        if (n <= APEX_CLI_MAX_HEADER && apex_cli_send_frame(fd, header, n) &&
+            apex_cli_send_frame(fd, markdown, input_len) &&
+            (status = apex_cli_recv_frame(fd, APEX_CLI_MAX_HEADER, &status_len)) != NULL &&
+            (output = apex_cli_recv_frame(fd, APEX_CLI_MAX_FRAME, &output_len)) != NULL) {
+            if (strcmp(status, "ok") == 0) {
+                if (output_file && !request.status) {
+                    /* Same temporary file and rename as a local -o */
+                    char *tmp_path = NULL;
+                    FILE *fp = apex_cli_output_open(output_file, &tmp_path);
+                    if (fp) {
+                        fwrite(output, 1, output_len, fp);
+                        rc = apex_cli_output_commit(fp, tmp_path, output_file, 0) == 0 ? 0 : 1;
+                    }
+                } else {
+                    rc = fwrite(output, 1, output_len, stdout) == output_len ? 0 : 1;
+                    if (rc != 0) fprintf(stderr, "Error: Cannot write output: %s\n", strerror(errno));
+                }
+            } else {
+                fprintf(stderr, "Error: daemon: %s\n",
+                        strncmp(status, "error ", 6) == 0 ? status + 6 : status);
+            }
+        } else {
+            fprintf(stderr, "Error: Lost connection to daemon at %s\n", socket_path);
+        }
+        free(status);
+        free(output);
+        free(header);
+    }
+
+    free(markdown);
+    close(fd);
+    return rc;
+}
+
+/* Parse a byte count with an optional K, M or G suffix */
+static bool apex_cli_parse_size(const char *text, size_t *out) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (errno != 0 || end == text) return false;
+    unsigned long long scale = 1;
+    switch (*end) {
+        case 'k': case 'K': scale = 1024ULL; end++; break;
+        case 'm': case 'M': scale = 1024ULL * 1024; end++; break;
+        case 'g': case 'G': scale = 1024ULL * 1024 * 1024; end++; break;
+        default: break;
+    }
+    if (*end == 'B' || *end == 'b') end++;
+    if (*end != '\0' || value > SIZE_MAX / scale) return false;
+    *out = (size_t)(value * scale);
+    return true;
+}
+
+static void apex_cli_print_cache_stats(apex_render_cache *cache) {
+    if (!cache) return;
+    apex_render_cache_stats stats;
+    apex_render_cache_get_stats(cache, &stats);
+    fprintf(stderr, "Cache: %zu hits, %zu misses, %zu not cacheable, %zu stored, %zu evicted\n",
+            stats.hits, stats.misses, stats.bypassed, stats.stores, stats.evictions);
+}
+
+/* apex_write_fn for a stdio stream. The progress line is cleared, and
+ * kept off, once output starts so it can't land in the middle of it. */
+static int apex_cli_write_stream(void *user_data, const char *data, size_t len) {
+    if (progress_enabled) {
+        clear_progress();
+        progress_enabled = false;
+    }
+    return fwrite(data, 1, len, (FILE *)user_data) == len ? 0 : -1;
+}
+
+/* Stream a conversion into output_file through a temporary file.
+ * Returns 0 on success, -1 after printing an error. */
+static int apex_cli_stream_to_file(const char *output_file, const char *markdown, size_t len,
+                                   const apex_options *options) {
+    char *tmp_path = NULL;
+    FILE *out = apex_cli_output_open(output_file, &tmp_path);
+    if (!out) return -1;
+    int rc = apex_markdown_to_sink(markdown, len, options, apex_cli_write_stream, out);
+    return apex_cli_output_commit(out, tmp_path, output_file, rc);
+}
+
+int main(int argc, char *argv[]) {
+    /* Hand the conversion to a running daemon when one is configured */
+    int client_rc = apex_cli_run_client(argc, argv);
+    if (client_rc >= 0) {
+        return client_rc;
+    }
+
+    /* Initialize progress reporting */
+    init_progress();
+
+    apex_options options = apex_options_default();
+    apex_options cli_options_snapshot;
+    apex_cli_option_mask cli_opt_mask = {0};
+    bool plugins_cli_override = false;
+    bool plugins_cli_value = false;
+    bool list_plugins = false;
+    bool list_themes = false;
+    bool cli_info = false;
+    bool cli_extract_meta = false;
+    const char *extract_meta_value_key = NULL;
+    const char *install_plugin_id = NULL;
+    const char *uninstall_plugin_id = NULL;
+    bool list_filters = false;
+    const char *uninstall_filter_id = NULL;
+
+    /* Filter install (AST filters) */
+    const char *install_filter_id = NULL;
+    const char *input_file = NULL;
+    const char *output_file = NULL;
+    const char *meta_file = NULL;
+    apex_metadata_item *cmdline_metadata = NULL;
+    char *allocated_base_dir = NULL;      /* Track if we allocated base_directory */
+    char *allocated_input_file_path = NULL;  /* Track if we allocate input_file_path */
+
+    /* Combine mode: concatenate Markdown files (with includes expanded) */
+    bool combine_mode = false;
+    char **combine_files = NULL;
+    size_t combine_file_count = 0;
+    size_t combine_file_capacity = 0;
+
+    /* mmd-merge mode: emulate MultiMarkdown mmd_merge.pl behavior */
+    bool mmd_merge_mode = false;
+    char **mmd_merge_files = NULL;
+    size_t mmd_merge_file_count = 0;
+    size_t mmd_merge_file_capacity = 0;
+
+    /* Batch mode: every positional input converted into --output-dir */
+    const char *batch_output_dir = NULL;
+    int batch_jobs = 0;                   /* --jobs; 0 = one per CPU */
+    int parse_threads = 0;                /* --parse-threads; 0 = serial parse */
+
+    /* Render cache: reuse earlier output for unchanged inputs */
+    const char *cache_dir = NULL;
+    size_t cache_size = 0;                /* --cache-size; 0 = library default */
+    bool cache_stats = false;
+
+    bool profile_json = false;            /* --profile-json: stage statistics to stderr */
+
+    /* Daemon mode: serve conversions over a Unix socket */
+    bool daemon_mode = false;
+    const char *socket_path = NULL;       /* --socket; also used by the thin client */
+    char **batch_inputs = NULL;
+    size_t batch_input_count = 0;
+    size_t batch_input_capacity = 0;
+
+    /* Bibliography files (NULL-terminated array) */
+    char **bibliography_files = NULL;
+    size_t bibliography_count = 0;
+    size_t bibliography_capacity = 4;
+
+    /* Stylesheet files (NULL-terminated array) */
+    char **stylesheet_files = NULL;
+    size_t stylesheet_count = 0;
+    size_t stylesheet_capacity = 4;
+
+    /* Script tags (NULL-terminated array of raw <script> HTML snippets) */
+    char **script_tags = NULL;
+    size_t script_tag_count = 0;
+    size_t script_tag_capacity = 4;
+
+    /* AST filters (Pandoc-style JSON filters) configured from CLI */
+    char   **ast_filter_names = NULL;   /* Filter names from --filter (resolved in config dir) */
+    size_t   ast_filter_name_count = 0;
+    size_t   ast_filter_name_capacity = 4;
+    bool     run_all_filters_dir = false;  /* --filters */
+    bool     ast_filters_strict = true;    /* default strict mode; --no-strict-filters disables */
+
+    /* Lua filters: explicit script paths run via 'lua <script>' */
+    char   **lua_filter_paths = NULL;
+    size_t   lua_filter_count = 0;
+    size_t   lua_filter_capacity = 4;
+
+    /* Optional fixed-width wrapping for terminal output */
+    int width_override = 0;
+
+    /* Pagination for terminal/terminal256 output */
+    bool paginate_cli = false;
+    bool paginate_symbols_cli = false;
+    bool no_paginate_cli = false;
+
+    /* Terminal inline images: --no-terminal-images / --terminal-image-width N */
+    bool no_terminal_images_cli = false;
+    int terminal_image_width_cli = -1; /* -1 = use options default */
+
+    /* Parse command-line arguments */
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--version") == 0) {
+            print_version();
+            return 0;
+        } else if (strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--info") == 0) {
+            cli_info = true;
+        } else if (strcmp(argv[i], "--extract-meta") == 0) {
+            cli_extract_meta = true;
+        } else if (strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "--extract-meta-value") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "Error: --extract-meta-value requires a KEY argument\n");
+                return 1;
+            }
+            extract_meta_value_key = argv[i];
+        } else if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--mode") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "Error: --mode requires an argument\n");
+                return 1;
+            }
+            cli_opt_mask.mode = true;
+            if (strcmp(argv[i], "commonmark") == 0) {
+                options = apex_options_for_mode(APEX_MODE_COMMONMARK);
+            } else if (strcmp(argv[i], "gfm") == 0) {
+                options = apex_options_for_mode(APEX_MODE_GFM);
+            } else if (strcmp(argv[i], "mmd") == 0 || strcmp(argv[i], "multimarkdown") == 0) {
+                options = apex_options_for_mode(APEX_MODE_MULTIMARKDOWN);
+            } else if (strcmp(argv[i], "kramdown") == 0) {
+                options = apex_options_for_mode(APEX_MODE_KRAMDOWN);
+            } else if (strcmp(argv[i], "unified") == 0) {
+                options = apex_options_for_mode(APEX_MODE_UNIFIED);
+            } else if (strcmp(argv[i], "quarto") == 0) {
+                options = apex_options_for_mode(APEX_MODE_QUARTO);
+            } else {
+                fprintf(stderr, "Error: Unknown mode '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--to") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "Error: --to requires an argument\n");
+                return 1;
+            }
+            cli_opt_mask.output_format = true;
+            if (strcmp(argv[i], "xhtml") == 0 || strcmp(argv[i], "strict-xhtml") == 0) {
+                cli_opt_mask.xhtml = true;
+                cli_opt_mask.strict_xhtml = true;
+            }
+            if (!apex_cli_set_output_format(&options, argv[i])) {
                 fprintf(stderr, "Error: Unknown output format '%s'\n", argv[i]);
                 fprintf(stderr, "Supported formats: html, xhtml, strict-xhtml, json, json-filtered/ast-json/ast, markdown/md, mmd, commonmark/cmark, kramdown, gfm, terminal/cli, terminal256, man, man-html, toc, rtf\n");
                 return 1;
@@ -2212,6 +3838,59 @@ int main(int argc, char *argv[]) {
                 return 1;
             }
             output_file = argv[i];
+        } else if (strcmp(argv[i], "--output-dir") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "Error: --output-dir requires an argument\n");
+                return 1;
+            }
+            batch_output_dir = argv[i];
+        } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "Error: --jobs requires an argument\n");
+                return 1;
+            }
+            batch_jobs = atoi(argv[i]);
+            if (batch_jobs < 1) {
+                fprintf(stderr, "Error: --jobs must be at least 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--daemon") == 0) {
+            daemon_mode = true;
+        } else if (strcmp(argv[i], "--socket") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "Error: --socket requires an argument\n");
+                return 1;
+            }
+            socket_path = argv[i];
+        } else if (strcmp(argv[i], "--cache-dir") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "Error: --cache-dir requires an argument\n");
+                return 1;
+            }
+            cache_dir = argv[i];
+        } else if (strcmp(argv[i], "--cache-size") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "Error: --cache-size requires an argument\n");
+                return 1;
+            }
+            if (!apex_cli_parse_size(argv[i], &cache_size) || cache_size == 0) {
+                fprintf(stderr, "Error: Invalid --cache-size '%s' (use bytes, or a K, M or G suffix)\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--cache-stats") == 0) {
+            cache_stats = true;
+        } else if (strcmp(argv[i], "--profile-json") == 0) {
+            profile_json = true;
+        } else if (strcmp(argv[i], "--parse-threads") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "Error: --parse-threads requires an argument\n");
+                return 1;
+            }
+            parse_threads = atoi(argv[i]);
+            if (parse_threads < 1) {
+                fprintf(stderr, "Error: --parse-threads must be at least 1\n");
+                return 1;
+            }
         } else if (strcmp(argv[i], "--plugins") == 0) {
             cli_opt_mask.enable_plugins = true;
             options.enable_plugins = true;
@@ -2820,6 +4499,13 @@ int main(int argc, char *argv[]) {
             cli_opt_mask.bibliography = true;
             bibliography_files[bibliography_count++] = argv[i];
             options.enable_citations = true;  /* Enable citations when bibliography is provided */
+        } else if (strcmp(argv[i], "--bibliography-cache") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "Error: --bibliography-cache requires an argument\n");
+                return 1;
+            }
+            cli_opt_mask.bibliography_cache_dir = true;
+            options.bibliography_cache_dir = argv[i];
         } else if (strcmp(argv[i], "--csl") == 0) {
             if (++i >= argc) {
                 fprintf(stderr, "Error: --csl requires an argument\n");
@@ -2915,8 +4601,20 @@ int main(int argc, char *argv[]) {
                 }
                 mmd_merge_files[mmd_merge_file_count++] = argv[i];
             } else {
-                /* Single-file mode: last positional wins (for compatibility) */
+                /* Single-file mode: last positional wins (for compatibility).
+                 * All of them are kept for batch mode (--output-dir). */
                 input_file = argv[i];
+                if (batch_input_count >= batch_input_capacity) {
+                    size_t new_cap = batch_input_capacity ? batch_input_capacity * 2 : 8;
+                    char **tmp = realloc(batch_inputs, new_cap * sizeof(char *));
+                    if (!tmp) {
+                        fprintf(stderr, "Error: Memory allocation failed\n");
+                        return 1;
+                    }
+                    batch_inputs = tmp;
+                    batch_input_capacity = new_cap;
+                }
+                batch_inputs[batch_input_count++] = argv[i];
             }
         }
     }
@@ -2932,6 +4630,25 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    /* --jobs only applies to batch and daemon mode */
+    if (batch_jobs > 0 && !batch_output_dir && !daemon_mode) {
+        fprintf(stderr, "Error: --jobs requires --output-dir or --daemon\n");
+        return 1;
+    }
+    if (daemon_mode && (batch_output_dir || batch_input_count > 0 || combine_mode ||
+                        mmd_merge_mode || output_file)) {
+        fprintf(stderr, "Error: --daemon takes no input files and cannot be used with --output-dir, --combine, --mmd-merge or --output\n");
+        return 1;
+    }
+    if (batch_output_dir && (combine_mode || mmd_merge_mode || output_file)) {
+        fprintf(stderr, "Error: --output-dir cannot be used with --combine, --mmd-merge or --output\n");
+        return 1;
+    }
+    if (batch_output_dir && batch_input_count == 0) {
+        fprintf(stderr, "Error: --output-dir requires at least one input file or directory\n");
+        return 1;
+    }
+
     /* --combine and --mmd-merge are mutually exclusive */
     if (combine_mode && mmd_merge_mode) {
         fprintf(stderr, "Error: --combine and --mmd-merge cannot be used together\n");
@@ -3786,296 +5503,98 @@ int main(int argc, char *argv[]) {
 
     /* mmd-merge mode: emulate MultiMarkdown mmd_merge.pl and exit */
     if (mmd_merge_mode) {
-        FILE *out = stdout;
-        if (output_file) {
-            out = fopen(output_file, "w");
-            if (!out) {
-                fprintf(stderr, "Error: Cannot open output file '%s'\n", output_file);
-                return 1;
-            }
-        }
-
-        if (mmd_merge_file_count == 0) {
-            fprintf(stderr, "Error: --mmd-merge requires at least one index file\n");
-            if (out != stdout) fclose(out);
-            return 1;
-        }
-
-        if (cli_info) {
-            apex_cli_print_info(stderr, &options, plugins_cli_override, plugins_cli_value, meta_file, cmdline_metadata);
-        }
-
-        int rc = 0;
-        for (size_t i = 0; i < mmd_merge_file_count; i++) {
-            const char *path = mmd_merge_files[i];
-            if (!path) continue;
-            if (apex_cli_mmd_merge_index(path, out) != 0) {
-                rc = 1;
-                break;
-            }
-        }
-
-        if (out != stdout) {
-            fclose(out);
-        }
-        return rc;
-    }
-
-    /* Combine mode: concatenate Markdown files (with includes expanded) and exit */
-    if (combine_mode) {
-        FILE *out = stdout;
-        if (output_file) {
-            out = fopen(output_file, "w");
-            if (!out) {
-                fprintf(stderr, "Error: Cannot open output file '%s'\n", output_file);
-                return 1;
-            }
-        }
-
-        if (cli_info) {
-            apex_cli_print_info(stderr, &options, plugins_cli_override, plugins_cli_value, meta_file, cmdline_metadata);
-        }
-
-        int rc = 0;
-        bool needs_separator = false;
-
-        for (size_t i = 0; i < combine_file_count; i++) {
-            const char *path = combine_files[i];
-            if (!path) continue;
-
-            /* Detect GitBook SUMMARY.md by basename */
-            char *path_copy = strdup(path);
-            if (!path_copy) {
-                rc = 1;
-                break;
-            }
-            char *base = basename(path_copy);
-            bool is_summary = (base && strcasecmp(base, "SUMMARY.md") == 0);
-
-            if (is_summary) {
-                if (apex_cli_combine_from_summary(path, out) != 0) {
-                    rc = 1;
-                    free(path_copy);
-                    break;
-                }
-                /* SUMMARY already handles its own separation */
-                needs_separator = true;
-            } else {
-                char *processed = apex_cli_combine_process_file(path);
-                if (!processed) {
-                    fprintf(stderr, "Warning: Skipping unreadable file '%s'\n", path);
-                } else {
-                    apex_cli_write_combined_chunk(out, processed, &needs_separator);
-                    free(processed);
-                }
-            }
-
-            free(path_copy);
-        }
-
-        if (out != stdout) {
-            fclose(out);
-        }
-        return rc;
-    }
-
-    /* Set base_directory from input file if not already set */
-    if (input_file && !options.base_directory) {
-        char *input_path_copy = strdup(input_file);
-        if (input_path_copy) {
-            char *dir = dirname(input_path_copy);
-            if (dir && dir[0] != '\0' && strcmp(dir, ".") != 0) {
-                allocated_base_dir = strdup(dir);
-                options.base_directory = allocated_base_dir;
-            }
-            free(input_path_copy);
-        }
-    }
-
-    if (cli_info && input_file && !combine_mode && !mmd_merge_mode) {
-        apex_cli_print_info(stderr, &options, plugins_cli_override, plugins_cli_value, meta_file, cmdline_metadata);
-    }
-
-    /* Set input_file_path for plugins (APEX_FILE_PATH) */
-    if (input_file) {
-        /* When a file is provided, use the original path (as passed in) */
-        options.input_file_path = input_file;
-    } else {
-        /* When reading from stdin:
-         * - Prefer an explicit base_directory, if set.
-         * - Otherwise, leave input_file_path empty (plugins see APEX_FILE_PATH="").
-         */
-        if (options.base_directory && options.base_directory[0] != '\0') {
-            options.input_file_path = options.base_directory;
-        } else {
-            options.input_file_path = NULL;
-        }
-    }
-
-    /* Read input */
-    size_t input_len;
-    char *markdown;
-
-    PROFILE_START(cli_total);
-    if (input_file) {
-        markdown = read_file(input_file, &input_len);
-    } else {
-        PROFILE_START(stdin_read);
-        markdown = read_stdin(&input_len);
-        PROFILE_END(stdin_read);
-    }
-
-    if (!markdown) {
-        if (cmdline_metadata) apex_free_metadata(cmdline_metadata);
-        return 1;
-    }
-
-    /* Load metadata from:
-     *   - Global config:   $XDG_CONFIG_HOME/apex/config.yml or ~/.config/apex/config.yml
-     *   - Project config:  .apex/config.yml (CWD/base_directory/git root)
-     *   - Explicit --meta-file (if provided)
-     *
-     * These are merged (global < project < explicit) and then merged with
-     * document metadata and command-line metadata below.
-     */
-    PROFILE_START(metadata_file_load);
-    apex_metadata_item *file_metadata = NULL;
-    apex_metadata_item *global_config_meta = NULL;
-    apex_metadata_item *project_config_meta = NULL;
-    apex_metadata_item *explicit_file_meta = NULL;
-
-    char *global_config_path = apex_cli_find_global_config();
-    char *project_config_path = apex_cli_find_project_config(&options);
-
-    if (global_config_path) {
-        global_config_meta = apex_load_metadata_from_file(global_config_path);
-        if (!global_config_meta) {
-            fprintf(stderr, "Warning: Could not load metadata from global config '%s'\n", global_config_path);
-        }
-    }
-
-    if (project_config_path) {
-        project_config_meta = apex_load_metadata_from_file(project_config_path);
-        if (!project_config_meta) {
-            fprintf(stderr, "Warning: Could not load metadata from project config '%s'\n", project_config_path);
-        }
-    }
-
-    if (meta_file) {
-        explicit_file_meta = apex_load_metadata_from_file(meta_file);
-        if (!explicit_file_meta) {
-            fprintf(stderr, "Warning: Could not load metadata from file '%s'\n", meta_file);
-        }
-    }
-
-    if (global_config_meta || project_config_meta || explicit_file_meta) {
-        file_metadata = apex_merge_metadata(
-            global_config_meta,
-            project_config_meta,
-            explicit_file_meta,
-            NULL
-        );
-    }
-
-    if (global_config_meta) apex_free_metadata(global_config_meta);
-    if (project_config_meta) apex_free_metadata(project_config_meta);
-    if (explicit_file_meta) apex_free_metadata(explicit_file_meta);
-    if (global_config_path) free(global_config_path);
-    if (project_config_path) free(project_config_path);
+        FILE *out = stdout;
+        if (output_file) {
+            out = fopen(output_file, "w");
+            if (!out) {
+                fprintf(stderr, "Error: Cannot open output file '%s'\n", output_file);
+                return 1;
+            }
+        }
 
-    PROFILE_END(metadata_file_load);
+        if (mmd_merge_file_count == 0) {
+            fprintf(stderr, "Error: --mmd-merge requires at least one index file\n");
+            if (out != stdout) fclose(out);
+            return 1;
+        }
 
-    /* Extract document metadata to merge with external sources
-     * We'll extract it here and then inject the merged result */
-    PROFILE_START(metadata_extract_cli);
-    apex_metadata_item *doc_metadata = NULL;
-    size_t doc_metadata_end = 0;
+        if (cli_info) {
+            apex_cli_print_info(stderr, &options, plugins_cli_override, plugins_cli_value, meta_file, cmdline_metadata);
+        }
 
-    if (options.mode == APEX_MODE_MULTIMARKDOWN ||
-        options.mode == APEX_MODE_KRAMDOWN ||
-        apex_mode_is_unified_family(options.mode)) {
-        /* Make a copy to extract metadata without modifying original */
-        char *doc_copy = malloc(input_len + 1);
-        if (doc_copy) {
-            memcpy(doc_copy, markdown, input_len);
-            doc_copy[input_len] = '\0';
-            char *doc_ptr = doc_copy;
-            doc_metadata = apex_extract_metadata(&doc_ptr);
-            if (doc_metadata) {
-                /* Calculate where metadata ended in original */
-                doc_metadata_end = doc_ptr - doc_copy;
+        int rc = 0;
+        for (size_t i = 0; i < mmd_merge_file_count; i++) {
+            const char *path = mmd_merge_files[i];
+            if (!path) continue;
+            if (apex_cli_mmd_merge_index(path, out) != 0) {
+                rc = 1;
+                break;
             }
-            free(doc_copy);
         }
-    }
-    PROFILE_END(metadata_extract_cli);
 
-    /* Merge metadata in priority order: file -> document -> command-line */
-    PROFILE_START(metadata_merge);
-    apex_metadata_item *merged_metadata = NULL;
-    if (file_metadata || doc_metadata || cmdline_metadata) {
-        merged_metadata = apex_merge_metadata(
-            file_metadata,
-            doc_metadata,
-            cmdline_metadata,
-            NULL
-        );
+        if (out != stdout) {
+            fclose(out);
+        }
+        return rc;
     }
-    PROFILE_END(metadata_merge);
-
-    /* Build enhanced markdown with merged metadata as YAML front matter */
-    PROFILE_START(metadata_yaml_build);
-    char *enhanced_markdown = NULL;
-    size_t enhanced_len = input_len;
 
-    if (merged_metadata) {
-        bool has_existing_metadata = (doc_metadata_end > 0);
-        size_t metadata_start_pos = 0;
-        size_t metadata_end_pos = doc_metadata_end;
+    /* Combine mode: concatenate Markdown files (with includes expanded) and exit */
+    if (combine_mode) {
+        FILE *out = stdout;
+        if (output_file) {
+            out = fopen(output_file, "w");
+            if (!out) {
+                fprintf(stderr, "Error: Cannot open output file '%s'\n", output_file);
+                return 1;
+            }
+        }
 
-        char *yaml_buf = NULL;
-        size_t yaml_sz = 0;
-        FILE *ym = open_memstream(&yaml_buf, &yaml_sz);
-        if (ym) {
-            fprintf(ym, "---\n");
-            apex_metadata_fprint_yaml_mapping(ym, merged_metadata);
-            fprintf(ym, "---\n");
-            fclose(ym);
+        if (cli_info) {
+            apex_cli_print_info(stderr, &options, plugins_cli_override, plugins_cli_value, meta_file, cmdline_metadata);
         }
 
-        if (yaml_buf && yaml_sz > 0) {
-            size_t yaml_pos = yaml_sz;
+        int rc = 0;
+        bool needs_separator = false;
 
-            if (has_existing_metadata) {
-                /* Replace existing metadata */
-                size_t before_len = metadata_start_pos;
-                size_t after_len = input_len - metadata_end_pos;
-                enhanced_len = before_len + yaml_pos + after_len;
-                enhanced_markdown = malloc(enhanced_len + 1);
-                if (enhanced_markdown) {
-                    if (before_len > 0) {
-                        memcpy(enhanced_markdown, markdown, before_len);
-                    }
-                    memcpy(enhanced_markdown + before_len, yaml_buf, yaml_pos);
-                    if (after_len > 0) {
-                        memcpy(enhanced_markdown + before_len + yaml_pos, markdown + metadata_end_pos, after_len);
-                    }
-                    enhanced_markdown[enhanced_len] = '\0';
+        for (size_t i = 0; i < combine_file_count; i++) {
+            const char *path = combine_files[i];
+            if (!path) continue;
+
+            /* Detect GitBook SUMMARY.md by basename */
+            char *path_copy = strdup(path);
+            if (!path_copy) {
+                rc = 1;
+                break;
+            }
+            char *base = basename(path_copy);
+            bool is_summary = (base && strcasecmp(base, "SUMMARY.md") == 0);
+
+            if (is_summary) {
+                if (apex_cli_combine_from_summary(path, out) != 0) {
+                    rc = 1;
+                    free(path_copy);
+                    break;
                 }
+                /* SUMMARY already handles its own separation */
+                needs_separator = true;
             } else {
-                /* Prepend metadata */
-                enhanced_len = yaml_pos + input_len;
-                enhanced_markdown = malloc(enhanced_len + 1);
-                if (enhanced_markdown) {
-                    memcpy(enhanced_markdown, yaml_buf, yaml_pos);
-                    memcpy(enhanced_markdown + yaml_pos, markdown, input_len);
-                    enhanced_markdown[enhanced_len] = '\0';
+                char *processed = apex_cli_combine_process_file(path);
+                if (!processed) {
+                    fprintf(stderr, "Warning: Skipping unreadable file '%s'\n", path);
+                } else {
+                    apex_cli_write_combined_chunk(out, processed, &needs_separator);
+                    free(processed);
                 }
             }
-            free(yaml_buf);
+
+            free(path_copy);
+        }
+
+        if (out != stdout) {
+            fclose(out);
         }
+        return rc;
     }
-    PROFILE_END(metadata_yaml_build);
 
     /* Set bibliography files in options (NULL-terminated array) */
     if (bibliography_count > 0) {
@@ -4096,20 +5615,6 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    /* Apply metadata to options - allows per-document control of command-line options */
-    /* Note: Bibliography file loading from metadata will be handled in citations extension */
-    if (merged_metadata) {
-        /* Snapshot argv-resolved options after wiring bibliography/stylesheet; merged metadata must not override explicit CLI flags. */
-        cli_options_snapshot = options;
-        apex_apply_metadata_to_options(merged_metadata, &options);
-        apex_cli_restore_argv_options(&options, &cli_options_snapshot, &cli_opt_mask);
-    }
-
-    /* Re-apply explicit CLI override for plugins so it wins over metadata. */
-    if (plugins_cli_override) {
-        options.enable_plugins = plugins_cli_value;
-    }
-
     /* Resolve AST filters configured from CLI into absolute command paths.
      * Filters live in $XDG_CONFIG_HOME/apex/filters or ~/.config/apex/filters.
      */
@@ -4348,6 +5853,124 @@ int main(int argc, char *argv[]) {
         options.script_tags = script_tags;
     }
 
+    /* Applied last so a later --mode doesn't reset it */
+    if (parse_threads > 0) {
+        options.parse_threads = parse_threads;
+    }
+
+    apex_render_cache *render_cache = NULL;
+    if (cache_dir) {
+        render_cache = apex_render_cache_open(cache_dir, cache_size);
+        if (!render_cache) {
+            fprintf(stderr, "Warning: Cannot use cache directory '%s'; converting without cache\n", cache_dir);
+        }
+    }
+
+    /* Daemon mode: keep this setup warm and serve conversions until stopped */
+    if (daemon_mode) {
+        char socket_buf[PATH_MAX];
+        int rc = apex_cli_run_daemon(&options,
+                                     apex_cli_socket_path(socket_path, socket_buf, sizeof(socket_buf)),
+                                     batch_jobs, meta_file, cmdline_metadata, &cli_opt_mask,
+                                     plugins_cli_override, plugins_cli_value, render_cache);
+        free(batch_inputs);
+        if (cmdline_metadata) apex_free_metadata(cmdline_metadata);
+        apex_render_cache_close(render_cache);
+        return rc;
+    }
+
+    /* Batch mode: convert every input into --output-dir and exit */
+    if (batch_output_dir) {
+        int rc = apex_cli_run_batch(&options, batch_inputs, batch_input_count,
+                                    batch_output_dir, batch_jobs, meta_file,
+                                    cmdline_metadata, &cli_opt_mask,
+                                    plugins_cli_override, plugins_cli_value, render_cache,
+                                    profile_json);
+        free(batch_inputs);
+        if (cmdline_metadata) apex_free_metadata(cmdline_metadata);
+        if (cache_stats) apex_cli_print_cache_stats(render_cache);
+        apex_render_cache_close(render_cache);
+        return rc;
+    }
+
+    /* Set base_directory from input file if not already set */
+    if (input_file && !options.base_directory) {
+        char *input_path_copy = strdup(input_file);
+        if (input_path_copy) {
+            char *dir = dirname(input_path_copy);
+            if (dir && dir[0] != '\0' && strcmp(dir, ".") != 0) {
+                allocated_base_dir = strdup(dir);
+                options.base_directory = allocated_base_dir;
+            }
+            free(input_path_copy);
+        }
+    }
+
+    if (cli_info && input_file && !combine_mode && !mmd_merge_mode) {
+        apex_cli_print_info(stderr, &options, plugins_cli_override, plugins_cli_value, meta_file, cmdline_metadata);
+    }
+
+    /* Set input_file_path for plugins (APEX_FILE_PATH) */
+    if (input_file) {
+        /* When a file is provided, use the original path (as passed in) */
+        options.input_file_path = input_file;
+    } else {
+        /* When reading from stdin:
+         * - Prefer an explicit base_directory, if set.
+         * - Otherwise, leave input_file_path empty (plugins see APEX_FILE_PATH="").
+         */
+        if (options.base_directory && options.base_directory[0] != '\0') {
+            options.input_file_path = options.base_directory;
+        } else {
+            options.input_file_path = NULL;
+        }
+    }
+
+    /* Read input */
+    size_t input_len;
+    char *markdown;
+
+    PROFILE_START(cli_total);
+    if (input_file) {
+        markdown = read_file(input_file, &input_len);
+    } else {
+        PROFILE_START(stdin_read);
+        markdown = read_stdin(&input_len);
+        PROFILE_END(stdin_read);
+    }
+
+    if (!markdown) {
+        if (cmdline_metadata) apex_free_metadata(cmdline_metadata);
+        return 1;
+    }
+
+    /* Load metadata from global config, project config and --meta-file */
+    apex_metadata_item *file_metadata = apex_cli_load_config_metadata(&options, meta_file);
+
+    /* Extract document metadata and merge it with the external sources,
+     * injecting the result as YAML front matter */
+    apex_metadata_item *doc_metadata = NULL;
+    apex_metadata_item *merged_metadata = NULL;
+    size_t enhanced_len = input_len;
+    char *enhanced_markdown = apex_cli_inject_metadata(markdown, input_len, options.mode,
+                                                       file_metadata, cmdline_metadata,
+                                                       &doc_metadata, &merged_metadata,
+                                                       &enhanced_len);
+
+    /* Apply metadata to options - allows per-document control of command-line options */
+    /* Note: Bibliography file loading from metadata will be handled in citations extension */
+    if (merged_metadata) {
+        /* Snapshot argv-resolved options after wiring bibliography/stylesheet; merged metadata must not override explicit CLI flags. */
+        cli_options_snapshot = options;
+        apex_apply_metadata_to_options(merged_metadata, &options);
+        apex_cli_restore_argv_options(&options, &cli_options_snapshot, &cli_opt_mask);
+    }
+
+    /* Re-apply explicit CLI override for plugins so it wins over metadata. */
+    if (plugins_cli_override) {
+        options.enable_plugins = plugins_cli_value;
+    }
+
     /* Use enhanced markdown if we created it, otherwise use original */
     char *final_markdown = enhanced_markdown ? enhanced_markdown : markdown;
     size_t final_len = enhanced_markdown ? enhanced_len : input_len;
@@ -4384,8 +6007,34 @@ int main(int argc, char *argv[]) {
         options.paginate_symbols = false;
     }
 
-    /* Convert to output (HTML, Markdown, terminal, etc.) */
-    char *html = apex_markdown_to_html(final_markdown, final_len, &options);
+    bool is_terminal_output = (options.output_format == APEX_OUTPUT_TERMINAL ||
+                               options.output_format == APEX_OUTPUT_TERMINAL256);
+
+    /* Convert to output (HTML, Markdown, terminal, etc.). Everything but
+     * terminal output, which may be wrapped or paged, is written as it is
+     * produced instead of being collected in one string first. */
+    char *html = NULL;
+    bool streamed = false;
+    int stream_rc = 0;
+    apex_stats profile_stats;
+    if (profile_json) options.stats = &profile_stats;
+    if (render_cache) {
+        html = apex_render_cache_convert(render_cache, NULL, final_markdown, final_len, &options);
+    } else if (is_terminal_output) {
+        html = apex_markdown_to_html(final_markdown, final_len, &options);
+    } else {
+        if (output_file) {
+            stream_rc = apex_cli_stream_to_file(output_file, final_markdown, final_len, &options);
+        } else {
+            stream_rc = apex_markdown_to_sink(final_markdown, final_len, &options,
+                                              apex_cli_write_stream, stdout);
+            if (stream_rc == 0 && fflush(stdout) != 0) stream_rc = -1;
+        }
+        streamed = true;
+    }
+    if (profile_json && (streamed ? stream_rc == 0 : html != NULL)) {
+        apex_cli_print_profile(input_file, &profile_stats);
+    }
 
     /* Check if we should show delayed progress (in case processing took > 1s but no progress was shown) */
     if (progress_enabled) {
@@ -4406,13 +6055,11 @@ int main(int argc, char *argv[]) {
     if (cmdline_metadata) apex_free_metadata(cmdline_metadata);
     if (merged_metadata) apex_free_metadata(merged_metadata);
 
-    if (!html) {
+    if (streamed ? stream_rc != 0 : !html) {
         fprintf(stderr, "Error: Conversion failed\n");
         return 1;
     }
 
-    bool is_terminal_output = (options.output_format == APEX_OUTPUT_TERMINAL ||
-                               options.output_format == APEX_OUTPUT_TERMINAL256);
     size_t html_len = 0;
     if (html) {
         html_len = is_terminal_output ? apex_terminal_output_length() : strlen(html);
@@ -4468,7 +6115,9 @@ int main(int argc, char *argv[]) {
 
     /* Write output (optionally via pager) */
     PROFILE_START(file_write);
-    if (paginate_effective) {
+    if (streamed) {
+        /* Already written during conversion */
+    } else if (paginate_effective) {
         const char *pager_cmd = getenv("APEX_PAGER");
         if (!pager_cmd || !*pager_cmd) {
             pager_cmd = getenv("PAGER");
@@ -4504,6 +6153,9 @@ int main(int argc, char *argv[]) {
 
     apex_free_string(html);
 
+    if (cache_stats) apex_cli_print_cache_stats(render_cache);
+    apex_render_cache_close(render_cache);
+
     /* Free bibliography files array */
     if (bibliography_files) {
         free(bibliography_files);
@@ -14,6 +14,7 @@ extern "C" {
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "ast_terminal.h"
 #ifndef CMARK_GFM_H
 typedef struct cmark_node cmark_node;
@@ -111,6 +112,37 @@ bool apex_plugin_register(apex_plugin_manager *manager, const char *id, apex_plu
 
 struct cmark_parser;  /* Opaque; for cmark_init callback. Include cmark-gfm when implementing. */
 
+/**
+ * Measurements for one pipeline stage (a preprocessor, parsing, rendering,
+ * a postprocessor, ...). A stage that runs more than once in a conversion
+ * has its numbers added up.
+ */
+typedef struct {
+    const char *name;          /* Stage name, e.g. "parsing" (static string) */
+    size_t calls;              /* Times the stage ran */
+    uint64_t elapsed_ns;       /* Monotonic clock time spent in the stage */
+    size_t bytes_in;           /* Size of the text handed to the stage */
+    size_t bytes_out;          /* Size of the text it produced (bytes_in if it left the text as is) */
+    size_t cmark_allocations;  /* Allocations made through the cmark allocator (not Apex's own) */
+    uint64_t subprocess_ns;    /* Time spent in external commands started by the stage */
+} apex_stage_stats;
+
+#define APEX_STATS_MAX_STAGES 128
+
+/**
+ * Statistics for one conversion; see apex_options.stats
+ */
+typedef struct {
+    uint64_t elapsed_ns;       /* Whole conversion */
+    size_t bytes_in;           /* Markdown length */
+    size_t bytes_out;          /* Output length */
+    size_t cmark_allocations;  /* Allocations made through the cmark allocator (not Apex's own) */
+    uint64_t subprocess_ns;    /* Plugins, AST filters and syntax highlighters */
+    size_t subprocesses;       /* External commands started */
+    size_t stage_count;        /* Entries used in stages, in the order they first ran */
+    apex_stage_stats stages[APEX_STATS_MAX_STAGES];
+} apex_stats;
+
 /**
  * Configuration options for the parser and renderer
  */
@@ -235,6 +267,7 @@ typedef struct apex_options {
     bool link_citations;  /* Link citations to bibliography entries */
     bool show_tooltips;  /* Show tooltips on citations */
     const char *nocite;  /* Comma-separated citation keys to include without citing, or "*" for all */
+    const char *bibliography_cache_dir;  /* Directory for parsed-bibliography cache files, or NULL to parse every time */
 
     /* Index options */
     bool enable_indices;  /* Enable index processing */
@@ -290,6 +323,14 @@ typedef struct apex_options {
     bool title_from_h1;                 /* Use first H1 as document title fallback */
     bool page_break_before_footnotes;   /* Insert page break before footnotes section */
 
+    /* Parallel parsing */
+    /* Documents larger than a few chunks are split in front of top-level
+     * headings and the pieces are parsed, block and inline phase, on up
+     * to parse_threads threads. Rendering runs once on the merged tree.
+     * Output is identical to a serial parse; documents that can't be split
+     * safely (or that use footnotes) are parsed serially. 0 or 1 disables. */
+    int parse_threads;
+
     /* Source file information for plugins */
     /* When Apex is invoked on a file, this is the full path to that file. */
     /* When reading from stdin, this is either the base directory (if set) or empty. */
@@ -314,6 +355,12 @@ typedef struct apex_options {
     void (*progress_callback)(const char *stage, int percent, void *user_data);
     void *progress_user_data;  /* User data passed to progress callback */
 
+    /* Conversion statistics (normally NULL). When set, each conversion
+     * overwrites *stats with per-stage timings, sizes and cmark allocation counts.
+     * Leaving it NULL costs nothing. Don't share one apex_stats between
+     * conversions running at the same time. */
+    apex_stats *stats;
+
     /* Custom cmark extension registration callback */
     /* Called after Apex registers its built-in extensions, before parsing.
      * Use this to attach custom cmark-gfm syntax extensions via
@@ -350,6 +397,9 @@ apex_options apex_options_for_mode(apex_mode_t mode);
 /**
  * Main conversion function: Markdown to HTML
  *
+ * Reentrant: conversions may run on several threads at once, as long as
+ * no thread modifies the options while another is reading them.
+ *
  * @param markdown Input markdown text
  * @param len Length of input text
  * @param options Processing options (NULL for defaults)
@@ -357,6 +407,224 @@ apex_options apex_options_for_mode(apex_mode_t mode);
  */
 char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options *options);
 
+/**
+ * Reusable converter for many documents with the same options
+ *
+ * apex_markdown_to_html() sets everything up from scratch on every call:
+ * plugin discovery, cmark syntax extensions, bibliography files and the
+ * syntax highlighter lookup. A converter does that once in
+ * apex_converter_new() and reuses it for every apex_converter_convert().
+ *
+ * The options are copied, but strings and arrays they point to must stay
+ * valid for the life of the converter. Plugins, bibliography files and the
+ * highlighter are resolved at creation time, so later changes on disk are
+ * not picked up.
+ *
+ * A converter is read-only after creation: one converter may be shared by
+ * several threads calling apex_converter_convert() at the same time.
+ */
+typedef struct apex_converter apex_converter;
+
+/**
+ * Create a converter
+ *
+ * @param options Processing options (NULL for defaults)
+ * @return New converter (free with apex_converter_free), or NULL on error
+ */
+apex_converter *apex_converter_new(const apex_options *options);
+
+/**
+ * Convert markdown with a converter's options
+ *
+ * @return Newly allocated HTML string (must be freed with apex_free_string)
+ */
+char *apex_converter_convert(const apex_converter *converter, const char *markdown, size_t len);
+
+/**
+ * Convert markdown with per-document options, reusing what the converter
+ * loaded at creation (plugins, syntax extensions, bibliography files and
+ * the highlighter lookup). Meant for options that only differ per
+ * document, such as input_file_path.
+ *
+ * Resources set up from fields that differ are loaded for the document
+ * instead: plugins when base_directory or the plugin settings differ, the
+ * bibliography when base_directory or bibliography_files differ, and the
+ * tables extension when per_cell_alignment differs, and the highlighter
+ * is looked up again when code_highlighter differs.
+ *
+ * @param options Processing options for this document (NULL for the converter's)
+ * @return Newly allocated HTML string (must be freed with apex_free_string)
+ */
+char *apex_converter_convert_with_options(const apex_converter *converter,
+                                          const char *markdown, size_t len,
+                                          const apex_options *options);
+
+/**
+ * Free a converter
+ */
+void apex_converter_free(apex_converter *converter);
+
+/**
+ * Output sink for streaming conversions
+ *
+ * Called with consecutive pieces of the output, in order. Return 0 to
+ * continue, or nonzero to stop; the conversion then reports an error.
+ */
+typedef int (*apex_write_fn)(void *user_data, const char *data, size_t len);
+
+/**
+ * Convert markdown and write the output through a sink instead of
+ * returning it as one string
+ *
+ * Only the end of the pipeline streams. Parsing, rendering and the HTML
+ * post-processing stages run over the whole document as in
+ * apex_markdown_to_html(), so nothing is written until the body is
+ * rendered and the rendered body is held in memory in full. After that
+ * the final clean-up passes run a segment at a time, and the head, each
+ * body segment and the footer are written as soon as they are finished,
+ * so a standalone page is never assembled in one buffer. Pretty-printed
+ * HTML and the other output formats are written in a single call once
+ * converted. The output is the same as apex_markdown_to_html().
+ *
+ * @param options Processing options (NULL for defaults)
+ * @return 0 on success, -1 if the conversion failed or the sink stopped it
+ */
+int apex_markdown_to_sink(const char *markdown, size_t len, const apex_options *options,
+                          apex_write_fn write, void *user_data);
+
+/**
+ * Convert markdown and write the output to a file descriptor
+ *
+ * @return 0 on success, -1 on failure (errno is set when a write failed)
+ */
+int apex_markdown_to_fd(const char *markdown, size_t len, const apex_options *options, int fd);
+
+/**
+ * Streaming form of apex_converter_convert_with_options()
+ *
+ * @param options Processing options for this document (NULL for the converter's)
+ * @return 0 on success, -1 if the conversion failed or the sink stopped it
+ */
+int apex_converter_convert_to_sink(const apex_converter *converter,
+                                   const char *markdown, size_t len,
+                                   const apex_options *options,
+                                   apex_write_fn write, void *user_data);
+
+/**
+ * Incremental rendering session for a document that is edited and
+ * re-rendered repeatedly (an editor preview, for example).
+ *
+ * The session splits the document in front of top-level headings and
+ * keeps the HTML of every section. Each apex_session_render() converts only
+ * the sections that changed since the previous call and splices in the
+ * cached HTML for the rest, so render time follows the size of the edit
+ * rather than the size of the document. The result is the same as
+ * apex_markdown_to_html() on the whole text.
+ *
+ * Reference and abbreviation definitions are prepended to every section,
+ * so editing one re-renders all sections. The table of contents, footnote
+ * numbers and the bibliography are rebuilt from what each section
+ * reports, and a section is converted again when what it depends on from
+ * the rest of the document changes. Documents with metadata, inline
+ * footnotes or abbreviations, index entries, critic markup or attribute
+ * list definitions, and options that post-process the whole output
+ * (standalone, pretty, plugins, AST filters, non-HTML formats) are
+ * converted in full on every call.
+ *
+ * A session is not thread-safe; use one per document.
+ */
+typedef struct apex_session apex_session;
+
+/**
+ * Create a session
+ *
+ * @param options Processing options (NULL for defaults); copied like apex_converter_new()
+ * @return New session (free with apex_session_free), or NULL on error
+ */
+apex_session *apex_session_new(const apex_options *options);
+
+/**
+ * Render the current text of the document
+ *
+ * @return Newly allocated HTML string (must be freed with apex_free_string)
+ */
+char *apex_session_render(apex_session *session, const char *markdown, size_t len);
+
+/**
+ * Number of conversions the last apex_session_render() ran: the sections
+ * that were re-rendered, plus one if the whole document was converted.
+ */
+size_t apex_session_last_rendered(const apex_session *session);
+
+/**
+ * Free a session
+ */
+void apex_session_free(apex_session *session);
+
+/**
+ * On-disk cache of conversion results, for builds that convert the same
+ * documents over and over (a static site generator, for example).
+ *
+ * Entries are addressed by a hash of the input, the options (compared by
+ * value; strings and arrays by content) and the Apex version. Each entry
+ * also lists the files the conversion read: includes, embedded images and
+ * stylesheets, bibliographies. A lookup checks them with stat() and only
+ * hashes a file again when its size or modification time changed.
+ *
+ * Conversions that depend on anything else are never cached: plugins, AST
+ * filters, cmark callbacks, toc_entries_out, stats and terminal output.
+ *
+ * Threads and processes may share a cache directory. Entries are written
+ * to a temporary file and renamed into place, and the least recently used
+ * entries are removed once the cache grows past its size limit.
+ */
+typedef struct apex_render_cache apex_render_cache;
+
+typedef struct {
+    size_t hits;
+    size_t misses;
+    size_t bypassed;    /* Conversions that can't be cached */
+    size_t stores;      /* Entries written */
+    size_t evictions;   /* Entries removed to stay under the size limit */
+} apex_render_cache_stats;
+
+/**
+ * Open (and create if needed) a cache directory
+ *
+ * @param max_bytes Size limit for the directory (0 for the default, 256 MB)
+ * @return Cache handle (close with apex_render_cache_close), or NULL if
+ *         the directory can't be created
+ */
+apex_render_cache *apex_render_cache_open(const char *directory, size_t max_bytes);
+
+/**
+ * Return the cached output for this input and options, or convert and
+ * store it
+ *
+ * @param converter Converter to use on a miss, or NULL for apex_markdown_to_html()
+ * @param options Processing options (NULL for the converter's, or defaults)
+ * @return Newly allocated output string (must be freed with apex_free_string)
+ */
+char *apex_render_cache_convert(apex_render_cache *cache, const apex_converter *converter,
+                                const char *markdown, size_t len, const apex_options *options);
+
+/**
+ * Counters for the lookups made through this handle
+ */
+void apex_render_cache_get_stats(apex_render_cache *cache, apex_render_cache_stats *stats);
+
+/**
+ * Close a cache handle; the directory is left in place
+ */
+void apex_render_cache_close(apex_render_cache *cache);
+
+/**
+ * Format conversion statistics as a JSON object
+ * @param stats Statistics filled by a conversion (see apex_options.stats)
+ * @return JSON text (must be freed with apex_free_string), or NULL on error
+ */
+char *apex_stats_to_json(const apex_stats *stats);
+
 /**
  * Collect document headings as a flat array of TOC entries.
  * Honors id_format, min/max levels, and .no_toc the same as -t toc.
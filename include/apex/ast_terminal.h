@@ -33,7 +33,8 @@ char *apex_cmark_to_terminal(cmark_node *document,
                              bool use_256);
 
 /**
- * Byte length of the most recent apex_cmark_to_terminal() result.
+ * Byte length of the most recent apex_cmark_to_terminal() result on the
+ * calling thread.
  * Use instead of strlen() because inline image escape sequences may contain NUL bytes.
  */
 size_t apex_terminal_output_length(void);
@@ -6,7 +6,8 @@
 #include <ctype.h>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <sys/time.h>
+#include <errno.h>
+#include <pthread.h>
 
 /* cmark-gfm headers */
 #include "cmark-gfm.h"
@@ -47,6 +48,15 @@
 #include "extensions/index.h"
 #include "extensions/fenced_divs.h"
 #include "extensions/syntax_highlight.h"
+#include "extensions/hashtags.h"
+#include "extensions/proofreader.h"
+#include "preprocess.h"
+#include "feature_scan.h"
+#include "chunk_split.h"
+#include "parser_lock.h"
+#include "render_cache.h"
+#include "stats.h"
+#include "html_rewriter.h"
 #include "plugins.h"
 #include "ast_json.h"
 #include "apex/ast_markdown.h"
@@ -57,6 +67,7 @@
 
 /* Custom renderer */
 #include "html_renderer.h"
+#include "section_summary.h"
 
 /**
  * Encode a string as hexadecimal HTML entities (&#xNN;)
@@ -567,6 +578,7 @@ static char *apex_embed_images(const char *html, const apex_options *options, co
                             char *resolved_path = apex_resolve_local_image_path(url, base_directory);
                             if (resolved_path) {
                                 struct stat st;
+                                apex_render_cache_note_file(resolved_path);
                                 if (stat(resolved_path, &st) == 0 && S_ISREG(st.st_mode)) {
                                     char *encoded = apex_read_and_encode_image(resolved_path);
                                     if (encoded) {
@@ -3011,6 +3023,7 @@ apex_options apex_options_default(void) {
     opts.bibliography_files = NULL;
     opts.csl_file = NULL;
     opts.suppress_bibliography = false;
+    opts.bibliography_cache_dir = NULL;
     opts.link_citations = false;
     opts.show_tooltips = false;
     opts.nocite = NULL;
@@ -3058,6 +3071,9 @@ apex_options apex_options_default(void) {
     opts.title_from_h1 = false;
     opts.page_break_before_footnotes = false;
 
+    /* Parallel parsing (off by default) */
+    opts.parse_threads = 0;
+
     /* Source file information (used by plugins via APEX_FILE_PATH) */
     opts.input_file_path = NULL;
 
@@ -3070,6 +3086,9 @@ apex_options apex_options_default(void) {
     opts.progress_callback = NULL;
     opts.progress_user_data = NULL;
 
+    /* Statistics */
+    opts.stats = NULL;
+
     /* Custom cmark extension callback */
     opts.cmark_init = NULL;
     opts.cmark_done = NULL;
@@ -3350,9 +3369,78 @@ static int apex_to_cmark_options(const apex_options *options) {
 /**
  * Register cmark-gfm extensions based on Apex options
  */
-static void apex_register_extensions(cmark_parser *parser, const apex_options *options) {
-    /* Ensure core extensions are registered */
+/**
+ * Reusable conversion handle (see apex_converter_new). Everything here is
+ * set up once and shared read-only by every conversion on the handle.
+ */
+struct apex_converter {
+    apex_options options;
+    apex_plugin_manager *plugins;             /* NULL when plugins are off or none found */
+    cmark_syntax_extension *math_ext;
+    cmark_syntax_extension *footnotes_ext;
+    cmark_syntax_extension *tables_ext;
+    apex_bibliography_registry *bibliography; /* Loaded from options.bibliography_files */
+    apex_metadata_cache *metadata_cache;      /* Parsed [%key] references */
+    bool highlighter_available;
+};
+
+static bool apex_same_string(const char *a, const char *b) {
+    if (!a || !b) return a == b;
+    return strcmp(a, b) == 0;
+}
+
+static bool apex_same_string_list(char **a, char **b) {
+    if (!a || !b) return a == b;
+    size_t i = 0;
+    for (; a[i] && b[i]; i++) {
+        if (strcmp(a[i], b[i]) != 0) return false;
+    }
+    return !a[i] && !b[i];
+}
+
+/* A document converted with options other than the converter's shares
+ * only what was set up from fields that are the same for both; anything
+ * else is loaded for that document as in a one-shot conversion. */
+static bool apex_converter_shares_plugins(const apex_converter *converter, const apex_options *options) {
+    const apex_options *own = &converter->options;
+    return options == own ||
+           (options->enable_plugins == own->enable_plugins &&
+            options->allow_external_plugin_detection == own->allow_external_plugin_detection &&
+            options->plugin_register == own->plugin_register &&
+            apex_same_string(options->base_directory, own->base_directory));
+}
+
+static bool apex_converter_shares_bibliography(const apex_converter *converter, const apex_options *options) {
+    const apex_options *own = &converter->options;
+    return options == own ||
+           (apex_same_string(options->base_directory, own->base_directory) &&
+            apex_same_string_list(options->bibliography_files, own->bibliography_files));
+}
+
+static bool apex_converter_shares_tables(const apex_converter *converter, const apex_options *options) {
+    return options->per_cell_alignment == converter->options.per_cell_alignment;
+}
+
+static bool apex_converter_shares_highlighter(const apex_converter *converter, const apex_options *options) {
+    return apex_same_string(options->code_highlighter, converter->options.code_highlighter);
+}
+
+/* cmark's core extension registration isn't guarded against concurrent
+ * first use, so route every caller through pthread_once */
+static pthread_once_t core_extensions_once = PTHREAD_ONCE_INIT;
+
+static void register_core_extensions(void) {
     cmark_gfm_core_extensions_ensure_registered();
+}
+
+static void apex_ensure_core_extensions(void) {
+    pthread_once(&core_extensions_once, register_core_extensions);
+}
+
+static void apex_register_extensions(cmark_parser *parser, const apex_options *options,
+                                     const apex_converter *converter) {
+    /* Ensure core extensions are registered */
+    apex_ensure_core_extensions();
 
     /* Note: Metadata is handled via preprocessing, not as an extension */
 
@@ -3401,7 +3489,8 @@ static void apex_register_extensions(cmark_parser *parser, const apex_options *o
 
     /* Math support (LaTeX) */
     if (options->enable_math) {
-        cmark_syntax_extension *math_ext = create_math_extension();
+        cmark_syntax_extension *math_ext = (converter && converter->math_ext) ? converter->math_ext
+                                                                              : create_math_extension();
         if (math_ext) {
             cmark_parser_attach_syntax_extension(parser, math_ext);
         }
@@ -3411,7 +3500,9 @@ static void apex_register_extensions(cmark_parser *parser, const apex_options *o
 
     /* Advanced footnotes (block-level content support) */
     if (options->enable_footnotes) {
-        cmark_syntax_extension *adv_footnotes_ext = create_advanced_footnotes_extension();
+        cmark_syntax_extension *adv_footnotes_ext = (converter && converter->footnotes_ext)
+                                                      ? converter->footnotes_ext
+                                                      : create_advanced_footnotes_extension();
         if (adv_footnotes_ext) {
             cmark_parser_attach_syntax_extension(parser, adv_footnotes_ext);
         }
@@ -3419,37 +3510,160 @@ static void apex_register_extensions(cmark_parser *parser, const apex_options *o
 
     /* Advanced tables (colspan, rowspan, captions) */
     if (options->enable_tables) {
-        cmark_syntax_extension *adv_tables_ext = create_advanced_tables_extension(options->per_cell_alignment);
+        cmark_syntax_extension *adv_tables_ext = (converter && converter->tables_ext &&
+                                                  apex_converter_shares_tables(converter, options))
+                                                   ? converter->tables_ext
+                                                   : create_advanced_tables_extension(options->per_cell_alignment);
         if (adv_tables_ext) {
             cmark_parser_attach_syntax_extension(parser, adv_tables_ext);
         }
     }
 }
 
+/* Smallest piece worth handing to its own thread */
+#define APEX_PARSE_CHUNK_MIN (8 * 1024)
+
+typedef struct {
+    char *text;                        /* Reference definitions + chunk source */
+    size_t len;
+    const apex_options *options;
+    const apex_converter *converter;
+    int cmark_opts;
+    cmark_parser *parser;              /* Fed parser, NULL on failure */
+} apex_parse_chunk_job;
+
+/* Block parsing of one chunk; the inline phase runs later, for all chunks
+ * at once, in apex_parsers_finish */
+static void *apex_parse_chunk_worker(void *arg) {
+    apex_parse_chunk_job *job = (apex_parse_chunk_job *)arg;
+    cmark_parser *parser = cmark_parser_new(job->cmark_opts);
+    if (!parser) return NULL;
+    apex_register_extensions(parser, job->options, job->converter);
+    cmark_parser_feed(parser, job->text, job->len);
+    job->parser = parser;
+    return NULL;
+}
+
 /**
- * Main conversion function using cmark-gfm
+ * Parse text in chunks on options->parse_threads threads and merge the
+ * chunk documents into one tree.
+ *
+ * Each chunk is block-parsed on its own thread, then all chunks run their
+ * inline phase concurrently through apex_parsers_finish, which keeps the
+ * shared trigger tables installed until the last chunk is done. Rendering
+ * and the HTML stages still see one merged document.
+ *
+ * The first chunk goes through the caller's parser, so the extensions the
+ * renderer later takes from it are unchanged. Returns NULL when the text
+ * can't be split safely; the caller then parses it in one piece.
  */
-/* Profiling helpers */
-static double get_time_ms(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+static cmark_node *apex_parse_chunked(cmark_parser *parser, const char *text, size_t len,
+                                      const apex_options *options, const apex_converter *converter,
+                                      int cmark_opts) {
+    apex_chunk_plan plan;
+    if (!apex_plan_chunks(text, len, (size_t)options->parse_threads, APEX_PARSE_CHUNK_MIN, &plan)) {
+        return NULL;
+    }
+
+    apex_parse_chunk_job *jobs = calloc(plan.count, sizeof(apex_parse_chunk_job));
+    pthread_t *threads = calloc(plan.count, sizeof(pthread_t));
+    bool *started = calloc(plan.count, sizeof(bool));
+    cmark_parser **parsers = calloc(plan.count, sizeof(cmark_parser *));
+    cmark_node **documents = calloc(plan.count, sizeof(cmark_node *));
+    cmark_node *document = NULL;
+    bool failed = !jobs || !threads || !started || !parsers || !documents;
+
+    for (size_t i = 0; !failed && i < plan.count; i++) {
+        size_t start = plan.offsets[i];
+        size_t end = (i + 1 < plan.count) ? plan.offsets[i + 1] : len;
+        jobs[i].len = plan.refdefs_len + (end - start);
+        jobs[i].text = malloc(jobs[i].len + 1);
+        if (!jobs[i].text) {
+            failed = true;
+            break;
+        }
+        if (plan.refdefs_len) memcpy(jobs[i].text, plan.refdefs, plan.refdefs_len);
+        memcpy(jobs[i].text + plan.refdefs_len, text + start, end - start);
+        jobs[i].text[jobs[i].len] = '\0';
+        jobs[i].options = options;
+        jobs[i].converter = converter;
+        jobs[i].cmark_opts = cmark_opts;
+    }
+
+    if (!failed) {
+        for (size_t i = 1; i < plan.count; i++) {
+            started[i] = pthread_create(&threads[i], NULL, apex_parse_chunk_worker, &jobs[i]) == 0;
+            if (!started[i]) apex_parse_chunk_worker(&jobs[i]);
+        }
+
+        cmark_parser_feed(parser, jobs[0].text, jobs[0].len);
+
+        for (size_t i = 1; i < plan.count; i++) {
+            if (started[i]) pthread_join(threads[i], NULL);
+        }
+
+        parsers[0] = parser;
+        for (size_t i = 1; i < plan.count; i++) {
+            parsers[i] = jobs[i].parser;
+            if (!parsers[i]) failed = true;
+        }
+
+        if (failed) {
+            /* The caller's parser is still fed, so it can't be reused */
+            documents[0] = apex_parser_finish(parser);
+        } else if (!apex_parsers_finish(parsers, documents, plan.count)) {
+            failed = true;
+        }
+        document = documents[0];
+    }
+
+    /* Move every chunk's top-level blocks to the end of the first document */
+    for (size_t i = 1; documents && i < plan.count; i++) {
+        cmark_node *chunk_doc = documents[i];
+        if (!chunk_doc) continue;
+        if (document && !failed) {
+            cmark_node *child;
+            while ((child = cmark_node_first_child(chunk_doc)) != NULL) {
+                cmark_node_unlink(child);
+                cmark_node_append_child(document, child);
+            }
+        }
+        cmark_node_free(chunk_doc);
+    }
+
+    if (failed && document) {
+        cmark_node_free(document);
+        document = NULL;
+    }
+
+    for (size_t i = 0; jobs && i < plan.count; i++) {
+        if (jobs[i].parser) cmark_parser_free(jobs[i].parser);
+        free(jobs[i].text);
+    }
+    free(jobs);
+    free(threads);
+    free(started);
+    free(parsers);
+    free(documents);
+    apex_chunk_plan_free(&plan);
+    return document;
 }
 
+/* APEX_PROFILE=1 prints the statistics of every conversion to stderr */
 static bool profiling_enabled(void) {
     const char *env = getenv("APEX_PROFILE");
     return env && (strcmp(env, "1") == 0 || strcmp(env, "yes") == 0 || strcmp(env, "true") == 0);
 }
 
-#define PROFILE_START(name) \
-    double name##_start = 0; \
-    if (profiling_enabled()) { name##_start = get_time_ms(); }
+/* Stage statistics, recorded into `prof` (options->stats) when it is set.
+ * input is the text the stage starts from and output the text it produced,
+ * either of which may be NULL (see apex_stats_stage_begin/end). */
+#define PROFILE_START(name, input) \
+    apex_stats_timer name##_timer; \
+    if (prof) apex_stats_stage_begin(&name##_timer, prof, #name, (input))
 
-#define PROFILE_END(name) \
-    if (profiling_enabled()) { \
-        double name##_elapsed = get_time_ms() - name##_start; \
-        fprintf(stderr, "[PROFILE] %-30s: %8.2f ms\n", #name, name##_elapsed); \
-    }
+#define PROFILE_END(name, output) \
+    if (prof) apex_stats_stage_end(&name##_timer, (output))
 
 /* Progress reporting helper macro */
 #define PROGRESS_REPORT(stage, percent) \
@@ -3459,182 +3673,177 @@ static bool profiling_enabled(void) {
         } \
     } while (0)
 
+/*
+ * Post-render tag stages. These are registered on the single-pass HTML
+ * rewriter (html_rewriter.h) so enabled fix-ups share one walk over the
+ * rendered document.
+ */
+
+/**
+ * Replace <hr> elements with Marked-style page break divs.
+ */
+static const char apex_hr_pagebreak_html[] =
+    "<div class=\"mkpagebreak manualbreak\" "
+    "title=\"Page break created from HR\" "
+    "data-description=\"PAGE (HR)\" "
+    "style=\"page-break-after:always\">"
+    "<span style=\"display:none\">&nbsp;</span></div>";
+
+static void apex_hr_pagebreak_tag(void *state, const apex_html_tag *tag, apex_html_rewriter *rw) {
+    (void)state;
+    if (tag->closing) return;
+    apex_html_rewriter_replace(rw, apex_hr_pagebreak_html, sizeof(apex_hr_pagebreak_html) - 1);
+}
+
 /**
  * Add 'poetry' class to code blocks without a language class.
  * Handles both fenced code blocks (<pre><code class="language-X">) and
  * indented code blocks (<pre><code>).
- * Returns a newly allocated string, or NULL on error.
+ *
+ * A <code> counts when it directly follows a bare <pre>, as the old
+ * "<pre><code" string match required. Unlike that match, each block is
+ * decided by its own class attribute (the old search for "language-"
+ * ran on past the tag, so a later language block suppressed poetry on
+ * every plain block before it), and markup inside comments, scripts and
+ * styles is left alone.
  */
-static char *apex_add_poetry_class_to_code_blocks(const char *html) {
-    if (!html) return NULL;
+typedef struct {
+    size_t pre_end;  /* Source offset just past the last bare <pre> */
+} apex_poetry_state;
 
-    size_t len = strlen(html);
-    size_t capacity = len * 2 + 1;
-    char *output = malloc(capacity);
-    if (!output) return NULL;
-
-    const char *read = html;
-    char *write = output;
-    size_t remaining = capacity;
+static void apex_poetry_pre_tag(void *state, const apex_html_tag *tag, apex_html_rewriter *rw) {
+    apex_poetry_state *st = (apex_poetry_state *)state;
+    (void)rw;
+    if (!tag->closing && tag->len == 5) {
+        st->pre_end = tag->end;
+    }
+}
 
-    while (*read) {
-        /* Look for <pre><code pattern */
-        const char *pre_code = strstr(read, "<pre><code");
-        if (!pre_code) {
-            /* Copy the rest */
-            size_t tail_len = strlen(read);
-            if (tail_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + tail_len + 1) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, read, tail_len);
-            write += tail_len;
-            remaining -= tail_len;
-            break;
-        }
+static void apex_poetry_code_tag(void *state, const apex_html_tag *tag, apex_html_rewriter *rw) {
+    apex_poetry_state *st = (apex_poetry_state *)state;
+    if (tag->closing || tag->offset != st->pre_end) return;
 
-        /* Copy up to the <pre><code */
-        size_t chunk_len = (size_t)(pre_code - read);
-        if (chunk_len >= remaining) {
-            size_t written = (size_t)(write - output);
-            capacity = (written + chunk_len + 100) * 2;
-            char *new_output = realloc(output, capacity);
-            if (!new_output) {
-                free(output);
-                return NULL;
-            }
-            output = new_output;
-            write = output + written;
-            remaining = capacity - written;
+    /* Check if this code block has a language class */
+    size_t class_len = 0;
+    const char *class_value = apex_html_tag_attr(tag, "class", &class_len);
+    if (class_value) {
+        for (size_t i = 0; i + 9 <= class_len; i++) {
+            if (memcmp(class_value + i, "language-", 9) == 0) return;
         }
-        memcpy(write, read, chunk_len);
-        write += chunk_len;
-        remaining -= chunk_len;
+    }
 
-        /* Check if this code block has a language class */
-        const char *code_tag = pre_code + 9;  /* Skip "<pre><code" */
-        bool has_language = false;
+    apex_html_rewriter_append_to_tag(rw, tag, " class=\"poetry\"", 15);
+}
 
-        /* Look for class="language- or class='language- */
-        const char *class_pos = strstr(code_tag, "class=");
-        if (class_pos) {
-            /* Check if it's a language class */
-            const char *lang_check = strstr(class_pos, "language-");
-            if (lang_check) {
-                has_language = true;
+/**
+ * Add hash prefix to footnote IDs to avoid collisions when combining documents.
+ * `state` is the hash prefix string.
+ */
+static void apex_footnote_ids_tag(void *state, const apex_html_tag *tag, apex_html_rewriter *rw) {
+    static const char *const id_prefixes[] = {
+        "id=\"fn-", "id=\"fnref-", "href=\"#fn-", "href=\"#fnref-"
+    };
+    const char *hash_prefix = (const char *)state;
+    if (tag->closing) return;
+
+    /* First pass: count references so the rewrite is sized exactly */
+    const char *end = tag->raw + tag->len;
+    size_t matches = 0;
+    for (const char *p = tag->raw; p < end; p++) {
+        if (*p != 'i' && *p != 'h') continue;
+        for (size_t i = 0; i < sizeof(id_prefixes) / sizeof(id_prefixes[0]); i++) {
+            size_t plen = strlen(id_prefixes[i]);
+            if ((size_t)(end - p) >= plen && memcmp(p, id_prefixes[i], plen) == 0) {
+                matches++;
+                break;
             }
         }
+    }
+    if (matches == 0) return;
 
-        /* Find the closing > of the <code> tag */
-        const char *code_end = strchr(code_tag, '>');
-        if (!code_end) {
-            /* Malformed, copy rest as-is */
-            size_t tail_len = strlen(pre_code);
-            if (tail_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + tail_len + 1) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, pre_code, tail_len);
-            write += tail_len;
-            remaining -= tail_len;
-            break;
-        }
+    size_t hash_len = strlen(hash_prefix);
+    char *output = malloc(tag->len + matches * (hash_len + 1) + 1);
+    if (!output) return;
 
-        if (!has_language) {
-            /* No language class, add poetry class */
-            /* Copy <pre><code */
-            size_t prefix_len = (size_t)(code_end - pre_code);
-            if (prefix_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + prefix_len + 20) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
+    char *write = output;
+    const char *read = tag->raw;
+    while (read < end) {
+        size_t prefix_len = 0;
+        if (*read == 'i' || *read == 'h') {
+            for (size_t i = 0; i < sizeof(id_prefixes) / sizeof(id_prefixes[0]); i++) {
+                size_t plen = strlen(id_prefixes[i]);
+                if ((size_t)(end - read) >= plen && memcmp(read, id_prefixes[i], plen) == 0) {
+                    prefix_len = plen;
+                    break;
                 }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
             }
-            memcpy(write, pre_code, prefix_len);
-            write += prefix_len;
-            remaining -= prefix_len;
+        }
+        if (prefix_len == 0) {
+            *write++ = *read++;
+            continue;
+        }
+        /* Copy up to fn-/fnref-, then insert the hash prefix */
+        memcpy(write, read, prefix_len);
+        write += prefix_len;
+        read += prefix_len;
+        memcpy(write, hash_prefix, hash_len);
+        write += hash_len;
+        *write++ = '-';
+    }
 
-            /* Add class="poetry" */
-            const char *poetry_class = " class=\"poetry\"";
-            size_t poetry_len = strlen(poetry_class);
-            if (poetry_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + poetry_len + 100) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, poetry_class, poetry_len);
-            write += poetry_len;
-            remaining -= poetry_len;
+    apex_html_rewriter_replace(rw, output, (size_t)(write - output));
+    free(output);
+}
 
-            /* Copy the closing > */
-            if (remaining < 10) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + 100) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            *write++ = '>';
-            remaining--;
-            read = code_end + 1;
-        } else {
-            /* Has language class, copy as-is */
-            size_t tag_len = (size_t)(code_end + 1 - pre_code);
-            if (tag_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + tag_len + 1) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, pre_code, tag_len);
-            write += tag_len;
-            remaining -= tag_len;
-            read = code_end + 1;
-        }
+/**
+ * Insert a page break before the footnotes section (the first one only).
+ * `state` points to a bool that is set once the break is in.
+ */
+static const char apex_footnotes_pagebreak_html[] =
+    "<div class=\"mkpagebreak manualbreak\" "
+    "title=\"Page break created before footnotes\" "
+    "data-description=\"PAGE (Footnotes)\" "
+    "style=\"page-break-after:always\">"
+    "<span style=\"display:none\">&nbsp;</span></div>";
+
+static void apex_footnotes_pagebreak_tag(void *state, const apex_html_tag *tag, apex_html_rewriter *rw) {
+    static const char marker[] = "<section class=\"footnotes\"";
+    bool *done = (bool *)state;
+    if (*done || tag->closing || tag->len < sizeof(marker) - 1 ||
+        memcmp(tag->raw, marker, sizeof(marker) - 1) != 0) {
+        return;
     }
+    *done = true;
 
-    *write = '\0';
-    return output;
+    size_t break_len = sizeof(apex_footnotes_pagebreak_html) - 1;
+    char *output = malloc(break_len + tag->len);
+    if (!output) return;
+    memcpy(output, apex_footnotes_pagebreak_html, break_len);
+    memcpy(output + break_len, tag->raw, tag->len);
+    apex_html_rewriter_replace(rw, output, break_len + tag->len);
+    free(output);
+}
+
+/**
+ * Shift <hN> tags by Base Header Level - 1, clamped to h6.
+ * `state` points to the base level (2-6).
+ */
+static void apex_header_level_tag(void *state, const apex_html_tag *tag, apex_html_rewriter *rw) {
+    int base_header_level = *(const int *)state;
+    if (tag->name_len != 2 || tag->name[0] != 'h' || tag->name[1] < '1' || tag->name[1] > '6') return;
+    /* Only plain </hN>, as the whole-text pass did */
+    if (tag->closing && tag->len != 5) return;
+
+    int new_level = (tag->name[1] - '0') + (base_header_level - 1);
+    if (new_level > 6) new_level = 6;
+    if (new_level == tag->name[1] - '0') return;
+
+    char *output = malloc(tag->len);
+    if (!output) return;
+    memcpy(output, tag->raw, tag->len);
+    output[(size_t)(tag->name - tag->raw) + 1] = (char)('0' + new_level);
+    apex_html_rewriter_replace(rw, output, tag->len);
+    free(output);
 }
 
 /**
@@ -3720,315 +3929,6 @@ static char *apex_compute_document_hash(const char *content, size_t len) {
     return hash_str;
 }
 
-/**
- * Add hash prefix to footnote IDs to avoid collisions when combining documents.
- * Returns a newly allocated string, or NULL on error.
- */
-static char *apex_add_hash_to_footnote_ids(const char *html, const char *hash_prefix) {
-    if (!html || !hash_prefix) return NULL;
-
-    size_t len = strlen(html);
-    size_t hash_len = strlen(hash_prefix);
-    /* Allow for expansion: each fn- or fnref- gets hash- prefix added */
-    size_t capacity = len + (hash_len + 1) * 100 + 1;  /* Estimate 100 footnotes max */
-    char *output = malloc(capacity);
-    if (!output) return NULL;
-
-    const char *read = html;
-    char *write = output;
-    size_t remaining = capacity;
-
-    while (*read) {
-        /* Look for id="fn- or id="fnref- */
-        if (strncmp(read, "id=\"fn-", 7) == 0) {
-            /* Copy up to fn- */
-            size_t prefix_len = 7;  /* "id=\"fn-" */
-            if (prefix_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + prefix_len + hash_len + 100) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, read, prefix_len);
-            write += prefix_len;
-            remaining -= prefix_len;
-            read += prefix_len;
-
-            /* Insert hash prefix */
-            if (hash_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + hash_len + 100) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, hash_prefix, hash_len);
-            write += hash_len;
-            remaining -= hash_len;
-            *write++ = '-';
-            remaining--;
-        } else if (strncmp(read, "id=\"fnref-", 10) == 0) {
-            /* Copy up to fnref- */
-            size_t prefix_len = 10;  /* "id=\"fnref-" */
-            if (prefix_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + prefix_len + hash_len + 100) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, read, prefix_len);
-            write += prefix_len;
-            remaining -= prefix_len;
-            read += prefix_len;
-
-            /* Insert hash prefix */
-            if (hash_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + hash_len + 100) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, hash_prefix, hash_len);
-            write += hash_len;
-            remaining -= hash_len;
-            *write++ = '-';
-            remaining--;
-        } else if (strncmp(read, "href=\"#fn-", 10) == 0) {
-            /* Copy up to #fn- */
-            size_t prefix_len = 10;  /* "href=\"#fn-" */
-            if (prefix_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + prefix_len + hash_len + 100) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, read, prefix_len);
-            write += prefix_len;
-            remaining -= prefix_len;
-            read += prefix_len;
-
-            /* Insert hash prefix */
-            if (hash_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + hash_len + 100) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, hash_prefix, hash_len);
-            write += hash_len;
-            remaining -= hash_len;
-            *write++ = '-';
-            remaining--;
-        } else if (strncmp(read, "href=\"#fnref-", 13) == 0) {
-            /* Copy up to #fnref- */
-            size_t prefix_len = 13;  /* "href=\"#fnref-" */
-            if (prefix_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + prefix_len + hash_len + 100) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, read, prefix_len);
-            write += prefix_len;
-            remaining -= prefix_len;
-            read += prefix_len;
-
-            /* Insert hash prefix */
-            if (hash_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + hash_len + 100) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, hash_prefix, hash_len);
-            write += hash_len;
-            remaining -= hash_len;
-            *write++ = '-';
-            remaining--;
-        } else {
-            /* Normal character, copy as-is */
-            if (remaining < 10) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + 100) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            *write++ = *read++;
-            remaining--;
-        }
-    }
-
-    *write = '\0';
-    return output;
-}
-
-/**
- * Replace <hr> elements in HTML with Marked-style page break divs.
- * Returns a newly allocated string, or NULL on error.
- */
-static char *apex_replace_hr_with_pagebreak(const char *html) {
-    if (!html) return NULL;
-
-    size_t len = strlen(html);
-    /* Page break divs are significantly longer than <hr>, allow generous expansion */
-    size_t capacity = len * 4 + 1;
-    char *output = malloc(capacity);
-    if (!output) return NULL;
-
-    const char *read = html;
-    char *write = output;
-    size_t remaining = capacity;
-
-    const char *replacement =
-        "<div class=\"mkpagebreak manualbreak\" "
-        "title=\"Page break created from HR\" "
-        "data-description=\"PAGE (HR)\" "
-        "style=\"page-break-after:always\">"
-        "<span style=\"display:none\">&nbsp;</span></div>";
-    size_t repl_len = strlen(replacement);
-
-    while (*read) {
-        const char *hr = strstr(read, "<hr");
-        if (!hr) {
-            /* Copy the rest */
-            size_t tail_len = strlen(read);
-            if (tail_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + tail_len + 1) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, read, tail_len);
-            write += tail_len;
-            remaining -= tail_len;
-            break;
-        }
-
-        /* Copy up to the <hr */
-        size_t chunk_len = (size_t)(hr - read);
-        if (chunk_len >= remaining) {
-            size_t written = (size_t)(write - output);
-            capacity = (written + chunk_len + repl_len + 1) * 2;
-            char *new_output = realloc(output, capacity);
-            if (!new_output) {
-                free(output);
-                return NULL;
-            }
-            output = new_output;
-            write = output + written;
-            remaining = capacity - written;
-        }
-        memcpy(write, read, chunk_len);
-        write += chunk_len;
-        remaining -= chunk_len;
-
-        /* Find end of the <hr ...> tag */
-        const char *tag_end = strchr(hr, '>');
-        if (!tag_end) {
-            /* Malformed tag, copy the rest as-is */
-            size_t tail_len = strlen(hr);
-            if (tail_len >= remaining) {
-                size_t written = (size_t)(write - output);
-                capacity = (written + tail_len + 1) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-            }
-            memcpy(write, hr, tail_len);
-            write += tail_len;
-            remaining -= tail_len;
-            break;
-        }
-
-        /* Skip the entire <hr ...> tag */
-        read = tag_end + 1;
-
-        /* Write replacement */
-        if (repl_len >= remaining) {
-            size_t written = (size_t)(write - output);
-            capacity = (written + repl_len + 1) * 2;
-            char *new_output = realloc(output, capacity);
-            if (!new_output) {
-                free(output);
-                return NULL;
-            }
-            output = new_output;
-            write = output + written;
-            remaining = capacity - written;
-        }
-        memcpy(write, replacement, repl_len);
-        write += repl_len;
-        remaining -= repl_len;
-    }
-
-    *write = '\0';
-    return output;
-}
-
 /**
  * Apply widont to headings: replace spaces with &nbsp; between trailing words
  * when their combined length (including spaces) is <= 10 characters.
@@ -4454,25 +4354,6 @@ static char *apex_apply_widont_to_headings(const char *html) {
     return output;
 }
 
-static const char *apex_find_unquoted_gt(const char *p, const char *end) {
-    int quote = 0;
-    while (p < end) {
-        if (quote) {
-            if (*p == quote) quote = 0;
-            p++;
-            continue;
-        }
-        if (*p == '"' || *p == '\'') {
-            quote = *p;
-            p++;
-            continue;
-        }
-        if (*p == '>') return p;
-        p++;
-    }
-    return NULL;
-}
-
 static bool apex_html_void_element_name(const char *name, size_t nlen) {
     static const char *void_tags[] = {
         "area", "base", "br", "col", "embed", "hr", "img", "input",
@@ -4491,151 +4372,305 @@ static bool apex_html_void_element_name(const char *name, size_t nlen) {
     return false;
 }
 
-static int apex_html_buf_append(char **outp, size_t *cap, size_t *olen, const char *s, size_t n) {
-    while (*olen + n + 1 > *cap) {
-        size_t new_cap = *cap ? *cap * 2 : 8192;
-        char *nbuf = realloc(*outp, new_cap);
-        if (!nbuf) return -1;
-        *outp = nbuf;
-        *cap = new_cap;
-    }
-    memcpy(*outp + *olen, s, n);
-    *olen += n;
-    (*outp)[*olen] = '\0';
-    return 0;
-}
-
 /**
  * Rewrite HTML void/empty elements to XML self-closing form (e.g. <br> -> <br />).
- * Skips contents of script, style, and HTML comments. Returns newly allocated string or NULL.
+ * Script, style and comment contents never reach tag stages.
  */
-static char *apex_html_apply_xhtml_void_tags(const char *html) {
-    if (!html) return NULL;
+static void apex_xhtml_void_tag(void *state, const apex_html_tag *tag, apex_html_rewriter *rw) {
+    (void)state;
+    if (tag->closing || tag->self_closing) return;
+    if (!apex_html_void_element_name(tag->name, tag->name_len)) return;
+    apex_html_rewriter_append_to_tag(rw, tag, " /", 2);
+}
 
-    size_t cap = strlen(html) * 2 + 256;
-    if (cap < 8192) cap = 8192;
-    char *out = malloc(cap);
-    if (!out) return NULL;
-    size_t olen = 0;
+/* Internal state of a streaming conversion (apex_markdown_to_sink) */
+typedef struct {
+    apex_write_fn write;
+    void *user_data;
+    bool streamed;       /* apex_convert wrote the output itself */
+    bool failed;         /* The sink asked to stop */
+    size_t written;      /* Bytes handed to write */
+} apex_output_sink;
+
+static void apex_sink_write(apex_output_sink *sink, const char *data, size_t len) {
+    if (!data || len == 0 || sink->failed) return;
+    if (sink->write(sink->user_data, data, len) != 0) {
+        sink->failed = true;
+        return;
+    }
+    sink->written += len;
+}
 
-    const char *r = html;
-    const char *end = html + strlen(html);
+/* Streamed bodies are finished and written in segments of about this size */
+#define APEX_SINK_SEGMENT (64 * 1024)
 
-    while (r < end) {
-        if (*r != '<') {
-            if (apex_html_buf_append(&out, &cap, &olen, r, 1) != 0) goto fail;
-            r++;
+/**
+ * Length of the next body segment to stream: up to the first line break
+ * after `min` bytes that sits between two tags, outside any table (as the
+ * table clean-up passes track it) and outside pre, script, style and
+ * comments. apex_finish_html() gives the same bytes for such segments as
+ * for the whole body. Returns len if there is no such break.
+ */
+static size_t apex_sink_segment_end(const char *html, size_t len, size_t min) {
+    static const struct { const char *open; const char *close; } raw[] = {
+        { "<pre", "</pre>" },
+        { "<script", "</script>" },
+        { "<style", "</style>" },
+        { "<!--", "-->" },
+    };
+    bool in_table = false;
+    const char *raw_close = NULL;
+
+    for (size_t i = 0; i < len; i++) {
+        const char *p = html + i;
+        if (raw_close) {
+            if (strncmp(p, raw_close, strlen(raw_close)) == 0) raw_close = NULL;
             continue;
         }
-
-        /* Comment */
-        if (r + 4 <= end && strncmp(r, "<!--", 4) == 0) {
-            const char *ce = strstr(r + 4, "-->");
-            if (!ce) {
-                if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(end - r)) != 0) goto fail;
-                break;
+        if (*p == '<') {
+            if (strncmp(p, "<table", 6) == 0 && (p[6] == '>' || p[6] == ' ')) {
+                in_table = true;
+            } else if (strncmp(p, "</table>", 8) == 0) {
+                in_table = false;
+            } else {
+                for (size_t r = 0; r < sizeof(raw) / sizeof(raw[0]); r++) {
+                    if (strncmp(p, raw[r].open, strlen(raw[r].open)) == 0) {
+                        raw_close = raw[r].close;
+                        break;
+                    }
+                }
             }
-            if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(ce + 3 - r)) != 0) goto fail;
-            r = ce + 3;
-            continue;
+        } else if (*p == '\n' && i >= min && !in_table && i > 0 && html[i - 1] == '>' &&
+                   i + 1 < len && html[i + 1] == '<') {
+            return i + 1;
         }
+    }
+    return len;
+}
 
-        /* CDATA */
-        if (r + 9 <= end && strncmp(r, "<![CDATA[", 9) == 0) {
-            const char *ce = strstr(r + 9, "]]>");
-            if (!ce) {
-                if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(end - r)) != 0) goto fail;
-                break;
-            }
-            if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(ce + 3 - r)) != 0) goto fail;
-            r = ce + 3;
-            continue;
+#define APEX_HTML_DOCUMENT_END "\n</body>\n</html>\n"
+
+/* Length of what apex_wrap_html_document() writes after the content */
+static size_t apex_html_document_tail_len(const char *html_footer) {
+    return (html_footer ? 1 + strlen(html_footer) : 0) + strlen(APEX_HTML_DOCUMENT_END);
+}
+
+/**
+ * Length of content without a trailing </body></html>, which
+ * apex_wrap_html_document() drops so the document isn't closed twice
+ */
+static size_t apex_html_document_content_len(const char *content) {
+    size_t content_len = strlen(content);
+    const char *html_end = NULL;
+    const char *body_end = NULL;
+
+    /* Find last occurrence of </html> near the end */
+    const char *search = content + content_len;
+    while (search > content) {
+        search--;
+        if (strncmp(search, "</html>", 7) == 0) {
+            html_end = search;
+            break;
         }
+    }
 
-        /* script */
-        if (r + 7 <= end && strncasecmp(r, "<script", 7) == 0) {
-            const char *close = strcasestr(r + 7, "</script>");
-            if (!close) {
-                if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(end - r)) != 0) goto fail;
+    /* If we found </html>, look for </body> before it */
+    if (html_end) {
+        search = html_end;
+        while (search > content) {
+            search--;
+            if (strncmp(search, "</body>", 7) == 0) {
+                body_end = search;
                 break;
             }
-            if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(close + 9 - r)) != 0) goto fail;
-            r = close + 9;
-            continue;
-        }
-
-        /* style */
-        if (r + 6 <= end && strncasecmp(r, "<style", 6) == 0) {
-            const char *close = strcasestr(r + 6, "</style>");
-            if (!close) {
-                if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(end - r)) != 0) goto fail;
+            /* Stop if we hit a non-whitespace character before finding </body> */
+            if (!isspace((unsigned char)*search) && *search != '>') {
                 break;
             }
-            if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(close + 8 - r)) != 0) goto fail;
-            r = close + 8;
-            continue;
         }
 
-        /* Declaration <!...> */
-        if (r + 1 < end && r[1] == '!') {
-            const char *gt = apex_find_unquoted_gt(r, end);
-            if (!gt) {
-                if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(end - r)) != 0) goto fail;
-                break;
+        /* If we found both tags at the end, strip them */
+        if (body_end) {
+            /* Check that there's only whitespace/newlines between </body> and </html> */
+            const char *between = body_end + 7;
+            bool only_whitespace = true;
+            while (between < html_end) {
+                if (!isspace((unsigned char)*between)) {
+                    only_whitespace = false;
+                    break;
+                }
+                between++;
+            }
+
+            if (only_whitespace) {
+                /* Strip everything from </body> to end */
+                content_len = body_end - content;
             }
-            if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(gt + 1 - r)) != 0) goto fail;
-            r = gt + 1;
-            continue;
         }
+    }
+    return content_len;
+}
 
-        /* Closing tag */
-        if (r + 1 < end && r[1] == '/') {
-            const char *gt = apex_find_unquoted_gt(r, end);
-            if (!gt) {
-                if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(end - r)) != 0) goto fail;
-                break;
+/**
+ * Replace the stylesheet links written by apex_wrap_html_document() with
+ * <style> blocks holding the files' contents. Takes ownership of html.
+ */
+static char *apex_embed_stylesheet_links(char *html, const char **css_paths, size_t css_count,
+                                         const char *base_directory) {
+    if (!html) return NULL;
+
+    /* Process each stylesheet in reverse order to maintain correct positions */
+    for (int i = (int)css_count - 1; i >= 0; i--) {
+        if (!css_paths[i]) continue;
+
+        const char *css_path = css_paths[i];
+        char *css_content = NULL;
+        size_t css_len = 0;
+
+        /* Helper lambda-like block to read file into memory */
+        {
+            apex_render_cache_note_file(css_path);
+            FILE *css_fp = fopen(css_path, "rb");
+            if (!css_fp && base_directory && base_directory[0] != '\0') {
+                /* Try base_directory + "/" + css_path */
+                size_t base_len = strlen(base_directory);
+                size_t path_len = strlen(css_path);
+                size_t full_len = base_len + 1 + path_len + 1;
+                char *full_path = malloc(full_len);
+                if (full_path) {
+                    snprintf(full_path, full_len, "%s/%s", base_directory, css_path);
+                    apex_render_cache_note_file(full_path);
+                    css_fp = fopen(full_path, "rb");
+                    free(full_path);
+                }
+            }
+
+            if (css_fp) {
+                if (fseek(css_fp, 0, SEEK_END) == 0) {
+                    long fsize = ftell(css_fp);
+                    if (fsize >= 0 && fsize < 10 * 1024 * 1024) { /* 10MB safety limit */
+                        rewind(css_fp);
+                        css_content = malloc((size_t)fsize + 1);
+                        if (css_content) {
+                            css_len = fread(css_content, 1, (size_t)fsize, css_fp);
+                            css_content[css_len] = '\0';
+                        }
+                    }
+                }
+                fclose(css_fp);
+            }
+        }
+
+        if (css_content && css_len > 0) {
+            /* Build the exact link line we expect from apex_wrap_html_document */
+            char link_line[2048];
+            int link_n = snprintf(link_line, sizeof(link_line),
+                                  "  <link rel=\"stylesheet\" href=\"%s\">\n",
+                                  css_path);
+            if (link_n > 0 && (size_t)link_n < sizeof(link_line)) {
+                char *pos = strstr(html, link_line);
+                if (pos) {
+                    size_t html_len = strlen(html);
+                    size_t link_len = (size_t)link_n;
+                    const char *style_prefix = "  <style>\n";
+                    const char *style_suffix = "\n  </style>\n";
+                    size_t prefix_len = strlen(style_prefix);
+                    size_t suffix_len = strlen(style_suffix);
+
+                    size_t new_len = html_len - link_len + prefix_len + css_len + suffix_len;
+                    char *embedded = malloc(new_len + 1);
+                    if (embedded) {
+                        size_t before_len = (size_t)(pos - html);
+                        memcpy(embedded, html, before_len);
+                        size_t offset = before_len;
+
+                        memcpy(embedded + offset, style_prefix, prefix_len);
+                        offset += prefix_len;
+
+                        memcpy(embedded + offset, css_content, css_len);
+                        offset += css_len;
+
+                        memcpy(embedded + offset, style_suffix, suffix_len);
+                        offset += suffix_len;
+
+                        size_t after_len = html_len - before_len - link_len;
+                        if (after_len > 0) {
+                            memcpy(embedded + offset, pos + link_len, after_len);
+                            offset += after_len;
+                        }
+
+                        embedded[offset] = '\0';
+                        free(html);
+                        html = embedded;
+                    }
+                }
             }
-            if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(gt + 1 - r)) != 0) goto fail;
-            r = gt + 1;
-            continue;
+            free(css_content);
         }
+    }
+    return html;
+}
+
+/**
+ * Final clean-up passes on rendered HTML: blank lines and separator rows
+ * in tables, pretty-printing and XHTML void elements. Takes ownership of
+ * html. The passes only look at one line, row or tag at a time, so a
+ * document may also be finished piece by piece.
+ */
+static char *apex_finish_html(char *html, const apex_options *local_opts, bool xhtml_output) {
+    if (!html) return NULL;
+    apex_stats *prof = local_opts->stats;
+
+    /* Remove blank lines within tables (applies to both pretty and non-pretty) */
+    PROFILE_START(remove_table_blank_lines, html);
+    char *cleaned = apex_remove_table_blank_lines(html);
+    PROFILE_END(remove_table_blank_lines, cleaned);
+    if (cleaned) {
+        free(html);
+        html = cleaned;
+    }
 
-        /* Opening tag: extract name */
-        const char *name_start = r + 1;
-        while (name_start < end && isspace((unsigned char)*name_start)) name_start++;
-        const char *name_end = name_start;
-        while (name_end < end && (isalnum((unsigned char)*name_end) || *name_end == '-' || *name_end == '_' || *name_end == ':')) {
-            name_end++;
+    /* Remove table separator rows that were incorrectly rendered as data rows */
+    /* This happens when smart typography converts --- to — in separator rows */
+    if (local_opts->enable_tables) {
+        PROFILE_START(remove_table_separator_rows, html);
+        extern char *apex_remove_table_separator_rows(const char *html);
+        cleaned = apex_remove_table_separator_rows(html);
+        PROFILE_END(remove_table_separator_rows, cleaned);
+        if (cleaned) {
+            free(html);
+            html = cleaned;
         }
-        size_t name_len = (size_t)(name_end - name_start);
+    }
 
-        const char *gt = apex_find_unquoted_gt(r, end);
-        if (!gt) {
-            if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(end - r)) != 0) goto fail;
-            break;
+    /* Pretty-print HTML if requested */
+    if (local_opts->pretty) {
+        PROFILE_START(pretty_print, html);
+        char *pretty = apex_pretty_print_html(html);
+        PROFILE_END(pretty_print, pretty);
+        if (pretty) {
+            free(html);
+            html = pretty;
         }
+    }
 
-        if (name_len > 0 && apex_html_void_element_name(name_start, name_len)) {
-            const char *slash = gt - 1;
-            while (slash > r && isspace((unsigned char)*slash)) slash--;
-            if (slash >= r && *slash == '/') {
-                if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(gt + 1 - r)) != 0) goto fail;
-            } else {
-                if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(gt - r)) != 0) goto fail;
-                if (apex_html_buf_append(&out, &cap, &olen, " />", 3) != 0) goto fail;
+    /* XHTML-style void elements (--xhtml / --strict-xhtml); run after pretty-print (HTML only) */
+    if (xhtml_output) {
+        apex_html_rewriter *rewriter = apex_html_rewriter_new();
+        if (rewriter) {
+            apex_html_rewriter_on_tag(rewriter, NULL, apex_xhtml_void_tag, NULL);
+            PROFILE_START(xhtml_void_tags, html);
+            char *xhtml_out = apex_html_rewriter_run(rewriter, html, strlen(html));
+            PROFILE_END(xhtml_void_tags, xhtml_out);
+            if (xhtml_out) {
+                free(html);
+                html = xhtml_out;
             }
-            r = gt + 1;
-            continue;
+            apex_html_rewriter_free(rewriter);
         }
-
-        if (apex_html_buf_append(&out, &cap, &olen, r, (size_t)(gt + 1 - r)) != 0) goto fail;
-        r = gt + 1;
     }
 
-    return out;
-fail:
-    free(out);
-    return NULL;
+    return html;
 }
 
 apex_toc_entry *apex_markdown_to_toc_entries(const char *markdown, size_t len,
@@ -4662,15 +4697,50 @@ apex_toc_entry *apex_markdown_to_toc_entries(const char *markdown, size_t len,
     return entries;
 }
 
-char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options *options) {
+/**
+ * Copy the registry's citations into a section summary, in source order
+ * (the registry keeps them newest first). Returns false on allocation
+ * failure.
+ */
+static bool apex_section_record_citations(apex_section_summary *section,
+                                          const apex_citation_registry *registry) {
+    if (registry->count == 0) return true;
+    section->citations = calloc(registry->count, sizeof(apex_section_citation));
+    if (!section->citations) return false;
+
+    size_t i = registry->count;
+    for (const apex_citation *cite = registry->citations; cite && i > 0; cite = cite->next) {
+        apex_section_citation *out = &section->citations[--i];
+        out->key = strdup(cite->key ? cite->key : "");
+        if (!out->key) return false;
+        out->author_in_text = cite->author_in_text;
+        out->author_suppressed = cite->author_suppressed;
+        section->citation_count++;
+    }
+    return i == 0;
+}
+
+/* The marker apex_insert_bibliography() would use in html */
+static apex_section_bib_marker apex_section_bib_marker_of(const char *html) {
+    if (strstr(html, "<!-- REFERENCES -->")) return APEX_SECTION_BIB_REFERENCES;
+    if (strstr(html, "{backmatter}")) return APEX_SECTION_BIB_BACKMATTER;
+    const char *refs_div = strstr(html, "<div id=\"refs\">");
+    if (!refs_div) return APEX_SECTION_BIB_NONE;
+    return strstr(refs_div, "</div>") ? APEX_SECTION_BIB_REFS_DIV : APEX_SECTION_BIB_REFS_DIV_OPEN;
+}
+
+/**
+ * Main conversion function using cmark-gfm
+ */
+static char *apex_convert_document(const char *markdown, size_t len, const apex_options *options,
+                                   const apex_converter *converter, apex_output_sink *sink,
+                                   apex_section_summary *section) {
     if (!markdown || len == 0) {
         char *empty = malloc(1);
         if (empty) empty[0] = '\0';
         return empty;
     }
 
-    PROFILE_START(total);
-
     /* Use default options if none provided, and create a mutable copy */
     apex_options local_opts;
     if (!options) {
@@ -4683,6 +4753,8 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     /* Use local_opts for rest of function (mutable) - shadow the const parameter */
     #define options (&local_opts)
 
+    apex_stats *prof = local_opts.stats;
+
     if (local_opts.strict_xhtml) {
         local_opts.xhtml = true;
     }
@@ -4708,16 +4780,19 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
      * in project and global plugin directories.
      */
     apex_plugin_manager *plugin_manager = NULL;
-    if (options->enable_plugins) {
+    bool plugins_shared = converter && apex_converter_shares_plugins(converter, options);
+    if (plugins_shared) {
+        plugin_manager = converter->plugins;
+    } else if (options->enable_plugins) {
         plugin_manager = apex_plugins_load(options);
     }
 
     char *quarto_shortcodes_processed = NULL;
     if (apex_quarto_feature(options, options->enable_quarto_shortcodes)) {
         bool warn_unknown = getenv("APEX_VERBOSE") != NULL;
-        PROFILE_START(quarto_shortcodes_preprocess);
+        PROFILE_START(quarto_shortcodes_preprocess, working_text);
         quarto_shortcodes_processed = apex_preprocess_quarto_shortcodes(working_text, warn_unknown, options->unsafe);
-        PROFILE_END(quarto_shortcodes_preprocess);
+        PROFILE_END(quarto_shortcodes_preprocess, quarto_shortcodes_processed);
         if (quarto_shortcodes_processed) {
             free(working_text);
             working_text = quarto_shortcodes_processed;
@@ -4729,10 +4804,12 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
      * over the raw markdown before any Apex-specific preprocessing.
      */
     if (plugin_manager) {
+        PROFILE_START(plugins_pre_parse, working_text);
         char *plugin_text = apex_plugins_run_text_phase(plugin_manager,
                                                         APEX_PLUGIN_PHASE_PRE_PARSE,
                                                         working_text,
                                                         options);
+        PROFILE_END(plugins_pre_parse, plugin_text);
         if (plugin_text) {
             free(working_text);
             working_text = plugin_text;
@@ -4753,9 +4830,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
      * doesn't consume top-of-file TYPE: lines before they can be treated as callouts.
      */
     if (options->enable_py_callouts) {
-        PROFILE_START(py_callouts_preprocess);
+        PROFILE_START(py_callouts_preprocess, text_ptr);
         py_callouts_processed = apex_preprocess_py_callouts(text_ptr);
-        PROFILE_END(py_callouts_preprocess);
+        PROFILE_END(py_callouts_preprocess, py_callouts_processed);
         if (py_callouts_processed) {
             text_ptr = py_callouts_processed;
         }
@@ -4776,9 +4853,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         options->mode == APEX_MODE_KRAMDOWN ||
         apex_mode_is_unified_family(options->mode)) {
         /* Extract metadata FIRST */
-        PROFILE_START(metadata);
+        PROFILE_START(metadata, text_ptr);
         metadata = apex_extract_metadata_for_mode(&text_ptr, options->mode);
-        PROFILE_END(metadata);
+        PROFILE_END(metadata, text_ptr);
         if (getenv("APEX_DEBUG_PIPELINE")) {
             size_t len = strlen(text_ptr);
             fprintf(stderr, "[APEX_DEBUG] after extract_metadata (len=%zu): %.200s%s\n",
@@ -4816,33 +4893,57 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
      */
     char *metadata_replaced = NULL;
     if (metadata && options->enable_metadata_variables) {
-        PROFILE_START(metadata_replace_pre);
-        metadata_replaced = apex_metadata_replace_variables(text_ptr, metadata, options);
-        PROFILE_END(metadata_replace_pre);
+        PROFILE_START(metadata_replace_pre, text_ptr);
+        metadata_replaced = apex_metadata_replace_variables(text_ptr, metadata, options,
+                                                            converter ? converter->metadata_cache : NULL);
+        PROFILE_END(metadata_replace_pre, metadata_replaced);
         if (metadata_replaced) {
             text_ptr = metadata_replaced;
         }
     }
 
+    /* Sniff which extension syntax occurs in the source so preprocessing
+     * stages with nothing to do can be skipped. Every stage that replaces
+     * the text goes through PIPELINE_ADVANCE, which marks the set stale;
+     * it rescans only when a later gate would otherwise skip its stage.
+     */
+    apex_feature_set features;
+    apex_feature_set_init(&features, text_ptr);
+#define PIPELINE_ADVANCE(next) do { \
+        text_ptr = (next); \
+        apex_features_invalidate(&features); \
+    } while (0)
+
     /* Load bibliography files if provided (before processing citations)
      * Check both CLI bibliography files and metadata bibliography
      * Only load bibliography if files are actually specified - this avoids
      * unnecessary file I/O and parsing when citations aren't being used
      */
     apex_bibliography_registry *bibliography = NULL;
+    bool bibliography_shared = false;
 
-    /* Load from CLI bibliography files if specified */
+    /* Load from CLI bibliography files if specified. A converter's copy is
+     * shared read-only, so a private one is still loaded when metadata
+     * entries will be merged into it. */
     if (options->bibliography_files) {
-        PROFILE_START(bibliography_load);
-        bibliography = apex_load_bibliography((const char **)options->bibliography_files, options->base_directory);
-        PROFILE_END(bibliography_load);
+        if (converter && converter->bibliography &&
+            apex_converter_shares_bibliography(converter, options) &&
+            !(metadata && apex_metadata_get(metadata, "bibliography"))) {
+            bibliography = converter->bibliography;
+            bibliography_shared = true;
+        } else {
+            PROFILE_START(bibliography_load, NULL);
+            bibliography = apex_load_bibliography((const char **)options->bibliography_files, options->base_directory,
+                                                  options->bibliography_cache_dir);
+            PROFILE_END(bibliography_load, NULL);
+        }
     }
 
     /* Also check metadata for bibliography (merge with CLI bibliography if both exist) */
     if (metadata) {
         const char *bib_value = apex_metadata_get(metadata, "bibliography");
         if (bib_value) {
-            PROFILE_START(bibliography_load_meta);
+            PROFILE_START(bibliography_load_meta, NULL);
             /* Load bibliography from metadata */
             char *resolved_path = NULL;
             if (options->base_directory) {
@@ -4862,23 +4963,12 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
             }
 
             if (resolved_path) {
-                apex_bibliography_registry *meta_bib = apex_load_bibliography_file(resolved_path);
+                apex_bibliography_registry *meta_bib =
+                    apex_load_bibliography_file_cached(resolved_path, options->bibliography_cache_dir);
                 if (meta_bib) {
                     if (bibliography) {
                         /* Merge with existing bibliography */
-                        apex_bibliography_entry *entry = meta_bib->entries;
-                        while (entry) {
-                            apex_bibliography_entry *next = entry->next;
-                            if (!apex_find_bibliography_entry(bibliography, entry->id)) {
-                                entry->next = bibliography->entries;
-                                bibliography->entries = entry;
-                                bibliography->count++;
-                            } else {
-                                apex_bibliography_entry_free(entry);
-                            }
-                            entry = next;
-                        }
-                        free(meta_bib);
+                        apex_bibliography_merge(bibliography, meta_bib);
                     } else {
                         /* Use metadata bibliography as the main bibliography */
                         bibliography = meta_bib;
@@ -4886,7 +4976,7 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
                 }
                 free(resolved_path);
             }
-            PROFILE_END(bibliography_load_meta);
+            PROFILE_END(bibliography_load_meta, NULL);
         }
     }
 
@@ -4916,24 +5006,28 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     if (options->enable_citations && should_process_citations) {
         PROGRESS_REPORT("Processing citations", -1);
-        PROFILE_START(citations);
+        PROFILE_START(citations, text_ptr);
         citations_processed = apex_process_citations(text_ptr, &citation_registry, options);
-        PROFILE_END(citations);
+        PROFILE_END(citations, citations_processed);
         if (citations_processed) {
-            text_ptr = citations_processed;
+            PIPELINE_ADVANCE(citations_processed);
+        }
+        if (section && !apex_section_record_citations(section, &citation_registry)) {
+            section->failed = true;
         }
     }
 
     /* Process index entries (preprocessing) */
     apex_index_registry index_registry = {0};
     char *indices_processed = NULL;
-    if (options->enable_indices) {
+    if (options->enable_indices &&
+        apex_features_any(&features, text_ptr, APEX_FEATURE_INDEX | APEX_FEATURE_BRACE)) {
         PROGRESS_REPORT("Processing indices", -1);
-        PROFILE_START(indices);
+        PROFILE_START(indices, text_ptr);
         indices_processed = apex_process_index_entries(text_ptr, &index_registry, options);
-        PROFILE_END(indices);
+        PROFILE_END(indices, indices_processed);
         if (indices_processed) {
-            text_ptr = indices_processed;
+            PIPELINE_ADVANCE(indices_processed);
         }
     }
 
@@ -4944,27 +5038,28 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     char *autolinks_processed = NULL;
     if (options->enable_autolink) {
         PROGRESS_REPORT("Processing autolinks", -1);
-        PROFILE_START(autolinks);
+        PROFILE_START(autolinks, text_ptr);
         autolinks_processed = apex_preprocess_autolinks(text_ptr, options);
-        PROFILE_END(autolinks);
+        PROFILE_END(autolinks, autolinks_processed);
         if (autolinks_processed) {
-            text_ptr = autolinks_processed;
+            PIPELINE_ADVANCE(autolinks_processed);
         }
     }
 
     /* Preprocess image attributes and URL-encode all link URLs */
     image_attr_entry *img_attrs = NULL;
     char *image_attrs_processed = NULL;
-    if (apex_mode_is_unified_family(options->mode) ||
-        options->mode == APEX_MODE_MULTIMARKDOWN ||
-        options->mode == APEX_MODE_KRAMDOWN ||
-        options->mode == APEX_MODE_GFM ||
-        options->mode == APEX_MODE_COMMONMARK) {
-        PROFILE_START(image_attrs_preprocess);
+    if ((apex_mode_is_unified_family(options->mode) ||
+         options->mode == APEX_MODE_MULTIMARKDOWN ||
+         options->mode == APEX_MODE_KRAMDOWN ||
+         options->mode == APEX_MODE_GFM ||
+         options->mode == APEX_MODE_COMMONMARK) &&
+        apex_features_any(&features, text_ptr, APEX_FEATURE_BRACKET)) {
+        PROFILE_START(image_attrs_preprocess, text_ptr);
         image_attrs_processed = apex_preprocess_image_attributes(text_ptr, &img_attrs, options->mode);
-        PROFILE_END(image_attrs_preprocess);
+        PROFILE_END(image_attrs_preprocess, image_attrs_processed);
         if (image_attrs_processed) {
-            text_ptr = image_attrs_processed;
+            PIPELINE_ADVANCE(image_attrs_processed);
             if (getenv("APEX_DEBUG_PIPELINE")) {
                 size_t len = strlen(text_ptr);
                 fprintf(stderr, "[APEX_DEBUG] after image_attrs (len=%zu): %.250s%s\n",
@@ -4976,12 +5071,14 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     /* Preprocess IAL markers (insert blank lines before them so cmark parses correctly) */
     char *ial_preprocessed = NULL;
     char *escaped_toc_protected = NULL;
-    if (options->mode == APEX_MODE_KRAMDOWN || apex_mode_is_unified_family(options->mode)) {
-        PROFILE_START(ial_preprocess);
+    apex_escaped_toc_store escaped_tocs = {0};
+    if ((options->mode == APEX_MODE_KRAMDOWN || apex_mode_is_unified_family(options->mode)) &&
+        apex_features_any(&features, text_ptr, APEX_FEATURE_BRACE)) {
+        PROFILE_START(ial_preprocess, text_ptr);
         ial_preprocessed = apex_preprocess_ial(text_ptr);
-        PROFILE_END(ial_preprocess);
+        PROFILE_END(ial_preprocess, ial_preprocessed);
         if (ial_preprocessed) {
-            text_ptr = ial_preprocessed;
+            PIPELINE_ADVANCE(ial_preprocessed);
             if (getenv("APEX_DEBUG_PIPELINE")) {
                 size_t len = strlen(text_ptr);
                 fprintf(stderr, "[APEX_DEBUG] after ial_preprocess (len=%zu): %.250s%s\n",
@@ -5010,34 +5107,41 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
             }
         }
 
-        PROFILE_START(grid_tables_preprocess);
-        grid_tables_processed = apex_preprocess_grid_tables(normalized_for_grid_tables ? normalized_for_grid_tables : text_ptr);
-        PROFILE_END(grid_tables_preprocess);
+        if (apex_features_any(&features, text_ptr, APEX_FEATURE_PLUS)) {
+            PROFILE_START(grid_tables_preprocess, normalized_for_grid_tables ? normalized_for_grid_tables : text_ptr);
+            grid_tables_processed = apex_preprocess_grid_tables(normalized_for_grid_tables ? normalized_for_grid_tables : text_ptr);
+            PROFILE_END(grid_tables_preprocess, grid_tables_processed);
+        } else {
+            /* No grid tables: keep only the trailing newline normalization */
+            grid_tables_processed = normalized_for_grid_tables;
+            normalized_for_grid_tables = NULL;
+        }
 
         if (normalized_for_grid_tables) {
             free(normalized_for_grid_tables);
         }
 
         if (grid_tables_processed) {
-            text_ptr = grid_tables_processed;
+            PIPELINE_ADVANCE(grid_tables_processed);
         }
     }
 
     /* Preprocess bracketed spans [text]{IAL} */
     char *spans_preprocessed = NULL;
-    if (options->enable_spans && apex_mode_is_kramdown_or_unified_family(options->mode)) {
-        PROFILE_START(spans_preprocess);
+    if (options->enable_spans && apex_mode_is_kramdown_or_unified_family(options->mode) &&
+        apex_features_all(&features, text_ptr, APEX_FEATURE_BRACKET | APEX_FEATURE_BRACE)) {
+        PROFILE_START(spans_preprocess, text_ptr);
         spans_preprocessed = apex_preprocess_bracketed_spans(text_ptr);
-        PROFILE_END(spans_preprocess);
+        PROFILE_END(spans_preprocess, spans_preprocessed);
         if (spans_preprocessed) {
-            text_ptr = spans_preprocessed;
+            PIPELINE_ADVANCE(spans_preprocessed);
         }
     }
 
     /* Process file includes before parsing (preprocessing) */
     char *includes_processed = NULL;
     if (options->enable_file_includes) {
-        PROFILE_START(includes);
+        PROFILE_START(includes, text_ptr);
         includes_processed = apex_process_includes(text_ptr,
                                                    options->base_directory,
                                                    metadata,
@@ -5045,31 +5149,34 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
                                                    options->wikilink_extension,
                                                    plugin_manager,
                                                    options);
-        PROFILE_END(includes);
+        PROFILE_END(includes, includes_processed);
         if (includes_processed) {
-            text_ptr = includes_processed;
+            PIPELINE_ADVANCE(includes_processed);
         }
     }
 
     /* Process special markers (^ end-of-block marker) and inline tables BEFORE alpha lists */
     /* This ensures ^ markers and inline table markers are converted before alpha list processing */
     char *markers_processed_early = NULL;
-    if (options->enable_marked_extensions) {
-        PROFILE_START(special_markers);
+    if (options->enable_marked_extensions &&
+        apex_features_any(&features, text_ptr, APEX_FEATURE_CARET | APEX_FEATURE_HTML_DECL | APEX_FEATURE_BRACE)) {
+        PROFILE_START(special_markers, text_ptr);
         markers_processed_early = apex_process_special_markers(text_ptr);
-        PROFILE_END(special_markers);
+        PROFILE_END(special_markers, markers_processed_early);
         if (markers_processed_early) {
-            text_ptr = markers_processed_early;
+            PIPELINE_ADVANCE(markers_processed_early);
         }
     }
 
     /* Process inline table fences and <!--TABLE--> markers before parsing */
     char *inline_tables_processed = NULL;
-    PROFILE_START(inline_tables);
-    inline_tables_processed = apex_process_inline_tables(text_ptr);
-    PROFILE_END(inline_tables);
-    if (inline_tables_processed) {
-        text_ptr = inline_tables_processed;
+    if (apex_features_any(&features, text_ptr, APEX_FEATURE_FENCE | APEX_FEATURE_HTML_DECL)) {
+        PROFILE_START(inline_tables, text_ptr);
+        inline_tables_processed = apex_process_inline_tables(text_ptr);
+        PROFILE_END(inline_tables, inline_tables_processed);
+        if (inline_tables_processed) {
+            PIPELINE_ADVANCE(inline_tables_processed);
+        }
     }
 
     /* Pandoc/Quarto list extensions before alpha/roman marker normalization */
@@ -5078,38 +5185,38 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     char *roman_lists_processed = NULL;
     char *strict_lists_processed = NULL;
     if (apex_quarto_feature(options, options->enable_quarto_example_lists)) {
-        PROFILE_START(example_lists_preprocess);
+        PROFILE_START(example_lists_preprocess, text_ptr);
         example_lists_processed = apex_preprocess_example_lists(text_ptr);
-        PROFILE_END(example_lists_preprocess);
+        PROFILE_END(example_lists_preprocess, example_lists_processed);
         if (example_lists_processed) {
-            text_ptr = example_lists_processed;
+            PIPELINE_ADVANCE(example_lists_processed);
         }
     }
 
     if (apex_quarto_feature(options, options->enable_quarto_line_blocks)) {
-        PROFILE_START(line_blocks_preprocess);
+        PROFILE_START(line_blocks_preprocess, text_ptr);
         line_blocks_processed = apex_preprocess_line_blocks(text_ptr, options->unsafe);
-        PROFILE_END(line_blocks_preprocess);
+        PROFILE_END(line_blocks_preprocess, line_blocks_processed);
         if (line_blocks_processed) {
-            text_ptr = line_blocks_processed;
+            PIPELINE_ADVANCE(line_blocks_processed);
         }
     }
 
     if (apex_quarto_feature(options, options->enable_quarto_roman_lists)) {
-        PROFILE_START(roman_lists_preprocess);
+        PROFILE_START(roman_lists_preprocess, text_ptr);
         roman_lists_processed = apex_preprocess_roman_lists(text_ptr);
-        PROFILE_END(roman_lists_preprocess);
+        PROFILE_END(roman_lists_preprocess, roman_lists_processed);
         if (roman_lists_processed) {
-            text_ptr = roman_lists_processed;
+            PIPELINE_ADVANCE(roman_lists_processed);
         }
     }
 
     if (apex_quarto_feature(options, options->enable_quarto_strict_lists)) {
-        PROFILE_START(quarto_strict_lists_preprocess);
+        PROFILE_START(quarto_strict_lists_preprocess, text_ptr);
         strict_lists_processed = apex_preprocess_quarto_strict_lists(text_ptr);
-        PROFILE_END(quarto_strict_lists_preprocess);
+        PROFILE_END(quarto_strict_lists_preprocess, strict_lists_processed);
         if (strict_lists_processed) {
-            text_ptr = strict_lists_processed;
+            PIPELINE_ADVANCE(strict_lists_processed);
         }
     }
 
@@ -5118,15 +5225,15 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     bool inserted_synthetic_nested_alpha_break = false;
     bool saw_explicit_nested_alpha_break = false;
     if (options->allow_alpha_lists) {
-        PROFILE_START(alpha_lists);
+        PROFILE_START(alpha_lists, text_ptr);
         alpha_lists_processed = apex_preprocess_alpha_lists(
             text_ptr,
             &inserted_synthetic_nested_alpha_break,
             &saw_explicit_nested_alpha_break
         );
-        PROFILE_END(alpha_lists);
+        PROFILE_END(alpha_lists, alpha_lists_processed);
         if (alpha_lists_processed) {
-            text_ptr = alpha_lists_processed;
+            PIPELINE_ADVANCE(alpha_lists_processed);
         }
     }
 
@@ -5136,62 +5243,74 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Process emoji autocorrect before parsing (preprocessing) */
     char *emoji_autocorrect_processed = NULL;
-    if (options->enable_emoji_autocorrect && (options->mode == APEX_MODE_GFM || apex_mode_is_unified_family(options->mode))) {
-        PROFILE_START(emoji_autocorrect);
+    if (options->enable_emoji_autocorrect && (options->mode == APEX_MODE_GFM || apex_mode_is_unified_family(options->mode)) &&
+        apex_features_any(&features, text_ptr, APEX_FEATURE_COLON)) {
+        PROFILE_START(emoji_autocorrect, text_ptr);
         emoji_autocorrect_processed = apex_autocorrect_emoji_names(text_ptr);
-        PROFILE_END(emoji_autocorrect);
+        PROFILE_END(emoji_autocorrect, emoji_autocorrect_processed);
         if (emoji_autocorrect_processed) {
-            text_ptr = emoji_autocorrect_processed;
+            PIPELINE_ADVANCE(emoji_autocorrect_processed);
         }
     }
 
     /* Process inline footnotes before parsing (Kramdown ^[...] and MMD [^... ...]) */
     char *inline_footnotes_processed = NULL;
-    if (options->enable_footnotes) {
-        PROFILE_START(inline_footnotes);
+    if (options->enable_footnotes && apex_features_any(&features, text_ptr, APEX_FEATURE_FOOTNOTE)) {
+        PROFILE_START(inline_footnotes, text_ptr);
         inline_footnotes_processed = apex_process_inline_footnotes(text_ptr);
-        PROFILE_END(inline_footnotes);
+        PROFILE_END(inline_footnotes, inline_footnotes_processed);
         if (inline_footnotes_processed) {
-            text_ptr = inline_footnotes_processed;
+            PIPELINE_ADVANCE(inline_footnotes_processed);
         }
     }
 
-    /* Process ==highlight== syntax before parsing
-     * Skip if proofreader mode is enabled (proofreader will handle it via CriticMarkup) */
-    char *highlights_processed = NULL;
-    if (!options->proofreader_mode) {
-        PROFILE_START(highlights);
-        highlights_processed = apex_process_highlights(text_ptr);
-        PROFILE_END(highlights);
-        if (highlights_processed) {
-            text_ptr = highlights_processed;
+    /* ==highlight== and ++insert++ are line stages: run whichever are
+     * present fused in a single pass over the text. Highlights are skipped
+     * in proofreader mode (proofreader will handle them via CriticMarkup). */
+    char *inline_marks_processed = NULL;
+    bool run_highlights = !options->proofreader_mode &&
+                          apex_features_any(&features, text_ptr, APEX_FEATURE_DOUBLE_EQUALS);
+    bool run_inserts = apex_features_any(&features, text_ptr, APEX_FEATURE_DOUBLE_PLUS);
+    if (run_highlights || run_inserts) {
+        apex_preprocessor *mark_stages = apex_preprocessor_new();
+        apex_highlight_state highlight_state;
+        apex_insert_state insert_state;
+        if (mark_stages) {
+            if (run_highlights) {
+                apex_highlight_state_init(&highlight_state);
+                apex_highlights_add_stage(mark_stages, &highlight_state);
+            }
+            if (run_inserts) {
+                apex_insert_state_init(&insert_state);
+                apex_inserts_add_stage(mark_stages, &insert_state);
+            }
+            PROFILE_START(inline_marks, text_ptr);
+            inline_marks_processed = apex_preprocessor_run(mark_stages, text_ptr, strlen(text_ptr));
+            PROFILE_END(inline_marks, inline_marks_processed);
+            apex_preprocessor_free(mark_stages);
+        }
+        if (inline_marks_processed) {
+            PIPELINE_ADVANCE(inline_marks_processed);
         }
-    }
-
-    /* Process ++insert++ syntax before parsing */
-    char *inserts_processed = NULL;
-    PROFILE_START(inserts);
-    inserts_processed = apex_process_inserts(text_ptr);
-    PROFILE_END(inserts);
-    if (inserts_processed) {
-        text_ptr = inserts_processed;
     }
 
     /* Process superscript and subscript syntax before parsing */
     char *sup_sub_processed = NULL;
-    if (options->enable_sup_sub) {
-        PROFILE_START(sup_sub);
+    if (options->enable_sup_sub &&
+        apex_features_any(&features, text_ptr, APEX_FEATURE_CARET | APEX_FEATURE_TILDE)) {
+        PROFILE_START(sup_sub, text_ptr);
         sup_sub_processed = apex_process_sup_sub(text_ptr);
-        PROFILE_END(sup_sub);
+        PROFILE_END(sup_sub, sup_sub_processed);
         if (sup_sub_processed) {
-            text_ptr = sup_sub_processed;
+            PIPELINE_ADVANCE(sup_sub_processed);
         }
     }
 
     /* Process relaxed tables before parsing (preprocessing) */
     char *relaxed_tables_processed = NULL;
     char *normalized_for_relaxed = NULL;
-    if (options->relaxed_tables && options->enable_tables) {
+    if (options->relaxed_tables && options->enable_tables &&
+        apex_features_any(&features, text_ptr, APEX_FEATURE_PIPE)) {
         /* Normalize text_ptr for relaxed tables processing if it doesn't end with newline */
         size_t pre_relaxed_len = strlen(text_ptr);
         bool needs_newline_for_relaxed = (pre_relaxed_len > 0 &&
@@ -5207,9 +5326,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         }
 
         PROGRESS_REPORT("Processing relaxed tables", -1);
-        PROFILE_START(relaxed_tables);
+        PROFILE_START(relaxed_tables, normalized_for_relaxed ? normalized_for_relaxed : text_ptr);
         relaxed_tables_processed = apex_process_relaxed_tables(normalized_for_relaxed ? normalized_for_relaxed : text_ptr);
-        PROFILE_END(relaxed_tables);
+        PROFILE_END(relaxed_tables, relaxed_tables_processed);
         /* Refresh progress after processing completes (in case it took a while) */
         PROGRESS_REPORT(NULL, -1);  /* NULL stage = refresh last known stage */
 
@@ -5225,7 +5344,7 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         }
 
         if (relaxed_tables_processed) {
-            text_ptr = relaxed_tables_processed;
+            PIPELINE_ADVANCE(relaxed_tables_processed);
         }
     }
 
@@ -5235,7 +5354,7 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
      */
     char *headerless_tables_processed = NULL;
     char *normalized_for_headerless = NULL;
-    if (options->enable_tables) {
+    if (options->enable_tables && apex_features_any(&features, text_ptr, APEX_FEATURE_PIPE)) {
         /* Normalize text_ptr for headerless tables processing if it doesn't end with newline */
         size_t pre_headerless_len = strlen(text_ptr);
         bool needs_newline_for_headerless = (pre_headerless_len > 0 &&
@@ -5250,9 +5369,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
             }
         }
 
-        PROFILE_START(headerless_tables);
+        PROFILE_START(headerless_tables, normalized_for_headerless ? normalized_for_headerless : text_ptr);
         headerless_tables_processed = apex_process_headerless_tables(normalized_for_headerless ? normalized_for_headerless : text_ptr);
-        PROFILE_END(headerless_tables);
+        PROFILE_END(headerless_tables, headerless_tables_processed);
 
         /* Handle cleanup */
         if (normalized_for_headerless) {
@@ -5266,7 +5385,7 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         }
 
         if (headerless_tables_processed) {
-            text_ptr = headerless_tables_processed;
+            PIPELINE_ADVANCE(headerless_tables_processed);
         }
     }
 
@@ -5275,7 +5394,7 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
      */
     char *table_colspans_processed = NULL;
     char *normalized_for_colspans = NULL;
-    if (options->enable_tables) {
+    if (options->enable_tables && apex_features_any(&features, text_ptr, APEX_FEATURE_PIPE)) {
         /* Normalize text_ptr for table colspan preprocessing if it doesn't end with newline */
         size_t pre_colspans_len = strlen(text_ptr);
         bool needs_newline_for_colspans = (pre_colspans_len > 0 &&
@@ -5290,9 +5409,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
             }
         }
 
-        PROFILE_START(table_colspans_preprocess);
+        PROFILE_START(table_colspans_preprocess, normalized_for_colspans ? normalized_for_colspans : text_ptr);
         table_colspans_processed = apex_preprocess_table_colspans(normalized_for_colspans ? normalized_for_colspans : text_ptr);
-        PROFILE_END(table_colspans_preprocess);
+        PROFILE_END(table_colspans_preprocess, table_colspans_processed);
 
         /* Handle cleanup */
         if (normalized_for_colspans) {
@@ -5304,7 +5423,7 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         }
 
         if (table_colspans_processed) {
-            text_ptr = table_colspans_processed;
+            PIPELINE_ADVANCE(table_colspans_processed);
         }
     }
 
@@ -5332,9 +5451,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
             }
         }
 
-        PROFILE_START(table_captions_preprocess);
+        PROFILE_START(table_captions_preprocess, normalized_for_caption ? normalized_for_caption : text_ptr);
         table_captions_processed = apex_preprocess_table_captions(normalized_for_caption ? normalized_for_caption : text_ptr);
-        PROFILE_END(table_captions_preprocess);
+        PROFILE_END(table_captions_preprocess, table_captions_processed);
 
         /* Handle cleanup: apex_preprocess_table_captions always returns a new allocated buffer (or NULL on malloc failure) */
         if (normalized_for_caption) {
@@ -5348,460 +5467,128 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         }
 
         if (table_captions_processed) {
-            text_ptr = table_captions_processed;
+            PIPELINE_ADVANCE(table_captions_processed);
         }
     }
 
     /* Process definition lists before parsing (preprocessing) */
     char *deflist_processed = NULL;
-    if (options->enable_definition_lists) {
-        PROFILE_START(definition_lists);
+    if (options->enable_definition_lists && apex_features_any(&features, text_ptr, APEX_FEATURE_COLON)) {
+        PROFILE_START(definition_lists, text_ptr);
         deflist_processed = apex_process_definition_lists(text_ptr, options->unsafe);
-        PROFILE_END(definition_lists);
+        PROFILE_END(definition_lists, deflist_processed);
         if (deflist_processed) {
-            text_ptr = deflist_processed;
+            PIPELINE_ADVANCE(deflist_processed);
         }
     }
 
     /* Pandoc/Quarto raw content ({=format}) before other fence preprocessors */
     char *raw_content_processed = NULL;
     char *code_fence_attrs_processed = NULL;
-    char *quarto_diagrams_processed = NULL;
-    if (apex_quarto_feature(options, options->enable_quarto_raw)) {
-        PROFILE_START(raw_content_preprocess);
-        raw_content_processed = apex_preprocess_raw_content(text_ptr, options->unsafe);
-        PROFILE_END(raw_content_preprocess);
-        if (raw_content_processed) {
-            text_ptr = raw_content_processed;
-        }
-    }
-
-    if (apex_quarto_feature(options, options->enable_quarto_code_attrs)) {
-        PROFILE_START(code_fence_attrs_preprocess);
-        code_fence_attrs_processed = apex_preprocess_code_fence_attrs(text_ptr);
-        PROFILE_END(code_fence_attrs_preprocess);
-        if (code_fence_attrs_processed) {
-            text_ptr = code_fence_attrs_processed;
-        }
-    }
-
-    if (apex_quarto_feature(options, options->enable_quarto_diagrams)) {
-        PROFILE_START(quarto_diagrams_preprocess);
-        quarto_diagrams_processed = apex_preprocess_quarto_diagrams(text_ptr, options->unsafe);
-        PROFILE_END(quarto_diagrams_preprocess);
-        if (quarto_diagrams_processed) {
-            text_ptr = quarto_diagrams_processed;
-        }
-    }
-
-    /* Process Quarto ::: callouts before fenced divs so recognized callouts bypass generic div conversion */
-    char *quarto_callouts_processed = NULL;
-    if (options->enable_quarto_callouts) {
-        PROFILE_START(quarto_callouts_preprocess);
-        quarto_callouts_processed = apex_preprocess_quarto_callouts(text_ptr);
-        PROFILE_END(quarto_callouts_preprocess);
-        if (quarto_callouts_processed) {
-            text_ptr = quarto_callouts_processed;
-        }
-    }
-
-    /* Process fenced divs before parsing (preprocessing) */
-    /* Only enabled in Unified mode */
-    char *fenced_divs_processed = NULL;
-    if (options->enable_divs && apex_mode_is_unified_family(options->mode)) {
-        PROFILE_START(fenced_divs);
-        fenced_divs_processed = apex_process_fenced_divs(text_ptr);
-        PROFILE_END(fenced_divs);
-        if (fenced_divs_processed) {
-            text_ptr = fenced_divs_processed;
-        }
-    }
-
-    /* Process HTML markdown attributes before parsing (preprocessing) */
-    char *html_markdown_processed = NULL;
-    if (options->enable_markdown_in_html) {
-        PROFILE_START(html_markdown);
-        html_markdown_processed = apex_process_html_markdown(text_ptr, img_attrs);
-        PROFILE_END(html_markdown);
-        if (html_markdown_processed) {
-            text_ptr = html_markdown_processed;
-        }
-    }
-
-    /* Process hashtags: convert #tags to span-wrapped hashtags */
-    char *hashtags_processed = NULL;
-    if (options->enable_hashtags && text_ptr) {
-        PROFILE_START(hashtags);
-        size_t len = strlen(text_ptr);
-        size_t capacity = len * 3 + 1;  /* Allow expansion with span tags */
-        char *output = malloc(capacity);
-        if (output) {
-            const char *read = text_ptr;
-            char *write = output;
-            size_t remaining = capacity;
-            bool in_code_block = false;
-            int indent_count = 0;
-            bool at_line_start = true;
-
-            while (*read) {
-                /* Track code blocks (4+ spaces or tab at line start) */
-                if (at_line_start) {
-                    if (*read == '\t') {
-                        in_code_block = true;
-                        indent_count = 0;
-                    } else if (*read == ' ') {
-                        indent_count++;
-                        if (indent_count >= 4) {
-                            in_code_block = true;
-                        }
-                    } else if (*read != '\n' && *read != '\r') {
-                        at_line_start = false;
-                        indent_count = 0;
-                    }
-                }
-
-                if (*read == '\n') {
-                    at_line_start = true;
-                    indent_count = 0;
-                    in_code_block = false;
-                }
-
-                /* Skip hashtag processing inside code blocks */
-                if (in_code_block) {
-                    if (remaining < 10) {
-                        size_t written = (size_t)(write - output);
-                        capacity = (written + 100) * 2;
-                        char *new_output = realloc(output, capacity);
-                        if (!new_output) {
-                            free(output);
-                            output = NULL;
-                            break;
-                        }
-                        output = new_output;
-                        write = output + written;
-                        remaining = capacity - written;
-                    }
-                    *write++ = *read++;
-                    remaining--;
-                    continue;
-                }
-
-                /* Check for hashtag pattern: # followed by alphanumeric, not preceded by non-whitespace */
-                /* Pattern: (?<=\s|^)#[a-zA-Z0-9][^# \n,;.!\)\]]* */
-                if (*read == '#' && (read == text_ptr || read[-1] == ' ' || read[-1] == '\t' || read[-1] == '\n')) {
-                    const char *tag_start = read;
-                    read++;  /* Skip # */
-
-                    /* Check if it's a valid hashtag start (alphanumeric) */
-                    if ((*read >= 'a' && *read <= 'z') || (*read >= 'A' && *read <= 'Z') || (*read >= '0' && *read <= '9')) {
-                        /* Find the end of the hashtag */
-                        const char *tag_end = read;
-                        while (*tag_end && *tag_end != '#' && *tag_end != ' ' && *tag_end != '\n' &&
-                               *tag_end != ',' && *tag_end != ';' && *tag_end != '.' && *tag_end != '!' &&
-                               *tag_end != ')' && *tag_end != ']') {
-                            tag_end++;
-                        }
-
-                        /* Check for special case: #tag# format (wrapped in #) */
-                        if (*tag_end == '#') {
-                            tag_end++;  /* Include the closing # */
-                        }
-
-                        if (tag_end > read) {
-                            /* Valid hashtag found */
-                            size_t tag_len = (size_t)(tag_end - tag_start);
-                            const char *class_name = options->style_hashtags ? "mkstyledtag" : "mkhashtag";
-                            size_t span_prefix_len = strlen("<span class=\"") + strlen(class_name) + strlen("\">");
-                            size_t span_suffix_len = strlen("</span>");
-                            size_t needed = span_prefix_len + tag_len + span_suffix_len;
-
-                            if (needed >= remaining) {
-                                size_t written = (size_t)(write - output);
-                                capacity = (written + needed + 100) * 2;
-                                char *new_output = realloc(output, capacity);
-                                if (!new_output) {
-                                    free(output);
-                                    output = NULL;
-                                    break;
-                                }
-                                output = new_output;
-                                write = output + written;
-                                remaining = capacity - written;
-                            }
-
-                            /* Write opening span */
-                            memcpy(write, "<span class=\"", 13);
-                            write += 13;
-                            remaining -= 13;
-                            memcpy(write, class_name, strlen(class_name));
-                            write += strlen(class_name);
-                            remaining -= strlen(class_name);
-                            memcpy(write, "\">", 2);
-                            write += 2;
-                            remaining -= 2;
-
-                            /* Write the hashtag */
-                            memcpy(write, tag_start, tag_len);
-                            write += tag_len;
-                            remaining -= tag_len;
-
-                            /* Write closing span */
-                            memcpy(write, "</span>", 7);
-                            write += 7;
-                            remaining -= 7;
-
-                            read = tag_end;
-                            continue;
-                        }
-                    }
-                    /* Not a valid hashtag, copy the # */
-                    if (remaining < 10) {
-                        size_t written = (size_t)(write - output);
-                        capacity = (written + 100) * 2;
-                        char *new_output = realloc(output, capacity);
-                        if (!new_output) {
-                            free(output);
-                            output = NULL;
-                            break;
-                        }
-                        output = new_output;
-                        write = output + written;
-                        remaining = capacity - written;
-                    }
-                    *write++ = *tag_start;
-                    remaining--;
-                    read = tag_start + 1;
-                } else {
-                    /* Normal character, copy as-is */
-                    if (remaining < 10) {
-                        size_t written = (size_t)(write - output);
-                        capacity = (written + 100) * 2;
-                        char *new_output = realloc(output, capacity);
-                        if (!new_output) {
-                            free(output);
-                            output = NULL;
-                            break;
-                        }
-                        output = new_output;
-                        write = output + written;
-                        remaining = capacity - written;
-                    }
-                    *write++ = *read++;
-                    remaining--;
-                }
-            }
-            if (output) {
-                *write = '\0';
-                hashtags_processed = output;
-            }
-        }
-        PROFILE_END(hashtags);
-        if (hashtags_processed) {
-            text_ptr = hashtags_processed;
-        }
-    }
-
-    /* Process proofreader mode: convert == and ~~ to CriticMarkup syntax */
-    char *proofreader_processed = NULL;
-    if (options->proofreader_mode && text_ptr) {
-        PROFILE_START(proofreader);
-        size_t len = strlen(text_ptr);
-        size_t capacity = len * 2 + 1;  /* Allow expansion */
-        char *output = malloc(capacity);
-        if (output) {
-            const char *read = text_ptr;
-            char *write = output;
-            size_t remaining = capacity;
-            bool in_code_block = false;
-            bool in_inline_code = false;
-            int backtick_count = 0;
-
-            while (*read) {
-                /* Track code blocks and inline code to skip processing inside them */
-                if (*read == '`') {
-                    backtick_count++;
-                    if (backtick_count >= 3) {
-                        /* Code block fence */
-                        in_code_block = !in_code_block;
-                        backtick_count = 0;
-                    } else if (!in_code_block) {
-                        /* Check for inline code */
-                        const char *next = read + 1;
-                        if (*next != '`') {
-                            in_inline_code = !in_inline_code;
-                            backtick_count = 0;
-                        }
-                    }
-                } else {
-                    backtick_count = 0;
-                }
-
-                if (in_code_block || in_inline_code) {
-                    /* Inside code, copy as-is */
-                    if (remaining < 10) {
-                        size_t written = (size_t)(write - output);
-                        capacity = (written + 100) * 2;
-                        char *new_output = realloc(output, capacity);
-                        if (!new_output) {
-                            free(output);
-                            output = NULL;
-                            break;
-                        }
-                        output = new_output;
-                        write = output + written;
-                        remaining = capacity - written;
-                    }
-                    *write++ = *read++;
-                    remaining--;
-                } else if (read[0] == '=' && read[1] == '=') {
-                    /* Found ==, convert to {== */
-                    const char *start = read;
-                    read += 2;
-                    /* Find matching == */
-                    const char *end = strstr(read, "==");
-                    if (end) {
-                        /* Found matching ==, wrap in {==...==} */
-                        size_t content_len = (size_t)(end - read);
-                        size_t needed = 2 + content_len + 2;  /* {== + content + ==} */
-                        if (needed >= remaining) {
-                            size_t written = (size_t)(write - output);
-                            capacity = (written + needed + 100) * 2;
-                            char *new_output = realloc(output, capacity);
-                            if (!new_output) {
-                                free(output);
-                                output = NULL;
-                                break;
-                            }
-                            output = new_output;
-                            write = output + written;
-                            remaining = capacity - written;
-                        }
-                        *write++ = '{';
-                        *write++ = '=';
-                        *write++ = '=';
-                        remaining -= 3;
-                        memcpy(write, read, content_len);
-                        write += content_len;
-                        remaining -= content_len;
-                        *write++ = '=';
-                        *write++ = '=';
-                        *write++ = '}';
-                        remaining -= 3;
-                        read = end + 2;
-                    } else {
-                        /* No matching ==, copy as-is */
-                        if (remaining < 10) {
-                            size_t written = (size_t)(write - output);
-                            capacity = (written + 100) * 2;
-                            char *new_output = realloc(output, capacity);
-                            if (!new_output) {
-                                free(output);
-                                output = NULL;
-                                break;
-                            }
-                            output = new_output;
-                            write = output + written;
-                            remaining = capacity - written;
-                        }
-                        *write++ = *start++;
-                        *write++ = *start;
-                        remaining -= 2;
-                        read = start + 1;
-                    }
-                } else if (read[0] == '~' && read[1] == '~') {
-                    /* Found ~~, convert to {-- */
-                    const char *start = read;
-                    read += 2;
-                    /* Find matching ~~ */
-                    const char *end = strstr(read, "~~");
-                    if (end) {
-                        /* Found matching ~~, wrap in {--...--} */
-                        size_t content_len = (size_t)(end - read);
-                        size_t needed = 2 + content_len + 2;  /* {-- + content + --} */
-                        if (needed >= remaining) {
-                            size_t written = (size_t)(write - output);
-                            capacity = (written + needed + 100) * 2;
-                            char *new_output = realloc(output, capacity);
-                            if (!new_output) {
-                                free(output);
-                                output = NULL;
-                                break;
-                            }
-                            output = new_output;
-                            write = output + written;
-                            remaining = capacity - written;
-                        }
-                        *write++ = '{';
-                        *write++ = '-';
-                        *write++ = '-';
-                        remaining -= 3;
-                        memcpy(write, read, content_len);
-                        write += content_len;
-                        remaining -= content_len;
-                        *write++ = '-';
-                        *write++ = '-';
-                        *write++ = '}';
-                        remaining -= 3;
-                        read = end + 2;
-                    } else {
-                        /* No matching ~~, copy as-is */
-                        if (remaining < 10) {
-                            size_t written = (size_t)(write - output);
-                            capacity = (written + 100) * 2;
-                            char *new_output = realloc(output, capacity);
-                            if (!new_output) {
-                                free(output);
-                                output = NULL;
-                                break;
-                            }
-                            output = new_output;
-                            write = output + written;
-                            remaining = capacity - written;
-                        }
-                        *write++ = *start++;
-                        *write++ = *start;
-                        remaining -= 2;
-                        read = start + 1;
-                    }
-                } else {
-                    /* Normal character, copy as-is */
-                    if (remaining < 10) {
-                        size_t written = (size_t)(write - output);
-                        capacity = (written + 100) * 2;
-                        char *new_output = realloc(output, capacity);
-                        if (!new_output) {
-                            free(output);
-                            output = NULL;
-                            break;
-                        }
-                        output = new_output;
-                        write = output + written;
-                        remaining = capacity - written;
-                    }
-                    *write++ = *read++;
-                    remaining--;
-                }
-            }
-            if (output) {
-                *write = '\0';
-                proofreader_processed = output;
-            }
+    char *quarto_diagrams_processed = NULL;
+    if (apex_quarto_feature(options, options->enable_quarto_raw)) {
+        PROFILE_START(raw_content_preprocess, text_ptr);
+        raw_content_processed = apex_preprocess_raw_content(text_ptr, options->unsafe);
+        PROFILE_END(raw_content_preprocess, raw_content_processed);
+        if (raw_content_processed) {
+            PIPELINE_ADVANCE(raw_content_processed);
+        }
+    }
+
+    if (apex_quarto_feature(options, options->enable_quarto_code_attrs)) {
+        PROFILE_START(code_fence_attrs_preprocess, text_ptr);
+        code_fence_attrs_processed = apex_preprocess_code_fence_attrs(text_ptr);
+        PROFILE_END(code_fence_attrs_preprocess, code_fence_attrs_processed);
+        if (code_fence_attrs_processed) {
+            PIPELINE_ADVANCE(code_fence_attrs_processed);
+        }
+    }
+
+    if (apex_quarto_feature(options, options->enable_quarto_diagrams)) {
+        PROFILE_START(quarto_diagrams_preprocess, text_ptr);
+        quarto_diagrams_processed = apex_preprocess_quarto_diagrams(text_ptr, options->unsafe);
+        PROFILE_END(quarto_diagrams_preprocess, quarto_diagrams_processed);
+        if (quarto_diagrams_processed) {
+            PIPELINE_ADVANCE(quarto_diagrams_processed);
+        }
+    }
+
+    /* Process Quarto ::: callouts before fenced divs so recognized callouts bypass generic div conversion */
+    char *quarto_callouts_processed = NULL;
+    if (options->enable_quarto_callouts && apex_features_any(&features, text_ptr, APEX_FEATURE_DOUBLE_COLON)) {
+        PROFILE_START(quarto_callouts_preprocess, text_ptr);
+        quarto_callouts_processed = apex_preprocess_quarto_callouts(text_ptr);
+        PROFILE_END(quarto_callouts_preprocess, quarto_callouts_processed);
+        if (quarto_callouts_processed) {
+            PIPELINE_ADVANCE(quarto_callouts_processed);
+        }
+    }
+
+    /* Process fenced divs before parsing (preprocessing) */
+    /* Only enabled in Unified mode */
+    char *fenced_divs_processed = NULL;
+    if (options->enable_divs && apex_mode_is_unified_family(options->mode) &&
+        apex_features_any(&features, text_ptr, APEX_FEATURE_DOUBLE_COLON)) {
+        PROFILE_START(fenced_divs, text_ptr);
+        fenced_divs_processed = apex_process_fenced_divs(text_ptr);
+        PROFILE_END(fenced_divs, fenced_divs_processed);
+        if (fenced_divs_processed) {
+            PIPELINE_ADVANCE(fenced_divs_processed);
+        }
+    }
+
+    /* Process HTML markdown attributes before parsing (preprocessing) */
+    char *html_markdown_processed = NULL;
+    if (options->enable_markdown_in_html && apex_features_any(&features, text_ptr, APEX_FEATURE_LT)) {
+        PROFILE_START(html_markdown, text_ptr);
+        html_markdown_processed = apex_process_html_markdown(text_ptr, img_attrs);
+        PROFILE_END(html_markdown, html_markdown_processed);
+        if (html_markdown_processed) {
+            PIPELINE_ADVANCE(html_markdown_processed);
         }
-        PROFILE_END(proofreader);
-        if (proofreader_processed) {
-            text_ptr = proofreader_processed;
+    }
+
+    /* Hashtags and proofreader markup are line-streaming stages: register
+     * whichever are enabled and run them fused in a single pass over the text.
+     */
+    char *line_stages_processed = NULL;
+    bool run_hashtags = options->enable_hashtags &&
+                        apex_features_any(&features, text_ptr, APEX_FEATURE_HASH);
+    bool run_proofreader = options->proofreader_mode &&
+                           apex_features_any(&features, text_ptr,
+                                             APEX_FEATURE_DOUBLE_EQUALS | APEX_FEATURE_DOUBLE_TILDE);
+    if ((run_hashtags || run_proofreader) && text_ptr) {
+        apex_preprocessor *line_stages = apex_preprocessor_new();
+        apex_proofreader_state proofreader_state;
+        if (line_stages) {
+            /* Hashtags: convert #tags to span-wrapped hashtags */
+            if (run_hashtags) {
+                apex_hashtags_add_stage(line_stages, options->style_hashtags);
+            }
+            /* Proofreader mode: convert == and ~~ to CriticMarkup syntax */
+            if (run_proofreader) {
+                apex_proofreader_state_init(&proofreader_state);
+                apex_proofreader_add_stage(line_stages, &proofreader_state);
+            }
+            PROFILE_START(line_stages, text_ptr);
+            line_stages_processed = apex_preprocessor_run(line_stages, text_ptr, strlen(text_ptr));
+            PROFILE_END(line_stages, line_stages_processed);
+            apex_preprocessor_free(line_stages);
+        }
+        if (line_stages_processed) {
+            PIPELINE_ADVANCE(line_stages_processed);
         }
     }
 
     /* Process Critic Markup before parsing (preprocessing) */
     char *critic_processed = NULL;
-    if (options->enable_critic_markup) {
-        PROFILE_START(critic);
+    if (options->enable_critic_markup && apex_features_any(&features, text_ptr, APEX_FEATURE_CRITIC)) {
+        PROFILE_START(critic, text_ptr);
         critic_mode_t critic_mode = (critic_mode_t)options->critic_mode;
         critic_processed = apex_process_critic_markup_text(text_ptr, critic_mode);
-        PROFILE_END(critic);
+        PROFILE_END(critic, critic_processed);
         if (critic_processed) {
-            text_ptr = critic_processed;
+            PIPELINE_ADVANCE(critic_processed);
         }
     }
 
@@ -5811,20 +5598,20 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
      */
     liquid_protected = apex_protect_liquid_tags(text_ptr, &liquid_tags, &liquid_tag_count);
     if (liquid_protected) {
-        text_ptr = liquid_protected;
+        PIPELINE_ADVANCE(liquid_protected);
     }
 
     /* Keep this late so later preprocessors do not collapse inserted separation. */
     if (apex_mode_is_unified_family(options->mode)) {
-        PROFILE_START(nested_ordered_sublists);
+        PROFILE_START(nested_ordered_sublists, text_ptr);
         nested_ordered_sublists_processed = apex_preprocess_nested_ordered_sublists(
             text_ptr,
             &inserted_synthetic_nested_ordered_break,
             &saw_explicit_nested_ordered_break
         );
-        PROFILE_END(nested_ordered_sublists);
+        PROFILE_END(nested_ordered_sublists, nested_ordered_sublists_processed);
         if (nested_ordered_sublists_processed) {
-            text_ptr = nested_ordered_sublists_processed;
+            PIPELINE_ADVANCE(nested_ordered_sublists_processed);
         }
     }
 
@@ -5847,7 +5634,7 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         if (final_normalized) {
             final_normalized[0] = '\n';
             final_normalized[1] = '\0';
-            text_ptr = final_normalized;
+            PIPELINE_ADVANCE(final_normalized);
             text_len = 1;
         }
     } else {
@@ -5860,7 +5647,7 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
                 memcpy(final_normalized, text_ptr, text_len);
                 final_normalized[text_len] = '\n';
                 final_normalized[text_len + 1] = '\0';
-                text_ptr = final_normalized;
+                PIPELINE_ADVANCE(final_normalized);
                 text_len = text_len + 1;
             } else {
                 /* If malloc fails, we can't normalize - but this should never happen in practice */
@@ -5874,16 +5661,23 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Protect backslash-escaped {{TOC...}} markers before parsing */
     if (options->enable_marked_extensions || options->mode == APEX_MODE_MULTIMARKDOWN) {
-        escaped_toc_protected = apex_protect_escaped_toc_markers(text_ptr);
+        escaped_toc_protected = apex_protect_escaped_toc_markers(text_ptr, &escaped_tocs);
         if (escaped_toc_protected) {
-            text_ptr = escaped_toc_protected;
+            PIPELINE_ADVANCE(escaped_toc_protected);
             text_len = strlen(text_ptr);
         }
     }
 
+    /* Features of the text handed to the parser, for the AST and HTML stages
+     * (text_ptr may point at final_normalized, which is freed after parsing) */
+    apex_feature_bits parsed_features = apex_features_get(&features, text_ptr);
+#undef PIPELINE_ADVANCE
+
     /* Create parser */
-    PROFILE_START(parsing);
-    cmark_parser *parser = cmark_parser_new(cmark_opts);
+    PROFILE_START(parsing, text_ptr);
+    /* With statistics on, the parser's allocator counts the AST allocations */
+    cmark_parser *parser = prof ? cmark_parser_new_with_mem(cmark_opts, apex_stats_allocator())
+                                : cmark_parser_new(cmark_opts);
     if (!parser) {
         if (final_normalized) free(final_normalized);
         free(working_text);
@@ -5892,7 +5686,7 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     }
 
     /* Register extensions based on mode and options */
-    apex_register_extensions(parser, options);
+    apex_register_extensions(parser, options, converter);
 
     if (options->cmark_init) {
         options->cmark_init(parser, options, cmark_opts, options->cmark_user_data);
@@ -5903,9 +5697,23 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         fprintf(stderr, "[APEX_DEBUG] markdown to parse (len=%zu): %.350s%s\n",
                 text_len, text_ptr, text_len > 350 ? "..." : "");
     }
-    cmark_parser_feed(parser, text_len ? text_ptr : "", text_len);
-    cmark_node *document = cmark_parser_finish(parser);
-    PROFILE_END(parsing);
+    cmark_node *document = NULL;
+    /* Footnote definitions are resolved when the whole document is
+     * finalized, and custom extensions may keep per-parser state, so those
+     * documents are always parsed in one piece */
+    if (options->parse_threads > 1 && !options->cmark_init &&
+        !(options->enable_footnotes && (parsed_features & APEX_FEATURE_FOOTNOTE))) {
+        document = apex_parse_chunked(parser, text_ptr, text_len, options, converter, cmark_opts);
+    }
+    if (!document) {
+        cmark_parser_feed(parser, text_len ? text_ptr : "", text_len);
+        document = apex_parser_finish(parser);
+    }
+    PROFILE_END(parsing, NULL);
+
+    if (section && document && options->enable_footnotes) {
+        section->footnote_refs = apex_footnote_reference_labels(document, &section->footnote_ref_count);
+    }
 
     /* Free normalized buffer if we allocated it (after parser is finished) */
     if (final_normalized) {
@@ -5954,7 +5762,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         } else if (options->output_format == APEX_OUTPUT_RTF) {
             target_format = "rtf";
         }
+        PROFILE_START(ast_filters, NULL);
         cmark_node *filtered = apex_run_ast_filters(document, options, target_format);
+        PROFILE_END(ast_filters, NULL);
         if (!filtered && options->ast_filter_strict) {
             cmark_node_free(document);
             if (options->cmark_done) {
@@ -5974,7 +5784,7 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     /* Postprocess wiki links if enabled */
     if (options->enable_wiki_links) {
         /* Fast path: skip AST walk if no wiki link markers present */
-        if (strstr(text_ptr, "[[") != NULL) {
+        if ((parsed_features & APEX_FEATURE_DOUBLE_BRACKET)) {
             PROGRESS_REPORT("Processing wiki links", -1);
             /* Create wiki link configuration from options */
             wiki_link_config wiki_config;
@@ -5998,12 +5808,10 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     if (alds || apex_mode_is_kramdown_or_unified_family(options->mode)) {
         /* Fast path: skip AST walk if no IAL markers present */
         /* Check for both Kramdown-style ({:) and Pandoc-style ({# or {.) IALs */
-        if (strstr(text_ptr, "{:") != NULL ||
-            strstr(text_ptr, "{#") != NULL ||
-            strstr(text_ptr, "{.") != NULL) {
-            PROFILE_START(ial);
+        if ((parsed_features & APEX_FEATURE_IAL)) {
+            PROFILE_START(ial, NULL);
             apex_process_ial_in_tree(document, alds);
-            PROFILE_END(ial);
+            PROFILE_END(ial, NULL);
         }
     }
 
@@ -6024,9 +5832,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Apply image attributes to image nodes */
     if (img_attrs) {
-        PROFILE_START(image_attrs);
+        PROFILE_START(image_attrs, NULL);
         apex_apply_image_attributes(document, img_attrs);
-        PROFILE_END(image_attrs);
+        PROFILE_END(image_attrs, NULL);
     }
 
     /* Merge lists with mixed markers if enabled */
@@ -6111,17 +5919,18 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Render to HTML
      * Use custom renderer when we have attributes (IAL, ALDs, or image attributes)
-     * Otherwise use standard renderer
+     * or tables, whose spans, tfoot and captions it emits; otherwise use standard renderer
      */
-    PROFILE_START(rendering);
+    PROFILE_START(rendering, NULL);
     char *html;
-    if (img_attrs || alds || apex_mode_is_kramdown_or_unified_family(options->mode)) {
+    if (img_attrs || alds || options->enable_tables ||
+        apex_mode_is_kramdown_or_unified_family(options->mode)) {
         /* Use custom renderer to inject attributes */
-        html = apex_render_html_with_attributes(document, cmark_opts);
+        html = apex_render_html_with_caption_position(document, cmark_opts, options->caption_position);
     } else {
         html = cmark_render_html(document, cmark_opts, NULL);
     }
-    PROFILE_END(rendering);
+    PROFILE_END(rendering, html);
 
     if (getenv("APEX_DEBUG_PIPELINE")) {
         size_t html_len = html ? strlen(html) : 0;
@@ -6149,96 +5958,17 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         }
     }
 
-    /* Post-process HTML for advanced table attributes (rowspan/colspan) */
-    if (options->enable_tables && html) {
-        PROFILE_START(inject_table_attributes);
-        extern char *apex_inject_table_attributes(const char *html, cmark_node *document, int caption_position);
-        char *processed_html = apex_inject_table_attributes(html, document, options->caption_position);
-        PROFILE_END(inject_table_attributes);
-        if (processed_html && processed_html != html) {
-            free(html);
-            html = processed_html;
-        }
-    }
-
-    /* Replace <hr> elements with Marked-style page breaks if requested */
-    if (options->hr_page_break && html) {
-        PROFILE_START(hr_page_break);
-        char *processed_html = apex_replace_hr_with_pagebreak(html);
-        PROFILE_END(hr_page_break);
-        if (processed_html && processed_html != html) {
-            free(html);
-            html = processed_html;
-        }
-    }
-
     /* Apply widont to headings if requested */
     if (options->enable_widont && html) {
-        PROFILE_START(widont);
+        PROFILE_START(widont, html);
         char *processed_html = apex_apply_widont_to_headings(html);
-        PROFILE_END(widont);
-        if (processed_html && processed_html != html) {
-            free(html);
-            html = processed_html;
-        }
-    }
-
-    /* Add poetry class to code blocks without language if requested */
-    if (options->code_is_poetry && html) {
-        PROFILE_START(code_is_poetry);
-        char *processed_html = apex_add_poetry_class_to_code_blocks(html);
-        PROFILE_END(code_is_poetry);
+        PROFILE_END(widont, processed_html);
         if (processed_html && processed_html != html) {
             free(html);
             html = processed_html;
         }
     }
 
-    /* Add hash prefix to footnote IDs if requested */
-    if (options->random_footnote_ids && html && working_text) {
-        PROFILE_START(footnote_hash_ids);
-        /* Compute hash from original markdown content */
-        char *hash_prefix = apex_compute_document_hash(working_text, strlen(working_text));
-        if (hash_prefix) {
-            char *processed_html = apex_add_hash_to_footnote_ids(html, hash_prefix);
-            if (processed_html && processed_html != html) {
-                free(html);
-                html = processed_html;
-            }
-            free(hash_prefix);
-        }
-        PROFILE_END(footnote_hash_ids);
-    }
-
-    /* Insert page break before footnotes section if requested */
-    if (options->page_break_before_footnotes && html) {
-        PROFILE_START(page_break_before_footnotes);
-        const char *marker = "<section class=\"footnotes\"";
-        char *pos = strstr(html, marker);
-        if (pos) {
-            const char *replacement =
-                "<div class=\"mkpagebreak manualbreak\" "
-                "title=\"Page break created before footnotes\" "
-                "data-description=\"PAGE (Footnotes)\" "
-                "style=\"page-break-after:always\">"
-                "<span style=\"display:none\">&nbsp;</span></div>";
-            size_t html_len = strlen(html);
-            size_t prefix_len = (size_t)(pos - html);
-            size_t repl_len = strlen(replacement);
-            size_t new_len = html_len + repl_len;
-            char *with_break = malloc(new_len + 1);
-            if (with_break) {
-                memcpy(with_break, html, prefix_len);
-                memcpy(with_break + prefix_len, replacement, repl_len);
-                memcpy(with_break + prefix_len + repl_len, pos, html_len - prefix_len);
-                with_break[new_len] = '\0';
-                free(html);
-                html = with_break;
-            }
-        }
-        PROFILE_END(page_break_before_footnotes);
-    }
-
     /* Extract metadata values needed for standalone HTML and post-processing BEFORE freeing metadata */
     /* We need to duplicate strings because metadata will be freed */
     char *css_metadata = NULL;
@@ -6300,22 +6030,57 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         generic_meta_tags = apex_render_generic_meta_tags(metadata);
     }
 
-    /* Adjust header levels and quote language based on metadata */
-    if (html) {
-        if (base_header_level > 1) {
-            PROFILE_START(adjust_header_levels);
-            char *adjusted_html = apex_adjust_header_levels(html, base_header_level);
-            PROFILE_END(adjust_header_levels);
-            if (adjusted_html) {
+    /* Tag-local fix-ups share one rewriter pass: page breaks from <hr>,
+     * poetry class on unlanguaged code blocks, hashed footnote IDs, a page
+     * break before the footnotes and Base Header Level */
+    if ((options->hr_page_break || options->code_is_poetry ||
+         (options->random_footnote_ids && working_text) ||
+         options->page_break_before_footnotes || base_header_level > 1) && html) {
+        apex_html_rewriter *rewriter = apex_html_rewriter_new();
+        apex_poetry_state poetry_state = { (size_t)-1 };
+        bool footnotes_break_done = false;
+        char *hash_prefix = NULL;
+        if (rewriter) {
+            if (options->hr_page_break) {
+                apex_html_rewriter_on_tag(rewriter, "hr", apex_hr_pagebreak_tag, NULL);
+            }
+            if (options->code_is_poetry) {
+                apex_html_rewriter_on_tag(rewriter, "pre", apex_poetry_pre_tag, &poetry_state);
+                apex_html_rewriter_on_tag(rewriter, "code", apex_poetry_code_tag, &poetry_state);
+            }
+            if (options->random_footnote_ids && working_text) {
+                /* Compute hash from original markdown content */
+                hash_prefix = apex_compute_document_hash(working_text, strlen(working_text));
+                if (hash_prefix) {
+                    apex_html_rewriter_on_tag(rewriter, NULL, apex_footnote_ids_tag, hash_prefix);
+                }
+            }
+            if (options->page_break_before_footnotes) {
+                apex_html_rewriter_on_tag(rewriter, "section", apex_footnotes_pagebreak_tag,
+                                          &footnotes_break_done);
+            }
+            if (base_header_level > 1) {
+                apex_html_rewriter_on_tag(rewriter, NULL, apex_header_level_tag, &base_header_level);
+            }
+            PROFILE_START(tag_rewrites, html);
+            char *processed_html = apex_html_rewriter_run(rewriter, html, strlen(html));
+            PROFILE_END(tag_rewrites, processed_html);
+            if (processed_html) {
                 free(html);
-                html = adjusted_html;
+                html = processed_html;
             }
+            apex_html_rewriter_free(rewriter);
         }
+        if (hash_prefix) free(hash_prefix);
+    }
 
+    /* Adjust quote language based on metadata (header levels were
+     * adjusted in the tag rewriter pass) */
+    if (html) {
         if (quotes_lang_metadata) {
-            PROFILE_START(adjust_quotes);
+            PROFILE_START(adjust_quotes, html);
             char *adjusted_quotes = apex_adjust_quote_language(html, quotes_lang_metadata);
-            PROFILE_END(adjust_quotes);
+            PROFILE_END(adjust_quotes, adjusted_quotes);
             if (adjusted_quotes) {
                 free(html);
                 html = adjusted_quotes;
@@ -6327,11 +6092,11 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
      * Use base_directory when set (e.g. from file path or metadata); otherwise use "."
      * so auto expansion runs when piping stdin (images resolved relative to cwd). */
     if (html && strstr(html, "data-apex-replace-auto=1")) {
-        PROFILE_START(expand_auto_media);
+        PROFILE_START(expand_auto_media, html);
         const char *base = options->base_directory && options->base_directory[0]
             ? options->base_directory : ".";
         char *expanded = apex_expand_auto_media(html, base);
-        PROFILE_END(expand_auto_media);
+        PROFILE_END(expand_auto_media, expanded);
         if (expanded) {
             free(html);
             html = expanded;
@@ -6340,9 +6105,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Convert images to figures with captions (caption="..." always wraps; otherwise when enable_image_captions) */
     if (html) {
-        PROFILE_START(image_captions);
+        PROFILE_START(image_captions, html);
         char *with_captions = apex_convert_image_captions(html, options->enable_image_captions, options->title_captions_only);
-        PROFILE_END(image_captions);
+        PROFILE_END(image_captions, with_captions);
         if (with_captions) {
             free(html);
             html = with_captions;
@@ -6369,9 +6134,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Inject header IDs if enabled */
     if (options->generate_header_ids && html) {
-        PROFILE_START(header_ids);
+        PROFILE_START(header_ids, html);
         char *processed_html = apex_inject_header_ids(html, document, true, options->header_anchors, options->id_format);
-        PROFILE_END(header_ids);
+        PROFILE_END(header_ids, processed_html);
         if (processed_html && processed_html != html) {
             free(html);
             html = processed_html;
@@ -6380,9 +6145,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Obfuscate email links if requested */
     if (options->obfuscate_emails && html) {
-        PROFILE_START(obfuscate_emails);
+        PROFILE_START(obfuscate_emails, html);
         char *obfuscated = apex_obfuscate_email_links(html);
-        PROFILE_END(obfuscate_emails);
+        PROFILE_END(obfuscate_emails, obfuscated);
         if (obfuscated) {
             free(html);
             html = obfuscated;
@@ -6391,9 +6156,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Embed images as base64 data URLs if requested (local images only) */
     if (options->embed_images && html) {
-        PROFILE_START(embed_images);
+        PROFILE_START(embed_images, html);
         char *embedded = apex_embed_images(html, options, options->base_directory);
-        PROFILE_END(embed_images);
+        PROFILE_END(embed_images, embedded);
         if (embedded) {
             free(html);
             html = embedded;
@@ -6404,9 +6169,10 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
      * Note: Most replacements happen in preprocessing, but this handles edge cases in HTML
      */
     if (metadata && options->enable_metadata_variables && html) {
-        PROFILE_START(metadata_replace);
-        char *replaced = apex_metadata_replace_variables(html, metadata, options);
-        PROFILE_END(metadata_replace);
+        PROFILE_START(metadata_replace, html);
+        char *replaced = apex_metadata_replace_variables(html, metadata, options,
+                                                         converter ? converter->metadata_cache : NULL);
+        PROFILE_END(metadata_replace, replaced);
         if (replaced && replaced != html) {
             free(html);
             html = replaced;
@@ -6420,15 +6186,28 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
      * MultiMarkdown uses {{TOC}} syntax even when Marked extensions are disabled.
      */
     if ((options->enable_marked_extensions || options->mode == APEX_MODE_MULTIMARKDOWN) && html) {
-        PROFILE_START(toc);
-        char *with_toc = apex_process_toc(html, document, options->id_format,
-                                          options->toc_min, options->toc_max);
-        PROFILE_END(toc);
+        PROFILE_START(toc, html);
+        char *with_toc = NULL;
+        if (section) {
+            /* The session places the TOC: record this section's headings
+             * and expand only where it asks, with the whole document's */
+            section->headings = apex_generate_toc_entries(document, options->id_format, 1, 6,
+                                                          &section->heading_count);
+            section->has_toc_marker = apex_html_has_toc_marker(html);
+            if (section->expand_toc) {
+                with_toc = apex_process_toc_entries(html, section->toc_entries, section->toc_entry_count,
+                                                    options->toc_min, options->toc_max);
+            }
+        } else {
+            with_toc = apex_process_toc(html, document, options->id_format,
+                                        options->toc_min, options->toc_max);
+        }
+        PROFILE_END(toc, with_toc);
         if (with_toc) {
             free(html);
             html = with_toc;
         }
-        char *restored = apex_restore_escaped_toc_markers(html);
+        char *restored = apex_restore_escaped_toc_markers(html, &escaped_tocs);
         if (restored) {
             free(html);
             html = restored;
@@ -6437,9 +6216,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Apply ARIA labels if enabled */
     if (options->enable_aria && html) {
-        PROFILE_START(aria_labels);
+        PROFILE_START(aria_labels, html);
         char *aria_html = apex_apply_aria_labels(html, document);
-        PROFILE_END(aria_labels);
+        PROFILE_END(aria_labels, aria_html);
         if (aria_html && aria_html != html) {
             free(html);
             html = aria_html;
@@ -6447,16 +6226,25 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     }
 
     /* Apply external syntax highlighting if requested */
-    if (options->code_highlighter && html) {
-        PROFILE_START(syntax_highlight);
+    bool highlighter_checked = converter && apex_converter_shares_highlighter(converter, options);
+    if (options->code_highlighter && html && (!highlighter_checked || converter->highlighter_available)) {
+        PROFILE_START(syntax_highlight, html);
         bool ansi_out = (options->output_format == APEX_OUTPUT_TERMINAL || options->output_format == APEX_OUTPUT_TERMINAL256);
-        char *highlighted = apex_apply_syntax_highlighting(html,
-                                                           options->code_highlighter,
-                                                           options->code_line_numbers,
-                                                           options->highlight_language_only,
-                                                           ansi_out,
-                                                           options->code_highlight_theme);
-        PROFILE_END(syntax_highlight);
+        /* A converter looked the tool up in PATH once when it was created */
+        char *highlighted = highlighter_checked
+            ? apex_apply_syntax_highlighting_prechecked(html,
+                                                        options->code_highlighter,
+                                                        options->code_line_numbers,
+                                                        options->highlight_language_only,
+                                                        ansi_out,
+                                                        options->code_highlight_theme)
+            : apex_apply_syntax_highlighting(html,
+                                             options->code_highlighter,
+                                             options->code_line_numbers,
+                                             options->highlight_language_only,
+                                             ansi_out,
+                                             options->code_highlight_theme);
+        PROFILE_END(syntax_highlight, highlighted);
         if (highlighted && highlighted != html) {
             free(html);
             html = highlighted;
@@ -6464,9 +6252,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     }
 
     if (apex_quarto_feature(options, options->enable_quarto_code_attrs) && html) {
-        PROFILE_START(code_fence_attrs_postprocess);
+        PROFILE_START(code_fence_attrs_postprocess, html);
         char *fence_html = apex_postprocess_code_fence_attrs_html(html);
-        PROFILE_END(code_fence_attrs_postprocess);
+        PROFILE_END(code_fence_attrs_postprocess, fence_html);
         if (fence_html) {
             free(html);
             html = fence_html;
@@ -6475,20 +6263,22 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Replace abbreviations if any were found */
     if (abbreviations && html) {
-        PROFILE_START(abbreviations);
+        PROFILE_START(abbreviations, html);
         char *with_abbrs = apex_replace_abbreviations(html, abbreviations);
-        PROFILE_END(abbreviations);
+        PROFILE_END(abbreviations, with_abbrs);
         if (with_abbrs) {
             free(html);
             html = with_abbrs;
         }
     }
 
-    /* Replace GitHub emoji if in GFM or Unified mode */
-    if ((options->mode == APEX_MODE_GFM || apex_mode_is_unified_family(options->mode)) && html) {
-        PROFILE_START(emoji);
+    /* Replace GitHub emoji if in GFM or Unified mode. Metadata values
+     * substituted into the HTML were never part of the scanned source. */
+    if ((options->mode == APEX_MODE_GFM || apex_mode_is_unified_family(options->mode)) && html &&
+        (metadata || (parsed_features & APEX_FEATURE_COLON))) {
+        PROFILE_START(emoji, html);
         char *with_emoji = apex_replace_emoji(html);
-        PROFILE_END(emoji);
+        PROFILE_END(emoji, with_emoji);
         if (with_emoji) {
             free(html);
             html = with_emoji;
@@ -6513,20 +6303,24 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     if (options->enable_citations && html && should_render_citations) {
         if (citation_registry.count > 0) {
-            PROFILE_START(citations_render);
+            PROFILE_START(citations_render, html);
             char *with_citations = apex_render_citations(html, &citation_registry, options);
-            PROFILE_END(citations_render);
+            PROFILE_END(citations_render, with_citations);
             if (with_citations) {
                 free(html);
                 html = with_citations;
             }
         }
 
+        if (section && html) {
+            section->bib_marker = apex_section_bib_marker_of(html);
+        }
+
         /* Insert bibliography at marker or end of document (even if no citations, if bibliography loaded) */
         if (html && !options->suppress_bibliography && citation_registry.bibliography) {
-            PROFILE_START(bibliography);
+            PROFILE_START(bibliography, html);
             char *with_bibliography = apex_insert_bibliography(html, &citation_registry, options);
-            PROFILE_END(bibliography);
+            PROFILE_END(bibliography, with_bibliography);
             if (with_bibliography) {
                 free(html);
                 html = with_bibliography;
@@ -6536,9 +6330,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Render index markers and insert index */
     if (options->enable_indices && html && index_registry.count > 0) {
-        PROFILE_START(index_render);
+        PROFILE_START(index_render, html);
         char *with_index_markers = apex_render_index_markers(html, &index_registry, options);
-        PROFILE_END(index_render);
+        PROFILE_END(index_render, with_index_markers);
         if (with_index_markers) {
             free(html);
             html = with_index_markers;
@@ -6546,9 +6340,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
         /* Insert index at marker or end of document */
         if (html) {
-            PROFILE_START(index_insert);
+            PROFILE_START(index_insert, html);
             char *with_index = apex_insert_index(html, &index_registry, options);
-            PROFILE_END(index_insert);
+            PROFILE_END(index_insert, with_index);
             if (with_index) {
                 free(html);
                 html = with_index;
@@ -6561,9 +6355,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Clean up HTML tag spacing (compress multiple spaces, remove spaces before >) */
     if (html) {
-        PROFILE_START(html_clean);
+        PROFILE_START(html_clean, html);
         char *cleaned = apex_clean_html_tag_spacing(html);
-        PROFILE_END(html_clean);
+        PROFILE_END(html_clean, cleaned);
         if (cleaned) {
             free(html);
             html = cleaned;
@@ -6575,9 +6369,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
      * compact HTML output while still letting pretty mode control layout.
      */
     if (html && !local_opts.pretty) {
-        PROFILE_START(collapse_intertag_newlines);
+        PROFILE_START(collapse_intertag_newlines, html);
         char *collapsed = apex_collapse_intertag_newlines(html);
-        PROFILE_END(collapse_intertag_newlines);
+        PROFILE_END(collapse_intertag_newlines, collapsed);
         if (collapsed) {
             free(html);
             html = collapsed;
@@ -6587,9 +6381,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     /* Convert thead to tbody for relaxed tables and remove empty thead from headerless tables */
     /* Only run this when relaxed_tables is enabled, otherwise keep thead as-is */
     if (html && options->enable_tables && options->relaxed_tables) {
-        PROFILE_START(relaxed_tables_convert);
+        PROFILE_START(relaxed_tables_convert, html);
         char *converted = apex_convert_relaxed_table_headers(html);
-        PROFILE_END(relaxed_tables_convert);
+        PROFILE_END(relaxed_tables_convert, converted);
         if (converted) {
             free(html);
             html = converted;
@@ -6598,9 +6392,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Post-process HTML to add style attributes to alpha lists */
     if (options->allow_alpha_lists && html) {
-        PROFILE_START(alpha_lists_postprocess);
+        PROFILE_START(alpha_lists_postprocess, html);
         char *processed_html = apex_postprocess_alpha_lists_html(html);
-        PROFILE_END(alpha_lists_postprocess);
+        PROFILE_END(alpha_lists_postprocess, processed_html);
         if (processed_html && processed_html != html) {
             free(html);
             html = processed_html;
@@ -6608,9 +6402,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     }
 
     if (apex_quarto_feature(options, options->enable_quarto_roman_lists) && html) {
-        PROFILE_START(roman_lists_postprocess);
+        PROFILE_START(roman_lists_postprocess, html);
         char *roman_html = apex_postprocess_roman_lists_html(html);
-        PROFILE_END(roman_lists_postprocess);
+        PROFILE_END(roman_lists_postprocess, roman_html);
         if (roman_html) {
             free(html);
             html = roman_html;
@@ -6618,9 +6412,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     }
 
     if (apex_quarto_feature(options, options->enable_quarto_xrefs) && html) {
-        PROFILE_START(quarto_xrefs_postprocess);
+        PROFILE_START(quarto_xrefs_postprocess, html);
         char *xref_html = apex_postprocess_quarto_xrefs_html(html);
-        PROFILE_END(quarto_xrefs_postprocess);
+        PROFILE_END(quarto_xrefs_postprocess, xref_html);
         if (xref_html) {
             free(html);
             html = xref_html;
@@ -6629,9 +6423,9 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
 
     /* Remove empty paragraphs created by ^ marker (zero-width space only) */
     if (html && options->enable_marked_extensions) {
-        PROFILE_START(remove_empty_paragraphs);
+        PROFILE_START(remove_empty_paragraphs, html);
         char *cleaned = apex_remove_empty_paragraphs(html);
-        PROFILE_END(remove_empty_paragraphs);
+        PROFILE_END(remove_empty_paragraphs, cleaned);
         if (cleaned && cleaned != html) {
             free(html);
             html = cleaned;
@@ -6647,6 +6441,7 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     free(working_text);
     if (ial_preprocessed) free(ial_preprocessed);
     if (escaped_toc_protected) free(escaped_toc_protected);
+    apex_escaped_toc_store_free(&escaped_tocs);
     if (spans_preprocessed) free(spans_preprocessed);
     if (grid_tables_processed) free(grid_tables_processed);
     if (raw_content_processed) free(raw_content_processed);
@@ -6667,8 +6462,7 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         }
     }
     if (inline_footnotes_processed) free(inline_footnotes_processed);
-    if (highlights_processed) free(highlights_processed);
-    if (inserts_processed) free(inserts_processed);
+    if (inline_marks_processed) free(inline_marks_processed);
     if (alpha_lists_processed) free(alpha_lists_processed);
     if (nested_ordered_sublists_processed) free(nested_ordered_sublists_processed);
     if (relaxed_tables_processed) free(relaxed_tables_processed);
@@ -6679,9 +6473,8 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     if (metadata_replaced) free(metadata_replaced);
     if (autolinks_processed) free(autolinks_processed);
     if (html_markdown_processed) free(html_markdown_processed);
-    if (hashtags_processed) free(hashtags_processed);
+    if (line_stages_processed) free(line_stages_processed);
     if (critic_processed) free(critic_processed);
-    if (proofreader_processed) free(proofreader_processed);
     if (liquid_protected) free(liquid_protected);
     if (liquid_tags) {
         for (size_t i = 0; i < liquid_tag_count; i++) {
@@ -6693,16 +6486,21 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     apex_free_abbreviations(abbreviations);
     apex_free_alds(alds);
     apex_free_image_attributes(img_attrs);
+    if (bibliography_shared) {
+        citation_registry.bibliography = NULL;
+    }
     apex_free_citation_registry(&citation_registry);
 
     /* Post-render plugin phase: allow plugins to transform the final HTML
      * fragment before standalone wrapping and pretty-printing.
      */
     if (plugin_manager && html) {
+        PROFILE_START(plugins_post_render, html);
         char *plugin_html = apex_plugins_run_text_phase(plugin_manager,
                                                         APEX_PLUGIN_PHASE_POST_RENDER,
                                                         html,
                                                         &local_opts);
+        PROFILE_END(plugins_post_render, plugin_html);
         if (plugin_html) {
             free(html);
             html = plugin_html;
@@ -6768,8 +6566,8 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     /* Undefine the macro */
     #undef options
 
-    /* Free plugin manager after all phases complete */
-    if (plugin_manager) {
+    /* Free plugin manager after all phases complete (converters keep theirs) */
+    if (plugin_manager && !plugins_shared) {
         apex_plugins_free(plugin_manager);
     }
 
@@ -6783,6 +6581,13 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         }
     }
 
+    /* When streaming, html stays the body and the document around it is
+     * kept in head and tail so the page is never assembled in one buffer.
+     * Pretty-printing needs the whole document, so it is never streamed. */
+    bool streaming = sink && !local_opts.pretty;
+    char *head = NULL;
+    char *tail = NULL;
+
     /* Wrap in complete HTML document if requested */
     if (local_opts.standalone && html) {
         /* CSS precedence: CLI flag (--css/--style) overrides metadata */
@@ -6855,20 +6660,32 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
             }
         }
 
-        PROFILE_START(standalone_wrap);
-        char *document = apex_wrap_html_document(html, local_opts.document_title, css_paths, css_count,
-                                                 local_opts.code_highlighter, head_to_use, footer_to_use,
-                                                 language_metadata, local_opts.strict_xhtml);
-        PROFILE_END(standalone_wrap);
-
-        /* Free temporary metadata stylesheet array if we allocated it */
-        if (css_paths && css_paths[0] == css_metadata) {
-            free((void*)css_paths);
-        }
-        if (document) {
-            free(html);
-            html = document;
+        PROFILE_START(standalone_wrap, html);
+        if (streaming) {
+            /* Wrap an empty body and split the result where the body goes */
+            char *shell = apex_wrap_html_document("", local_opts.document_title, css_paths, css_count,
+                                                  local_opts.code_highlighter, head_to_use, footer_to_use,
+                                                  language_metadata, local_opts.strict_xhtml);
+            size_t tail_len = apex_html_document_tail_len(footer_to_use);
+            size_t shell_len = shell ? strlen(shell) : 0;
+            if (shell_len > tail_len) {
+                tail = strdup(shell + shell_len - tail_len);
+                shell[shell_len - tail_len] = '\0';
+                head = shell;
+                html[apex_html_document_content_len(html)] = '\0';
+            } else {
+                free(shell);
+            }
+        } else {
+            char *document = apex_wrap_html_document(html, local_opts.document_title, css_paths, css_count,
+                                                     local_opts.code_highlighter, head_to_use, footer_to_use,
+                                                     language_metadata, local_opts.strict_xhtml);
+            if (document) {
+                free(html);
+                html = document;
+            }
         }
+        PROFILE_END(standalone_wrap, html);
 
         if (footer_with_scripts) {
             free(footer_with_scripts);
@@ -6878,119 +6695,50 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
         }
 
         /* If requested, replace stylesheet links with embedded CSS contents */
-        if (html && css_paths && css_count > 0 && local_opts.embed_stylesheet) {
-            /* Process each stylesheet in reverse order to maintain correct positions */
-            for (int i = (int)css_count - 1; i >= 0; i--) {
-                if (!css_paths[i]) continue;
-
-                const char *css_path = css_paths[i];
-                char *css_content = NULL;
-                size_t css_len = 0;
-
-                /* Helper lambda-like block to read file into memory */
-                {
-                    FILE *css_fp = fopen(css_path, "rb");
-                    if (!css_fp && local_opts.base_directory && local_opts.base_directory[0] != '\0') {
-                        /* Try base_directory + "/" + css_path */
-                        size_t base_len = strlen(local_opts.base_directory);
-                        size_t path_len = strlen(css_path);
-                        size_t full_len = base_len + 1 + path_len + 1;
-                        char *full_path = malloc(full_len);
-                        if (full_path) {
-                            snprintf(full_path, full_len, "%s/%s", local_opts.base_directory, css_path);
-                            css_fp = fopen(full_path, "rb");
-                            free(full_path);
-                        }
-                    }
-
-                    if (css_fp) {
-                        if (fseek(css_fp, 0, SEEK_END) == 0) {
-                            long fsize = ftell(css_fp);
-                            if (fsize >= 0 && fsize < 10 * 1024 * 1024) { /* 10MB safety limit */
-                                rewind(css_fp);
-                                css_content = malloc((size_t)fsize + 1);
-                                if (css_content) {
-                                    css_len = fread(css_content, 1, (size_t)fsize, css_fp);
-                                    css_content[css_len] = '\0';
-                                }
-                            }
-                        }
-                        fclose(css_fp);
-                    }
-                }
-
-                if (css_content && css_len > 0) {
-                    /* Build the exact link line we expect from apex_wrap_html_document */
-                    char link_line[2048];
-                    int link_n = snprintf(link_line, sizeof(link_line),
-                                          "  <link rel=\"stylesheet\" href=\"%s\">\n",
-                                          css_path);
-                    if (link_n > 0 && (size_t)link_n < sizeof(link_line)) {
-                        char *pos = strstr(html, link_line);
-                        if (pos) {
-                            size_t html_len = strlen(html);
-                            size_t link_len = (size_t)link_n;
-                            const char *style_prefix = "  <style>\n";
-                            const char *style_suffix = "\n  </style>\n";
-                            size_t prefix_len = strlen(style_prefix);
-                            size_t suffix_len = strlen(style_suffix);
-
-                            size_t new_len = html_len - link_len + prefix_len + css_len + suffix_len;
-                            char *embedded = malloc(new_len + 1);
-                            if (embedded) {
-                                size_t before_len = (size_t)(pos - html);
-                                memcpy(embedded, html, before_len);
-                                size_t offset = before_len;
-
-                                memcpy(embedded + offset, style_prefix, prefix_len);
-                                offset += prefix_len;
-
-                                memcpy(embedded + offset, css_content, css_len);
-                                offset += css_len;
-
-                                memcpy(embedded + offset, style_suffix, suffix_len);
-                                offset += suffix_len;
-
-                                size_t after_len = html_len - before_len - link_len;
-                                if (after_len > 0) {
-                                    memcpy(embedded + offset, pos + link_len, after_len);
-                                    offset += after_len;
-                                }
-
-                                embedded[offset] = '\0';
-                                free(html);
-                                html = embedded;
-                            }
-                        }
-                    }
-                    free(css_content);
-                }
+        if (css_paths && css_count > 0 && local_opts.embed_stylesheet) {
+            if (streaming) {
+                head = apex_embed_stylesheet_links(head, css_paths, css_count, local_opts.base_directory);
+            } else {
+                html = apex_embed_stylesheet_links(html, css_paths, css_count, local_opts.base_directory);
             }
         }
+
+        /* Free temporary metadata stylesheet array if we allocated it */
+        if (css_paths && css_paths[0] == css_metadata) {
+            free((void*)css_paths);
+        }
     } else if (html && scripts_html) {
         /* Snippet mode: append scripts to the end of the HTML fragment */
         size_t html_len = strlen(html);
         size_t scripts_len = strlen(scripts_html);
         size_t extra_newline = (html_len > 0 && scripts_len > 0 && html[html_len - 1] != '\n') ? 1 : 0;
 
-        char *combined = malloc(html_len + extra_newline + scripts_len + 1);
-        if (combined) {
-            size_t pos = 0;
-            if (html_len > 0) {
-                memcpy(combined + pos, html, html_len);
-                pos += html_len;
-            }
-            if (extra_newline) {
-                combined[pos++] = '\n';
-            }
-            if (scripts_len > 0) {
-                memcpy(combined + pos, scripts_html, scripts_len);
-                pos += scripts_len;
+        if (streaming) {
+            tail = malloc(extra_newline + scripts_len + 1);
+            if (tail) {
+                if (extra_newline) tail[0] = '\n';
+                memcpy(tail + extra_newline, scripts_html, scripts_len + 1);
             }
-            combined[pos] = '\0';
+        } else {
+            char *combined = malloc(html_len + extra_newline + scripts_len + 1);
+            if (combined) {
+                size_t pos = 0;
+                if (html_len > 0) {
+                    memcpy(combined + pos, html, html_len);
+                    pos += html_len;
+                }
+                if (extra_newline) {
+                    combined[pos++] = '\n';
+                }
+                if (scripts_len > 0) {
+                    memcpy(combined + pos, scripts_html, scripts_len);
+                    pos += scripts_len;
+                }
+                combined[pos] = '\0';
 
-            free(html);
-            html = combined;
+                free(html);
+                html = combined;
+            }
         }
     }
 
@@ -7007,59 +6755,221 @@ char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options
     if (generic_meta_tags) free(generic_meta_tags);
     if (h1_title) free(h1_title);
 
-    /* Remove blank lines within tables (applies to both pretty and non-pretty) */
-    if (html) {
-        PROFILE_START(remove_table_blank_lines);
-        char *cleaned = apex_remove_table_blank_lines(html);
-        PROFILE_END(remove_table_blank_lines);
-        if (cleaned) {
-            free(html);
-            html = cleaned;
+    bool xhtml_output = local_opts.xhtml && options->output_format == APEX_OUTPUT_HTML;
+    if (streaming) {
+        /* The final passes work line by line or tag by tag, so each piece
+         * can be finished on its own */
+        if (html) {
+            head = apex_finish_html(head, &local_opts, xhtml_output);
+            apex_sink_write(sink, head, head ? strlen(head) : 0);
+            sink->streamed = true;
+
+            /* Finish and write the body a segment at a time, so the final
+             * passes copy one segment instead of the whole body */
+            size_t body_len = strlen(html);
+            size_t pos = 0;
+            while (pos < body_len && !sink->failed) {
+                size_t end = pos + apex_sink_segment_end(html + pos, body_len - pos, APEX_SINK_SEGMENT);
+                char *piece = apex_finish_html(strndup(html + pos, end - pos), &local_opts, xhtml_output);
+                if (!piece) {
+                    sink->failed = true;
+                    break;
+                }
+                apex_sink_write(sink, piece, strlen(piece));
+                free(piece);
+                pos = end;
+            }
+
+            tail = apex_finish_html(tail, &local_opts, xhtml_output);
+            apex_sink_write(sink, tail, tail ? strlen(tail) : 0);
         }
+        free(head);
+        free(tail);
+        free(html);
+        html = NULL;
+    } else {
+        html = apex_finish_html(html, &local_opts, xhtml_output);
     }
 
-    /* Remove table separator rows that were incorrectly rendered as data rows */
-    /* This happens when smart typography converts --- to — in separator rows */
-    if (html && local_opts.enable_tables) {
-        PROFILE_START(remove_table_separator_rows);
-        extern char *apex_remove_table_separator_rows(const char *html);
-        char *cleaned = apex_remove_table_separator_rows(html);
-        PROFILE_END(remove_table_separator_rows);
-        if (cleaned) {
-            free(html);
-            html = cleaned;
-        }
+    return html;
+}
+
+/**
+ * Run a conversion, timing it when options->stats is set or APEX_PROFILE
+ * asks for the numbers on stderr
+ */
+static char *apex_convert(const char *markdown, size_t len, const apex_options *options,
+                          const apex_converter *converter, apex_output_sink *sink) {
+    apex_stats *stats = options ? options->stats : NULL;
+    apex_stats env_stats;
+    apex_options env_opts;
+    bool to_stderr = false;
+    if (!stats && profiling_enabled()) {
+        env_opts = options ? *options : apex_options_default();
+        env_opts.stats = &env_stats;
+        options = &env_opts;
+        stats = &env_stats;
+        to_stderr = true;
+    }
+    if (!stats) {
+        return apex_convert_document(markdown, len, options, converter, sink, NULL);
+    }
+
+    apex_stats_timer timer;
+    apex_stats_begin(stats, &timer, markdown ? strnlen(markdown, len) : 0);
+    char *output = apex_convert_document(markdown, len, options, converter, sink, NULL);
+    apex_stats_finish(&timer, output ? strlen(output) : (sink ? sink->written : 0));
+    if (to_stderr) apex_stats_print(stats, stderr);
+    return output;
+}
+
+char *apex_markdown_to_html(const char *markdown, size_t len, const apex_options *options) {
+    return apex_convert(markdown, len, options, NULL, NULL);
+}
+
+apex_converter *apex_converter_new(const apex_options *options) {
+    apex_converter *converter = calloc(1, sizeof(apex_converter));
+    if (!converter) return NULL;
+
+    converter->options = options ? *options : apex_options_default();
+    const apex_options *opts = &converter->options;
+
+    if (opts->enable_plugins) {
+        converter->plugins = apex_plugins_load(opts);
     }
 
-    /* Pretty-print HTML if requested */
-    if (local_opts.pretty && html) {
-        PROFILE_START(pretty_print);
-        char *pretty = apex_pretty_print_html(html);
-        PROFILE_END(pretty_print);
-        if (pretty) {
-            free(html);
-            html = pretty;
-        }
+    apex_ensure_core_extensions();
+    if (opts->enable_math) {
+        converter->math_ext = create_math_extension();
+    }
+    if (opts->enable_footnotes) {
+        converter->footnotes_ext = create_advanced_footnotes_extension();
+    }
+    if (opts->enable_tables) {
+        converter->tables_ext = create_advanced_tables_extension(opts->per_cell_alignment);
     }
 
-    /* XHTML-style void elements (--xhtml / --strict-xhtml); run after pretty-print (HTML only) */
-    if (local_opts.xhtml && html && options->output_format == APEX_OUTPUT_HTML) {
-        PROFILE_START(xhtml_void_tags);
-        char *xhtml_out = apex_html_apply_xhtml_void_tags(html);
-        PROFILE_END(xhtml_void_tags);
-        if (xhtml_out) {
-            free(html);
-            html = xhtml_out;
+    if (opts->bibliography_files) {
+        converter->bibliography = apex_load_bibliography((const char **)opts->bibliography_files,
+                                                         opts->base_directory,
+                                                         opts->bibliography_cache_dir);
+    }
+
+    converter->metadata_cache = apex_metadata_cache_new();
+
+    if (opts->code_highlighter) {
+        converter->highlighter_available = apex_syntax_highlighter_available(opts->code_highlighter);
+        if (!converter->highlighter_available && !getenv("APEX_SUPPRESS_HIGHLIGHT_WARNINGS")) {
+            fprintf(stderr, "Warning: Syntax highlighting tool '%s' not found in PATH. "
+                    "Code blocks will not be highlighted.\n", opts->code_highlighter);
         }
     }
 
-    PROFILE_END(total);
+    return converter;
+}
+
+char *apex_converter_convert(const apex_converter *converter, const char *markdown, size_t len) {
+    if (!converter) return NULL;
+    return apex_convert(markdown, len, &converter->options, converter, NULL);
+}
+
+char *apex_converter_convert_with_options(const apex_converter *converter,
+                                          const char *markdown, size_t len,
+                                          const apex_options *options) {
+    if (!converter) return NULL;
+    return apex_convert(markdown, len, options ? options : &converter->options, converter, NULL);
+}
+
+char *apex_converter_convert_section(const apex_converter *converter,
+                                     const char *markdown, size_t len,
+                                     const apex_options *options,
+                                     apex_section_summary *summary) {
+    if (!converter || !summary) return NULL;
+    return apex_convert_document(markdown, len, options ? options : &converter->options,
+                                 converter, NULL, summary);
+}
 
-    if (profiling_enabled()) {
-        fprintf(stderr, "[PROFILE] %-30s: %8s\n", "---", "---");
+void apex_section_summary_clear(apex_section_summary *summary) {
+    if (!summary) return;
+    apex_toc_entries_free(summary->headings, summary->heading_count);
+    for (size_t i = 0; i < summary->citation_count; i++) {
+        free(summary->citations[i].key);
     }
+    free(summary->citations);
+    for (size_t i = 0; i < summary->footnote_ref_count; i++) {
+        free(summary->footnote_refs[i]);
+    }
+    free(summary->footnote_refs);
+    memset(summary, 0, sizeof(*summary));
+}
 
-    return html;
+static int apex_convert_to_sink(const char *markdown, size_t len, const apex_options *options,
+                                const apex_converter *converter, apex_write_fn write, void *user_data) {
+    if (!write) return -1;
+
+    apex_output_sink sink = { write, user_data, false, false, 0 };
+    char *output = apex_convert(markdown, len, options, converter, &sink);
+    if (output) {
+        /* Formats that aren't streamed come back as one string */
+        size_t output_len = strlen(output);
+        if (options && (options->output_format == APEX_OUTPUT_TERMINAL ||
+                        options->output_format == APEX_OUTPUT_TERMINAL256)) {
+            size_t terminal_len = apex_terminal_output_length();
+            if (terminal_len > 0) output_len = terminal_len;
+        }
+        apex_sink_write(&sink, output, output_len);
+        free(output);
+    } else if (!sink.streamed) {
+        return -1;
+    }
+    return sink.failed ? -1 : 0;
+}
+
+int apex_markdown_to_sink(const char *markdown, size_t len, const apex_options *options,
+                          apex_write_fn write, void *user_data) {
+    return apex_convert_to_sink(markdown, len, options, NULL, write, user_data);
+}
+
+int apex_converter_convert_to_sink(const apex_converter *converter,
+                                   const char *markdown, size_t len,
+                                   const apex_options *options,
+                                   apex_write_fn write, void *user_data) {
+    if (!converter) return -1;
+    return apex_convert_to_sink(markdown, len, options ? options : &converter->options,
+                                converter, write, user_data);
+}
+
+static int apex_fd_write(void *user_data, const char *data, size_t len) {
+    int fd = *(const int *)user_data;
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int apex_markdown_to_fd(const char *markdown, size_t len, const apex_options *options, int fd) {
+    return apex_convert_to_sink(markdown, len, options, NULL, apex_fd_write, &fd);
+}
+
+const apex_options *apex_converter_options(const apex_converter *converter) {
+    return converter ? &converter->options : NULL;
+}
+
+void apex_converter_free(apex_converter *converter) {
+    if (!converter) return;
+    if (converter->plugins) apex_plugins_free(converter->plugins);
+    if (converter->math_ext) cmark_syntax_extension_free(cmark_get_default_mem_allocator(), converter->math_ext);
+    if (converter->footnotes_ext) cmark_syntax_extension_free(cmark_get_default_mem_allocator(), converter->footnotes_ext);
+    if (converter->tables_ext) cmark_syntax_extension_free(cmark_get_default_mem_allocator(), converter->tables_ext);
+    if (converter->bibliography) apex_free_bibliography_registry(converter->bibliography);
+    apex_metadata_cache_free(converter->metadata_cache);
+    free(converter);
 }
 
 /**
@@ -7072,54 +6982,7 @@ char *apex_wrap_html_document(const char *content, const char *title, const char
     const char *lang = language ? language : "en";
 
     /* Strip any existing </body></html> tags from end of content to avoid duplicates */
-    size_t content_len = strlen(content);
-    const char *html_end = NULL;
-    const char *body_end = NULL;
-
-    /* Find last occurrence of </html> near the end */
-    const char *search = content + content_len;
-    while (search > content) {
-        search--;
-        if (strncmp(search, "</html>", 7) == 0) {
-            html_end = search;
-            break;
-        }
-    }
-
-    /* If we found </html>, look for </body> before it */
-    if (html_end) {
-        search = html_end;
-        while (search > content) {
-            search--;
-            if (strncmp(search, "</body>", 7) == 0) {
-                body_end = search;
-                break;
-            }
-            /* Stop if we hit a non-whitespace character before finding </body> */
-            if (!isspace((unsigned char)*search) && *search != '>') {
-                break;
-            }
-        }
-
-        /* If we found both tags at the end, strip them */
-        if (body_end) {
-            /* Check that there's only whitespace/newlines between </body> and </html> */
-            const char *between = body_end + 7;
-            bool only_whitespace = true;
-            while (between < html_end) {
-                if (!isspace((unsigned char)*between)) {
-                    only_whitespace = false;
-                    break;
-                }
-                between++;
-            }
-
-            if (only_whitespace) {
-                /* Strip everything from </body> to end */
-                content_len = body_end - content;
-            }
-        }
-    }
+    size_t content_len = apex_html_document_content_len(content);
     size_t title_len = strlen(doc_title);
     /* Calculate total length for all stylesheet links */
     size_t style_len = 0;
@@ -7539,7 +7402,7 @@ char *apex_wrap_html_document(const char *content, const char *title, const char
     }
 
     /* Close body and html */
-    n = snprintf(write, remaining, "\n</body>\n</html>\n");
+    n = snprintf(write, remaining, APEX_HTML_DOCUMENT_END);
     if (n < 0 || (size_t)n >= remaining) {
         free(output);
         return strdup(content);
@@ -393,21 +393,24 @@ static void render_inline_roff(man_buffer *buf, cmark_node *node) {
 /* Block roff rendering                                                     */
 /* ------------------------------------------------------------------------- */
 
-static void render_block_roff(man_buffer *buf, cmark_node *node);
-
-/* True after we emitted a <dl> block so the next paragraph is definition continuation (no .PP). */
-static bool roff_last_was_dl_dd = false;
+/* Block rendering state for one document */
+typedef struct {
+    man_buffer *buf;
+    /* True after we emitted a <dl> block so the next paragraph is definition continuation (no .PP). */
+    bool last_was_dl_dd;
+} roff_block_state;
 
-static void render_block_roff(man_buffer *buf, cmark_node *node) {
+static void render_block_roff(roff_block_state *st, cmark_node *node) {
     if (!node) return;
+    man_buffer *buf = st->buf;
     cmark_node_type t = cmark_node_get_type(node);
     switch (t) {
         case CMARK_NODE_DOCUMENT:
             for (cmark_node *cur = cmark_node_first_child(node); cur; cur = cmark_node_next(cur))
-                render_block_roff(buf, cur);
+                render_block_roff(st, cur);
             break;
         case CMARK_NODE_HEADING: {
-            roff_last_was_dl_dd = false;
+            st->last_was_dl_dd = false;
             int level = cmark_node_get_heading_level(node);
             man_buf_append_str(buf, level == 1 ? "\n.SH " : "\n.SS ");
             for (cmark_node *c = cmark_node_first_child(node); c; c = cmark_node_next(c))
@@ -423,11 +426,11 @@ static void render_block_roff(man_buffer *buf, cmark_node *node) {
                 (pt == (cmark_node_type)APEX_NODE_DEFINITION_DATA &&
                  !cmark_node_previous(node));
             bool in_def_term = (pt == (cmark_node_type)APEX_NODE_DEFINITION_TERM);
-            bool continue_after_dd = roff_last_was_dl_dd;
+            bool continue_after_dd = st->last_was_dl_dd;
             bool para_has_content = (cmark_node_first_child(node) != NULL);
             if (continue_after_dd) {
                 if (para_has_content)
-                    roff_last_was_dl_dd = false;
+                    st->last_was_dl_dd = false;
                 /* else leave flag set so next block (e.g. code block) is treated as continuation */
             }
             if (!in_item && !in_def_data_first && !in_def_term && !continue_after_dd) {
@@ -443,9 +446,9 @@ static void render_block_roff(man_buffer *buf, cmark_node *node) {
             break;
         }
         case CMARK_NODE_LIST:
-            roff_last_was_dl_dd = false;
+            st->last_was_dl_dd = false;
             for (cmark_node *cur = cmark_node_first_child(node); cur; cur = cmark_node_next(cur))
-                render_block_roff(buf, cur);
+                render_block_roff(st, cur);
             break;
         case CMARK_NODE_ITEM: {
             cmark_node *list = cmark_node_parent(node);
@@ -458,7 +461,7 @@ static void render_block_roff(man_buffer *buf, cmark_node *node) {
                 man_buf_append_str(buf, num);
             }
             for (cmark_node *cur = cmark_node_first_child(node); cur; cur = cmark_node_next(cur))
-                render_block_roff(buf, cur);
+                render_block_roff(st, cur);
             break;
         }
         case CMARK_NODE_CODE_BLOCK: {
@@ -467,16 +470,16 @@ static void render_block_roff(man_buffer *buf, cmark_node *node) {
             cmark_node_type pt = parent ? cmark_node_get_type(parent) : (cmark_node_type)0;
             bool in_item = (pt == CMARK_NODE_ITEM);
             /* Continuation: after <dl> dd, or inside list item (indented line in source) - no .PP/.nf/.fi */
-            if (roff_last_was_dl_dd || in_item) {
-                if (roff_last_was_dl_dd)
-                    roff_last_was_dl_dd = false;
+            if (st->last_was_dl_dd || in_item) {
+                if (st->last_was_dl_dd)
+                    st->last_was_dl_dd = false;
                 if (buf->len > 0 && buf->buf[buf->len - 1] != '\n')
                     man_buf_append_str(buf, " ");
                 if (lit) man_buf_append_roff_safe(buf, lit, strlen(lit));
                 man_buf_append_str(buf, "\n");
                 break;
             }
-            roff_last_was_dl_dd = false;
+            st->last_was_dl_dd = false;
             /* \fR not \f[C] to avoid "cannot select font 'C'" on some groff devices */
             man_buf_append_str(buf, "\n.PP\n.nf\n\\fR\n");
             if (lit) {
@@ -504,45 +507,45 @@ static void render_block_roff(man_buffer *buf, cmark_node *node) {
             break;
         }
         case CMARK_NODE_BLOCK_QUOTE:
-            roff_last_was_dl_dd = false;
+            st->last_was_dl_dd = false;
             man_buf_append_str(buf, "\n.RS\n");
             for (cmark_node *cur = cmark_node_first_child(node); cur; cur = cmark_node_next(cur))
-                render_block_roff(buf, cur);
+                render_block_roff(st, cur);
             man_buf_append_str(buf, "\n.RE\n");
             break;
         case CMARK_NODE_THEMATIC_BREAK:
-            roff_last_was_dl_dd = false;
+            st->last_was_dl_dd = false;
             man_buf_append_str(buf, "\n.PP\n  *  *  *  *  *\n");
             break;
         case CMARK_NODE_HTML_BLOCK: {
             const char *lit = cmark_node_get_literal(node);
             size_t lit_len = lit ? strlen(lit) : 0;
             if (lit_len > 0 && render_dl_html_block_as_roff(buf, lit, lit_len))
-                roff_last_was_dl_dd = true;
+                st->last_was_dl_dd = true;
             break;
         }
         default:
-            roff_last_was_dl_dd = false;
+            st->last_was_dl_dd = false;
             /* Definition list (Apex extension): term = .TP + bold term, data = body */
             if (t == (cmark_node_type)APEX_NODE_DEFINITION_LIST) {
                 for (cmark_node *cur = cmark_node_first_child(node); cur; cur = cmark_node_next(cur))
-                    render_block_roff(buf, cur);
+                    render_block_roff(st, cur);
                 break;
             }
             if (t == (cmark_node_type)APEX_NODE_DEFINITION_TERM) {
                 man_buf_append_str(buf, "\n.TP\n");
                 /* Term can contain a paragraph or direct inlines; recurse so paragraph content is emitted without .PP */
                 for (cmark_node *cur = cmark_node_first_child(node); cur; cur = cmark_node_next(cur))
-                    render_block_roff(buf, cur);
+                    render_block_roff(st, cur);
                 break;
             }
             if (t == (cmark_node_type)APEX_NODE_DEFINITION_DATA) {
                 for (cmark_node *cur = cmark_node_first_child(node); cur; cur = cmark_node_next(cur))
-                    render_block_roff(buf, cur);
+                    render_block_roff(st, cur);
                 break;
             }
             for (cmark_node *cur = cmark_node_first_child(node); cur; cur = cmark_node_next(cur))
-                render_block_roff(buf, cur);
+                render_block_roff(st, cur);
             break;
     }
 }
@@ -579,7 +582,8 @@ char *apex_cmark_to_man_roff(cmark_node *document, const apex_options *options)
     man_buf_append_str(&buf, source);
     man_buf_append_str(&buf, "\"\n");
 
-    render_block_roff(&buf, document);
+    roff_block_state roff_state = { &buf, false };
+    render_block_roff(&roff_state, document);
 
     if (first_h1) free(first_h1);
 
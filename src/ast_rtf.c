@@ -8,6 +8,7 @@
 #include "apex/apex.h"
 #include "table.h"
 #include "strikethrough.h"
+#include "render_cache.h"
 #include "cmark-gfm-core-extensions.h"
 
 #include <ctype.h>
@@ -289,6 +290,7 @@ static bool rtf_try_embed_image(rtf_ctx *ctx, const char *url) {
         path = resolved;
     }
 
+    apex_render_cache_note_file(path);
     FILE *fp = fopen(path, "rb");
     if (!fp) return false;
     if (fseek(fp, 0, SEEK_END) != 0) { fclose(fp); return false; }
@@ -16,6 +16,7 @@
 #include "apex/ast_terminal.h"
 #include "table.h"          /* For CMARK_NODE_TABLE, CMARK_NODE_TABLE_ROW, CMARK_NODE_TABLE_CELL */
 #include "extensions/emoji.h"
+#include "attr_pool.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -38,10 +39,35 @@
 /* Buffer helper                                                             */
 /* ------------------------------------------------------------------------- */
 
+typedef enum {
+    TERM_IMG_NONE = 0,
+    TERM_IMG_IMGCAT,
+    TERM_IMG_CHAFA,
+    TERM_IMG_VIU,
+    TERM_IMG_CATIMG
+} term_img_tool_t;
+
+/* Output buffer plus the per-render state that rides along with it, so
+ * concurrent renders on different threads don't share anything. */
 typedef struct {
     char *buf;
     size_t len;
     size_t capacity;
+
+    /* Stack of active HTML <span class="..."> styles for RawInline HTML.
+     * This is only used for CMARK_NODE_HTML_INLINE nodes. */
+    const char *html_span_style_stack[16];
+    int html_span_style_depth;
+
+    /* Inline image support, probed once per render */
+    term_img_tool_t img_tool;
+    int img_width;
+    bool has_curl;
+    bool use_256;
+    bool paginate_symbols;
+
+    /* Typed view of node user_data (IAL classes, table spans), parsed once per node */
+    apex_attr_pool *attrs;
 } terminal_buffer;
 
 /* Alignment options for table cells */
@@ -74,9 +100,9 @@ static term_cell *grid_at(term_table_grid *g, int r, int c) {
 }
 
 static void buffer_init(terminal_buffer *buf) {
-    buf->buf = NULL;
-    buf->len = 0;
-    buf->capacity = 0;
+    memset(buf, 0, sizeof(*buf));
+    buf->img_tool = TERM_IMG_NONE;
+    buf->img_width = 50;
 }
 
 static void buffer_append(terminal_buffer *buf, const char *str, size_t len) {
@@ -104,57 +130,29 @@ static void buffer_append_str(terminal_buffer *buf, const char *str) {
     }
 }
 
-/* Helper to detect alignment from cell/user attributes (advanced tables, IAL, etc.) */
-static term_align_t
-parse_alignment_from_attrs(const char *attrs) {
-    if (!attrs) {
-        return TERM_ALIGN_DEFAULT;
-    }
-
-    /* Prefer explicit text-align style if present */
-    if (strstr(attrs, "text-align: center") || strstr(attrs, "text-align:center")) {
-        return TERM_ALIGN_CENTER;
-    }
-    if (strstr(attrs, "text-align: right") || strstr(attrs, "text-align:right")) {
-        return TERM_ALIGN_RIGHT;
-    }
-    if (strstr(attrs, "text-align: left") || strstr(attrs, "text-align:left")) {
-        return TERM_ALIGN_LEFT;
-    }
-
-    /* Fallback: check legacy align attribute if it ever appears in user_data */
-    if (strstr(attrs, "align=\"center\"")) {
-        return TERM_ALIGN_CENTER;
-    }
-    if (strstr(attrs, "align=\"right\"")) {
-        return TERM_ALIGN_RIGHT;
-    }
-    if (strstr(attrs, "align=\"left\"")) {
-        return TERM_ALIGN_LEFT;
-    }
-
+static term_align_t align_from_keyword(const char *value) {
+    if (strncmp(value, "center", 6) == 0) return TERM_ALIGN_CENTER;
+    if (strncmp(value, "right", 5) == 0) return TERM_ALIGN_RIGHT;
+    if (strncmp(value, "left", 4) == 0) return TERM_ALIGN_LEFT;
     return TERM_ALIGN_DEFAULT;
 }
 
-/* Parse integer attribute value like colspan="3" from an attribute string. */
-static int parse_span_attr(const char *attrs, const char *name) {
-    if (!attrs || !name) return 1;
-    const char *p = strstr(attrs, name);
-    if (!p) return 1;
-    p += strlen(name);
-    if (*p != '=') return 1;
-    p++;
-    if (*p == '"' || *p == '\'') {
-        char quote = *p++;
-        int val = atoi(p);
-        (void)quote;
-        if (val <= 0) val = 1;
-        return val;
-    } else {
-        int val = atoi(p);
-        if (val <= 0) val = 1;
-        return val;
-    }
+/* Helper to detect alignment from cell/user attributes (advanced tables, IAL, etc.) */
+static term_align_t
+parse_alignment_from_attrs(const apex_attributes *attrs) {
+    /* Prefer explicit text-align style if present */
+    const char *style = apex_attributes_get(attrs, "style");
+    const char *text_align = style ? strstr(style, "text-align:") : NULL;
+    if (text_align) {
+        text_align += strlen("text-align:");
+        while (*text_align == ' ') text_align++;
+        term_align_t align = align_from_keyword(text_align);
+        if (align != TERM_ALIGN_DEFAULT) return align;
+    }
+
+    /* Fallback: legacy align attribute if it ever appears in user_data */
+    const char *align = apex_attributes_get(attrs, "align");
+    return align ? align_from_keyword(align) : TERM_ALIGN_DEFAULT;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -1184,46 +1182,37 @@ static const char *theme_style_for_node_attrs(const terminal_theme *theme,
     return theme_style_for_span_classes(theme, buf);
 }
 
-/* Convenience helper: get style for classes attached to a node via IAL.
- * Attributes are stored as a serialized HTML attribute string in user_data.
+/* Convenience helper: get style for classes attached to a node via IAL,
+ * taking the first of the node's classes that the theme styles.
  */
 static const char *theme_style_for_node(const terminal_theme *theme,
+                                        const terminal_buffer *buf,
                                         cmark_node *node) {
     if (!theme || !node || theme->span_classes_count == 0) {
         return NULL;
     }
-    const char *attrs = (const char *)cmark_node_get_user_data(node);
-    if (!attrs || !*attrs) {
+    const apex_attributes *attrs = apex_attr_pool_get(buf->attrs, node);
+    if (!attrs) {
         return NULL;
     }
-    return theme_style_for_node_attrs(theme, attrs);
+    for (int c = 0; c < attrs->class_count; c++) {
+        for (size_t i = 0; i < theme->span_classes_count; i++) {
+            const span_class_style *entry = &theme->span_classes[i];
+            if (entry->class_name && entry->style &&
+                strcmp(entry->class_name, attrs->classes[c]) == 0) {
+                return entry->style;
+            }
+        }
+    }
+    return NULL;
 }
 
-/* Simple stack of active HTML <span class="..."> styles for RawInline HTML.
- * This is only used for CMARK_NODE_HTML_INLINE nodes so we don't have to
- * thread extra state through every serialize_* call.
- */
-static const char *html_span_style_stack[16];
-static int html_span_style_depth = 0;
-
 /* ------------------------------------------------------------------------- */
 /* Terminal inline images (imgcat, chafa, viu, catimg)                        */
 /* ------------------------------------------------------------------------- */
 
-typedef enum {
-    TERM_IMG_NONE = 0,
-    TERM_IMG_IMGCAT,
-    TERM_IMG_CHAFA,
-    TERM_IMG_VIU,
-    TERM_IMG_CATIMG
-} term_img_tool_t;
-
-static term_img_tool_t g_term_img_tool = TERM_IMG_NONE;
-static int g_term_img_width = 50;
-static bool g_term_has_curl = false;
-static bool g_term_use_256 = false;
-static bool g_term_paginate_symbols = false;
-static size_t g_terminal_output_len = 0;
+/* Length of the last render on this thread, for apex_terminal_output_length() */
+static __thread size_t g_terminal_output_len = 0;
 
 static bool terminal_debug_enabled(void) {
     return getenv("APEX_DEBUG_TERMINAL") != NULL;
@@ -1381,8 +1370,8 @@ static bool terminal_curl_download(const char *url, const char *dest_path) {
  * Download http(s) URL to a fresh temp file (caller must unlink + free).
  * Returns NULL on failure; curl errors are suppressed (stderr to /dev/null).
  */
-static char *terminal_fetch_http_image_temp(const char *url) {
-    if (!url || !g_term_has_curl || !terminal_url_is_http(url)) {
+static char *terminal_fetch_http_image_temp(const char *url, bool has_curl) {
+    if (!url || !has_curl || !terminal_url_is_http(url)) {
         return NULL;
     }
     char *path = terminal_mkstemp_download_path();
@@ -1433,8 +1422,8 @@ static bool executable_on_path(const char *name) {
     return false;
 }
 
-static term_img_tool_t probe_terminal_image_tool(void) {
-    if (g_term_paginate_symbols) {
+static term_img_tool_t probe_terminal_image_tool(bool paginate_symbols) {
+    if (paginate_symbols) {
         if (executable_on_path("chafa")) {
             return TERM_IMG_CHAFA;
         }
@@ -1563,8 +1552,8 @@ static bool run_terminal_image_tool(terminal_buffer *buf, term_img_tool_t tool,
             argv[argc++] = (char *)abspath;
             break;
         case TERM_IMG_CHAFA: {
-            const char *colors = g_term_use_256 ? "256" : "16";
-            const char *format = g_term_paginate_symbols ? "symbols" : terminal_chafa_format();
+            const char *colors = buf->use_256 ? "256" : "16";
+            const char *format = buf->paginate_symbols ? "symbols" : terminal_chafa_format();
             argv[argc++] = "chafa";
             argv[argc++] = "-f";
             argv[argc++] = format;
@@ -1697,7 +1686,7 @@ static void serialize_inline(terminal_buffer *buf,
     switch (type) {
         case CMARK_NODE_TEXT: {
             if (literal) {
-                const char *class_style = theme_style_for_node(theme, node);
+                const char *class_style = theme_style_for_node(theme, buf, node);
 
                 if (class_style) {
                     apply_style_string(buf, class_style, use_256_color);
@@ -1764,7 +1753,7 @@ static void serialize_inline(terminal_buffer *buf,
             break;
         case CMARK_NODE_CODE:
             if (literal) {
-                const char *class_style = theme_style_for_node(theme, node);
+                const char *class_style = theme_style_for_node(theme, buf, node);
                 if (class_style) {
                     apply_style_string(buf, class_style, use_256_color);
                 } else if (theme && theme->code_span) {
@@ -1778,7 +1767,7 @@ static void serialize_inline(terminal_buffer *buf,
             break;
         case CMARK_NODE_EMPH:
         {
-            const char *class_style = theme_style_for_node(theme, node);
+            const char *class_style = theme_style_for_node(theme, buf, node);
             if (class_style) {
                 apply_style_string(buf, class_style, use_256_color);
             }
@@ -1791,7 +1780,7 @@ static void serialize_inline(terminal_buffer *buf,
         }
         case CMARK_NODE_STRONG:
         {
-            const char *class_style = theme_style_for_node(theme, node);
+            const char *class_style = theme_style_for_node(theme, buf, node);
             if (class_style) {
                 apply_style_string(buf, class_style, use_256_color);
             }
@@ -1804,7 +1793,7 @@ static void serialize_inline(terminal_buffer *buf,
         }
         case CMARK_NODE_LINK: {
             const char *url = cmark_node_get_url(node);
-            const char *class_style = theme_style_for_node(theme, node);
+            const char *class_style = theme_style_for_node(theme, buf, node);
             if (class_style) {
                 apply_style_string(buf, class_style, use_256_color);
             } else if (theme && theme->link_text) {
@@ -1833,14 +1822,14 @@ static void serialize_inline(terminal_buffer *buf,
         case CMARK_NODE_IMAGE: {
             const char *url = cmark_node_get_url(node);
             bool did_inline = false;
-            if (g_term_img_tool != TERM_IMG_NONE && url && options && options->terminal_inline_images &&
+            if (buf->img_tool != TERM_IMG_NONE && url && options && options->terminal_inline_images &&
                 isatty(STDOUT_FILENO)) {
                 char *path_to_show = NULL;
                 bool is_temp_http = false;
 
                 if (terminal_url_is_http(url)) {
-                    if (g_term_has_curl) {
-                        path_to_show = terminal_fetch_http_image_temp(url);
+                    if (buf->has_curl) {
+                        path_to_show = terminal_fetch_http_image_temp(url, buf->has_curl);
                         is_temp_http = (path_to_show != NULL);
                     }
                 } else {
@@ -1862,9 +1851,9 @@ static void serialize_inline(terminal_buffer *buf,
                     if (terminal_debug_enabled()) {
                         fprintf(stderr,
                                 "[APEX_DEBUG_TERMINAL] image url=%s path=%s tool=%s\n",
-                                url, path_to_show, term_img_tool_name(g_term_img_tool));
+                                url, path_to_show, term_img_tool_name(buf->img_tool));
                     }
-                    if (run_terminal_image_tool(buf, g_term_img_tool, g_term_img_width, path_to_show)) {
+                    if (run_terminal_image_tool(buf, buf->img_tool, buf->img_width, path_to_show)) {
                         append_terminal_image_caption(buf, path_to_show, title, altbuf, options, theme,
                                                       use_256_color);
                         buffer_append_str(buf, "\n");
@@ -1883,7 +1872,7 @@ static void serialize_inline(terminal_buffer *buf,
                         reason = "terminal_inline_images disabled";
                     } else if (!isatty(STDOUT_FILENO)) {
                         reason = "stdout is not a TTY";
-                    } else if (g_term_img_tool == TERM_IMG_NONE) {
+                    } else if (buf->img_tool == TERM_IMG_NONE) {
                         reason = "no image viewer on PATH";
                     } else {
                         reason = "path resolve or viewer failed";
@@ -1913,8 +1902,8 @@ static void serialize_inline(terminal_buffer *buf,
                         const char *attrs = literal + 5; /* after 'span' */
                         const char *style = theme_style_for_node_attrs(theme, attrs);
                         if (style) {
-                            if (html_span_style_depth < (int)(sizeof(html_span_style_stack) / sizeof(html_span_style_stack[0]))) {
-                                html_span_style_stack[html_span_style_depth++] = style;
+                            if (buf->html_span_style_depth < (int)(sizeof(buf->html_span_style_stack) / sizeof(buf->html_span_style_stack[0]))) {
+                                buf->html_span_style_stack[buf->html_span_style_depth++] = style;
                             }
                             apply_style_string(buf, style, use_256_color);
                         }
@@ -1925,8 +1914,8 @@ static void serialize_inline(terminal_buffer *buf,
                      * re-apply any outer span styles; nested spans are rare
                      * in terminal output.
                      */
-                    if (html_span_style_depth > 0) {
-                        html_span_style_depth--;
+                    if (buf->html_span_style_depth > 0) {
+                        buf->html_span_style_depth--;
                     }
                     append_ansi_reset(buf);
                 } else {
@@ -1969,7 +1958,7 @@ static void serialize_terminal_image_as_link(terminal_buffer *buf,
                                              const apex_options *options,
                                              const terminal_theme *theme,
                                              bool use_256_color) {
-    const char *class_style = theme_style_for_node(theme, image);
+    const char *class_style = theme_style_for_node(theme, buf, image);
     if (class_style) {
         apply_style_string(buf, class_style, use_256_color);
     } else if (theme && theme->link_text) {
@@ -2010,8 +1999,7 @@ static void serialize_block(terminal_buffer *buf,
     if (type == CMARK_NODE_TABLE) {
         /* If advanced_tables or other processors marked this entire table for
          * removal, skip it. */
-        char *table_attrs = (char *)cmark_node_get_user_data(node);
-        if (table_attrs && strstr(table_attrs, "data-remove")) {
+        if (apex_attributes_has(apex_attr_pool_get(buf->attrs, node), "data-remove")) {
             return;
         }
 
@@ -2035,10 +2023,8 @@ static void serialize_block(terminal_buffer *buf,
             int logical_cols = 0;
             for (cmark_node *cell = cmark_node_first_child(row); cell; cell = cmark_node_next(cell)) {
                 if (cmark_node_get_type(cell) != CMARK_NODE_TABLE_CELL) continue;
-                char *attrs = (char *)cmark_node_get_user_data(cell);
-                int colspan = parse_span_attr(attrs, "colspan");
-                if (colspan < 1) colspan = 1;
-                logical_cols += colspan;
+                const apex_attributes *attrs = apex_attr_pool_get(buf->attrs, cell);
+                logical_cols += apex_attributes_get_int(attrs, "colspan", 1);
             }
             if (logical_cols > max_cols) max_cols = logical_cols;
         }
@@ -2058,13 +2044,11 @@ static void serialize_block(terminal_buffer *buf,
             for (cmark_node *cell = cmark_node_first_child(row); cell; cell = cmark_node_next(cell)) {
                 if (cmark_node_get_type(cell) != CMARK_NODE_TABLE_CELL) continue;
 
-                char *attrs = (char *)cmark_node_get_user_data(cell);
-                int colspan = parse_span_attr(attrs, "colspan");
-                int rowspan = parse_span_attr(attrs, "rowspan");
-                if (colspan < 1) colspan = 1;
-                if (rowspan < 1) rowspan = 1;
+                const apex_attributes *attrs = apex_attr_pool_get(buf->attrs, cell);
+                int colspan = apex_attributes_get_int(attrs, "colspan", 1);
+                int rowspan = apex_attributes_get_int(attrs, "rowspan", 1);
 
-                bool removed = (attrs && strstr(attrs, "data-remove"));
+                bool removed = apex_attributes_has(attrs, "data-remove");
 
                 if (!removed) {
                     /* Find next free column (skip slots already occupied by rowspans) */
@@ -2152,8 +2136,7 @@ static void serialize_block(terminal_buffer *buf,
         for (int c = 0; c < max_cols; c++) {
             term_cell *tc = grid_at(&grid, 0, c);
             if (!tc || !tc->cell || !tc->is_owner) continue;
-            const char *attrs = (const char *)cmark_node_get_user_data(tc->cell);
-            term_align_t a = parse_alignment_from_attrs(attrs);
+            term_align_t a = parse_alignment_from_attrs(apex_attr_pool_get(buf->attrs, tc->cell));
             if (a != TERM_ALIGN_DEFAULT) {
                 col_align[c] = a;
             }
@@ -2357,8 +2340,7 @@ static void serialize_block(terminal_buffer *buf,
                 if (col_align[c] != TERM_ALIGN_DEFAULT) {
                     align = col_align[c];
                 }
-                const char *attrs = (const char *)cmark_node_get_user_data(tc->cell);
-                term_align_t cell_align = parse_alignment_from_attrs(attrs);
+                term_align_t cell_align = parse_alignment_from_attrs(apex_attr_pool_get(buf->attrs, tc->cell));
                 if (cell_align != TERM_ALIGN_DEFAULT) {
                     align = cell_align;
                 }
@@ -2485,12 +2467,15 @@ static void serialize_block(terminal_buffer *buf,
                 if (getenv("APEX_DEBUG_THEME")) {
                     cmark_node_type ctype = cmark_node_get_type(child);
                     const char *lit = cmark_node_get_literal(child);
-                    const char *attrs = (const char *)cmark_node_get_user_data(child);
+                    const apex_attributes *typed = apex_node_attributes(child);
+                    char *serialized = typed ? attributes_to_html(typed) : NULL;
+                    const char *attrs = serialized ? serialized : (const char *)cmark_node_get_user_data(child);
                     fprintf(stderr,
                             "[APEX_DEBUG_THEME] inline node type=%d literal='%s' attrs='%s'\n",
                             (int)ctype,
                             lit ? lit : "",
                             attrs ? attrs : "");
+                    free(serialized);
                 }
                 serialize_inline(buf, child, options, theme, use_256_color);
             }
@@ -3064,19 +3049,14 @@ char *apex_cmark_to_terminal(cmark_node *document,
     terminal_buffer buf;
     buffer_init(&buf);
 
-    /* Reset HTML span style stack at the start of each render. */
-    html_span_style_depth = 0;
-
-    g_term_img_tool = TERM_IMG_NONE;
-    g_term_img_width = 50;
-    g_term_has_curl = executable_on_path("curl");
-    g_term_use_256 = use_256;
-    g_term_paginate_symbols = (options && options->paginate_symbols);
+    buf.has_curl = executable_on_path("curl");
+    buf.use_256 = use_256;
+    buf.paginate_symbols = (options && options->paginate_symbols);
     g_terminal_output_len = 0;
     if (options && options->terminal_inline_images && isatty(STDOUT_FILENO)) {
         int w = options->terminal_image_width > 0 ? options->terminal_image_width : 50;
-        g_term_img_width = w;
-        g_term_img_tool = probe_terminal_image_tool();
+        buf.img_width = w;
+        buf.img_tool = probe_terminal_image_tool(buf.paginate_symbols);
     }
 
     if (terminal_debug_enabled()) {
@@ -3085,7 +3065,7 @@ char *apex_cmark_to_terminal(cmark_node *document,
                 use_256 ? 1 : 0,
                 isatty(STDOUT_FILENO) ? 1 : 0,
                 (options && options->paginate) ? 1 : 0,
-                g_term_paginate_symbols ? 1 : 0,
+                buf.paginate_symbols ? 1 : 0,
                 (options && options->terminal_inline_images) ? 1 : 0);
         fprintf(stderr,
                 "[APEX_DEBUG_TERMINAL] TERM_PROGRAM=%s iterm=%d kitty=%d wezterm=%d chafa_format=%s\n",
@@ -3093,7 +3073,7 @@ char *apex_cmark_to_terminal(cmark_node *document,
                 terminal_is_iterm() ? 1 : 0,
                 terminal_is_kitty() ? 1 : 0,
                 terminal_is_wezterm() ? 1 : 0,
-                g_term_paginate_symbols ? "symbols" : terminal_chafa_format());
+                buf.paginate_symbols ? "symbols" : terminal_chafa_format());
         terminal_debug_log_tool_path("imgcat");
         terminal_debug_log_tool_path("chafa");
         terminal_debug_log_tool_path("catimg");
@@ -3101,7 +3081,7 @@ char *apex_cmark_to_terminal(cmark_node *document,
         terminal_debug_log_tool_path("curl");
         fprintf(stderr,
                 "[APEX_DEBUG_TERMINAL] selected image tool: %s (width=%d)\n",
-                term_img_tool_name(g_term_img_tool), g_term_img_width);
+                term_img_tool_name(buf.img_tool), buf.img_width);
         if (options && options->code_highlighter) {
             fprintf(stderr,
                     "[APEX_DEBUG_TERMINAL] code_highlighter=%s theme=%s\n",
@@ -3120,12 +3100,12 @@ char *apex_cmark_to_terminal(cmark_node *document,
                 theme ? theme->span_classes_count : 0);
     }
 
+    buf.attrs = apex_attr_pool_new();
     serialize_block(&buf, document, options, theme, use_256, 0);
+    apex_attr_pool_free(buf.attrs);
 
     free_theme(theme);
 
-    g_term_img_tool = TERM_IMG_NONE;
-
     if (!buf.buf) {
         /* Fallback: empty string */
         char *empty = (char *)malloc(1);
@@ -0,0 +1,342 @@
+/**
+ * Typed Node Attributes for Apex
+ * Implementation
+ */
+
+#include "attr_pool.h"
+#include "node.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+typedef struct {
+    cmark_node *node;            /* NULL marks an empty slot */
+    apex_attributes *attrs;      /* NULL if the node has no attributes */
+} attr_slot;
+
+struct apex_attr_pool {
+    attr_slot *slots;
+    size_t capacity;             /* Power of two */
+    size_t count;
+};
+
+#define ATTR_POOL_INITIAL_CAPACITY 64
+
+/* user_data of a node with typed attributes. It starts with a NUL byte so
+ * code that reads user_data as an attribute string sees "". */
+typedef struct {
+    char empty;
+    apex_attributes *attrs;
+} node_attributes;
+
+/* Also how typed user_data is told apart from an attribute string */
+static void node_attributes_free(cmark_mem *mem, void *data) {
+    (void)mem;
+    node_attributes *record = data;
+    apex_free_attributes(record->attrs);
+    free(record);
+}
+
+static node_attributes *node_record(cmark_node *node) {
+    if (!node || node->user_data_free_func != node_attributes_free) return NULL;
+    return (node_attributes *)node->user_data;
+}
+
+const apex_attributes *apex_node_attributes(cmark_node *node) {
+    node_attributes *record = node_record(node);
+    return record ? record->attrs : NULL;
+}
+
+bool apex_node_set_attributes(cmark_node *node, apex_attributes *attrs) {
+    if (!node || !attrs) {
+        apex_free_attributes(attrs);
+        return false;
+    }
+    node_attributes *record = node_record(node);
+    if (record) {
+        apex_free_attributes(record->attrs);
+        record->attrs = attrs;
+        return true;
+    }
+    record = malloc(sizeof(node_attributes));
+    if (!record) {
+        apex_free_attributes(attrs);
+        return false;
+    }
+    record->empty = '\0';
+    record->attrs = attrs;
+    /* An attribute string on user_data is owned by the node */
+    free(cmark_node_get_user_data(node));
+    cmark_node_set_user_data(node, record);
+    cmark_node_set_user_data_free_func(node, node_attributes_free);
+    return true;
+}
+
+apex_attributes *apex_node_take_attributes(cmark_node *node) {
+    node_attributes *record = node_record(node);
+    if (!record) return NULL;
+    apex_attributes *attrs = record->attrs;
+    free(record);
+    cmark_node_set_user_data(node, NULL);
+    cmark_node_set_user_data_free_func(node, NULL);
+    return attrs;
+}
+
+apex_attr_pool *apex_attr_pool_new(void) {
+    apex_attr_pool *pool = calloc(1, sizeof(apex_attr_pool));
+    if (!pool) return NULL;
+    pool->slots = calloc(ATTR_POOL_INITIAL_CAPACITY, sizeof(attr_slot));
+    if (!pool->slots) {
+        free(pool);
+        return NULL;
+    }
+    pool->capacity = ATTR_POOL_INITIAL_CAPACITY;
+    return pool;
+}
+
+void apex_attr_pool_free(apex_attr_pool *pool) {
+    if (!pool) return;
+    for (size_t i = 0; i < pool->capacity; i++) {
+        apex_free_attributes(pool->slots[i].attrs);
+    }
+    free(pool->slots);
+    free(pool);
+}
+
+static size_t node_hash(const cmark_node *node) {
+    uintptr_t h = (uintptr_t)node;
+    h ^= h >> 17;
+    h *= (uintptr_t)0x9E3779B97F4A7C15ULL;
+    return (size_t)(h ^ (h >> 29));
+}
+
+static attr_slot *pool_find_slot(attr_slot *slots, size_t capacity, const cmark_node *node) {
+    size_t i = node_hash(node) & (capacity - 1);
+    while (slots[i].node && slots[i].node != node) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &slots[i];
+}
+
+static bool pool_grow(apex_attr_pool *pool) {
+    size_t capacity = pool->capacity * 2;
+    attr_slot *slots = calloc(capacity, sizeof(attr_slot));
+    if (!slots) return false;
+    for (size_t i = 0; i < pool->capacity; i++) {
+        if (pool->slots[i].node) {
+            *pool_find_slot(slots, capacity, pool->slots[i].node) = pool->slots[i];
+        }
+    }
+    free(pool->slots);
+    pool->slots = slots;
+    pool->capacity = capacity;
+    return true;
+}
+
+static bool push_string(char ***list, int *count, char *value) {
+    char **grown = realloc(*list, sizeof(char *) * (size_t)(*count + 1));
+    if (!grown) return false;
+    *list = grown;
+    grown[(*count)++] = value;
+    return true;
+}
+
+/* Split a class attribute value into the class list */
+static bool add_classes(apex_attributes *attrs, const char *value, size_t len) {
+    const char *end = value + len;
+    while (value < end) {
+        while (value < end && isspace((unsigned char)*value)) value++;
+        const char *start = value;
+        while (value < end && !isspace((unsigned char)*value)) value++;
+        if (value == start) break;
+        char *name = strndup(start, (size_t)(value - start));
+        if (!name || !push_string(&attrs->classes, &attrs->class_count, name)) {
+            free(name);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* value is NULL for a bare attribute */
+static bool add_pair(apex_attributes *attrs, const char *key, size_t key_len,
+                     const char *value, size_t value_len) {
+    char *k = strndup(key, key_len);
+    char *v = value ? strndup(value, value_len) : NULL;
+    if (!k || (value && !v)) {
+        free(k);
+        free(v);
+        return false;
+    }
+    /* Grow values first so a failed keys realloc can't leave counts out of step */
+    char **values = realloc(attrs->values, sizeof(char *) * (size_t)(attrs->attr_count + 1));
+    if (values) attrs->values = values;
+    if (!values || !push_string(&attrs->keys, &attrs->attr_count, k)) {
+        free(k);
+        free(v);
+        return false;
+    }
+    attrs->values[attrs->attr_count - 1] = v;
+    return true;
+}
+
+apex_attributes *apex_attributes_from_html(const char *attrs) {
+    if (!attrs) return NULL;
+    apex_attributes *result = calloc(1, sizeof(apex_attributes));
+    if (!result) return NULL;
+
+    const char *p = attrs;
+    while (*p) {
+        while (*p && isspace((unsigned char)*p)) p++;
+        if (!*p) break;
+
+        const char *name = p;
+        while (*p && *p != '=' && !isspace((unsigned char)*p)) p++;
+        size_t name_len = (size_t)(p - name);
+
+        const char *value = NULL;
+        size_t value_len = 0;
+        if (*p == '=') {
+            p++;
+            if (*p == '"' || *p == '\'') {
+                char quote = *p++;
+                value = p;
+                while (*p && *p != quote) p++;
+                value_len = (size_t)(p - value);
+                if (*p) p++;
+            } else {
+                value = p;
+                while (*p && !isspace((unsigned char)*p)) p++;
+                value_len = (size_t)(p - value);
+            }
+        }
+        if (name_len == 0) {
+            if (*p) p++;
+            continue;
+        }
+
+        bool is_id = name_len == 2 && strncmp(name, "id", 2) == 0;
+        bool is_class = name_len == 5 && strncmp(name, "class", 5) == 0;
+        bool ok;
+        if (!value && (is_id || is_class)) {
+            ok = true;  /* A bare id or class has nothing to hold */
+        } else if (is_id) {
+            free(result->id);
+            result->id = strndup(value, value_len);
+            ok = result->id != NULL;
+        } else if (is_class) {
+            ok = add_classes(result, value, value_len);
+        } else {
+            ok = add_pair(result, name, name_len, value, value_len);
+        }
+        if (!ok) {
+            apex_free_attributes(result);
+            return NULL;
+        }
+    }
+    return result;
+}
+
+/* Move the strings of one list onto the end of another, skipping those
+ * already there; moved or freed, none are left in from */
+static bool merge_strings(char ***list, int *count, char **from, int from_count) {
+    bool ok = true;
+    for (int i = 0; i < from_count; i++) {
+        bool present = false;
+        for (int j = 0; j < *count && !present; j++) {
+            present = strcmp((*list)[j], from[i]) == 0;
+        }
+        if (present || !ok || !push_string(list, count, from[i])) {
+            if (!present) ok = false;
+            free(from[i]);
+        }
+    }
+    return ok;
+}
+
+bool apex_node_add_attributes(cmark_node *node, apex_attributes *attrs) {
+    if (!node || !attrs) {
+        apex_free_attributes(attrs);
+        return false;
+    }
+
+    apex_attributes *base = (apex_attributes *)apex_node_attributes(node);
+    if (!base) {
+        const char *data = (const char *)cmark_node_get_user_data(node);
+        if (!data || !*data) return apex_node_set_attributes(node, attrs);
+        base = apex_attributes_from_html(data);
+        if (!base || !apex_node_set_attributes(node, base)) {
+            apex_free_attributes(attrs);
+            return false;
+        }
+    }
+
+    if (!base->id) {
+        base->id = attrs->id;
+        attrs->id = NULL;
+    }
+    bool ok = merge_strings(&base->classes, &base->class_count, attrs->classes, attrs->class_count);
+    attrs->class_count = 0;
+    for (int i = 0; i < attrs->attr_count; i++) {
+        bool present = false;
+        for (int j = 0; j < base->attr_count && !present; j++) {
+            present = strcmp(base->keys[j], attrs->keys[i]) == 0;
+        }
+        if (present || !ok) continue;
+        const char *value = attrs->values[i];
+        ok = add_pair(base, attrs->keys[i], strlen(attrs->keys[i]), value, value ? strlen(value) : 0);
+    }
+    apex_free_attributes(attrs);
+    return ok;
+}
+
+const apex_attributes *apex_attr_pool_get(apex_attr_pool *pool, cmark_node *node) {
+    if (!pool || !node) return NULL;
+
+    /* Typed attributes are read in place */
+    const apex_attributes *typed = apex_node_attributes(node);
+    if (typed) return typed;
+
+    const char *data = (const char *)cmark_node_get_user_data(node);
+
+    attr_slot *slot = pool_find_slot(pool->slots, pool->capacity, node);
+    if (slot->node) return slot->attrs;
+
+    /* Keep the load factor at or below one half */
+    if ((pool->count + 1) * 2 > pool->capacity) {
+        if (!pool_grow(pool)) return NULL;
+        slot = pool_find_slot(pool->slots, pool->capacity, node);
+    }
+    slot->node = node;
+    slot->attrs = data && *data ? apex_attributes_from_html(data) : NULL;
+    pool->count++;
+    return slot->attrs;
+}
+
+const char *apex_attributes_get(const apex_attributes *attrs, const char *key) {
+    if (!attrs || !key) return NULL;
+    for (int i = 0; i < attrs->attr_count; i++) {
+        if (attrs->values[i] && strcmp(attrs->keys[i], key) == 0) return attrs->values[i];
+    }
+    return NULL;
+}
+
+bool apex_attributes_has(const apex_attributes *attrs, const char *key) {
+    return apex_attributes_get(attrs, key) != NULL;
+}
+
+int apex_attributes_get_int(const apex_attributes *attrs, const char *key, int fallback) {
+    const char *value = apex_attributes_get(attrs, key);
+    if (!value) return fallback;
+    int n = atoi(value);
+    return n > 0 ? n : fallback;
+}
+
+bool apex_attributes_has_class(const apex_attributes *attrs, const char *class_name) {
+    if (!attrs || !class_name) return false;
+    for (int i = 0; i < attrs->class_count; i++) {
+        if (strcmp(attrs->classes[i], class_name) == 0) return true;
+    }
+    return false;
+}
@@ -0,0 +1,112 @@
+/**
+ * Typed Node Attributes for Apex
+ *
+ * IAL, ALDs, span attributes and header IDs are stored on the node they
+ * apply to as an apex_attributes (id, class list, key/value pairs) with
+ * apex_node_set_attributes() or apex_node_add_attributes(). The node owns
+ * them (cmark frees them with the node) and renderers serialize them once,
+ * when the opening tag is written.
+ *
+ * Image attributes and advanced_tables' caption, span and footer markers
+ * are still left on user_data as an HTML attribute string such as
+ * ` id="x" class="a b" colspan="2"`. A pool parses each node's string
+ * once and keeps it for the rest of the document's render, and hands back
+ * typed attributes as they are, so readers see one view of both.
+ *
+ * A pool belongs to one document and one render: it assumes user_data is
+ * not replaced while the pool is alive.
+ */
+
+#ifndef APEX_ATTR_POOL_H
+#define APEX_ATTR_POOL_H
+
+#include <stdbool.h>
+#include "cmark-gfm.h"
+#include "extensions/ial.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct apex_attr_pool apex_attr_pool;
+
+/**
+ * Create an empty pool. Returns NULL on allocation failure.
+ */
+apex_attr_pool *apex_attr_pool_new(void);
+
+/**
+ * Free a pool and every attribute set it parsed
+ */
+void apex_attr_pool_free(apex_attr_pool *pool);
+
+/**
+ * Attributes of a node, parsed from its user_data on first use.
+ * Returns NULL if the node has no attributes (or pool is NULL). The
+ * result is owned by the pool.
+ */
+const apex_attributes *apex_attr_pool_get(apex_attr_pool *pool, cmark_node *node);
+
+/**
+ * Attributes stored typed on node, or NULL if it has none or its
+ * user_data is an attribute string. Owned by the node.
+ */
+const apex_attributes *apex_node_attributes(cmark_node *node);
+
+/**
+ * Store attrs on node, replacing whatever its user_data held. The node
+ * takes ownership of attrs, even on failure. Returns false on failure.
+ */
+bool apex_node_set_attributes(cmark_node *node, apex_attributes *attrs);
+
+/**
+ * Merge attrs into the node's attributes (an attribute string already on
+ * the node is parsed first). What the node has wins: its id is kept, and
+ * only classes and keys it lacks are added. The node takes ownership of
+ * attrs, even on failure. Returns false on failure.
+ */
+bool apex_node_add_attributes(cmark_node *node, apex_attributes *attrs);
+
+/**
+ * Detach the node's typed attributes and return them (caller frees with
+ * apex_free_attributes), leaving user_data empty; NULL if it has none
+ */
+apex_attributes *apex_node_take_attributes(cmark_node *node);
+
+/**
+ * Parse an HTML attribute string (` id="x" class="a b" key="v" flag`)
+ * Bare attributes such as `flag` are kept with a NULL value, so a cell
+ * whose user_data is raw text like "rowspan" has no rowspan attribute.
+ * Returns NULL if attrs is NULL or allocation fails. Caller frees with
+ * apex_free_attributes.
+ */
+apex_attributes *apex_attributes_from_html(const char *attrs);
+
+/**
+ * Value of a key/value attribute ("id" and "class" are held separately),
+ * or NULL if absent or bare
+ */
+const char *apex_attributes_get(const apex_attributes *attrs, const char *key);
+
+/**
+ * Whether a key/value attribute is present with a value (which may be
+ * empty, as in key=""); bare attributes don't count
+ */
+bool apex_attributes_has(const apex_attributes *attrs, const char *key);
+
+/**
+ * Integer value of an attribute such as colspan, or fallback if it is
+ * absent or not a positive number
+ */
+int apex_attributes_get_int(const apex_attributes *attrs, const char *key, int fallback);
+
+/**
+ * Whether the class list contains class_name
+ */
+bool apex_attributes_has_class(const apex_attributes *attrs, const char *class_name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APEX_ATTR_POOL_H */
@@ -0,0 +1,354 @@
+/**
+ * Chunk Planning for Parallel Parsing
+ */
+
+#include "chunk_split.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+/* Multi-line HTML block kinds (CommonMark start conditions 1-5) */
+typedef enum {
+    CHUNK_HTML_NONE = 0,
+    CHUNK_HTML_RAW,       /* <pre>, <script>, <style>, <textarea> */
+    CHUNK_HTML_COMMENT,   /* <!-- ... --> */
+    CHUNK_HTML_PI,        /* <? ... ?> */
+    CHUNK_HTML_DECL,      /* <!X ... > */
+    CHUNK_HTML_CDATA      /* <![CDATA[ ... ]]> */
+} chunk_html_kind;
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+} chunk_buf;
+
+static bool chunk_buf_append(chunk_buf *b, const char *s, size_t n) {
+    if (b->len + n + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 256;
+        while (cap < b->len + n + 1) cap *= 2;
+        char *nb = realloc(b->buf, cap);
+        if (!nb) return false;
+        b->buf = nb;
+        b->cap = cap;
+    }
+    memcpy(b->buf + b->len, s, n);
+    b->len += n;
+    b->buf[b->len] = '\0';
+    return true;
+}
+
+/* Case-insensitive search for needle in [s, end) */
+static const char *chunk_find_ci(const char *s, const char *end, const char *needle) {
+    size_t n = strlen(needle);
+    for (; s + n <= end; s++) {
+        if (strncasecmp(s, needle, n) == 0) return s;
+    }
+    return NULL;
+}
+
+static bool chunk_is_blank(const char *p, const char *end) {
+    for (; p < end; p++) {
+        if (*p != ' ' && *p != '\t' && *p != '\r') return false;
+    }
+    return true;
+}
+
+/* Skip leading whitespace; returns the indentation in columns */
+static int chunk_indent(const char *line, const char *end, const char **first) {
+    int cols = 0;
+    const char *p = line;
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        cols = (*p == '\t') ? (cols / 4 + 1) * 4 : cols + 1;
+        p++;
+    }
+    *first = p;
+    return cols;
+}
+
+/* Length of the run of c starting at p */
+static size_t chunk_run(const char *p, const char *end, char c) {
+    size_t n = 0;
+    while (p + n < end && p[n] == c) n++;
+    return n;
+}
+
+static bool chunk_is_atx_heading(const char *p, const char *end) {
+    size_t n = chunk_run(p, end, '#');
+    if (n < 1 || n > 6) return false;
+    return p + n == end || p[n] == ' ' || p[n] == '\t' || p[n] == '\r';
+}
+
+static bool chunk_html_end_found(chunk_html_kind kind, const char *p, const char *end) {
+    switch (kind) {
+        case CHUNK_HTML_RAW:
+            return chunk_find_ci(p, end, "</pre>") || chunk_find_ci(p, end, "</script>") ||
+                   chunk_find_ci(p, end, "</style>") || chunk_find_ci(p, end, "</textarea>");
+        case CHUNK_HTML_COMMENT: return chunk_find_ci(p, end, "-->") != NULL;
+        case CHUNK_HTML_PI:      return chunk_find_ci(p, end, "?>") != NULL;
+        case CHUNK_HTML_DECL:    return memchr(p, '>', (size_t)(end - p)) != NULL;
+        case CHUNK_HTML_CDATA:   return chunk_find_ci(p, end, "]]>") != NULL;
+        default:                 return true;
+    }
+}
+
+/* Which multi-line HTML block, if any, starts at p; *body is where to look for its end */
+static chunk_html_kind chunk_html_start(const char *p, const char *end, const char **body) {
+    static const char *raw_tags[] = { "pre", "script", "style", "textarea" };
+    size_t avail = (size_t)(end - p);
+
+    if (avail < 2 || p[0] != '<') return CHUNK_HTML_NONE;
+    if (avail >= 4 && strncmp(p, "<!--", 4) == 0) {
+        *body = p + 4;
+        return CHUNK_HTML_COMMENT;
+    }
+    if (p[1] == '?') {
+        *body = p + 2;
+        return CHUNK_HTML_PI;
+    }
+    if (avail >= 9 && strncmp(p, "<![CDATA[", 9) == 0) {
+        *body = p + 9;
+        return CHUNK_HTML_CDATA;
+    }
+    if (p[1] == '!' && avail >= 3 && isalpha((unsigned char)p[2])) {
+        *body = p + 2;
+        return CHUNK_HTML_DECL;
+    }
+    for (size_t i = 0; i < sizeof(raw_tags) / sizeof(raw_tags[0]); i++) {
+        size_t n = strlen(raw_tags[i]);
+        if (avail >= n + 1 && strncasecmp(p + 1, raw_tags[i], n) == 0) {
+            const char *after = p + 1 + n;
+            if (after == end || *after == ' ' || *after == '\t' || *after == '>' || *after == '\r') {
+                *body = p;
+                return CHUNK_HTML_RAW;
+            }
+        }
+    }
+    return CHUNK_HTML_NONE;
+}
+
+/* "[label]:" at p (footnote definitions excluded); *dest is set past the colon */
+static bool chunk_is_refdef(const char *p, const char *end, const char **dest) {
+    if (p >= end || *p != '[' || (p + 1 < end && p[1] == '^')) return false;
+    const char *q = p + 1;
+    while (q < end && *q != ']') {
+        if (*q == '[') return false;
+        if (*q == '\\' && q + 1 < end) q++;
+        q++;
+    }
+    if (q >= end || q == p + 1 || q + 1 >= end || q[1] != ':') return false;
+    *dest = q + 2;
+    return true;
+}
+
+/* "[label]:" behind block quote markers or list item markers */
+static bool chunk_is_nested_refdef(const char *p, const char *end) {
+    const char *dest;
+    for (;;) {
+        while (p < end && (*p == '>' || *p == ' ' || *p == '\t')) p++;
+        if (p + 1 < end && (*p == '-' || *p == '*' || *p == '+') && (p[1] == ' ' || p[1] == '\t')) {
+            p++;
+            continue;
+        }
+        const char *d = p;
+        while (d < end && isdigit((unsigned char)*d)) d++;
+        if (d > p && d + 1 < end && (*d == '.' || *d == ')') && (d[1] == ' ' || d[1] == '\t')) {
+            p = d + 1;
+            continue;
+        }
+        break;
+    }
+    return chunk_is_refdef(p, end, &dest);
+}
+
+/* Does a title opened on the definition line also close there? */
+static bool chunk_title_closed(const char *dest, const char *end) {
+    const char *p = dest;
+    if (p < end && *p == '<') {
+        while (p < end && *p != '>') p++;
+        if (p < end) p++;
+    } else {
+        while (p < end && *p != ' ' && *p != '\t') p++;
+    }
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    if (p >= end || (*p != '"' && *p != '\'' && *p != '(')) return true;
+    char close = (*p == '(') ? ')' : *p;
+    for (p++; p < end; p++) {
+        if (*p == '\\' && p + 1 < end) {
+            p++;
+        } else if (*p == close) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Does the line after a reference definition look like a title continuation? */
+static bool chunk_next_is_title(const char *next, const char *end) {
+    const char *p;
+    chunk_indent(next, end, &p);
+    return p < end && (*p == '"' || *p == '\'' || *p == '(');
+}
+
+/* Append a cut; offsets grows as needed */
+static bool chunk_add_cut(apex_chunk_plan *plan, size_t *cap, size_t offset) {
+    if (plan->count == *cap) {
+        size_t ncap = *cap ? *cap * 2 : 16;
+        size_t *no = realloc(plan->offsets, ncap * sizeof(size_t));
+        if (!no) return false;
+        plan->offsets = no;
+        *cap = ncap;
+    }
+    plan->offsets[plan->count++] = offset;
+    return true;
+}
+
+/*
+ * Scan text once, tracking fences, HTML blocks, divs and reference
+ * definitions. With want == 0 every safe heading becomes a cut; otherwise
+ * up to want chunks are cut near multiples of target, each at least
+ * min_chunk bytes.
+ */
+static bool chunk_scan(const char *text, size_t len, size_t want, size_t target,
+                       size_t min_chunk, apex_chunk_plan *plan) {
+    size_t cap = 0;
+    if (!chunk_add_cut(plan, &cap, 0)) return false;
+
+    chunk_buf refdefs = {0};
+    char fence_char = 0;
+    size_t fence_len = 0;
+    int fence_indent = 0;
+    chunk_html_kind html = CHUNK_HTML_NONE;
+    int div_depth = 0;
+    bool prev_blank = true;
+    bool prev_refdef = false;
+    bool ok = true;
+
+    const char *end_text = text + len;
+    const char *ls = text;
+    while (ok && ls < end_text) {
+        const char *nl = memchr(ls, '\n', (size_t)(end_text - ls));
+        const char *le = nl ? nl : end_text;
+        const char *next = nl ? nl + 1 : end_text;
+        const char *p;
+        int indent = chunk_indent(ls, le, &p);
+        bool blank = (p == le) || chunk_is_blank(p, le);
+        bool is_refdef = false;
+
+        if (fence_char) {
+            if (!blank && indent < fence_indent) {
+                /* Could be the end of a list item holding the fence; give up */
+                ok = false;
+                break;
+            }
+            if (!blank && indent <= 3 && chunk_run(p, le, fence_char) >= fence_len &&
+                chunk_is_blank(p + chunk_run(p, le, fence_char), le)) {
+                fence_char = 0;
+            }
+        } else if (html != CHUNK_HTML_NONE) {
+            if (chunk_html_end_found(html, p, le)) html = CHUNK_HTML_NONE;
+        } else if (!blank && indent <= 3) {
+            size_t run;
+            const char *body = NULL;
+            const char *dest = NULL;
+            chunk_html_kind kind;
+
+            if ((*p == '`' || *p == '~') && (run = chunk_run(p, le, *p)) >= 3 &&
+                !(*p == '`' && memchr(p + run, '`', (size_t)(le - p - run)))) {
+                fence_char = *p;
+                fence_len = run;
+                fence_indent = indent;
+            } else if (*p == ':' && chunk_run(p, le, ':') >= 3) {
+                run = chunk_run(p, le, ':');
+                if (!chunk_is_blank(p + run, le)) {
+                    div_depth++;
+                } else if (div_depth > 0) {
+                    div_depth--;
+                }
+            } else if ((kind = chunk_html_start(p, le, &body)) != CHUNK_HTML_NONE) {
+                if (!chunk_html_end_found(kind, body, le)) html = kind;
+            } else if (*p == '#' && prev_blank && indent == 0 && div_depth == 0 &&
+                       chunk_is_atx_heading(p, le)) {
+                size_t at = (size_t)(ls - text);
+                bool cut = want == 0
+                    ? at > 0
+                    : (plan->count < want && at >= plan->count * target &&
+                       at - plan->offsets[plan->count - 1] >= min_chunk &&
+                       len - at >= min_chunk);
+                if (cut && !chunk_add_cut(plan, &cap, at)) {
+                    ok = false;
+                    break;
+                }
+            } else if (chunk_is_refdef(p, le, &dest)) {
+                /* Only a definition if it starts a block, with its destination on the line */
+                const char *d;
+                chunk_indent(dest, le, &d);
+                if ((!prev_blank && !prev_refdef) || d >= le || chunk_is_blank(d, le) ||
+                    !chunk_title_closed(d, le) ||
+                    (next < end_text && chunk_next_is_title(next, end_text))) {
+                    ok = false;
+                    break;
+                }
+                if (!chunk_buf_append(&refdefs, p, (size_t)(le - p)) ||
+                    !chunk_buf_append(&refdefs, "\n", 1)) {
+                    ok = false;
+                    break;
+                }
+                is_refdef = true;
+            } else if (chunk_is_nested_refdef(p, le)) {
+                /* Definitions inside quotes and list items are not tracked */
+                ok = false;
+                break;
+            }
+        } else if (!blank && chunk_is_nested_refdef(p, le)) {
+            ok = false;
+            break;
+        }
+
+        prev_blank = blank;
+        prev_refdef = is_refdef;
+        ls = next;
+    }
+
+    if (ok && refdefs.len) ok = chunk_buf_append(&refdefs, "\n", 1);
+    if (!ok) {
+        free(refdefs.buf);
+        apex_chunk_plan_free(plan);
+        return false;
+    }
+
+    plan->refdefs = refdefs.buf;
+    plan->refdefs_len = refdefs.len;
+    return true;
+}
+
+bool apex_plan_chunks(const char *text, size_t len, size_t max_chunks,
+                      size_t min_chunk, apex_chunk_plan *plan) {
+    memset(plan, 0, sizeof(*plan));
+    if (!text || max_chunks < 2 || min_chunk == 0 || len < 2 * min_chunk) return false;
+
+    size_t want = len / min_chunk;
+    if (want > max_chunks) want = max_chunks;
+
+    if (!chunk_scan(text, len, want, len / want, min_chunk, plan)) return false;
+    if (plan->count < 2) {
+        apex_chunk_plan_free(plan);
+        return false;
+    }
+    return true;
+}
+
+bool apex_plan_sections(const char *text, size_t len, apex_chunk_plan *plan) {
+    memset(plan, 0, sizeof(*plan));
+    if (!text) return false;
+    return chunk_scan(text, len, 0, 0, 0, plan);
+}
+
+void apex_chunk_plan_free(apex_chunk_plan *plan) {
+    if (!plan) return;
+    free(plan->offsets);
+    free(plan->refdefs);
+    memset(plan, 0, sizeof(*plan));
+}
@@ -0,0 +1,66 @@
+/**
+ * Chunk Planning for Parallel Parsing
+ *
+ * Finds places where a large document can be cut into independent pieces
+ * that parse to the same top-level blocks as the whole. A cut is only made
+ * in front of an ATX heading that follows a blank line and sits outside
+ * any code fence, fenced div or multi-line HTML block, so no block can
+ * straddle two chunks.
+ *
+ * Link reference definitions are the one piece of parse state shared by
+ * the whole document. The planner collects them in document order so the
+ * caller can repeat them at the top of every chunk; cmark keeps the first
+ * definition of a label, exactly as it does for the full text.
+ *
+ * Anything the planner cannot prove safe (a definition inside a paragraph
+ * or block quote, a title on a continuation line, ...) makes it give up,
+ * and the caller parses the document in one piece.
+ */
+
+#ifndef APEX_CHUNK_SPLIT_H
+#define APEX_CHUNK_SPLIT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    size_t *offsets;     /* Start of each chunk; offsets[0] is 0 */
+    size_t count;        /* Number of chunks */
+    char *refdefs;       /* Reference definitions to prepend to each chunk, or NULL */
+    size_t refdefs_len;
+} apex_chunk_plan;
+
+/**
+ * Plan a split of text into at most max_chunks chunks of at least
+ * min_chunk bytes each.
+ *
+ * Returns true and fills plan when the document can be split safely.
+ * Returns false (plan zeroed) when it is too small, has no safe cut
+ * points, or contains constructs the planner does not handle.
+ */
+bool apex_plan_chunks(const char *text, size_t len, size_t max_chunks,
+                      size_t min_chunk, apex_chunk_plan *plan);
+
+/**
+ * Split text in front of every safe heading, however small the pieces.
+ *
+ * Returns true with at least one chunk (the whole text when there is no
+ * safe heading), or false when the text contains constructs the planner
+ * does not handle.
+ */
+bool apex_plan_sections(const char *text, size_t len, apex_chunk_plan *plan);
+
+/**
+ * Free the memory held by a plan
+ */
+void apex_chunk_plan_free(apex_chunk_plan *plan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APEX_CHUNK_SPLIT_H */
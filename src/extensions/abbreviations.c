@@ -216,8 +216,378 @@ abbr_item *apex_extract_abbreviations(char **text_ptr) {
     return abbrs;
 }
 
+
+/**
+ * Append to a growable output buffer
+ */
+static bool append_chunk(char **out, size_t *len, size_t *cap, const char *chunk, size_t chunk_len) {
+    if (*len + chunk_len + 1 > *cap) {
+        size_t new_cap = *cap ? *cap : 256;
+        while (*len + chunk_len + 1 > new_cap) {
+            new_cap *= 2;
+        }
+        char *new_out = realloc(*out, new_cap);
+        if (!new_out) return false;
+        *out = new_out;
+        *cap = new_cap;
+    }
+    memcpy(*out + *len, chunk, chunk_len);
+    *len += chunk_len;
+    (*out)[*len] = '\0';
+    return true;
+}
+
+static bool append_abbr_tag(char **out, size_t *len, size_t *cap,
+                            const char *abbr, size_t abbr_len,
+                            const char *title, size_t title_len) {
+    return append_chunk(out, len, cap, "<abbr title=\"", 13) &&
+           append_chunk(out, len, cap, title, title_len) &&
+           append_chunk(out, len, cap, "\">", 2) &&
+           append_chunk(out, len, cap, abbr, abbr_len) &&
+           append_chunk(out, len, cap, "</abbr>", 7);
+}
+
+/**
+ * Trim whitespace from both ends of a span
+ */
+static void trim_span(const char **start, size_t *len) {
+    while (*len && isspace((unsigned char)**start)) {
+        (*start)++;
+        (*len)--;
+    }
+    while (*len && isspace((unsigned char)(*start)[*len - 1])) (*len)--;
+}
+
+/**
+ * Aho-Corasick automaton over the abbreviation strings. Node 0 is the root;
+ * its edges are a direct table, other nodes keep a sibling list since they
+ * rarely have more than a couple of children.
+ */
+typedef struct {
+    int first_child;
+    int next_sibling;
+    int fail;       /* Longest proper suffix of this node's string that is in the trie */
+    int output;     /* Nearest node on the fail chain that ends an abbreviation, 0 if none */
+    int item;       /* First abbreviation (in list order) ending here, -1 if none */
+    unsigned char byte;
+} abbr_ac_node;
+
+typedef struct {
+    abbr_ac_node *nodes;
+    size_t node_count;
+    size_t node_capacity;
+    int root[256];
+    abbr_item **items;   /* Abbreviations by list index */
+    size_t *lengths;
+} abbr_automaton;
+
+typedef struct {
+    size_t start;
+    size_t len;
+    int item;
+} abbr_match;
+
+static int ac_child(const abbr_automaton *ac, int node, unsigned char c) {
+    if (node == 0) return ac->root[c];
+    for (int child = ac->nodes[node].first_child; child; child = ac->nodes[child].next_sibling) {
+        if (ac->nodes[child].byte == c) return child;
+    }
+    return 0;
+}
+
+static int ac_add_child(abbr_automaton *ac, int parent, unsigned char c) {
+    if (ac->node_count == ac->node_capacity) {
+        size_t new_cap = ac->node_capacity * 2;
+        abbr_ac_node *nodes = realloc(ac->nodes, new_cap * sizeof(abbr_ac_node));
+        if (!nodes) return -1;
+        ac->nodes = nodes;
+        ac->node_capacity = new_cap;
+    }
+    int child = (int)ac->node_count++;
+    abbr_ac_node *node = &ac->nodes[child];
+    node->first_child = 0;
+    node->fail = 0;
+    node->output = 0;
+    node->item = -1;
+    node->byte = c;
+    if (parent == 0) {
+        node->next_sibling = 0;
+        ac->root[c] = child;
+    } else {
+        node->next_sibling = ac->nodes[parent].first_child;
+        ac->nodes[parent].first_child = child;
+    }
+    return child;
+}
+
+static void ac_free(abbr_automaton *ac) {
+    free(ac->nodes);
+    free(ac->items);
+    free(ac->lengths);
+}
+
+/**
+ * Build the automaton: a trie of every abbreviation, then fail and output
+ * links breadth-first so each node's fail target is finished before it.
+ */
+static bool ac_build(abbr_automaton *ac, abbr_item *abbrs) {
+    memset(ac, 0, sizeof(*ac));
+
+    size_t item_count = 0;
+    size_t total_len = 0;
+    for (abbr_item *item = abbrs; item; item = item->next) {
+        item_count++;
+        total_len += strlen(item->abbr);
+    }
+
+    ac->node_capacity = total_len + 1;
+    ac->nodes = malloc(ac->node_capacity * sizeof(abbr_ac_node));
+    ac->items = malloc(item_count * sizeof(abbr_item *));
+    ac->lengths = malloc(item_count * sizeof(size_t));
+    if (!ac->nodes || !ac->items || !ac->lengths) {
+        ac_free(ac);
+        return false;
+    }
+    ac->node_count = 1;
+    memset(&ac->nodes[0], 0, sizeof(abbr_ac_node));
+    ac->nodes[0].item = -1;
+
+    int index = 0;
+    for (abbr_item *item = abbrs; item; item = item->next, index++) {
+        const unsigned char *s = (const unsigned char *)item->abbr;
+        size_t len = strlen(item->abbr);
+        ac->items[index] = item;
+        ac->lengths[index] = len;
+        /* An empty abbreviation would match everywhere without consuming anything */
+        if (len == 0) continue;
+
+        int node = 0;
+        for (size_t i = 0; i < len; i++) {
+            int next = ac_child(ac, node, s[i]);
+            if (!next) next = ac_add_child(ac, node, s[i]);
+            if (next < 0) {
+                ac_free(ac);
+                return false;
+            }
+            node = next;
+        }
+        /* Duplicates keep the earlier definition, as the list walk did */
+        if (ac->nodes[node].item < 0) ac->nodes[node].item = index;
+    }
+
+    int *queue = malloc(ac->node_count * sizeof(int));
+    if (!queue) {
+        ac_free(ac);
+        return false;
+    }
+    size_t head = 0, tail = 0;
+    for (int c = 0; c < 256; c++) {
+        if (ac->root[c]) queue[tail++] = ac->root[c];
+    }
+    while (head < tail) {
+        int node = queue[head++];
+        for (int child = ac->nodes[node].first_child; child; child = ac->nodes[child].next_sibling) {
+            unsigned char c = ac->nodes[child].byte;
+            int f = ac->nodes[node].fail;
+            int target;
+            while (!(target = ac_child(ac, f, c)) && f) f = ac->nodes[f].fail;
+            ac->nodes[child].fail = target;
+            ac->nodes[child].output = ac->nodes[target].item >= 0 ? target : ac->nodes[target].output;
+            queue[tail++] = child;
+        }
+    }
+    free(queue);
+    return true;
+}
+
+static int ac_step(const abbr_automaton *ac, int state, unsigned char c) {
+    for (;;) {
+        int next = ac_child(ac, state, c);
+        if (next || state == 0) return next;
+        state = ac->nodes[state].fail;
+    }
+}
+
+/**
+ * Index of the first abbreviation equal to key, or -1
+ */
+static int ac_lookup(const abbr_automaton *ac, const char *key, size_t len) {
+    int node = 0;
+    for (size_t i = 0; i < len; i++) {
+        node = ac_child(ac, node, (unsigned char)key[i]);
+        if (!node) return -1;
+    }
+    return len ? ac->nodes[node].item : -1;
+}
+
+static int compare_abbr_match(const void *a, const void *b) {
+    const abbr_match *x = a;
+    const abbr_match *y = b;
+    if (x->start != y->start) return x->start < y->start ? -1 : 1;
+    return x->item - y->item;
+}
+
+/* Elements whose content is never rewritten */
+static const char *const abbr_skip_elements[] = { "code", "pre", "kbd", "samp", "script", "style", "abbr" };
+
+/**
+ * End of the markup starting at html[pos] that must be copied verbatim: a
+ * tag, comment, or character reference, or a whole code/pre/script/style/abbr
+ * element. Returns pos when html[pos] starts ordinary text.
+ */
+static size_t protected_span_end(const char *html, size_t len, size_t pos) {
+    if (html[pos] == '&') {
+        size_t p = pos + 1;
+        if (p < len && html[p] == '#') p++;
+        size_t name_start = p;
+        while (p < len && p - name_start < 32 && isalnum((unsigned char)html[p])) p++;
+        return (p > name_start && p < len && html[p] == ';') ? p + 1 : pos;
+    }
+
+    if (html[pos] != '<' || pos + 1 >= len) return pos;
+    char next = html[pos + 1];
+    if (next == '!' && strncmp(html + pos, "<!--", 4) == 0) {
+        const char *close = strstr(html + pos + 4, "-->");
+        return close ? (size_t)(close - html) + 3 : len;
+    }
+    if (!isalpha((unsigned char)next) && next != '/' && next != '!' && next != '?') return pos;
+
+    /* End of the tag, ignoring '>' inside quoted attribute values */
+    size_t p = pos + 1;
+    char quote = 0;
+    while (p < len && (quote || html[p] != '>')) {
+        if (quote) {
+            if (html[p] == quote) quote = 0;
+        } else if (html[p] == '"' || html[p] == '\'') {
+            quote = html[p];
+        }
+        p++;
+    }
+    if (p >= len) return pos;
+    size_t tag_end = p + 1;
+
+    if (!isalpha((unsigned char)next)) return tag_end;
+    size_t name_len = 0;
+    while (isalnum((unsigned char)html[pos + 1 + name_len])) name_len++;
+    for (size_t i = 0; i < sizeof(abbr_skip_elements) / sizeof(abbr_skip_elements[0]); i++) {
+        const char *name = abbr_skip_elements[i];
+        if (strlen(name) != name_len || strncasecmp(html + pos + 1, name, name_len) != 0) continue;
+
+        /* Skip through the matching close tag */
+        for (const char *lt = html + tag_end; (lt = memchr(lt, '<', len - (size_t)(lt - html))); lt++) {
+            if (lt[1] == '/' && strncasecmp(lt + 2, name, name_len) == 0 &&
+                !isalnum((unsigned char)lt[2 + name_len])) {
+                const char *gt = strchr(lt, '>');
+                return gt ? (size_t)(gt - html) + 1 : len;
+            }
+        }
+        break;
+    }
+    return tag_end;
+}
+
+/**
+ * Find every whole-word occurrence of an abbreviation outside protected
+ * markup in one pass, sorted by start and then list order.
+ */
+static abbr_match *find_abbreviation_matches(const abbr_automaton *ac, const char *html,
+                                             size_t html_len, size_t *count) {
+    abbr_match *matches = NULL;
+    size_t match_count = 0, match_cap = 0;
+    int state = 0;
+    size_t i = 0;
+
+    while (i < html_len) {
+        if (html[i] == '<' || html[i] == '&') {
+            size_t end = protected_span_end(html, html_len, i);
+            if (end > i) {
+                i = end;
+                state = 0;
+                continue;
+            }
+        }
+
+        state = ac_step(ac, state, (unsigned char)html[i]);
+        for (int node = state; node; node = ac->nodes[node].output) {
+            int item = ac->nodes[node].item;
+            if (item < 0) continue;
+            size_t len = ac->lengths[item];
+            size_t start = i + 1 - len;
+            /* Whole words only */
+            if (start > 0 && isalnum((unsigned char)html[start - 1])) continue;
+            if (isalnum((unsigned char)html[i + 1])) continue;
+
+            if (match_count == match_cap) {
+                size_t new_cap = match_cap ? match_cap * 2 : 64;
+                abbr_match *grown = realloc(matches, new_cap * sizeof(abbr_match));
+                if (!grown) {
+                    free(matches);
+                    return NULL;
+                }
+                matches = grown;
+                match_cap = new_cap;
+            }
+            matches[match_count].start = start;
+            matches[match_count].len = len;
+            matches[match_count].item = item;
+            match_count++;
+        }
+        i++;
+    }
+
+    /* Found in order of end position; the writer wants them by start */
+    if (match_count > 1) qsort(matches, match_count, sizeof(abbr_match), compare_abbr_match);
+    *count = match_count;
+    return matches;
+}
+
+/**
+ * Replace an MMD 6 inline abbreviation at html[pos]: [&gt;abbr] or
+ * [&gt;(abbr) expansion]. Returns the number of bytes consumed, 0 if there
+ * is none here, or (size_t)-1 if the output could not grow.
+ */
+static size_t replace_mmd6_abbreviation(const abbr_automaton *ac, const char *html, size_t pos,
+                                        char **out, size_t *len, size_t *cap) {
+    const char *start = html + pos + 5;
+    const char *end = start;
+    while (*end && *end != ']' && *end != '\n' && *end != '<') end++;
+    if (*end != ']') return 0;
+
+    if (*start == '(') {
+        /* Inline expansion: [&gt;(abbr) expansion] */
+        const char *abbr_end = memchr(start + 1, ')', (size_t)(end - (start + 1)));
+        if (!abbr_end) return 0;
+        const char *abbr = start + 1;
+        size_t abbr_len = (size_t)(abbr_end - abbr);
+        const char *exp = abbr_end + 1;
+        size_t exp_len = (size_t)(end - exp);
+        if (abbr_len == 0 || exp_len == 0) return 0;
+        trim_span(&abbr, &abbr_len);
+        trim_span(&exp, &exp_len);
+        if (!append_abbr_tag(out, len, cap, abbr, abbr_len, exp, exp_len)) return (size_t)-1;
+        return (size_t)(end + 1 - (html + pos));
+    }
+
+    /* Reference: [&gt;MMD] */
+    const char *ref = start;
+    size_t ref_len = (size_t)(end - start);
+    trim_span(&ref, &ref_len);
+    int item = ac_lookup(ac, ref, ref_len);
+    if (item < 0) return 0;
+    abbr_item *abbr = ac->items[item];
+    if (!append_abbr_tag(out, len, cap, abbr->abbr, ac->lengths[item],
+                         abbr->expansion, strlen(abbr->expansion))) {
+        return (size_t)-1;
+    }
+    return (size_t)(end + 1 - (html + pos));
+}
+
 /**
  * Replace abbreviations in HTML
+ *
+ * The abbreviations are compiled into one automaton, so the document is
+ * scanned once however many are defined. Tags, character references, and
+ * code, pre, script, style and existing abbr elements are copied unchanged.
  */
 char *apex_replace_abbreviations(const char *html, abbr_item *abbrs) {
     if (!html || !abbrs) {
@@ -225,148 +595,70 @@ char *apex_replace_abbreviations(const char *html, abbr_item *abbrs) {
     }
 
     size_t html_len = strlen(html);
-    /* Calculate max possible expansion:
-     * Each abbreviation could be replaced with <abbr title="expansion">abbr</abbr>
-     * Worst case: very long expansions. Use html_len * 5 to be safe. */
-    size_t capacity = html_len * 5;
-    char *output = malloc(capacity);
-    if (!output) return strdup(html);
-
-    const char *read = html;
-    char *write = output;
-    size_t remaining = capacity;
-
-    while (*read) {
-        bool replaced = false;
-
-        /* Check for MMD 6 inline abbreviation (HTML-escaped): [&gt;abbr] or [&gt;(abbr) expansion] */
-        if (strncmp(read, "[&gt;", 5) == 0) {
-            const char *start = read + 5;
-            const char *end = start;
-
-            /* Find closing ] */
-            while (*end && *end != ']' && *end != '\n' && *end != '<') end++;
-
-            if (*end == ']') {
-                /* Check for inline expansion: [&gt;(abbr) expansion] */
-                if (*start == '(') {
-                    const char *abbr_end = strchr(start + 1, ')');
-                    if (abbr_end && abbr_end < end) {
-                        /* Extract abbreviation and expansion */
-                        size_t abbr_len = (size_t)(abbr_end - (start + 1));
-                        size_t exp_len = (size_t)(end - (abbr_end + 1));
-
-                        if (abbr_len > 0 && exp_len > 0) {
-                            char abbr_text[256];
-                            char exp_text[1024];
-
-                            memcpy(abbr_text, start + 1, abbr_len);
-                            abbr_text[abbr_len] = '\0';
-
-                            memcpy(exp_text, abbr_end + 1, exp_len);
-                            exp_text[exp_len] = '\0';
-
-                            /* Trim whitespace */
-                            char *abbr_trimmed = trim(abbr_text);
-                            char *exp_trimmed = trim(exp_text);
-
-                            /* Generate abbr tag */
-                            char abbr_tag[2048];
-                            snprintf(abbr_tag, sizeof(abbr_tag),
-                                    "<abbr title=\"%s\">%s</abbr>",
-                                    exp_trimmed, abbr_trimmed);
-
-                            size_t tag_len = strlen(abbr_tag);
-                            if (tag_len < remaining) {
-                                memcpy(write, abbr_tag, tag_len);
-                                write += tag_len;
-                                remaining -= tag_len;
-                            }
-
-                            read = end + 1;
-                            replaced = true;
-                        }
-                    }
-                } else {
-                    /* Reference abbreviation: [&gt;MMD] */
-                    size_t ref_len = (size_t)(end - start);
-                    if (ref_len > 0 && ref_len < 256) {
-                        char ref[256];
-                        memcpy(ref, start, ref_len);
-                        ref[ref_len] = '\0';
-                        char *ref_trimmed = trim(ref);
-
-                        /* Look up in abbreviation list */
-                        for (abbr_item *item = abbrs; item; item = item->next) {
-                            if (strcmp(item->abbr, ref_trimmed) == 0) {
-                                /* Found match */
-                                char abbr_tag[2048];
-                                snprintf(abbr_tag, sizeof(abbr_tag),
-                                        "<abbr title=\"%s\">%s</abbr>",
-                                        item->expansion, item->abbr);
-
-                                size_t tag_len = strlen(abbr_tag);
-                                if (tag_len < remaining) {
-                                    memcpy(write, abbr_tag, tag_len);
-                                    write += tag_len;
-                                    remaining -= tag_len;
-                                }
-
-                                read = end + 1;
-                                replaced = true;
-                                break;
-                            }
-                        }
-                    }
-                }
+    abbr_automaton ac;
+    if (!ac_build(&ac, abbrs)) return strdup(html);
+
+    size_t match_count = 0;
+    abbr_match *matches = find_abbreviation_matches(&ac, html, html_len, &match_count);
+    if (!matches && match_count) {
+        ac_free(&ac);
+        return strdup(html);
+    }
 
-                if (replaced) continue;
+    size_t cap = html_len + html_len / 8 + 64;
+    size_t len = 0;
+    char *output = malloc(cap);
+    if (!output) goto fail;
+    output[0] = '\0';
+
+    size_t m = 0;
+    size_t i = 0;
+    while (i < html_len) {
+        if (html[i] == '[' && strncmp(html + i, "[&gt;", 5) == 0) {
+            size_t consumed = replace_mmd6_abbreviation(&ac, html, i, &output, &len, &cap);
+            if (consumed == (size_t)-1) goto fail;
+            if (consumed) {
+                i += consumed;
+                continue;
             }
         }
 
-        /* Try each abbreviation (automatic replacement) */
-        for (abbr_item *item = abbrs; item; item = item->next) {
-            size_t abbr_len = strlen(item->abbr);
-
-            /* Check if we have a match */
-            if (strncmp(read, item->abbr, abbr_len) == 0) {
-                /* Check it's a whole word (not part of larger word) */
-                bool word_boundary = true;
-                if (read > html && isalnum((unsigned char)*(read - 1))) word_boundary = false;
-                if (isalnum((unsigned char)read[abbr_len])) word_boundary = false;
-
-                if (word_boundary) {
-                    /* Replace with <abbr> tag */
-                    char abbr_tag[2048];
-                    snprintf(abbr_tag, sizeof(abbr_tag),
-                            "<abbr title=\"%s\">%s</abbr>",
-                            item->expansion, item->abbr);
-
-                    size_t tag_len = strlen(abbr_tag);
-                    if (tag_len < remaining) {
-                        memcpy(write, abbr_tag, tag_len);
-                        write += tag_len;
-                        remaining -= tag_len;
-                    }
-
-                    read += abbr_len;
-                    replaced = true;
-                    break;
-                }
+        if (html[i] == '<' || html[i] == '&') {
+            size_t end = protected_span_end(html, html_len, i);
+            if (end > i) {
+                if (!append_chunk(&output, &len, &cap, html + i, end - i)) goto fail;
+                i = end;
+                continue;
             }
         }
 
-        if (!replaced) {
-            if (remaining > 0) {
-                *write++ = *read++;
-                remaining--;
-            } else {
-                read++;
+        /* Matches that started inside something already written are dropped */
+        while (m < match_count && matches[m].start < i) m++;
+        if (m < match_count && matches[m].start == i) {
+            abbr_item *item = ac.items[matches[m].item];
+            if (!append_abbr_tag(&output, &len, &cap, item->abbr, matches[m].len,
+                                 item->expansion, strlen(item->expansion))) {
+                goto fail;
             }
+            i += matches[m].len;
+            continue;
         }
+
+        /* Copy plain text up to the next match or markup */
+        size_t next = m < match_count ? matches[m].start : html_len;
+        size_t run = i + 1;
+        while (run < next && html[run] != '<' && html[run] != '&' && html[run] != '[') run++;
+        if (!append_chunk(&output, &len, &cap, html + i, run - i)) goto fail;
+        i = run;
     }
 
-    *write = '\0';
+    free(matches);
+    ac_free(&ac);
     return output;
-}
 
+fail:
+    free(output);
+    free(matches);
+    ac_free(&ac);
+    return strdup(html);
+}
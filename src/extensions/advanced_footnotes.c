@@ -10,6 +10,7 @@
 #include "parser.h"
 #include "node.h"
 #include "inlines.h"
+#include "../parser_lock.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -106,7 +107,7 @@ static void reparse_footnote_blocks(cmark_node *footnote_def, cmark_parser *pars
 
     /* Parse the content */
     cmark_parser_feed(sub_parser, literal, strlen(literal));
-    cmark_node *parsed = cmark_parser_finish(sub_parser);
+    cmark_node *parsed = apex_parser_finish(sub_parser);
 
     if (parsed) {
         /* Remove old content */
@@ -159,6 +160,57 @@ cmark_node *apex_process_advanced_footnotes(cmark_node *root, cmark_parser *pars
     return root;
 }
 
+char **apex_footnote_reference_labels(cmark_node *root, size_t *count) {
+    *count = 0;
+    if (!root) return NULL;
+
+    cmark_iter *iter = cmark_iter_new(root);
+    if (!iter) return NULL;
+
+    char **labels = NULL;
+    size_t cap = 0;
+    int in_definition = 0;
+    bool ok = true;
+    cmark_event_type ev_type;
+
+    while (ok && (ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+        cmark_node *cur = cmark_iter_get_node(iter);
+        cmark_node_type type = cmark_node_get_type(cur);
+
+        if (type == CMARK_NODE_FOOTNOTE_DEFINITION) {
+            in_definition += (ev_type == CMARK_EVENT_ENTER) ? 1 : -1;
+            continue;
+        }
+        if (type != CMARK_NODE_FOOTNOTE_REFERENCE || in_definition) continue;
+
+        /* After finalizing, the reference's literal is its number; the
+         * label stays on the definition it resolved to */
+        const char *label = cur->parent_footnote_def
+                                ? cmark_node_get_literal(cur->parent_footnote_def) : NULL;
+        if (*count == cap) {
+            cap = cap ? cap * 2 : 8;
+            char **grown = realloc(labels, cap * sizeof(char *));
+            if (!grown) {
+                ok = false;
+                break;
+            }
+            labels = grown;
+        }
+        labels[*count] = strdup(label ? label : "");
+        if (!labels[*count]) ok = false;
+        else (*count)++;
+    }
+    cmark_iter_free(iter);
+
+    if (!ok) {
+        for (size_t i = 0; i < *count; i++) free(labels[i]);
+        free(labels);
+        *count = 0;
+        return NULL;
+    }
+    return labels;
+}
+
 /**
  * Postprocess function for the extension
  */
@@ -36,6 +36,13 @@ extern "C" {
  */
 cmark_node *apex_process_advanced_footnotes(cmark_node *root, cmark_parser *parser);
 
+/**
+ * Labels of the footnote references in a finished document, in document
+ * order (the order cmark numbers them in). References inside footnote
+ * definitions are left out. Returns NULL with *count 0 if there are none.
+ */
+char **apex_footnote_reference_labels(cmark_node *root, size_t *count);
+
 /**
  * Create advanced footnotes extension
  * This extends the base cmark-gfm footnote support
@@ -18,12 +18,10 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <ctype.h>
 #include <stdio.h>
 
-/* Global flag for per-cell alignment (set when extension is created) */
-static bool g_per_cell_alignment = false;
-
 /* Placeholder for escaped \<< (literal <<). Must match table.c. No underscore so inline parser doesn't treat as emphasis. */
 static const unsigned char ESCAPED_LTLT_PLACEHOLDER[] = "APEXLTLT";
 #define ESCAPED_LTLT_PLACEHOLDER_LEN 8
@@ -403,7 +401,7 @@ static bool is_caption_row(cmark_node *row) {
  * Add colspan/rowspan attributes to table cells
  * This modifies the AST by setting user_data with HTML attributes
  */
-static void process_table_spans(cmark_node *table) {
+static void process_table_spans(cmark_node *table, bool per_cell_alignment) {
     if (!table || cmark_node_get_type(table) != CMARK_NODE_TABLE) return;
 
     /* Walk through table rows - start from first TABLE_ROW node */
@@ -545,7 +543,7 @@ static void process_table_spans(cmark_node *table) {
 
                     /* Process per-cell alignment markers (:) BEFORE colspan/rowspan processing
                      * so that alignment is preserved when cells are merged. */
-                    if (g_per_cell_alignment) {
+                    if (per_cell_alignment) {
                         char *cell_attrs_check = (char *)cmark_node_get_user_data(cell);
                         if (!cell_attrs_check || !strstr(cell_attrs_check, "data-remove")) {
                             const char *align = process_cell_alignment(cell);
@@ -1538,7 +1536,7 @@ static void add_table_caption(cmark_node *table, const char *caption, const char
 /**
  * Process tables in document
  */
-cmark_node *apex_process_advanced_tables(cmark_node *root) {
+cmark_node *apex_process_advanced_tables(cmark_node *root, bool per_cell_alignment) {
     if (!root) return root;
 
     cmark_iter *iter = cmark_iter_new(root);
@@ -1751,7 +1749,7 @@ cmark_node *apex_process_advanced_tables(cmark_node *root) {
                 }
 
                 /* Process spans - this also detects tfoot rows */
-                process_table_spans(cur);
+                process_table_spans(cur, per_cell_alignment);
             }
         }
     }
@@ -1760,111 +1758,15 @@ cmark_node *apex_process_advanced_tables(cmark_node *root) {
     return root;
 }
 
-/**
- * Custom HTML renderer for tables with spans and captions
- */
-__attribute__((unused))
-static void html_render_table(cmark_syntax_extension *ext,
-                              struct cmark_html_renderer *renderer,
-                              cmark_node *node,
-                              cmark_event_type ev_type,
-                              int options) {
-    (void)ext;
-    (void)options;
-    cmark_strbuf *html = renderer->html;
-    cmark_node_type type = cmark_node_get_type(node);
-
-    if (ev_type == CMARK_EVENT_ENTER && type == CMARK_NODE_TABLE) {
-        /* Check for caption */
-        char *user_data = (char *)cmark_node_get_user_data(node);
-        if (user_data && strstr(user_data, "data-caption=")) {
-            char caption[512];
-            if (sscanf(user_data, " data-caption=\"%[^\"]\"", caption) == 1) {
-                cmark_strbuf_puts(html, "<figure class=\"table-figure\">\n");
-                cmark_strbuf_puts(html, "<figcaption>");
-                cmark_strbuf_puts(html, caption);
-                cmark_strbuf_puts(html, "</figcaption>\n");
-            }
-        }
-        /* Let default renderer handle the table tag */
-        return;
-    } else if (ev_type == CMARK_EVENT_EXIT && type == CMARK_NODE_TABLE) {
-        char *user_data = (char *)cmark_node_get_user_data(node);
-        if (user_data && strstr(user_data, "data-caption=")) {
-            cmark_strbuf_puts(html, "</figure>\n");
-        }
-        return;
-    }
-
-    /* Handle ALL table cells to properly handle removal and spans */
-    if (type == CMARK_NODE_TABLE_CELL) {
-        char *attrs = (char *)cmark_node_get_user_data(node);
-
-        /* Skip cells marked for removal entirely (don't render enter or exit) */
-        if (attrs && strstr(attrs, "data-remove")) {
-            return; /* Don't render this cell at all */
-        }
-
-        /* If this cell has rowspan/colspan, we need custom rendering */
-        if (ev_type == CMARK_EVENT_ENTER && attrs &&
-            (strstr(attrs, "colspan=") || strstr(attrs, "rowspan="))) {
-            /* Determine if header or data cell by checking parent row */
-            bool is_header = false;
-            cmark_node *row = cmark_node_parent(node);
-            if (row) {
-                cmark_node *parent = cmark_node_parent(row);
-                if (parent && cmark_node_get_type(parent) == CMARK_NODE_TABLE) {
-                    /* First row is header in cmark-gfm tables */
-                    cmark_node *first_row = cmark_node_first_child(parent);
-                    is_header = (first_row == row);
-                }
-            }
-
-            /* Output opening tag */
-            if (is_header) {
-                cmark_strbuf_puts(html, "<th");
-            } else {
-                cmark_strbuf_puts(html, "<td");
-            }
-
-            /* Add rowspan/colspan attributes */
-            cmark_strbuf_puts(html, attrs);
-
-            cmark_strbuf_putc(html, '>');
-            return; /* We've handled the opening tag */
-        } else if (ev_type == CMARK_EVENT_EXIT && attrs &&
-                   (strstr(attrs, "colspan=") || strstr(attrs, "rowspan="))) {
-            /* Closing tag */
-            bool is_header = false;
-            cmark_node *row = cmark_node_parent(node);
-            if (row) {
-                cmark_node *parent = cmark_node_parent(row);
-                if (parent && cmark_node_get_type(parent) == CMARK_NODE_TABLE) {
-                    cmark_node *first_row = cmark_node_first_child(parent);
-                    is_header = (first_row == row);
-                }
-            }
-
-            if (is_header) {
-                cmark_strbuf_puts(html, "</th>\n");
-            } else {
-                cmark_strbuf_puts(html, "</td>\n");
-            }
-            return; /* We've handled the closing tag */
-        }
-        /* For normal cells without spans, let default renderer handle them */
-    }
-}
-
 /**
  * Postprocess function
  */
 static cmark_node *postprocess(cmark_syntax_extension *ext,
                                cmark_parser *parser,
                                cmark_node *root) {
-    (void)ext;
     (void)parser;
-    return apex_process_advanced_tables(root);
+    bool per_cell_alignment = (uintptr_t)cmark_syntax_extension_get_private(ext) != 0;
+    return apex_process_advanced_tables(root, per_cell_alignment);
 }
 
 /**
@@ -1874,16 +1776,15 @@ cmark_syntax_extension *create_advanced_tables_extension(bool per_cell_alignment
     cmark_syntax_extension *ext = cmark_syntax_extension_new("advanced_tables");
     if (!ext) return NULL;
 
-    /* Store per_cell_alignment flag in static variable */
-    g_per_cell_alignment = per_cell_alignment;
+    /* Keep the flag on the extension so each parser sees its own setting */
+    cmark_syntax_extension_set_private(ext, (void *)(uintptr_t)per_cell_alignment, NULL);
 
     /* Set postprocess callback to add span/caption attributes to AST */
     cmark_syntax_extension_set_postprocess_func(ext, postprocess);
 
-    /* NOTE: We don't use html_render_func here because it conflicts with GFM table renderer.
-     * Instead, we do HTML postprocessing in apex.c after rendering.
-     * The post-processing should remove cells with data-remove and inject colspan/rowspan attributes. */
-    /* cmark_syntax_extension_set_html_render_func(ext, html_render_table); */
+    /* NOTE: No html_render_func: cmark only calls it for nodes this extension owns,
+     * and table nodes belong to the GFM table extension. html_renderer.c reads the
+     * user_data set here and emits spans, tfoot and captions itself. */
 
     /* Register to handle table and table cell rendering */
     cmark_syntax_extension_set_can_contain_func(ext, NULL);
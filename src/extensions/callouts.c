@@ -502,7 +502,8 @@ char *apex_preprocess_quarto_callouts(const char *text) {
 
                     char *attrs_work = strdup(attrs);
                     if (!attrs_work) goto fail;
-                    char *token = strtok(attrs_work, " \t");
+                    char *saveptr = NULL;
+                    char *token = strtok_r(attrs_work, " \t", &saveptr);
                     char type_buf[64] = {0};
                     char title_buf[256] = {0};
                     bool collapsible = false;
@@ -530,7 +531,7 @@ char *apex_preprocess_quarto_callouts(const char *text) {
                                 default_open = true;
                             }
                         }
-                        token = strtok(NULL, " \t");
+                        token = strtok_r(NULL, " \t", &saveptr);
                     }
                     free(attrs_work);
 
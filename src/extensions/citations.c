@@ -4,6 +4,7 @@
  */
 
 #include "citations.h"
+#include "../render_cache.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -11,6 +12,11 @@
 #include <stdbool.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* Citation placeholder prefix - we'll use a unique marker */
 #define CITATION_PLACEHOLDER_PREFIX "<!--CITE:"
@@ -1107,6 +1113,8 @@ void apex_free_citation_registry(apex_citation_registry *registry) {
 static char *read_bibliography_file(const char *filepath) {
     if (!filepath) return NULL;
 
+    apex_render_cache_note_file(filepath);
+
     FILE *fp = fopen(filepath, "r");
     if (!fp) return NULL;
 
@@ -1136,7 +1144,7 @@ static char *read_bibliography_file(const char *filepath) {
 /**
  * Resolve bibliography file path relative to base directory
  */
-static char *resolve_bibliography_path(const char *filepath, const char *base_directory) {
+char *apex_resolve_bibliography_path(const char *filepath, const char *base_directory) {
     if (!filepath) return NULL;
 
     /* If absolute path or starts with ./ or ../, use as-is */
@@ -1212,6 +1220,7 @@ static apex_bibliography_entry *bibliography_entry_new(const char *id) {
     entry->page = NULL;
     entry->raw_data = NULL;
     entry->next = NULL;
+    entry->cached = false;
 
     return entry;
 }
@@ -1220,7 +1229,8 @@ static apex_bibliography_entry *bibliography_entry_new(const char *id) {
  * Free bibliography entry
  */
 void apex_bibliography_entry_free(apex_bibliography_entry *entry) {
-    if (!entry) return;
+    /* Cached entries are freed with the registry's blocks */
+    if (!entry || entry->cached) return;
 
     free(entry->id);
     free(entry->type);
@@ -1235,6 +1245,14 @@ void apex_bibliography_entry_free(apex_bibliography_entry *entry) {
     free(entry);
 }
 
+/* A bibliography cache file mapped into memory, and the entries pointing into it */
+struct apex_bibliography_block {
+    void *map;
+    size_t map_len;
+    apex_bibliography_entry *entries;
+    struct apex_bibliography_block *next;
+};
+
 /**
  * Free bibliography registry
  */
@@ -1248,8 +1266,85 @@ void apex_free_bibliography_registry(apex_bibliography_registry *registry) {
         entry = next;
     }
 
+    apex_bibliography_block *block = registry->blocks;
+    while (block) {
+        apex_bibliography_block *next = block->next;
+        free(block->entries);
+        munmap(block->map, block->map_len);
+        free(block);
+        block = next;
+    }
+
+    free(registry->index);
     registry->entries = NULL;
     registry->count = 0;
+    registry->index = NULL;
+    registry->index_size = 0;
+    registry->index_count = 0;
+    registry->blocks = NULL;
+}
+
+static apex_bibliography_registry *bibliography_registry_new(void) {
+    return calloc(1, sizeof(apex_bibliography_registry));
+}
+
+/* FNV-1a over an entry ID */
+static uint64_t bibliography_hash(const char *id) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)id; *p; p++) {
+        h = (h ^ *p) * 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * Slot holding id in a table of size slots (a power of two), or the empty
+ * slot where it would go
+ */
+static size_t bibliography_index_slot(apex_bibliography_entry *const *index, size_t size, const char *id) {
+    size_t mask = size - 1;
+    size_t slot = (size_t)bibliography_hash(id) & mask;
+    while (index[slot] && strcmp(index[slot]->id, id) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/* Keep the table at most half full */
+static bool bibliography_index_reserve(apex_bibliography_registry *registry, size_t entries) {
+    if (registry->index && entries * 2 <= registry->index_size) return true;
+
+    size_t size = 64;
+    while (size < entries * 2) size *= 2;
+    apex_bibliography_entry **index = calloc(size, sizeof(apex_bibliography_entry *));
+    if (!index) return false;
+    for (size_t i = 0; i < registry->index_size; i++) {
+        apex_bibliography_entry *entry = registry->index[i];
+        if (entry) index[bibliography_index_slot(index, size, entry->id)] = entry;
+    }
+    free(registry->index);
+    registry->index = index;
+    registry->index_size = size;
+    return true;
+}
+
+/**
+ * Index every entry by ID. Where IDs repeat, the first one in the list is
+ * indexed, which is the one a linear search would find.
+ */
+static void bibliography_index_build(apex_bibliography_registry *registry) {
+    free(registry->index);
+    registry->index = NULL;
+    registry->index_size = 0;
+    registry->index_count = 0;
+    if (!bibliography_index_reserve(registry, registry->count)) return;
+
+    for (apex_bibliography_entry *entry = registry->entries; entry; entry = entry->next) {
+        if (!entry->id) continue;
+        size_t slot = bibliography_index_slot(registry->index, registry->index_size, entry->id);
+        if (!registry->index[slot]) registry->index[slot] = entry;
+    }
+    registry->index_count = registry->count;
 }
 
 /**
@@ -1258,6 +1353,11 @@ void apex_free_bibliography_registry(apex_bibliography_registry *registry) {
 apex_bibliography_entry *apex_find_bibliography_entry(apex_bibliography_registry *registry, const char *id) {
     if (!registry || !id) return NULL;
 
+    if (registry->index && registry->index_count == registry->count) {
+        return registry->index[bibliography_index_slot(registry->index, registry->index_size, id)];
+    }
+
+    /* The list was changed behind the index's back */
     apex_bibliography_entry *entry = registry->entries;
     while (entry) {
         if (entry->id && strcmp(entry->id, id) == 0) {
@@ -1269,6 +1369,59 @@ apex_bibliography_entry *apex_find_bibliography_entry(apex_bibliography_registry
     return NULL;
 }
 
+/**
+ * Add an entry unless its ID is already present
+ */
+bool apex_bibliography_add_entry(apex_bibliography_registry *registry, apex_bibliography_entry *entry) {
+    if (!registry || !entry || !entry->id) return false;
+    if (apex_find_bibliography_entry(registry, entry->id)) return false;
+
+    entry->next = registry->entries;
+    registry->entries = entry;
+    registry->count++;
+
+    if (registry->index && registry->index_count == registry->count - 1 &&
+        bibliography_index_reserve(registry, registry->count)) {
+        registry->index[bibliography_index_slot(registry->index, registry->index_size, entry->id)] = entry;
+        registry->index_count = registry->count;
+    } else {
+        bibliography_index_build(registry);
+    }
+    return true;
+}
+
+/**
+ * Merge one registry into another
+ */
+void apex_bibliography_merge(apex_bibliography_registry *registry, apex_bibliography_registry *from) {
+    if (!registry || !from) return;
+
+    /* Into an empty registry, take over the list and index as they are */
+    if (!registry->entries && !registry->blocks) {
+        free(registry->index);
+        *registry = *from;
+        free(from);
+        return;
+    }
+
+    apex_bibliography_entry *entry = from->entries;
+    while (entry) {
+        apex_bibliography_entry *next = entry->next;
+        if (!apex_bibliography_add_entry(registry, entry)) {
+            apex_bibliography_entry_free(entry);
+        }
+        entry = next;
+    }
+
+    /* Cached entries still point into from's blocks */
+    apex_bibliography_block **tail = &registry->blocks;
+    while (*tail) tail = &(*tail)->next;
+    *tail = from->blocks;
+
+    free(from->index);
+    free(from);
+}
+
 /**
  * Trim whitespace from string (in-place)
  */
@@ -1469,10 +1622,8 @@ static const char *bibtex_to_csl_type(const char *bibtex_type) {
 apex_bibliography_registry *apex_parse_bibtex(const char *content) {
     if (!content) return NULL;
 
-    apex_bibliography_registry *registry = malloc(sizeof(apex_bibliography_registry));
+    apex_bibliography_registry *registry = bibliography_registry_new();
     if (!registry) return NULL;
-    registry->entries = NULL;
-    registry->count = 0;
 
     const char *p = content;
 
@@ -1609,10 +1760,8 @@ apex_bibliography_registry *apex_parse_csl_json(const char *content) {
     /* For a full implementation, we'd use a JSON library like cJSON */
     /* This is a minimal implementation for MVP */
 
-    apex_bibliography_registry *registry = malloc(sizeof(apex_bibliography_registry));
+    apex_bibliography_registry *registry = bibliography_registry_new();
     if (!registry) return NULL;
-    registry->entries = NULL;
-    registry->count = 0;
 
     /* TODO: Implement proper JSON parsing */
     /* For now, return empty registry - will be enhanced later */
@@ -1851,10 +2000,8 @@ static char *parse_yaml_date(const char *content, int base_indent) {
 apex_bibliography_registry *apex_parse_csl_yaml(const char *content) {
     if (!content) return NULL;
 
-    apex_bibliography_registry *registry = malloc(sizeof(apex_bibliography_registry));
+    apex_bibliography_registry *registry = bibliography_registry_new();
     if (!registry) return NULL;
-    registry->entries = NULL;
-    registry->count = 0;
 
     const char *p = content;
     apex_bibliography_entry *current_entry = NULL;
@@ -2023,51 +2170,351 @@ apex_bibliography_registry *apex_load_bibliography_file(const char *filepath) {
     }
 
     free(content);
+    if (registry) bibliography_index_build(registry);
+    return registry;
+}
+
+/**
+ * Parsed-bibliography cache
+ *
+ * A cache file holds one parsed bibliography file, so a large .bib is
+ * parsed once instead of on every run. It is named after a hash of the
+ * file's absolute path and records that path, the file's size and
+ * modification time and the Apex version; when any of them differ the file
+ * is parsed again and the cache rewritten. The layout is used in place
+ * after mmap():
+ *
+ *     header     bib_cache_header
+ *     entries    entry_count x BIB_CACHE_FIELDS string offsets
+ *     index      index_size entry numbers, BIB_CACHE_NONE for empty slots
+ *     strings    NUL-terminated strings
+ *
+ * String offsets are into the strings area (BIB_CACHE_NONE for a NULL
+ * field). The index is the registry's hash table, by entry number. Integers
+ * are in host byte order, which byte_order checks.
+ */
+#define BIB_CACHE_MAGIC "apexbib1"
+#define BIB_CACHE_BYTE_ORDER 0x01020304u
+#define BIB_CACHE_FIELDS 10
+#define BIB_CACHE_NONE UINT32_MAX
+
+#ifdef __APPLE__
+#define BIB_CACHE_MTIME_NSEC(st) ((int64_t)(st).st_mtimespec.tv_nsec)
+#else
+#define BIB_CACHE_MTIME_NSEC(st) ((int64_t)(st).st_mtim.tv_nsec)
+#endif
+
+typedef struct {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t entry_count;
+    uint32_t index_size;
+    uint32_t path_offset;
+    uint32_t version_offset;
+    uint32_t reserved;
+    uint64_t source_size;
+    int64_t source_mtime_sec;
+    int64_t source_mtime_nsec;
+    uint64_t strings_size;
+} bib_cache_header;
+
+/* Entry fields in the order they are stored */
+static const size_t bib_cache_fields[BIB_CACHE_FIELDS] = {
+    offsetof(apex_bibliography_entry, id),
+    offsetof(apex_bibliography_entry, type),
+    offsetof(apex_bibliography_entry, title),
+    offsetof(apex_bibliography_entry, author),
+    offsetof(apex_bibliography_entry, year),
+    offsetof(apex_bibliography_entry, container_title),
+    offsetof(apex_bibliography_entry, publisher),
+    offsetof(apex_bibliography_entry, volume),
+    offsetof(apex_bibliography_entry, page),
+    offsetof(apex_bibliography_entry, raw_data),
+};
+
+#define BIB_CACHE_FIELD(entry, i) (*(char **)((char *)(entry) + bib_cache_fields[i]))
+
+static char *bib_cache_path(const char *cache_dir, const char *source) {
+    size_t len = strlen(cache_dir) + 32;
+    char *path = malloc(len);
+    if (path) {
+        snprintf(path, len, "%s/%016llx.bibcache", cache_dir,
+                 (unsigned long long)bibliography_hash(source));
+    }
+    return path;
+}
+
+/**
+ * Check a mapped cache file against the source and build a registry whose
+ * entries point into it. Returns NULL if the file is stale or malformed.
+ */
+static apex_bibliography_registry *bib_cache_read(void *map, size_t map_len, const char *source,
+                                                  const struct stat *st) {
+    const bib_cache_header *header = map;
+    if (memcmp(header->magic, BIB_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->byte_order != BIB_CACHE_BYTE_ORDER ||
+        header->source_size != (uint64_t)st->st_size ||
+        header->source_mtime_sec != (int64_t)st->st_mtime ||
+        header->source_mtime_nsec != BIB_CACHE_MTIME_NSEC(*st)) {
+        return NULL;
+    }
+
+    size_t count = header->entry_count;
+    size_t index_size = header->index_size;
+    uint64_t tables = ((uint64_t)count * BIB_CACHE_FIELDS + index_size) * sizeof(uint32_t);
+    if (header->strings_size == 0 || sizeof(*header) + tables + header->strings_size != map_len ||
+        (index_size & (index_size - 1)) != 0 || index_size < count * 2) {
+        return NULL;
+    }
+
+    const uint32_t *fields = (const uint32_t *)(header + 1);
+    const uint32_t *slots = fields + count * BIB_CACHE_FIELDS;
+    const char *strings = (const char *)(slots + index_size);
+    size_t strings_size = (size_t)header->strings_size;
+    if (strings[strings_size - 1] != '\0' ||
+        header->path_offset >= strings_size || strcmp(strings + header->path_offset, source) != 0 ||
+        header->version_offset >= strings_size ||
+        strcmp(strings + header->version_offset, apex_version_string()) != 0) {
+        return NULL;
+    }
+
+    apex_bibliography_registry *registry = bibliography_registry_new();
+    apex_bibliography_block *block = calloc(1, sizeof(apex_bibliography_block));
+    apex_bibliography_entry *entries = calloc(count ? count : 1, sizeof(apex_bibliography_entry));
+    apex_bibliography_entry **index = calloc(index_size ? index_size : 1, sizeof(apex_bibliography_entry *));
+    if (!registry || !block || !entries || !index) goto fail;
+
+    for (size_t i = 0; i < count; i++) {
+        for (size_t f = 0; f < BIB_CACHE_FIELDS; f++) {
+            uint32_t offset = fields[i * BIB_CACHE_FIELDS + f];
+            if (offset == BIB_CACHE_NONE) continue;
+            if (offset >= strings_size) goto fail;
+            BIB_CACHE_FIELD(&entries[i], f) = (char *)(strings + offset);
+        }
+        if (!entries[i].id) goto fail;
+        entries[i].cached = true;
+        entries[i].next = i + 1 < count ? &entries[i + 1] : NULL;
+    }
+    for (size_t slot = 0; slot < index_size; slot++) {
+        if (slots[slot] == BIB_CACHE_NONE) continue;
+        if (slots[slot] >= count) goto fail;
+        index[slot] = &entries[slots[slot]];
+    }
+
+    block->map = map;
+    block->map_len = map_len;
+    block->entries = entries;
+    registry->entries = count ? entries : NULL;
+    registry->count = count;
+    if (index_size) {
+        registry->index = index;
+        registry->index_size = index_size;
+        registry->index_count = count;
+    } else {
+        free(index);
+    }
+    registry->blocks = block;
+    return registry;
+
+fail:
+    free(registry);
+    free(block);
+    free(entries);
+    free(index);
+    return NULL;
+}
+
+static apex_bibliography_registry *bib_cache_load(const char *cache_path, const char *source,
+                                                  const struct stat *st) {
+    int fd = open(cache_path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat cache_st;
+    if (fstat(fd, &cache_st) != 0 || (size_t)cache_st.st_size < sizeof(bib_cache_header)) {
+        close(fd);
+        return NULL;
+    }
+    size_t map_len = (size_t)cache_st.st_size;
+    void *map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    apex_bibliography_registry *registry = bib_cache_read(map, map_len, source, st);
+    if (!registry) munmap(map, map_len);
+    return registry;
+}
+
+/* Append a NUL-terminated string to the strings area; NULL is stored as BIB_CACHE_NONE */
+static bool bib_cache_add_string(char **strings, size_t *len, size_t *cap, const char *str, uint32_t *offset) {
+    if (!str) {
+        *offset = BIB_CACHE_NONE;
+        return true;
+    }
+    size_t str_len = strlen(str) + 1;
+    if (*len + str_len >= BIB_CACHE_NONE) return false;
+    if (*len + str_len > *cap) {
+        size_t new_cap = *cap ? *cap : 4096;
+        while (*len + str_len > new_cap) new_cap *= 2;
+        char *grown = realloc(*strings, new_cap);
+        if (!grown) return false;
+        *strings = grown;
+        *cap = new_cap;
+    }
+    memcpy(*strings + *len, str, str_len);
+    *offset = (uint32_t)*len;
+    *len += str_len;
+    return true;
+}
+
+static bool bib_cache_write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/**
+ * Write a registry parsed from source to cache_path. The file is written
+ * under a temporary name and renamed into place, so concurrent readers see
+ * either the old file or the complete new one.
+ */
+static void bib_cache_store(const char *cache_dir, const char *cache_path, const char *source,
+                            const struct stat *st, const apex_bibliography_registry *registry) {
+    size_t count = 0;
+    for (apex_bibliography_entry *entry = registry->entries; entry; entry = entry->next) count++;
+    if (count >= BIB_CACHE_NONE / (2 * BIB_CACHE_FIELDS)) return;
+
+    size_t index_size = count ? 64 : 0;
+    while (index_size < count * 2) index_size *= 2;
+
+    bib_cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BIB_CACHE_MAGIC, sizeof(header.magic));
+    header.byte_order = BIB_CACHE_BYTE_ORDER;
+    header.entry_count = (uint32_t)count;
+    header.index_size = (uint32_t)index_size;
+    header.source_size = (uint64_t)st->st_size;
+    header.source_mtime_sec = (int64_t)st->st_mtime;
+    header.source_mtime_nsec = BIB_CACHE_MTIME_NSEC(*st);
+
+    apex_bibliography_entry **list = malloc((count ? count : 1) * sizeof(apex_bibliography_entry *));
+    uint32_t *fields = malloc((count ? count : 1) * BIB_CACHE_FIELDS * sizeof(uint32_t));
+    uint32_t *slots = malloc((index_size ? index_size : 1) * sizeof(uint32_t));
+    char *strings = NULL;
+    size_t strings_len = 0, strings_cap = 0;
+    char *tmp = NULL;
+    bool ok = list && fields && slots;
+
+    if (ok) {
+        ok = bib_cache_add_string(&strings, &strings_len, &strings_cap, source, &header.path_offset) &&
+             bib_cache_add_string(&strings, &strings_len, &strings_cap, apex_version_string(),
+                                  &header.version_offset);
+
+        size_t i = 0;
+        for (apex_bibliography_entry *entry = registry->entries; ok && entry; entry = entry->next, i++) {
+            list[i] = entry;
+            for (size_t f = 0; ok && f < BIB_CACHE_FIELDS; f++) {
+                ok = bib_cache_add_string(&strings, &strings_len, &strings_cap, BIB_CACHE_FIELD(entry, f),
+                                          &fields[i * BIB_CACHE_FIELDS + f]);
+            }
+            if (!entry->id) ok = false;
+        }
+    }
+
+    if (ok) {
+        /* Same table as bibliography_index_build(): the first of repeated IDs wins */
+        memset(slots, 0xff, index_size * sizeof(uint32_t));
+        for (size_t i = 0; i < count; i++) {
+            size_t mask = index_size - 1;
+            size_t slot = (size_t)bibliography_hash(list[i]->id) & mask;
+            while (slots[slot] != BIB_CACHE_NONE && strcmp(list[slots[slot]]->id, list[i]->id) != 0) {
+                slot = (slot + 1) & mask;
+            }
+            if (slots[slot] == BIB_CACHE_NONE) slots[slot] = (uint32_t)i;
+        }
+        header.strings_size = strings_len;
+
+        size_t tmp_len = strlen(cache_dir) + 32;
+        tmp = malloc(tmp_len);
+        ok = tmp != NULL;
+        if (ok) snprintf(tmp, tmp_len, "%s/.bibcache-XXXXXX", cache_dir);
+    }
+
+    int fd = ok ? mkstemp(tmp) : -1;
+    if (fd >= 0) {
+        ok = bib_cache_write_all(fd, &header, sizeof(header)) &&
+             bib_cache_write_all(fd, fields, count * BIB_CACHE_FIELDS * sizeof(uint32_t)) &&
+             bib_cache_write_all(fd, slots, index_size * sizeof(uint32_t)) &&
+             bib_cache_write_all(fd, strings, strings_len);
+        ok = close(fd) == 0 && ok;
+        if (!ok || rename(tmp, cache_path) != 0) unlink(tmp);
+    }
+
+    free(tmp);
+    free(strings);
+    free(slots);
+    free(fields);
+    free(list);
+}
+
+/**
+ * Load bibliography from a single file through the parsed-bibliography cache
+ */
+apex_bibliography_registry *apex_load_bibliography_file_cached(const char *filepath, const char *cache_dir) {
+    if (!filepath) return NULL;
+    if (!cache_dir || !*cache_dir) return apex_load_bibliography_file(filepath);
+
+    struct stat st;
+    if (stat(filepath, &st) != 0 || !S_ISREG(st.st_mode)) return apex_load_bibliography_file(filepath);
+
+    char *source = realpath(filepath, NULL);
+    const char *key = source ? source : filepath;
+    char *cache_path = bib_cache_path(cache_dir, key);
+    apex_bibliography_registry *registry = cache_path ? bib_cache_load(cache_path, key, &st) : NULL;
+
+    if (registry) {
+        apex_render_cache_note_file(filepath);
+    } else {
+        registry = apex_load_bibliography_file(filepath);
+        if (registry && cache_path) {
+            mkdir(cache_dir, 0755);
+            bib_cache_store(cache_dir, cache_path, key, &st, registry);
+        }
+    }
+
+    free(cache_path);
+    free(source);
     return registry;
 }
 
 /**
  * Load bibliography from multiple files
  */
-apex_bibliography_registry *apex_load_bibliography(const char **files, const char *base_directory) {
+apex_bibliography_registry *apex_load_bibliography(const char **files, const char *base_directory,
+                                                   const char *cache_dir) {
     if (!files) return NULL;
 
-    apex_bibliography_registry *merged_registry = malloc(sizeof(apex_bibliography_registry));
+    apex_bibliography_registry *merged_registry = bibliography_registry_new();
     if (!merged_registry) return NULL;
-    merged_registry->entries = NULL;
-    merged_registry->count = 0;
 
     /* Load each file and merge entries */
     for (int i = 0; files[i] != NULL; i++) {
-        char *resolved_path = resolve_bibliography_path(files[i], base_directory);
+        char *resolved_path = apex_resolve_bibliography_path(files[i], base_directory);
         if (!resolved_path) continue;
 
-        apex_bibliography_registry *file_registry = apex_load_bibliography_file(resolved_path);
+        apex_bibliography_registry *file_registry = apex_load_bibliography_file_cached(resolved_path, cache_dir);
         free(resolved_path);
 
         if (file_registry) {
-            /* Merge entries into merged_registry */
-            apex_bibliography_entry *entry = file_registry->entries;
-            while (entry) {
-                apex_bibliography_entry *next = entry->next;
-
-                /* Check if entry with same ID already exists */
-                apex_bibliography_entry *existing = apex_find_bibliography_entry(merged_registry, entry->id);
-                if (!existing) {
-                    /* Add to merged registry */
-                    entry->next = merged_registry->entries;
-                    merged_registry->entries = entry;
-                    merged_registry->count++;
-                } else {
-                    /* Entry already exists, skip (or could update) */
-                    apex_bibliography_entry_free(entry);
-                }
-
-                entry = next;
-            }
-
-            /* Free the file registry structure (entries were moved) */
-            free(file_registry);
+            /* Earlier files win for repeated IDs */
+            apex_bibliography_merge(merged_registry, file_registry);
         }
     }
 
@@ -53,12 +53,20 @@ typedef struct apex_bibliography_entry {
     char *page;                  /* Pages */
     char *raw_data;              /* Raw JSON/BibTeX data for future use */
     struct apex_bibliography_entry *next;  /* Linked list */
+    bool cached;                 /* Loaded from a bibliography cache file; owned by the registry */
 } apex_bibliography_entry;
 
+/* Mapped bibliography cache file that cached entries point into */
+typedef struct apex_bibliography_block apex_bibliography_block;
+
 /* Bibliography registry */
 typedef struct {
     apex_bibliography_entry *entries;  /* Linked list of bibliography entries */
     size_t count;                      /* Number of entries */
+    apex_bibliography_entry **index;   /* Open-addressing table on id, or NULL */
+    size_t index_size;                 /* Slots in index (a power of two) */
+    size_t index_count;                /* count when index was last updated; a stale index isn't used */
+    apex_bibliography_block *blocks;   /* Cache files backing cached entries */
 } apex_bibliography_registry;
 
 /* Citation registry */
@@ -116,9 +124,17 @@ void apex_citation_free(apex_citation *citation);
 /**
  * Load bibliography from file(s)
  * Auto-detects format from extension (.bib, .json, .yaml, .yml)
+ * With a cache_dir, each file goes through apex_load_bibliography_file_cached()
  * Returns bibliography registry, or NULL on error
  */
-apex_bibliography_registry *apex_load_bibliography(const char **files, const char *base_directory);
+apex_bibliography_registry *apex_load_bibliography(const char **files, const char *base_directory,
+                                                   const char *cache_dir);
+
+/**
+ * Resolve a bibliography path the way apex_load_bibliography() does:
+ * relative paths (other than ./ and ../) are taken from base_directory
+ */
+char *apex_resolve_bibliography_path(const char *filepath, const char *base_directory);
 
 /**
  * Load bibliography from a single file
@@ -126,6 +142,15 @@ apex_bibliography_registry *apex_load_bibliography(const char **files, const cha
  */
 apex_bibliography_registry *apex_load_bibliography_file(const char *filepath);
 
+/**
+ * Load bibliography from a single file through a parsed-bibliography cache
+ * Reuses the cache file in cache_dir when it was written for this path and
+ * the file's size and modification time still match; otherwise parses the
+ * file and writes a new cache file. Without a cache_dir this is
+ * apex_load_bibliography_file().
+ */
+apex_bibliography_registry *apex_load_bibliography_file_cached(const char *filepath, const char *cache_dir);
+
 /**
  * Parse BibTeX file
  */
@@ -146,6 +171,18 @@ apex_bibliography_registry *apex_parse_csl_yaml(const char *content);
  */
 apex_bibliography_entry *apex_find_bibliography_entry(apex_bibliography_registry *registry, const char *id);
 
+/**
+ * Add an entry unless one with the same ID is already there
+ * Returns false (leaving the entry to the caller) for a duplicate
+ */
+bool apex_bibliography_add_entry(apex_bibliography_registry *registry, apex_bibliography_entry *entry);
+
+/**
+ * Move the entries of from into registry, skipping IDs it already has,
+ * and free from
+ */
+void apex_bibliography_merge(apex_bibliography_registry *registry, apex_bibliography_registry *from);
+
 /**
  * Free bibliography registry
  */
@@ -27,7 +27,9 @@
 #include "node.h"
 #include "html.h"
 #include "render.h"
+#include "../parser_lock.h"
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <stdbool.h>
 
@@ -196,30 +198,430 @@ static bool is_code_fence_line(const char *line, size_t len) {
     return false;
 }
 
+/** True if p..end is a thematic break: three or more "*", "-" or "_" and spaces. */
+static bool is_thematic_break(const char *p, const char *end) {
+    if (p >= end || (*p != '*' && *p != '-' && *p != '_')) return false;
+    char c = *p;
+    int count = 0;
+    for (; p < end; p++) {
+        if (*p == c) count++;
+        else if (*p != ' ' && *p != '\t' && *p != '\r') return false;
+    }
+    return count >= 3;
+}
+
+/** True if p..end is a setext heading underline ("===" or "---"). */
+static bool is_setext_underline(const char *p, const char *end) {
+    if (p >= end || (*p != '=' && *p != '-')) return false;
+    char c = *p;
+    while (p < end && *p == c) p++;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p == end;
+}
+
+/* HTML blocks that end on a line of their own (CommonMark types 1-5),
+ * rather than at a blank line */
+static const struct {
+    const char *open;
+    const char *close;
+} html_block_kinds[] = {
+    { "<script", "</script>" },
+    { "<pre", "</pre>" },
+    { "<style", "</style>" },
+    { "<textarea", "</textarea>" },
+    { "<!--", "-->" },
+    { "<?", "?>" },
+    { "<![CDATA[", "]]>" },
+    { "<!", ">" },
+};
+
+/** Close marker of the HTML block p..end starts, or NULL */
+static const char *html_block_close(const char *p, const char *end) {
+    for (size_t i = 0; i < sizeof(html_block_kinds) / sizeof(html_block_kinds[0]); i++) {
+        size_t n = strlen(html_block_kinds[i].open);
+        if ((size_t)(end - p) < n || strncasecmp(p, html_block_kinds[i].open, n) != 0) continue;
+        if (i < 4) {
+            /* Tag names end at whitespace, ">" or the end of the line */
+            if ((size_t)(end - p) > n && p[n] != ' ' && p[n] != '\t' && p[n] != '>' && p[n] != '\r') continue;
+        } else if (i == 7 && ((size_t)(end - p) <= n || !isalpha((unsigned char)p[n]))) {
+            continue;
+        }
+        return html_block_kinds[i].close;
+    }
+    return NULL;
+}
+
+/** True if p..end contains close (ASCII case-insensitive) */
+static bool line_has_close(const char *p, const char *end, const char *close) {
+    size_t n = strlen(close);
+    for (; (size_t)(end - p) >= n; p++) {
+        if (strncasecmp(p, close, n) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * If line (after indentation and blockquote markers) starts a link reference
+ * definition "[label]:", return where the "[" is, else NULL.
+ */
+static const char *reference_def_start(const char *line, size_t len) {
+    const char *p = line;
+    const char *end = line + len;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '>')) p++;
+    if (p >= end || *p != '[') return NULL;
+    const char *q = p + 1;
+    while (q < end && *q != ']') {
+        if (*q == '\\' && q + 1 < end) q++;
+        else if (*q == '[') return NULL;
+        q++;
+    }
+    if (q >= end || q == p + 1 || q + 1 >= end || q[1] != ':') return NULL;
+    return p;
+}
+
 /**
- * Render inline content (term or definition) with full document context so cmark
- * can resolve reference links. Parses full_doc + "\n\n" + content so ref defs are
- * available. Returns HTML of the last block (our content), stripping <p></p>.
- * Caller must free the returned string.
+ * If p starts a list item marker ("-", "*", "+", "1." or "1)" followed by
+ * whitespace or the end of the line), return where the item's content
+ * starts, else NULL.
  */
-static char *render_inline_with_doc(const char *content, size_t content_len,
-                                    const char *full_doc, size_t full_doc_len, bool unsafe) {
-    size_t buf_len = full_doc_len + 2 + content_len + 1;
-    char *buf = malloc(buf_len);
+static const char *list_item_content(const char *p, const char *end) {
+    const char *m = p;
+    if (m < end && (*m == '-' || *m == '*' || *m == '+')) {
+        m++;
+    } else {
+        while (m < end && m - p < 9 && isdigit((unsigned char)*m)) m++;
+        if (m == p || m >= end || (*m != '.' && *m != ')')) return NULL;
+        m++;
+    }
+    if (m < end && *m != ' ' && *m != '\t' && *m != '\r') return NULL;
+    /* One to four spaces belong to the marker; more start indented code */
+    const char *c = m;
+    while (c < end && c - m < 5 && (*c == ' ' || *c == '\t')) c++;
+    return c - m == 5 ? m + 1 : c;
+}
+
+/**
+ * Collect the link reference definitions of a document, one per paragraph,
+ * so terms and definitions can be rendered against them without re-parsing
+ * the whole document each time. A definition only counts where cmark would
+ * see one: at the start of a paragraph (or after another definition),
+ * including the first line of a list item, and outside fenced or indented
+ * code. Title or URL lines that continue a definition are kept with it.
+ * Returns NULL if there are none; caller frees.
+ */
+static char *collect_reference_defs(const char *text, size_t text_len, size_t *out_len) {
+    char *refs = NULL;
+    size_t len = 0, cap = 0;
+    bool in_fence = false;
+    const char *html_close = NULL; /* End marker of the open HTML block */
+    bool can_start = true;  /* Previous line ended a block or was a definition */
+    bool in_def = false;    /* Previous line belongs to a definition */
+    size_t list_indent = 0; /* Content column of the open list item, or 0 */
+    const char *read = text;
+    const char *text_end = text + text_len;
+
+    while (read < text_end) {
+        const char *line_end = memchr(read, '\n', (size_t)(text_end - read));
+        if (!line_end) line_end = text_end;
+        size_t line_len = (size_t)(line_end - read);
+        const char *next = line_end < text_end ? line_end + 1 : text_end;
+
+        /* Indentation of the content after any blockquote markers */
+        const char *p = read;
+        size_t indent = 0;
+        for (;;) {
+            indent = 0;
+            while (p < line_end && (*p == ' ' || *p == '\t')) {
+                indent += *p == '\t' ? 4 - indent % 4 : 1;
+                p++;
+            }
+            if (p >= line_end || *p != '>' || indent >= 4) break;
+            p++;
+            if (p < line_end && *p == ' ') p++;
+        }
+        bool blank = p >= line_end || *p == '\r';
+
+        /* Raw HTML up to the block's end marker; the line after it can
+         * start a definition */
+        if (html_close) {
+            bool closed = line_has_close(p, line_end, html_close);
+            if (closed) html_close = NULL;
+            in_def = false;
+            can_start = closed;
+            read = next;
+            continue;
+        }
+
+        /* Indentation relative to the list item the line continues */
+        if (!blank && indent < list_indent && can_start && !in_def) list_indent = 0;
+        size_t rel = indent >= list_indent ? indent - list_indent : indent;
+        bool rule = !blank && rel < 4 && !in_fence && is_thematic_break(p, line_end);
+        const char *item = !blank && rel < 4 && !rule ? list_item_content(p, line_end) : NULL;
+        if (item) {
+            list_indent = indent + (size_t)(item - p);
+            p = item;
+        }
+
+        const char *def = NULL;
+        bool continues = false;
+        bool code = !item && !blank && rel >= 4 && can_start && !in_def;
+        bool fence = is_code_fence_line(read, line_len);
+        /* A setext underline ends the paragraph above it */
+        bool underline = !in_fence && !blank && !code && !can_start && !in_def && rel < 4 &&
+                         is_setext_underline(p, line_end);
+        if (fence) {
+            in_fence = !in_fence;
+        } else if (!in_fence && !blank && !code && !item && rel < 4 && (html_close = html_block_close(p, line_end))) {
+            /* HTML block: a definition can follow the line that ends it */
+            if (line_has_close(p + 1, line_end, html_close)) html_close = NULL;
+            in_def = false;
+            can_start = html_close == NULL;
+            read = next;
+            continue;
+        } else if (!in_fence && !blank && !code && !rule && !underline) {
+            def = can_start || item ? reference_def_start(p, (size_t)(line_end - p)) : NULL;
+            /* Title, or URL after a bare "[label]:" */
+            continues = !def && in_def && (read[0] == ' ' || read[0] == '\t' ||
+                                          *p == '"' || *p == '\'' || *p == '(');
+        }
+
+        if (def || continues) {
+            const char *from = def ? def : p;
+            size_t piece = (size_t)(line_end - from);
+            if (len + piece + 3 > cap) {
+                size_t new_cap = cap ? cap * 2 : 1024;
+                while (len + piece + 3 > new_cap) new_cap *= 2;
+                char *grown = realloc(refs, new_cap);
+                if (!grown) {
+                    free(refs);
+                    return NULL;
+                }
+                refs = grown;
+                cap = new_cap;
+            }
+            /* Each definition starts its own paragraph */
+            if (def && len > 0) refs[len++] = '\n';
+            memcpy(refs + len, from, piece);
+            len += piece;
+            refs[len++] = '\n';
+        }
+
+        in_def = def || continues;
+        can_start = fence || in_fence || blank || in_def || code || rule || underline ||
+                    is_atx_heading_line(read, line_len);
+        read = next;
+    }
+
+    if (refs) refs[len] = '\0';
+    *out_len = len;
+    return refs;
+}
+
+/* Longest link label cmark accepts */
+#define DL_MAX_LABEL 999
+
+/**
+ * Collected definitions keyed by label, so each term or definition is
+ * parsed with only the definitions it can refer to. Labels are matched
+ * ASCII case-insensitively with whitespace collapsed; definitions whose
+ * labels have other bytes (which cmark case-folds as Unicode) go with
+ * every piece of content.
+ */
+typedef struct {
+    char *key;
+    const char *text;      /* Definition lines, inside dl_ref_map.refs */
+    size_t len;
+    size_t order;          /* Earlier definitions win, as in cmark */
+    unsigned long used;    /* Generation that last selected this entry */
+} dl_ref_entry;
+
+typedef struct {
+    char *refs;            /* From collect_reference_defs */
+    dl_ref_entry *entries; /* Sorted by key, one per label */
+    size_t count;
+    char *wide;            /* Definitions with non-ASCII labels */
+    size_t wide_len;
+    unsigned long generation;
+} dl_ref_map;
+
+/* Normalize a label into key (DL_MAX_LABEL + 1 bytes). Returns false if it is too long. */
+static bool dl_ref_key(const char *label, size_t len, char *key, bool *ascii) {
+    size_t n = 0;
+    bool space = false;
+    *ascii = true;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)label[i];
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            space = n > 0;
+            continue;
+        }
+        if (c >= 0x80) *ascii = false;
+        if (n + (space ? 2 : 1) > DL_MAX_LABEL) return false;
+        if (space) key[n++] = ' ';
+        space = false;
+        key[n++] = (char)tolower(c);
+    }
+    key[n] = '\0';
+    return n > 0;
+}
+
+static int dl_ref_entry_cmp(const void *a, const void *b) {
+    const dl_ref_entry *x = a;
+    const dl_ref_entry *y = b;
+    int c = strcmp(x->key, y->key);
+    if (c) return c;
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+static int dl_ref_key_cmp(const void *key, const void *entry) {
+    return strcmp(key, ((const dl_ref_entry *)entry)->key);
+}
+
+static void dl_ref_map_free(dl_ref_map *map) {
+    for (size_t i = 0; i < map->count; i++) free(map->entries[i].key);
+    free(map->entries);
+    free(map->wide);
+    free(map->refs);
+}
+
+/* Split collected definitions (one per paragraph) into the map. Returns false on allocation failure. */
+static bool dl_ref_map_build(dl_ref_map *map, char *refs, size_t refs_len) {
+    memset(map, 0, sizeof(*map));
+    map->refs = refs;
+    if (!refs) return true;
+
+    size_t cap = 0;
+    char key[DL_MAX_LABEL + 1];
+    const char *end = refs + refs_len;
+    const char *def = refs;
+    while (def < end) {
+        const char *next = def;
+        while (next < end && !(next[0] == '\n' && next + 1 < end && next[1] == '\n')) next++;
+        if (next < end) next++;
+        size_t len = (size_t)(next - def);
+
+        const char *close = def + 1;
+        while (close < next && *close != ']') close += (*close == '\\' && close + 1 < next) ? 2 : 1;
+        bool ascii;
+        if (close < next && dl_ref_key(def + 1, (size_t)(close - def - 1), key, &ascii)) {
+            if (!ascii) {
+                char *wide = realloc(map->wide, map->wide_len + len + 2);
+                if (!wide) return false;
+                map->wide = wide;
+                memcpy(wide + map->wide_len, def, len);
+                map->wide_len += len;
+                wide[map->wide_len++] = '\n';
+            } else {
+                if (map->count == cap) {
+                    size_t new_cap = cap ? cap * 2 : 16;
+                    dl_ref_entry *grown = realloc(map->entries, new_cap * sizeof(dl_ref_entry));
+                    if (!grown) return false;
+                    map->entries = grown;
+                    cap = new_cap;
+                }
+                char *k = strdup(key);
+                if (!k) return false;
+                map->entries[map->count] = (dl_ref_entry){ k, def, len, map->count, 0 };
+                map->count++;
+            }
+        }
+        def = next < end && *next == '\n' ? next + 1 : next;
+    }
+
+    if (map->count > 1) {
+        qsort(map->entries, map->count, sizeof(dl_ref_entry), dl_ref_entry_cmp);
+        size_t kept = 1;
+        for (size_t i = 1; i < map->count; i++) {
+            if (strcmp(map->entries[i].key, map->entries[kept - 1].key) == 0) {
+                free(map->entries[i].key);
+            } else {
+                map->entries[kept++] = map->entries[i];
+            }
+        }
+        map->count = kept;
+    }
+    return true;
+}
+
+/* Append text to a growing buffer. Returns false on allocation failure. */
+static bool dl_append(char **buf, size_t *len, size_t *cap, const char *text, size_t text_len) {
+    if (*len + text_len + 1 > *cap) {
+        size_t new_cap = *cap ? *cap * 2 : 256;
+        while (*len + text_len + 1 > new_cap) new_cap *= 2;
+        char *grown = realloc(*buf, new_cap);
+        if (!grown) return false;
+        *buf = grown;
+        *cap = new_cap;
+    }
+    memcpy(*buf + *len, text, text_len);
+    *len += text_len;
+    (*buf)[*len] = '\0';
+    return true;
+}
+
+/**
+ * Build the source for one piece of content: the definitions whose labels
+ * appear in brackets in it, a blank line, then the content. Returns NULL
+ * on allocation failure; caller frees.
+ */
+static char *dl_source_with_refs(dl_ref_map *map, const char *content, size_t content_len, size_t *out_len) {
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    bool ok = dl_append(&buf, &len, &cap, map->wide ? map->wide : "", map->wide_len);
+
+    map->generation++;
+    char key[DL_MAX_LABEL + 1];
+    const char *end = content + content_len;
+    for (const char *p = content; ok && map->count && p < end; p++) {
+        if (*p == '\\') {
+            p++;
+            continue;
+        }
+        if (*p != '[') continue;
+        const char *q = p + 1;
+        while (q < end && *q != ']' && *q != '[') q += (*q == '\\' && q + 1 < end) ? 2 : 1;
+        bool ascii;
+        if (q < end && *q == ']' && dl_ref_key(p + 1, (size_t)(q - p - 1), key, &ascii) && ascii) {
+            dl_ref_entry *entry = bsearch(key, map->entries, map->count, sizeof(dl_ref_entry), dl_ref_key_cmp);
+            if (entry && entry->used != map->generation) {
+                entry->used = map->generation;
+                ok = dl_append(&buf, &len, &cap, entry->text, entry->len) &&
+                     dl_append(&buf, &len, &cap, "\n", 1);
+            }
+        }
+        /* Resume at a nested "[" or after the closing "]" */
+        p = q < end && *q == '[' ? q - 1 : q;
+    }
+
+    ok = ok && dl_append(&buf, &len, &cap, "\n\n", 2) &&
+         dl_append(&buf, &len, &cap, content, content_len);
+    if (!ok) {
+        free(buf);
+        return NULL;
+    }
+    *out_len = len;
+    return buf;
+}
+
+/**
+ * Render inline content (term or definition) with the document's reference
+ * definitions so cmark can resolve reference links. Parses the definitions
+ * the content uses + "\n\n" + content and returns HTML of the last block
+ * (our content), stripping <p></p>. Caller must free the returned string.
+ */
+static char *render_inline_with_refs(const char *content, size_t content_len,
+                                     dl_ref_map *refs, bool unsafe) {
+    size_t src_len = 0;
+    char *buf = dl_source_with_refs(refs, content, content_len, &src_len);
     if (!buf) return NULL;
-    memcpy(buf, full_doc, full_doc_len);
-    buf[full_doc_len] = '\n';
-    buf[full_doc_len + 1] = '\n';
-    memcpy(buf + full_doc_len + 2, content, content_len);
-    buf[buf_len - 1] = '\0';
 
     int opts = CMARK_OPT_DEFAULT | CMARK_OPT_SMART;
     if (unsafe) opts |= CMARK_OPT_UNSAFE | CMARK_OPT_LIBERAL_HTML_TAG;
     cmark_parser *cp = cmark_parser_new(opts);
     if (!cp) { free(buf); return NULL; }
-    cmark_parser_feed(cp, buf, (int)(buf_len - 1));
+    cmark_parser_feed(cp, buf, (int)src_len);
     free(buf);
-    cmark_node *doc = cmark_parser_finish(cp);
+    cmark_node *doc = apex_parser_finish(cp);
     cmark_parser_free(cp);
     if (!doc) return NULL;
 
@@ -285,9 +687,22 @@ char *apex_process_definition_lists(const char *text, bool unsafe) {
     }
     if (!has_pattern) return NULL;
 
+    /* Gathered once; every term and definition is rendered against these */
+    size_t refs_len = 0;
+    char *ref_text = collect_reference_defs(text, text_len, &refs_len);
+    dl_ref_map ref_map;
+    dl_ref_map *refs = &ref_map;
+    if (!dl_ref_map_build(refs, ref_text, refs_len)) {
+        dl_ref_map_free(refs);
+        return NULL;
+    }
+
     size_t output_capacity = text_len * 3;
     char *output = malloc(output_capacity + 1);
-    if (!output) return NULL;
+    if (!output) {
+        dl_ref_map_free(refs);
+        return NULL;
+    }
 
     const char *read = text;
     char *write = output;
@@ -299,7 +714,7 @@ char *apex_process_definition_lists(const char *text, bool unsafe) {
         size_t min_capacity = used + (needed) + 1; \
         output_capacity = (min_capacity < 1024) ? 2048 : min_capacity * 2; \
         char *new_output = realloc(output, output_capacity + 1); \
-        if (!new_output) { free(output); return NULL; } \
+        if (!new_output) { free(output); dl_ref_map_free(refs); return NULL; } \
         output = new_output; \
         write = output + used; \
         remaining = output_capacity - used; \
@@ -460,7 +875,7 @@ char *apex_process_definition_lists(const char *text, bool unsafe) {
                 memcpy(write, "<dt>", 4);
                 write += 4;
                 remaining -= 4;
-                char *term_html = render_inline_with_doc(term_buffer, (size_t)term_len, text, text_len, unsafe);
+                char *term_html = render_inline_with_refs(term_buffer, (size_t)term_len, refs, unsafe);
                 if (term_html) {
                     size_t html_len = strlen(term_html);
                     ENSURE_SPACE(html_len + 20);
@@ -490,7 +905,7 @@ char *apex_process_definition_lists(const char *text, bool unsafe) {
             dd_open = true;
 
             if (def_len > 0) {
-                char *def_html = render_inline_with_doc(def_start, def_len, text, text_len, unsafe);
+                char *def_html = render_inline_with_refs(def_start, def_len, refs, unsafe);
                 if (def_html) {
                     size_t html_len = strlen(def_html);
                     ENSURE_SPACE(html_len + 20);
@@ -565,7 +980,7 @@ char *apex_process_definition_lists(const char *text, bool unsafe) {
 
             /* Parse term as inline markdown */
             if (term_len > 0) {
-                char *term_html = render_inline_with_doc(term_start, term_len, text, text_len, unsafe);
+                char *term_html = render_inline_with_refs(term_start, term_len, refs, unsafe);
                 if (term_html) {
                     size_t html_len = strlen(term_html);
                     ENSURE_SPACE(html_len + 20);
@@ -587,7 +1002,7 @@ char *apex_process_definition_lists(const char *text, bool unsafe) {
             remaining -= 4;
 
             if (def_len > 0) {
-                char *def_html = render_inline_with_doc(def_start, def_len, text, text_len, unsafe);
+                char *def_html = render_inline_with_refs(def_start, def_len, refs, unsafe);
                 if (def_html) {
                     size_t html_len = strlen(def_html);
                     ENSURE_SPACE(html_len + 20);
@@ -688,6 +1103,7 @@ char *apex_process_definition_lists(const char *text, bool unsafe) {
     *write = '\0';
 #undef ENSURE_SPACE
 
+    dl_ref_map_free(refs);
     return output;
 }
 
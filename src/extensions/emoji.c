@@ -9,7 +9,13 @@
 #include <ctype.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <pthread.h>
+#include "emoji_hash.h"
+#ifdef APEX_EMOJI_DATA_GENERATED
+#include APEX_EMOJI_DATA_GENERATED  /* Tables the CMake build generated from github-emoji.txt */
+#else
 #include "emoji_data.h"
+#endif
 
 /* Forward declarations */
 static void normalize_emoji_name(char *name);
@@ -45,11 +51,11 @@ static int line_is_indented_code_block(const char *read) {
  * Returns pointer to emoji_entry or NULL if not found
  */
 static const emoji_entry *find_emoji_entry(const char *name, int len) {
-    for (int i = 0; complete_emoji_map[i].name; i++) {
-        if (strlen(complete_emoji_map[i].name) == (size_t)len &&
-            strncmp(complete_emoji_map[i].name, name, len) == 0) {
-            return &complete_emoji_map[i];
-        }
+    if (len <= 0) return NULL;
+    size_t slot = emoji_hash_slot(name, (size_t)len, emoji_name_seeds, EMOJI_NAME_BUCKETS, EMOJI_NAME_SLOTS);
+    const emoji_entry *entry = &complete_emoji_map[emoji_name_slots[slot]];
+    if (strncmp(entry->name, name, (size_t)len) == 0 && entry->name[len] == '\0') {
+        return entry;
     }
     return NULL;
 }
@@ -217,31 +223,20 @@ static int is_inside_html_attribute(const char *pos, const char *start) {
 
 /**
  * Find emoji name from unicode emoji (reverse lookup)
- * Compares the unicode string against the emoji map
+ * The generated table maps each sequence to its longest (most descriptive)
+ * name, so "thumbsup" is preferred over "+1".
  */
 const char *apex_find_emoji_name(const char *unicode, size_t unicode_len) {
     if (!unicode || unicode_len == 0) return NULL;
 
-    const char *best_match = NULL;
-    size_t best_match_len = 0;
-
-    for (int i = 0; complete_emoji_map[i].name; i++) {
-        const char *emoji_unicode = complete_emoji_map[i].unicode;
-        if (emoji_unicode) {
-            size_t emoji_len = strlen(emoji_unicode);
-            /* Check if the unicode matches (exact match) */
-            if (emoji_len == unicode_len &&
-                strncmp(emoji_unicode, unicode, unicode_len) == 0) {
-                size_t name_len = strlen(complete_emoji_map[i].name);
-                /* Prefer longer names (more descriptive) over shorter ones (like "+1" vs "thumbsup") */
-                if (!best_match || name_len > best_match_len) {
-                    best_match = complete_emoji_map[i].name;
-                    best_match_len = name_len;
-                }
-            }
-        }
+    size_t slot = emoji_hash_slot(unicode, unicode_len, emoji_unicode_seeds,
+                                  EMOJI_UNICODE_BUCKETS, EMOJI_UNICODE_SLOTS);
+    const emoji_entry *entry = &complete_emoji_map[emoji_unicode_slots[slot]];
+    if (entry->unicode && strncmp(entry->unicode, unicode, unicode_len) == 0 &&
+        entry->unicode[unicode_len] == '\0') {
+        return entry->name;
     }
-    return best_match;
+    return NULL;
 }
 
 /**
@@ -635,56 +630,106 @@ static void normalize_emoji_name(char *name) {
     name[write_pos] = '\0';
 }
 
+/* Longest name the fuzzy matcher compares (normalized names are cut to 63) */
+#define EMOJI_FUZZY_MAX_LEN 63
+
+/* Bit mask of each byte's positions in a string of at most 64 bytes */
+typedef struct {
+    uint64_t peq[256];
+    size_t len;
+} emoji_pattern;
+
+static void emoji_pattern_init(emoji_pattern *pattern, const char *s, size_t len) {
+    memset(pattern->peq, 0, sizeof(pattern->peq));
+    if (len > EMOJI_FUZZY_MAX_LEN) len = EMOJI_FUZZY_MAX_LEN;
+    for (size_t i = 0; i < len; i++) {
+        pattern->peq[(unsigned char)s[i]] |= 1ULL << i;
+    }
+    pattern->len = len;
+}
+
 /**
- * Calculate Levenshtein distance between two strings
+ * Levenshtein distance between a pattern and a string, using Myers'
+ * bit-parallel algorithm: one column of the distance matrix is held in two
+ * 64-bit words, so each byte of text costs a handful of word operations
+ * and nothing is allocated.
  */
-static int levenshtein_distance(const char *s1, size_t len1, const char *s2, size_t len2) {
-    if (len1 == 0) return (int)len2;
-    if (len2 == 0) return (int)len1;
-
-    /* Use dynamic programming with minimal memory */
-    int *prev_row = malloc((len2 + 1) * sizeof(int));
-    int *curr_row = malloc((len2 + 1) * sizeof(int));
-    if (!prev_row || !curr_row) {
-        free(prev_row);
-        free(curr_row);
-        return (int)(len1 > len2 ? len1 : len2); /* Fallback: return max length */
+static int levenshtein_distance(const emoji_pattern *pattern, const char *text, size_t text_len) {
+    if (pattern->len == 0) return (int)text_len;
+
+    uint64_t pv = ~0ULL;  /* Vertical deltas of +1 */
+    uint64_t mv = 0;      /* Vertical deltas of -1 */
+    uint64_t last = 1ULL << (pattern->len - 1);
+    int score = (int)pattern->len;
+
+    for (size_t j = 0; j < text_len; j++) {
+        uint64_t eq = pattern->peq[(unsigned char)text[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & last) score++;
+        else if (mh & last) score--;
+        /* The top row grows by one per column */
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
     }
+    return score;
+}
 
-    /* Initialize first row */
-    for (size_t i = 0; i <= len2; i++) {
-        prev_row[i] = (int)i;
+/*
+ * BK-tree over the emoji names, built once per process. Each node's
+ * children are keyed by their edit distance to it; by the triangle
+ * inequality, a search for names within max_distance of a query at
+ * distance d from a node only needs children keyed d - max .. d + max.
+ */
+typedef struct {
+    int16_t first_child;   /* -1 if none */
+    int16_t next_sibling;  /* -1 if none */
+    uint8_t distance;      /* Edit distance to the parent */
+    uint8_t length;        /* strlen of the name */
+} emoji_bk_node;
+
+#define EMOJI_BK_NODES (sizeof(complete_emoji_map) / sizeof(complete_emoji_map[0]) - 1)
+
+static emoji_bk_node emoji_bk_tree[EMOJI_BK_NODES];
+static pthread_once_t emoji_bk_once = PTHREAD_ONCE_INIT;
+
+static void emoji_bk_build(void) {
+    /* Node i is complete_emoji_map[i]; node 0 is the root */
+    for (size_t i = 0; i < EMOJI_BK_NODES; i++) {
+        emoji_bk_tree[i].first_child = -1;
+        emoji_bk_tree[i].next_sibling = -1;
+        emoji_bk_tree[i].distance = 0;
+        emoji_bk_tree[i].length = (uint8_t)strlen(complete_emoji_map[i].name);
     }
-
-    /* Fill the matrix */
-    for (size_t i = 0; i < len1; i++) {
-        curr_row[0] = (int)(i + 1);
-        for (size_t j = 0; j < len2; j++) {
-            int cost = (s1[i] == s2[j]) ? 0 : 1;
-            int deletion = prev_row[j + 1] + 1;
-            int insertion = curr_row[j] + 1;
-            int substitution = prev_row[j] + cost;
-
-            curr_row[j + 1] = (deletion < insertion) ?
-                (deletion < substitution ? deletion : substitution) :
-                (insertion < substitution ? insertion : substitution);
+    emoji_pattern pattern;
+    for (size_t i = 1; i < EMOJI_BK_NODES; i++) {
+        emoji_pattern_init(&pattern, complete_emoji_map[i].name, emoji_bk_tree[i].length);
+        size_t node = 0;
+        for (;;) {
+            int d = levenshtein_distance(&pattern, complete_emoji_map[node].name, emoji_bk_tree[node].length);
+            int16_t child = emoji_bk_tree[node].first_child;
+            while (child >= 0 && emoji_bk_tree[child].distance != d) {
+                child = emoji_bk_tree[child].next_sibling;
+            }
+            if (child < 0) {
+                emoji_bk_tree[i].distance = (uint8_t)d;
+                emoji_bk_tree[i].next_sibling = emoji_bk_tree[node].first_child;
+                emoji_bk_tree[node].first_child = (int16_t)i;
+                break;
+            }
+            node = (size_t)child;
         }
-
-        /* Swap rows */
-        int *temp = prev_row;
-        prev_row = curr_row;
-        curr_row = temp;
     }
-
-    int result = prev_row[len2];
-    free(prev_row);
-    free(curr_row);
-    return result;
 }
 
 /**
  * Find best emoji match using fuzzy matching
- * Returns the shortest matching emoji name within max_distance, or NULL if no match
+ * Returns the closest emoji name within max_distance, preferring the shorter
+ * name and then the earlier one on ties, or NULL if no match
  */
 static const char *find_best_emoji_match(const char *name, size_t name_len, int max_distance) {
     char normalized[64];
@@ -702,28 +747,44 @@ static const char *find_best_emoji_match(const char *name, size_t name_len, int
         return exact->name;
     }
 
-    /* Find fuzzy matches */
+    pthread_once(&emoji_bk_once, emoji_bk_build);
+    emoji_pattern pattern;
+    emoji_pattern_init(&pattern, normalized, normalized_len);
+
+    /* Find fuzzy matches: depth-first walk of the BK-tree with an explicit stack */
     int best_distance = max_distance + 1;
     size_t best_length = SIZE_MAX;
-    const char *best_match = NULL;
+    int best_index = -1;
 
-    for (int i = 0; complete_emoji_map[i].name; i++) {
-        const char *emoji_name = complete_emoji_map[i].name;
-        size_t emoji_len = strlen(emoji_name);
+    int16_t stack[EMOJI_BK_NODES];
+    size_t depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        int16_t node = stack[--depth];
+        size_t emoji_len = emoji_bk_tree[node].length;
 
-        int distance = levenshtein_distance(normalized, normalized_len, emoji_name, emoji_len);
+        int distance = levenshtein_distance(&pattern, complete_emoji_map[node].name, emoji_len);
 
         if (distance <= max_distance) {
             if (distance < best_distance ||
-                (distance == best_distance && emoji_len < best_length)) {
+                (distance == best_distance &&
+                 (emoji_len < best_length || (emoji_len == best_length && node < best_index)))) {
                 best_distance = distance;
                 best_length = emoji_len;
-                best_match = emoji_name;
+                best_index = node;
+            }
+        }
+
+        for (int16_t child = emoji_bk_tree[node].first_child; child >= 0;
+             child = emoji_bk_tree[child].next_sibling) {
+            int edge = emoji_bk_tree[child].distance;
+            if (edge >= distance - max_distance && edge <= distance + max_distance) {
+                stack[depth++] = child;
             }
         }
     }
 
-    return best_match;
+    return best_index >= 0 ? complete_emoji_map[best_index].name : NULL;
 }
 
 /**
@@ -1,12 +1,14 @@
 /**
  * Complete GitHub Emoji Database
- * Generated from github-emoji.txt
+ * Generated from github-emoji.txt by tools/gen_emoji_data.c - do not edit
  * Total: 861 emoji mappings (847 unicode, 14 image-based)
  */
 
 #ifndef APEX_EMOJI_DATA_H
 #define APEX_EMOJI_DATA_H
 
+#include <stdint.h>
+
 typedef struct {
     const char *name;
     const char *unicode;  /* NULL if image-based */
@@ -939,4 +941,236 @@ static const emoji_entry complete_emoji_map[] = {
     {NULL, NULL, NULL}  /* Terminator */
 };
 
+/* Name lookup: perfect hash (emoji_hash.h) to the complete_emoji_map index */
+#define EMOJI_NAME_BUCKETS 430
+#define EMOJI_NAME_SLOTS 861
+
+static const uint16_t emoji_name_seeds[EMOJI_NAME_BUCKETS] = {
+    2, 4, 27, 0, 6, 5, 0, 1, 3, 14, 3, 1,
+    6, 1, 8, 3, 1, 1, 0, 1, 7, 1, 13, 22,
+    0, 0, 10, 6, 1, 0, 7, 20, 6, 0, 1, 4,
+    3, 0, 9, 1, 6, 0, 1, 2, 12, 2, 7, 6,
+    4, 1, 1, 1, 1, 0, 6, 1, 2, 5, 2, 1,
+    6, 6, 3, 1, 4, 3, 1, 8, 36, 3, 1, 0,
+    14, 4, 43, 25, 2, 4, 16, 3, 1, 1, 2, 6,
+    5, 8, 11, 7, 0, 18, 7, 1, 18, 1, 0, 15,
+    7, 3, 1, 2, 0, 1, 5, 3, 9, 0, 32, 5,
+    26, 1, 3, 6, 12, 0, 4, 5, 1, 4, 10, 20,
+    84, 1, 12, 1, 17, 1, 8, 12, 2, 11, 0, 4,
+    2, 3, 8, 16, 0, 1, 15, 2, 61, 1, 1, 11,
+    17, 1, 20, 0, 0, 1, 6, 4, 2, 6, 0, 23,
+    14, 0, 6, 4, 4, 11, 4, 2, 2, 4, 9, 1,
+    4, 1, 9, 6, 0, 6, 1, 0, 2, 8, 8, 0,
+    16, 1, 0, 5, 16, 0, 18, 8, 6, 39, 4, 11,
+    1, 1, 14, 17, 3, 11, 44, 12, 11, 2, 1, 2,
+    2, 4, 0, 8, 1, 26, 1, 4, 0, 12, 5, 15,
+    26, 7, 2, 15, 0, 1, 3, 73, 6, 37, 0, 2,
+    20, 2, 1, 2, 28, 0, 2, 3, 9, 16, 1, 5,
+    0, 0, 2, 0, 15, 1, 1, 23, 1, 3, 15, 35,
+    4, 0, 13, 6, 55, 20, 4, 3, 0, 0, 1, 3,
+    2, 1, 0, 3, 1, 16, 0, 36, 14, 7, 14, 12,
+    5, 19, 42, 0, 18, 0, 1, 10, 10, 2, 6, 16,
+    4, 1, 2, 60, 33, 0, 3, 12, 8, 11, 9, 1,
+    3, 13, 18, 21, 2, 6, 50, 19, 3, 1, 5, 28,
+    28, 4, 0, 9, 5, 8, 13, 8, 1, 2, 39, 2,
+    8, 33, 1, 48, 3, 72, 17, 0, 4, 0, 30, 0,
+    2, 42, 9, 23, 7, 84, 17, 1, 58, 19, 3, 55,
+    8, 3, 0, 5, 18, 5, 4, 25, 40, 1, 1, 18,
+    40, 19, 4, 5, 13, 3, 3, 48, 10, 26, 3, 17,
+    8, 0, 6, 4, 23, 0, 5, 13, 30, 67, 24, 14,
+    53, 74, 7, 14, 2, 2, 19, 91, 19, 69, 41, 24,
+    17, 0, 2, 15, 52, 52, 35, 5, 1, 1, 0, 99,
+    60, 0, 4, 5, 280, 100, 8, 21, 12, 195, 2, 1,
+    13, 35, 0, 146, 307, 4, 0, 783, 23, 970,
+};
+
+static const uint16_t emoji_name_slots[EMOJI_NAME_SLOTS] = {
+    56, 231, 641, 645, 538, 782, 793, 205, 262, 680, 25, 771,
+    592, 477, 556, 453, 119, 150, 780, 414, 257, 123, 401, 341,
+    681, 298, 223, 724, 131, 241, 419, 460, 473, 75, 144, 315,
+    714, 671, 729, 259, 113, 765, 383, 851, 830, 292, 0, 450,
+    24, 299, 309, 300, 826, 344, 636, 647, 353, 495, 853, 685,
+    815, 683, 728, 693, 726, 770, 112, 170, 109, 784, 588, 93,
+    106, 420, 362, 179, 367, 484, 520, 494, 270, 845, 237, 178,
+    849, 733, 813, 212, 509, 524, 213, 857, 416, 208, 493, 841,
+    511, 140, 321, 61, 666, 410, 53, 620, 190, 585, 373, 148,
+    16, 187, 153, 469, 673, 418, 475, 371, 616, 286, 180, 374,
+    188, 42, 351, 15, 105, 785, 132, 725, 111, 568, 717, 773,
+    501, 379, 468, 796, 380, 471, 523, 149, 707, 244, 603, 83,
+    805, 669, 711, 433, 327, 285, 478, 839, 583, 846, 225, 84,
+    47, 164, 334, 303, 662, 166, 214, 311, 349, 263, 391, 43,
+    719, 26, 100, 720, 65, 403, 38, 706, 621, 432, 412, 505,
+    455, 649, 17, 537, 336, 659, 375, 718, 60, 203, 242, 459,
+    599, 284, 404, 129, 218, 704, 396, 618, 390, 736, 182, 172,
+    500, 581, 543, 751, 575, 72, 689, 289, 844, 274, 32, 94,
+    41, 787, 737, 201, 426, 54, 797, 195, 800, 124, 542, 548,
+    591, 288, 146, 835, 246, 499, 20, 64, 329, 565, 422, 136,
+    343, 822, 605, 629, 14, 522, 703, 350, 62, 553, 587, 560,
+    766, 277, 653, 79, 644, 617, 399, 557, 710, 408, 467, 743,
+    564, 227, 337, 265, 534, 486, 74, 744, 508, 406, 127, 157,
+    393, 510, 2, 243, 183, 463, 775, 489, 573, 823, 476, 545,
+    497, 381, 254, 35, 295, 378, 440, 485, 71, 128, 162, 272,
+    11, 424, 449, 763, 597, 4, 194, 838, 727, 803, 650, 142,
+    721, 82, 197, 193, 518, 794, 723, 161, 121, 547, 808, 189,
+    699, 247, 328, 755, 672, 759, 90, 52, 595, 648, 472, 78,
+    752, 177, 697, 229, 312, 234, 411, 261, 101, 687, 466, 761,
+    750, 446, 313, 230, 138, 643, 531, 580, 549, 216, 488, 66,
+    739, 768, 168, 860, 481, 57, 68, 578, 798, 637, 318, 159,
+    267, 630, 325, 31, 207, 746, 283, 425, 252, 256, 577, 448,
+    695, 89, 795, 491, 465, 302, 452, 48, 354, 842, 638, 639,
+    665, 209, 73, 335, 832, 507, 88, 98, 407, 745, 776, 385,
+    632, 608, 235, 552, 217, 44, 600, 232, 151, 513, 619, 192,
+    709, 781, 529, 688, 614, 514, 233, 236, 589, 526, 609, 788,
+    5, 758, 384, 713, 271, 623, 708, 574, 163, 801, 824, 49,
+    55, 291, 836, 107, 779, 732, 451, 598, 818, 698, 156, 825,
+    245, 8, 40, 445, 551, 266, 820, 444, 690, 443, 10, 655,
+    811, 228, 338, 682, 63, 415, 821, 816, 676, 819, 70, 498,
+    756, 372, 829, 348, 1, 324, 308, 250, 428, 663, 50, 409,
+    22, 143, 610, 431, 160, 339, 778, 668, 731, 85, 657, 544,
+    264, 268, 652, 97, 239, 458, 76, 567, 631, 13, 27, 198,
+    59, 317, 30, 461, 392, 593, 633, 398, 748, 210, 397, 185,
+    310, 278, 831, 363, 604, 696, 253, 802, 102, 692, 184, 664,
+    125, 222, 532, 316, 258, 33, 69, 515, 255, 281, 828, 382,
+    219, 533, 738, 487, 447, 427, 539, 36, 462, 734, 607, 86,
+    340, 87, 642, 691, 147, 81, 684, 483, 240, 503, 767, 521,
+    528, 139, 421, 516, 442, 220, 249, 275, 705, 502, 359, 700,
+    370, 342, 850, 387, 333, 45, 430, 677, 730, 843, 120, 238,
+    51, 174, 290, 296, 563, 169, 679, 287, 566, 558, 155, 114,
+    840, 774, 646, 37, 535, 269, 606, 634, 191, 753, 417, 506,
+    405, 694, 301, 554, 126, 377, 154, 92, 28, 202, 305, 456,
+    571, 686, 858, 670, 388, 429, 435, 400, 110, 176, 118, 12,
+    204, 320, 108, 173, 355, 859, 186, 260, 171, 457, 167, 541,
+    654, 9, 394, 175, 330, 512, 658, 199, 181, 625, 612, 760,
+    386, 527, 248, 99, 749, 145, 855, 660, 722, 582, 319, 314,
+    77, 530, 615, 80, 848, 772, 46, 293, 436, 104, 837, 786,
+    211, 611, 434, 58, 23, 667, 550, 715, 701, 117, 331, 854,
+    740, 133, 783, 141, 413, 345, 576, 395, 196, 627, 251, 122,
+    586, 702, 622, 376, 584, 365, 540, 716, 29, 799, 364, 470,
+    810, 135, 602, 777, 307, 590, 496, 39, 628, 791, 137, 34,
+    439, 809, 165, 762, 438, 454, 95, 158, 807, 221, 856, 596,
+    280, 827, 276, 525, 402, 678, 356, 601, 103, 224, 572, 437,
+    806, 579, 814, 812, 294, 519, 569, 536, 754, 480, 789, 19,
+    804, 389, 613, 490, 352, 357, 306, 322, 769, 492, 847, 656,
+    626, 764, 134, 852, 323, 712, 817, 504, 273, 226, 423, 479,
+    559, 360, 347, 624, 130, 735, 517, 332, 200, 546, 215, 464,
+    346, 3, 482, 675, 570, 635, 790, 757, 368, 594, 747, 674,
+    555, 326, 369, 741, 640, 834, 361, 115, 96, 279, 366, 206,
+    474, 792, 661, 21, 651, 116, 358, 742, 833, 6, 282, 67,
+    18, 297, 91, 561, 562, 441, 304, 7, 152,
+};
+
+/* Reverse lookup: unicode sequence to the index of its longest name */
+#define EMOJI_UNICODE_BUCKETS 413
+#define EMOJI_UNICODE_SLOTS 827
+
+static const uint16_t emoji_unicode_seeds[EMOJI_UNICODE_BUCKETS] = {
+    4, 1, 15, 0, 3, 1, 1, 2, 3, 18, 1, 1,
+    2, 6, 5, 2, 0, 2, 3, 1, 1, 4, 5, 1,
+    3, 1, 10, 7, 5, 1, 2, 5, 3, 6, 8, 2,
+    1, 4, 15, 1, 1, 8, 1, 13, 4, 17, 0, 1,
+    0, 3, 7, 11, 0, 0, 7, 1, 0, 1, 3, 2,
+    3, 0, 7, 1, 12, 3, 6, 1, 18, 2, 44, 2,
+    7, 1, 0, 2, 5, 2, 0, 24, 3, 1, 5, 7,
+    0, 27, 0, 1, 1, 31, 0, 1, 10, 28, 0, 4,
+    5, 10, 30, 7, 21, 2, 4, 22, 11, 0, 3, 7,
+    0, 2, 4, 46, 3, 15, 15, 12, 6, 0, 5, 5,
+    0, 6, 0, 0, 4, 2, 21, 8, 3, 0, 13, 12,
+    6, 7, 4, 3, 13, 2, 1, 29, 11, 16, 8, 1,
+    3, 1, 12, 5, 20, 22, 2, 17, 9, 2, 10, 0,
+    33, 23, 53, 10, 0, 0, 5, 9, 67, 0, 7, 21,
+    20, 3, 2, 7, 47, 0, 2, 1, 2, 1, 2, 3,
+    14, 0, 17, 2, 3, 17, 12, 17, 13, 1, 10, 11,
+    0, 6, 13, 6, 9, 7, 2, 0, 11, 3, 1, 0,
+    0, 10, 0, 4, 32, 6, 1, 24, 0, 15, 2, 1,
+    14, 18, 51, 0, 30, 9, 0, 4, 3, 5, 3, 3,
+    5, 5, 8, 7, 7, 65, 5, 5, 9, 5, 4, 14,
+    5, 18, 10, 10, 5, 1, 39, 0, 1, 8, 3, 21,
+    20, 0, 1, 63, 8, 0, 14, 0, 7, 1, 1, 5,
+    31, 29, 51, 4, 1, 42, 1, 32, 2, 15, 7, 33,
+    56, 18, 8, 41, 40, 1, 0, 7, 10, 2, 118, 1,
+    7, 88, 11, 8, 0, 83, 3, 13, 0, 11, 0, 35,
+    15, 32, 6, 21, 1, 7, 8, 7, 31, 22, 11, 0,
+    0, 1, 19, 7, 0, 46, 16, 4, 10, 0, 90, 17,
+    41, 3, 8, 3, 71, 10, 1, 0, 74, 30, 0, 0,
+    6, 8, 8, 0, 11, 14, 0, 1, 94, 15, 1, 0,
+    60, 95, 0, 0, 11, 85, 1, 31, 1, 4, 30, 57,
+    8, 2, 105, 3, 0, 2, 0, 7, 10, 57, 8, 17,
+    61, 2, 275, 81, 4, 0, 67, 19, 0, 5, 103, 4,
+    0, 6, 385, 3, 5, 2, 11, 156, 2, 2, 11, 94,
+    2, 72, 207, 20, 0, 0, 1, 19, 3, 1367, 195, 1,
+    36, 35, 0, 0, 103,
+};
+
+static const uint16_t emoji_unicode_slots[EMOJI_UNICODE_SLOTS] = {
+    506, 560, 388, 658, 798, 332, 204, 609, 24, 49, 172, 122,
+    358, 378, 395, 549, 809, 547, 488, 754, 316, 15, 654, 631,
+    343, 818, 623, 373, 402, 587, 827, 187, 284, 220, 305, 501,
+    856, 646, 289, 688, 622, 532, 436, 182, 573, 575, 693, 264,
+    537, 731, 849, 554, 85, 720, 846, 750, 743, 689, 200, 564,
+    14, 147, 451, 347, 152, 130, 588, 674, 509, 95, 65, 382,
+    183, 329, 602, 364, 562, 681, 533, 7, 60, 450, 224, 153,
+    470, 838, 823, 700, 53, 246, 638, 644, 687, 293, 168, 389,
+    173, 327, 336, 730, 107, 561, 176, 6, 716, 834, 236, 21,
+    472, 401, 104, 502, 274, 677, 45, 534, 724, 625, 733, 516,
+    738, 295, 44, 660, 692, 297, 698, 318, 285, 779, 59, 36,
+    755, 51, 341, 154, 831, 234, 657, 426, 308, 566, 403, 415,
+    421, 742, 372, 548, 518, 259, 345, 487, 600, 233, 103, 704,
+    311, 729, 705, 181, 310, 133, 461, 832, 784, 830, 207, 531,
+    27, 313, 824, 551, 481, 76, 12, 354, 499, 844, 778, 579,
+    145, 852, 783, 805, 86, 185, 304, 33, 434, 594, 758, 736,
+    614, 676, 250, 164, 56, 512, 276, 63, 132, 756, 649, 418,
+    612, 727, 732, 616, 148, 585, 429, 61, 583, 317, 263, 771,
+    521, 656, 346, 454, 179, 452, 74, 847, 572, 375, 2, 419,
+    503, 117, 405, 245, 121, 229, 469, 169, 476, 239, 360, 568,
+    751, 216, 275, 417, 734, 813, 75, 467, 489, 299, 337, 848,
+    635, 223, 797, 569, 92, 522, 491, 540, 331, 628, 143, 240,
+    249, 545, 765, 89, 72, 785, 258, 444, 146, 272, 339, 393,
+    709, 744, 300, 13, 377, 455, 794, 277, 528, 381, 558, 238,
+    766, 485, 414, 188, 114, 214, 453, 829, 800, 726, 604, 124,
+    266, 438, 374, 156, 519, 570, 515, 741, 330, 708, 667, 590,
+    795, 129, 273, 171, 261, 119, 679, 477, 288, 231, 670, 247,
+    396, 9, 603, 826, 428, 753, 653, 140, 817, 324, 411, 178,
+    286, 31, 62, 496, 850, 686, 97, 482, 473, 822, 320, 596,
+    254, 458, 292, 775, 160, 683, 574, 459, 557, 803, 232, 365,
+    563, 740, 194, 314, 589, 505, 855, 668, 757, 35, 157, 88,
+    287, 202, 376, 186, 306, 404, 712, 565, 353, 702, 652, 116,
+    749, 595, 520, 58, 840, 752, 699, 210, 464, 67, 11, 544,
+    642, 109, 361, 302, 836, 237, 511, 368, 340, 691, 201, 760,
+    40, 68, 408, 158, 371, 621, 764, 739, 48, 134, 669, 301,
+    737, 309, 471, 703, 209, 29, 774, 787, 355, 10, 759, 111,
+    221, 4, 211, 5, 714, 601, 613, 530, 416, 357, 645, 127,
+    435, 255, 457, 789, 82, 719, 217, 32, 391, 406, 105, 328,
+    845, 52, 629, 804, 184, 598, 392, 776, 662, 167, 597, 37,
+    578, 367, 715, 685, 468, 463, 356, 203, 386, 728, 768, 717,
+    792, 322, 710, 17, 437, 460, 241, 661, 79, 198, 22, 205,
+    370, 523, 665, 433, 162, 696, 853, 725, 413, 98, 825, 431,
+    666, 323, 41, 851, 70, 110, 23, 112, 141, 423, 860, 639,
+    773, 811, 841, 786, 64, 748, 163, 541, 828, 651, 230, 315,
+    576, 497, 663, 282, 18, 335, 212, 84, 682, 439, 494, 296,
+    680, 66, 219, 857, 350, 208, 369, 424, 599, 398, 334, 281,
+    632, 527, 338, 215, 859, 195, 443, 648, 556, 78, 427, 634,
+    149, 584, 799, 42, 650, 190, 50, 228, 618, 449, 150, 257,
+    155, 577, 108, 43, 762, 206, 39, 695, 191, 93, 770, 390,
+    46, 294, 400, 144, 57, 591, 197, 3, 321, 761, 80, 38,
+    807, 801, 529, 559, 399, 253, 675, 624, 550, 858, 790, 138,
+    746, 492, 640, 290, 81, 782, 139, 412, 113, 303, 291, 252,
+    483, 351, 271, 611, 16, 478, 397, 430, 87, 269, 99, 235,
+    843, 546, 225, 837, 486, 262, 553, 115, 571, 777, 422, 462,
+    684, 466, 525, 26, 835, 69, 796, 536, 630, 244, 94, 767,
+    128, 379, 539, 475, 610, 73, 781, 409, 690, 175, 136, 440,
+    298, 349, 348, 659, 385, 102, 626, 91, 655, 772, 366, 793,
+    456, 542, 120, 307, 19, 833, 581, 619, 747, 199, 517, 802,
+    319, 352, 189, 538, 694, 71, 543, 815, 248, 500, 100, 819,
+    812, 47, 504, 394, 810, 495, 193, 123, 678, 707, 278, 816,
+    718, 359, 745, 446, 420, 839, 592, 723, 620, 586, 432, 142,
+    20, 265, 362, 243, 647, 637, 713, 510, 706, 387, 722, 131,
+    177, 159, 580, 180, 633, 513, 165, 842, 54, 641, 174, 820,
+    615, 701, 448, 627, 196, 814, 535, 135, 555, 524, 312, 55,
+    125, 791, 788, 493, 270, 763, 552, 30, 474, 83, 77, 161,
+    441, 407, 769, 137, 410, 617, 166, 242, 226, 333, 490, 636,
+    479, 342, 697, 514, 251, 106, 28, 445, 192, 218, 151, 8,
+    384, 484, 442, 118, 380, 854, 508, 711, 507, 227, 256, 222,
+    25, 447, 664, 808, 34, 267, 170, 821, 213, 721, 363,
+};
+
 #endif /* APEX_EMOJI_DATA_H */
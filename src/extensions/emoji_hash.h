@@ -0,0 +1,40 @@
+/**
+ * Emoji Perfect Hash
+ *
+ * Hash functions shared by tools/gen_emoji_data.c, which builds the lookup
+ * tables in emoji_data.h, and emoji.c, which reads them. The tables are a
+ * hash-and-displace minimal perfect hash: a key's bucket (seed 0) gives a
+ * seed, and the key hashed with that seed gives its slot. Every table key
+ * has its own slot; any other string lands on some slot too, so callers
+ * compare the entry there with the key.
+ */
+
+#ifndef APEX_EMOJI_HASH_H
+#define APEX_EMOJI_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* FNV-1a with a seeded start, then a murmur3 finalizer to spread the bits */
+static inline uint32_t emoji_hash(const char *key, size_t len, uint32_t seed) {
+    uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)key[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Slot for key in a table of slot_count slots with bucket_count seeds */
+static inline size_t emoji_hash_slot(const char *key, size_t len, const uint16_t *seeds,
+                                     size_t bucket_count, size_t slot_count) {
+    uint32_t seed = seeds[emoji_hash(key, len, 0) % bucket_count];
+    return emoji_hash(key, len, seed) % slot_count;
+}
+
+#endif /* APEX_EMOJI_HASH_H */
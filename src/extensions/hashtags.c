@@ -0,0 +1,115 @@
+/**
+ * Hashtags Extension for Apex
+ * Implementation
+ */
+
+#include "hashtags.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char *hashtag_class_basic = "mkhashtag";
+static const char *hashtag_class_styled = "mkstyledtag";
+
+static bool is_hashtag_start_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+static bool is_hashtag_stop_char(char c) {
+    return c == '#' || c == ' ' || c == '\n' || c == ',' || c == ';' ||
+           c == '.' || c == '!' || c == ')' || c == ']';
+}
+
+/**
+ * Line stage: hashtags never span lines and the indented-code state resets
+ * at every newline, so each line is handled on its own.
+ */
+static apex_pp_result hashtags_line(void *state, const char *line, size_t len, apex_pp_sink *out) {
+    const char *class_name = (const char *)state;
+
+    if (!memchr(line, '#', len)) {
+        return APEX_PP_PASS;
+    }
+
+    const char *end = line + len;
+    const char *read = line;
+    const char *copy_from = line;
+    bool in_code_block = false;
+    bool at_line_start = true;
+    int indent_count = 0;
+
+    while (read < end) {
+        /* Track code blocks (4+ spaces or tab at line start) */
+        if (at_line_start) {
+            if (*read == '\t') {
+                in_code_block = true;
+                indent_count = 0;
+            } else if (*read == ' ') {
+                indent_count++;
+                if (indent_count >= 4) {
+                    in_code_block = true;
+                }
+            } else if (*read != '\n' && *read != '\r') {
+                at_line_start = false;
+                indent_count = 0;
+            }
+        }
+
+        if (in_code_block) {
+            /* Rest of the line is code; nothing more to convert */
+            break;
+        }
+
+        /* Pattern: (?<=\s|^)#[a-zA-Z0-9][^# \n,;.!\)\]]* */
+        if (*read == '#' && (read == line || read[-1] == ' ' || read[-1] == '\t')) {
+            const char *tag_start = read;
+            const char *name = read + 1;
+
+            if (name < end && is_hashtag_start_char(*name)) {
+                const char *tag_end = name;
+                while (tag_end < end && !is_hashtag_stop_char(*tag_end)) {
+                    tag_end++;
+                }
+
+                /* Special case: #tag# format (wrapped in #) */
+                if (tag_end < end && *tag_end == '#') {
+                    tag_end++;
+                }
+
+                apex_pp_emit(out, copy_from, (size_t)(tag_start - copy_from));
+                apex_pp_emit(out, "<span class=\"", 13);
+                apex_pp_emit(out, class_name, strlen(class_name));
+                apex_pp_emit(out, "\">", 2);
+                apex_pp_emit(out, tag_start, (size_t)(tag_end - tag_start));
+                apex_pp_emit(out, "</span>", 7);
+
+                read = tag_end;
+                copy_from = tag_end;
+                continue;
+            }
+        }
+
+        read++;
+    }
+
+    apex_pp_emit(out, copy_from, (size_t)(end - copy_from));
+    return APEX_PP_HANDLED;
+}
+
+bool apex_hashtags_add_stage(apex_preprocessor *pp, bool styled) {
+    const char *class_name = styled ? hashtag_class_styled : hashtag_class_basic;
+    return apex_preprocessor_add_stage(pp, "hashtags", hashtags_line, NULL, (void *)class_name);
+}
+
+char *apex_process_hashtags(const char *text, bool styled) {
+    if (!text) return NULL;
+
+    apex_preprocessor *pp = apex_preprocessor_new();
+    if (!pp) return NULL;
+
+    char *result = NULL;
+    if (apex_hashtags_add_stage(pp, styled)) {
+        result = apex_preprocessor_run(pp, text, strlen(text));
+    }
+    apex_preprocessor_free(pp);
+    return result;
+}
@@ -0,0 +1,37 @@
+/**
+ * Hashtags Extension for Apex
+ *
+ * Wraps #tags in span elements (Marked-style):
+ *   #project  ->  <span class="mkhashtag">#project</span>
+ *
+ * A tag starts with # at the beginning of a line or after whitespace,
+ * followed by an ASCII letter or digit. Indented code lines are skipped.
+ */
+
+#ifndef APEX_HASHTAGS_H
+#define APEX_HASHTAGS_H
+
+#include <stdbool.h>
+#include "../preprocess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Register the hashtag line stage on a streaming preprocessor
+ * @param styled Use the "mkstyledtag" class instead of "mkhashtag"
+ */
+bool apex_hashtags_add_stage(apex_preprocessor *pp, bool styled);
+
+/**
+ * Process hashtags in text
+ * @return Newly allocated string (must be freed), or NULL on error
+ */
+char *apex_process_hashtags(const char *text, bool styled);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APEX_HASHTAGS_H */
@@ -6,6 +6,7 @@
 #include "header_ids.h"
 #include "cmark-gfm.h"
 #include "emoji.h"
+#include "../attr_pool.h"
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
@@ -608,9 +609,23 @@ static bool is_valid_mmd_id(const char *s) {
     return true;
 }
 
+/**
+ * Give a heading an ID, unless its IAL already set one
+ */
+static void set_heading_id(cmark_node *heading_node, const char *id) {
+    apex_attributes *attrs = calloc(1, sizeof(apex_attributes));
+    if (!attrs) return;
+    attrs->id = strdup(id);
+    if (!attrs->id) {
+        free(attrs);
+        return;
+    }
+    apex_node_add_attributes(heading_node, attrs);
+}
+
 /**
  * Process manual header IDs in a heading node
- * Extracts MMD [id] or Kramdown {#id} syntax and stores ID in user_data
+ * Extracts MMD [id] or Kramdown {#id} syntax and stores the ID on the node
  * Updates the heading text node to remove the manual ID syntax
  *
  * Walks ALL text children (not just first) so headings split by "&" etc.
@@ -661,26 +676,7 @@ bool apex_process_manual_header_id(cmark_node *heading_node) {
     }
 
     if (match_node && match_id) {
-        /* Store ID in user_data as id="..." */
-        char *id_attr = malloc(strlen(match_id) + 6);  /* id="" + null */
-        if (id_attr) {
-            sprintf(id_attr, "id=\"%s\"", match_id);
-
-            /* Merge with existing user_data if present (e.g. from IAL) */
-            char *existing = (char *)cmark_node_get_user_data(heading_node);
-            if (existing) {
-                char *combined = malloc(strlen(existing) + strlen(id_attr) + 2);
-                if (combined) {
-                    sprintf(combined, "%s %s", existing, id_attr);
-                    cmark_node_set_user_data(heading_node, combined);
-                    free(id_attr);
-                } else {
-                    cmark_node_set_user_data(heading_node, id_attr);
-                }
-            } else {
-                cmark_node_set_user_data(heading_node, id_attr);
-            }
-        }
+        set_heading_id(heading_node, match_id);
 
         cmark_node_set_literal(match_node, match_text);
         free(match_id);
@@ -723,23 +719,7 @@ bool apex_process_manual_header_id(cmark_node *heading_node) {
     cmark_node_unlink(last);
     cmark_node_free(last);
 
-    char *id_attr = malloc(strlen(link_text) + 6);
-    if (id_attr) {
-        sprintf(id_attr, "id=\"%s\"", link_text);
-        char *existing = (char *)cmark_node_get_user_data(heading_node);
-        if (existing) {
-            char *combined = malloc(strlen(existing) + strlen(id_attr) + 2);
-            if (combined) {
-                sprintf(combined, "%s %s", existing, id_attr);
-                cmark_node_set_user_data(heading_node, combined);
-                free(id_attr);
-            } else {
-                cmark_node_set_user_data(heading_node, id_attr);
-            }
-        } else {
-            cmark_node_set_user_data(heading_node, id_attr);
-        }
-    }
+    set_heading_id(heading_node, link_text);
     free(link_text);
     return true;
 }
@@ -9,69 +9,81 @@
 #include <stdbool.h>
 #include <ctype.h>
 
+/* Byte at p, or '\0' past the end of the line */
+#define AT(p) ((p) < end ? *(p) : '\0')
+
 /** True if content at p looks like a list marker (- , * , + , or digit+. ) */
-static bool looks_like_list_marker(const char *p) {
-    if (*p == '-' || *p == '*' || *p == '+')
-        return (p[1] == ' ' || p[1] == '\t');
-    if (isdigit((unsigned char)*p)) {
-        while (isdigit((unsigned char)*p)) p++;
-        return (*p == '.' && (p[1] == ' ' || p[1] == '\t'));
+static bool looks_like_list_marker(const char *p, const char *end) {
+    if (AT(p) == '-' || AT(p) == '*' || AT(p) == '+')
+        return (AT(p + 1) == ' ' || AT(p + 1) == '\t');
+    if (isdigit((unsigned char)AT(p))) {
+        while (isdigit((unsigned char)AT(p))) p++;
+        return (AT(p) == '.' && (AT(p + 1) == ' ' || AT(p + 1) == '\t'));
     }
     return false;
 }
 
-/** True if we're at the start of a line that is an indented code block (4+ spaces or tab)
- * and not a list line. List lines (nested or continuation) should still get highlight. */
-static bool line_is_indented_code_block(const char *read) {
-    if (*read == '\t') {
-        return !looks_like_list_marker(read + 1);
+/** True if the line is an indented code block (4+ spaces or tab) and not a
+ * list line. List lines (nested or continuation) should still get highlight. */
+static bool line_is_indented_code_block(const char *read, const char *end) {
+    if (AT(read) == '\t') {
+        return !looks_like_list_marker(read + 1, end);
     }
-    if (read[0] != ' ' || read[1] != ' ' || read[2] != ' ' || read[3] != ' ')
+    if (AT(read) != ' ' || AT(read + 1) != ' ' || AT(read + 2) != ' ' || AT(read + 3) != ' ')
         return false;
     const char *content = read + 4;
-    while (*content == ' ')
+    while (AT(content) == ' ')
         content++;
-    return !looks_like_list_marker(content);
+    return !looks_like_list_marker(content, end);
 }
 
-/**
- * Process ==highlight== syntax as preprocessing
- * Converts to <mark>text</mark> before parsing
- */
-char *apex_process_highlights(const char *text) {
-    if (!text) return NULL;
+/** True if the line contains "==" */
+static bool has_double_equals(const char *p, const char *end) {
+    while (p + 1 < end) {
+        const char *hit = memchr(p, '=', (size_t)(end - p - 1));
+        if (!hit) return false;
+        if (hit[1] == '=') return true;
+        p = hit + 1;
+    }
+    return false;
+}
 
-    size_t len = strlen(text);
-    size_t capacity = len * 2;  /* Room for <mark> tags */
-    char *output = malloc(capacity);
-    if (!output) return NULL;
+void apex_highlight_state_init(apex_highlight_state *state) {
+    if (!state) return;
+    state->in_code_block = false;
+    state->in_inline_code = false;
+}
 
-    const char *read = text;
-    char *write = output;
-    size_t remaining = capacity;
+/**
+ * Line stage: convert ==highlight== to <mark>highlight</mark>, outside
+ * fenced, inline and indented code
+ */
+static apex_pp_result highlights_line(void *state, const char *line, size_t len, apex_pp_sink *out) {
+    apex_highlight_state *st = (apex_highlight_state *)state;
+    const char *end = line + len;
 
-    bool in_code_block = false;
-    bool in_inline_code = false;
-    bool in_indented_code_block = false;
+    /* Nothing to convert and no code state to update */
+    if (!memchr(line, '`', len) && !has_double_equals(line, end)) {
+        return APEX_PP_PASS;
+    }
 
-    while (*read) {
-        /* At line start: indented code block only if 4+ spaces/tab and not a list line */
-        if (read == text || read[-1] == '\n') {
-            in_indented_code_block = line_is_indented_code_block(read);
-        }
+    bool in_indented_code_block = line_is_indented_code_block(line, end);
+    const char *read = line;
+    const char *copy_from = line;
 
+    while (read < end) {
         /* Track fenced and inline code (skip highlighting inside them) */
         if (*read == '`') {
-            if (read[1] == '`' && read[2] == '`') {
-                in_code_block = !in_code_block;
-            } else if (!in_code_block) {
-                in_inline_code = !in_inline_code;
+            if (AT(read + 1) == '`' && AT(read + 2) == '`') {
+                st->in_code_block = !st->in_code_block;
+            } else if (!st->in_code_block) {
+                st->in_inline_code = !st->in_inline_code;
             }
         }
 
         /* Look for ==highlight== (not in code, not Critic Markup) */
         /* Skip if preceded by { (Critic Markup) */
-        bool is_critic = (read > text && read[-1] == '{');
+        bool is_critic = (read > line && read[-1] == '{');
 
         /* Check opening == requirements:
          * - Exactly 2 = characters: read[0] == '=' && read[1] == '='
@@ -80,30 +92,31 @@ char *apex_process_highlights(const char *text) {
          * - Character immediately before or after == is not +
          * - Character after == is not whitespace
          */
-        bool preceded_by_equals = (read > text && read[-1] == '=');
-        bool preceded_by_plus = (read > text && read[-1] == '+');
-        bool followed_by_plus = (read[2] == '+');
-        bool is_valid_highlight_start = (read[0] == '=' && read[1] == '=' &&
-                                         read[2] != '=' && read[2] != '}' &&
-                                         read[2] != '\0' && read[2] != '\n' &&
-                                         read[2] != '\r' && read[2] != ' ' && read[2] != '\t' &&
-                                         !preceded_by_equals && !preceded_by_plus && !followed_by_plus);
-
-        if (!in_code_block && !in_inline_code && !in_indented_code_block && !is_critic && is_valid_highlight_start) {
+        char after = AT(read + 2);
+        bool preceded_by_equals = (read > line && read[-1] == '=');
+        bool preceded_by_plus = (read > line && read[-1] == '+');
+        bool is_valid_highlight_start = (read[0] == '=' && AT(read + 1) == '=' &&
+                                         after != '=' && after != '}' &&
+                                         after != '\0' && after != '\n' &&
+                                         after != '\r' && after != ' ' && after != '\t' &&
+                                         after != '+' && !preceded_by_equals && !preceded_by_plus);
+
+        if (!st->in_code_block && !st->in_inline_code && !in_indented_code_block && !is_critic &&
+            is_valid_highlight_start) {
 
             /* Find closing == */
             const char *close = read + 2;
-            while (*close && *close != '\n' && *close != '\r') {
-                if (close[0] == '=' && close[1] == '=') {
+            while (close < end && *close != '\n' && *close != '\r') {
+                if (close[0] == '=' && AT(close + 1) == '=') {
                     /* Check closing == requirements:
                      * - Character after closing == is not =
                      * - Character before closing == is not space
                      * - Character immediately before or after closing == is not +
                      */
-                    bool closing_followed_by_equals = (close[2] == '=');
+                    bool closing_followed_by_equals = (AT(close + 2) == '=');
                     bool closing_preceded_by_space = (close > read + 2 && (close[-1] == ' ' || close[-1] == '\t'));
                     bool closing_preceded_by_plus = (close > read + 2 && close[-1] == '+');
-                    bool closing_followed_by_plus = (close[2] == '+');
+                    bool closing_followed_by_plus = (AT(close + 2) == '+');
 
                     if (!closing_followed_by_equals && !closing_preceded_by_space &&
                         !closing_preceded_by_plus && !closing_followed_by_plus) {
@@ -113,55 +126,48 @@ char *apex_process_highlights(const char *text) {
                 close++;
             }
 
-            if (*close && close[0] == '=' && close[1] == '=' && close[2] != '=') {
-                /* Found complete ==highlight== */
-                size_t content_len = close - (read + 2);
-
-                /* Ensure there's actual content (not just == on a line by itself) */
-                if (content_len > 0) {
-                    /* Write <mark> */
-                    const char *open_tag = "<mark>";
-                    size_t tag_len = strlen(open_tag);
-                    if (tag_len < remaining) {
-                        memcpy(write, open_tag, tag_len);
-                        write += tag_len;
-                        remaining -= tag_len;
-                    }
-
-                    /* Copy highlighted content */
-                    if (content_len < remaining) {
-                        memcpy(write, read + 2, content_len);
-                        write += content_len;
-                        remaining -= content_len;
-                    }
-
-                    /* Write </mark> */
-                    const char *close_tag = "</mark>";
-                    tag_len = strlen(close_tag);
-                    if (tag_len < remaining) {
-                        memcpy(write, close_tag, tag_len);
-                        write += tag_len;
-                        remaining -= tag_len;
-                    }
-
-                    /* Skip past the closing == */
-                    read = close + 2;
-                    continue;
-                }
+            /* Found complete ==highlight== with actual content */
+            if (close < end && close[0] == '=' && AT(close + 1) == '=' && AT(close + 2) != '=' &&
+                close > read + 2) {
+                apex_pp_emit(out, copy_from, (size_t)(read - copy_from));
+                apex_pp_emit(out, "<mark>", 6);
+                apex_pp_emit(out, read + 2, (size_t)(close - (read + 2)));
+                apex_pp_emit(out, "</mark>", 7);
+
+                /* Skip past the closing == */
+                read = close + 2;
+                copy_from = read;
+                continue;
             }
         }
 
-        /* Copy character */
-        if (remaining > 0) {
-            *write++ = *read++;
-            remaining--;
-        } else {
-            read++;
-        }
+        read++;
     }
 
-    *write = '\0';
-    return output;
+    apex_pp_emit(out, copy_from, (size_t)(end - copy_from));
+    return APEX_PP_HANDLED;
 }
 
+bool apex_highlights_add_stage(apex_preprocessor *pp, apex_highlight_state *state) {
+    return apex_preprocessor_add_stage(pp, "highlights", highlights_line, NULL, state);
+}
 
+/**
+ * Process ==highlight== syntax as preprocessing
+ * Converts to <mark>text</mark> before parsing
+ */
+char *apex_process_highlights(const char *text) {
+    if (!text) return NULL;
+
+    apex_preprocessor *pp = apex_preprocessor_new();
+    if (!pp) return NULL;
+
+    apex_highlight_state state;
+    apex_highlight_state_init(&state);
+    char *result = NULL;
+    if (apex_highlights_add_stage(pp, &state)) {
+        result = apex_preprocessor_run(pp, text, strlen(text));
+    }
+    apex_preprocessor_free(pp);
+    return result;
+}
@@ -1,11 +1,34 @@
 /**
  * Simple Highlight Extension
  * Handles ==text== syntax (not part of CommonMark, but widely supported)
+ *
+ * A highlight never spans lines, so it runs as a line stage on the
+ * streaming preprocessor. Fenced and inline code state is carried from
+ * line to line.
  */
 
 #ifndef APEX_HIGHLIGHT_H
 #define APEX_HIGHLIGHT_H
 
+#include <stdbool.h>
+#include "../preprocess.h"
+
+/**
+ * Scanner state carried from line to line (caller-owned while the
+ * preprocessor runs; initialize with apex_highlight_state_init)
+ */
+typedef struct {
+    bool in_code_block;
+    bool in_inline_code;
+} apex_highlight_state;
+
+void apex_highlight_state_init(apex_highlight_state *state);
+
+/**
+ * Register the highlight stage on a streaming preprocessor
+ */
+bool apex_highlights_add_stage(apex_preprocessor *pp, apex_highlight_state *state);
+
 /**
  * Process ==highlight== syntax in text
  * Converts ==text== to <mark>text</mark>
@@ -13,4 +36,3 @@
 char *apex_process_highlights(const char *text);
 
 #endif
-
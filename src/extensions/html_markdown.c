@@ -6,12 +6,14 @@
 #include "html_markdown.h"
 #include "ial.h"
 #include "../html_renderer.h"
+#include "../parser_lock.h"
 #include "cmark-gfm.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct {
     char **ids;
@@ -225,20 +227,78 @@ static void collect_defined_reference_ids(const char *text, ref_id_list *list) {
     }
 }
 
-static char *extract_matching_reference_definitions(const char *full_doc, ref_id_list *needed) {
-    if (!full_doc || !needed || needed->count == 0) return NULL;
+/* One "[label]:" line of the document */
+typedef struct {
+    const char *line;
+    size_t line_len;
+    char *key;          /* Normalized label */
+    size_t next;        /* Index + 1 of the next line with the same key, 0 at the end */
+} def_line;
 
-    size_t capacity = 256;
-    size_t len = 0;
-    char *output = malloc(capacity);
-    if (!output) return NULL;
+/**
+ * Reference and footnote definition lines of the whole document, indexed by
+ * label once, plus the parser every markdown="1" block is parsed with. Both
+ * are built by ctx_prepare() when the first block needs them.
+ */
+typedef struct {
+    const char *full_doc;
+    bool prepared;
+    def_line *lines;
+    size_t count;
+    size_t *slots;      /* Open addressing: index + 1 of the first line per key */
+    size_t slot_mask;
+    cmark_parser *parser;
+    int parser_opts;
+} html_markdown_ctx;
+
+/* Lowercased label with surrounding whitespace trimmed and runs collapsed */
+static char *normalize_label(const char *label, size_t len) {
+    char *key = malloc(len + 1);
+    if (!key) return NULL;
+    size_t k = 0;
+    bool pending_space = false;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)label[i];
+        if (isspace(c)) {
+            pending_space = k > 0;
+            continue;
+        }
+        if (pending_space) key[k++] = ' ';
+        pending_space = false;
+        key[k++] = (char)tolower(c);
+    }
+    key[k] = '\0';
+    return key;
+}
+
+static size_t label_hash(const char *key) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const char *p = key; *p; p++) {
+        h ^= (unsigned char)*p;
+        h *= 1099511628211ULL;
+    }
+    return (size_t)h;
+}
 
+/* Index + 1 of the first definition line for key, 0 if none */
+static size_t ctx_lookup(const html_markdown_ctx *ctx, const char *key) {
+    if (!ctx->slots) return 0;
+    size_t slot = label_hash(key) & ctx->slot_mask;
+    while (ctx->slots[slot]) {
+        if (strcmp(ctx->lines[ctx->slots[slot] - 1].key, key) == 0) return ctx->slots[slot];
+        slot = (slot + 1) & ctx->slot_mask;
+    }
+    return 0;
+}
+
+/* Scan full_doc once for definition lines ("[id]: ..." and "[^id]: ...") */
+static void ctx_index_definitions(html_markdown_ctx *ctx, const char *full_doc) {
+    size_t capacity = 0;
     const char *p = full_doc;
     while (*p) {
         const char *line_start = p;
         const char *line_end = strchr(p, '\n');
         if (!line_end) line_end = p + strlen(p);
-        size_t line_len = (size_t)(line_end - line_start);
 
         const char *content_start = line_start;
         while (content_start < line_end && (*content_start == ' ' || *content_start == '\t')) {
@@ -246,65 +306,111 @@ static char *extract_matching_reference_definitions(const char *full_doc, ref_id
         }
 
         if (content_start < line_end && *content_start == '[') {
-            const char *id_end = strchr(content_start + 1, ']');
-            if (id_end && id_end < line_end && id_end[1] == ':') {
-                const char *id_start = content_start + 1;
-                size_t id_len = (size_t)(id_end - id_start);
-                bool needed_line = false;
-                for (size_t i = 0; i < needed->count; i++) {
-                    if (reference_id_matches(needed->ids[i], id_start, id_len)) {
-                        needed_line = true;
-                        break;
-                    }
+            const char *id_end = memchr(content_start + 1, ']', (size_t)(line_end - content_start - 1));
+            if (id_end && id_end + 1 < line_end && id_end[1] == ':' && id_end > content_start + 1) {
+                if (ctx->count >= capacity) {
+                    size_t new_capacity = capacity ? capacity * 2 : 16;
+                    def_line *new_lines = realloc(ctx->lines, new_capacity * sizeof(def_line));
+                    if (!new_lines) break;
+                    ctx->lines = new_lines;
+                    capacity = new_capacity;
                 }
-
-                if (needed_line) {
-                    if (len + line_len + 2 > capacity) {
-                        capacity = (len + line_len + 2) * 2;
-                        char *new_output = realloc(output, capacity);
-                        if (!new_output) {
-                            free(output);
-                            return NULL;
-                        }
-                        output = new_output;
-                    }
-                    if (len > 0) {
-                        output[len++] = '\n';
-                    }
-                    memcpy(output + len, line_start, line_len);
-                    len += line_len;
+                char *key = normalize_label(content_start + 1, (size_t)(id_end - content_start - 1));
+                if (key) {
+                    def_line *line = &ctx->lines[ctx->count++];
+                    line->line = line_start;
+                    line->line_len = (size_t)(line_end - line_start);
+                    line->key = key;
+                    line->next = 0;
                 }
             }
         }
 
         p = (*line_end == '\n') ? line_end + 1 : line_end;
     }
-
-    if (len == 0) {
-        free(output);
-        return NULL;
+    if (ctx->count == 0) return;
+
+    size_t cap = 16;
+    while (cap < ctx->count * 2) cap *= 2;
+    ctx->slots = calloc(cap, sizeof(size_t));
+    if (!ctx->slots) return;
+    ctx->slot_mask = cap - 1;
+
+    /* Link backwards so each chain is in document order */
+    for (size_t i = ctx->count; i-- > 0; ) {
+        size_t slot = label_hash(ctx->lines[i].key) & ctx->slot_mask;
+        while (ctx->slots[slot] && strcmp(ctx->lines[ctx->slots[slot] - 1].key, ctx->lines[i].key) != 0) {
+            slot = (slot + 1) & ctx->slot_mask;
+        }
+        ctx->lines[i].next = ctx->slots[slot];
+        ctx->slots[slot] = i + 1;
     }
+}
 
-    output[len] = '\0';
-    return output;
+/* Index the document and create the parser, once */
+static void ctx_prepare(html_markdown_ctx *ctx) {
+    if (ctx->prepared) return;
+    ctx->prepared = true;
+    ctx->parser = cmark_parser_new(ctx->parser_opts);
+    ctx_index_definitions(ctx, ctx->full_doc);
 }
 
-static bool is_footnote_definition_line(const char *line_start, const char *line_end, const char *footnote_id) {
-    const char *content_start = line_start;
-    while (content_start < line_end && (*content_start == ' ' || *content_start == '\t')) {
-        content_start++;
+static void ctx_free(html_markdown_ctx *ctx) {
+    for (size_t i = 0; i < ctx->count; i++) {
+        free(ctx->lines[i].key);
     }
+    free(ctx->lines);
+    free(ctx->slots);
+    if (ctx->parser) cmark_parser_free(ctx->parser);
+}
 
-    if (content_start >= line_end || *content_start != '[') {
-        return false;
-    }
+static int compare_size(const void *a, const void *b) {
+    size_t x = *(const size_t *)a;
+    size_t y = *(const size_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Every definition line for the needed ids, in document order */
+static char *extract_matching_reference_definitions(const html_markdown_ctx *ctx, ref_id_list *needed) {
+    if (!needed || needed->count == 0 || ctx->count == 0) return NULL;
 
-    const char *id_end = strchr(content_start + 1, ']');
-    if (!id_end || id_end >= line_end || id_end[1] != ':') {
-        return false;
+    size_t found_count = 0, found_capacity = 16;
+    size_t *found = malloc(found_capacity * sizeof(size_t));
+    if (!found) return NULL;
+    for (size_t i = 0; i < needed->count; i++) {
+        char *key = normalize_label(needed->ids[i], strlen(needed->ids[i]));
+        if (!key) continue;
+        for (size_t n = ctx_lookup(ctx, key); n; n = ctx->lines[n - 1].next) {
+            if (found_count >= found_capacity) {
+                found_capacity *= 2;
+                size_t *new_found = realloc(found, found_capacity * sizeof(size_t));
+                if (!new_found) break;
+                found = new_found;
+            }
+            found[found_count++] = n - 1;
+        }
+        free(key);
     }
+    qsort(found, found_count, sizeof(size_t), compare_size);
 
-    return reference_id_matches(footnote_id, content_start + 1, (size_t)(id_end - (content_start + 1)));
+    size_t len = 0;
+    for (size_t i = 0; i < found_count; i++) len += ctx->lines[found[i]].line_len + 1;
+    char *output = len ? malloc(len + 1) : NULL;
+    if (!output) {
+        free(found);
+        return NULL;
+    }
+    len = 0;
+    for (size_t i = 0; i < found_count; i++) {
+        if (i > 0 && found[i] == found[i - 1]) continue;
+        const def_line *line = &ctx->lines[found[i]];
+        if (len > 0) output[len++] = '\n';
+        memcpy(output + len, line->line, line->line_len);
+        len += line->line_len;
+    }
+    output[len] = '\0';
+    free(found);
+    return output;
 }
 
 static bool is_footnote_definition_continuation(const char *line_start, size_t line_len) {
@@ -318,73 +424,32 @@ static bool is_footnote_definition_continuation(const char *line_start, size_t l
            line_start[2] == ' ' && line_start[3] == ' ';
 }
 
-static char *extract_footnote_definition_block(const char *full_doc, const char *footnote_id) {
-    if (!full_doc || !footnote_id) return NULL;
-
-    const char *p = full_doc;
-    while (*p) {
-        const char *line_start = p;
-        const char *line_end = strchr(p, '\n');
-        if (!line_end) line_end = p + strlen(p);
-        size_t line_len = (size_t)(line_end - line_start);
-
-        if (is_footnote_definition_line(line_start, line_end, footnote_id)) {
-            size_t capacity = line_len + 64;
-            size_t len = 0;
-            char *output = malloc(capacity);
-            if (!output) return NULL;
-
-            if (len + line_len + 2 > capacity) {
-                capacity = line_len + 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-            }
-            memcpy(output + len, line_start, line_len);
-            len += line_len;
-
-            p = (*line_end == '\n') ? line_end + 1 : line_end;
-            while (*p) {
-                line_start = p;
-                line_end = strchr(p, '\n');
-                if (!line_end) line_end = p + strlen(p);
-                line_len = (size_t)(line_end - line_start);
-
-                if (!is_footnote_definition_continuation(line_start, line_len)) {
-                    break;
-                }
-
-                if (len + line_len + 2 > capacity) {
-                    capacity = (len + line_len + 2) * 2;
-                    char *new_output = realloc(output, capacity);
-                    if (!new_output) {
-                        free(output);
-                        return NULL;
-                    }
-                    output = new_output;
-                }
-                output[len++] = '\n';
-                memcpy(output + len, line_start, line_len);
-                len += line_len;
-
-                p = (*line_end == '\n') ? line_end + 1 : line_end;
-            }
-
-            output[len] = '\0';
-            return output;
+/* First footnote definition for id, with its continuation lines; sets block_len */
+static const char *find_footnote_definition_block(const html_markdown_ctx *ctx, const char *footnote_id,
+                                                  size_t *block_len) {
+    char *key = normalize_label(footnote_id, strlen(footnote_id));
+    if (!key) return NULL;
+    size_t n = ctx_lookup(ctx, key);
+    free(key);
+    if (!n) return NULL;
+
+    const def_line *line = &ctx->lines[n - 1];
+    const char *end = line->line + line->line_len;
+    while (*end == '\n') {
+        const char *next_start = end + 1;
+        const char *next_end = strchr(next_start, '\n');
+        if (!next_end) next_end = next_start + strlen(next_start);
+        if (!*next_start || !is_footnote_definition_continuation(next_start, (size_t)(next_end - next_start))) {
+            break;
         }
-
-        p = (*line_end == '\n') ? line_end + 1 : line_end;
+        end = next_end;
     }
-
-    return NULL;
+    *block_len = (size_t)(end - line->line);
+    return line->line;
 }
 
-static char *extract_matching_footnote_definitions(const char *full_doc, ref_id_list *needed) {
-    if (!full_doc || !needed || needed->count == 0) return NULL;
+static char *extract_matching_footnote_definitions(const html_markdown_ctx *ctx, ref_id_list *needed) {
+    if (!needed || needed->count == 0 || ctx->count == 0) return NULL;
 
     size_t capacity = 256;
     size_t len = 0;
@@ -396,38 +461,24 @@ static char *extract_matching_footnote_definitions(const char *full_doc, ref_id_
             continue;
         }
 
-        char *block = extract_footnote_definition_block(full_doc, needed->ids[i]);
+        size_t block_len = 0;
+        const char *block = find_footnote_definition_block(ctx, needed->ids[i], &block_len);
         if (!block) continue;
 
-        size_t block_len = strlen(block);
-        if (len > 0) {
-            if (len + 1 >= capacity) {
-                capacity = (len + block_len + 2) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(block);
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-            }
-            output[len++] = '\n';
-        }
-
         if (len + block_len + 2 > capacity) {
             capacity = (len + block_len + 2) * 2;
             char *new_output = realloc(output, capacity);
             if (!new_output) {
-                free(block);
                 free(output);
                 return NULL;
             }
             output = new_output;
         }
-
+        if (len > 0) {
+            output[len++] = '\n';
+        }
         memcpy(output + len, block, block_len);
         len += block_len;
-        free(block);
     }
 
     if (len == 0) {
@@ -467,8 +518,8 @@ static ref_id_list filter_needed_ids(ref_id_list *used, ref_id_list *defined_in_
  * used in content but not already defined within content.
  * Caller must free the returned string.
  */
-static char *prepend_needed_definitions(const char *full_doc, const char *content) {
-    if (!full_doc || !content || strcmp(full_doc, content) == 0) {
+static char *prepend_needed_definitions(const html_markdown_ctx *ctx, const char *content) {
+    if (!content) {
         return NULL;
     }
 
@@ -489,9 +540,9 @@ static char *prepend_needed_definitions(const char *full_doc, const char *conten
     ref_id_list_free(&defined_in_content);
 
     char *link_defs = needed_links.count > 0 ?
-        extract_matching_reference_definitions(full_doc, &needed_links) : NULL;
+        extract_matching_reference_definitions(ctx, &needed_links) : NULL;
     char *footnote_defs = needed_footnotes.count > 0 ?
-        extract_matching_footnote_definitions(full_doc, &needed_footnotes) : NULL;
+        extract_matching_footnote_definitions(ctx, &needed_footnotes) : NULL;
 
     ref_id_list_free(&needed_links);
     ref_id_list_free(&needed_footnotes);
@@ -670,11 +721,11 @@ static const char *find_closing_tag(const char *text, const char *tag_name) {
 /**
  * Process HTML tags with markdown attributes
  * If img_attrs is non-NULL, image attributes (e.g. width/height from ref defs) are applied to images in markdown="1" regions.
- * full_doc is the original document used to resolve reference-style link definitions.
+ * ctx indexes the definitions of the original document, used to resolve
+ * reference-style links and footnotes, and holds the shared parser.
  */
-static char *apex_process_html_markdown_impl(const char *text, void *img_attrs, const char *full_doc) {
+static char *apex_process_html_markdown_impl(const char *text, void *img_attrs, html_markdown_ctx *ctx) {
     if (!text) return NULL;
-    if (!full_doc) full_doc = text;
 
     image_attr_entry *attrs = (image_attr_entry *)img_attrs;
 
@@ -782,27 +833,28 @@ static char *apex_process_html_markdown_impl(const char *text, void *img_attrs,
 
                 /* Recursively process nested divs with markdown="1" BEFORE parsing */
                 /* This ensures nested divs are processed before cmark-gfm sees them */
-                char *processed_content = apex_process_html_markdown_impl(content, img_attrs, full_doc);
+                char *processed_content = apex_process_html_markdown_impl(content, img_attrs, ctx);
                 if (processed_content) {
                     free(content);
                     content = processed_content;
                     content_len = strlen(content);
                 }
 
-                char *content_with_refs = prepend_needed_definitions(full_doc, content);
+                ctx_prepare(ctx);
+                char *content_with_refs = prepend_needed_definitions(ctx, content);
                 if (content_with_refs) {
                     free(content);
                     content = content_with_refs;
                     content_len = strlen(content);
                 }
 
-                /* Create parser and parse */
-                /* Use CMARK_OPT_UNSAFE to allow raw HTML (including nested divs) */
-                int cmark_opts = CMARK_OPT_DEFAULT | CMARK_OPT_UNSAFE | CMARK_OPT_FOOTNOTES;
-                cmark_parser *parser = cmark_parser_new(cmark_opts);
+                /* Parse with the shared parser; finishing a parse resets it for the next block.
+                 * Nested blocks were handled above, so it is never in use twice. */
+                int cmark_opts = ctx->parser_opts;
+                cmark_parser *parser = ctx->parser;
                 if (parser) {
                     cmark_parser_feed(parser, content, content_len);
-                    cmark_node *doc = cmark_parser_finish(parser);
+                    cmark_node *doc = apex_parser_finish(parser);
 
                     if (doc) {
                         apex_process_ial_in_tree(doc, NULL);
@@ -911,7 +963,6 @@ static char *apex_process_html_markdown_impl(const char *text, void *img_attrs,
                         }
                         cmark_node_free(doc);
                     }
-                    cmark_parser_free(parser);
                 }
                 free(content);
             }
@@ -956,6 +1007,15 @@ static char *apex_process_html_markdown_impl(const char *text, void *img_attrs,
 }
 
 char *apex_process_html_markdown(const char *text, void *img_attrs) {
-    return apex_process_html_markdown_impl(text, img_attrs, text);
+    if (!text) return NULL;
+
+    html_markdown_ctx ctx = {0};
+    ctx.full_doc = text;
+    /* Use CMARK_OPT_UNSAFE to allow raw HTML (including nested divs) */
+    ctx.parser_opts = CMARK_OPT_DEFAULT | CMARK_OPT_UNSAFE | CMARK_OPT_FOOTNOTES;
+
+    char *result = apex_process_html_markdown_impl(text, img_attrs, &ctx);
+    ctx_free(&ctx);
+    return result;
 }
 
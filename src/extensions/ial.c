@@ -4,6 +4,7 @@
 
 #include "ial.h"
 #include "bear_image_attrs.h"
+#include "../attr_pool.h"
 #include "table.h"  /* For CMARK_NODE_TABLE */
 #include "apex/apex.h"  /* For apex_mode_t */
 #include <string.h>
@@ -730,7 +731,7 @@ static bool extract_ial_from_text(const char *text, apex_attributes **attrs_out,
  * Apply attributes to HTML tag
  * Helper function to generate attribute string
  */
-char *attributes_to_html(apex_attributes *attrs) {
+char *attributes_to_html(const apex_attributes *attrs) {
     if (!attrs) return strdup("");
 
     char buffer[4096];
@@ -805,7 +806,7 @@ char *attributes_to_html(apex_attributes *attrs) {
             continue;
         }
 
-        if (strcmp(key, "width") == 0 || strcmp(key, "height") == 0) {
+        if ((strcmp(key, "width") == 0 || strcmp(key, "height") == 0) && val) {
             size_t val_len = strlen(val);
             bool is_px = (val_len >= 2 && val[val_len - 2] == 'p' && val[val_len - 1] == 'x');
             bool is_percent = (val_len >= 1 && val[val_len - 1] == '%');
@@ -913,13 +914,16 @@ char *attributes_to_html(apex_attributes *attrs) {
             continue;
         }
 
+        /* Bare attributes (no value) are written bare; a value holding a
+         * double quote is single-quoted */
         char attr_str[1024];
-        if (first_attr) {
-            snprintf(attr_str, sizeof(attr_str), "%s=\"%s\"", key, val);
-            first_attr = false;
+        char quote = val && strchr(val, '"') ? '\'' : '"';
+        if (!val) {
+            snprintf(attr_str, sizeof(attr_str), "%s%s", first_attr ? "" : " ", key);
         } else {
-            snprintf(attr_str, sizeof(attr_str), " %s=\"%s\"", key, val);
+            snprintf(attr_str, sizeof(attr_str), "%s%s=%c%s%c", first_attr ? "" : " ", key, quote, val, quote);
         }
+        first_attr = false;
         APPEND(attr_str);
     }
 
@@ -1211,9 +1215,7 @@ static bool process_span_ial_in_container(cmark_node *container, ald_entry *alds
             bool has_preceding_content = (cmark_node_previous(child) != NULL) || (ial_start > text);
             if (container_type == CMARK_NODE_PARAGRAPH && has_preceding_content) {
                 /* IAL was at end of text - apply to paragraph (e.g. "Text\n{: .lead }" on one block) */
-                char *attr_str = attributes_to_html(attrs);
-                cmark_node_set_user_data(container, attr_str);
-                apex_free_attributes(attrs);
+                apex_node_set_attributes(container, attrs);
 
                 /* Remove the IAL from the text node */
                 size_t prefix_len = ial_start - text;
@@ -1283,13 +1285,13 @@ static bool process_span_ial_in_container(cmark_node *container, ald_entry *alds
         }
 
         /* Apply attributes to the target inline element */
-        char *attr_str = attributes_to_html(attrs);
-        cmark_node_set_user_data(target, attr_str);
         if (getenv("APEX_DEBUG_PIPELINE") && cmark_node_get_type(target) == CMARK_NODE_LINK) {
+            char *attr_str = attributes_to_html(attrs);
             fprintf(stderr, "[APEX_DEBUG] IAL applied to link (attrs: %.80s%s)\n",
                     attr_str ? attr_str : "(null)", attr_str && strlen(attr_str) > 80 ? "..." : "");
+            free(attr_str);
         }
-        apex_free_attributes(attrs);
+        apex_node_set_attributes(target, attrs);
 
         /* Remove the IAL from the text node, preserving any text before/after it */
         size_t prefix_len;
@@ -1536,27 +1538,8 @@ static cmark_node *process_node_ial(cmark_node *node, ald_entry *alds) {
         apex_attributes *attrs = NULL;
         bool extracted = extract_ial_from_heading(node, &attrs, alds);
         if (extracted) {
-            /* Store attributes in heading */
-            char *attr_str = attributes_to_html(attrs);
-
-            /* Merge with existing user_data if present */
-            char *existing = (char *)cmark_node_get_user_data(node);
-            if (existing) {
-                /* Append to existing */
-                char *combined = malloc(strlen(existing) + strlen(attr_str) + 1);
-                if (combined) {
-                    strcpy(combined, existing);
-                    strcat(combined, attr_str);
-                    cmark_node_set_user_data(node, combined);
-                    free(attr_str);
-                } else {
-                    cmark_node_set_user_data(node, attr_str);
-                }
-            } else {
-                cmark_node_set_user_data(node, attr_str);
-            }
-
-            apex_free_attributes(attrs);
+            /* Store attributes in heading, merged with any it already has */
+            apex_node_add_attributes(node, attrs);
             return NULL;  /* No node to free */
         }
         /* If no inline IAL, fall through to check for next-line IAL */
@@ -1606,9 +1589,7 @@ static cmark_node *process_node_ial(cmark_node *node, ald_entry *alds) {
         apex_attributes *attrs = NULL;
         if (extract_ial_from_paragraph(next, &attrs, alds)) {
             /* Store attributes in this node */
-            char *attr_str = attributes_to_html(attrs);
-            cmark_node_set_user_data(node, attr_str);
-            apex_free_attributes(attrs);
+            apex_node_set_attributes(node, attrs);
 
             /* Return node to be unlinked and freed after iteration completes */
             /* Don't unlink here - that invalidates the iterator */
@@ -4514,7 +4495,11 @@ void apex_apply_image_attributes(cmark_node *document, image_attr_entry *img_att
             if (matching && matching->attrs) {
                 char *attr_str = attributes_to_html_for_image(url, matching->attrs);
                 if (attr_str) {
-                    char *existing = (char *)cmark_node_get_user_data(node);
+                    /* The media markers are read back from the attribute
+                     * string, so a span IAL already on the image joins it */
+                    apex_attributes *ial = apex_node_take_attributes(node);
+                    char *existing = ial ? attributes_to_html(ial) : (char *)cmark_node_get_user_data(node);
+                    apex_free_attributes(ial);
                     if (existing) {
                         char *combined = malloc(strlen(existing) + strlen(attr_str) + 2);
                         if (combined) {
@@ -4526,6 +4511,7 @@ void apex_apply_image_attributes(cmark_node *document, image_attr_entry *img_att
                         } else {
                             cmark_node_set_user_data(node, attr_str);
                         }
+                        free(existing);
                     } else {
                         cmark_node_set_user_data(node, attr_str);
                     }
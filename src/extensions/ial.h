@@ -93,7 +93,7 @@ apex_attributes *parse_ial_content(const char *content, int len);
  * Returns a newly allocated string with HTML attributes (e.g., ' id="foo" class="bar"')
  * Caller must free the returned string
  */
-char *attributes_to_html(apex_attributes *attrs);
+char *attributes_to_html(const apex_attributes *attrs);
 
 /**
  * Image attribute entry (stored in document order for matching)
@@ -6,6 +6,7 @@
 #include "includes.h"
 #include "metadata.h"
 #include "../plugins.h"
+#include "../render_cache.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,6 +23,7 @@
  * Read file contents
  */
 static char *read_file_contents(const char *filepath) {
+    apex_render_cache_note_file(filepath);
     FILE *fp = fopen(filepath, "rb");
     if (!fp) return NULL;
 
@@ -116,6 +118,7 @@ static char *get_directory(const char *filepath) {
  */
 bool apex_file_exists(const char *filepath) {
     if (!filepath) return false;
+    apex_render_cache_note_exists(filepath);
     struct stat st;
     return (stat(filepath, &st) == 0);
 }
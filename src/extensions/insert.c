@@ -11,68 +11,100 @@
 #include <stdbool.h>
 #include <ctype.h>
 
+/* Byte at p, or '\0' past the end of the line */
+#define AT(p) ((p) < end ? *(p) : '\0')
+
 /**
- * Find IAL pattern after text
+ * Find IAL pattern after text. The "{" must be on the same line; the
+ * closing "}" may be anywhere before end.
  * Returns pointer to IAL start, or NULL if not found
- * Sets ial_end to end of IAL pattern
+ * Sets ial_end to end of IAL pattern, or NULL if the IAL isn't closed yet
  */
-static const char *find_ial_after(const char *text, const char **ial_end) {
+static const char *find_ial_after(const char *text, const char *end, const char **ial_end) {
     const char *p = text;
 
     /* Skip whitespace */
-    while (*p && (*p == ' ' || *p == '\t')) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
         p++;
     }
 
     /* Check for IAL pattern { ... } */
-    if (*p == '{') {
+    if (p < end && *p == '{') {
         const char *start = p;
         p++;
 
         /* Find closing } */
-        const char *close = strchr(p, '}');
-        if (close) {
-            *ial_end = close + 1;
-            return start;
-        }
+        const char *close = memchr(p, '}', (size_t)(end - p));
+        *ial_end = close ? close + 1 : NULL;
+        return start;
     }
 
     return NULL;
 }
 
+/** True if the line contains "++" */
+static bool has_double_plus(const char *p, const char *end) {
+    while (p + 1 < end) {
+        const char *hit = memchr(p, '+', (size_t)(end - p - 1));
+        if (!hit) return false;
+        if (hit[1] == '+') return true;
+        p = hit + 1;
+    }
+    return false;
+}
+
+void apex_insert_state_init(apex_insert_state *state) {
+    if (!state) return;
+    state->in_code_block = false;
+    state->in_inline_code = false;
+    state->ial_open = false;
+    state->ial_content_len = 0;
+    state->ial_offset = 0;
+}
+
 /**
- * Process ++insert++ syntax as preprocessing
- * Converts to <ins>text</ins> before parsing
- * If followed by IAL, converts to <ins markdown="span" ...>text</ins>
+ * Emit <ins markdown="span" ...> for an IAL, or return false if the IAL
+ * has no usable attributes
  */
-char *apex_process_inserts(const char *text) {
-    if (!text) return NULL;
+static bool emit_ins_with_ial(const char *ial_start, const char *ial_end, apex_pp_sink *out) {
+    size_t ial_len = (size_t)((ial_end - 1) - (ial_start + 1));  /* Content inside {} */
+    apex_attributes *attrs = parse_ial_content(ial_start + 1, (int)ial_len);
+    if (!attrs) return false;
 
-    size_t len = strlen(text);
-    size_t capacity = len * 2;  /* Room for <ins> tags */
-    char *output = malloc(capacity);
-    if (!output) return NULL;
+    char *attr_str = attributes_to_html(attrs);
+    apex_free_attributes(attrs);
+    if (!attr_str) return false;
 
-    const char *read = text;
-    char *write = output;
-    size_t remaining = capacity;
+    apex_pp_emit(out, "<ins markdown=\"span\"", 20);
+    apex_pp_emit(out, attr_str, strlen(attr_str));
+    apex_pp_emit(out, ">", 1);
+    free(attr_str);
+    return true;
+}
 
-    bool in_code_block = false;
-    bool in_inline_code = false;
+/**
+ * Convert ++insert++ to <ins>insert</ins> in text, outside fenced and
+ * inline code. With more set, an insert whose IAL is still open at the
+ * end of text is claimed until a later line closes it.
+ */
+static void inserts_scan(apex_insert_state *st, const char *line, size_t len, apex_pp_sink *out, bool more) {
+    const char *end = line + len;
+    const char *read = line;
+    const char *copy_from = line;
 
-    while (*read) {
+    while (read < end) {
         /* Track code blocks (skip processing inside them) */
         if (*read == '`') {
-            if (read[1] == '`' && read[2] == '`') {
-                in_code_block = !in_code_block;
-            } else if (!in_code_block) {
-                in_inline_code = !in_inline_code;
+            if (AT(read + 1) == '`' && AT(read + 2) == '`') {
+                st->in_code_block = !st->in_code_block;
+            } else if (!st->in_code_block) {
+                st->in_inline_code = !st->in_inline_code;
             }
         }
 
         /* Look for ++insert++ (not in code, not Critic Markup) */
         /* Skip if preceded by { (Critic Markup) */
-        bool is_critic = (read > text && read[-1] == '{');
+        bool is_critic = (read > line && read[-1] == '{');
 
         /* Check opening ++ requirements:
          * - Exactly 2 + characters: read[0] == '+' && read[1] == '+'
@@ -80,28 +112,26 @@ char *apex_process_inserts(const char *text) {
          * - Character after ++ is not + or }
          * - Character after ++ is not whitespace or newline
          */
-        bool preceded_by_plus = (read > text && read[-1] == '+');
-        bool preceded_by_brace = (read > text && read[-1] == '{');
-        bool followed_by_plus = (read[2] == '+');
-        bool followed_by_brace = (read[2] == '}');
-        bool is_valid_insert_start = (read[0] == '+' && read[1] == '+' &&
-                                     read[2] != '+' && !followed_by_brace &&
-                                     read[2] != '\0' && read[2] != '\n' &&
-                                     read[2] != '\r' && read[2] != ' ' && read[2] != '\t' &&
-                                     !preceded_by_plus && !preceded_by_brace && !followed_by_plus);
-
-        if (!in_code_block && !in_inline_code && !is_critic && is_valid_insert_start) {
+        char after = AT(read + 2);
+        bool preceded_by_plus = (read > line && read[-1] == '+');
+        bool is_valid_insert_start = (read[0] == '+' && AT(read + 1) == '+' &&
+                                      after != '+' && after != '}' &&
+                                      after != '\0' && after != '\n' &&
+                                      after != '\r' && after != ' ' && after != '\t' &&
+                                      !preceded_by_plus);
+
+        if (!st->in_code_block && !st->in_inline_code && !is_critic && is_valid_insert_start) {
 
             /* Find closing ++ */
             const char *close = read + 2;
-            while (*close && *close != '\n' && *close != '\r') {
-                if (close[0] == '+' && close[1] == '+') {
+            while (close < end && *close != '\n' && *close != '\r') {
+                if (close[0] == '+' && AT(close + 1) == '+') {
                     /* Check closing ++ requirements:
                      * - Character after closing ++ is not +
                      * - Character before closing ++ is not space
                      * - Character immediately before or after closing ++ is not +
                      */
-                    bool closing_followed_by_plus = (close[2] == '+');
+                    bool closing_followed_by_plus = (AT(close + 2) == '+');
                     bool closing_preceded_by_space = (close > read + 2 && (close[-1] == ' ' || close[-1] == '\t'));
                     bool closing_preceded_by_plus = (close > read + 2 && close[-1] == '+');
 
@@ -113,136 +143,144 @@ char *apex_process_inserts(const char *text) {
                 close++;
             }
 
-            if (*close && close[0] == '+' && close[1] == '+' && close[2] != '+') {
-                /* Found complete ++insert++ */
-                size_t content_len = close - (read + 2);
-
-                /* Ensure there's actual content (not just ++ on a line by itself) */
-                if (content_len > 0) {
-                    const char *after_close = close + 2;
-                    const char *ial_end = NULL;
-                    const char *ial_start = find_ial_after(after_close, &ial_end);
-
-                    if (ial_start) {
-                        /* Has IAL - convert to <ins markdown="span" ...>text</ins> */
-                        size_t ial_len = (ial_end - 1) - (ial_start + 1);  /* Content inside {} */
-
-                        /* Parse IAL attributes */
-                        apex_attributes *attrs = parse_ial_content(ial_start + 1, (int)ial_len);
-
-                        if (attrs) {
-                            /* Build ins tag with attributes */
-                            char *attr_str = attributes_to_html(attrs);
-                            if (attr_str) {
-                                /* Calculate space needed */
-                                size_t ins_open_len = 30 + strlen(attr_str) + content_len + 20;
-                                if (remaining < ins_open_len) {
-                                    size_t written = write - output;
-                                    capacity = (written + ins_open_len + 1) * 2;
-                                    char *new_output = realloc(output, capacity);
-                                    if (!new_output) {
-                                        free(attr_str);
-                                        apex_free_attributes(attrs);
-                                        goto cleanup;
-                                    }
-                                    output = new_output;
-                                    write = output + written;
-                                    remaining = capacity - written;
-                                }
-
-                                /* Write <ins markdown="span" ...> */
-                                int written = snprintf(write, remaining, "<ins markdown=\"span\"%s>", attr_str);
-                                if (written > 0) {
-                                    if ((size_t)written >= remaining) {
-                                        /* String was truncated - need more space */
-                                        size_t current_written = write - output;
-                                        capacity = (current_written + written + 1) * 2;
-                                        char *new_output = realloc(output, capacity);
-                                        if (!new_output) {
-                                            free(attr_str);
-                                            apex_free_attributes(attrs);
-                                            goto cleanup;
-                                        }
-                                        output = new_output;
-                                        write = output + current_written;
-                                        remaining = capacity - current_written;
-                                        /* Retry with more space */
-                                        written = snprintf(write, remaining, "<ins markdown=\"span\"%s>", attr_str);
-                                    }
-                                    if (written > 0 && (size_t)written < remaining) {
-                                        write += written;
-                                        remaining -= written;
-                                    }
-                                }
-
-                                /* Write the content */
-                                if (content_len < remaining) {
-                                    memcpy(write, read + 2, content_len);
-                                    write += content_len;
-                                    remaining -= content_len;
-                                }
-
-                                /* Write </ins> */
-                                const char *close_tag = "</ins>";
-                                size_t tag_len = strlen(close_tag);
-                                if (tag_len < remaining) {
-                                    memcpy(write, close_tag, tag_len);
-                                    write += tag_len;
-                                    remaining -= tag_len;
-                                }
-
-                                /* Skip past the closing ++ and IAL */
-                                read = ial_end;
-                                free(attr_str);
-                                apex_free_attributes(attrs);
-                                continue;
-                            }
-                            apex_free_attributes(attrs);
-                        }
-                    }
+            /* Found complete ++insert++ with actual content */
+            if (close < end && close[0] == '+' && AT(close + 1) == '+' && AT(close + 2) != '+' &&
+                close > read + 2) {
+                const char *after_close = close + 2;
+                const char *ial_end = NULL;
+                const char *ial_start = find_ial_after(after_close, end, &ial_end);
 
-                    /* No IAL - write simple <ins>text</ins> */
-                    const char *open_tag = "<ins>";
-                    size_t tag_len = strlen(open_tag);
-                    if (tag_len < remaining) {
-                        memcpy(write, open_tag, tag_len);
-                        write += tag_len;
-                        remaining -= tag_len;
-                    }
+                const char *content = read + 2;
+                apex_pp_emit(out, copy_from, (size_t)(read - copy_from));
+                if (ial_start && !ial_end && more) {
+                    /* The IAL continues on a later line: hold the insert */
+                    st->ial_open = true;
+                    st->ial_content_len = (size_t)(close - content);
+                    st->ial_offset = (size_t)(ial_start - read);
+                    apex_pp_claim(out, read, (size_t)(end - read));
+                    return;
+                }
+                if (ial_start && ial_end && emit_ins_with_ial(ial_start, ial_end, out)) {
+                    /* Has IAL - <ins markdown="span" ...>text</ins>; the IAL is consumed */
+                    read = ial_end;
+                } else {
+                    apex_pp_emit(out, "<ins>", 5);
+                    read = after_close;
+                }
+                apex_pp_emit(out, content, (size_t)(close - content));
+                apex_pp_emit(out, "</ins>", 6);
+                copy_from = read;
+                continue;
+            }
+        }
 
-                    /* Copy inserted content */
-                    if (content_len < remaining) {
-                        memcpy(write, read + 2, content_len);
-                        write += content_len;
-                        remaining -= content_len;
-                    }
+        read++;
+    }
 
-                    /* Write </ins> */
-                    const char *close_tag = "</ins>";
-                    tag_len = strlen(close_tag);
-                    if (tag_len < remaining) {
-                        memcpy(write, close_tag, tag_len);
-                        write += tag_len;
-                        remaining -= tag_len;
-                    }
+    apex_pp_emit(out, copy_from, (size_t)(end - copy_from));
+}
 
-                    /* Skip past the closing ++ */
-                    read = close + 2;
-                    continue;
-                }
-            }
+/**
+ * Write out the held insert, then scan rest. When the IAL closed (the
+ * claim ends with its "}") and parses, the insert gets its attributes;
+ * otherwise it is a plain <ins> and the text after it is scanned again,
+ * as when the IAL is missing.
+ */
+static void inserts_flush_ial(apex_insert_state *st, apex_pp_sink *out, bool closed,
+                              const char *rest, size_t rest_len, bool more) {
+    size_t held_len = 0;
+    const char *claimed = apex_pp_claimed(out, &held_len);
+    char *held = claimed ? strndup(claimed, held_len) : NULL;
+    size_t content_len = st->ial_content_len;
+    size_t ial_offset = st->ial_offset;
+    st->ial_open = false;
+    apex_pp_release(out, "", 0);
+    if (!held) {
+        inserts_scan(st, rest, rest_len, out, more);
+        return;
+    }
+
+    const char *content = held + 2;
+    if (closed && emit_ins_with_ial(held + ial_offset, held + held_len, out)) {
+        apex_pp_emit(out, content, content_len);
+        apex_pp_emit(out, "</ins>", 6);
+        inserts_scan(st, rest, rest_len, out, more);
+    } else {
+        apex_pp_emit(out, "<ins>", 5);
+        apex_pp_emit(out, content, content_len);
+        apex_pp_emit(out, "</ins>", 6);
+
+        /* Scan what followed the insert together with rest */
+        size_t after = 2 + content_len + 2;
+        size_t tail_len = held_len - after;
+        char *tail = malloc(tail_len + rest_len + 1);
+        if (tail) {
+            memcpy(tail, held + after, tail_len);
+            memcpy(tail + tail_len, rest, rest_len);
+            tail[tail_len + rest_len] = '\0';
+            inserts_scan(st, tail, tail_len + rest_len, out, more);
+            free(tail);
         }
+    }
+    free(held);
+}
 
-        /* Copy character */
-        if (remaining > 0) {
-            *write++ = *read++;
-            remaining--;
-        } else {
-            read++;
+/**
+ * Line stage: convert ++insert++ to <ins>insert</ins>, outside fenced and
+ * inline code
+ */
+static apex_pp_result inserts_line(void *state, const char *line, size_t len, apex_pp_sink *out) {
+    apex_insert_state *st = (apex_insert_state *)state;
+
+    /* An insert whose IAL opened on an earlier line: hold lines until its "}" */
+    if (st->ial_open) {
+        const char *close = memchr(line, '}', len);
+        if (!close) {
+            apex_pp_claim(out, line, len);
+            return APEX_PP_HANDLED;
         }
+        size_t upto = (size_t)(close + 1 - line);
+        apex_pp_claim(out, line, upto);
+        inserts_flush_ial(st, out, true, line + upto, len - upto, true);
+        return APEX_PP_HANDLED;
     }
 
-cleanup:
-    *write = '\0';
-    return output;
+    /* Nothing to convert and no code state to update */
+    if (!memchr(line, '`', len) && !has_double_plus(line, line + len)) {
+        return APEX_PP_PASS;
+    }
+
+    inserts_scan(st, line, len, out, true);
+    return APEX_PP_HANDLED;
+}
+
+/* End of input: an IAL that never closed isn't an IAL */
+static void inserts_finish(void *state, apex_pp_sink *out) {
+    apex_insert_state *st = (apex_insert_state *)state;
+    if (st->ial_open) inserts_flush_ial(st, out, false, "", 0, false);
+}
+
+bool apex_inserts_add_stage(apex_preprocessor *pp, apex_insert_state *state) {
+    return apex_preprocessor_add_stage(pp, "inserts", inserts_line, inserts_finish, state);
+}
+
+/**
+ * Process ++insert++ syntax as preprocessing
+ * Converts to <ins>text</ins> before parsing
+ * If followed by IAL, converts to <ins markdown="span" ...>text</ins>
+ */
+char *apex_process_inserts(const char *text) {
+    if (!text) return NULL;
+
+    apex_preprocessor *pp = apex_preprocessor_new();
+    if (!pp) return NULL;
+
+    apex_insert_state state;
+    apex_insert_state_init(&state);
+    char *result = NULL;
+    if (apex_inserts_add_stage(pp, &state)) {
+        result = apex_preprocessor_run(pp, text, strlen(text));
+    }
+    apex_preprocessor_free(pp);
+    return result;
 }
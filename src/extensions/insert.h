@@ -2,11 +2,38 @@
  * Insert Extension
  * Handles ++text++ syntax (converts to <ins>text</ins>)
  * Supports IAL attributes: ++text++{: .class} → <ins markdown="span" class="class">text</ins>
+ *
+ * Runs as a line stage on the streaming preprocessor. Fenced and inline
+ * code state is carried from line to line, and an insert whose IAL is
+ * closed on a later line is held back until its "}" arrives.
  */
 
 #ifndef APEX_INSERT_H
 #define APEX_INSERT_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include "../preprocess.h"
+
+/**
+ * Scanner state carried from line to line (caller-owned while the
+ * preprocessor runs; initialize with apex_insert_state_init)
+ */
+typedef struct {
+    bool in_code_block;
+    bool in_inline_code;
+    bool ial_open;            /* An insert is held until its IAL's "}" */
+    size_t ial_content_len;   /* Length of the held insert's text */
+    size_t ial_offset;        /* Offset of the IAL's "{" in the held text */
+} apex_insert_state;
+
+void apex_insert_state_init(apex_insert_state *state);
+
+/**
+ * Register the insert stage on a streaming preprocessor
+ */
+bool apex_inserts_add_stage(apex_preprocessor *pp, apex_insert_state *state);
+
 /**
  * Process ++insert++ syntax in text
  * Converts ++text++ to <ins>text</ins>
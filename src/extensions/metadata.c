@@ -11,8 +11,10 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <time.h>
 #include <regex.h>
+#include <pthread.h>
 
 #ifdef APEX_HAVE_LIBYAML
 #include <yaml.h>
@@ -47,10 +49,13 @@ typedef struct {
     size_t capacity;
 } apex_string_array;
 
+static void metadata_index_release(const apex_metadata_item *head);
+
 /**
  * Free metadata items list
  */
 void apex_free_metadata(apex_metadata_item *metadata) {
+    metadata_index_release(metadata);
     while (metadata) {
         apex_metadata_item *next = metadata->next;
         free(metadata->key);
@@ -79,6 +84,8 @@ static char *trim_whitespace(char *str) {
     return str;
 }
 
+static void metadata_index_build(apex_metadata_item *list);
+
 /**
  * Add a metadata item to the list
  */
@@ -777,6 +784,7 @@ apex_metadata_item *apex_extract_metadata_for_mode(char **text_ptr, apex_mode_t
         *text_ptr = text + consumed;
     }
 
+    metadata_index_build(items);
     return items;
 }
 
@@ -807,75 +815,221 @@ apex_metadata_item *apex_get_metadata(cmark_node *document) {
 /**
  * Normalize metadata key by removing spaces and converting to lowercase
  * This matches MultiMarkdown's behavior where "HTML Header Level" becomes "htmlheaderlevel"
+ * Writes at most out_size - 1 characters; returns the full normalized length
  */
-static char *normalize_metadata_key(const char *key) {
-    if (!key) return NULL;
-
-    size_t len = strlen(key);
-    char *normalized = malloc(len + 1);
-    if (!normalized) return NULL;
-
-    char *out = normalized;
+static size_t normalize_metadata_key(const char *key, char *out, size_t out_size) {
+    size_t len = 0;
     for (const char *in = key; *in; in++) {
         if (!isspace((unsigned char)*in)) {
-            *out++ = (char)tolower((unsigned char)*in);
+            if (len + 1 < out_size) out[len] = (char)tolower((unsigned char)*in);
+            len++;
         }
     }
-    *out = '\0';
-    return normalized;
+    if (out_size) out[len < out_size ? len : out_size - 1] = '\0';
+    return len;
+}
+
+/* Whether key normalizes to normalized */
+static bool metadata_key_matches_normalized(const char *key, const char *normalized) {
+    for (const char *in = key; *in; in++) {
+        if (isspace((unsigned char)*in)) continue;
+        if (*normalized++ != (char)tolower((unsigned char)*in)) return false;
+    }
+    return *normalized == '\0';
+}
+
+static uint32_t metadata_key_hash(const char *normalized) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)normalized; *p; p++) {
+        h = (h ^ *p) * 16777619u;
+    }
+    return h;
 }
 
+/* One entry per keyed item, in list order */
+typedef struct {
+    const char *normalized;
+    apex_metadata_item *item;
+    int next_same;          /* Next entry with the same normalized key, or -1 */
+} metadata_index_entry;
+
 /**
- * Get a specific metadata value (case-insensitive, spaces ignored)
- * Matches MultiMarkdown behavior where "HTML Header Level" matches "htmlheaderlevel"
+ * Open-addressing table from normalized key to the first entry with that
+ * key. Entries, slots and normalized keys share the index's allocation.
  */
-const char *apex_metadata_get(apex_metadata_item *metadata, const char *key) {
-    if (!key || !metadata) return NULL;
-
-    /* Validate key is a valid string (not just a non-NULL pointer) */
-    if (strlen(key) == 0) return NULL;
+typedef struct metadata_index {
+    const apex_metadata_item *head;  /* List this index belongs to */
+    struct metadata_index *next;     /* Next index in the same registry bucket */
+    metadata_index_entry *entries;
+    int *slots;              /* First entry for a normalized key, or -1 */
+    size_t slot_count;       /* A power of two */
+} metadata_index;
+
+/*
+ * Indexes live in a registry keyed by the list's first item rather than in
+ * the item itself, so lists built elsewhere (by hand, with plain malloc)
+ * carry nothing that apex_free_metadata or apex_metadata_get could misread.
+ * An index is registered by the function that built its list and dropped
+ * when that list is freed.
+ */
+#define METADATA_INDEX_BUCKETS 256
 
-    /* Normalize the search key */
-    char *normalized_key = normalize_metadata_key(key);
-    if (!normalized_key) return NULL;
+static metadata_index *metadata_index_buckets[METADATA_INDEX_BUCKETS];
+static pthread_mutex_t metadata_index_lock = PTHREAD_MUTEX_INITIALIZER;
 
-    /* Try exact case-insensitive match first (for backwards compatibility) */
-    for (apex_metadata_item *item = metadata; item != NULL; item = item->next) {
-        /* Validate item and its key before using */
-        if (!item) break;
-        if (!item->key) continue;
+static size_t metadata_index_bucket(const apex_metadata_item *head) {
+    uintptr_t p = (uintptr_t)head;
+    return (size_t)((p >> 4) ^ (p >> 12)) & (METADATA_INDEX_BUCKETS - 1);
+}
 
-        /* Additional safety: check if key is a valid string */
-        size_t key_len = strlen(item->key);
-        if (key_len == 0) continue;
+/* Index registered for a list, or NULL */
+static metadata_index *metadata_index_find(const apex_metadata_item *head) {
+    metadata_index *found = NULL;
+    pthread_mutex_lock(&metadata_index_lock);
+    for (metadata_index *index = metadata_index_buckets[metadata_index_bucket(head)]; index; index = index->next) {
+        if (index->head == head) {
+            found = index;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&metadata_index_lock);
+    return found;
+}
 
-        if (strcasecmp(item->key, key) == 0) {
-            free(normalized_key);
-            return item->value;
+static void metadata_index_release(const apex_metadata_item *head) {
+    if (!head) return;
+    metadata_index *released = NULL;
+    pthread_mutex_lock(&metadata_index_lock);
+    for (metadata_index **link = &metadata_index_buckets[metadata_index_bucket(head)]; *link; link = &(*link)->next) {
+        if ((*link)->head == head) {
+            released = *link;
+            *link = released->next;
+            break;
         }
     }
+    pthread_mutex_unlock(&metadata_index_lock);
+    free(released);
+}
 
-    /* Try normalized match (spaces removed, lowercase) */
-    for (apex_metadata_item *item = metadata; item != NULL; item = item->next) {
-        if (!item || !item->key) continue;  /* Skip items with NULL keys */
+/**
+ * Index a list by normalized key and register the index for its first item
+ */
+static void metadata_index_build(apex_metadata_item *list) {
+    if (!list || metadata_index_find(list)) return;
+
+    size_t count = 0, key_bytes = 0;
+    for (apex_metadata_item *item = list; item; item = item->next) {
+        if (!item->key || !*item->key) continue;
+        count++;
+        key_bytes += normalize_metadata_key(item->key, NULL, 0) + 1;
+    }
+    if (count == 0) return;
+
+    size_t slot_count = 16;
+    while (slot_count < count * 2) slot_count *= 2;
+
+    size_t size = sizeof(metadata_index) + count * sizeof(metadata_index_entry) +
+                  slot_count * sizeof(int) + key_bytes;
+    metadata_index *index = malloc(size);
+    if (!index) return;
+    index->head = list;
+    index->entries = (metadata_index_entry *)(index + 1);
+    index->slots = (int *)(index->entries + count);
+    index->slot_count = slot_count;
+    char *keys = (char *)(index->slots + slot_count);
+    memset(index->slots, 0xff, slot_count * sizeof(int));
+
+    size_t mask = slot_count - 1;
+    int n = 0;
+    for (apex_metadata_item *item = list; item; item = item->next) {
+        if (!item->key || !*item->key) continue;
+        size_t len = normalize_metadata_key(item->key, keys, key_bytes);
+        metadata_index_entry *entry = &index->entries[n];
+        entry->normalized = keys;
+        entry->item = item;
+        entry->next_same = -1;
+        keys += len + 1;
+        key_bytes -= len + 1;
+
+        size_t slot = metadata_key_hash(entry->normalized) & mask;
+        while (index->slots[slot] >= 0 &&
+               strcmp(index->entries[index->slots[slot]].normalized, entry->normalized) != 0) {
+            slot = (slot + 1) & mask;
+        }
+        if (index->slots[slot] < 0) {
+            index->slots[slot] = n;
+        } else {
+            /* Keep same-key entries in list order */
+            int last = index->slots[slot];
+            while (index->entries[last].next_same >= 0) last = index->entries[last].next_same;
+            index->entries[last].next_same = n;
+        }
+        n++;
+    }
 
-        /* Additional safety: check if key is a valid string */
-        size_t key_len = strlen(item->key);
-        if (key_len == 0) continue;
+    pthread_mutex_lock(&metadata_index_lock);
+    size_t bucket = metadata_index_bucket(list);
+    index->next = metadata_index_buckets[bucket];
+    metadata_index_buckets[bucket] = index;
+    pthread_mutex_unlock(&metadata_index_lock);
+}
 
-        char *normalized_item_key = normalize_metadata_key(item->key);
-        if (normalized_item_key) {
-            bool match = (strcmp(normalized_item_key, normalized_key) == 0);
-            free(normalized_item_key);
-            if (match) {
-                free(normalized_key);
-                return item->value;
+/**
+ * Get a specific metadata value (case-insensitive, spaces ignored)
+ * Matches MultiMarkdown behavior where "HTML Header Level" matches "htmlheaderlevel".
+ * An item whose key equals the query ignoring case wins over an earlier one
+ * that only matches once spaces are removed.
+ */
+const char *apex_metadata_get(apex_metadata_item *metadata, const char *key) {
+    if (!key || !metadata || !*key) return NULL;
+
+    char stack_key[256];
+    char *normalized_key = stack_key;
+    size_t len = normalize_metadata_key(key, stack_key, sizeof(stack_key));
+    if (len >= sizeof(stack_key)) {
+        normalized_key = malloc(len + 1);
+        if (!normalized_key) return NULL;
+        normalize_metadata_key(key, normalized_key, len + 1);
+    }
+
+    const char *value = NULL;
+    const metadata_index *index = metadata_index_find(metadata);
+    if (index) {
+        size_t mask = index->slot_count - 1;
+        size_t slot = metadata_key_hash(normalized_key) & mask;
+        int first = -1;
+        while (index->slots[slot] >= 0) {
+            if (strcmp(index->entries[index->slots[slot]].normalized, normalized_key) == 0) {
+                first = index->slots[slot];
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+        for (int e = first; e >= 0; e = index->entries[e].next_same) {
+            if (strcasecmp(index->entries[e].item->key, key) == 0) {
+                value = index->entries[e].item->value;
+                break;
+            }
+        }
+        if (!value && first >= 0) value = index->entries[first].item->value;
+    } else {
+        /* Exact case-insensitive match first (for backwards compatibility) */
+        for (apex_metadata_item *item = metadata; item; item = item->next) {
+            if (item->key && *item->key && strcasecmp(item->key, key) == 0) {
+                value = item->value;
+                break;
+            }
+        }
+        /* Then normalized match (spaces removed, lowercase) */
+        for (apex_metadata_item *item = metadata; !value && item; item = item->next) {
+            if (item->key && *item->key && metadata_key_matches_normalized(item->key, normalized_key)) {
+                value = item->value;
             }
         }
     }
 
-    free(normalized_key);
-    return NULL;
+    if (normalized_key != stack_key) free(normalized_key);
+    return value;
 }
 
 static void apex_fprint_yaml_escaped_double_quoted(FILE *fp, const char *value) {
@@ -1087,6 +1241,143 @@ static bool parse_date(const char *date_str, struct tm *tm_out) {
     return false;
 }
 
+static bool append_chunk(char **out, size_t *len, size_t *cap, const char *chunk, size_t chunk_len) {
+    if (chunk_len == 0) {
+        return true;
+    }
+    if (*len + chunk_len + 1 > *cap) {
+        size_t new_cap = (*cap == 0 ? 256 : *cap * 2);
+        while (*len + chunk_len + 1 > new_cap) {
+            new_cap *= 2;
+        }
+        char *grown = realloc(*out, new_cap);
+        if (!grown) {
+            return false;
+        }
+        *out = grown;
+        *cap = new_cap;
+    }
+    memcpy(*out + *len, chunk, chunk_len);
+    *len += chunk_len;
+    (*out)[*len] = '\0';
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Template cache                                                            */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Parsed [%...] references and the split and replace(regex:...) patterns
+ * in their transforms repeat across a document and across the source and
+ * HTML passes, so both are compiled once per cache. A converter owns one
+ * cache for its lifetime; a conversion without a converter uses one per
+ * substitution pass. Entries are never evicted; once a table is full,
+ * further entries are compiled per call and freed after use.
+ */
+#define METADATA_REGEX_SLOTS 128
+#define METADATA_REGEX_MAX (METADATA_REGEX_SLOTS / 2)
+#define METADATA_REFERENCE_SLOTS 1024
+#define METADATA_REFERENCE_MAX (METADATA_REFERENCE_SLOTS / 2)
+
+typedef struct {
+    char *pattern;           /* NULL for an empty slot */
+    regex_t regex;
+    bool compiled;           /* false when regcomp rejected the pattern */
+} metadata_regex_entry;
+
+struct metadata_reference;
+
+struct apex_metadata_cache {
+    pthread_mutex_t lock;
+    metadata_regex_entry regexes[METADATA_REGEX_SLOTS];
+    size_t regex_count;
+    struct metadata_reference *references[METADATA_REFERENCE_SLOTS];
+    size_t reference_count;
+};
+
+static void metadata_reference_free(struct metadata_reference *ref);
+
+apex_metadata_cache *apex_metadata_cache_new(void) {
+    apex_metadata_cache *cache = calloc(1, sizeof(apex_metadata_cache));
+    if (!cache) return NULL;
+    if (pthread_mutex_init(&cache->lock, NULL) != 0) {
+        free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void apex_metadata_cache_free(apex_metadata_cache *cache) {
+    if (!cache) return;
+    for (size_t i = 0; i < METADATA_REGEX_SLOTS; i++) {
+        metadata_regex_entry *entry = &cache->regexes[i];
+        if (!entry->pattern) continue;
+        if (entry->compiled) regfree(&entry->regex);
+        free(entry->pattern);
+    }
+    for (size_t i = 0; i < METADATA_REFERENCE_SLOTS; i++) {
+        metadata_reference_free(cache->references[i]);
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+/**
+ * Get a compiled extended regex for pattern, or NULL if it doesn't compile.
+ * Sets *owned when the regex wasn't cached (no cache, or the cache is full)
+ * and must go back through metadata_regex_release. regexec is safe on a
+ * shared regex_t.
+ */
+static regex_t *metadata_regex_acquire(apex_metadata_cache *cache, const char *pattern, bool *owned) {
+    *owned = false;
+
+    if (cache) {
+        uint32_t h = metadata_key_hash(pattern);
+        size_t mask = METADATA_REGEX_SLOTS - 1;
+
+        pthread_mutex_lock(&cache->lock);
+        size_t slot = h & mask;
+        while (cache->regexes[slot].pattern) {
+            metadata_regex_entry *entry = &cache->regexes[slot];
+            if (strcmp(entry->pattern, pattern) == 0) {
+                pthread_mutex_unlock(&cache->lock);
+                return entry->compiled ? &entry->regex : NULL;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        if (cache->regex_count < METADATA_REGEX_MAX) {
+            char *copy = strdup(pattern);
+            if (copy) {
+                metadata_regex_entry *entry = &cache->regexes[slot];
+                entry->compiled = regcomp(&entry->regex, pattern, REG_EXTENDED) == 0;
+                entry->pattern = copy;
+                cache->regex_count++;
+                pthread_mutex_unlock(&cache->lock);
+                return entry->compiled ? &entry->regex : NULL;
+            }
+        }
+        pthread_mutex_unlock(&cache->lock);
+    }
+
+    regex_t *regex = malloc(sizeof(regex_t));
+    if (!regex) return NULL;
+    if (regcomp(regex, pattern, REG_EXTENDED) != 0) {
+        free(regex);
+        return NULL;
+    }
+    *owned = true;
+    return regex;
+}
+
+static void metadata_regex_release(regex_t *regex, bool owned) {
+    if (regex && owned) {
+        regfree(regex);
+        free(regex);
+    }
+}
+
 /* Simple string split fallback (for when regex fails) */
 static apex_string_array *split_string_simple(const char *str, const char *delimiter) {
     if (!str) return NULL;
@@ -1112,7 +1403,8 @@ static apex_string_array *split_string_simple(const char *str, const char *delim
         return NULL;
     }
 
-    char *token = strtok(str_copy, delimiter);
+    char *saveptr = NULL;
+    char *token = strtok_r(str_copy, delimiter, &saveptr);
     while (token) {
         /* Trim whitespace from token */
         char *start = token;
@@ -1139,7 +1431,7 @@ static apex_string_array *split_string_simple(const char *str, const char *delim
         }
         arr->count++;
 
-        token = strtok(NULL, delimiter);
+        token = strtok_r(NULL, delimiter, &saveptr);
     }
 
     free(str_copy);
@@ -1149,7 +1441,8 @@ static apex_string_array *split_string_simple(const char *str, const char *delim
 /**
  * Create string array from string using regex delimiter
  */
-static apex_string_array *split_string(const char *str, const char *delimiter_pattern) {
+static apex_string_array *split_string(const char *str, const char *delimiter_pattern,
+                                       apex_metadata_cache *cache) {
     if (!str) return NULL;
 
     apex_string_array *arr = calloc(1, sizeof(apex_string_array));
@@ -1164,9 +1457,9 @@ static apex_string_array *split_string(const char *str, const char *delimiter_pa
 
     const char *pattern = delimiter_pattern && delimiter_pattern[0] ? delimiter_pattern : "\\s+";
 
-    regex_t regex;
-    int ret = regcomp(&regex, pattern, REG_EXTENDED);
-    if (ret != 0) {
+    bool regex_owned = false;
+    regex_t *regex = metadata_regex_acquire(cache, pattern, &regex_owned);
+    if (!regex) {
         /* Regex compilation failed, fall back to simple string split */
         free(arr->items);
         free(arr);
@@ -1177,7 +1470,7 @@ static apex_string_array *split_string(const char *str, const char *delimiter_pa
     const char *search_pos = str;
     regmatch_t matches[1];
 
-    while (regexec(&regex, search_pos, 1, matches, 0) == 0) {
+    while (regexec(regex, search_pos, 1, matches, 0) == 0) {
         /* Extract token before match */
         size_t token_len = (size_t)matches[0].rm_so;
         if (token_len > 0) {
@@ -1185,7 +1478,7 @@ static apex_string_array *split_string(const char *str, const char *delimiter_pa
                 arr->capacity *= 2;
                 arr->items = realloc(arr->items, arr->capacity * sizeof(char*));
                 if (!arr->items) {
-                    regfree(&regex);
+                    metadata_regex_release(regex, regex_owned);
                     free_string_array(arr);
                     return NULL;
                 }
@@ -1193,7 +1486,7 @@ static apex_string_array *split_string(const char *str, const char *delimiter_pa
 
             char *token = malloc(token_len + 1);
             if (!token) {
-                regfree(&regex);
+                metadata_regex_release(regex, regex_owned);
                 free_string_array(arr);
                 return NULL;
             }
@@ -1211,7 +1504,7 @@ static apex_string_array *split_string(const char *str, const char *delimiter_pa
                 arr->items[arr->count] = strdup(start);
                 if (!arr->items[arr->count]) {
                     free(token);
-                    regfree(&regex);
+                    metadata_regex_release(regex, regex_owned);
                     free_string_array(arr);
                     return NULL;
                 }
@@ -1232,7 +1525,7 @@ static apex_string_array *split_string(const char *str, const char *delimiter_pa
                 arr->capacity *= 2;
                 arr->items = realloc(arr->items, arr->capacity * sizeof(char*));
                 if (!arr->items) {
-                    regfree(&regex);
+                    metadata_regex_release(regex, regex_owned);
                     free_string_array(arr);
                     return NULL;
                 }
@@ -1258,7 +1551,7 @@ static apex_string_array *split_string(const char *str, const char *delimiter_pa
         }
     }
 
-    regfree(&regex);
+    metadata_regex_release(regex, regex_owned);
 
     /* If no matches found, return array with single element (original string) */
     if (arr->count == 0) {
@@ -1277,13 +1570,14 @@ static apex_string_array *split_string(const char *str, const char *delimiter_pa
  * If is_array is true, value is treated as an array (apex_string_array*)
  */
 static char *apply_transform(const char *transform_name, const char *options,
-                            const char *value, apex_string_array **array_ptr, bool *is_array) {
+                            const char *value, apex_string_array **array_ptr, bool *is_array,
+                            apex_metadata_cache *cache) {
     if (!transform_name || !value) return NULL;
 
     /* Handle array transforms */
     if (strcmp(transform_name, "split") == 0) {
         const char *delim = options && options[0] ? options : " ";
-        apex_string_array *arr = split_string(value, delim);
+        apex_string_array *arr = split_string(value, delim, cache);
         if (!arr) return NULL;
         if (*array_ptr) free_string_array(*array_ptr);
         *array_ptr = arr;
@@ -1295,7 +1589,7 @@ static char *apply_transform(const char *transform_name, const char *options,
     if (strcmp(transform_name, "join") == 0) {
         if (!*is_array || !*array_ptr) {
             /* Not an array yet, try to split on commas */
-            apex_string_array *arr = split_string(value, ",");
+            apex_string_array *arr = split_string(value, ",", cache);
             if (!arr) return NULL;
             if (*array_ptr) free_string_array(*array_ptr);
             *array_ptr = arr;
@@ -1339,7 +1633,7 @@ static char *apply_transform(const char *transform_name, const char *options,
     if (strcmp(transform_name, "first") == 0) {
         if (!*is_array || !*array_ptr) {
             /* Not an array yet, try to split on commas */
-            apex_string_array *arr = split_string(value, ",");
+            apex_string_array *arr = split_string(value, ",", cache);
             if (!arr) return NULL;
             if (*array_ptr) free_string_array(*array_ptr);
             *array_ptr = arr;
@@ -1353,7 +1647,7 @@ static char *apply_transform(const char *transform_name, const char *options,
     if (strcmp(transform_name, "last") == 0) {
         if (!*is_array || !*array_ptr) {
             /* Not an array yet, try to split on commas */
-            apex_string_array *arr = split_string(value, ",");
+            apex_string_array *arr = split_string(value, ",", cache);
             if (!arr) return NULL;
             if (*array_ptr) free_string_array(*array_ptr);
             *array_ptr = arr;
@@ -1651,14 +1945,14 @@ static char *apply_transform(const char *transform_name, const char *options,
 
         if (use_regex) {
             /* Use regex replacement */
-            regex_t regex;
-            int ret = regcomp(&regex, old_pattern, REG_EXTENDED);
-            if (ret == 0) {
+            bool regex_owned = false;
+            regex_t *regex = metadata_regex_acquire(cache, old_pattern, &regex_owned);
+            if (regex) {
                 regmatch_t matches[1];
                 /* Count matches first to estimate size */
                 size_t count = 0;
                 const char *search_pos = value;
-                while (regexec(&regex, search_pos, 1, matches, 0) == 0) {
+                while (regexec(regex, search_pos, 1, matches, 0) == 0) {
                     count++;
                     search_pos += matches[0].rm_eo;
                     if (*search_pos == '\0') break;
@@ -1673,7 +1967,7 @@ static char *apply_transform(const char *transform_name, const char *options,
                         const char *src = value;
 
                         search_pos = src;
-                        while (regexec(&regex, search_pos, 1, matches, 0) == 0) {
+                        while (regexec(regex, search_pos, 1, matches, 0) == 0) {
                             /* Copy text before match */
                             size_t before_len = matches[0].rm_so;
                             memcpy(out, search_pos, before_len);
@@ -1698,7 +1992,7 @@ static char *apply_transform(const char *transform_name, const char *options,
                     result = strdup(value);
                 }
 
-                regfree(&regex);
+                metadata_regex_release(regex, regex_owned);
             } else {
                 /* Regex compilation failed, return original */
                 result = strdup(value);
@@ -2025,7 +2319,7 @@ static char *apply_transform(const char *transform_name, const char *options,
  * Apply transform chain to a value
  * Returns newly allocated string
  */
-static char *apply_transform_chain(const char *value, apex_transform *chain) {
+static char *apply_transform_chain(const char *value, apex_transform *chain, apex_metadata_cache *cache) {
     if (!value || !chain) return strdup(value ? value : "");
 
     char *current_value = strdup(value);
@@ -2035,7 +2329,7 @@ static char *apply_transform_chain(const char *value, apex_transform *chain) {
     apex_transform *transform = chain;
     while (transform) {
         char *new_value = apply_transform(transform->name, transform->options,
-                                         current_value, &array, &is_array);
+                                         current_value, &array, &is_array, cache);
         if (!new_value) {
             /* Transform failed, return original value */
             free(current_value);
@@ -2056,179 +2350,267 @@ static char *apply_transform_chain(const char *value, apex_transform *chain) {
     return current_value;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Template programs                                                         */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * A [%...] reference compiled once: the key to look up and its parsed
+ * transform chain. Cached references are keyed by their text and whether
+ * transforms were enabled.
+ */
+typedef struct metadata_reference {
+    char *pattern;
+    bool transforms;
+    char *key;
+    apex_transform *chain;   /* NULL when the reference has no transforms */
+} metadata_reference;
+
+static void metadata_reference_free(metadata_reference *ref) {
+    if (!ref) return;
+    free(ref->pattern);
+    free(ref->key);
+    free_transform_chain(ref->chain);
+    free(ref);
+}
+
 /**
- * Replace [%key] patterns with metadata values
- * If options->enable_metadata_transforms is true, supports [%key:transform:transform2] syntax
+ * Parse a reference body (the text between "[%" and "]")
  */
-char *apex_metadata_replace_variables(const char *text, apex_metadata_item *metadata, const apex_options *options) {
-    if (!text || !metadata) {
-        return text ? strdup(text) : NULL;
+static metadata_reference *metadata_reference_parse(const char *pattern, bool transforms) {
+    metadata_reference *ref = calloc(1, sizeof(metadata_reference));
+    if (!ref) return NULL;
+    ref->pattern = strdup(pattern);
+    ref->transforms = transforms;
+    if (!ref->pattern) {
+        free(ref);
+        return NULL;
     }
 
-    bool transforms_enabled = options && options->enable_metadata_transforms;
+    if (transforms && strchr(pattern, ':')) {
+        ref->chain = parse_transform_chain(pattern, &ref->key);
+    }
+    if (!ref->key) {
+        /* No transforms, or the chain didn't parse: look up the whole text */
+        ref->key = strdup(pattern);
+        if (!ref->key) {
+            metadata_reference_free(ref);
+            return NULL;
+        }
+    }
+    return ref;
+}
+
+/**
+ * Get the compiled reference for pattern. Sets *owned when there is no
+ * cache or it is full, and the caller must free the result.
+ */
+static metadata_reference *metadata_reference_acquire(apex_metadata_cache *cache, const char *pattern,
+                                                      bool transforms, bool *owned) {
+    *owned = false;
+    if (!cache) {
+        metadata_reference *ref = metadata_reference_parse(pattern, transforms);
+        *owned = ref != NULL;
+        return ref;
+    }
+
+    uint32_t h = metadata_key_hash(pattern) ^ (transforms ? 0x9e3779b9u : 0u);
+    size_t mask = METADATA_REFERENCE_SLOTS - 1;
+
+    pthread_mutex_lock(&cache->lock);
+    size_t slot = h & mask;
+    while (cache->references[slot]) {
+        metadata_reference *ref = cache->references[slot];
+        if (ref->transforms == transforms && strcmp(ref->pattern, pattern) == 0) {
+            pthread_mutex_unlock(&cache->lock);
+            return ref;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    metadata_reference *ref = metadata_reference_parse(pattern, transforms);
+    if (ref && cache->reference_count < METADATA_REFERENCE_MAX) {
+        cache->references[slot] = ref;
+        cache->reference_count++;
+    } else if (ref) {
+        *owned = true;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return ref;
+}
+
+/* One [%...] occurrence in the template text */
+typedef struct {
+    size_t start;            /* Offset of "[%" */
+    size_t length;           /* Through the closing "]" */
+    metadata_reference *ref;
+    bool owned;
+} metadata_template_span;
 
-    /* Build result incrementally */
-    size_t result_capacity = strlen(text) + 512;  /* Extra space for potential expansions */
-    char *result = malloc(result_capacity);
-    if (!result) return NULL;
+/* Template text with its references resolved against a cache */
+typedef struct {
+    char *text;
+    size_t text_len;
+    metadata_template_span *spans;
+    size_t span_count;
+    apex_metadata_cache *cache;   /* For transform regexes; may be NULL */
+} metadata_template;
+
+static void metadata_template_free(metadata_template *tpl) {
+    if (!tpl) return;
+    for (size_t i = 0; i < tpl->span_count; i++) {
+        if (tpl->spans[i].owned) metadata_reference_free(tpl->spans[i].ref);
+    }
+    free(tpl->spans);
+    free(tpl->text);
+    free(tpl);
+}
 
-    size_t result_len = 0;
-    const char *last_pos = text;  /* Track position in original text */
+/**
+ * Scan text for [%...] references and resolve each one through the cache
+ */
+static metadata_template *metadata_template_compile(const char *text, bool transforms,
+                                                    apex_metadata_cache *cache) {
+    if (!text) return NULL;
+
+    metadata_template *tpl = calloc(1, sizeof(metadata_template));
+    if (!tpl) return NULL;
+    tpl->cache = cache;
+    tpl->text_len = strlen(text);
+    tpl->text = malloc(tpl->text_len + 1);
+    if (!tpl->text) {
+        free(tpl);
+        return NULL;
+    }
+    memcpy(tpl->text, text, tpl->text_len + 1);
 
-    const char *p = text;
+    size_t span_cap = 0;
+    const char *p = tpl->text;
     while ((p = strstr(p, "[%")) != NULL) {
-        /* Find the matching closing ']' for '[%', accounting for brackets inside the pattern */
-        /* Since '[%' opens a bracket, we need to find the matching ']' */
-        /* We scan forward and track bracket depth to handle nested brackets in regex patterns */
+        /* Find the matching ']', tracking depth so brackets inside
+         * transform options (e.g. regex classes) don't end the reference */
         const char *end = p + 2;
-        int bracket_depth = 1;  /* Start at 1 because '[%' opened a bracket */
-
-        while (*end && bracket_depth > 0) {
+        int bracket_depth = 1;
+        while (*end) {
             if (*end == '[') {
                 bracket_depth++;
-            } else if (*end == ']') {
-                bracket_depth--;
-            }
-            if (bracket_depth > 0) {
-                end++;
+            } else if (*end == ']' && --bracket_depth == 0) {
+                break;
             }
+            end++;
         }
-
-        if (!*end && bracket_depth > 0) {
-            /* Malformed - no matching closing bracket found */
+        if (!*end) {
+            /* Malformed - no matching closing bracket; the rest is literal */
             break;
         }
 
-        /* Copy text before [%...] */
-        size_t prefix_len = p - last_pos;
-        if (prefix_len > 0) {
-            if (result_len + prefix_len + 1 > result_capacity) {
-                result_capacity = (result_len + prefix_len + 1) * 2;
-                char *new_result = realloc(result, result_capacity);
-                if (!new_result) {
-                    free(result);
-                    return NULL;
-                }
-                result = new_result;
-            }
-            memcpy(result + result_len, last_pos, prefix_len);
-            result_len += prefix_len;
-        }
-
-        /* Extract key and transforms */
         size_t pattern_len = end - (p + 2);
         char pattern[512];
         if (pattern_len >= sizeof(pattern)) {
             /* Pattern too long, keep original */
-            size_t keep_len = (end - p) + 1;
-            if (result_len + keep_len + 1 > result_capacity) {
-                result_capacity = (result_len + keep_len + 1) * 2;
-                char *new_result = realloc(result, result_capacity);
-                if (!new_result) {
-                    free(result);
-                    return NULL;
-                }
-                result = new_result;
-            }
-            memcpy(result + result_len, p, keep_len);
-            result_len += keep_len;
-            last_pos = end + 1;
             p = end + 1;
             continue;
         }
-
         memcpy(pattern, p + 2, pattern_len);
         pattern[pattern_len] = '\0';
 
-        /* Parse key and transforms */
-        char *key = NULL;
-        apex_transform *transform_chain = NULL;
-        const char *value = NULL;
-        char *transformed_value = NULL;
-
-        if (transforms_enabled && strchr(pattern, ':')) {
-            /* Has transforms */
-            transform_chain = parse_transform_chain(pattern, &key);
-            if (key) {
-                value = apex_metadata_get(metadata, key);
-                if (value && transform_chain) {
-                    transformed_value = apply_transform_chain(value, transform_chain);
-                    /* If transform chain failed, fall back to original value */
-                    if (!transformed_value) {
-                        transformed_value = strdup(value);
-                    }
-                } else if (value) {
-                    transformed_value = strdup(value);
-                }
-                free(key);
-                free_transform_chain(transform_chain);
-            } else {
-                /* Parse failed, treat as simple key */
-                value = apex_metadata_get(metadata, pattern);
-                if (value) {
-                    transformed_value = strdup(value);
-                }
-            }
-        } else {
-            /* Simple key, no transforms */
-            value = apex_metadata_get(metadata, pattern);
-            if (value) {
-                transformed_value = strdup(value);
-            }
+        bool owned = false;
+        metadata_reference *ref = metadata_reference_acquire(cache, pattern, transforms, &owned);
+        if (!ref) {
+            metadata_template_free(tpl);
+            return NULL;
         }
 
-        if (transformed_value) {
-            size_t value_len = strlen(transformed_value);
-            if (result_len + value_len + 1 > result_capacity) {
-                result_capacity = (result_len + value_len + 1) * 2;
-                char *new_result = realloc(result, result_capacity);
-                if (!new_result) {
-                    free(result);
-                    free(transformed_value);
-                    return NULL;
-                }
-                result = new_result;
-            }
-            memcpy(result + result_len, transformed_value, value_len);
-            result_len += value_len;
-            free(transformed_value);
-        } else {
-            /* Keep original pattern if not found */
-            size_t keep_len = (end - p) + 1;
-            if (result_len + keep_len + 1 > result_capacity) {
-                result_capacity = (result_len + keep_len + 1) * 2;
-                char *new_result = realloc(result, result_capacity);
-                if (!new_result) {
-                    free(result);
-                    return NULL;
-                }
-                result = new_result;
+        if (tpl->span_count == span_cap) {
+            size_t new_cap = span_cap ? span_cap * 2 : 16;
+            metadata_template_span *grown = realloc(tpl->spans, new_cap * sizeof(metadata_template_span));
+            if (!grown) {
+                if (owned) metadata_reference_free(ref);
+                metadata_template_free(tpl);
+                return NULL;
             }
-            memcpy(result + result_len, p, keep_len);
-            result_len += keep_len;
+            tpl->spans = grown;
+            span_cap = new_cap;
         }
+        metadata_template_span *span = &tpl->spans[tpl->span_count++];
+        span->start = p - tpl->text;
+        span->length = (end - p) + 1;
+        span->ref = ref;
+        span->owned = owned;
 
-        last_pos = end + 1;
         p = end + 1;
     }
 
-    /* Copy remaining text after last [%...] */
-    if (last_pos && *last_pos) {
-        size_t remaining = strlen(last_pos);
-        if (result_len + remaining + 1 > result_capacity) {
-            result_capacity = result_len + remaining + 1;
-            char *new_result = realloc(result, result_capacity);
-            if (!new_result) {
-                free(result);
-                return NULL;
-            }
-            result = new_result;
+    return tpl;
+}
+
+/**
+ * Render a compiled template, keeping references whose key isn't in metadata
+ */
+static char *metadata_template_render(const metadata_template *tpl, apex_metadata_item *metadata) {
+    if (!tpl) return NULL;
+
+    size_t cap = tpl->text_len + 512;  /* Extra space for potential expansions */
+    size_t len = 0;
+    char *out = malloc(cap);
+    if (!out) return NULL;
+    out[0] = '\0';
+
+    size_t pos = 0;
+    for (size_t i = 0; i < tpl->span_count; i++) {
+        const metadata_template_span *span = &tpl->spans[i];
+        if (!append_chunk(&out, &len, &cap, tpl->text + pos, span->start - pos)) {
+            free(out);
+            return NULL;
+        }
+        pos = span->start + span->length;
+
+        const char *value = metadata ? apex_metadata_get(metadata, span->ref->key) : NULL;
+        bool ok;
+        if (!value) {
+            /* Keep original reference if the key isn't found */
+            ok = append_chunk(&out, &len, &cap, tpl->text + span->start, span->length);
+        } else if (span->ref->chain) {
+            char *transformed = apply_transform_chain(value, span->ref->chain, tpl->cache);
+            ok = append_chunk(&out, &len, &cap, transformed ? transformed : value,
+                              strlen(transformed ? transformed : value));
+            free(transformed);
+        } else {
+            ok = append_chunk(&out, &len, &cap, value, strlen(value));
+        }
+        if (!ok) {
+            free(out);
+            return NULL;
         }
-        strcpy(result + result_len, last_pos);
-        result_len += remaining;
     }
 
-    result[result_len] = '\0';
+    if (!append_chunk(&out, &len, &cap, tpl->text + pos, tpl->text_len - pos)) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+/**
+ * Replace [%key] patterns with metadata values
+ * If options->enable_metadata_transforms is true, supports [%key:transform:transform2] syntax
+ */
+char *apex_metadata_replace_variables(const char *text, apex_metadata_item *metadata, const apex_options *options,
+                                      apex_metadata_cache *cache) {
+    if (!text || !metadata) {
+        return text ? strdup(text) : NULL;
+    }
+    if (!strstr(text, "[%")) {
+        return strdup(text);
+    }
+
+    /* Without a caller's cache, references repeated in this text still share one */
+    apex_metadata_cache *local_cache = cache ? NULL : apex_metadata_cache_new();
+    bool transforms_enabled = options && options->enable_metadata_transforms;
+    metadata_template *tpl = metadata_template_compile(text, transforms_enabled, cache ? cache : local_cache);
+    char *result = tpl ? metadata_template_render(tpl, metadata) : NULL;
+    metadata_template_free(tpl);
+    apex_metadata_cache_free(local_cache);
     return result;
 }
 
@@ -2278,6 +2660,7 @@ apex_metadata_item *apex_load_metadata_from_file(const char *filepath) {
     }
 
     free(buffer);
+    metadata_index_build(items);
     return items;
 }
 
@@ -2429,6 +2812,7 @@ apex_metadata_item *apex_parse_command_metadata(const char *arg) {
         }
     }
 
+    metadata_index_build(items);
     return items;
 }
 
@@ -2486,6 +2870,7 @@ apex_metadata_item *apex_merge_metadata(apex_metadata_item *first, ...) {
     }
 
     va_end(args);
+    metadata_index_build(result);
     return result;
 }
 
@@ -68,15 +68,37 @@ void apex_free_metadata(apex_metadata_item *metadata);
 
 /**
  * Get a specific metadata value by key (case-insensitive)
+ * Lists returned by the extract, load, parse and merge functions are
+ * indexed by key in a table kept beside the list until apex_free_metadata,
+ * so the lookup doesn't walk the list or allocate. Values are read from the
+ * items at lookup time; relinking such a list or renaming its keys is not
+ * seen by the index. Other lists, such as ones built by hand, are searched
+ * linearly.
  * Returns NULL if not found
  */
 const char *apex_metadata_get(apex_metadata_item *metadata, const char *key);
 
+typedef struct apex_metadata_cache apex_metadata_cache;
+
 /**
  * Replace [%key] patterns in text with metadata values
  * If options->enable_metadata_transforms is true, supports [%key:transform:transform2] syntax
+ * Parsed references are kept in cache (NULL for one private to this call)
+ */
+char *apex_metadata_replace_variables(const char *text, apex_metadata_item *metadata, const apex_options *options,
+                                      apex_metadata_cache *cache);
+
+/**
+ * Cache of parsed [%key] references and the regexes their transforms use.
+ * Safe to share between threads. Its size is bounded: once full, further
+ * references are parsed per call.
+ */
+apex_metadata_cache *apex_metadata_cache_new(void);
+
+/**
+ * Free a cache created with apex_metadata_cache_new()
  */
-char *apex_metadata_replace_variables(const char *text, apex_metadata_item *metadata, const apex_options *options);
+void apex_metadata_cache_free(apex_metadata_cache *cache);
 
 /**
  * Load metadata from a file
@@ -0,0 +1,169 @@
+/**
+ * Proofreader Extension for Apex
+ * Implementation
+ */
+
+#include "proofreader.h"
+#include <string.h>
+#include <stdlib.h>
+
+void apex_proofreader_state_init(apex_proofreader_state *state) {
+    if (!state) return;
+    state->in_code_block = false;
+    state->in_inline_code = false;
+    state->backtick_count = 0;
+    state->pending = 0;
+}
+
+/**
+ * Find the first "cc" pair in [p, end)
+ */
+static const char *find_marker_pair(const char *p, const char *end, char c) {
+    while (p + 1 < end) {
+        const char *hit = memchr(p, c, (size_t)(end - p - 1));
+        if (!hit) return NULL;
+        if (hit[1] == c) return hit;
+        p = hit + 1;
+    }
+    return NULL;
+}
+
+/**
+ * Convert markers in text, carrying code state in st.
+ * Returns the number of bytes consumed. Unless final, stops (without
+ * consuming) at an opener whose closer is not in text yet and records it
+ * in st->pending so the caller can claim the rest.
+ */
+static size_t proofread_run(apex_proofreader_state *st, const char *text, size_t len,
+                            apex_pp_sink *out, bool final) {
+    const char *read = text;
+    const char *end = text + len;
+    const char *copy_from = text;
+
+    st->pending = 0;
+
+    while (read < end) {
+        char c = *read;
+        char next = (read + 1 < end) ? read[1] : '\0';
+
+        /* Track code blocks and inline code to skip processing inside them */
+        if (c == '`') {
+            st->backtick_count++;
+            if (st->backtick_count >= 3) {
+                /* Code block fence */
+                st->in_code_block = !st->in_code_block;
+                st->backtick_count = 0;
+            } else if (!st->in_code_block && next != '`') {
+                st->in_inline_code = !st->in_inline_code;
+                st->backtick_count = 0;
+            }
+        } else {
+            st->backtick_count = 0;
+        }
+
+        if (st->in_code_block || st->in_inline_code) {
+            read++;
+            continue;
+        }
+
+        if ((c == '=' || c == '~') && next == c) {
+            const char *close = find_marker_pair(read + 2, end, c);
+            if (!close && !final) {
+                apex_pp_emit(out, copy_from, (size_t)(read - copy_from));
+                st->pending = c;
+                return (size_t)(read - text);
+            }
+            if (close) {
+                /* ==text== -> {==text==}, ~~text~~ -> {--text--} */
+                char mark = (c == '=') ? '=' : '-';
+                char open_tag[3] = { '{', mark, mark };
+                char close_tag[3] = { mark, mark, '}' };
+                apex_pp_emit(out, copy_from, (size_t)(read - copy_from));
+                apex_pp_emit(out, open_tag, 3);
+                apex_pp_emit(out, read + 2, (size_t)(close - (read + 2)));
+                apex_pp_emit(out, close_tag, 3);
+                read = close + 2;
+                copy_from = read;
+                continue;
+            }
+            /* No closer anywhere: both characters are copied as-is */
+            read += 2;
+            continue;
+        }
+
+        read++;
+    }
+
+    apex_pp_emit(out, copy_from, (size_t)(end - copy_from));
+    return len;
+}
+
+static apex_pp_result proofreader_line(void *state, const char *line, size_t len, apex_pp_sink *out) {
+    apex_proofreader_state *st = (apex_proofreader_state *)state;
+
+    if (st->pending) {
+        /* Waiting for a closer: keep claiming until a line contains one */
+        apex_pp_claim(out, line, len);
+        if (!find_marker_pair(line, line + len, st->pending)) {
+            return APEX_PP_HANDLED;
+        }
+        size_t claimed_len = 0;
+        const char *claimed = apex_pp_claimed(out, &claimed_len);
+        size_t done = proofread_run(st, claimed, claimed_len, out, false);
+        apex_pp_claim_consume(out, done);
+        return APEX_PP_HANDLED;
+    }
+
+    /* Fast path: nothing that could change state or output */
+    bool interesting = false;
+    for (size_t i = 0; i < len; i++) {
+        char c = line[i];
+        if (c == '`' || c == '=' || c == '~') {
+            interesting = true;
+            break;
+        }
+    }
+    if (!interesting) {
+        st->backtick_count = 0;
+        return APEX_PP_PASS;
+    }
+
+    size_t done = proofread_run(st, line, len, out, false);
+    if (done < len) {
+        apex_pp_claim(out, line + done, len - done);
+    }
+    return APEX_PP_HANDLED;
+}
+
+static void proofreader_finish(void *state, apex_pp_sink *out) {
+    apex_proofreader_state *st = (apex_proofreader_state *)state;
+    size_t claimed_len = 0;
+    const char *claimed = apex_pp_claimed(out, &claimed_len);
+    if (claimed) {
+        proofread_run(st, claimed, claimed_len, out, true);
+        apex_pp_claim_consume(out, claimed_len);
+    }
+    st->pending = 0;
+}
+
+bool apex_proofreader_add_stage(apex_preprocessor *pp, apex_proofreader_state *state) {
+    if (!state) return false;
+    return apex_preprocessor_add_stage(pp, "proofreader", proofreader_line, proofreader_finish, state);
+}
+
+char *apex_process_proofreader(const char *text) {
+    if (!text) return NULL;
+
+    apex_preprocessor *pp = apex_preprocessor_new();
+    if (!pp) return NULL;
+
+    apex_proofreader_state state;
+    apex_proofreader_state_init(&state);
+
+    char *result = NULL;
+    if (apex_proofreader_add_stage(pp, &state)) {
+        result = apex_preprocessor_run(pp, text, strlen(text));
+    }
+    apex_preprocessor_free(pp);
+    return result;
+}
@@ -0,0 +1,50 @@
+/**
+ * Proofreader Extension for Apex
+ *
+ * Converts proofreading shorthand to CriticMarkup before parsing:
+ *   ==text==  ->  {==text==}
+ *   ~~text~~  ->  {--text--}
+ *
+ * Text inside fenced and inline code is left alone. A marker may be closed
+ * on a later line; the stage claims the lines in between until it is.
+ */
+
+#ifndef APEX_PROOFREADER_H
+#define APEX_PROOFREADER_H
+
+#include <stdbool.h>
+#include "../preprocess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Scanner state carried from line to line (caller-owned while the
+ * preprocessor runs; initialize with apex_proofreader_state_init)
+ */
+typedef struct {
+    bool in_code_block;
+    bool in_inline_code;
+    int backtick_count;
+    char pending;  /* '=' or '~' while an opener waits for its closer, else 0 */
+} apex_proofreader_state;
+
+void apex_proofreader_state_init(apex_proofreader_state *state);
+
+/**
+ * Register the proofreader stage on a streaming preprocessor
+ */
+bool apex_proofreader_add_stage(apex_preprocessor *pp, apex_proofreader_state *state);
+
+/**
+ * Convert proofreader markup in text
+ * @return Newly allocated string (must be freed), or NULL on error
+ */
+char *apex_process_proofreader(const char *text);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APEX_PROOFREADER_H */
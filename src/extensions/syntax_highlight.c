@@ -7,6 +7,7 @@
  */
 
 #include "syntax_highlight.h"
+#include "../stats.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -41,7 +42,10 @@ bool apex_syntax_highlighter_available(const char *tool) {
     /* Use 'which' to check if the binary exists */
     char cmd[256];
     snprintf(cmd, sizeof(cmd), "which %s >/dev/null 2>&1", binary);
-    return system(cmd) == 0;
+    uint64_t started = apex_stats_subprocess_begin();
+    bool found = system(cmd) == 0;
+    apex_stats_subprocess_end(started);
+    return found;
 }
 
 /**
@@ -278,7 +282,10 @@ static char *highlight_code_block(const char *code, const char *language,
         return NULL;
     }
 
-    return run_command(cmd, code);
+    uint64_t started = apex_stats_subprocess_begin();
+    char *highlighted = run_command(cmd, code);
+    apex_stats_subprocess_end(started);
+    return highlighted;
 }
 
 /**
@@ -299,6 +306,14 @@ char *apex_apply_syntax_highlighting(const char *html, const char *tool, bool li
         return strdup(html);
     }
 
+    return apex_apply_syntax_highlighting_prechecked(html, tool, line_numbers,
+                                                     language_only, ansi_output, theme);
+}
+
+char *apex_apply_syntax_highlighting_prechecked(const char *html, const char *tool, bool line_numbers,
+                                                bool language_only, bool ansi_output, const char *theme) {
+    if (!html || !tool) return html ? strdup(html) : NULL;
+
     size_t html_len = strlen(html);
     /* Allocate generous buffer for output (highlighted code can be larger) */
     size_t cap = html_len * 3 + 1024;
@@ -36,6 +36,14 @@
  */
 char *apex_apply_syntax_highlighting(const char *html, const char *tool, bool line_numbers, bool language_only, bool ansi_output, const char *theme);
 
+/**
+ * Same as apex_apply_syntax_highlighting(), minus the PATH lookup.
+ *
+ * For callers that already confirmed the tool with
+ * apex_syntax_highlighter_available() and convert many documents.
+ */
+char *apex_apply_syntax_highlighting_prechecked(const char *html, const char *tool, bool line_numbers, bool language_only, bool ansi_output, const char *theme);
+
 /**
  * Check if a syntax highlighting tool is available in PATH.
  *
@@ -5,6 +5,7 @@
 
 #include "toc.h"
 #include "header_ids.h"
+#include "../attr_pool.h"
 #include "apex/apex.h"
 #include <string.h>
 #include <stdlib.h>
@@ -12,19 +13,16 @@
 #include <ctype.h>
 #include <stdbool.h>
 
-/* Placeholders for backslash-escaped {{TOC...}} markers preserved through parsing. */
-static char **escaped_toc_originals = NULL;
-static size_t escaped_toc_count = 0;
-
-static void clear_escaped_toc_store(void) {
-    if (escaped_toc_originals) {
-        for (size_t i = 0; i < escaped_toc_count; i++) {
-            free(escaped_toc_originals[i]);
+void apex_escaped_toc_store_free(apex_escaped_toc_store *store) {
+    if (!store) return;
+    if (store->originals) {
+        for (size_t i = 0; i < store->count; i++) {
+            free(store->originals[i]);
         }
-        free(escaped_toc_originals);
+        free(store->originals);
     }
-    escaped_toc_originals = NULL;
-    escaped_toc_count = 0;
+    store->originals = NULL;
+    store->count = 0;
 }
 
 static bool is_escaped_mmd_toc_start(const char *p) {
@@ -59,10 +57,10 @@ static char *build_unescaped_toc_marker(const char *escaped_start, const char *e
     return out;
 }
 
-char *apex_protect_escaped_toc_markers(const char *text) {
-    if (!text) return NULL;
+char *apex_protect_escaped_toc_markers(const char *text, apex_escaped_toc_store *store) {
+    if (!text || !store) return NULL;
 
-    clear_escaped_toc_store();
+    apex_escaped_toc_store_free(store);
 
     size_t len = strlen(text);
     size_t capacity = len + 64;
@@ -80,31 +78,31 @@ char *apex_protect_escaped_toc_markers(const char *text) {
                 char *original = build_unescaped_toc_marker(read, end);
                 if (!original) {
                     free(output);
-                    clear_escaped_toc_store();
+                    apex_escaped_toc_store_free(store);
                     return NULL;
                 }
 
-                char **new_store = realloc(escaped_toc_originals,
-                                           (escaped_toc_count + 1) * sizeof(char *));
+                char **new_store = realloc(store->originals,
+                                           (store->count + 1) * sizeof(char *));
                 if (!new_store) {
                     free(original);
                     free(output);
-                    clear_escaped_toc_store();
+                    apex_escaped_toc_store_free(store);
                     return NULL;
                 }
-                escaped_toc_originals = new_store;
-                escaped_toc_originals[escaped_toc_count++] = original;
+                store->originals = new_store;
+                store->originals[store->count++] = original;
 
                 char placeholder[64];
                 int ph_len = snprintf(placeholder, sizeof(placeholder),
-                                      "@APEX_ESCAPED_TOC_%zu@", escaped_toc_count - 1);
+                                      "@APEX_ESCAPED_TOC_%zu@", store->count - 1);
                 if ((size_t)ph_len >= remaining) {
                     size_t written = (size_t)(write - output);
                     capacity = written + (size_t)ph_len + len + 64;
                     char *new_output = realloc(output, capacity);
                     if (!new_output) {
                         free(output);
-                        clear_escaped_toc_store();
+                        apex_escaped_toc_store_free(store);
                         return NULL;
                     }
                     output = new_output;
@@ -125,7 +123,7 @@ char *apex_protect_escaped_toc_markers(const char *text) {
             char *new_output = realloc(output, capacity);
             if (!new_output) {
                 free(output);
-                clear_escaped_toc_store();
+                apex_escaped_toc_store_free(store);
                 return NULL;
             }
             output = new_output;
@@ -140,12 +138,12 @@ char *apex_protect_escaped_toc_markers(const char *text) {
     return output;
 }
 
-char *apex_restore_escaped_toc_markers(const char *html) {
+char *apex_restore_escaped_toc_markers(const char *html, apex_escaped_toc_store *store) {
     if (!html) return NULL;
-    if (escaped_toc_count == 0) return strdup(html);
+    if (!store || store->count == 0) return strdup(html);
 
     size_t len = strlen(html);
-    size_t capacity = len + escaped_toc_count * 32;
+    size_t capacity = len + store->count * 32;
     char *output = malloc(capacity);
     if (!output) return NULL;
 
@@ -164,8 +162,8 @@ char *apex_restore_escaped_toc_markers(const char *html) {
                     memcpy(idx_buf, idx_start, idx_len);
                     idx_buf[idx_len] = '\0';
                     size_t index = (size_t)atoi(idx_buf);
-                    if (index < escaped_toc_count && escaped_toc_originals[index]) {
-                        const char *original = escaped_toc_originals[index];
+                    if (index < store->count && store->originals[index]) {
+                        const char *original = store->originals[index];
                         size_t orig_len = strlen(original);
                         if (orig_len >= remaining) {
                             size_t written = (size_t)(write - output);
@@ -206,7 +204,7 @@ char *apex_restore_escaped_toc_markers(const char *html) {
     }
 
     *write = '\0';
-    clear_escaped_toc_store();
+    apex_escaped_toc_store_free(store);
     return output;
 }
 
@@ -254,23 +252,11 @@ static char *normalize_toc_text(const char *text) {
     return out;
 }
 
-static char *heading_id_from_attrs_or_text(const char *attrs, const char *text,
+static char *heading_id_from_attrs_or_text(const apex_attributes *attrs, const char *text,
                                            apex_id_format_t id_format) {
-    if (attrs) {
-        const char *id_attr = strstr(attrs, "id=\"");
-        if (id_attr) {
-            const char *id_start = id_attr + 4;
-            const char *id_end = strchr(id_start, '"');
-            if (id_end && id_end > id_start) {
-                size_t id_len = (size_t)(id_end - id_start);
-                char *id = malloc(id_len + 1);
-                if (id) {
-                    memcpy(id, id_start, id_len);
-                    id[id_len] = '\0';
-                    return id;
-                }
-            }
-        }
+    if (attrs && attrs->id && *attrs->id) {
+        char *id = strdup(attrs->id);
+        if (id) return id;
     }
     return apex_generate_header_id(text, id_format);
 }
@@ -329,13 +315,11 @@ static header_item *collect_headers(cmark_node *node, header_item **tail,
     /* Check if current node is a header */
     if (cmark_node_get_type(node) == CMARK_NODE_HEADING) {
         /* Skip headings marked with the Kramdown-style ".no_toc" class.
-         * The IAL processor stores attributes as a raw HTML attribute
-         * string in the node's user_data, e.g. id="..." class="a b no_toc".
-         * If we see "no_toc" in the attribute string, we exclude this
-         * heading from the generated table of contents.
+         * The IAL processor stores the heading's attributes typed on the
+         * node (see attr_pool.h), along with any ID it was given.
          */
-        const char *attrs = (const char *)cmark_node_get_user_data(node);
-        if (!(attrs && strstr(attrs, "no_toc") != NULL)) {
+        const apex_attributes *attrs = apex_node_attributes(node);
+        if (!apex_attributes_has_class(attrs, "no_toc")) {
             header_item *item = malloc(sizeof(header_item));
             if (item) {
                 item->level = cmark_node_get_heading_level(node);
@@ -722,32 +706,16 @@ static const char *find_toc_marker_not_in_code(const char *html, int *is_html_co
 }
 
 /**
- * Process TOC markers in HTML
+ * Replace the marker with a TOC of headers
  */
-char *apex_process_toc(const char *html, cmark_node *document, int id_format,
-                       int default_min, int default_max) {
-    if (!html || !document) return html ? strdup(html) : NULL;
-
-    int is_html_comment = 0;
-    const char *marker = find_toc_marker_not_in_code(html, &is_html_comment);
-
-    if (!marker) {
-        return strdup(html);  /* No valid TOC marker (or all are in code), return as-is */
-    }
-
-    /* Collect headers from document */
-    header_item *tail = NULL;
-    header_item *headers = collect_headers(document, &tail, (apex_id_format_t)id_format);
-    if (!headers) return strdup(html);
-
+static char *replace_toc_marker(const char *html, const char *marker, int is_html_comment,
+                                header_item *headers, int default_min, int default_max) {
     /* Parse the marker for min/max levels */
     int min_level, max_level;
     parse_toc_marker(marker, &min_level, &max_level, default_min, default_max);
 
     /* Generate TOC HTML */
     char *toc_html = generate_toc_html(headers, min_level, max_level);
-    free_headers(headers);
-
     if (!toc_html) return strdup(html);
 
     /* Replace marker with TOC */
@@ -788,3 +756,56 @@ char *apex_process_toc(const char *html, cmark_node *document, int id_format,
     return output;
 }
 
+/**
+ * Process TOC markers in HTML
+ */
+char *apex_process_toc(const char *html, cmark_node *document, int id_format,
+                       int default_min, int default_max) {
+    if (!html || !document) return html ? strdup(html) : NULL;
+
+    int is_html_comment = 0;
+    const char *marker = find_toc_marker_not_in_code(html, &is_html_comment);
+
+    if (!marker) {
+        return strdup(html);  /* No valid TOC marker (or all are in code), return as-is */
+    }
+
+    /* Collect headers from document */
+    header_item *tail = NULL;
+    header_item *headers = collect_headers(document, &tail, (apex_id_format_t)id_format);
+    if (!headers) return strdup(html);
+
+    char *output = replace_toc_marker(html, marker, is_html_comment, headers,
+                                      default_min, default_max);
+    free_headers(headers);
+    return output;
+}
+
+char *apex_process_toc_entries(const char *html, const apex_toc_entry *entries, size_t count,
+                               int default_min, int default_max) {
+    if (!html) return NULL;
+
+    int is_html_comment = 0;
+    const char *marker = find_toc_marker_not_in_code(html, &is_html_comment);
+    if (!marker || count == 0) return strdup(html);
+
+    /* The entries stand in for the headers collect_headers() would find */
+    header_item *items = calloc(count, sizeof(header_item));
+    if (!items) return strdup(html);
+    for (size_t i = 0; i < count; i++) {
+        items[i].level = entries[i].level;
+        items[i].text = entries[i].text;
+        items[i].id = entries[i].id;
+        items[i].next = i + 1 < count ? &items[i + 1] : NULL;
+    }
+
+    char *output = replace_toc_marker(html, marker, is_html_comment, items,
+                                      default_min, default_max);
+    free(items);
+    return output;
+}
+
+bool apex_html_has_toc_marker(const char *html) {
+    int is_html_comment = 0;
+    return html && find_toc_marker_not_in_code(html, &is_html_comment) != NULL;
+}
@@ -12,6 +12,8 @@
 #define APEX_TOC_H
 
 #include "cmark-gfm.h"
+#include "apex/apex.h"
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,6 +31,20 @@ extern "C" {
 char *apex_process_toc(const char *html, cmark_node *document, int id_format,
                        int default_min, int default_max);
 
+/**
+ * Like apex_process_toc(), with the headers given as entries (levels 1-6
+ * in document order) instead of collected from an AST. Incremental
+ * sessions use this to expand the marker in one section with the
+ * headings of the whole document.
+ */
+char *apex_process_toc_entries(const char *html, const apex_toc_entry *entries, size_t count,
+                               int default_min, int default_max);
+
+/**
+ * Whether html holds a TOC marker apex_process_toc() would replace
+ */
+bool apex_html_has_toc_marker(const char *html);
+
 /**
  * Generate a Markdown table of contents from document headings.
  * Returns a newly allocated string containing "- [text](#id)" entries.
@@ -40,16 +56,32 @@ char *apex_process_toc(const char *html, cmark_node *document, int id_format,
 char *apex_generate_toc_markdown(cmark_node *document, int id_format,
                                  int min_level, int max_level);
 
+/**
+ * Backslash-escaped {{TOC...}} markers preserved through parsing.
+ * One store per conversion; zero-initialize before use.
+ */
+typedef struct {
+    char **originals;
+    size_t count;
+} apex_escaped_toc_store;
+
 /**
  * Replace backslash-escaped {{TOC...}} markers with placeholders before parsing.
  * Call before markdown parse when TOC processing will run later.
+ * The original markers are recorded in store.
  */
-char *apex_protect_escaped_toc_markers(const char *text);
+char *apex_protect_escaped_toc_markers(const char *text, apex_escaped_toc_store *store);
 
 /**
  * Restore placeholders to literal {{TOC...}} text in HTML after TOC processing.
+ * Empties store on success.
+ */
+char *apex_restore_escaped_toc_markers(const char *html, apex_escaped_toc_store *store);
+
+/**
+ * Free the markers held by store (the struct itself is not freed)
  */
-char *apex_restore_escaped_toc_markers(const char *html);
+void apex_escaped_toc_store_free(apex_escaped_toc_store *store);
 
 #ifdef __cplusplus
 }
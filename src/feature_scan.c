@@ -0,0 +1,181 @@
+/**
+ * Feature Sniffing for Apex
+ * Implementation
+ */
+
+#include "feature_scan.h"
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_BLOCK 16
+typedef __m128i scan_vec;
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SCAN_BLOCK 16
+typedef uint8x16_t scan_vec;
+#endif
+
+/* Bytes the scan stops at: trigger characters and the first byte of
+ * every trigger pair. Everything else (most prose) is skipped. */
+static const bool scan_stop[256] = {
+    ['+'] = true, ['^'] = true, ['~'] = true, ['{'] = true,
+    ['['] = true, [':'] = true, ['#'] = true, ['|'] = true,
+    ['<'] = true, ['='] = true, ['('] = true, ['`'] = true,
+};
+
+/* Bits contributed by a byte on its own */
+static const apex_feature_bits byte_features[256] = {
+    ['+'] = APEX_FEATURE_PLUS,
+    ['^'] = APEX_FEATURE_CARET,
+    ['~'] = APEX_FEATURE_TILDE,
+    ['{'] = APEX_FEATURE_BRACE,
+    ['['] = APEX_FEATURE_BRACKET,
+    [':'] = APEX_FEATURE_COLON,
+    ['#'] = APEX_FEATURE_HASH,
+    ['|'] = APEX_FEATURE_PIPE,
+    ['<'] = APEX_FEATURE_LT,
+};
+
+#ifdef SCAN_BLOCK
+/* The scan_stop bytes, one vector lane each */
+static const char scan_stop_bytes[] = "+^~{[:#|<=(`";
+#define SCAN_STOP_COUNT (sizeof(scan_stop_bytes) - 1)
+
+/* Whether the SCAN_BLOCK bytes at p hold any stop byte */
+static inline bool scan_block_has_stop(const unsigned char *p, const scan_vec *stops) {
+#if defined(__SSE2__)
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i hit = _mm_setzero_si128();
+    for (size_t i = 0; i < SCAN_STOP_COUNT; i++) {
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, stops[i]));
+    }
+    return _mm_movemask_epi8(hit) != 0;
+#else
+    uint8x16_t v = vld1q_u8(p);
+    uint8x16_t hit = vdupq_n_u8(0);
+    for (size_t i = 0; i < SCAN_STOP_COUNT; i++) {
+        hit = vorrq_u8(hit, vceqq_u8(v, stops[i]));
+    }
+    return vmaxvq_u8(hit) != 0;
+#endif
+}
+#endif
+
+/**
+ * Bits contributed by the pair (prev, c); only called when prev is a
+ * stop byte
+ */
+static apex_feature_bits pair_features(unsigned char prev, unsigned char c) {
+    switch (prev) {
+        case '+':
+            return c == '+' ? APEX_FEATURE_DOUBLE_PLUS : 0;
+        case '=':
+            return c == '=' ? APEX_FEATURE_DOUBLE_EQUALS : 0;
+        case '~':
+            return c == '~' ? APEX_FEATURE_DOUBLE_TILDE : 0;
+        case ':':
+            return c == ':' ? APEX_FEATURE_DOUBLE_COLON : 0;
+        case '[':
+            if (c == '[') return APEX_FEATURE_DOUBLE_BRACKET;
+            if (c == '^') return APEX_FEATURE_FOOTNOTE;
+            return 0;
+        case '^':
+            return c == '[' ? APEX_FEATURE_FOOTNOTE : 0;
+        case '<':
+            return c == '!' ? APEX_FEATURE_HTML_DECL : 0;
+        case '(':
+            return c == '!' ? APEX_FEATURE_INDEX : 0;
+        case '`':
+            return c == '`' ? APEX_FEATURE_FENCE : 0;
+        case '{':
+            switch (c) {
+                case '+': case '-': case '~': case '=': case '>':
+                    return APEX_FEATURE_CRITIC;
+                case ':': case '#': case '.':
+                    return APEX_FEATURE_IAL;
+                default:
+                    return 0;
+            }
+        default:
+            return 0;
+    }
+}
+
+apex_feature_bits apex_scan_features(const char *text, size_t len) {
+    if (!text) return 0;
+
+    const unsigned char *p = (const unsigned char *)text;
+    const unsigned char *end = p + len;
+    apex_feature_bits bits = 0;
+
+#ifdef SCAN_BLOCK
+    scan_vec stops[SCAN_STOP_COUNT];
+    for (size_t i = 0; i < SCAN_STOP_COUNT; i++) {
+#if defined(__SSE2__)
+        stops[i] = _mm_set1_epi8(scan_stop_bytes[i]);
+#else
+        stops[i] = vdupq_n_u8((uint8_t)scan_stop_bytes[i]);
+#endif
+    }
+#endif
+
+    while (p < end) {
+        const unsigned char *chunk_end = end;
+#ifdef SCAN_BLOCK
+        /* Skip whole blocks without a stop byte, then look at the first
+         * block that has one byte by byte */
+        while ((size_t)(end - p) >= SCAN_BLOCK && !scan_block_has_stop(p, stops)) {
+            p += SCAN_BLOCK;
+        }
+        if ((size_t)(end - p) >= SCAN_BLOCK) chunk_end = p + SCAN_BLOCK;
+#endif
+        for (; p < chunk_end; p++) {
+            if (!scan_stop[*p]) continue;
+            bits |= byte_features[*p];
+            if (p + 1 < end) bits |= pair_features(p[0], p[1]);
+            if (bits == APEX_FEATURE_ALL) return bits;
+        }
+    }
+
+    return bits;
+}
+
+void apex_feature_set_init(apex_feature_set *fs, const char *text) {
+    if (!fs) return;
+    fs->text = text;
+    fs->bits = text ? apex_scan_features(text, strlen(text)) : 0;
+    fs->stale = false;
+}
+
+void apex_features_invalidate(apex_feature_set *fs) {
+    if (fs) fs->stale = true;
+}
+
+/* Scan text again if the set no longer describes it */
+static void features_refresh(apex_feature_set *fs, const char *text) {
+    if (fs->stale || text != fs->text) {
+        apex_feature_set_init(fs, text);
+    }
+}
+
+apex_feature_bits apex_features_get(apex_feature_set *fs, const char *text) {
+    if (!fs) return APEX_FEATURE_ALL;
+    features_refresh(fs, text);
+    return fs->bits;
+}
+
+bool apex_features_any(apex_feature_set *fs, const char *text, apex_feature_bits mask) {
+    if (!fs) return true;
+    /* A bit seen before the text changed is still a safe "maybe" */
+    if (fs->bits & mask) return true;
+    features_refresh(fs, text);
+    return (fs->bits & mask) != 0;
+}
+
+bool apex_features_all(apex_feature_set *fs, const char *text, apex_feature_bits mask) {
+    if (!fs) return true;
+    if ((fs->bits & mask) == mask) return true;
+    features_refresh(fs, text);
+    return (fs->bits & mask) == mask;
+}
@@ -0,0 +1,111 @@
+/**
+ * Feature Sniffing for Apex
+ *
+ * One table-driven pass over the source records which trigger characters
+ * and two-byte sequences occur anywhere in it. Preprocessing stages whose
+ * syntax cannot appear in the text (no "==" means no highlights, no "::"
+ * means no fenced divs, ...) are skipped instead of copying and rescanning
+ * the whole document for nothing.
+ *
+ * The bits are conservative: a set bit only means the stage might have
+ * work to do, a clear bit means it provably has none.
+ *
+ * The scan only stops at trigger bytes and the first bytes of trigger
+ * pairs; with SSE2 or NEON it skips 16 bytes at a time until a block
+ * holds one.
+ */
+
+#ifndef APEX_FEATURE_SCAN_H
+#define APEX_FEATURE_SCAN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t apex_feature_bits;
+
+/* Single trigger characters */
+#define APEX_FEATURE_PLUS            ((apex_feature_bits)1 << 0)   /* +  grid tables */
+#define APEX_FEATURE_CARET           ((apex_feature_bits)1 << 1)   /* ^  superscript, end-of-block */
+#define APEX_FEATURE_TILDE           ((apex_feature_bits)1 << 2)   /* ~  subscript */
+#define APEX_FEATURE_BRACE           ((apex_feature_bits)1 << 3)   /* {  IAL, index, markers */
+#define APEX_FEATURE_BRACKET         ((apex_feature_bits)1 << 4)   /* [  spans, links */
+#define APEX_FEATURE_COLON           ((apex_feature_bits)1 << 5)   /* :  emoji, definition lists */
+#define APEX_FEATURE_HASH            ((apex_feature_bits)1 << 6)   /* #  hashtags */
+#define APEX_FEATURE_PIPE            ((apex_feature_bits)1 << 17)  /* |  tables */
+#define APEX_FEATURE_LT              ((apex_feature_bits)1 << 18)  /* <  markdown in HTML */
+
+/* Two-byte sequences */
+#define APEX_FEATURE_DOUBLE_PLUS     ((apex_feature_bits)1 << 7)   /* ++ inserts */
+#define APEX_FEATURE_DOUBLE_EQUALS   ((apex_feature_bits)1 << 8)   /* == highlights */
+#define APEX_FEATURE_DOUBLE_TILDE    ((apex_feature_bits)1 << 9)   /* ~~ proofreader deletions */
+#define APEX_FEATURE_DOUBLE_COLON    ((apex_feature_bits)1 << 10)  /* :: fenced divs, callouts */
+#define APEX_FEATURE_DOUBLE_BRACKET  ((apex_feature_bits)1 << 11)  /* [[ wiki links */
+#define APEX_FEATURE_CRITIC          ((apex_feature_bits)1 << 12)  /* {+ {- {~ {= {> */
+#define APEX_FEATURE_FOOTNOTE        ((apex_feature_bits)1 << 13)  /* ^[ [^ */
+#define APEX_FEATURE_HTML_DECL       ((apex_feature_bits)1 << 14)  /* <! comments, markers */
+#define APEX_FEATURE_IAL             ((apex_feature_bits)1 << 15)  /* {: {# {. */
+#define APEX_FEATURE_INDEX           ((apex_feature_bits)1 << 16)  /* (! mmark index */
+#define APEX_FEATURE_FENCE           ((apex_feature_bits)1 << 19)  /* `` inline table fences */
+
+#define APEX_FEATURE_ALL             (((apex_feature_bits)1 << 20) - 1)
+
+/**
+ * Scan `len` bytes of text
+ * @return Bitmask of APEX_FEATURE_* present in the text
+ */
+apex_feature_bits apex_scan_features(const char *text, size_t len);
+
+/**
+ * Feature bits for the current pipeline text. After the text changes
+ * (apex_features_invalidate(), or a query about a different buffer) the
+ * bits from the last scan are kept: a stage that removed its triggers
+ * only costs a stage that runs for nothing, so a bit that was set still
+ * answers "maybe". The text is scanned again only when a query would
+ * otherwise skip a stage, because a stage before it may have added the
+ * trigger. Most stages leave the answer unchanged, so a pipeline with its
+ * triggers present rescans rarely.
+ *
+ * The address alone is not enough to tell texts apart: a buffer freed
+ * mid-pipeline can come back from malloc at the same address with
+ * different text, so the pipeline invalidates the set whenever it moves
+ * on to a new buffer.
+ */
+typedef struct {
+    apex_feature_bits bits;     /* From the last scan */
+    const char *text;           /* Text of the last scan */
+    bool stale;                 /* The text changed since */
+} apex_feature_set;
+
+void apex_feature_set_init(apex_feature_set *fs, const char *text);
+
+/**
+ * Note that the text changed; a query whose answer is no longer known
+ * rescans it
+ */
+void apex_features_invalidate(apex_feature_set *fs);
+
+/**
+ * Exact feature bits of `text` (rescans a stale set)
+ */
+apex_feature_bits apex_features_get(apex_feature_set *fs, const char *text);
+
+/**
+ * True if `text` may contain a feature in `mask`
+ */
+bool apex_features_any(apex_feature_set *fs, const char *text, apex_feature_bits mask);
+
+/**
+ * True if `text` may contain every feature in `mask`
+ */
+bool apex_features_all(apex_feature_set *fs, const char *text, apex_feature_bits mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APEX_FEATURE_SCAN_H */
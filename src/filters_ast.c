@@ -1,5 +1,7 @@
 #include "filters_ast.h"
 #include "ast_json.h"
+#include "plugins.h"
+#include "stats.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -24,19 +26,24 @@ static char *run_single_ast_filter(const char *cmd,
                                    const char *json_input) {
     if (!cmd || !*cmd || !json_input) return NULL;
 
-    /* Ensure target format env var is visible to the child process. */
-    if (target_format && *target_format) {
-        setenv("APEX_TARGET_FORMAT", target_format, 1);
-    }
+    /* Expose the target format to the child process only. */
+    const char *env_pairs[] = {
+        "APEX_TARGET_FORMAT", (target_format && *target_format) ? target_format : NULL,
+        NULL
+    };
+    char **envp = apex_child_env_new(env_pairs);
+    if (!envp) return NULL;
 
     int in_pipe[2];
     int out_pipe[2];
     if (pipe(in_pipe) == -1 || pipe(out_pipe) == -1) {
+        apex_child_env_free(envp);
         return NULL;
     }
 
     pid_t pid = fork();
     if (pid == -1) {
+        apex_child_env_free(envp);
         close(in_pipe[0]); close(in_pipe[1]);
         close(out_pipe[0]); close(out_pipe[1]);
         return NULL;
@@ -49,11 +56,12 @@ static char *run_single_ast_filter(const char *cmd,
         close(in_pipe[0]); close(in_pipe[1]);
         close(out_pipe[0]); close(out_pipe[1]);
 
-        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        execle("/bin/sh", "sh", "-c", cmd, (char *)NULL, envp);
         _exit(127);
     }
 
     /* Parent */
+    apex_child_env_free(envp);
     close(in_pipe[0]);
     close(out_pipe[1]);
 
@@ -150,7 +158,9 @@ cmark_node *apex_run_ast_filters(cmark_node *document,
         }
 
         /* Run external filter */
+        uint64_t started = apex_stats_subprocess_begin();
         char *json_out = run_single_ast_filter(cmd, target_format, json_in);
+        apex_stats_subprocess_end(started);
         free(json_in);
 
         if (!json_out) {
@@ -5,7 +5,11 @@
 
 #include "html_renderer.h"
 #include "table.h"  /* For CMARK_NODE_TABLE */
+#include "strikethrough.h"
+#include "cmark-gfm-core-extensions.h"
 #include "extensions/header_ids.h"
+#include "render_cache.h"
+#include "attr_pool.h"
 #include <string.h>
 #include <strings.h>  /* For strncasecmp */
 #include <stdlib.h>
@@ -14,148 +18,6 @@
 #include <ctype.h>
 #include <sys/stat.h>
 
-/**
- * Inject attributes into HTML opening tags
- * This postprocesses the HTML output to add attributes stored in user_data
- */
-__attribute__((unused))
-static char *inject_attributes_in_html(const char *html, cmark_node *document) {
-    if (!html || !document) return html ? strdup(html) : NULL;
-
-    /* For now, we'll use a simpler approach: */
-    /* Since we can't easily modify cmark's renderer, we'll inject attributes */
-    /* by pattern matching on the HTML output */
-
-    /* This is a simplified implementation */
-    /* A full implementation would require forking cmark's HTML renderer */
-
-    return strdup(html);
-}
-
-/**
- * Walk AST and collect nodes with attributes
- */
-typedef struct attr_node {
-    cmark_node *node;
-    char *attrs;
-    cmark_node_type node_type;
-    int element_index;  /* nth element of this type (0=first p, 1=second p, etc.) */
-    char *text_fingerprint;  /* First 50 chars of text content for matching */
-    struct attr_node *next;
-} attr_node;
-
-/**
- * Extract IAL attributes (id, class, key="value") from attribute string,
- * excluding internal attributes like data-caption, data-remove, colspan, rowspan
- * Returns a newly allocated string with just the IAL attributes, or NULL if none found
- */
-static char *extract_ial_from_table_attrs(const char *attrs) {
-    if (!attrs) return NULL;
-
-    size_t result_cap = strlen(attrs) + 1;
-    char *result = malloc(result_cap);
-    if (!result) return NULL;
-    char *write = result;
-    *write = '\0';
-
-    const char *p = attrs;
-
-    /* Skip leading whitespace */
-    while (*p && isspace((unsigned char)*p)) p++;
-
-    while (*p) {
-        const char *attr_start = p;
-
-        /* Find end of attribute name or = */
-        const char *attr_name_end = p;
-        while (*attr_name_end && *attr_name_end != '=' && *attr_name_end != ' ' && *attr_name_end != '\t') {
-            attr_name_end++;
-        }
-
-        size_t attr_name_len = attr_name_end - attr_start;
-
-        /* Check if this is an internal attribute we should skip */
-        bool skip = false;
-        if (attr_name_len == 11 && strncmp(attr_start, "data-caption", 11) == 0) skip = true;
-        else if (attr_name_len == 11 && strncmp(attr_start, "data-remove", 11) == 0) skip = true;
-        else if (attr_name_len == 7 && strncmp(attr_start, "colspan", 7) == 0) skip = true;
-        else if (attr_name_len == 7 && strncmp(attr_start, "rowspan", 7) == 0) skip = true;
-
-        if (!skip) {
-            /* This is an IAL attribute - find the full attribute (name="value" or name='value') */
-            const char *attr_end = attr_name_end;
-            if (*attr_end == '=') {
-                attr_end++;
-                if (*attr_end == '"' || *attr_end == '\'') {
-                    char q = *attr_end;
-                    attr_end++;
-                    while (*attr_end && *attr_end != q) {
-                        if (*attr_end == '\\' && *(attr_end + 1)) attr_end++;
-                        attr_end++;
-                    }
-                    if (*attr_end == q) attr_end++;
-                } else {
-                    /* Unquoted value */
-                    while (*attr_end && *attr_end != ' ' && *attr_end != '\t') attr_end++;
-                }
-            }
-
-            /* Copy this attribute to result */
-            size_t attr_len = attr_end - attr_start;
-            if ((size_t)(write - result) + attr_len + 2 >= result_cap) {
-                /* Need to realloc */
-                size_t current_len = write - result;
-                result_cap = (current_len + attr_len + 2) * 2;
-                char *new_result = realloc(result, result_cap);
-                if (!new_result) {
-                    free(result);
-                    return NULL;
-                }
-                result = new_result;
-                write = result + current_len;
-            }
-
-            /* Add space before attribute if needed (always for first attribute, or if previous doesn't end with space) */
-            if (write == result || (write > result && write[-1] != ' ')) {
-                *write++ = ' ';
-            }
-            memcpy(write, attr_start, attr_len);
-            write += attr_len;
-            *write = '\0';
-
-            p = attr_end;
-        } else {
-            /* Skip this attribute - find its end */
-            if (*attr_name_end == '=') {
-                attr_name_end++;
-                if (*attr_name_end == '"' || *attr_name_end == '\'') {
-                    char q = *attr_name_end;
-                    attr_name_end++;
-                    while (*attr_name_end && *attr_name_end != q) {
-                        if (*attr_name_end == '\\' && *(attr_name_end + 1)) attr_name_end++;
-                        attr_name_end++;
-                    }
-                    if (*attr_name_end == q) attr_name_end++;
-                } else {
-                    while (*attr_name_end && *attr_name_end != ' ' && *attr_name_end != '\t') attr_name_end++;
-                }
-            }
-            p = attr_name_end;
-        }
-
-        /* Skip whitespace before next attribute */
-        while (*p && isspace((unsigned char)*p)) p++;
-    }
-
-    if (write == result) {
-        /* No IAL attributes found */
-        free(result);
-        return NULL;
-    }
-
-    return result;
-}
-
 /**
  * Extract value of an attribute from an HTML tag.
  * Returns newly allocated string or NULL. Caller must free.
@@ -254,27 +116,6 @@ static const char *video_type_from_url(const char *url) {
     return "video/mp4";
 }
 
-/**
- * Extract value of data-apex-picture-webp or data-apex-picture-avif from attrs string.
- * Format: data-apex-picture-webp="value" or data-apex-picture-avif="value"
- * Caller must free.
- */
-static char *extract_data_apex_picture_srcset(const char *attrs, const char *format) {
-    char key[64];
-    snprintf(key, sizeof(key), "data-apex-picture-%s=\"", format);
-    const char *p = strstr(attrs, key);
-    if (!p) return NULL;
-    p += strlen(key);
-    const char *end = strchr(p, '"');
-    if (!end) return NULL;
-    size_t len = (size_t)(end - p);
-    char *out = malloc(len + 1);
-    if (!out) return NULL;
-    memcpy(out, p, len);
-    out[len] = '\0';
-    return out;
-}
-
 /**
  * Return attrs with internal data-apex-* and core img attrs removed.
  * Keeps user-specified attrs (e.g. width/height/loading/class/style) for img fallback.
@@ -336,875 +177,1233 @@ static char *filter_img_fallback_attrs(const char *attrs) {
     return out;
 }
 
-/* Counters for element indexing */
+/* ------------------------------------------------------------------------- */
+/* Native HTML renderer                                                      */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Mirrors cmark-gfm's html.c (and the table, strikethrough and tasklist
+ * extension renderers) through the public node API, so attributes stored in
+ * a node's user_data are written into its opening tag as the tag is emitted.
+ * Unknown extension nodes depend on renderer state cmark doesn't expose;
+ * those subtrees are rendered by cmark itself. Footnote definitions are
+ * rendered by cmark around placeholders for their blocks, which are
+ * rendered here.
+ */
+
 typedef struct {
-    int para_count;
-    int heading_count;
-    int table_count;
-    int blockquote_count;
-    int list_count;
-    int item_count;
-    int code_count;
-    int link_count;
-    int image_count;
-    int strong_count;
-    int emph_count;
-    int code_inline_count;
-} element_counters;
+    char *data;
+    size_t len;
+    size_t cap;
+    bool failed;
+    apex_attr_pool *attrs;  /* Typed view of node user_data, parsed once per node */
+} html_out;
+
+static void html_out_put(html_out *out, const char *s, size_t n) {
+    if (out->failed || n == 0) return;
+    if (out->len + n + 1 > out->cap) {
+        size_t new_cap = out->cap ? out->cap * 2 : 4096;
+        while (out->len + n + 1 > new_cap) new_cap *= 2;
+        char *grown = realloc(out->data, new_cap);
+        if (!grown) {
+            out->failed = true;
+            return;
+        }
+        out->data = grown;
+        out->cap = new_cap;
+    }
+    memcpy(out->data + out->len, s, n);
+    out->len += n;
+    out->data[out->len] = '\0';
+}
+
+static void html_out_puts(html_out *out, const char *s) {
+    if (s) html_out_put(out, s, strlen(s));
+}
+
+static void html_out_putc(html_out *out, char c) {
+    html_out_put(out, &c, 1);
+}
+
+/* Same as cmark_html_render_cr: start a new line unless already at one */
+static void html_out_cr(html_out *out) {
+    if (out->len > 0 && out->data[out->len - 1] != '\n') {
+        html_out_putc(out, '\n');
+    }
+}
+
+/* houdini_escape_html0 with secure=0: only & < > " are escaped */
+static void html_out_escape(html_out *out, const char *s, size_t n) {
+    if (!s) return;
+    size_t run = 0;
+    for (size_t i = 0; i < n; i++) {
+        const char *rep = NULL;
+        switch (s[i]) {
+            case '&': rep = "&amp;"; break;
+            case '<': rep = "&lt;"; break;
+            case '>': rep = "&gt;"; break;
+            case '"': rep = "&quot;"; break;
+            default: continue;
+        }
+        html_out_put(out, s + run, i - run);
+        html_out_puts(out, rep);
+        run = i + 1;
+    }
+    html_out_put(out, s + run, n - run);
+}
+
+static void html_out_escape_str(html_out *out, const char *s) {
+    if (s) html_out_escape(out, s, strlen(s));
+}
+
+/* houdini_escape_href: keep URL-safe bytes, entity-encode & and ', %-encode the rest */
+static void html_out_escape_href(html_out *out, const char *s) {
+    static const char hex[] = "0123456789ABCDEF";
+    if (!s) return;
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        unsigned char c = *p;
+        if (isalnum(c) || (c < 0x80 && strchr("-_.+!*(),%#@?=;:/$~", c))) {
+            html_out_putc(out, (char)c);
+        } else if (c == '&') {
+            html_out_puts(out, "&amp;");
+        } else if (c == '\'') {
+            html_out_puts(out, "&#x27;");
+        } else {
+            char enc[3] = { '%', hex[c >> 4], hex[c & 0xF] };
+            html_out_put(out, enc, 3);
+        }
+    }
+}
+
+/* Same rule as cmark's _scan_dangerous_url */
+static bool url_is_dangerous(const char *url) {
+    if (!url) return false;
+    if (strncasecmp(url, "javascript:", 11) == 0 ||
+        strncasecmp(url, "vbscript:", 9) == 0 ||
+        strncasecmp(url, "file:", 5) == 0) {
+        return true;
+    }
+    if (strncasecmp(url, "data:", 5) == 0) {
+        const char *rest = url + 5;
+        return !(strncasecmp(rest, "image/png", 9) == 0 ||
+                 strncasecmp(rest, "image/gif", 9) == 0 ||
+                 strncasecmp(rest, "image/jpeg", 10) == 0 ||
+                 strncasecmp(rest, "image/webp", 10) == 0);
+    }
+    return false;
+}
+
+static void html_out_url(html_out *out, const char *url, int options) {
+    if ((options & CMARK_OPT_UNSAFE) || !url_is_dangerous(url)) {
+        html_out_escape_href(out, url);
+    }
+}
+
+static void html_out_sourcepos(html_out *out, cmark_node *node, int options) {
+    if (!(options & CMARK_OPT_SOURCEPOS)) return;
+    char buffer[100];
+    snprintf(buffer, sizeof(buffer), " data-sourcepos=\"%d:%d-%d:%d\"",
+             cmark_node_get_start_line(node), cmark_node_get_start_column(node),
+             cmark_node_get_end_line(node), cmark_node_get_end_column(node));
+    html_out_puts(out, buffer);
+}
+
+/* Append the string rendering of a subtree, as cmark would produce it */
+static void html_out_cmark(html_out *out, cmark_node *node, int options) {
+    char *rendered = cmark_render_html(node, options, NULL);
+    if (!rendered) {
+        out->failed = true;
+        return;
+    }
+    html_out_puts(out, rendered);
+    free(rendered);
+}
 
 /**
- * Get text fingerprint from node (first 50 chars for matching)
+ * Node types whose user_data attributes are written into the opening tag
  */
-static char *get_node_text_fingerprint(cmark_node *node) {
-    if (!node) return NULL;
+static bool node_takes_attributes(cmark_node_type type) {
+    switch (type) {
+        case CMARK_NODE_PARAGRAPH:
+        case CMARK_NODE_HEADING:
+        case CMARK_NODE_BLOCK_QUOTE:
+        case CMARK_NODE_LIST:
+        case CMARK_NODE_ITEM:
+        case CMARK_NODE_CODE_BLOCK:
+        case CMARK_NODE_LINK:
+        case CMARK_NODE_IMAGE:
+        case CMARK_NODE_STRONG:
+        case CMARK_NODE_EMPH:
+        case CMARK_NODE_CODE:
+            return true;
+        default:
+            return type == CMARK_NODE_TABLE;
+    }
+}
 
-    cmark_node_type type = cmark_node_get_type(node);
+static const char *node_attrs(cmark_node *node) {
+    if (!node_takes_attributes(cmark_node_get_type(node))) return NULL;
+    const char *attrs = (const char *)cmark_node_get_user_data(node);
+    return attrs && *attrs ? attrs : NULL;
+}
 
-    /* For headings, get the literal */
-    if (type == CMARK_NODE_HEADING) {
-        cmark_node *text = cmark_node_first_child(node);
-        if (text && cmark_node_get_type(text) == CMARK_NODE_TEXT) {
-            const char *literal = cmark_node_get_literal(text);
-            if (literal) {
-                size_t len = strlen(literal);
-                if (len > 50) len = 50;
-                char *fingerprint = malloc(len + 1);
-                if (fingerprint) {
-                    memcpy(fingerprint, literal, len);
-                    fingerprint[len] = '\0';
-                    return fingerprint;
-                }
-            }
+/* Write serialized attributes after a tag name */
+static void html_out_attr_string(html_out *out, const char *attrs) {
+    while (isspace((unsigned char)*attrs)) attrs++;
+    size_t len = strlen(attrs);
+    while (len > 0 && isspace((unsigned char)attrs[len - 1])) len--;
+    if (len > 0) {
+        html_out_putc(out, ' ');
+        html_out_put(out, attrs, len);
+    }
+}
+
+/**
+ * Write a node's attributes after its tag name. Typed attributes (IAL,
+ * ALDs, header IDs) are serialized here; image attributes are still a string.
+ */
+static void html_out_node_attrs(html_out *out, cmark_node *node) {
+    if (!node_takes_attributes(cmark_node_get_type(node))) return;
+
+    const apex_attributes *typed = apex_node_attributes(node);
+    if (typed) {
+        char *attrs = attributes_to_html(typed);
+        if (!attrs) {
+            out->failed = true;
+            return;
         }
+        html_out_attr_string(out, attrs);
+        free(attrs);
+        return;
     }
 
-    /* For paragraphs, get text from first text node */
-    if (type == CMARK_NODE_PARAGRAPH) {
-        cmark_node *child = cmark_node_first_child(node);
-        if (child && cmark_node_get_type(child) == CMARK_NODE_TEXT) {
-            const char *literal = cmark_node_get_literal(child);
-            if (literal) {
-                size_t len = strlen(literal);
-                if (len > 50) len = 50;
-                char *fingerprint = malloc(len + 1);
-                if (fingerprint) {
-                    memcpy(fingerprint, literal, len);
-                    fingerprint[len] = '\0';
-                    return fingerprint;
-                }
+    const char *attrs = node_attrs(node);
+    if (attrs) html_out_attr_string(out, attrs);
+}
+
+/* Markers advanced_tables leaves for the renderer, never written as attributes */
+static bool table_attr_is_internal(const char *key) {
+    return strcmp(key, "data-caption") == 0 || strcmp(key, "data-remove") == 0 ||
+           strcmp(key, "data-tfoot") == 0 || strcmp(key, "colspan") == 0 ||
+           strcmp(key, "rowspan") == 0;
+}
+
+/**
+ * Write a table's IAL attributes, leaving out the markers advanced_tables
+ * adds (its caption is written as a figcaption instead)
+ */
+static void html_out_table_attrs(html_out *out, cmark_node *node) {
+    const apex_attributes *typed = apex_node_attributes(node);
+    if (typed) {
+        /* A view of the IAL without the markers; the strings stay typed's */
+        apex_attributes view = *typed;
+        view.keys = malloc(sizeof(char *) * (size_t)(typed->attr_count + 1));
+        view.values = malloc(sizeof(char *) * (size_t)(typed->attr_count + 1));
+        view.attr_count = 0;
+        char *serialized = NULL;
+        if (view.keys && view.values) {
+            for (int i = 0; i < typed->attr_count; i++) {
+                if (table_attr_is_internal(typed->keys[i])) continue;
+                view.keys[view.attr_count] = typed->keys[i];
+                view.values[view.attr_count++] = typed->values[i];
             }
+            serialized = attributes_to_html(&view);
+        }
+        free(view.keys);
+        free(view.values);
+        if (!serialized) {
+            out->failed = true;
+            return;
         }
+        html_out_attr_string(out, serialized);
+        free(serialized);
+        return;
     }
 
-    /* For links, use URL + link text (first text child) to disambiguate
-     * same-href links and avoid matching raw HTML <a> tags. */
-    if (type == CMARK_NODE_LINK) {
-        const char *url = cmark_node_get_url(node);
-        if (url) {
-            size_t url_len = strlen(url);
-            if (url_len > 50) url_len = 50;
-            const char *text = NULL;
-            for (cmark_node *child = cmark_node_first_child(node); child;
-                 child = cmark_node_next(child)) {
-                if (cmark_node_get_type(child) == CMARK_NODE_TEXT) {
-                    text = cmark_node_get_literal(child);
-                    if (text && *text) break;
-                    text = NULL;
-                }
-            }
-            size_t text_len = text ? strlen(text) : 0;
-            if (text_len > 20) text_len = 20;
-            size_t total = url_len + (text_len ? 1 + text_len : 0);
-            if (total > 50) total = 50;
-            char *fingerprint = malloc(total + 1);
-            if (fingerprint) {
-                memcpy(fingerprint, url, url_len);
-                size_t pos = url_len;
-                if (text_len && pos + 1 + text_len <= 50) {
-                    fingerprint[pos++] = '|';
-                    memcpy(fingerprint + pos, text, text_len);
-                    pos += text_len;
-                }
-                fingerprint[pos] = '\0';
-                return fingerprint;
-            }
+    const apex_attributes *attrs = apex_attr_pool_get(out->attrs, node);
+    if (!attrs) return;
+
+    if (attrs->id) {
+        html_out_puts(out, " id=\"");
+        html_out_puts(out, attrs->id);
+        html_out_putc(out, '"');
+    }
+    if (attrs->class_count > 0) {
+        html_out_puts(out, " class=\"");
+        for (int i = 0; i < attrs->class_count; i++) {
+            if (i > 0) html_out_putc(out, ' ');
+            html_out_puts(out, attrs->classes[i]);
         }
+        html_out_putc(out, '"');
+    }
+    for (int i = 0; i < attrs->attr_count; i++) {
+        if (table_attr_is_internal(attrs->keys[i])) continue;
+        html_out_putc(out, ' ');
+        html_out_puts(out, attrs->keys[i]);
+        if (!attrs->values[i] || !*attrs->values[i]) continue;
+        /* Values were single-quoted in the source if they hold a double quote */
+        char quote = strchr(attrs->values[i], '"') ? '\'' : '"';
+        html_out_putc(out, '=');
+        html_out_putc(out, quote);
+        html_out_puts(out, attrs->values[i]);
+        html_out_putc(out, quote);
     }
+}
 
-    /* For images, use URL + alt (from first child) to disambiguate same-src images */
-    if (type == CMARK_NODE_IMAGE) {
-        const char *url = cmark_node_get_url(node);
-        if (url) {
-            size_t url_len = strlen(url);
-            if (url_len > 50) url_len = 50;
-            cmark_node *child = cmark_node_first_child(node);
-            const char *alt = (child && cmark_node_get_type(child) == CMARK_NODE_TEXT) ?
-                cmark_node_get_literal(child) : NULL;
-            size_t alt_len = alt ? strlen(alt) : 0;
-            if (alt_len > 20) alt_len = 20;
-            size_t total = url_len + (alt_len ? 1 + alt_len : 0);
-            if (total > 50) total = 50;
-            char *fingerprint = malloc(total + 1);
-            if (fingerprint) {
-                memcpy(fingerprint, url, url_len);
-                size_t pos = url_len;
-                if (alt_len && pos + 1 + alt_len <= 50) {
-                    fingerprint[pos++] = '|';
-                    memcpy(fingerprint + pos, alt, alt_len);
-                    pos += alt_len;
-                }
-                fingerprint[pos] = '\0';
-                return fingerprint;
-            }
+/* Image alt text: cmark's "plain" mode over the image's children */
+static void html_out_plain(html_out *out, cmark_node *node) {
+    for (cmark_node *child = cmark_node_first_child(node); child; child = cmark_node_next(child)) {
+        switch (cmark_node_get_type(child)) {
+            case CMARK_NODE_TEXT:
+            case CMARK_NODE_CODE:
+            case CMARK_NODE_HTML_INLINE:
+                html_out_escape_str(out, cmark_node_get_literal(child));
+                break;
+            case CMARK_NODE_LINEBREAK:
+            case CMARK_NODE_SOFTBREAK:
+                html_out_putc(out, ' ');
+                break;
+            default:
+                html_out_plain(out, child);
+                break;
         }
     }
+}
 
-    return NULL;
+/**
+ * Render an image whose attributes ask for a <video> or <picture> element
+ */
+static void html_out_media_replacement(html_out *out, const apex_attributes *media, const char *attrs,
+                                       const char *src, const char *alt, const char *title) {
+    if (apex_attributes_has(media, "data-apex-replace-video")) {
+        /* <video> with <source> elements. Order: webm, ogg, mp4/mov/m4v (primary) */
+        static const struct { const char *marker; const char *ext; const char *type; } variants[] = {
+            { "data-apex-video-webm", "webm", "video/webm" },
+            { "data-apex-video-ogg", "ogg", "video/ogg" },
+            { "data-apex-video-mp4", "mp4", "video/mp4" },
+            { "data-apex-video-mov", "mov", "video/quicktime" },
+            { "data-apex-video-m4v", "m4v", "video/mp4" },
+        };
+        html_out_puts(out, "<video");
+        if (*alt) {
+            html_out_puts(out, " title=\"");
+            html_out_puts(out, alt);
+            html_out_putc(out, '"');
+        }
+        html_out_putc(out, '>');
+        for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+            if (!apex_attributes_has(media, variants[i].marker)) continue;
+            char *u = url_with_extension(src, variants[i].ext);
+            if (!u) continue;
+            html_out_puts(out, "<source src=\"");
+            html_out_puts(out, u);
+            html_out_puts(out, "\" type=\"");
+            html_out_puts(out, variants[i].type);
+            html_out_puts(out, "\">");
+            free(u);
+        }
+        /* Primary src as fallback (always include) */
+        html_out_puts(out, "<source src=\"");
+        html_out_puts(out, src);
+        html_out_puts(out, "\" type=\"");
+        html_out_puts(out, video_type_from_url(src));
+        html_out_puts(out, "\"></video>");
+        return;
+    }
+
+    /* <picture> with <source> elements and <img> fallback */
+    const char *webp_srcset = apex_attributes_get(media, "data-apex-picture-webp");
+    const char *avif_srcset = apex_attributes_get(media, "data-apex-picture-avif");
+    char *img_fallback_attrs = filter_img_fallback_attrs(attrs);
+
+    html_out_puts(out, "<picture>");
+    if (avif_srcset) {
+        html_out_puts(out, "<source type=\"image/avif\" srcset=\"");
+        html_out_puts(out, avif_srcset);
+        html_out_puts(out, "\">");
+    }
+    if (webp_srcset) {
+        html_out_puts(out, "<source type=\"image/webp\" srcset=\"");
+        html_out_puts(out, webp_srcset);
+        html_out_puts(out, "\">");
+    }
+    html_out_puts(out, "<img src=\"");
+    html_out_puts(out, src);
+    html_out_puts(out, "\" alt=\"");
+    html_out_puts(out, alt);
+    html_out_putc(out, '"');
+    /* Preserve title on img for caption logic (apex_convert_image_captions) */
+    if (title && *title) {
+        html_out_puts(out, " title=\"");
+        html_out_puts(out, title);
+        html_out_putc(out, '"');
+    }
+    if (img_fallback_attrs && *img_fallback_attrs) {
+        html_out_putc(out, ' ');
+        html_out_puts(out, img_fallback_attrs);
+    }
+    html_out_puts(out, "></picture>");
+
+    free(img_fallback_attrs);
 }
 
-static void collect_nodes_with_attrs_recursive(cmark_node *node, attr_node **list, element_counters *counters) {
-    if (!node) return;
+static void html_out_image(html_out *out, cmark_node *node, int options) {
+    const char *attrs = node_attrs(node);
+    const apex_attributes *media = attrs ? apex_attr_pool_get(out->attrs, node) : NULL;
 
-    cmark_node_type type = cmark_node_get_type(node);
+    if (apex_attributes_has(media, "data-apex-replace-video") ||
+        apex_attributes_has(media, "data-apex-replace-picture")) {
+        html_out src = {0}, alt = {0}, title = {0};
+        html_out_url(&src, cmark_node_get_url(node), options);
+        html_out_plain(&alt, node);
+        html_out_escape_str(&title, cmark_node_get_title(node));
+
+        /* Fallback: title may be in the IAL attrs */
+        const char *attr_title = title.len ? NULL : apex_attributes_get(media, "title");
 
-    /* Increment counter for this element type */
-    int elem_idx = -1;
-    if (type == CMARK_NODE_PARAGRAPH) elem_idx = counters->para_count++;
-    else if (type >= CMARK_NODE_HEADING && type <= CMARK_NODE_HEADING + 5) elem_idx = counters->heading_count++;
-    else if (type == CMARK_NODE_TABLE) {
-        /* For tables, increment the counter first, then use (count - 1) as the index */
-        /* This ensures the index matches the HTML renderer's count of <table> tags */
-        elem_idx = counters->table_count++;
+        if (!src.failed && !alt.failed && !title.failed) {
+            html_out_media_replacement(out, media, attrs, src.data ? src.data : "", alt.data ? alt.data : "",
+                                       attr_title ? attr_title : title.data);
+        } else {
+            out->failed = true;
+        }
+        free(src.data);
+        free(alt.data);
+        free(title.data);
+        return;
+    }
+
+    html_out_puts(out, "<img src=\"");
+    html_out_url(out, cmark_node_get_url(node), options);
+    html_out_puts(out, "\" alt=\"");
+    html_out_plain(out, node);
+    const char *title = cmark_node_get_title(node);
+    if (title && *title) {
+        html_out_puts(out, "\" title=\"");
+        html_out_escape_str(out, title);
     }
-    else if (type == CMARK_NODE_BLOCK_QUOTE) elem_idx = counters->blockquote_count++;
-    else if (type == CMARK_NODE_LIST) elem_idx = counters->list_count++;
-    else if (type == CMARK_NODE_ITEM) elem_idx = counters->item_count++;
-    else if (type == CMARK_NODE_CODE_BLOCK) elem_idx = counters->code_count++;
-    /* Inline elements need indices too - each type has its own counter */
-    else if (type == CMARK_NODE_LINK) elem_idx = counters->link_count++;
-    else if (type == CMARK_NODE_IMAGE) elem_idx = counters->image_count++;
-    else if (type == CMARK_NODE_STRONG) elem_idx = counters->strong_count++;
-    else if (type == CMARK_NODE_EMPH) elem_idx = counters->emph_count++;
-    else if (type == CMARK_NODE_CODE) elem_idx = counters->code_inline_count++;
-
-    /* Check if this node has attributes */
-    void *user_data = cmark_node_get_user_data(node);
-    if (user_data) {
-        attr_node *new_node = malloc(sizeof(attr_node));
-        if (new_node) {
-            new_node->node = node;
-            new_node->attrs = (char *)user_data;
-            new_node->node_type = type;
-            new_node->element_index = elem_idx;
-            new_node->text_fingerprint = get_node_text_fingerprint(node);
-            new_node->next = *list;
-            *list = new_node;
+    html_out_putc(out, '"');
+    html_out_node_attrs(out, node);
+    html_out_puts(out, " />");
+}
+
+static void html_out_code_block(html_out *out, cmark_node *node, int options) {
+    const char *info = cmark_node_get_fence_info(node);
+    const char *literal = cmark_node_get_literal(node);
+
+    html_out_cr(out);
+    html_out_puts(out, "<pre");
+    html_out_node_attrs(out, node);
+    html_out_sourcepos(out, node, options);
+
+    if (!info || !*info) {
+        html_out_puts(out, "><code>");
+    } else {
+        size_t info_len = strlen(info);
+        size_t first_tag = 0;
+        while (first_tag < info_len && !isspace((unsigned char)info[first_tag])) {
+            first_tag++;
         }
 
-        /* If node is marked for removal, don't traverse children */
-        if (strstr((char *)user_data, "data-remove")) {
-            return;
+        if (options & CMARK_OPT_GITHUB_PRE_LANG) {
+            html_out_puts(out, " lang=\"");
+        } else {
+            html_out_puts(out, "><code class=\"language-");
+        }
+        html_out_escape(out, info, first_tag);
+        if (first_tag < info_len && (options & CMARK_OPT_FULL_INFO_STRING)) {
+            html_out_puts(out, "\" data-meta=\"");
+            html_out_escape(out, info + first_tag + 1, info_len - first_tag - 1);
         }
+        html_out_puts(out, (options & CMARK_OPT_GITHUB_PRE_LANG) ? "\"><code>" : "\">");
     }
 
-    /* Recurse */
-    for (cmark_node *child = cmark_node_first_child(node); child; child = cmark_node_next(child)) {
-        collect_nodes_with_attrs_recursive(child, list, counters);
+    html_out_escape_str(out, literal);
+    html_out_puts(out, "</code></pre>\n");
+}
+
+static void html_out_table_align(html_out *out, const char *align, int options) {
+    if (options & CMARK_OPT_TABLE_PREFER_STYLE_ATTRIBUTES) {
+        html_out_puts(out, " style=\"text-align: ");
+    } else {
+        html_out_puts(out, " align=\"");
     }
+    html_out_puts(out, align);
+    html_out_putc(out, '"');
 }
 
-static void collect_nodes_with_attrs(cmark_node *node, attr_node **list) {
-    element_counters counters = {0};
-    collect_nodes_with_attrs_recursive(node, list, &counters);
-
-    /* Reverse the list: prepend builds [last_visited, ..., first_visited];
-     * we need document order [first, ..., last] for matching. */
-    attr_node *reversed = NULL;
-    while (*list) {
-        attr_node *next = (*list)->next;
-        (*list)->next = reversed;
-        reversed = *list;
-        *list = next;
+/* table.c swaps an escaped \<< in a cell for this so it isn't read as a colspan */
+#define ESCAPED_LTLT_PLACEHOLDER "APEXLTLT"
+#define ESCAPED_LTLT_PLACEHOLDER_LEN 8
+
+/* Escape text inside a table, turning the \<< placeholder back into << */
+static void html_out_escape_cell_text(html_out *out, const char *s) {
+    if (!s) return;
+    const char *hit;
+    while ((hit = strstr(s, ESCAPED_LTLT_PLACEHOLDER)) != NULL) {
+        html_out_escape(out, s, (size_t)(hit - s));
+        html_out_puts(out, "&lt;&lt;");
+        s = hit + ESCAPED_LTLT_PLACEHOLDER_LEN;
     }
-    *list = reversed;
+    html_out_escape_str(out, s);
+}
+
+/* Table state carried across row and cell events */
+typedef struct {
+    int caption_position;  /* 0 = figcaption above the table, 1 = below */
+    char *caption;         /* Caption of the open table, or NULL */
+    bool in_header;
+    bool in_table;
+    bool body_open;
+    bool foot_open;
+    bool row_headers;      /* Blank first header cell: body rows open with <th scope="row"> */
+    bool row_header_cell;  /* The open cell is one of those row headers */
+    int column;
+} html_table_state;
+
+/* Node marked by advanced_tables as merged into a span or as a marker */
+static bool node_removed(apex_attr_pool *pool, cmark_node *node) {
+    return apex_attributes_has(apex_attr_pool_get(pool, node), "data-remove");
+}
+
+/* Cell user_data holding colspan/rowspan (it can also hold raw cell text) */
+static const char *table_cell_span_attrs(apex_attr_pool *pool, cmark_node *cell) {
+    const apex_attributes *attrs = apex_attr_pool_get(pool, cell);
+    if (apex_attributes_has(attrs, "colspan") || apex_attributes_has(attrs, "rowspan")) {
+        return (const char *)cmark_node_get_user_data(cell);
+    }
+    return NULL;
+}
+
+/* First text literal of a cell, looking one level into inline containers */
+static const char *table_cell_text(cmark_node *cell) {
+    for (cmark_node *child = cmark_node_first_child(cell); child; child = cmark_node_next(child)) {
+        if (cmark_node_get_type(child) == CMARK_NODE_TEXT) return cmark_node_get_literal(child);
+        for (cmark_node *nested = cmark_node_first_child(child); nested; nested = cmark_node_next(nested)) {
+            if (cmark_node_get_type(nested) == CMARK_NODE_TEXT) return cmark_node_get_literal(nested);
+        }
+    }
+    return NULL;
 }
 
 /**
- * Enhanced HTML rendering with attribute support
+ * Whether a cell holds only text matching marker (NULL matches blank
+ * cells), ignoring surrounding whitespace. The inline parser can split
+ * "<<" into several text nodes, so all of them are compared in turn.
  */
-char *apex_render_html_with_attributes(cmark_node *document, int options) {
-    if (!document) return NULL;
+static bool table_cell_text_is(cmark_node *cell, const char *marker) {
+    const char *want = marker ? marker : "";
+    bool leading = true;
+    for (cmark_node *child = cmark_node_first_child(cell); child; child = cmark_node_next(child)) {
+        if (cmark_node_get_type(child) != CMARK_NODE_TEXT) return false;
+        const char *p = cmark_node_get_literal(child);
+        for (; p && *p; p++) {
+            if (isspace((unsigned char)*p)) {
+                if (!leading && *want) return false;
+                continue;
+            }
+            if (*p != *want) return false;
+            want++;
+            leading = false;
+        }
+    }
+    return *want == '\0';
+}
 
-    /* First, render normally */
-    char *html = cmark_render_html(document, options, NULL);
-    if (!html) return NULL;
+/* The === row that starts a tfoot: every cell removed, at least one === */
+static bool table_row_is_foot_marker(apex_attr_pool *pool, cmark_node *row) {
+    bool has_cells = false;
+    bool has_marker = false;
+    for (cmark_node *cell = cmark_node_first_child(row); cell; cell = cmark_node_next(cell)) {
+        if (cmark_node_get_type(cell) != CMARK_NODE_TABLE_CELL) continue;
+        if (!node_removed(pool, cell)) return false;
+        has_cells = true;
+        const char *text = table_cell_text(cell);
+        if (text) {
+            while (isspace((unsigned char)*text)) text++;
+            if (strncmp(text, "===", 3) == 0) has_marker = true;
+        }
+    }
+    return has_cells && has_marker;
+}
 
-    /* Collect all nodes with attributes */
-    attr_node *attr_list = NULL;
-    collect_nodes_with_attrs(document, &attr_list);
+/**
+ * Caption text of a [Caption] paragraph: a lone text literal in brackets, or
+ * a lone link when [Caption] matched a reference. *droppable is set when the
+ * paragraph is plain text and so must not be rendered next to the caption.
+ */
+static char *table_caption_from_paragraph(cmark_node *para, bool *droppable) {
+    *droppable = false;
+    if (!para || cmark_node_get_type(para) != CMARK_NODE_PARAGRAPH) return NULL;
+    cmark_node *child = cmark_node_first_child(para);
+    if (!child) return NULL;
+
+    if (cmark_node_get_type(child) == CMARK_NODE_TEXT) {
+        const char *text = cmark_node_get_literal(child);
+        if (!text || text[0] != '[') return NULL;
+        const char *end = strchr(text + 1, ']');
+        if (!end) return NULL;
+        for (const char *after = end + 1; *after; after++) {
+            if (!isspace((unsigned char)*after)) return NULL;
+        }
+        size_t len = (size_t)(end - text - 1);
+        if (len == 0 || len >= 512) return NULL;
+        *droppable = true;
+        return strndup(text + 1, len);
+    }
+    if (cmark_node_get_type(child) == CMARK_NODE_LINK) {
+        /* Footnote definitions like "[^1]: ..." parse as a link plus text */
+        cmark_node *link_text = cmark_node_first_child(child);
+        if (!link_text || cmark_node_get_type(link_text) != CMARK_NODE_TEXT) return NULL;
+        if (cmark_node_next(link_text) || cmark_node_next(child)) return NULL;
+        const char *text = cmark_node_get_literal(link_text);
+        return text ? strdup(text) : NULL;
+    }
+    return NULL;
+}
 
-    if (!attr_list) {
-        return html; /* No attributes to inject */
+/**
+ * Caption of a table: data-caption set by advanced_tables, or else a
+ * [Caption] paragraph right before or after the table (used when an IAL
+ * replaced the table's user_data). *para is set to a caption paragraph
+ * that is left out of the output. Returns NULL if there is no caption.
+ */
+static char *table_caption(apex_attr_pool *pool, cmark_node *table, cmark_node **para) {
+    *para = NULL;
+    const char *data = apex_attributes_get(apex_attr_pool_get(pool, table), "data-caption");
+    if (data) {
+        size_t len = strlen(data);
+        if (len > 511) len = 511;
+        return len > 0 ? strndup(data, len) : NULL;
     }
 
-    /* Build new HTML with attributes injected */
-    size_t html_len = strlen(html);
+    cmark_node *neighbours[2] = { cmark_node_previous(table), cmark_node_next(table) };
+    for (int i = 0; i < 2; i++) {
+        bool droppable;
+        char *caption = table_caption_from_paragraph(neighbours[i], &droppable);
+        if (caption) {
+            if (droppable) *para = neighbours[i];
+            return caption;
+        }
+    }
+    return NULL;
+}
 
-    /* Calculate needed capacity: original HTML + all attribute strings */
-    size_t attrs_size = 0;
-    for (attr_node *a = attr_list; a; a = a->next) {
-        attrs_size += strlen(a->attrs);
+/* Whether a paragraph was taken as the caption of the table next to it */
+static bool paragraph_is_table_caption(apex_attr_pool *pool, cmark_node *para) {
+    cmark_node *neighbours[2] = { cmark_node_next(para), cmark_node_previous(para) };
+    for (int i = 0; i < 2; i++) {
+        if (!neighbours[i] || cmark_node_get_type(neighbours[i]) != CMARK_NODE_TABLE) continue;
+        cmark_node *source;
+        free(table_caption(pool, neighbours[i], &source));
+        if (source == para) return true;
     }
-    size_t capacity = html_len + attrs_size + 1024; /* +1KB buffer */
-    char *output = malloc(capacity);
-    if (!output) {
-        /* Clean up attr list */
-        while (attr_list) {
-            attr_node *next = attr_list->next;
-            free(attr_list);
-            attr_list = next;
+    return false;
+}
+
+static void html_out_figcaption(html_out *out, const char *caption) {
+    html_out_puts(out, "<figcaption>");
+    html_out_escape_str(out, caption);
+    html_out_puts(out, "</figcaption>\n");
+}
+
+static void html_out_tree(html_out *out, cmark_node *root, int options, html_table_state *table);
+
+/* Text cmark renders unchanged, standing in for one block of a footnote */
+#define FOOTNOTE_MARKER "\x1e" "apex-fn-%zu" "\x1e"
+
+/* Start of the placeholder's opening <p> or <pre> tag before marker */
+static const char *footnote_marker_start(const char *from, const char *marker, const char *tag) {
+    size_t len = strlen(tag);
+    for (const char *p = marker; p > from; p--) {
+        if ((size_t)(p - from) >= len && strncmp(p - len, tag, len) == 0 && (*p == '>' || *p == ' ')) {
+            return p - len;
         }
-        return html;
     }
+    return marker;
+}
 
-    const char *read = html;
-    char *write = output;
-    size_t remaining = capacity;
+/* Whether a rendered block is a single <p> element */
+static bool footnote_piece_is_para(const char *piece) {
+    size_t len = piece ? strlen(piece) : 0;
+    return len >= 8 && strncmp(piece, "<p", 2) == 0 && (piece[2] == '>' || piece[2] == ' ') &&
+           strcmp(piece + len - 5, "</p>\n") == 0;
+}
 
-    /* Track which attributes we've used */
-    int attr_count = 0;
-    for (attr_node *a = attr_list; a; a = a->next) attr_count++;
-    bool *used = calloc(attr_count + 1, sizeof(bool));
+/**
+ * Render the footnote definitions from first onward. cmark owns the footnote
+ * numbering, the backrefs and the enclosing section, so it renders the run
+ * with every block of every definition swapped for a placeholder: a
+ * paragraph for a paragraph, so cmark still appends the backref to the last
+ * one, and a code block for anything else. The blocks are rendered here,
+ * keeping their attributes and media replacements, and spliced over the
+ * placeholders. cmark only renders whole subtrees, so the
+ * run is moved under a scratch document and back. Returns the last
+ * definition rendered.
+ */
+static cmark_node *html_out_footnotes(html_out *out, cmark_node *first, int options,
+                                      int caption_position) {
+    cmark_node *last = first;
+    size_t count = 0;
+    for (cmark_node *def = first;; def = cmark_node_next(def)) {
+        for (cmark_node *child = cmark_node_first_child(def); child; child = cmark_node_next(child)) {
+            count++;
+        }
+        last = def;
+        cmark_node *next = cmark_node_next(def);
+        if (!next || cmark_node_get_type(next) != CMARK_NODE_FOOTNOTE_DEFINITION) break;
+    }
 
-    /* Track element counts in HTML (same as AST walker) */
-    element_counters html_counters = {0};
+    cmark_node *scratch = cmark_node_new(CMARK_NODE_DOCUMENT);
+    cmark_node **blocks = calloc(count + 1, sizeof(cmark_node *));
+    cmark_node **holders = calloc(count + 1, sizeof(cmark_node *));
+    char **pieces = calloc(count + 1, sizeof(char *));
+    bool *paras = calloc(count + 1, sizeof(bool));
+    if (!scratch || !blocks || !holders || !pieces || !paras) {
+        if (scratch) cmark_node_free(scratch);
+        free(blocks);
+        free(holders);
+        free(pieces);
+        free(paras);
+        out->failed = true;
+        return last;
+    }
 
-    /* Process HTML, injecting attributes */
-    while (*read) {
-        /* Check if we're at an opening tag */
-        if (*read == '<' && read[1] != '/' && read[1] != '!') {
-            const char *tag_start = read + 1;
-            const char *tag_name_end = tag_start;
-
-            /* Get tag name */
-            while (*tag_name_end && !isspace((unsigned char)*tag_name_end) &&
-                   *tag_name_end != '>' && *tag_name_end != '/') {
-                tag_name_end++;
+    /* Render each block and put a placeholder in its place */
+    size_t n = 0;
+    for (cmark_node *def = first; def && !out->failed; def = def == last ? NULL : cmark_node_next(def)) {
+        cmark_node *child = cmark_node_first_child(def);
+        while (child) {
+            cmark_node *next = cmark_node_next(child);
+            html_out piece = {0};
+            html_table_state table = {0};
+            piece.attrs = out->attrs;
+            table.caption_position = caption_position;
+            html_out_tree(&piece, child, options, &table);
+            free(table.caption);
+            bool para = cmark_node_get_type(child) == CMARK_NODE_PARAGRAPH &&
+                        footnote_piece_is_para(piece.data);
+
+            char marker[32];
+            snprintf(marker, sizeof(marker), FOOTNOTE_MARKER, n);
+            cmark_node *holder = cmark_node_new(para ? CMARK_NODE_PARAGRAPH : CMARK_NODE_CODE_BLOCK);
+            cmark_node *text = para ? cmark_node_new(CMARK_NODE_TEXT) : NULL;
+            bool ok = holder && !piece.failed;
+            if (ok && para) {
+                ok = text && cmark_node_set_literal(text, marker) && cmark_node_append_child(holder, text);
+            } else if (ok) {
+                ok = cmark_node_set_literal(holder, marker);
+            }
+            if (!ok) {
+                if (text && !cmark_node_parent(text)) cmark_node_free(text);
+                if (holder) cmark_node_free(holder);
+                free(piece.data);
+                out->failed = true;
+                break;
             }
 
-            /* Find the end of the tag (> or />) */
-            const char *tag_end = tag_name_end;
-            while (*tag_end && *tag_end != '>') tag_end++;
+            cmark_node_insert_before(child, holder);
+            cmark_node_unlink(child);
+            blocks[n] = child;
+            holders[n] = holder;
+            pieces[n] = piece.data;
+            paras[n] = para;
+            n++;
+            child = next;
+        }
+    }
+
+    cmark_node *parent = cmark_node_parent(first);
+    cmark_node *after = cmark_node_next(last);
+    cmark_node *def = first;
+    while (def) {
+        cmark_node *next = def == last ? NULL : cmark_node_next(def);
+        cmark_node_append_child(scratch, def);
+        def = next;
+    }
 
-            /* Check if this is a block tag or table cell we care about */
-            size_t tag_len = (size_t)(tag_name_end - tag_start);
-
-            /* Determine element type and increment counter */
-            cmark_node_type elem_type = 0;
-            int elem_idx = -1;
-
-            if (tag_len == 1 && *tag_start == 'p') {
-                elem_type = CMARK_NODE_PARAGRAPH;
-                elem_idx = html_counters.para_count++;
-            } else if (tag_len == 2 && tag_start[0] == 'h' && tag_start[1] >= '1' && tag_start[1] <= '6') {
-                elem_type = CMARK_NODE_HEADING;
-                elem_idx = html_counters.heading_count++;
-            } else if (tag_len == 10 && memcmp(tag_start, "blockquote", 10) == 0) {
-                elem_type = CMARK_NODE_BLOCK_QUOTE;
-                elem_idx = html_counters.blockquote_count++;
-            } else if (tag_len == 5 && memcmp(tag_start, "table", 5) == 0) {
-                elem_type = CMARK_NODE_TABLE;
-                elem_idx = html_counters.table_count++;
-            } else if (tag_len == 2 && (memcmp(tag_start, "ul", 2) == 0 || memcmp(tag_start, "ol", 2) == 0)) {
-                elem_type = CMARK_NODE_LIST;
-                elem_idx = html_counters.list_count++;
-            } else if (tag_len == 2 && memcmp(tag_start, "li", 2) == 0) {
-                elem_type = CMARK_NODE_ITEM;
-                elem_idx = html_counters.item_count++;
-            } else if (tag_len == 3 && memcmp(tag_start, "pre", 3) == 0) {
-                elem_type = CMARK_NODE_CODE_BLOCK;
-                elem_idx = html_counters.code_count++;
-            } else if (tag_len == 1 && *tag_start == 'a') {
-                /* Links - inline elements */
-                elem_type = CMARK_NODE_LINK;
-                elem_idx = html_counters.link_count++;
-            } else if (tag_len == 3 && memcmp(tag_start, "img", 3) == 0) {
-                /* Images - inline elements */
-                elem_type = CMARK_NODE_IMAGE;
-                elem_idx = html_counters.image_count++;
-            } else if (tag_len == 6 && memcmp(tag_start, "strong", 6) == 0) {
-                /* Strong - inline elements */
-                elem_type = CMARK_NODE_STRONG;
-                elem_idx = html_counters.strong_count++;
-            } else if (tag_len == 2 && memcmp(tag_start, "em", 2) == 0) {
-                /* Emphasis - inline elements */
-                elem_type = CMARK_NODE_EMPH;
-                elem_idx = html_counters.emph_count++;
-            } else if (tag_len == 4 && memcmp(tag_start, "code", 4) == 0) {
-                /* Code - inline elements */
-                elem_type = CMARK_NODE_CODE;
-                elem_idx = html_counters.code_inline_count++;
+    char *rendered = out->failed ? NULL : cmark_render_html(scratch, options, NULL);
+    if (rendered) {
+        const char *p = rendered;
+        for (size_t k = 0; k < n; k++) {
+            char marker[32];
+            snprintf(marker, sizeof(marker), FOOTNOTE_MARKER, k);
+            const char *at = strstr(p, marker);
+            if (!at) continue;
+            const char *start = footnote_marker_start(p, at, paras[k] ? "<p" : "<pre");
+            const char *end = at + strlen(marker);
+            const char *piece = pieces[k] ? pieces[k] : "";
+            size_t piece_len = strlen(piece);
+            if (!paras[k]) {
+                if (strncmp(end, "</code></pre>\n", 14) == 0) end += 14;
+            } else if (strncmp(end, "</p>\n", 5) == 0) {
+                end += 5;
+            } else {
+                /* The backref follows: leave cmark's </p> to close the paragraph */
+                piece_len -= 5;
             }
+            html_out_put(out, p, (size_t)(start - p));
+            html_out_put(out, piece, piece_len);
+            p = end;
+        }
+        html_out_puts(out, p);
+        free(rendered);
+    } else {
+        out->failed = true;
+    }
 
-            /* Check if we should skip this element (marked for removal) */
-            /* We do this BEFORE the main matching to remove elements first */
-            bool should_remove = false;
-            int removal_idx = -1;
-            if (elem_type != 0) {
-                int check_idx = 0;
-                for (attr_node *a = attr_list; a; a = a->next, check_idx++) {
-                    /* Check by element type and index for removal */
-                    if (!used[check_idx] &&
-                        (a->node_type == elem_type ||
-                         (elem_type == CMARK_NODE_HEADING && a->node_type >= CMARK_NODE_HEADING && a->node_type <= CMARK_NODE_HEADING + 5)) &&
-                        a->element_index == elem_idx) {
-                        if (strstr(a->attrs, "data-remove")) {
-                            should_remove = true;
-                            removal_idx = check_idx;
-                            break;
-                        }
-                        /* Found matching element but not for removal - stop checking */
-                        break;
-                    }
+    /* Put the blocks and definitions back */
+    for (size_t k = 0; k < n; k++) {
+        cmark_node_insert_before(holders[k], blocks[k]);
+        cmark_node_free(holders[k]);
+        free(pieces[k]);
+    }
+    while ((def = cmark_node_first_child(scratch)) != NULL) {
+        if (after) {
+            cmark_node_insert_before(after, def);
+        } else {
+            cmark_node_append_child(parent, def);
+        }
+    }
+    cmark_node_free(scratch);
+    free(blocks);
+    free(holders);
+    free(pieces);
+    free(paras);
+    return last;
+}
+
+/**
+ * Render a node event. Returns false if the node's subtree was rendered
+ * (or dropped) as a whole and the iterator should skip its children.
+ */
+static bool html_out_node(html_out *out, cmark_node *node, cmark_event_type ev,
+                          int options, html_table_state *table) {
+    bool entering = (ev == CMARK_EVENT_ENTER);
+    cmark_node_type type = cmark_node_get_type(node);
+
+    if (entering && node_takes_attributes(type) && node_removed(out->attrs, node)) {
+        return false;
+    }
+
+    if (type == CMARK_NODE_TABLE) {
+        if (entering) {
+            cmark_node *caption_para;
+            html_out_cr(out);
+            table->caption = table_caption(out->attrs, node, &caption_para);
+            if (table->caption) {
+                html_out_puts(out, "<figure class=\"table-figure\">\n");
+                if (table->caption_position == 0) html_out_figcaption(out, table->caption);
+            }
+            html_out_puts(out, "<table");
+            html_out_table_attrs(out, node);
+            html_out_sourcepos(out, node, options);
+            html_out_putc(out, '>');
+            table->in_table = true;
+            table->body_open = false;
+            table->foot_open = false;
+            table->row_headers = false;
+        } else {
+            if (table->body_open || table->foot_open) {
+                html_out_cr(out);
+                html_out_puts(out, table->foot_open ? "</tfoot>" : "</tbody>");
+                html_out_cr(out);
+            }
+            html_out_cr(out);
+            html_out_puts(out, "</table>");
+            html_out_cr(out);
+            if (table->caption) {
+                if (table->caption_position != 0) html_out_figcaption(out, table->caption);
+                html_out_puts(out, "</figure>\n");
+                free(table->caption);
+                table->caption = NULL;
+            }
+            table->in_table = false;
+            table->body_open = false;
+            table->foot_open = false;
+        }
+        return true;
+    }
+    if (type == CMARK_NODE_TABLE_ROW) {
+        bool is_header = cmark_gfm_extensions_get_table_row_is_header(node) != 0;
+        if (entering) {
+            /* Caption rows and the === marker row are not part of the table body */
+            if (node_removed(out->attrs, node) || table_row_is_foot_marker(out->attrs, node)) {
+                return false;
+            }
+            bool is_foot = !is_header &&
+                           apex_attributes_has(apex_attr_pool_get(out->attrs, node), "data-tfoot");
+
+            html_out_cr(out);
+            if (is_header) {
+                table->in_header = true;
+                cmark_node *first = cmark_node_first_child(node);
+                table->row_headers = first && table_cell_text_is(first, NULL);
+                html_out_puts(out, "<thead>");
+                html_out_cr(out);
+            } else if (is_foot && !table->foot_open) {
+                if (table->body_open) {
+                    html_out_puts(out, "</tbody>");
+                    html_out_cr(out);
+                    table->body_open = false;
                 }
+                html_out_puts(out, "<tfoot>");
+                html_out_cr(out);
+                table->foot_open = true;
+            } else if (!table->body_open && !table->foot_open) {
+                html_out_puts(out, "<tbody>");
+                html_out_cr(out);
+                table->body_open = true;
+            }
+            html_out_puts(out, "<tr");
+            html_out_sourcepos(out, node, options);
+            html_out_putc(out, '>');
+            table->column = 0;
+        } else {
+            html_out_cr(out);
+            html_out_puts(out, "</tr>");
+            if (is_header) {
+                html_out_cr(out);
+                html_out_puts(out, "</thead>");
+                table->in_header = false;
+            }
+        }
+        return true;
+    }
+    if (type == CMARK_NODE_TABLE_CELL) {
+        if (entering) {
+            int column = table->column++;
+            if (node_removed(out->attrs, node) ||
+                table_cell_text_is(node, "^^") || table_cell_text_is(node, "<<")) {
+                return false;
             }
 
-            if (should_remove) {
-                /* Skip this entire element */
-                const char *close_start = read;
-                int depth = 1;
-                while (*close_start && depth > 0) {
-                    if (*close_start == '<') {
-                        if (close_start[1] == '/') {
-                            /* Closing tag */
-                            const char *tag_check = close_start + 2;
-                            if (memcmp(tag_check, tag_start, tag_len) == 0 &&
-                                (tag_check[tag_len] == '>' || isspace((unsigned char)tag_check[tag_len]))) {
-                                depth--;
-                                if (depth == 0) {
-                                    /* Found matching close tag */
-                                    while (*close_start && *close_start != '>') close_start++;
-                                    if (*close_start == '>') close_start++;
-                                    read = close_start;
-                                    if (removal_idx >= 0) used[removal_idx] = true;
-                                    goto skip_element;
-                                }
-                            }
-                        } else if (close_start[1] != '!' && close_start[1] != '?') {
-                            /* Another opening tag of same type */
-                            const char *tag_check = close_start + 1;
-                            if (memcmp(tag_check, tag_start, tag_len) == 0 &&
-                                (tag_check[tag_len] == '>' || tag_check[tag_len] == ' ')) {
-                                depth++;
-                            }
-                        }
+            html_out_cr(out);
+            const char *span_attrs = table_cell_span_attrs(out->attrs, node);
+            table->row_header_cell = !span_attrs && column == 0 && table->row_headers &&
+                                     !table->in_header && !table->foot_open;
+            if (span_attrs) {
+                /* Spans replace the column alignment; the attributes carry any per-cell style */
+                while (isspace((unsigned char)*span_attrs)) span_attrs++;
+                html_out_puts(out, table->in_header ? "<th " : "<td ");
+                html_out_puts(out, span_attrs);
+            } else if (table->row_header_cell) {
+                html_out_puts(out, "<th scope=\"row\"");
+            } else {
+                cmark_node *table_node = cmark_node_parent(cmark_node_parent(node));
+                uint16_t columns = table_node ? cmark_gfm_extensions_get_table_columns(table_node) : 0;
+                uint8_t *alignments = table_node ? cmark_gfm_extensions_get_table_alignments(table_node) : NULL;
+                html_out_puts(out, table->in_header ? "<th" : "<td");
+                if (alignments && column < columns) {
+                    switch (alignments[column]) {
+                        case 'l': html_out_table_align(out, "left", options); break;
+                        case 'c': html_out_table_align(out, "center", options); break;
+                        case 'r': html_out_table_align(out, "right", options); break;
+                        default: break;
                     }
-                    close_start++;
                 }
             }
+            html_out_sourcepos(out, node, options);
+            html_out_putc(out, '>');
+        } else {
+            html_out_puts(out, table->in_header || table->row_header_cell ? "</th>" : "</td>");
+        }
+        return true;
+    }
+    if (type == CMARK_NODE_STRIKETHROUGH) {
+        html_out_puts(out, entering ? "<del>" : "</del>");
+        return true;
+    }
 
-            skip_element:
-            if (read != html && *read != '<') {
-                continue; /* We skipped an element */
+    if (cmark_node_get_syntax_extension(node)) {
+        const char *type_string = cmark_node_get_type_string(node);
+        if (type == CMARK_NODE_ITEM && type_string && strcmp(type_string, "tasklist") == 0) {
+            if (entering) {
+                html_out_cr(out);
+                html_out_puts(out, "<li");
+                html_out_node_attrs(out, node);
+                html_out_sourcepos(out, node, options);
+                html_out_putc(out, '>');
+                html_out_puts(out, cmark_gfm_extensions_get_tasklist_item_checked(node)
+                                   ? "<input type=\"checkbox\" checked=\"\" disabled=\"\" /> "
+                                   : "<input type=\"checkbox\" disabled=\"\" /> ");
+            } else {
+                html_out_puts(out, "</li>\n");
             }
+            return true;
+        }
+        /* Unknown extension node: let cmark render the subtree */
+        if ((type & CMARK_NODE_TYPE_MASK) == CMARK_NODE_TYPE_BLOCK) html_out_cr(out);
+        html_out_cmark(out, node, options);
+        return false;
+    }
 
-            /* Handle both block and inline elements with attributes */
-            if (elem_type != 0) {
-                /* Extract fingerprint for matching */
-                char html_fingerprint[51] = {0};
-                size_t fp_idx = 0;
-
-                if (elem_type == CMARK_NODE_LINK || elem_type == CMARK_NODE_IMAGE) {
-                    /* For links/images, extract href/src and for images also alt (to disambiguate same-src) */
-                    const char *url_attr = (elem_type == CMARK_NODE_LINK) ? "href=\"" : "src=\"";
-                    const char *url_start = strstr(read, url_attr);
-                    if (url_start) {
-                        url_start += strlen(url_attr);
-                        const char *url_end = strchr(url_start, '"');
-                        if (url_end) {
-                            size_t url_len = url_end - url_start;
-                            if (url_len > 50) url_len = 50;
-                            memcpy(html_fingerprint, url_start, url_len);
-                            fp_idx = url_len;
-                            if (elem_type == CMARK_NODE_IMAGE && fp_idx < 49) {
-                                const char *alt_attr = "alt=\"";
-                                const char *alt_start = strstr(read, alt_attr);
-                                if (alt_start && alt_start < tag_end) {
-                                    alt_start += strlen(alt_attr);
-                                    const char *alt_end = strchr(alt_start, '"');
-                                    if (alt_end) {
-                                        size_t alt_len = alt_end - alt_start;
-                                        if (alt_len > 20) alt_len = 20;
-                                        if (fp_idx + 1 + alt_len <= 50) {
-                                            html_fingerprint[fp_idx++] = '|';
-                                            memcpy(html_fingerprint + fp_idx, alt_start, alt_len);
-                                            fp_idx += alt_len;
-                                        }
-                                    }
-                                }
-                            } else if (elem_type == CMARK_NODE_LINK && fp_idx < 49) {
-                                /* Append visible text before any nested tag (skip image-only links). */
-                                const char *content_start = tag_end;
-                                if (*content_start == '>') content_start++;
-                                if (*content_start && *content_start != '<') {
-                                    size_t text_len = 0;
-                                    while (content_start[text_len] &&
-                                           content_start[text_len] != '<' &&
-                                           text_len < 20) {
-                                        text_len++;
-                                    }
-                                    if (text_len > 0 && fp_idx + 1 + text_len <= 50) {
-                                        html_fingerprint[fp_idx++] = '|';
-                                        memcpy(html_fingerprint + fp_idx, content_start, text_len);
-                                        fp_idx += text_len;
-                                    }
-                                }
-                            }
-                            html_fingerprint[fp_idx] = '\0';
-                        }
-                    }
-                } else if (elem_type == CMARK_NODE_STRONG || elem_type == CMARK_NODE_EMPH || elem_type == CMARK_NODE_CODE) {
-                    /* For inline elements (strong, emph, code), extract text content */
-                    const char *content_start = tag_name_end;
-                    while (*content_start && *content_start != '>') content_start++;
-                    if (*content_start == '>') content_start++;
-
-                    const char *text_p = content_start;
-                    while (*text_p && *text_p != '<' && fp_idx < 50) {
-                        html_fingerprint[fp_idx++] = *text_p++;
-                    }
-                    html_fingerprint[fp_idx] = '\0';
-                } else {
-                    /* For block elements, extract text content */
-                    const char *content_start = tag_name_end;
-                    while (*content_start && *content_start != '>') content_start++;
-                    if (*content_start == '>') content_start++;
-
-                    const char *text_p = content_start;
-                    while (*text_p && *text_p != '<' && fp_idx < 50) {
-                        html_fingerprint[fp_idx++] = *text_p++;
-                    }
-                    html_fingerprint[fp_idx] = '\0';
+    char heading_tag[] = "<h0";
+    cmark_node *parent;
+    cmark_node *grandparent;
+
+    switch (type) {
+        case CMARK_NODE_DOCUMENT:
+            break;
+
+        case CMARK_NODE_BLOCK_QUOTE:
+            html_out_cr(out);
+            if (entering) {
+                html_out_puts(out, "<blockquote");
+                html_out_node_attrs(out, node);
+                html_out_sourcepos(out, node, options);
+                html_out_puts(out, ">\n");
+            } else {
+                html_out_puts(out, "</blockquote>\n");
+            }
+            break;
+
+        case CMARK_NODE_LIST: {
+            bool bullet = cmark_node_get_list_type(node) == CMARK_BULLET_LIST;
+            if (entering) {
+                int start = cmark_node_get_list_start(node);
+                html_out_cr(out);
+                html_out_puts(out, bullet ? "<ul" : "<ol");
+                html_out_node_attrs(out, node);
+                if (!bullet && start != 1) {
+                    char buffer[32];
+                    snprintf(buffer, sizeof(buffer), " start=\"%d\"", start);
+                    html_out_puts(out, buffer);
                 }
+                html_out_sourcepos(out, node, options);
+                html_out_puts(out, ">\n");
+            } else {
+                html_out_puts(out, bullet ? "</ul>\n" : "</ol>\n");
+            }
+            break;
+        }
 
-                /* Find matching attribute - try fingerprint first, then index */
-                attr_node *matching = NULL;
-                int idx = 0;
-
-                /* For tables, use sequential matching (first unused table) since index may not match */
-                if (elem_type == CMARK_NODE_TABLE) {
-                    for (attr_node *a = attr_list; a; a = a->next, idx++) {
-                        if (used[idx]) continue;
-                        if (a->node_type == CMARK_NODE_TABLE) {
-                            matching = a;
-                            used[idx] = true;
-                            break;
-                        }
-                    }
-                } else if (elem_type == CMARK_NODE_IMAGE) {
-                    /* Images: match by element_index (document order). */
-                    for (attr_node *a = attr_list; a; a = a->next, idx++) {
-                        if (used[idx]) continue;
-                        if (a->node_type != CMARK_NODE_IMAGE) continue;
-                        if (a->element_index == elem_idx) {
-                            matching = a;
-                            used[idx] = true;
-                            break;
-                        }
-                    }
-                } else if (elem_type == CMARK_NODE_LINK) {
-                    /* Links: match by href(+text) fingerprint among unused attrs.
-                     * Raw HTML <a> tags inflate html link_count, so element_index is
-                     * not reliable. Consume matching fingerprints in document order. */
-                    if (fp_idx > 0) {
-                        for (attr_node *a = attr_list; a; a = a->next, idx++) {
-                            if (used[idx]) continue;
-                            if (a->node_type != CMARK_NODE_LINK) continue;
-                            if (!a->text_fingerprint) continue;
-                            if (strncmp(a->text_fingerprint, html_fingerprint, 50) == 0) {
-                                matching = a;
-                                used[idx] = true;
-                                break;
-                            }
-                        }
-                    }
-                    /* Fall back to index only when no fingerprint is available. */
-                    if (!matching) {
-                        idx = 0;
-                        for (attr_node *a = attr_list; a; a = a->next, idx++) {
-                            if (used[idx]) continue;
-                            if (a->node_type != CMARK_NODE_LINK) continue;
-                            if (!a->text_fingerprint && a->element_index == elem_idx) {
-                                matching = a;
-                                used[idx] = true;
-                                break;
-                            }
-                        }
-                    }
-                } else {
-                    /* For other elements, use the existing matching logic */
-                    for (attr_node *a = attr_list; a; a = a->next, idx++) {
-                        if (used[idx]) continue;
-
-                        /* Check type match (including inline elements) */
-                        bool type_match = (a->node_type == elem_type ||
-                             (elem_type == CMARK_NODE_HEADING && a->node_type >= CMARK_NODE_HEADING && a->node_type <= CMARK_NODE_HEADING + 5));
-
-                        if (!type_match) continue;
-
-                        /* Try fingerprint match first (works for both block and inline) */
-                        if (a->text_fingerprint && fp_idx > 0 &&
-                            strncmp(a->text_fingerprint, html_fingerprint, 50) == 0) {
-                            /* For inline elements, also check element_index to handle duplicates. */
-                            if (elem_type == CMARK_NODE_STRONG || elem_type == CMARK_NODE_EMPH ||
-                                elem_type == CMARK_NODE_CODE) {
-                                if (a->element_index == elem_idx) {
-                                    matching = a;
-                                    used[idx] = true;
-                                    break;
-                                }
-                            } else {
-                                /* For other elements, fingerprint match is sufficient */
-                                matching = a;
-                                used[idx] = true;
-                                break;
-                            }
-                        }
-
-                        /* Fall back to index match if no fingerprint */
-                        if (!a->text_fingerprint && a->element_index == elem_idx) {
-                            matching = a;
-                            used[idx] = true;
-                            break;
-                        }
-                    }
-                }
+        case CMARK_NODE_ITEM:
+            if (entering) {
+                html_out_cr(out);
+                html_out_puts(out, "<li");
+                html_out_node_attrs(out, node);
+                html_out_sourcepos(out, node, options);
+                html_out_putc(out, '>');
+            } else {
+                html_out_puts(out, "</li>\n");
+            }
+            break;
+
+        case CMARK_NODE_HEADING:
+            heading_tag[2] = (char)('0' + cmark_node_get_heading_level(node));
+            if (entering) {
+                html_out_cr(out);
+                html_out_puts(out, heading_tag);
+                html_out_node_attrs(out, node);
+                html_out_sourcepos(out, node, options);
+                html_out_putc(out, '>');
+            } else {
+                html_out_puts(out, "</");
+                html_out_puts(out, heading_tag + 1);
+                html_out_puts(out, ">\n");
+            }
+            break;
 
-                if (matching) {
-                    /* Skip internal attributes and table span attributes */
-                    /* Table spans are handled by apex_inject_table_attributes() */
-                    /* For tables, we need to extract IAL attributes even if data-caption is present */
-                    bool skip_all = false;
-                    bool extract_ial_from_caption = false;
-
-                    if (strstr(matching->attrs, "data-remove") ||
-                        strstr(matching->attrs, "colspan=") ||
-                        strstr(matching->attrs, "rowspan=")) {
-                        skip_all = true;
-                    } else if (strstr(matching->attrs, "data-caption") && elem_type == CMARK_NODE_TABLE) {
-                        /* For tables with captions, extract IAL attributes (id, class, etc.) but skip data-caption */
-                        extract_ial_from_caption = true;
-                    }
+        case CMARK_NODE_CODE_BLOCK:
+            html_out_code_block(out, node, options);
+            break;
 
-                    if (skip_all) {
-                        /* These are handled elsewhere, don't inject here */
-                    } else if (extract_ial_from_caption) {
-                        /* Extract IAL attributes from the attribute string, excluding data-caption */
-                        char *ial_attrs = extract_ial_from_table_attrs(matching->attrs);
-                        if (ial_attrs && *ial_attrs) {
-                            /* Find where to inject attributes (before closing > of <table> tag) */
-                            const char *inject_point = tag_end;
-                            if (*inject_point == '>') {
-                                /* Copy up to injection point */
-                                size_t prefix_len = inject_point - read;
-                                if (prefix_len <= remaining) {
-                                    memcpy(write, read, prefix_len);
-                                    write += prefix_len;
-                                    remaining -= prefix_len;
-                                }
+        case CMARK_NODE_HTML_BLOCK:
+            html_out_cr(out);
+            if (!(options & CMARK_OPT_UNSAFE)) {
+                html_out_puts(out, "<!-- raw HTML omitted -->");
+            } else {
+                html_out_puts(out, cmark_node_get_literal(node));
+            }
+            html_out_cr(out);
+            break;
+
+        case CMARK_NODE_CUSTOM_BLOCK:
+            html_out_cr(out);
+            html_out_puts(out, entering ? cmark_node_get_on_enter(node) : cmark_node_get_on_exit(node));
+            html_out_cr(out);
+            break;
+
+        case CMARK_NODE_THEMATIC_BREAK:
+            html_out_cr(out);
+            html_out_puts(out, "<hr");
+            html_out_sourcepos(out, node, options);
+            html_out_puts(out, " />\n");
+            break;
+
+        case CMARK_NODE_PARAGRAPH:
+            parent = cmark_node_parent(node);
+            grandparent = parent ? cmark_node_parent(parent) : NULL;
+            if (grandparent && cmark_node_get_type(grandparent) == CMARK_NODE_LIST &&
+                cmark_node_get_list_tight(grandparent)) {
+                break;
+            }
+            if (entering) {
+                if (paragraph_is_table_caption(out->attrs, node)) {
+                    return false;
+                }
+                html_out_cr(out);
+                html_out_puts(out, "<p");
+                html_out_node_attrs(out, node);
+                html_out_sourcepos(out, node, options);
+                html_out_putc(out, '>');
+            } else {
+                html_out_puts(out, "</p>\n");
+            }
+            break;
 
-                                /* Inject IAL attributes - ensure leading space */
-                                /* Check if we need to add a space before the attributes */
-                                bool needs_leading_space = (ial_attrs[0] != ' ');
-                                size_t ial_len = strlen(ial_attrs);
-                                size_t total_len = ial_len + (needs_leading_space ? 1 : 0);
+        case CMARK_NODE_TEXT:
+            if (table->in_table) {
+                html_out_escape_cell_text(out, cmark_node_get_literal(node));
+            } else {
+                html_out_escape_str(out, cmark_node_get_literal(node));
+            }
+            break;
 
-                                if (total_len <= remaining) {
-                                    if (needs_leading_space) {
-                                        *write++ = ' ';
-                                        remaining--;
-                                    }
-                                    memcpy(write, ial_attrs, ial_len);
-                                    write += ial_len;
-                                    remaining -= ial_len;
-                                } else {
-                                    /* Buffer too small - need to expand */
-                                    size_t current_pos = write - output;
-                                    size_t new_cap = (current_pos + total_len + 1) * 2;
-                                    char *new_output = realloc(output, new_cap);
-                                    if (new_output) {
-                                        output = new_output;
-                                        write = output + current_pos;
-                                        remaining = new_cap - current_pos;
-                                        if (needs_leading_space) {
-                                            *write++ = ' ';
-                                            remaining--;
-                                        }
-                                        memcpy(write, ial_attrs, ial_len);
-                                        write += ial_len;
-                                        remaining -= ial_len;
-                                    }
-                                }
-                                if (remaining > 0) {
-                                    *write++ = '>';
-                                    remaining--;
-                                }
-                                read = inject_point + 1;
-                                free(ial_attrs);
-                                continue;
-                            }
-                        }
-                        if (ial_attrs) free(ial_attrs);
-                        /* No IAL attributes to inject, but table still needs to be copied - fall through */
-                    } else if (elem_type == CMARK_NODE_IMAGE &&
-                               (strstr(matching->attrs, "data-apex-replace-video") ||
-                                strstr(matching->attrs, "data-apex-replace-picture"))) {
-                        /* Replace img with video or picture element */
-                        const char *img_tag_end = find_tag_end(read);
-                        if (img_tag_end && img_tag_end > read) {
-                            char *src = extract_attr_from_tag(read, img_tag_end + 1, "src");
-                            char *alt = extract_attr_from_tag(read, img_tag_end + 1, "alt");
-                            char *title = extract_attr_from_tag(read, img_tag_end + 1, "title");
-                            /* Fallback: title may be in IAL attrs (cmark may not emit it on img) */
-                            if ((!title || !*title) && matching->attrs) {
-                                size_t alen = strlen(matching->attrs);
-                                char *fake_tag = malloc(alen + 10);
-                                if (fake_tag) {
-                                    snprintf(fake_tag, alen + 10, "<img %s>", matching->attrs);
-                                    char *t = extract_attr_from_tag(fake_tag, fake_tag + strlen(fake_tag) + 1, "title");
-                                    free(fake_tag);
-                                    if (t) { free(title); title = t; }
-                                }
-                            }
-                            if (!src) src = strdup("");
-                            if (!alt) alt = strdup("");
-
-                            char *replacement = NULL;
-                            size_t repl_len = 0;
-
-                            if (strstr(matching->attrs, "data-apex-replace-video")) {
-                                /* Build <video> with <source> elements. Order: webm, ogg, mp4/mov/m4v (primary) */
-                                size_t cap = 256 + (src ? strlen(src) * 4 : 0);
-                                replacement = malloc(cap);
-                                if (replacement) {
-                                    char *w = replacement;
-                                    w += snprintf(w, cap, "<video");
-                                    if (alt && *alt) w += snprintf(w, cap - (size_t)(w - replacement), " title=\"%s\"", alt);
-                                    w += snprintf(w, cap - (size_t)(w - replacement), ">");
-
-                                    if (strstr(matching->attrs, "data-apex-video-webm")) {
-                                        char *u = url_with_extension(src, "webm");
-                                        if (u) { w += snprintf(w, cap - (size_t)(w - replacement), "<source src=\"%s\" type=\"video/webm\">", u); free(u); }
-                                    }
-                                    if (strstr(matching->attrs, "data-apex-video-ogg")) {
-                                        char *u = url_with_extension(src, "ogg");
-                                        if (u) { w += snprintf(w, cap - (size_t)(w - replacement), "<source src=\"%s\" type=\"video/ogg\">", u); free(u); }
-                                    }
-                                    if (strstr(matching->attrs, "data-apex-video-mp4")) {
-                                        char *u = url_with_extension(src, "mp4");
-                                        if (u) { w += snprintf(w, cap - (size_t)(w - replacement), "<source src=\"%s\" type=\"video/mp4\">", u); free(u); }
-                                    }
-                                    if (strstr(matching->attrs, "data-apex-video-mov")) {
-                                        char *u = url_with_extension(src, "mov");
-                                        if (u) { w += snprintf(w, cap - (size_t)(w - replacement), "<source src=\"%s\" type=\"video/quicktime\">", u); free(u); }
-                                    }
-                                    if (strstr(matching->attrs, "data-apex-video-m4v")) {
-                                        char *u = url_with_extension(src, "m4v");
-                                        if (u) { w += snprintf(w, cap - (size_t)(w - replacement), "<source src=\"%s\" type=\"video/mp4\">", u); free(u); }
-                                    }
-                                    /* Primary src as fallback (always include) */
-                                    w += snprintf(w, cap - (size_t)(w - replacement), "<source src=\"%s\" type=\"%s\">", src, video_type_from_url(src));
-                                    w += snprintf(w, cap - (size_t)(w - replacement), "</video>");
-                                    repl_len = (size_t)(w - replacement);
-                                }
-                            } else {
-                                /* Build <picture> with <source> elements and <img> fallback */
-                                char *webp_srcset = extract_data_apex_picture_srcset(matching->attrs, "webp");
-                                char *avif_srcset = extract_data_apex_picture_srcset(matching->attrs, "avif");
-                                char *img_fallback_attrs = filter_img_fallback_attrs(matching->attrs);
-
-                                size_t cap = 512 + (src ? strlen(src) * 2 : 0) +
-                                             (webp_srcset ? strlen(webp_srcset) : 0) +
-                                             (avif_srcset ? strlen(avif_srcset) : 0) +
-                                             (img_fallback_attrs ? strlen(img_fallback_attrs) : 0);
-                                replacement = malloc(cap);
-                                if (replacement) {
-                                    char *w = replacement;
-                                    w += snprintf(w, cap, "<picture>");
-                                    if (avif_srcset) w += snprintf(w, cap - (size_t)(w - replacement), "<source type=\"image/avif\" srcset=\"%s\">", avif_srcset);
-                                    if (webp_srcset) w += snprintf(w, cap - (size_t)(w - replacement), "<source type=\"image/webp\" srcset=\"%s\">", webp_srcset);
-                                    /* Preserve title on img for caption logic (apex_convert_image_captions) */
-                                    const char *img_attrs = (img_fallback_attrs && *img_fallback_attrs) ? img_fallback_attrs : NULL;
-                                    if (title && *title) {
-                                        if (img_attrs) {
-                                            w += snprintf(w, cap - (size_t)(w - replacement), "<img src=\"%s\" alt=\"%s\" title=\"%s\" %s></picture>", src, alt, title, img_attrs);
-                                        } else {
-                                            w += snprintf(w, cap - (size_t)(w - replacement), "<img src=\"%s\" alt=\"%s\" title=\"%s\"></picture>", src, alt, title);
-                                        }
-                                    } else {
-                                        if (img_attrs) {
-                                            w += snprintf(w, cap - (size_t)(w - replacement), "<img src=\"%s\" alt=\"%s\" %s></picture>", src, alt, img_attrs);
-                                        } else {
-                                            w += snprintf(w, cap - (size_t)(w - replacement), "<img src=\"%s\" alt=\"%s\"></picture>", src, alt);
-                                        }
-                                    }
-                                    repl_len = (size_t)(w - replacement);
-                                }
-                                free(webp_srcset);
-                                free(avif_srcset);
-                                free(img_fallback_attrs);
-                            }
+        case CMARK_NODE_LINEBREAK:
+            html_out_puts(out, "<br />\n");
+            break;
 
-                            if (replacement && repl_len > 0 && repl_len <= remaining) {
-                                memcpy(write, replacement, repl_len);
-                                write += repl_len;
-                                remaining -= repl_len;
-                                read = img_tag_end + 1;
-                                free(replacement);
-                                free(src);
-                                free(alt);
-                                free(title);
-                                continue;
-                            }
-                            free(replacement);
-                            free(src);
-                            free(alt);
-                            free(title);
-                        }
-                        /* Fall through to normal inject if replacement failed */
-                    } else {
-                        /* Find where to inject attributes */
-                        const char *inject_point = NULL;
-
-                        if (elem_type == CMARK_NODE_IMAGE || elem_type == CMARK_NODE_LINK ||
-                            elem_type == CMARK_NODE_STRONG || elem_type == CMARK_NODE_EMPH ||
-                            elem_type == CMARK_NODE_CODE) {
-                            /* For inline elements (img, a), inject before the closing > or /> */
-                            /* Find the closing > for this tag */
-                            const char *close_pos = tag_end;
-                            bool is_self_closing = false;
-                            if (*close_pos == '>') {
-                                /* Check if it's a self-closing tag /> */
-                                if (close_pos > tag_name_end && close_pos[-1] == '/') {
-                                    inject_point = close_pos - 1; /* Before /> */
-                                    is_self_closing = true;
-                                } else {
-                                    inject_point = close_pos; /* Before > */
-                                }
-                            } else {
-                                /* Fallback: after tag name if we can't find > */
-                                inject_point = tag_name_end;
-                                while (*inject_point && isspace((unsigned char)*inject_point) && *inject_point != '>') inject_point++;
-                            }
+        case CMARK_NODE_SOFTBREAK:
+            if (options & CMARK_OPT_HARDBREAKS) {
+                html_out_puts(out, "<br />\n");
+            } else if (options & CMARK_OPT_NOBREAKS) {
+                html_out_putc(out, ' ');
+            } else {
+                html_out_putc(out, '\n');
+            }
+            break;
+
+        case CMARK_NODE_CODE:
+            html_out_puts(out, "<code");
+            html_out_node_attrs(out, node);
+            html_out_putc(out, '>');
+            if (table->in_table) {
+                html_out_escape_cell_text(out, cmark_node_get_literal(node));
+            } else {
+                html_out_escape_str(out, cmark_node_get_literal(node));
+            }
+            html_out_puts(out, "</code>");
+            break;
 
-                            /* Copy up to injection point (but for self-closing tags, don't include the space before /) */
-                            size_t prefix_len;
-                            if (is_self_closing && inject_point > read && inject_point[-1] == ' ') {
-                                /* Don't copy the space before / - we'll add it back after attributes */
-                                prefix_len = inject_point - read - 1;
-                            } else {
-                                prefix_len = inject_point - read;
-                            }
+        case CMARK_NODE_HTML_INLINE:
+            if (!(options & CMARK_OPT_UNSAFE)) {
+                html_out_puts(out, "<!-- raw HTML omitted -->");
+            } else {
+                html_out_puts(out, cmark_node_get_literal(node));
+            }
+            break;
 
-                            if (prefix_len < remaining && prefix_len > 0) {
-                                memcpy(write, read, prefix_len);
-                                write += prefix_len;
-                                remaining -= prefix_len;
-                            }
+        case CMARK_NODE_CUSTOM_INLINE:
+            html_out_puts(out, entering ? cmark_node_get_on_enter(node) : cmark_node_get_on_exit(node));
+            break;
 
-                            /* Always add a space before attributes (they need to be separated from existing attributes) */
-                            /* The only exception is if inject_point is at > and there's already a space before it */
-                            /* But since we're injecting attributes, we always need a space before them */
-                            if (remaining > 0) {
-                                *write++ = ' ';
-                                remaining--;
-                            }
+        case CMARK_NODE_STRONG:
+            if (entering) {
+                html_out_puts(out, "<strong");
+                html_out_node_attrs(out, node);
+                html_out_putc(out, '>');
+            } else {
+                html_out_puts(out, "</strong>");
+            }
+            break;
 
-                            /* Inject attributes */
-                            size_t attr_len = strlen(matching->attrs);
-                            if (attr_len <= remaining) {
-                                memcpy(write, matching->attrs, attr_len);
-                                write += attr_len;
-                                remaining -= attr_len;
-                            }
+        case CMARK_NODE_EMPH:
+            if (entering) {
+                html_out_puts(out, "<em");
+                html_out_node_attrs(out, node);
+                html_out_putc(out, '>');
+            } else {
+                html_out_puts(out, "</em>");
+            }
+            break;
+
+        case CMARK_NODE_LINK:
+            if (entering) {
+                const char *title = cmark_node_get_title(node);
+                html_out_puts(out, "<a href=\"");
+                html_out_url(out, cmark_node_get_url(node), options);
+                if (title && *title) {
+                    html_out_puts(out, "\" title=\"");
+                    html_out_escape_str(out, title);
+                }
+                html_out_putc(out, '"');
+                html_out_node_attrs(out, node);
+                html_out_putc(out, '>');
+            } else {
+                html_out_puts(out, "</a>");
+            }
+            break;
 
-                            /* For self-closing tags, ensure space before / */
-                            if (is_self_closing && remaining > 0) {
-                                *write++ = ' ';
-                                remaining--;
-                            }
+        case CMARK_NODE_IMAGE:
+            html_out_image(out, node, options);
+            return false;
 
-                            read = inject_point;
-                        } else {
-                            /* For block elements, inject after tag name */
-                            inject_point = tag_name_end;
-                            while (*inject_point && isspace((unsigned char)*inject_point)) inject_point++;
-
-                            /* Copy up to injection point */
-                            size_t prefix_len = inject_point - read;
-                            if (prefix_len < remaining) {
-                                memcpy(write, read, prefix_len);
-                                write += prefix_len;
-                                remaining -= prefix_len;
-                            }
+        case CMARK_NODE_FOOTNOTE_REFERENCE:
+            html_out_cmark(out, node, options);
+            break;
 
-                            /* Always add space before attributes for block elements */
-                            /* We're injecting right after the tag name, so we need a space */
-                            /* Check if there's already whitespace to avoid doubling spaces */
-                            bool needs_space = true;
-                            if (inject_point > read) {
-                                /* Check the character immediately before inject_point */
-                                const char *before_inject = inject_point - 1;
-                                if (isspace((unsigned char)*before_inject)) {
-                                    /* There's already whitespace, don't add another */
-                                    needs_space = false;
-                                }
-                            }
+        default:
+            break;
+    }
+    return true;
+}
 
-                            if (needs_space && remaining > 0) {
-                                *write++ = ' ';
-                                remaining--;
-                            }
+/**
+ * Render root and everything under it
+ */
+static void html_out_tree(html_out *out, cmark_node *root, int options, html_table_state *table) {
+    cmark_iter *iter = cmark_iter_new(root);
+    if (!iter) {
+        out->failed = true;
+        return;
+    }
 
-                            /* Inject attributes */
-                            size_t attr_len = strlen(matching->attrs);
-                            if (attr_len <= remaining) {
-                                memcpy(write, matching->attrs, attr_len);
-                                write += attr_len;
-                                remaining -= attr_len;
-                            }
+    cmark_event_type ev;
+    while ((ev = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+        cmark_node *node = cmark_iter_get_node(iter);
 
-                            read = inject_point;
-                        }
-                        continue;
-                    }
-                }
-            }
+        if (ev == CMARK_EVENT_ENTER && cmark_node_get_type(node) == CMARK_NODE_FOOTNOTE_DEFINITION) {
+            cmark_node *last = html_out_footnotes(out, node, options, table->caption_position);
+            cmark_iter_reset(iter, last, CMARK_EVENT_EXIT);
+            continue;
         }
 
-        /* Copy character */
-        if (remaining > 0) {
-            *write++ = *read++;
-            remaining--;
-        } else {
-            read++;
+        if (!html_out_node(out, node, ev, options, table)) {
+            cmark_iter_reset(iter, node, CMARK_EVENT_EXIT);
         }
     }
+    cmark_iter_free(iter);
+}
 
-    free(used);
+/**
+ * Render HTML with attributes from node user_data written into opening tags
+ */
+char *apex_render_html_with_attributes(cmark_node *document, int options) {
+    return apex_render_html_with_caption_position(document, options, 1);
+}
 
-    *write = '\0';
+/**
+ * Render HTML with attributes, placing table figcaptions above (0) or below (1)
+ */
+char *apex_render_html_with_caption_position(cmark_node *document, int options, int caption_position) {
+    if (!document) return NULL;
 
-    /* Clean up */
-    while (attr_list) {
-        attr_node *next = attr_list->next;
-        free(attr_list->text_fingerprint);
-        free(attr_list);
-        attr_list = next;
+    html_out out = {0};
+    html_table_state table = {0};
+    table.caption_position = caption_position;
+    out.attrs = apex_attr_pool_new();
+    if (!out.attrs) return NULL;
+    html_out_tree(&out, document, options, &table);
+    free(table.caption);
+    apex_attr_pool_free(out.attrs);
+
+    if (out.failed) {
+        free(out.data);
+        return NULL;
     }
-
-    free(html);
-    return output;
+    return out.data ? out.data : strdup("");
 }
 
 /**
@@ -1229,6 +1428,7 @@ char *apex_inject_header_ids(const char *html, cmark_node *document, bool genera
     int header_count = 0;
 
     /* Walk AST to collect headers (only markdown HEADING nodes, not raw HTML) */
+    apex_attr_pool *pool = apex_attr_pool_new();
     cmark_iter *iter = cmark_iter_new(document);
     cmark_event_type event;
     while ((event = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
@@ -1239,21 +1439,9 @@ char *apex_inject_header_ids(const char *html, cmark_node *document, bool genera
             char *id = NULL;
 
             /* Check if ID already exists from IAL or manual ID (stored in user_data) */
-            char *user_data = (char *)cmark_node_get_user_data(node);
-            if (user_data) {
-                const char *id_attr = strstr(user_data, "id=\"");
-                if (id_attr) {
-                    const char *id_start = id_attr + 4;
-                    const char *id_end = strchr(id_start, '"');
-                    if (id_end && id_end > id_start) {
-                        size_t id_len = id_end - id_start;
-                        id = malloc(id_len + 1);
-                        if (id) {
-                            memcpy(id, id_start, id_len);
-                            id[id_len] = '\0';
-                        }
-                    }
-                }
+            const apex_attributes *attrs = apex_attr_pool_get(pool, node);
+            if (attrs && attrs->id && *attrs->id) {
+                id = strdup(attrs->id);
             }
 
             if (!id) {
@@ -1276,6 +1464,7 @@ char *apex_inject_header_ids(const char *html, cmark_node *document, bool genera
         }
     }
     cmark_iter_free(iter);
+    apex_attr_pool_free(pool);
 
     if (!header_map) {
         return strdup(html);
@@ -2153,185 +2342,6 @@ char *apex_remove_table_separator_rows(const char *html) {
     return output;
 }
 
-/**
- * Adjust header levels in HTML based on Base Header Level metadata
- * Shifts all headers by the specified offset (e.g., Base Header Level: 2 means h1->h2, h2->h3, etc.)
- */
-char *apex_adjust_header_levels(const char *html, int base_header_level) {
-    if (!html || base_header_level <= 0 || base_header_level > 6) {
-        return html ? strdup(html) : NULL;
-    }
-
-    /* If base_header_level is 1, no adjustment needed */
-    if (base_header_level == 1) {
-        return strdup(html);
-    }
-
-    size_t len = strlen(html);
-    size_t capacity = len + 1024;  /* Extra space for potential changes */
-    char *output = malloc(capacity);
-    if (!output) return NULL;
-
-    const char *read = html;
-    char *write = output;
-    size_t remaining = capacity;
-
-    while (*read) {
-        /* Look for header opening tags: <h1>, <h2>, etc. or closing tags: </h1>, </h2>, etc. */
-        bool is_closing_tag = false;
-        int header_level = -1;
-
-        if (*read == '<') {
-            /* Check for closing tag </h1> first */
-            if (read[1] == '/' && read[2] == 'h' &&
-                read[3] >= '1' && read[3] <= '6' && read[4] == '>') {
-                is_closing_tag = true;
-                header_level = read[3] - '0';
-            }
-            /* Check for opening tag <h1> or <h1 ...> */
-            else if (read[1] == 'h' && read[2] >= '1' && read[2] <= '6' &&
-                     (read[3] == '>' || isspace((unsigned char)read[3]))) {
-                is_closing_tag = false;
-                header_level = read[2] - '0';
-            }
-        }
-
-        if (header_level >= 1 && header_level <= 6) {
-            /* Calculate new level */
-            int new_level = header_level + (base_header_level - 1);
-
-            /* Clamp to valid range (1-6) */
-            if (new_level > 6) {
-                new_level = 6;
-            } else if (new_level < 1) {
-                new_level = 1;
-            }
-
-            /* Find the end of the tag */
-            const char *tag_start = read;
-            const char *tag_end = strchr(tag_start, '>');
-            if (!tag_end) {
-                /* Malformed tag, just copy */
-                if (remaining > 0) {
-                    *write++ = *read++;
-                    remaining--;
-                } else {
-                    read++;
-                }
-                continue;
-            }
-
-            /* Check if we need to adjust the level */
-            if (new_level != header_level) {
-                /* Need to replace h<header_level> with h<new_level> */
-                size_t tag_len = tag_end - tag_start;
-
-                /* Ensure we have enough space */
-                if (remaining < tag_len + 10) {
-                    size_t written = write - output;
-                    capacity = (written + tag_len + 10) * 2;
-                    char *new_output = realloc(output, capacity);
-                    if (!new_output) {
-                        free(output);
-                        return NULL;
-                    }
-                    output = new_output;
-                    write = output + written;
-                    remaining = capacity - written;
-                }
-
-                if (is_closing_tag) {
-                    /* Closing tag: </h1> -> </h2> */
-                    *write++ = '<';
-                    *write++ = '/';
-                    *write++ = 'h';
-                    *write++ = '0' + new_level;
-                    *write++ = '>';
-                    remaining -= 5;
-                    read = tag_end + 1;
-                } else {
-                    /* Opening tag: <h1> or <h1 ...> */
-                    const char *h_pos = tag_start + 1;  /* After '<' */
-                    size_t before_h = h_pos - tag_start;
-                    memcpy(write, tag_start, before_h);
-                    write += before_h;
-                    remaining -= before_h;
-
-                    /* Write 'h' */
-                    *write++ = 'h';
-                    remaining--;
-
-                    /* Write new level */
-                    *write++ = '0' + new_level;
-                    remaining--;
-
-                    /* Copy rest of tag */
-                    const char *after_level = tag_start + 3;  /* After 'h' and level digit */
-                    size_t rest_len = tag_end - after_level;
-                    if (rest_len > 0 && remaining >= rest_len) {
-                        memcpy(write, after_level, rest_len);
-                        write += rest_len;
-                        remaining -= rest_len;
-                    }
-
-                    /* Copy closing '>' */
-                    *write++ = '>';
-                    remaining--;
-
-                    read = tag_end + 1;
-                }
-            } else {
-                /* No change needed, copy tag as-is */
-                size_t tag_len = tag_end - tag_start + 1;
-                if (tag_len < remaining) {
-                    memcpy(write, tag_start, tag_len);
-                    write += tag_len;
-                    remaining -= tag_len;
-                } else {
-                    /* Need more space */
-                    size_t written = write - output;
-                    capacity = (written + tag_len + 1) * 2;
-                    char *new_output = realloc(output, capacity);
-                    if (!new_output) {
-                        free(output);
-                        return NULL;
-                    }
-                    output = new_output;
-                    write = output + written;
-                    remaining = capacity - written;
-                    memcpy(write, tag_start, tag_len);
-                    write += tag_len;
-                    remaining -= tag_len;
-                }
-                read = tag_end + 1;
-            }
-        } else {
-            /* Not a header tag, copy character */
-            if (remaining > 0) {
-                *write++ = *read++;
-                remaining--;
-            } else {
-                /* Need more space */
-                size_t written = write - output;
-                capacity = (written + 1) * 2;
-                char *new_output = realloc(output, capacity);
-                if (!new_output) {
-                    free(output);
-                    return NULL;
-                }
-                output = new_output;
-                write = output + written;
-                remaining = capacity - written;
-                *write++ = *read++;
-                remaining--;
-            }
-        }
-    }
-
-    *write = '\0';
-    return output;
-}
-
 /**
  * Adjust quote styles in HTML based on Quotes Language metadata
  * Replaces default English quote entities with language-specific quotes
@@ -3870,6 +3880,7 @@ char *apex_strip_block_paragraph_wrapper(const char *html) {
  */
 static bool file_exists(const char *path) {
     if (!path || !*path) return false;
+    apex_render_cache_note_exists(path);
     struct stat st;
     return (stat(path, &st) == 0 && S_ISREG(st.st_mode));
 }
@@ -15,10 +15,17 @@ extern "C" {
 
 /**
  * Render document to HTML with IAL attribute support
- * This is a wrapper around cmark_render_html that injects attributes
+ * Attributes stored in node user_data are written into each opening tag
+ * as it is rendered
  */
 char *apex_render_html_with_attributes(cmark_node *document, int options);
 
+/**
+ * Render document to HTML with IAL attribute support, placing the
+ * figcaption of captioned tables above (0) or below (1) the table
+ */
+char *apex_render_html_with_caption_position(cmark_node *document, int options, int caption_position);
+
 /**
  * Inject header IDs into HTML output
  * @param html The HTML output
@@ -76,15 +83,6 @@ char *apex_remove_table_blank_lines(const char *html);
  */
 char *apex_remove_table_separator_rows(const char *html);
 
-/**
- * Adjust header levels in HTML based on Base Header Level metadata
- * Shifts all headers by the specified offset (e.g., Base Header Level: 2 means h1->h2, h2->h3, etc.)
- * @param html The HTML to process
- * @param base_header_level The base header level (1-6, or 0 to disable)
- * @return Newly allocated HTML with adjusted header levels (must be freed)
- */
-char *apex_adjust_header_levels(const char *html, int base_header_level);
-
 /**
  * Adjust quote styles in HTML based on Quotes Language metadata
  * Replaces default English quote entities with language-specific quotes
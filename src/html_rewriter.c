@@ -0,0 +1,428 @@
+/**
+ * Single-pass HTML Rewriter for Apex
+ * Implementation
+ */
+
+#include "html_rewriter.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} rw_buf;
+
+typedef struct {
+    const char *tag_name;   /* NULL: every tag (tag stages only) */
+    apex_html_tag_func on_tag;
+    apex_html_text_func on_text;
+    void *state;
+} rw_stage;
+
+struct apex_html_rewriter {
+    rw_stage *stages;
+    size_t count;
+    size_t capacity;
+    size_t tag_stages;
+    size_t text_stages;
+
+    rw_buf output;
+
+    /* Current token; points into the input or into scratch[active] */
+    const char *cur;
+    size_t cur_len;
+    bool replaced;
+    rw_buf scratch[2];
+    int active;
+
+    int code_depth;
+    bool failed;
+};
+
+static bool rw_buf_reserve(apex_html_rewriter *rw, rw_buf *buf, size_t need) {
+    if (need + 1 <= buf->cap) return true;
+    size_t new_cap = buf->cap ? buf->cap : 256;
+    while (new_cap < need + 1) new_cap *= 2;
+    char *new_data = realloc(buf->data, new_cap);
+    if (!new_data) {
+        rw->failed = true;
+        return false;
+    }
+    buf->data = new_data;
+    buf->cap = new_cap;
+    return true;
+}
+
+static bool rw_buf_append(apex_html_rewriter *rw, rw_buf *buf, const char *data, size_t len) {
+    if (len == 0) return true;
+    if (!rw_buf_reserve(rw, buf, buf->len + len)) return false;
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+    return true;
+}
+
+static void rw_buf_free(rw_buf *buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+static const char *rw_find_unquoted_gt(const char *p, const char *end) {
+    int quote = 0;
+    while (p < end) {
+        if (quote) {
+            if (*p == quote) quote = 0;
+            p++;
+            continue;
+        }
+        if (*p == '"' || *p == '\'') {
+            quote = *p;
+            p++;
+            continue;
+        }
+        if (*p == '>') return p;
+        p++;
+    }
+    return NULL;
+}
+
+/* Find needle in [p, end); case-insensitive when `fold` is set */
+static const char *rw_find(const char *p, const char *end, const char *needle, bool fold) {
+    size_t nlen = strlen(needle);
+    while ((size_t)(end - p) >= nlen) {
+        size_t i = 0;
+        if (fold) {
+            while (i < nlen && tolower((unsigned char)p[i]) == needle[i]) i++;
+        } else {
+            while (i < nlen && p[i] == needle[i]) i++;
+        }
+        if (i == nlen) return p;
+        p++;
+    }
+    return NULL;
+}
+
+static bool rw_name_char(char c) {
+    return isalnum((unsigned char)c) || c == '-' || c == '_' || c == ':';
+}
+
+/* Parse a start or end tag at p; false if p does not begin a complete tag */
+static bool rw_parse_tag(const char *p, const char *end, apex_html_tag *tag) {
+    if (end - p < 3 || p[0] != '<') return false;
+
+    bool closing = (p[1] == '/');
+    const char *name = p + (closing ? 2 : 1);
+    if (name >= end || !isalpha((unsigned char)*name)) return false;
+
+    const char *name_end = name;
+    while (name_end < end && rw_name_char(*name_end)) name_end++;
+
+    const char *gt = rw_find_unquoted_gt(name_end, end);
+    if (!gt) return false;
+
+    const char *last = gt - 1;
+    while (last > name_end && isspace((unsigned char)*last)) last--;
+
+    tag->raw = p;
+    tag->len = (size_t)(gt + 1 - p);
+    tag->name = name;
+    tag->name_len = (size_t)(name_end - name);
+    tag->closing = closing;
+    tag->self_closing = !closing && last >= name_end && *last == '/';
+    return true;
+}
+
+static bool rw_name_is(const char *name, size_t name_len, const char *want) {
+    size_t i = 0;
+    for (; i < name_len && want[i]; i++) {
+        if (tolower((unsigned char)name[i]) != tolower((unsigned char)want[i])) return false;
+    }
+    return i == name_len && want[i] == '\0';
+}
+
+apex_html_rewriter *apex_html_rewriter_new(void) {
+    return calloc(1, sizeof(apex_html_rewriter));
+}
+
+void apex_html_rewriter_free(apex_html_rewriter *rw) {
+    if (!rw) return;
+    rw_buf_free(&rw->output);
+    rw_buf_free(&rw->scratch[0]);
+    rw_buf_free(&rw->scratch[1]);
+    free(rw->stages);
+    free(rw);
+}
+
+static bool rw_add_stage(apex_html_rewriter *rw, const char *tag_name,
+                         apex_html_tag_func on_tag, apex_html_text_func on_text, void *state) {
+    if (rw->count == rw->capacity) {
+        size_t new_cap = rw->capacity ? rw->capacity * 2 : 8;
+        rw_stage *new_stages = realloc(rw->stages, new_cap * sizeof(rw_stage));
+        if (!new_stages) return false;
+        rw->stages = new_stages;
+        rw->capacity = new_cap;
+    }
+    rw->stages[rw->count].tag_name = tag_name;
+    rw->stages[rw->count].on_tag = on_tag;
+    rw->stages[rw->count].on_text = on_text;
+    rw->stages[rw->count].state = state;
+    rw->count++;
+    return true;
+}
+
+bool apex_html_rewriter_on_tag(apex_html_rewriter *rw,
+                               const char *tag_name,
+                               apex_html_tag_func on_tag,
+                               void *state) {
+    if (!rw || !on_tag) return false;
+    if (!rw_add_stage(rw, tag_name, on_tag, NULL, state)) return false;
+    rw->tag_stages++;
+    return true;
+}
+
+bool apex_html_rewriter_on_text(apex_html_rewriter *rw,
+                                apex_html_text_func on_text,
+                                void *state) {
+    if (!rw || !on_text) return false;
+    if (!rw_add_stage(rw, NULL, NULL, on_text, state)) return false;
+    rw->text_stages++;
+    return true;
+}
+
+size_t apex_html_rewriter_stage_count(const apex_html_rewriter *rw) {
+    return rw ? rw->count : 0;
+}
+
+void apex_html_rewriter_replace(apex_html_rewriter *rw, const char *text, size_t len) {
+    if (!rw || (!text && len > 0)) return;
+
+    /* Write into the scratch buffer the current token does not live in */
+    rw_buf *target = &rw->scratch[!rw->active];
+    size_t inside = (text && target->data && text >= target->data &&
+                     text < target->data + target->cap)
+                        ? (size_t)(text - target->data) : (size_t)-1;
+
+    if (!rw_buf_reserve(rw, target, len)) return;
+    if (inside != (size_t)-1) {
+        memmove(target->data, target->data + inside, len);
+    } else if (len > 0) {
+        memcpy(target->data, text, len);
+    }
+    target->len = len;
+    target->data[len] = '\0';
+
+    rw->active = !rw->active;
+    rw->cur = target->data;
+    rw->cur_len = len;
+    rw->replaced = true;
+}
+
+void apex_html_rewriter_append_to_tag(apex_html_rewriter *rw, const apex_html_tag *tag,
+                                      const char *text, size_t len) {
+    if (!rw || !tag || tag->len == 0) return;
+
+    size_t head = tag->len - 1;  /* Everything before '>' */
+    char *joined = malloc(head + len + 2);
+    if (!joined) {
+        rw->failed = true;
+        return;
+    }
+    memcpy(joined, tag->raw, head);
+    memcpy(joined + head, text, len);
+    joined[head + len] = '>';
+    joined[head + len + 1] = '\0';
+    apex_html_rewriter_replace(rw, joined, head + len + 1);
+    free(joined);
+}
+
+bool apex_html_rewriter_in_code(const apex_html_rewriter *rw) {
+    return rw && rw->code_depth > 0;
+}
+
+const char *apex_html_tag_attr(const apex_html_tag *tag, const char *attr, size_t *value_len) {
+    if (value_len) *value_len = 0;
+    if (!tag || !attr || tag->closing) return NULL;
+
+    size_t attr_len = strlen(attr);
+    const char *p = tag->name + tag->name_len;
+    const char *end = tag->raw + tag->len - 1;  /* At '>' */
+
+    while (p < end) {
+        while (p < end && (isspace((unsigned char)*p) || *p == '/')) p++;
+        const char *name = p;
+        while (p < end && !isspace((unsigned char)*p) && *p != '=' && *p != '>' && *p != '/') p++;
+        size_t name_len = (size_t)(p - name);
+        if (name_len == 0) break;
+
+        while (p < end && isspace((unsigned char)*p)) p++;
+        const char *value = p;
+        size_t len = 0;
+        if (p < end && *p == '=') {
+            p++;
+            while (p < end && isspace((unsigned char)*p)) p++;
+            if (p < end && (*p == '"' || *p == '\'')) {
+                char quote = *p++;
+                value = p;
+                while (p < end && *p != quote) p++;
+                len = (size_t)(p - value);
+                if (p < end) p++;
+            } else {
+                value = p;
+                while (p < end && !isspace((unsigned char)*p)) p++;
+                len = (size_t)(p - value);
+            }
+        }
+
+        if (name_len == attr_len && rw_name_is(name, name_len, attr)) {
+            if (value_len) *value_len = len;
+            return value;
+        }
+    }
+    return NULL;
+}
+
+bool apex_html_tag_is(const apex_html_tag *tag, const char *name) {
+    return tag && name && rw_name_is(tag->name, tag->name_len, name);
+}
+
+static void rw_emit_text(apex_html_rewriter *rw, const char *text, size_t len) {
+    if (len == 0) return;
+    if (rw->text_stages == 0) {
+        rw_buf_append(rw, &rw->output, text, len);
+        return;
+    }
+
+    rw->cur = text;
+    rw->cur_len = len;
+    for (size_t i = 0; i < rw->count && !rw->failed; i++) {
+        rw_stage *stage = &rw->stages[i];
+        if (!stage->on_text) continue;
+        stage->on_text(stage->state, rw->cur, rw->cur_len, rw);
+    }
+    rw_buf_append(rw, &rw->output, rw->cur, rw->cur_len);
+}
+
+static void rw_emit_tag(apex_html_rewriter *rw, const apex_html_tag *source) {
+    if (rw->tag_stages > 0) {
+        apex_html_tag current = *source;
+        rw->cur = source->raw;
+        rw->cur_len = source->len;
+
+        for (size_t i = 0; i < rw->count && !rw->failed; i++) {
+            rw_stage *stage = &rw->stages[i];
+            if (!stage->on_tag) continue;
+            if (stage->tag_name && !rw_name_is(current.name, current.name_len, stage->tag_name)) continue;
+
+            rw->replaced = false;
+            stage->on_tag(stage->state, &current, rw);
+            if (!rw->replaced) continue;
+
+            /* Later stages only see the replacement if it is still one tag */
+            apex_html_tag reparsed;
+            if (!rw_parse_tag(rw->cur, rw->cur + rw->cur_len, &reparsed) ||
+                reparsed.len != rw->cur_len) {
+                break;
+            }
+            reparsed.offset = source->offset;
+            reparsed.end = source->end;
+            current = reparsed;
+        }
+        rw_buf_append(rw, &rw->output, rw->cur, rw->cur_len);
+    } else {
+        rw_buf_append(rw, &rw->output, source->raw, source->len);
+    }
+
+    /* Track <pre>/<code> nesting for apex_html_rewriter_in_code() */
+    if (rw_name_is(source->name, source->name_len, "pre") ||
+        rw_name_is(source->name, source->name_len, "code")) {
+        if (source->closing) {
+            if (rw->code_depth > 0) rw->code_depth--;
+        } else if (!source->self_closing) {
+            rw->code_depth++;
+        }
+    }
+}
+
+char *apex_html_rewriter_run(apex_html_rewriter *rw, const char *html, size_t len) {
+    if (!rw || !html) return NULL;
+
+    rw->output.len = 0;
+    rw->code_depth = 0;
+    rw->failed = false;
+
+    /* Most stages change only a few bytes per token */
+    if (!rw_buf_reserve(rw, &rw->output, len + len / 8 + 64)) return NULL;
+    rw->output.data[0] = '\0';
+
+    const char *p = html;
+    const char *end = html + len;
+    const char *text_start = html;
+
+    while (p < end && !rw->failed) {
+        const char *lt = memchr(p, '<', (size_t)(end - p));
+        if (!lt) break;
+
+        const char *token_end = NULL;
+
+        if (end - lt >= 4 && memcmp(lt, "<!--", 4) == 0) {
+            const char *close = rw_find(lt + 4, end, "-->", false);
+            token_end = close ? close + 3 : end;
+        } else if (end - lt >= 9 && memcmp(lt, "<![CDATA[", 9) == 0) {
+            const char *close = rw_find(lt + 9, end, "]]>", false);
+            token_end = close ? close + 3 : end;
+        } else if (lt + 1 < end && (lt[1] == '!' || lt[1] == '?')) {
+            const char *gt = rw_find_unquoted_gt(lt, end);
+            token_end = gt ? gt + 1 : end;
+        } else {
+            apex_html_tag tag;
+            if (!rw_parse_tag(lt, end, &tag)) {
+                if (lt + 1 < end && (isalpha((unsigned char)lt[1]) || lt[1] == '/')) {
+                    /* Unterminated tag: copy the rest as-is */
+                    token_end = end;
+                } else {
+                    /* A bare '<' is character data */
+                    p = lt + 1;
+                    continue;
+                }
+            } else {
+                rw_emit_text(rw, text_start, (size_t)(lt - text_start));
+                tag.offset = (size_t)(lt - html);
+                tag.end = tag.offset + tag.len;
+                rw_emit_tag(rw, &tag);
+                p = text_start = lt + tag.len;
+
+                /* Script and style contents are copied through as-is */
+                const char *raw_close = NULL;
+                if (!tag.closing && !tag.self_closing) {
+                    if (rw_name_is(tag.name, tag.name_len, "script")) raw_close = "</script";
+                    else if (rw_name_is(tag.name, tag.name_len, "style")) raw_close = "</style";
+                }
+                if (raw_close) {
+                    const char *close = rw_find(p, end, raw_close, true);
+                    const char *raw_end = close ? close : end;
+                    rw_buf_append(rw, &rw->output, p, (size_t)(raw_end - p));
+                    p = text_start = raw_end;
+                }
+                continue;
+            }
+        }
+
+        /* Comment, CDATA, declaration or unterminated tag: copied untouched */
+        rw_emit_text(rw, text_start, (size_t)(lt - text_start));
+        rw_buf_append(rw, &rw->output, lt, (size_t)(token_end - lt));
+        p = text_start = token_end;
+    }
+    rw_emit_text(rw, text_start, (size_t)(end - text_start));
+
+    if (rw->failed) return NULL;
+
+    char *result = rw->output.data;
+    rw->output.data = NULL;
+    rw->output.len = 0;
+    rw->output.cap = 0;
+    return result;
+}
@@ -0,0 +1,135 @@
+/**
+ * Single-pass HTML Rewriter for Apex
+ *
+ * Post-render fix-ups register per-tag and per-text-run callbacks on a
+ * rewriter, which tokenizes the rendered HTML once and dispatches every
+ * token through the registered stages in order. N fused stages cost one
+ * walk over the document instead of N full copies and rescans.
+ *
+ * Comments, CDATA sections, declarations and the contents of script and
+ * style elements are copied through untouched and never reach a callback.
+ *
+ * A callback rewrites the current token with apex_html_rewriter_replace().
+ * Later stages see the replacement: text stays text, and a tag replaced by
+ * another single tag is re-parsed. A tag replaced by anything else (e.g.
+ * <hr> -> <div>...</div>) is final and skips the remaining tag stages.
+ *
+ * Stages on the rewriter: hr page breaks, the poetry class, hashed
+ * footnote ids, the page break before footnotes, Base Header Level, and
+ * XHTML void tags. The other post-render stages in apex_markdown_to_html
+ * still take the whole string. They rewrite across tokens (figures and
+ * captions, header ids, TOC, tables, lists), depend on text collected
+ * from the whole document (abbreviations, citations, index), or
+ * run external tools (syntax highlighting, plugins).
+ */
+
+#ifndef APEX_HTML_REWRITER_H
+#define APEX_HTML_REWRITER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct apex_html_rewriter apex_html_rewriter;
+
+/**
+ * A start or end tag as seen by a tag callback. `raw` covers the whole tag
+ * from '<' to '>' and, like `name`, is only valid during the call.
+ */
+typedef struct {
+    const char *raw;
+    size_t len;
+    const char *name;     /* Tag name as written (not lowercased) */
+    size_t name_len;
+    bool closing;         /* </name> */
+    bool self_closing;    /* <name ... /> */
+    size_t offset;        /* Source span of the tag in the input HTML; */
+    size_t end;           /* unchanged by rewrites in earlier stages */
+} apex_html_tag;
+
+typedef void (*apex_html_tag_func)(void *state, const apex_html_tag *tag, apex_html_rewriter *rw);
+
+/**
+ * Text handler. `text` is a maximal run of character data between two
+ * tokens and is only valid for the duration of the call.
+ */
+typedef void (*apex_html_text_func)(void *state, const char *text, size_t len, apex_html_rewriter *rw);
+
+/**
+ * Create an empty rewriter. Free with apex_html_rewriter_free().
+ */
+apex_html_rewriter *apex_html_rewriter_new(void);
+
+/**
+ * Free a rewriter. Stage state pointers are owned by the caller.
+ */
+void apex_html_rewriter_free(apex_html_rewriter *rw);
+
+/**
+ * Register a tag stage. With a non-NULL `tag_name` the callback only sees
+ * start and end tags of that element (compared case-insensitively).
+ * @return false on allocation failure
+ */
+bool apex_html_rewriter_on_tag(apex_html_rewriter *rw,
+                               const char *tag_name,
+                               apex_html_tag_func on_tag,
+                               void *state);
+
+/**
+ * Register a text stage
+ * @return false on allocation failure
+ */
+bool apex_html_rewriter_on_text(apex_html_rewriter *rw,
+                                apex_html_text_func on_text,
+                                void *state);
+
+/**
+ * Number of registered stages (tag and text)
+ */
+size_t apex_html_rewriter_stage_count(const apex_html_rewriter *rw);
+
+/**
+ * Run all stages over `html` in a single pass
+ * @return Newly allocated string (must be freed), or NULL on error
+ */
+char *apex_html_rewriter_run(apex_html_rewriter *rw, const char *html, size_t len);
+
+/**
+ * Replace the current token (from inside a callback). `text` may point
+ * into the current token.
+ */
+void apex_html_rewriter_replace(apex_html_rewriter *rw, const char *text, size_t len);
+
+/**
+ * Replace the current tag with a copy that has `text` inserted just
+ * before its closing '>' (e.g. " class=\"x\"" or " /").
+ */
+void apex_html_rewriter_append_to_tag(apex_html_rewriter *rw, const apex_html_tag *tag,
+                                      const char *text, size_t len);
+
+/**
+ * True while the current token is inside a <pre> or <code> element
+ */
+bool apex_html_rewriter_in_code(const apex_html_rewriter *rw);
+
+/**
+ * Find an attribute on a start tag
+ * @return Pointer to the (unquoted) value with its length in *value_len,
+ *         or NULL if the attribute is absent. Valueless attributes return
+ *         an empty value.
+ */
+const char *apex_html_tag_attr(const apex_html_tag *tag, const char *attr, size_t *value_len);
+
+/**
+ * Case-insensitive tag name comparison
+ */
+bool apex_html_tag_is(const apex_html_tag *tag, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APEX_HTML_REWRITER_H */
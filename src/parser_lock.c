@@ -0,0 +1,158 @@
+/**
+ * Serialized Inline Parsing
+ * Implementation
+ */
+
+#include "parser_lock.h"
+#include "parser.h"
+#include "inlines.h"
+#include "syntax_extension.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+static pthread_mutex_t finish_lock;
+static pthread_once_t finish_lock_once = PTHREAD_ONCE_INIT;
+
+/* Set on the threads of an apex_parsers_finish() call, whose triggers are
+ * installed for the whole call */
+static __thread bool tls_shared_triggers = false;
+
+static void init_finish_lock(void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&finish_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+cmark_node *apex_parser_finish(cmark_parser *parser) {
+    /* The calling apex_parsers_finish() holds the lock on another thread */
+    if (tls_shared_triggers) return cmark_parser_finish(parser);
+
+    pthread_once(&finish_lock_once, init_finish_lock);
+    pthread_mutex_lock(&finish_lock);
+    cmark_node *document = cmark_parser_finish(parser);
+    pthread_mutex_unlock(&finish_lock);
+    return document;
+}
+
+/* An inline extension whose trigger list is detached for the duration */
+typedef struct {
+    cmark_syntax_extension *ext;
+    cmark_llist *chars;
+} detached_triggers;
+
+typedef struct {
+    cmark_parser *parser;
+    cmark_node *document;
+} finish_job;
+
+static void *finish_worker(void *arg) {
+    finish_job *job = (finish_job *)arg;
+    tls_shared_triggers = true;
+    job->document = cmark_parser_finish(job->parser);
+    tls_shared_triggers = false;
+    return NULL;
+}
+
+static void set_triggers(cmark_llist *chars, bool emphasis, bool add) {
+    for (cmark_llist *c = chars; c; c = c->next) {
+        unsigned char ch = (unsigned char)(size_t)c->data;
+        if (add) {
+            cmark_inlines_add_special_character(ch, emphasis);
+        } else {
+            cmark_inlines_remove_special_character(ch, emphasis);
+        }
+    }
+}
+
+static void restore_triggers(detached_triggers *detached, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        detached[i].ext->special_inline_chars = detached[i].chars;
+        set_triggers(detached[i].chars, detached[i].ext->emphasis, false);
+    }
+    free(detached);
+}
+
+/**
+ * Install the triggers of every parser's inline extensions and detach the
+ * lists from the extensions, so the finishes below neither add nor clear
+ * any. Extensions shared between parsers are detached once. Returns false,
+ * with everything restored, when out of memory.
+ */
+static bool detach_triggers(cmark_parser **parsers, size_t count,
+                            detached_triggers **out, size_t *out_count) {
+    size_t cap = 0, n = 0;
+    detached_triggers *detached = NULL;
+    for (size_t i = 0; i < count; i++) {
+        for (cmark_llist *e = parsers[i]->inline_syntax_extensions; e; e = e->next) {
+            cmark_syntax_extension *ext = (cmark_syntax_extension *)e->data;
+            if (!ext->special_inline_chars) continue;
+            if (n == cap) {
+                size_t new_cap = cap ? cap * 2 : 8;
+                detached_triggers *grown = realloc(detached, new_cap * sizeof(detached_triggers));
+                if (!grown) {
+                    restore_triggers(detached, n);
+                    return false;
+                }
+                detached = grown;
+                cap = new_cap;
+            }
+            detached[n].ext = ext;
+            detached[n].chars = ext->special_inline_chars;
+            set_triggers(ext->special_inline_chars, ext->emphasis, true);
+            ext->special_inline_chars = NULL;
+            n++;
+        }
+    }
+    *out = detached;
+    *out_count = n;
+    return true;
+}
+
+bool apex_parsers_finish(cmark_parser **parsers, cmark_node **documents, size_t count) {
+    pthread_once(&finish_lock_once, init_finish_lock);
+    pthread_mutex_lock(&finish_lock);
+
+    size_t slots = count ? count : 1;
+    finish_job *jobs = calloc(slots, sizeof(finish_job));
+    pthread_t *threads = calloc(slots, sizeof(pthread_t));
+    bool *started = calloc(slots, sizeof(bool));
+    detached_triggers *detached = NULL;
+    size_t detached_count = 0;
+    bool ok = true;
+
+    if (!jobs || !threads || !started ||
+        !detach_triggers(parsers, count, &detached, &detached_count)) {
+        /* One at a time, each adding and clearing its own triggers */
+        for (size_t i = 0; i < count; i++) {
+            documents[i] = cmark_parser_finish(parsers[i]);
+            if (!documents[i]) ok = false;
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) jobs[i].parser = parsers[i];
+        for (size_t i = 1; i < count; i++) {
+            started[i] = pthread_create(&threads[i], NULL, finish_worker, &jobs[i]) == 0;
+        }
+        if (count > 0) finish_worker(&jobs[0]);
+        for (size_t i = 1; i < count; i++) {
+            if (started[i]) {
+                pthread_join(threads[i], NULL);
+            } else {
+                finish_worker(&jobs[i]);
+            }
+        }
+        restore_triggers(detached, detached_count);
+
+        for (size_t i = 0; i < count; i++) {
+            documents[i] = jobs[i].document;
+            if (!documents[i]) ok = false;
+        }
+    }
+
+    pthread_mutex_unlock(&finish_lock);
+    free(jobs);
+    free(threads);
+    free(started);
+    return ok;
+}
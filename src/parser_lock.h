@@ -0,0 +1,56 @@
+/**
+ * Serialized Inline Parsing
+ *
+ * cmark-gfm keeps the inline parser's trigger-character tables
+ * (SPECIAL_CHARS / SKIP_CHARS in inlines.c) in process globals. Each
+ * cmark_parser_finish() adds the characters of the parser's inline
+ * extensions (~ for strikethrough, : and w for autolinks, $ and \ for
+ * math) when inline parsing starts and clears them when it ends, so two
+ * parsers finishing at once can strip each other's triggers mid-parse.
+ *
+ * Every cmark_parser_finish() in Apex goes through apex_parser_finish(),
+ * which holds one process-wide lock for the duration. Block parsing
+ * (cmark_parser_feed) doesn't touch the tables and still runs
+ * concurrently.
+ *
+ * apex_parsers_finish() is the exception for the chunks of one document:
+ * it installs the triggers of all its parsers once, keeps them installed
+ * while the parsers finish on their own threads, and clears them when the
+ * last one is done.
+ */
+
+#ifndef APEX_PARSER_LOCK_H
+#define APEX_PARSER_LOCK_H
+
+#include "cmark-gfm.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * cmark_parser_finish() under the process-wide inline parsing lock.
+ * The lock is recursive, so extensions may finish nested parsers from
+ * their postprocess callbacks.
+ */
+cmark_node *apex_parser_finish(cmark_parser *parser);
+
+/**
+ * Finish count parsers concurrently, parsers[0] on the calling thread and
+ * the rest on threads of their own, storing each document in documents[i]
+ * (NULL when that parser failed).
+ *
+ * The lock is held throughout, so no other finish can change the trigger
+ * tables meanwhile. Parsers finished from postprocess callbacks during
+ * the call must attach no inline extensions besides those of the parsers
+ * passed in. Returns false if any parser failed.
+ */
+bool apex_parsers_finish(cmark_parser **parsers, cmark_node **documents, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APEX_PARSER_LOCK_H */
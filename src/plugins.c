@@ -19,7 +19,8 @@ char *apex_run_external_plugin_command(const char *cmd,
                                        const char *phase,
                                        const char *plugin_id,
                                        const char *text,
-                                       int timeout_ms);
+                                       int timeout_ms,
+                                       char *const *envp);
 
 /* ------------------------------------------------------------------------- */
 /* Profiling helpers                                                         */
@@ -831,73 +832,27 @@ char *apex_plugins_run_text_phase(apex_plugin_manager *manager,
         }
 
         if (p->handler_command) {
-            /* Temporarily set APEX_PLUGIN_DIR, APEX_SUPPORT_DIR, and APEX_FILE_PATH for this plugin */
-            char *old_dir = NULL;
-            char *old_support = NULL;
-            char *old_file_path = NULL;
-
-            const char *prev_dir = getenv("APEX_PLUGIN_DIR");
-            if (prev_dir) {
-                old_dir = strdup(prev_dir);
-            }
-            if (p->dir_path) {
-                setenv("APEX_PLUGIN_DIR", p->dir_path, 1);
-            }
-
-            const char *prev_support = getenv("APEX_SUPPORT_DIR");
-            if (prev_support) {
-                old_support = strdup(prev_support);
-            }
-            if (p->support_dir) {
-                setenv("APEX_SUPPORT_DIR", p->support_dir, 1);
-            }
-
-            /* APEX_FILE_PATH: full path to input file, or base dir / empty for stdin */
-            const char *prev_file = getenv("APEX_FILE_PATH");
-            if (prev_file) {
-                old_file_path = strdup(prev_file);
-            }
+            /* Pass APEX_PLUGIN_DIR, APEX_SUPPORT_DIR, and APEX_FILE_PATH to this plugin.
+             * APEX_FILE_PATH: full path to input file, or base dir / empty for stdin */
             const char *file_path = (options && options->input_file_path)
                                       ? options->input_file_path
                                       : "";
-            setenv("APEX_FILE_PATH", file_path, 1);
-
-            next = apex_run_external_plugin_command(p->handler_command,
-                                                    phase_name,
-                                                    plugin_id,
-                                                    current,
-                                                    p->timeout_ms);
-
-            /* Restore previous APEX_PLUGIN_DIR */
-            if (p->dir_path) {
-                if (old_dir) {
-                    setenv("APEX_PLUGIN_DIR", old_dir, 1);
-                    free(old_dir);
-                } else {
-                    unsetenv("APEX_PLUGIN_DIR");
-                }
-            } else if (old_dir) {
-                free(old_dir);
-            }
-
-            /* Restore previous APEX_SUPPORT_DIR */
-            if (p->support_dir) {
-                if (old_support) {
-                    setenv("APEX_SUPPORT_DIR", old_support, 1);
-                    free(old_support);
-                } else {
-                    unsetenv("APEX_SUPPORT_DIR");
-                }
-            } else if (old_support) {
-                free(old_support);
-            }
-
-            /* Restore previous APEX_FILE_PATH */
-            if (old_file_path) {
-                setenv("APEX_FILE_PATH", old_file_path, 1);
-                free(old_file_path);
-            } else {
-                unsetenv("APEX_FILE_PATH");
+            const char *env_pairs[] = {
+                "APEX_PLUGIN_DIR", p->dir_path,
+                "APEX_SUPPORT_DIR", p->support_dir,
+                "APEX_FILE_PATH", file_path,
+                NULL
+            };
+            char **envp = apex_child_env_new(env_pairs);
+
+            if (envp) {
+                next = apex_run_external_plugin_command(p->handler_command,
+                                                        phase_name,
+                                                        plugin_id,
+                                                        current,
+                                                        p->timeout_ms,
+                                                        envp);
+                apex_child_env_free(envp);
             }
         } else if (p->has_regex) {
             next = apply_regex_replacement(p, current);
@@ -22,6 +22,16 @@ char *apex_plugins_run_text_phase(apex_plugin_manager *manager,
                                   const char *text,
                                   const apex_options *options);
 
+/* Build an environment for a child process: a copy of the current
+ * environment with the given NAME, VALUE pairs (NULL-terminated list)
+ * set. Pairs with a NULL value are left as inherited. The environment is
+ * built in the parent so that plugins and filters can be run from several
+ * threads without calling setenv(). Free with apex_child_env_free(). */
+char **apex_child_env_new(const char *const *pairs);
+
+/* Free an environment returned by apex_child_env_new(). */
+void apex_child_env_free(char **envp);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,4 +1,6 @@
 #include "../include/apex/apex.h"
+#include "plugins.h"
+#include "stats.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -6,6 +8,7 @@
 #include <sys/wait.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdbool.h>
 
 /**
  * Very small helper to JSON-escape a string for inclusion as a value.
@@ -47,17 +50,76 @@ char *apex_json_escape(const char *text) {
     return out;
 }
 
+extern char **environ;
+
+char **apex_child_env_new(const char *const *pairs) {
+    size_t inherited = 0;
+    while (environ && environ[inherited]) inherited++;
+    size_t overrides = 0;
+    while (pairs && pairs[overrides * 2]) overrides++;
+
+    char **envp = calloc(inherited + overrides + 1, sizeof(char *));
+    if (!envp) return NULL;
+
+    size_t count = 0;
+    for (size_t i = 0; i < inherited; i++) {
+        /* Drop inherited entries that an override replaces */
+        bool replaced = false;
+        for (size_t j = 0; j < overrides; j++) {
+            const char *name = pairs[j * 2];
+            size_t name_len = strlen(name);
+            if (pairs[j * 2 + 1] && strncmp(environ[i], name, name_len) == 0 &&
+                environ[i][name_len] == '=') {
+                replaced = true;
+                break;
+            }
+        }
+        if (replaced) continue;
+        envp[count] = strdup(environ[i]);
+        if (!envp[count]) goto fail;
+        count++;
+    }
+
+    for (size_t j = 0; j < overrides; j++) {
+        const char *name = pairs[j * 2];
+        const char *value = pairs[j * 2 + 1];
+        if (!value) continue;
+        size_t entry_len = strlen(name) + 1 + strlen(value);
+        envp[count] = malloc(entry_len + 1);
+        if (!envp[count]) goto fail;
+        snprintf(envp[count], entry_len + 1, "%s=%s", name, value);
+        count++;
+    }
+
+    envp[count] = NULL;
+    return envp;
+
+fail:
+    apex_child_env_free(envp);
+    return NULL;
+}
+
+void apex_child_env_free(char **envp) {
+    if (!envp) return;
+    for (char **e = envp; *e; e++) {
+        free(*e);
+    }
+    free(envp);
+}
+
 /**
  * Run a single external plugin command for a text-based phase.
  * Protocol:
  *  - Host sends JSON on stdin with fields: version, plugin_id, phase, text.
  *  - Plugin writes transformed text to stdout (no JSON response parsing).
+ *  - The command runs with envp as its environment (NULL to inherit).
  */
-char *apex_run_external_plugin_command(const char *cmd,
-                                       const char *phase,
-                                       const char *plugin_id,
-                                       const char *text,
-                                       int timeout_ms) {
+static char *run_external_plugin_command(const char *cmd,
+                                         const char *phase,
+                                         const char *plugin_id,
+                                         const char *text,
+                                         int timeout_ms,
+                                         char *const *envp) {
     (void)timeout_ms; /* Reserved for future timeout handling */
     if (!cmd || !*cmd || !text || !phase || !plugin_id) return NULL;
 
@@ -103,7 +165,11 @@ char *apex_run_external_plugin_command(const char *cmd,
         close(in_pipe[0]); close(in_pipe[1]);
         close(out_pipe[0]); close(out_pipe[1]);
 
-        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        if (envp) {
+            execle("/bin/sh", "sh", "-c", cmd, (char *)NULL, envp);
+        } else {
+            execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        }
         /* If exec fails */
         _exit(127);
     }
@@ -171,6 +237,19 @@ char *apex_run_external_plugin_command(const char *cmd,
     return buf;
 }
 
+/* The public runner; its time counts toward conversion statistics */
+char *apex_run_external_plugin_command(const char *cmd,
+                                       const char *phase,
+                                       const char *plugin_id,
+                                       const char *text,
+                                       int timeout_ms,
+                                       char *const *envp) {
+    uint64_t started = apex_stats_subprocess_begin();
+    char *out = run_external_plugin_command(cmd, phase, plugin_id, text, timeout_ms, envp);
+    apex_stats_subprocess_end(started);
+    return out;
+}
+
 /**
  * Backwards-compatible helper: use APEX_PRE_PARSE_PLUGIN env var as a single
  * pre-parse plugin. This is effectively a thin wrapper around the generic
@@ -182,6 +261,6 @@ char *apex_run_preparse_plugin_env(const char *text, const apex_options *options
     if (!cmd || !*cmd || !text) {
         return NULL;
     }
-    return apex_run_external_plugin_command(cmd, "pre_parse", "env-pre-parse", text, 0);
+    return apex_run_external_plugin_command(cmd, "pre_parse", "env-pre-parse", text, 0, NULL);
 }
 
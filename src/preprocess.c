@@ -0,0 +1,281 @@
+/**
+ * Streaming Preprocessor Engine for Apex
+ * Implementation
+ */
+
+#include "preprocess.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} pp_buf;
+
+typedef struct {
+    const char *name;
+    apex_pp_line_func on_line;
+    apex_pp_finish_func on_finish;
+    void *state;
+} pp_stage;
+
+struct apex_pp_sink {
+    apex_preprocessor *pp;
+    size_t index;     /* Index of the stage that owns this sink */
+    pp_buf claim;     /* Lines held back by the stage */
+    pp_buf partial;   /* Emitted text not yet terminated by '\n' */
+};
+
+struct apex_preprocessor {
+    pp_stage *stages;
+    size_t count;
+    size_t capacity;
+    apex_pp_sink *sinks;
+    pp_buf output;
+    bool failed;
+};
+
+static bool pp_buf_append(apex_preprocessor *pp, pp_buf *buf, const char *data, size_t len) {
+    if (len == 0) return true;
+    if (buf->len + len + 1 > buf->cap) {
+        size_t new_cap = buf->cap ? buf->cap : 256;
+        while (new_cap < buf->len + len + 1) new_cap *= 2;
+        char *new_data = realloc(buf->data, new_cap);
+        if (!new_data) {
+            pp->failed = true;
+            return false;
+        }
+        buf->data = new_data;
+        buf->cap = new_cap;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+    return true;
+}
+
+static void pp_buf_free(pp_buf *buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+/* Hand one complete line to stage `index` (or to the output after the last stage) */
+static void pp_feed(apex_preprocessor *pp, size_t index, const char *line, size_t len) {
+    if (index >= pp->count) {
+        pp_buf_append(pp, &pp->output, line, len);
+        return;
+    }
+
+    pp_stage *stage = &pp->stages[index];
+    apex_pp_sink *sink = &pp->sinks[index];
+    apex_pp_result result = stage->on_line(stage->state, line, len, sink);
+    if (result == APEX_PP_PASS) {
+        /* Keep ordering intact when the stage is holding earlier lines */
+        if (sink->claim.len > 0) {
+            apex_pp_claim(sink, line, len);
+        } else {
+            apex_pp_emit(sink, line, len);
+        }
+    }
+}
+
+apex_preprocessor *apex_preprocessor_new(void) {
+    return calloc(1, sizeof(apex_preprocessor));
+}
+
+void apex_preprocessor_free(apex_preprocessor *pp) {
+    if (!pp) return;
+    if (pp->sinks) {
+        for (size_t i = 0; i < pp->count; i++) {
+            pp_buf_free(&pp->sinks[i].claim);
+            pp_buf_free(&pp->sinks[i].partial);
+        }
+        free(pp->sinks);
+    }
+    pp_buf_free(&pp->output);
+    free(pp->stages);
+    free(pp);
+}
+
+bool apex_preprocessor_add_stage(apex_preprocessor *pp,
+                                 const char *name,
+                                 apex_pp_line_func on_line,
+                                 apex_pp_finish_func on_finish,
+                                 void *state) {
+    if (!pp || !on_line) return false;
+
+    if (pp->count == pp->capacity) {
+        size_t new_cap = pp->capacity ? pp->capacity * 2 : 8;
+        pp_stage *new_stages = realloc(pp->stages, new_cap * sizeof(pp_stage));
+        if (!new_stages) return false;
+        pp->stages = new_stages;
+        pp->capacity = new_cap;
+    }
+
+    pp->stages[pp->count].name = name;
+    pp->stages[pp->count].on_line = on_line;
+    pp->stages[pp->count].on_finish = on_finish;
+    pp->stages[pp->count].state = state;
+    pp->count++;
+    return true;
+}
+
+size_t apex_preprocessor_stage_count(const apex_preprocessor *pp) {
+    return pp ? pp->count : 0;
+}
+
+char *apex_preprocessor_run(apex_preprocessor *pp, const char *text, size_t len) {
+    if (!pp || !text) return NULL;
+
+    /* Fresh sinks for this run */
+    if (pp->sinks) {
+        for (size_t i = 0; i < pp->count; i++) {
+            pp_buf_free(&pp->sinks[i].claim);
+            pp_buf_free(&pp->sinks[i].partial);
+        }
+        free(pp->sinks);
+        pp->sinks = NULL;
+    }
+    if (pp->count > 0) {
+        pp->sinks = calloc(pp->count, sizeof(apex_pp_sink));
+        if (!pp->sinks) return NULL;
+        for (size_t i = 0; i < pp->count; i++) {
+            pp->sinks[i].pp = pp;
+            pp->sinks[i].index = i;
+        }
+    }
+    pp->output.len = 0;
+    pp->failed = false;
+
+    /* Reserve roughly the input size up front; most stages grow it only slightly */
+    size_t reserve = len + len / 8 + 64;
+    if (pp->output.cap < reserve) {
+        char *reserved = realloc(pp->output.data, reserve);
+        if (!reserved) return NULL;
+        pp->output.data = reserved;
+        pp->output.cap = reserve;
+    }
+    pp->output.data[0] = '\0';
+
+    /* Single walk over the input: every line travels the whole stage chain */
+    const char *p = text;
+    const char *end = text + len;
+    while (p < end && !pp->failed) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = nl ? nl + 1 : end;
+        pp_feed(pp, 0, p, (size_t)(line_end - p));
+        p = line_end;
+    }
+
+    /* End of input: let each stage flush, in chain order, so flushed text
+     * still flows through the stages after it. */
+    for (size_t i = 0; i < pp->count && !pp->failed; i++) {
+        apex_pp_sink *sink = &pp->sinks[i];
+        if (pp->stages[i].on_finish) {
+            pp->stages[i].on_finish(pp->stages[i].state, sink);
+        }
+        if (sink->claim.len > 0) {
+            apex_pp_release(sink, NULL, 0);
+        }
+        if (sink->partial.len > 0) {
+            pp_feed(pp, i + 1, sink->partial.data, sink->partial.len);
+            sink->partial.len = 0;
+        }
+    }
+
+    if (pp->failed) return NULL;
+
+    char *result = pp->output.data;
+    if (!result) {
+        result = malloc(1);
+        if (result) result[0] = '\0';
+    }
+    pp->output.data = NULL;
+    pp->output.len = 0;
+    pp->output.cap = 0;
+    return result;
+}
+
+void apex_pp_emit(apex_pp_sink *out, const char *data, size_t len) {
+    if (!out || !data) return;
+    apex_preprocessor *pp = out->pp;
+
+    while (len > 0 && !pp->failed) {
+        const char *nl = memchr(data, '\n', len);
+        if (!nl) {
+            pp_buf_append(pp, &out->partial, data, len);
+            return;
+        }
+        size_t seg = (size_t)(nl - data) + 1;
+        if (out->partial.len > 0) {
+            if (!pp_buf_append(pp, &out->partial, data, seg)) return;
+            /* Detach before feeding so nested emits cannot alias the buffer */
+            pp_buf line = out->partial;
+            out->partial.data = NULL;
+            out->partial.len = 0;
+            out->partial.cap = 0;
+            pp_feed(pp, out->index + 1, line.data, line.len);
+            if (!out->partial.data) {
+                line.len = 0;
+                out->partial = line;
+            } else {
+                pp_buf_free(&line);
+            }
+        } else {
+            pp_feed(pp, out->index + 1, data, seg);
+        }
+        data += seg;
+        len -= seg;
+    }
+}
+
+void apex_pp_claim(apex_pp_sink *out, const char *data, size_t len) {
+    if (!out || !data) return;
+    pp_buf_append(out->pp, &out->claim, data, len);
+}
+
+const char *apex_pp_claimed(apex_pp_sink *out, size_t *len) {
+    if (len) *len = out ? out->claim.len : 0;
+    if (!out || out->claim.len == 0) return NULL;
+    return out->claim.data;
+}
+
+void apex_pp_release(apex_pp_sink *out, const char *replacement, size_t len) {
+    if (!out) return;
+
+    /* Take the claim out of the sink first: the replacement may point into
+     * it, and the emit below may let this stage claim again. */
+    pp_buf held = out->claim;
+    out->claim.data = NULL;
+    out->claim.len = 0;
+    out->claim.cap = 0;
+
+    if (replacement) {
+        apex_pp_emit(out, replacement, len);
+    } else if (held.len > 0) {
+        apex_pp_emit(out, held.data, held.len);
+    }
+
+    if (!out->claim.data) {
+        held.len = 0;
+        if (held.data) held.data[0] = '\0';
+        out->claim = held;
+    } else {
+        pp_buf_free(&held);
+    }
+}
+
+void apex_pp_claim_consume(apex_pp_sink *out, size_t consumed) {
+    if (!out || consumed == 0) return;
+    if (consumed >= out->claim.len) {
+        out->claim.len = 0;
+        if (out->claim.data) out->claim.data[0] = '\0';
+        return;
+    }
+    memmove(out->claim.data, out->claim.data + consumed, out->claim.len - consumed);
+    out->claim.len -= consumed;
+    out->claim.data[out->claim.len] = '\0';
+}
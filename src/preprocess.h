@@ -0,0 +1,133 @@
+/**
+ * Streaming Preprocessor Engine for Apex
+ *
+ * Splits the source into lines once and pushes every line through a chain
+ * of registered stage handlers in a single pass. Each stage sees the lines
+ * emitted by the stage before it, so N fused stages cost one walk over the
+ * document instead of N full copies and rescans.
+ *
+ * A stage that needs more than one line of context (a block, or an opener
+ * whose closer is further down) can claim lines: claimed lines are held by
+ * the engine until the stage releases them, either unchanged or replaced
+ * by its own output. Anything still claimed at the end of input is handed
+ * to the stage's finish callback.
+ *
+ * Stages on the engine: highlights and inserts (fused, where the
+ * highlight pass used to run) and hashtags and proofreader (fused, after
+ * markdown-in-HTML). The other preprocessors in apex_markdown_to_html
+ * still take the whole text. Moving them keeps the order in which stages
+ * see the text, so only neighbours in the pipeline are fused:
+ *
+ * 1. sup/sub, which runs right after inserts and is line-local with the
+ *    same code state, joins the highlight/insert pass.
+ * 2. Emoji autocorrect and inline footnotes, just before it, join the
+ *    same pass; inline footnotes claim lines until their "]".
+ * 3. Critic markup, right after the proofreader, joins that pass and
+ *    claims lines for markup that spans them.
+ * 4. Autolinks, image attributes, IALs and spans are line-local but sit
+ *    between whole-document stages (indices before, grid tables after),
+ *    so they become a pass of their own.
+ *
+ * Staying on the whole text: stages that need the whole document first
+ * (metadata and its replacement, citations, includes, abbreviations) and
+ * block rewriters (tables, lists, definition lists, fenced divs, callouts,
+ * code fences, raw content, markdown in HTML). Those would need a block
+ * claim API, which the engine doesn't have.
+ */
+
+#ifndef APEX_PREPROCESS_H
+#define APEX_PREPROCESS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct apex_preprocessor apex_preprocessor;
+
+/* Handle through which a stage writes to the next stage in the chain */
+typedef struct apex_pp_sink apex_pp_sink;
+
+typedef enum {
+    APEX_PP_PASS = 0,     /* Forward the line to the next stage unchanged */
+    APEX_PP_HANDLED = 1   /* Stage emitted, claimed, or dropped the line itself */
+} apex_pp_result;
+
+/**
+ * Line handler. `line` includes its trailing '\n' (the final line of the
+ * input may lack one) and is only valid for the duration of the call.
+ */
+typedef apex_pp_result (*apex_pp_line_func)(void *state, const char *line, size_t len, apex_pp_sink *out);
+
+/**
+ * Called once at end of input, after the last line. Stages use it to flush
+ * claimed lines; anything still claimed afterwards is released unchanged.
+ */
+typedef void (*apex_pp_finish_func)(void *state, apex_pp_sink *out);
+
+/**
+ * Create an empty preprocessor. Free with apex_preprocessor_free().
+ */
+apex_preprocessor *apex_preprocessor_new(void);
+
+/**
+ * Free a preprocessor. Stage state pointers are owned by the caller.
+ */
+void apex_preprocessor_free(apex_preprocessor *pp);
+
+/**
+ * Append a stage to the chain. Stages run in registration order.
+ * @return false on allocation failure
+ */
+bool apex_preprocessor_add_stage(apex_preprocessor *pp,
+                                 const char *name,
+                                 apex_pp_line_func on_line,
+                                 apex_pp_finish_func on_finish,
+                                 void *state);
+
+/**
+ * Number of registered stages.
+ */
+size_t apex_preprocessor_stage_count(const apex_preprocessor *pp);
+
+/**
+ * Run all stages over text in one streaming pass.
+ * @return Newly allocated output (must be freed), or NULL on allocation failure
+ */
+char *apex_preprocessor_run(apex_preprocessor *pp, const char *text, size_t len);
+
+/**
+ * Write data to the next stage. Data may contain any number of lines;
+ * the engine re-splits it before handing it on.
+ */
+void apex_pp_emit(apex_pp_sink *out, const char *data, size_t len);
+
+/**
+ * Hold a line (or any text) back in the stage's claim buffer.
+ */
+void apex_pp_claim(apex_pp_sink *out, const char *data, size_t len);
+
+/**
+ * Currently claimed text (NUL-terminated), or NULL when nothing is claimed.
+ */
+const char *apex_pp_claimed(apex_pp_sink *out, size_t *len);
+
+/**
+ * Release the claimed range. When replacement is NULL the claimed text is
+ * emitted unchanged, otherwise replacement is emitted in its place.
+ */
+void apex_pp_release(apex_pp_sink *out, const char *replacement, size_t len);
+
+/**
+ * Drop the first `consumed` bytes of the claim buffer, keeping the rest
+ * claimed. Used by stages that resolve only part of what they hold.
+ */
+void apex_pp_claim_consume(apex_pp_sink *out, size_t consumed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APEX_PREPROCESS_H */
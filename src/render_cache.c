@@ -0,0 +1,881 @@
+/**
+ * On-disk Render Cache
+ *
+ * An entry lives at <dir>/<2 hex>/<30 hex>, named by a 128-bit hash of the
+ * Apex version, the canonicalized options and the input. It holds the list
+ * of files the conversion depended on, then the output:
+ *
+ *     apex-cache 1
+ *     <key>
+ *     <dependency count>
+ *     <c|e> <exists> <size> <mtime sec> <mtime nsec> <content hash> <path length>
+ *     <path>
+ *     ...
+ *     <output length>
+ *     <output bytes>
+ *
+ * 'c' dependencies were read, so their content matters; 'e' dependencies
+ * were only checked for existence. A dependency whose size and time still
+ * match is taken as unchanged without reading it.
+ *
+ * Entries are written to a dot file and renamed into place. A hit updates
+ * the entry's modification time, which is what eviction sorts by. The
+ * total size of the entries is kept in <dir>/.size under flock(); when a
+ * store pushes it past the limit, the directory is scanned and the least
+ * recently used entries are removed until it is back under 90% of it.
+ */
+
+#include "apex/apex.h"
+#include "render_cache.h"
+#include "extensions/citations.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define CACHE_FORMAT "apex-cache 1"
+#define CACHE_DEFAULT_MAX_BYTES ((size_t)256 * 1024 * 1024)
+#define CACHE_STALE_TMP_SECONDS 3600
+
+#ifdef __APPLE__
+#define CACHE_MTIME_NSEC(st) ((long)(st).st_mtimespec.tv_nsec)
+#else
+#define CACHE_MTIME_NSEC(st) ((long)(st).st_mtim.tv_nsec)
+#endif
+
+struct apex_render_cache {
+    char *directory;
+    size_t max_bytes;
+    pthread_mutex_t lock;
+    apex_render_cache_stats stats;
+    unsigned long tmp_counter;
+};
+
+/* ------------------------------------------------------------------------- */
+/* Hashing                                                                   */
+/* ------------------------------------------------------------------------- */
+
+/* Two independent 64-bit lanes, finalized into a 128-bit hex digest */
+typedef struct {
+    uint64_t a;
+    uint64_t b;
+} cache_hash;
+
+static void cache_hash_init(cache_hash *h) {
+    h->a = 14695981039346656037ULL;
+    h->b = 0x9e3779b97f4a7c15ULL;
+}
+
+static void cache_hash_update(cache_hash *h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint64_t a = h->a;
+    uint64_t b = h->b;
+    for (size_t i = 0; i < len; i++) {
+        a = (a ^ p[i]) * 1099511628211ULL;
+        b = (b + p[i] + 1) * 0xff51afd7ed558ccdULL;
+        b ^= b >> 31;
+    }
+    h->a = a;
+    h->b = b;
+}
+
+static void cache_hash_u64(cache_hash *h, uint64_t value) {
+    unsigned char bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (unsigned char)(value >> (i * 8));
+    }
+    cache_hash_update(h, bytes, sizeof(bytes));
+}
+
+/* Length-prefixed so adjacent strings can't run together; NULL differs from "" */
+static void cache_hash_str(cache_hash *h, const char *s) {
+    if (!s) {
+        cache_hash_u64(h, UINT64_MAX);
+        return;
+    }
+    size_t len = strlen(s);
+    cache_hash_u64(h, len);
+    cache_hash_update(h, s, len);
+}
+
+static void cache_hash_strv(cache_hash *h, const char *const *strv, size_t count) {
+    if (!strv) {
+        cache_hash_u64(h, UINT64_MAX);
+        return;
+    }
+    cache_hash_u64(h, count);
+    for (size_t i = 0; i < count; i++) {
+        cache_hash_str(h, strv[i]);
+    }
+}
+
+static size_t cache_strv_count(const char *const *strv) {
+    size_t count = 0;
+    while (strv && strv[count]) count++;
+    return count;
+}
+
+static uint64_t cache_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static void cache_hash_hex(const cache_hash *h, char out[33]) {
+    snprintf(out, 33, "%016llx%016llx",
+             (unsigned long long)cache_mix(h->a),
+             (unsigned long long)cache_mix(h->b ^ h->a));
+}
+
+static bool cache_hash_file(const char *path, char out[33]) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    cache_hash h;
+    cache_hash_init(&h);
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            return false;
+        }
+        cache_hash_update(&h, buffer, (size_t)n);
+    }
+    close(fd);
+    cache_hash_hex(&h, out);
+    return true;
+}
+
+/**
+ * Hash every option that can change the output. Pointers are followed and
+ * hashed by content; fields are hashed in a fixed order, so the key does
+ * not depend on struct padding.
+ */
+static void cache_hash_options(cache_hash *h, const apex_options *o) {
+#define KEY(field) cache_hash_u64(h, (uint64_t)(int64_t)o->field)
+#define KEY_STR(field) cache_hash_str(h, o->field)
+    KEY(mode);
+    KEY(enable_tables);
+    KEY(enable_footnotes);
+    KEY(enable_definition_lists);
+    KEY(enable_smart_typography);
+    KEY(enable_math);
+    KEY(enable_critic_markup);
+    KEY(enable_wiki_links);
+    KEY(enable_task_lists);
+    KEY(enable_attributes);
+    KEY(enable_callouts);
+    KEY(enable_py_callouts);
+    KEY(enable_quarto_callouts);
+    KEY(enable_quarto_extensions);
+    KEY(enable_quarto_raw);
+    KEY(enable_quarto_example_lists);
+    KEY(enable_quarto_line_blocks);
+    KEY(enable_quarto_roman_lists);
+    KEY(enable_quarto_code_attrs);
+    KEY(enable_quarto_diagrams);
+    KEY(enable_quarto_shortcodes);
+    KEY(enable_quarto_strict_lists);
+    KEY(enable_quarto_xrefs);
+    KEY(enable_marked_extensions);
+    KEY(enable_divs);
+    KEY(enable_spans);
+    KEY(enable_grid_tables);
+    KEY(critic_mode);
+    KEY(strip_metadata);
+    KEY(enable_metadata_variables);
+    KEY(enable_metadata_transforms);
+    KEY(enable_file_includes);
+    KEY(max_include_depth);
+    KEY_STR(base_directory);
+    KEY(output_format);
+    KEY(unsafe);
+    KEY(validate_utf8);
+    KEY(github_pre_lang);
+    KEY(standalone);
+    KEY(pretty);
+    KEY(xhtml);
+    KEY(strict_xhtml);
+    cache_hash_strv(h, o->stylesheet_paths, o->stylesheet_paths ? o->stylesheet_count : 0);
+    KEY_STR(document_title);
+    KEY_STR(theme_name);
+    KEY(terminal_width);
+    KEY(paginate);
+    KEY(paginate_symbols);
+    KEY(terminal_inline_images);
+    KEY(terminal_image_width);
+    KEY(hardbreaks);
+    KEY(nobreaks);
+    KEY(generate_header_ids);
+    KEY(header_anchors);
+    KEY(id_format);
+    KEY(toc_min);
+    KEY(toc_max);
+    KEY(relaxed_tables);
+    KEY(caption_position);
+    KEY(per_cell_alignment);
+    KEY(allow_mixed_list_markers);
+    KEY(allow_alpha_lists);
+    KEY(enable_sup_sub);
+    KEY(enable_strikethrough);
+    KEY(enable_autolink);
+    KEY(obfuscate_emails);
+    KEY(embed_images);
+    KEY(enable_image_captions);
+    KEY(title_captions_only);
+    KEY(enable_citations);
+    cache_hash_strv(h, (const char *const *)o->bibliography_files,
+                    cache_strv_count((const char *const *)o->bibliography_files));
+    KEY_STR(csl_file);
+    KEY(suppress_bibliography);
+    KEY(link_citations);
+    KEY(show_tooltips);
+    KEY_STR(nocite);
+    KEY(enable_indices);
+    KEY(enable_mmark_index_syntax);
+    KEY(enable_textindex_syntax);
+    KEY(enable_leanpub_index_syntax);
+    KEY(suppress_index);
+    KEY(group_index_by_letter);
+    KEY(wikilink_space);
+    KEY_STR(wikilink_extension);
+    KEY(wikilink_sanitize);
+    cache_hash_strv(h, (const char *const *)o->script_tags,
+                    cache_strv_count((const char *const *)o->script_tags));
+    KEY(embed_stylesheet);
+    KEY(enable_aria);
+    KEY(enable_emoji_autocorrect);
+    KEY_STR(code_highlighter);
+    KEY(code_line_numbers);
+    KEY(highlight_language_only);
+    KEY_STR(code_highlight_theme);
+    KEY(enable_widont);
+    KEY(code_is_poetry);
+    KEY(enable_markdown_in_html);
+    KEY(random_footnote_ids);
+    KEY(enable_hashtags);
+    KEY(style_hashtags);
+    KEY(proofreader_mode);
+    KEY(hr_page_break);
+    KEY(title_from_h1);
+    KEY(page_break_before_footnotes);
+    KEY_STR(input_file_path);
+#undef KEY
+#undef KEY_STR
+}
+
+/* Conversions whose output depends on more than the input, options and noted files */
+static bool cache_options_cacheable(const apex_options *o) {
+    return !o->enable_plugins &&
+           !o->plugin_register &&
+           o->ast_filter_count == 0 &&
+           !o->cmark_init &&
+           !o->cmark_done &&
+           !o->toc_entries_out &&
+           !o->stats &&
+           o->output_format != APEX_OUTPUT_TERMINAL &&
+           o->output_format != APEX_OUTPUT_TERMINAL256;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Dependencies                                                              */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    char *path;          /* Absolute */
+    bool content;        /* Read ('c'), not only checked for existence ('e') */
+    bool exists;
+    unsigned long long size;
+    long long mtime_sec;
+    long mtime_nsec;
+    char hash[33];       /* Content hash, "-" when not read */
+} cache_dep;
+
+typedef struct {
+    cache_dep *items;
+    size_t count;
+    size_t capacity;
+    bool failed;         /* Out of memory: don't store the entry */
+} cache_dep_list;
+
+/* Dependency list of the conversion running on this thread, if any */
+static __thread cache_dep_list *tls_deps = NULL;
+
+static void cache_dep_list_free(cache_dep_list *deps) {
+    for (size_t i = 0; i < deps->count; i++) {
+        free(deps->items[i].path);
+    }
+    free(deps->items);
+    memset(deps, 0, sizeof(*deps));
+}
+
+static char *cache_absolute_path(const char *path) {
+    if (path[0] == '/') return strdup(path);
+    char cwd[4096];
+    if (!getcwd(cwd, sizeof(cwd))) return strdup(path);
+    size_t len = strlen(cwd) + 1 + strlen(path) + 1;
+    char *full = malloc(len);
+    if (full) snprintf(full, len, "%s/%s", cwd, path);
+    return full;
+}
+
+/* Fill in the current state of dep->path */
+static void cache_dep_stat(cache_dep *dep) {
+    struct stat st;
+    dep->exists = stat(dep->path, &st) == 0 && S_ISREG(st.st_mode);
+    dep->size = dep->exists ? (unsigned long long)st.st_size : 0;
+    dep->mtime_sec = dep->exists ? (long long)st.st_mtime : 0;
+    dep->mtime_nsec = dep->exists ? CACHE_MTIME_NSEC(st) : 0;
+    strcpy(dep->hash, "-");
+    if (dep->exists && dep->content && !cache_hash_file(dep->path, dep->hash)) {
+        /* Unreadable now but found by stat(): don't trust it */
+        dep->exists = false;
+    }
+}
+
+static void cache_note(const char *path, bool content) {
+    cache_dep_list *deps = tls_deps;
+    if (!deps || !path || !*path || deps->failed) return;
+
+    char *abs_path = cache_absolute_path(path);
+    if (!abs_path) {
+        deps->failed = true;
+        return;
+    }
+    for (size_t i = 0; i < deps->count; i++) {
+        if (strcmp(deps->items[i].path, abs_path) == 0) {
+            if (content && !deps->items[i].content) {
+                deps->items[i].content = true;
+                cache_dep_stat(&deps->items[i]);
+            }
+            free(abs_path);
+            return;
+        }
+    }
+
+    if (deps->count == deps->capacity) {
+        size_t capacity = deps->capacity ? deps->capacity * 2 : 16;
+        cache_dep *items = realloc(deps->items, capacity * sizeof(cache_dep));
+        if (!items) {
+            free(abs_path);
+            deps->failed = true;
+            return;
+        }
+        deps->items = items;
+        deps->capacity = capacity;
+    }
+    cache_dep *dep = &deps->items[deps->count++];
+    memset(dep, 0, sizeof(*dep));
+    dep->path = abs_path;
+    dep->content = content;
+    cache_dep_stat(dep);
+}
+
+void apex_render_cache_note_file(const char *path) {
+    cache_note(path, true);
+}
+
+void apex_render_cache_note_exists(const char *path) {
+    cache_note(path, false);
+}
+
+/* Is the recorded state of a dependency still true? */
+static bool cache_dep_current(const cache_dep *dep) {
+    struct stat st;
+    bool exists = stat(dep->path, &st) == 0 && S_ISREG(st.st_mode);
+    if (exists != dep->exists) return false;
+    if (!exists || !dep->content) return true;
+    if ((unsigned long long)st.st_size != dep->size) return false;
+    if ((long long)st.st_mtime == dep->mtime_sec && CACHE_MTIME_NSEC(st) == dep->mtime_nsec) {
+        return true;
+    }
+
+    /* Touched: compare contents */
+    char hash[33];
+    return cache_hash_file(dep->path, hash) && strcmp(hash, dep->hash) == 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Entries                                                                   */
+/* ------------------------------------------------------------------------- */
+
+static char *cache_entry_path(const apex_render_cache *cache, const char *key, bool dir_only) {
+    size_t len = strlen(cache->directory) + 1 + 2 + 1 + 30 + 1;
+    char *path = malloc(len);
+    if (!path) return NULL;
+    if (dir_only) {
+        snprintf(path, len, "%s/%.2s", cache->directory, key);
+    } else {
+        snprintf(path, len, "%s/%.2s/%s", cache->directory, key, key + 2);
+    }
+    return path;
+}
+
+static bool cache_read_all(int fd, char **out, size_t *out_len) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) return false;
+    size_t size = (size_t)st.st_size;
+    char *data = malloc(size + 1);
+    if (!data) return false;
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = read(fd, data + got, size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    if (got != size) {
+        free(data);
+        return false;
+    }
+    data[size] = '\0';
+    *out = data;
+    *out_len = size;
+    return true;
+}
+
+/* Read one line field; p advances past the newline */
+static const char *cache_line(const char **p, const char *end) {
+    const char *line = *p;
+    const char *nl = memchr(line, '\n', (size_t)(end - line));
+    if (!nl) return NULL;
+    *p = nl + 1;
+    return line;
+}
+
+/**
+ * Look up an entry; returns the output when the entry exists and all of
+ * its dependencies are unchanged
+ */
+static char *cache_lookup(const char *path, const char *key) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    char *data = NULL;
+    size_t size = 0;
+    if (!cache_read_all(fd, &data, &size)) {
+        close(fd);
+        return NULL;
+    }
+
+    const char *p = data;
+    const char *end = data + size;
+    const char *line;
+    char *output = NULL;
+    bool valid = false;
+
+    line = cache_line(&p, end);
+    if (!line || strncmp(line, CACHE_FORMAT "\n", sizeof(CACHE_FORMAT)) != 0) goto done;
+    line = cache_line(&p, end);
+    if (!line || strncmp(line, key, 32) != 0 || line[32] != '\n') goto done;
+    line = cache_line(&p, end);
+    if (!line) goto done;
+    unsigned long dep_count = strtoul(line, NULL, 10);
+
+    for (unsigned long i = 0; i < dep_count; i++) {
+        line = cache_line(&p, end);
+        if (!line) goto done;
+        cache_dep dep;
+        memset(&dep, 0, sizeof(dep));
+        char kind = 0;
+        int exists = 0;
+        unsigned long path_len = 0;
+        if (sscanf(line, "%c %d %llu %lld %ld %32s %lu", &kind, &exists, &dep.size,
+                   &dep.mtime_sec, &dep.mtime_nsec, dep.hash, &path_len) != 7) {
+            goto done;
+        }
+        if ((size_t)(end - p) < path_len + 1 || p[path_len] != '\n') goto done;
+        dep.content = kind == 'c';
+        dep.exists = exists != 0;
+        dep.path = strndup(p, path_len);
+        p += path_len + 1;
+        bool current = dep.path && cache_dep_current(&dep);
+        free(dep.path);
+        if (!current) goto done;
+    }
+
+    line = cache_line(&p, end);
+    if (!line) goto done;
+    unsigned long long output_len = strtoull(line, NULL, 10);
+    if ((unsigned long long)(end - p) != output_len) goto done;
+    valid = true;
+
+done:
+    if (valid) {
+        /* Move the output to the front of the buffer */
+        size_t offset = (size_t)(p - data);
+        memmove(data, p, size - offset);
+        data[size - offset] = '\0';
+        output = data;
+
+        /* Mark as recently used */
+        futimens(fd, NULL);
+    } else {
+        free(data);
+    }
+    close(fd);
+    return output;
+}
+
+static bool cache_write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool cache_write_entry(int fd, const char *key, const cache_dep_list *deps,
+                              const char *output, size_t output_len) {
+    char line[256];
+    int n = snprintf(line, sizeof(line), CACHE_FORMAT "\n%s\n%zu\n", key, deps->count);
+    if (!cache_write_all(fd, line, (size_t)n)) return false;
+
+    for (size_t i = 0; i < deps->count; i++) {
+        const cache_dep *dep = &deps->items[i];
+        size_t path_len = strlen(dep->path);
+        n = snprintf(line, sizeof(line), "%c %d %llu %lld %ld %s %zu\n",
+                     dep->content ? 'c' : 'e', dep->exists ? 1 : 0, dep->size,
+                     dep->mtime_sec, dep->mtime_nsec, dep->hash, path_len);
+        if (!cache_write_all(fd, line, (size_t)n) ||
+            !cache_write_all(fd, dep->path, path_len) ||
+            !cache_write_all(fd, "\n", 1)) {
+            return false;
+        }
+    }
+
+    n = snprintf(line, sizeof(line), "%zu\n", output_len);
+    return cache_write_all(fd, line, (size_t)n) && cache_write_all(fd, output, output_len);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Size accounting and eviction                                              */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    char *path;
+    size_t size;
+    time_t mtime;
+} cache_file;
+
+static int cache_file_cmp(const void *a, const void *b) {
+    const cache_file *fa = a;
+    const cache_file *fb = b;
+    if (fa->mtime != fb->mtime) return fa->mtime < fb->mtime ? -1 : 1;
+    return strcmp(fa->path, fb->path);
+}
+
+/**
+ * Scan the cache and remove least recently used entries until it is under
+ * 90% of the limit. Also removes temporary files left by crashed writers.
+ * Returns the size of the remaining entries.
+ */
+static size_t cache_evict(apex_render_cache *cache, size_t *evicted) {
+    cache_file *files = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    size_t total = 0;
+    time_t now = time(NULL);
+
+    DIR *top = opendir(cache->directory);
+    if (!top) return 0;
+    struct dirent *sub;
+    while ((sub = readdir(top)) != NULL) {
+        if (strlen(sub->d_name) != 2 || sub->d_name[0] == '.') continue;
+        size_t dir_len = strlen(cache->directory) + 4;
+        char *dir_path = malloc(dir_len);
+        if (!dir_path) continue;
+        snprintf(dir_path, dir_len, "%s/%s", cache->directory, sub->d_name);
+        DIR *dir = opendir(dir_path);
+        struct dirent *ent;
+        while (dir && (ent = readdir(dir)) != NULL) {
+            if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+            size_t path_len = dir_len + strlen(ent->d_name) + 1;
+            char *path = malloc(path_len);
+            if (!path) continue;
+            snprintf(path, path_len, "%s/%s", dir_path, ent->d_name);
+            struct stat st;
+            if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+                free(path);
+                continue;
+            }
+            if (ent->d_name[0] == '.') {
+                if (now - st.st_mtime > CACHE_STALE_TMP_SECONDS) unlink(path);
+                free(path);
+                continue;
+            }
+            if (count == capacity) {
+                size_t new_capacity = capacity ? capacity * 2 : 256;
+                cache_file *grown = realloc(files, new_capacity * sizeof(cache_file));
+                if (!grown) {
+                    free(path);
+                    continue;
+                }
+                files = grown;
+                capacity = new_capacity;
+            }
+            files[count].path = path;
+            files[count].size = (size_t)st.st_size;
+            files[count].mtime = st.st_mtime;
+            count++;
+            total += (size_t)st.st_size;
+        }
+        if (dir) closedir(dir);
+        free(dir_path);
+    }
+    closedir(top);
+
+    if (total > cache->max_bytes) {
+        size_t target = cache->max_bytes / 10 * 9;
+        qsort(files, count, sizeof(cache_file), cache_file_cmp);
+        for (size_t i = 0; i < count && total > target; i++) {
+            if (unlink(files[i].path) == 0 || errno == ENOENT) {
+                total -= files[i].size;
+                (*evicted)++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        free(files[i].path);
+    }
+    free(files);
+    return total;
+}
+
+/**
+ * Add an entry's size to the shared total in <dir>/.size and evict when
+ * it goes over the limit
+ */
+static void cache_account(apex_render_cache *cache, size_t added) {
+    size_t len = strlen(cache->directory) + 7;
+    char *path = malloc(len);
+    if (!path) return;
+    snprintf(path, len, "%s/.size", cache->directory);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    free(path);
+    if (fd < 0) return;
+
+    if (flock(fd, LOCK_EX) == 0) {
+        char buffer[32] = {0};
+        ssize_t n = pread(fd, buffer, sizeof(buffer) - 1, 0);
+        bool known = n > 0;
+        size_t total = known ? (size_t)strtoull(buffer, NULL, 10) : 0;
+        total += added;
+
+        size_t evicted = 0;
+        if (!known || total > cache->max_bytes) {
+            /* First use of the directory, or over the limit: count for real */
+            total = cache_evict(cache, &evicted);
+        }
+
+        n = snprintf(buffer, sizeof(buffer), "%zu\n", total);
+        if (ftruncate(fd, 0) == 0) {
+            ssize_t written = pwrite(fd, buffer, (size_t)n, 0);
+            (void)written;
+        }
+        flock(fd, LOCK_UN);
+
+        if (evicted) {
+            pthread_mutex_lock(&cache->lock);
+            cache->stats.evictions += evicted;
+            pthread_mutex_unlock(&cache->lock);
+        }
+    }
+    close(fd);
+}
+
+static void cache_store(apex_render_cache *cache, const char *key, const cache_dep_list *deps,
+                        const char *output, size_t output_len) {
+    char *dir = cache_entry_path(cache, key, true);
+    char *path = cache_entry_path(cache, key, false);
+    if (!dir || !path) {
+        free(dir);
+        free(path);
+        return;
+    }
+    mkdir(dir, 0755);
+
+    pthread_mutex_lock(&cache->lock);
+    unsigned long serial = cache->tmp_counter++;
+    pthread_mutex_unlock(&cache->lock);
+
+    size_t tmp_len = strlen(dir) + 64;
+    char *tmp = malloc(tmp_len);
+    if (tmp) {
+        snprintf(tmp, tmp_len, "%s/.tmp-%ld-%lu", dir, (long)getpid(), serial);
+        int fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0) {
+            bool ok = cache_write_entry(fd, key, deps, output, output_len);
+            struct stat st;
+            ok = close(fd) == 0 && ok && stat(tmp, &st) == 0;
+            if (ok && rename(tmp, path) == 0) {
+                pthread_mutex_lock(&cache->lock);
+                cache->stats.stores++;
+                pthread_mutex_unlock(&cache->lock);
+                cache_account(cache, (size_t)st.st_size);
+            } else {
+                unlink(tmp);
+            }
+        }
+        free(tmp);
+    }
+    free(dir);
+    free(path);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+static bool cache_mkdirs(const char *directory) {
+    char *path = strdup(directory);
+    if (!path) return false;
+    for (char *p = path + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            free(path);
+            return false;
+        }
+        *p = '/';
+    }
+    bool ok = mkdir(path, 0755) == 0 || errno == EEXIST;
+    free(path);
+
+    struct stat st;
+    return ok && stat(directory, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+apex_render_cache *apex_render_cache_open(const char *directory, size_t max_bytes) {
+    if (!directory || !*directory || !cache_mkdirs(directory)) return NULL;
+
+    apex_render_cache *cache = calloc(1, sizeof(apex_render_cache));
+    if (!cache) return NULL;
+    cache->directory = strdup(directory);
+    if (!cache->directory) {
+        free(cache);
+        return NULL;
+    }
+    /* Trailing slashes would end up doubled in entry paths */
+    size_t len = strlen(cache->directory);
+    while (len > 1 && cache->directory[len - 1] == '/') {
+        cache->directory[--len] = '\0';
+    }
+    cache->max_bytes = max_bytes ? max_bytes : CACHE_DEFAULT_MAX_BYTES;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+char *apex_render_cache_convert(apex_render_cache *cache, const apex_converter *converter,
+                                const char *markdown, size_t len, const apex_options *options) {
+    apex_options defaults;
+    if (!options) {
+        if (converter) {
+            options = apex_converter_options(converter);
+        } else {
+            defaults = apex_options_default();
+            options = &defaults;
+        }
+    }
+    if (!markdown) {
+        markdown = "";
+        len = 0;
+    }
+
+    if (!cache || !cache_options_cacheable(options)) {
+        if (cache) {
+            pthread_mutex_lock(&cache->lock);
+            cache->stats.bypassed++;
+            pthread_mutex_unlock(&cache->lock);
+        }
+        return converter ? apex_converter_convert_with_options(converter, markdown, len, options)
+                         : apex_markdown_to_html(markdown, len, options);
+    }
+
+    cache_hash h;
+    cache_hash_init(&h);
+    cache_hash_str(&h, CACHE_FORMAT);
+    cache_hash_str(&h, apex_version_string());
+    cache_hash_options(&h, options);
+    cache_hash_u64(&h, len);
+    cache_hash_update(&h, markdown, len);
+    char key[33];
+    cache_hash_hex(&h, key);
+
+    char *path = cache_entry_path(cache, key, false);
+    char *output = path ? cache_lookup(path, key) : NULL;
+    free(path);
+
+    pthread_mutex_lock(&cache->lock);
+    if (output) {
+        cache->stats.hits++;
+    } else {
+        cache->stats.misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    if (output) return output;
+
+    /* Record what the conversion reads on this thread */
+    cache_dep_list deps;
+    memset(&deps, 0, sizeof(deps));
+    cache_dep_list *saved = tls_deps;
+    tls_deps = &deps;
+
+    /* A converter loaded its bibliography up front, so note it here */
+    if (converter && options->bibliography_files) {
+        for (char **file = options->bibliography_files; *file; file++) {
+            char *resolved = apex_resolve_bibliography_path(*file, options->base_directory);
+            apex_render_cache_note_file(resolved);
+            free(resolved);
+        }
+    }
+
+    output = converter ? apex_converter_convert_with_options(converter, markdown, len, options)
+                       : apex_markdown_to_html(markdown, len, options);
+    tls_deps = saved;
+
+    if (output && !deps.failed) {
+        cache_store(cache, key, &deps, output, strlen(output));
+    }
+    cache_dep_list_free(&deps);
+    return output;
+}
+
+void apex_render_cache_get_stats(apex_render_cache *cache, apex_render_cache_stats *stats) {
+    if (!stats) return;
+    if (!cache) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void apex_render_cache_close(apex_render_cache *cache) {
+    if (!cache) return;
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->directory);
+    free(cache);
+}
@@ -0,0 +1,42 @@
+/**
+ * Render Cache Dependency Tracking
+ *
+ * Conversions read files besides their input: transcluded documents,
+ * embedded images and stylesheets, bibliographies. The code that reads
+ * them reports each path here so apex_render_cache_convert() can store it
+ * with the cached output and notice when the file changes.
+ *
+ * Reporting costs nothing unless the conversion runs inside
+ * apex_render_cache_convert() on the same thread.
+ */
+
+#ifndef APEX_RENDER_CACHE_H
+#define APEX_RENDER_CACHE_H
+
+#include "apex/apex.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The conversion read this file (or tried to: a missing file is recorded
+ * as missing)
+ */
+void apex_render_cache_note_file(const char *path);
+
+/**
+ * The conversion only checked whether this file exists
+ */
+void apex_render_cache_note_exists(const char *path);
+
+/**
+ * Options a converter was created with (defined in apex.c)
+ */
+const apex_options *apex_converter_options(const apex_converter *converter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APEX_RENDER_CACHE_H */
@@ -0,0 +1,75 @@
+/**
+ * Section Summaries
+ *
+ * Incremental sessions (session.c) convert a document one heading section
+ * at a time. Output that depends on the whole document - the table of
+ * contents, footnote numbers, the bibliography - is put back together from
+ * a summary of each section: the conversion reports what the section
+ * contributes, and the session feeds the rest of the document back in
+ * when it converts the section again.
+ */
+
+#ifndef APEX_SECTION_SUMMARY_H
+#define APEX_SECTION_SUMMARY_H
+
+#include "apex/apex.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* One citation, with what apex_render_citations() reads from it */
+typedef struct {
+    char *key;
+    bool author_in_text;      /* @key */
+    bool author_suppressed;   /* [-@key] */
+} apex_section_citation;
+
+/* Where apex_insert_bibliography() would put the bibliography, best first */
+typedef enum {
+    APEX_SECTION_BIB_NONE = 0,
+    APEX_SECTION_BIB_REFS_DIV,        /* <div id="refs"> ... </div> */
+    APEX_SECTION_BIB_REFS_DIV_OPEN,   /* <div id="refs"> without its </div> */
+    APEX_SECTION_BIB_BACKMATTER,      /* {backmatter} */
+    APEX_SECTION_BIB_REFERENCES       /* <!-- REFERENCES --> */
+} apex_section_bib_marker;
+
+typedef struct {
+    /* Set by the caller */
+    bool expand_toc;                  /* Expand the first TOC marker with toc_entries */
+    const apex_toc_entry *toc_entries;
+    size_t toc_entry_count;
+
+    /* Filled in by the conversion */
+    apex_toc_entry *headings;         /* Headings (levels 1-6) a TOC would list */
+    size_t heading_count;
+    bool has_toc_marker;              /* A marker the TOC stage would replace */
+    apex_section_citation *citations; /* In source order */
+    size_t citation_count;
+    apex_section_bib_marker bib_marker;
+    char **footnote_refs;             /* Labels of numbered footnote references, in order */
+    size_t footnote_ref_count;
+    bool failed;                      /* Out of memory while recording; the summary is incomplete */
+} apex_section_summary;
+
+/**
+ * Convert one section with converter and options, filling in summary.
+ * TOC markers are only expanded when summary->expand_toc is set.
+ */
+char *apex_converter_convert_section(const apex_converter *converter,
+                                     const char *markdown, size_t len,
+                                     const apex_options *options,
+                                     apex_section_summary *summary);
+
+/**
+ * Free what a conversion filled in (the struct itself is not freed)
+ */
+void apex_section_summary_clear(apex_section_summary *summary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APEX_SECTION_SUMMARY_H */
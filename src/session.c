@@ -0,0 +1,1039 @@
+/**
+ * Incremental Rendering Sessions
+ *
+ * A session remembers the previous document split into heading sections
+ * (see apex_plan_sections) together with each section's HTML. On the next
+ * render, sections at the start and end that are unchanged keep their
+ * cached HTML and only the edited region in between is converted again.
+ *
+ * Sections are converted on their own, with the document's reference
+ * definitions and abbreviation definitions prepended (an edit that changes
+ * either re-renders every section). Output that depends on the rest of the
+ * document is rebuilt from a summary of each section (section_summary.h):
+ *
+ * - Table of contents: each section reports its headings, and the section
+ *   with the document's first TOC marker is converted with the headings
+ *   of every section.
+ * - Footnotes: each section's definitions are prepended to every other
+ *   section, and a section that references notes is converted after a
+ *   hidden paragraph repeating the references before it, so cmark numbers
+ *   them as in the whole document. Only the last section keeps its list
+ *   of notes, which then holds every note.
+ * - Citations: a key is formatted from its last citation in the document
+ *   and the bibliography lists the cited keys in order, so a section is
+ *   converted with hidden paragraphs repeating the citations it depends
+ *   on. Only the section with the bibliography marker (or the last one)
+ *   gets the bibliography.
+ * - Header ids: Apex does not number repeated ids, so a section converted
+ *   alone produces the ids it has in the whole document.
+ *
+ * The hidden paragraphs are cut from the HTML again, and a section is
+ * converted again when what it was given from the rest changes. Index
+ * entries, critic markup, attribute list definitions, metadata variables,
+ * Liquid tags, MMD citations and inline abbreviations or footnotes have no
+ * summary, so documents that use them (or open with metadata) and options
+ * that post-process the whole output (standalone, pretty, non-HTML
+ * formats, plugins, AST filters) are converted in full on every render.
+ *
+ * Only the section split, the definition scans and a hash per section cost
+ * time proportional to the document; conversion cost follows the size of
+ * the edited region.
+ */
+
+#include "apex/apex.h"
+#include "chunk_split.h"
+#include "feature_scan.h"
+#include "section_summary.h"
+#include "extensions/metadata.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+/* Words that open and close the hidden paragraphs; the paragraphs are cut
+ * from the section's HTML by them */
+#define SESSION_NOTES_MARK "ApexSessionNotes"
+#define SESSION_CITES_BEFORE_MARK "ApexSessionCitesBefore"
+#define SESSION_CITES_AFTER_MARK "ApexSessionCitesAfter"
+
+typedef struct {
+    uint64_t hash;
+    char *source;        /* Section text, without the prepended definitions */
+    size_t source_len;
+    char *html;
+    size_t html_len;
+    uint64_t context;             /* Hash of what the section was given from the rest */
+    apex_section_summary summary; /* The section's own headings, citations and footnote references */
+} apex_session_block;
+
+struct apex_session {
+    apex_converter *converter;
+    apex_options options;
+    apex_session_block *blocks;
+    size_t block_count;
+    char *refdefs;       /* Definitions the cached blocks were converted with */
+    size_t refdefs_len;
+    size_t last_rendered;
+};
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} session_buf;
+
+/* What one render knows about the document as a whole */
+typedef struct {
+    session_buf notes;          /* Footnote definitions of every section, in order */
+    size_t *note_bounds;        /* Section i's definitions are notes[note_bounds[i] .. note_bounds[i + 1]] */
+    bool cites;                 /* Citations are processed */
+    size_t toc_block;           /* Section that expands the TOC, or the section count */
+    apex_toc_entry *toc;        /* Headings of every section */
+    size_t toc_count;
+    uint64_t toc_hash;
+    size_t bib_block;           /* Section that gets the bibliography, or the section count */
+} session_doc;
+
+/* What a section is converted with from the rest of the document */
+typedef struct {
+    session_buf lead;           /* Hidden paragraphs before the section */
+    session_buf trail;          /* Hidden paragraph after it */
+    const char **refs;          /* Footnote references in the lead */
+    size_t ref_count;
+    const apex_section_citation **before;
+    size_t before_count;
+    const apex_section_citation **after;
+    size_t after_count;
+    bool keep_notes;            /* Keep the list of notes (the last section) */
+    bool bibliography;
+    bool expand_toc;
+    uint64_t hash;
+} session_context;
+
+static bool session_buf_append(session_buf *buf, const char *s, size_t len) {
+    if (buf->len + len + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 256;
+        while (cap < buf->len + len + 1) cap *= 2;
+        char *data = realloc(buf->data, cap);
+        if (!data) return false;
+        buf->data = data;
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, s, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+    return true;
+}
+
+static bool session_buf_puts(session_buf *buf, const char *s) {
+    return session_buf_append(buf, s, strlen(s));
+}
+
+/* End buf with a blank line, unless it is empty */
+static bool session_buf_blank_line(session_buf *buf) {
+    if (buf->len == 0 || (buf->len >= 2 && memcmp(buf->data + buf->len - 2, "\n\n", 2) == 0)) return true;
+    return session_buf_puts(buf, buf->data[buf->len - 1] == '\n' ? "\n" : "\n\n");
+}
+
+static uint64_t session_hash_more(uint64_t h, const char *s, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint64_t session_hash(const char *s, size_t len) {
+    return session_hash_more(14695981039346656037ULL, s, len);
+}
+
+static void session_block_clear(apex_session_block *block) {
+    free(block->source);
+    apex_free_string(block->html);
+    apex_section_summary_clear(&block->summary);
+    memset(block, 0, sizeof(*block));
+}
+
+static void session_clear(apex_session *session) {
+    for (size_t i = 0; i < session->block_count; i++) {
+        session_block_clear(&session->blocks[i]);
+    }
+    free(session->blocks);
+    session->blocks = NULL;
+    session->block_count = 0;
+    free(session->refdefs);
+    session->refdefs = NULL;
+    session->refdefs_len = 0;
+}
+
+/* Options whose output is more than the concatenation of the sections */
+static bool session_options_cacheable(const apex_options *options) {
+    return options->output_format == APEX_OUTPUT_HTML &&
+           !options->standalone &&
+           !options->pretty &&
+           !options->enable_plugins &&
+           options->ast_filter_count == 0 &&
+           !options->nocite &&
+           !options->script_tags &&
+           options->mode != APEX_MODE_QUARTO &&
+           !options->enable_quarto_xrefs;
+}
+
+/* Modes in which apex_extract_metadata_for_mode() runs */
+static bool session_mode_has_metadata(apex_mode_t mode) {
+    return mode == APEX_MODE_MULTIMARKDOWN || mode == APEX_MODE_KRAMDOWN ||
+           apex_mode_is_unified_family(mode);
+}
+
+/* Does the document open with metadata the conversion would take: YAML
+ * front matter, an MMD block or a Pandoc title block? The same parser
+ * decides, so a first line like "Note:" with nothing after it is text. */
+static bool session_has_metadata(const char *text, size_t len, apex_mode_t mode) {
+    if (len == 0 || !session_mode_has_metadata(mode)) return false;
+
+    /* Every format needs "-" or "%" first, or a colon on the first line */
+    const char *nl = memchr(text, '\n', len);
+    size_t first = nl ? (size_t)(nl - text) : len;
+    if (text[0] != '-' && text[0] != '%' && !memchr(text, ':', first)) return false;
+
+    char *copy = malloc(len + 1);
+    if (!copy) return true;
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    char *text_ptr = copy;
+    apex_metadata_item *metadata = apex_extract_metadata_for_mode(&text_ptr, mode);
+    bool found = metadata != NULL;
+    apex_free_metadata(metadata);
+    free(copy);
+    return found;
+}
+
+/* Modes in which apex_extract_abbreviations() runs */
+static bool session_mode_has_abbreviations(apex_mode_t mode) {
+    return mode == APEX_MODE_MULTIMARKDOWN || mode == APEX_MODE_KRAMDOWN ||
+           apex_mode_is_unified_family(mode);
+}
+
+/* A line apex_extract_abbreviations() removes as a definition:
+ * "*[abbr]: expansion" or "[>abbr]: expansion" */
+static bool session_is_abbr_def(const char *p, const char *end) {
+    if (end - p < 3 || !((p[0] == '*' && p[1] == '[') || (p[0] == '[' && p[1] == '>'))) return false;
+    const char *close = memchr(p + 2, ']', (size_t)(end - p - 2));
+    return close && close + 1 < end && close[1] == ':';
+}
+
+/**
+ * Split text line by line into abbreviation definitions (appended to defs,
+ * each ending in a newline) and everything else (appended to rest, if not
+ * NULL). Returns false on allocation failure.
+ */
+static bool session_split_abbr_defs(const char *text, size_t len, session_buf *defs, session_buf *rest) {
+    const char *end = text + len;
+    const char *line = text;
+    while (line < end) {
+        const char *nl = memchr(line, '\n', (size_t)(end - line));
+        const char *next = nl ? nl + 1 : end;
+        bool ok;
+        if (session_is_abbr_def(line, nl ? nl : end)) {
+            ok = session_buf_append(defs, line, (size_t)(next - line)) &&
+                 (nl || session_buf_append(defs, "\n", 1));
+        } else {
+            ok = !rest || session_buf_append(rest, line, (size_t)(next - line));
+        }
+        if (!ok) return false;
+        line = next;
+    }
+    return true;
+}
+
+/* Syntax whose rendering depends on the rest of the document and that has
+ * no section summary */
+static bool session_has_global_syntax(const char *text, size_t len, bool abbreviations, bool footnotes) {
+    static const char *markers[] = {
+        "[#",                    /* MMD citations */
+        "[%",                    /* metadata variables */
+        "{:",                    /* attribute list definitions */
+        "{%",                    /* Liquid tags */
+        "{^",                    /* index entries */
+    };
+
+    apex_feature_bits features = apex_scan_features(text, len);
+    if (features & (APEX_FEATURE_CRITIC | APEX_FEATURE_INDEX)) return true;
+    /* Without footnotes, "[^label]: ..." is a link reference definition
+     * the planner does not collect */
+    if (!footnotes && (features & APEX_FEATURE_FOOTNOTE)) return true;
+    /* Inline definitions, [>(abbr) expansion], have no summary */
+    if (abbreviations) {
+        for (const char *p = memchr(text, '[', len); p;
+             p = memchr(p + 1, '[', (size_t)(text + len - p - 1))) {
+            if ((size_t)(text + len - p) >= 3 && p[1] == '>' && p[2] == '(') return true;
+        }
+    }
+    for (size_t i = 0; i < sizeof(markers) / sizeof(markers[0]); i++) {
+        size_t n = strlen(markers[i]);
+        for (const char *p = memchr(text, markers[i][0], len); p;
+             p = memchr(p + 1, markers[i][0], (size_t)(text + len - p - 1))) {
+            if ((size_t)(text + len - p) >= n && memcmp(p, markers[i], n) == 0) return true;
+        }
+    }
+    return false;
+}
+
+/* Characters of a footnote label the session moves between sections */
+static bool session_is_label_char(char c) {
+    return isalnum((unsigned char)c) || c == '-' || c == '_';
+}
+
+/* Length of the label of "[^label]" at p, or 0 if it isn't a plain label */
+static size_t session_note_label(const char *p, const char *end) {
+    if (end - p < 4 || p[0] != '[' || p[1] != '^') return 0;
+    const char *q = p + 2;
+    while (q < end && session_is_label_char(*q)) q++;
+    return (q > p + 2 && q < end && *q == ']') ? (size_t)(q - p - 2) : 0;
+}
+
+/* Skip up to three spaces of indentation; NULL for a deeper indent */
+static const char *session_skip_indent(const char *p, const char *end) {
+    int n = 0;
+    while (p < end && *p == ' ' && n < 4) {
+        p++;
+        n++;
+    }
+    return (n == 4 || (p < end && *p == '\t')) ? NULL : p;
+}
+
+static bool session_is_blank(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p == end;
+}
+
+/* "[^label]:" opening a footnote definition; sets *label_len */
+static bool session_is_note_def(const char *line, const char *end, size_t *label_len) {
+    const char *p = session_skip_indent(line, end);
+    if (!p) return false;
+    size_t n = session_note_label(p, end);
+    if (n == 0 || p + n + 3 >= end || p[n + 3] != ':') return false;
+    *label_len = n;
+    return true;
+}
+
+/* A line that could start a block instead of continuing a paragraph */
+static bool session_may_start_block(const char *line, const char *end) {
+    const char *p = session_skip_indent(line, end);
+    if (!p || p == end) return false;
+    if (strchr("#>-+*=|<`~[:{", *p)) return true;
+    const char *digits = p;
+    while (p < end && isdigit((unsigned char)*p)) p++;
+    return p > digits && p < end && (*p == '.' || *p == ')');
+}
+
+/* Footnote definition text the session can't move: nested references,
+ * headings or TOC markers (collected from inside the notes), fences,
+ * and citations when they are processed */
+static bool session_note_is_movable(const char *def, size_t len, bool cites) {
+    const char *end = def + len;
+    const char *label_end = memchr(def, ']', len);
+    for (const char *p = label_end; p && p + 1 < end; p++) {
+        if ((p[0] == '[' && p[1] == '^') || (p[0] == '^' && p[1] == '[')) return false;
+        if (cites && *p == '@') return false;
+    }
+    for (const char *line = def; line < end;) {
+        const char *nl = memchr(line, '\n', (size_t)(end - line));
+        const char *line_end = nl ? nl : end;
+        const char *p = line;
+        while (p < line_end && (*p == ' ' || *p == '\t')) p++;
+        if (p < line_end && (*p == '#' || *p == '=' || *p == '-' ||
+                             (line_end - p >= 3 && (memcmp(p, "```", 3) == 0 || memcmp(p, "~~~", 3) == 0)))) {
+            return false;
+        }
+        line = nl ? nl + 1 : end;
+    }
+    for (const char *p = def; p + 3 <= end; p++) {
+        if (memcmp(p, "TOC", 3) == 0) return false;
+    }
+    return true;
+}
+
+/* End of the footnote definition whose first line ends at from */
+static const char *session_note_def_end(const char *from, const char *end) {
+    const char *def_end = from;
+    bool after_blank = false;
+    for (const char *line = from; line < end;) {
+        const char *nl = memchr(line, '\n', (size_t)(end - line));
+        const char *line_end = nl ? nl : end;
+        const char *next = nl ? nl + 1 : end;
+        size_t label_len;
+        if (session_is_blank(line, line_end)) {
+            after_blank = true;
+        } else if (!session_skip_indent(line, line_end)) {
+            def_end = next;         /* Indented continuation */
+            after_blank = false;
+        } else if (after_blank || session_is_note_def(line, line_end, &label_len)) {
+            break;
+        } else if (session_may_start_block(line, line_end)) {
+            return NULL;            /* Would need a real block parser to tell */
+        } else {
+            def_end = next;         /* Lazy continuation */
+        }
+        line = next;
+    }
+    return def_end;
+}
+
+/**
+ * Collect the footnote definitions of every section into doc->notes, with
+ * section i's at doc->note_bounds[i]. Returns false when the document has
+ * footnote syntax the session can't split: inline footnotes, labels other
+ * than letters, digits, "-" and "_", a label defined twice, or a
+ * definition that isn't on its own after a blank line.
+ */
+static bool session_scan_notes(const char *text, size_t len, const apex_chunk_plan *plan,
+                               session_doc *doc, bool cites) {
+    const char *end = text + len;
+    for (const char *p = memchr(text, '^', len); p; p = memchr(p + 1, '^', (size_t)(end - p - 1))) {
+        if (p + 1 < end && p[1] == '[') return false;
+        if (p > text && p[-1] == '[' && session_note_label(p - 1, end) == 0) return false;
+    }
+
+    doc->note_bounds = calloc(plan->count + 1, sizeof(size_t));
+    if (!doc->note_bounds) return false;
+
+    const char **labels = NULL;
+    size_t *label_lens = NULL;
+    size_t label_count = 0;
+    bool ok = true;
+
+    for (size_t i = 0; ok && i < plan->count; i++) {
+        doc->note_bounds[i] = doc->notes.len;
+        const char *line = text + plan->offsets[i];
+        const char *section_end = (i + 1 < plan->count) ? text + plan->offsets[i + 1] : end;
+        bool may_define = true;     /* After a blank line or a definition */
+        char fence = 0;
+        size_t fence_len = 0;
+
+        while (ok && line < section_end) {
+            const char *nl = memchr(line, '\n', (size_t)(section_end - line));
+            const char *line_end = nl ? nl : section_end;
+            const char *next = nl ? nl + 1 : section_end;
+
+            /* Definitions are never inside a fenced code block */
+            const char *p = session_skip_indent(line, line_end);
+            if (p && p < line_end && (*p == '`' || *p == '~')) {
+                size_t run = 0;
+                while (p + run < line_end && p[run] == *p) run++;
+                if (run >= 3 && !fence) {
+                    fence = *p;
+                    fence_len = run;
+                } else if (run >= fence_len && fence == *p && session_is_blank(p + run, line_end)) {
+                    fence = 0;
+                }
+            }
+
+            size_t label_len;
+            if (!fence && session_is_note_def(line, line_end, &label_len)) {
+                const char *def_end = may_define ? session_note_def_end(next, section_end) : NULL;
+                const char *label = session_skip_indent(line, line_end) + 2;
+                if (!def_end || !session_note_is_movable(line, (size_t)(def_end - line), cites)) {
+                    ok = false;
+                    break;
+                }
+                for (size_t k = 0; k < label_count; k++) {
+                    if (label_lens[k] == label_len && strncasecmp(labels[k], label, label_len) == 0) ok = false;
+                }
+                const char **grown = ok ? realloc(labels, (label_count + 1) * sizeof(char *)) : NULL;
+                if (grown) labels = grown;
+                size_t *grown_lens = grown ? realloc(label_lens, (label_count + 1) * sizeof(size_t)) : NULL;
+                if (grown_lens) label_lens = grown_lens;
+                if (!grown || !grown_lens) {
+                    ok = false;
+                    break;
+                }
+                labels[label_count] = label;
+                label_lens[label_count++] = label_len;
+
+                ok = session_buf_append(&doc->notes, line, (size_t)(def_end - line)) &&
+                     session_buf_blank_line(&doc->notes);
+                line = def_end;
+                may_define = true;
+                continue;
+            }
+            /* A definition can follow a blank line or an ATX heading */
+            const char *first = session_skip_indent(line, line_end);
+            may_define = !fence && (session_is_blank(line, line_end) || (first && first < line_end && *first == '#'));
+            line = next;
+        }
+    }
+    doc->note_bounds[plan->count] = doc->notes.len;
+
+    free(labels);
+    free(label_lens);
+    return ok;
+}
+
+/* apex_process_citations() skips what it takes for code by flipping a flag
+ * on every backtick of the whole text; text that leaves the flag set would
+ * change what the next section cites */
+static bool session_code_state_closed(const char *text, size_t len) {
+    bool in_block = false;
+    bool in_inline = false;
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] != '`') continue;
+        if (i + 2 < len && text[i + 1] == '`' && text[i + 2] == '`') {
+            in_block = !in_block;
+        } else if (!in_block) {
+            in_inline = !in_inline;
+        }
+    }
+    return !in_block && !in_inline;
+}
+
+/**
+ * Work out the TOC section, its headings and the bibliography section
+ * from the blocks' summaries. Returns false when the bibliography would
+ * land in a way the session can't place (a <div id="refs"> whose closing
+ * tag is in another section).
+ */
+static bool session_doc_update(session_doc *doc, const apex_session_block *blocks, size_t count,
+                               const apex_options *options) {
+    apex_toc_entries_free(doc->toc, doc->toc_count);
+    doc->toc = NULL;
+    doc->toc_count = 0;
+    doc->toc_hash = 0;
+    doc->toc_block = count;
+    doc->bib_block = count;
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (doc->toc_block == count && blocks[i].summary.has_toc_marker) doc->toc_block = i;
+        total += blocks[i].summary.heading_count;
+    }
+    if (doc->toc_block < count && total > 0) {
+        doc->toc = calloc(total, sizeof(apex_toc_entry));
+        if (!doc->toc) return false;
+        uint64_t h = session_hash("", 0);
+        for (size_t i = 0; i < count; i++) {
+            const apex_section_summary *summary = &blocks[i].summary;
+            for (size_t k = 0; k < summary->heading_count; k++) {
+                const apex_toc_entry *entry = &summary->headings[k];
+                apex_toc_entry *copy = &doc->toc[doc->toc_count];
+                copy->level = entry->level;
+                copy->text = strdup(entry->text ? entry->text : "");
+                copy->id = strdup(entry->id ? entry->id : "");
+                doc->toc_count++;
+                if (!copy->text || !copy->id) return false;
+                char level = (char)('0' + copy->level);
+                h = session_hash_more(h, &level, 1);
+                h = session_hash_more(h, copy->text, strlen(copy->text) + 1);
+                h = session_hash_more(h, copy->id, strlen(copy->id) + 1);
+            }
+        }
+        doc->toc_hash = h;
+    }
+
+    if (!doc->cites || options->suppress_bibliography || count == 0) return true;
+
+    /* <!-- REFERENCES --> anywhere wins over {backmatter}, then <div id="refs"> */
+    static const apex_section_bib_marker ranks[] = {
+        APEX_SECTION_BIB_REFERENCES, APEX_SECTION_BIB_BACKMATTER, APEX_SECTION_BIB_REFS_DIV
+    };
+    for (size_t r = 0; r < sizeof(ranks) / sizeof(ranks[0]) && doc->bib_block == count; r++) {
+        for (size_t i = 0; i < count; i++) {
+            apex_section_bib_marker marker = blocks[i].summary.bib_marker;
+            if (marker == APEX_SECTION_BIB_REFS_DIV_OPEN && ranks[r] == APEX_SECTION_BIB_REFS_DIV) {
+                return false;
+            }
+            if (marker == ranks[r]) {
+                doc->bib_block = i;
+                break;
+            }
+        }
+    }
+    if (doc->bib_block == count) doc->bib_block = count - 1;
+    return true;
+}
+
+static void session_doc_free(session_doc *doc) {
+    free(doc->notes.data);
+    free(doc->note_bounds);
+    apex_toc_entries_free(doc->toc, doc->toc_count);
+    memset(doc, 0, sizeof(*doc));
+}
+
+static void session_context_free(session_context *ctx) {
+    free(ctx->lead.data);
+    free(ctx->trail.data);
+    free(ctx->refs);
+    free(ctx->before);
+    free(ctx->after);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+/* Append a citation that parses back to the same key and form */
+static bool session_cite_append(session_buf *buf, const apex_section_citation *cite) {
+    const char *key = cite->key;
+    bool braces = !(isalnum((unsigned char)key[0]) || key[0] == '_');
+    return session_buf_puts(buf, cite->author_in_text ? "@" : cite->author_suppressed ? "[-@" : "[@") &&
+           (!braces || session_buf_puts(buf, "{")) &&
+           session_buf_puts(buf, key) &&
+           (!braces || session_buf_puts(buf, "}")) &&
+           (cite->author_in_text || session_buf_puts(buf, "]"));
+}
+
+/* Write a hidden paragraph of citations */
+static bool session_cites_para(session_buf *buf, const char *mark,
+                               const apex_section_citation **cites, size_t count) {
+    if (count == 0) return true;
+    bool ok = session_buf_puts(buf, mark) && session_buf_puts(buf, " ");
+    for (size_t i = 0; ok && i < count; i++) {
+        ok = (i == 0 || session_buf_puts(buf, ", ")) && session_cite_append(buf, cites[i]);
+    }
+    return ok && session_buf_puts(buf, " ") && session_buf_puts(buf, mark) && session_buf_puts(buf, "\n\n");
+}
+
+static bool session_cites_push(const apex_section_citation ***list, size_t *count,
+                               const apex_section_citation *cite) {
+    const apex_section_citation **grown = realloc(*list, (*count + 1) * sizeof(**list));
+    if (!grown) return false;
+    grown[(*count)++] = cite;
+    *list = grown;
+    return true;
+}
+
+/**
+ * Work out what block i is converted with from the other sections. With
+ * known false the block's own summary isn't known yet, and it is given
+ * everything it might depend on.
+ */
+static bool session_context_build(const session_doc *doc, const apex_session_block *blocks, size_t count,
+                                  size_t i, bool known, session_context *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+    const apex_section_summary *own = &blocks[i].summary;
+    bool notes = doc->notes.len > 0;
+    bool ok = true;
+
+    /* Footnote references before this section, when it has its own or
+     * keeps the list of notes */
+    if (notes) {
+        ctx->keep_notes = i + 1 == count;
+        size_t total = 0;
+        for (size_t b = 0; b < i; b++) total += blocks[b].summary.footnote_ref_count;
+        if (total > 0 && (!known || own->footnote_ref_count > 0 || ctx->keep_notes)) {
+            ctx->refs = malloc(total * sizeof(char *));
+            ok = ctx->refs && session_buf_puts(&ctx->lead, SESSION_NOTES_MARK);
+            for (size_t b = 0; ok && b < i; b++) {
+                const apex_section_summary *summary = &blocks[b].summary;
+                for (size_t k = 0; ok && k < summary->footnote_ref_count; k++) {
+                    ctx->refs[ctx->ref_count++] = summary->footnote_refs[k];
+                    ok = session_buf_puts(&ctx->lead, " [^") &&
+                         session_buf_puts(&ctx->lead, summary->footnote_refs[k]) &&
+                         session_buf_puts(&ctx->lead, "]");
+                }
+            }
+            ok = ok && session_buf_puts(&ctx->lead, " " SESSION_NOTES_MARK "\n\n");
+        }
+    }
+
+    /* The bibliography section repeats every other citation; any other
+     * section repeats the last later citation of each key it cites */
+    if (ok && doc->cites) {
+        ctx->bibliography = i == doc->bib_block;
+        for (size_t b = 0; ok && ctx->bibliography && b < i; b++) {
+            for (size_t k = 0; ok && k < blocks[b].summary.citation_count; k++) {
+                ok = session_cites_push(&ctx->before, &ctx->before_count, &blocks[b].summary.citations[k]);
+            }
+        }
+        if (ctx->bibliography || !known) {
+            for (size_t b = i + 1; ok && b < count; b++) {
+                for (size_t k = 0; ok && k < blocks[b].summary.citation_count; k++) {
+                    ok = session_cites_push(&ctx->after, &ctx->after_count, &blocks[b].summary.citations[k]);
+                }
+            }
+        } else {
+            for (size_t c = 0; ok && c < own->citation_count; c++) {
+                const char *key = own->citations[c].key;
+                bool seen = false;
+                for (size_t d = 0; d < c && !seen; d++) seen = strcmp(own->citations[d].key, key) == 0;
+                const apex_section_citation *last = NULL;
+                for (size_t b = i + 1; !seen && b < count; b++) {
+                    const apex_section_summary *summary = &blocks[b].summary;
+                    for (size_t k = 0; k < summary->citation_count; k++) {
+                        if (strcmp(summary->citations[k].key, key) == 0) last = &summary->citations[k];
+                    }
+                }
+                if (last) ok = session_cites_push(&ctx->after, &ctx->after_count, last);
+            }
+        }
+        ok = ok && session_cites_para(&ctx->lead, SESSION_CITES_BEFORE_MARK, ctx->before, ctx->before_count) &&
+             session_cites_para(&ctx->trail, SESSION_CITES_AFTER_MARK, ctx->after, ctx->after_count);
+    }
+
+    ctx->expand_toc = i == doc->toc_block;
+
+    uint64_t h = session_hash("", 0);
+    if (notes) {
+        h = session_hash_more(h, doc->notes.data, doc->note_bounds[i]);
+        h = session_hash_more(h, doc->notes.data + doc->note_bounds[i + 1],
+                              doc->notes.len - doc->note_bounds[i + 1]);
+    }
+    h = session_hash_more(h, ctx->lead.data ? ctx->lead.data : "", ctx->lead.len);
+    h = session_hash_more(h, ctx->trail.data ? ctx->trail.data : "", ctx->trail.len);
+    char flags = (char)((ctx->keep_notes ? 1 : 0) | (ctx->bibliography ? 2 : 0) | (ctx->expand_toc ? 4 : 0));
+    h = session_hash_more(h, &flags, 1);
+    if (ctx->expand_toc) h ^= doc->toc_hash;
+    ctx->hash = h;
+
+    if (!ok) session_context_free(ctx);
+    return ok;
+}
+
+/* Cut the hidden paragraph opened and closed by mark out of html */
+static bool session_cut_para(char *html, size_t *len, const char *mark) {
+    char open[64];
+    char close[64];
+    snprintf(open, sizeof(open), "<p>%s ", mark);
+    snprintf(close, sizeof(close), " %s</p>\n", mark);
+    char *start = strstr(html, open);
+    char *stop = start ? strstr(start, close) : NULL;
+    if (!stop) return false;
+    stop += strlen(close);
+    memmove(start, stop, (size_t)(html + *len - stop) + 1);
+    *len -= (size_t)(stop - start);
+    return true;
+}
+
+/* Drop the first n items of a summary list, freeing them */
+static void session_drop_refs(apex_section_summary *summary, size_t n) {
+    for (size_t k = 0; k < n; k++) free(summary->footnote_refs[k]);
+    memmove(summary->footnote_refs, summary->footnote_refs + n,
+            (summary->footnote_ref_count - n) * sizeof(char *));
+    summary->footnote_ref_count -= n;
+}
+
+static bool session_same_cite(const apex_section_citation *a, const apex_section_citation *b) {
+    return strcmp(a->key, b->key) == 0 && a->author_in_text == b->author_in_text &&
+           a->author_suppressed == b->author_suppressed;
+}
+
+/**
+ * Remove what the context added from a section's HTML and summary: the
+ * hidden paragraphs, the list of notes outside the last section, and the
+ * references and citations of the hidden paragraphs. Returns false if the
+ * conversion didn't come out as expected.
+ */
+static bool session_finish_block(char *html, size_t *len, const session_context *ctx,
+                                 apex_section_summary *summary) {
+    if (ctx->ref_count && !session_cut_para(html, len, SESSION_NOTES_MARK)) return false;
+    if (ctx->before_count && !session_cut_para(html, len, SESSION_CITES_BEFORE_MARK)) return false;
+    if (ctx->after_count && !session_cut_para(html, len, SESSION_CITES_AFTER_MARK)) return false;
+
+    if (!ctx->keep_notes) {
+        char *list = strstr(html, "<section class=\"footnotes\"");
+        if (list) {
+            const char *close = strstr(list, "</section>");
+            if (!close || !session_is_blank(close + 10, html + *len)) return false;
+            *list = '\0';
+            *len = (size_t)(list - html);
+        }
+    }
+
+    if (summary->footnote_ref_count < ctx->ref_count) return false;
+    for (size_t k = 0; k < ctx->ref_count; k++) {
+        if (strcmp(summary->footnote_refs[k], ctx->refs[k]) != 0) return false;
+    }
+    session_drop_refs(summary, ctx->ref_count);
+
+    size_t extra = ctx->before_count + ctx->after_count;
+    if (summary->citation_count < extra) return false;
+    size_t own = summary->citation_count - extra;
+    for (size_t k = 0; k < ctx->before_count; k++) {
+        if (!session_same_cite(&summary->citations[k], ctx->before[k])) return false;
+    }
+    for (size_t k = 0; k < ctx->after_count; k++) {
+        if (!session_same_cite(&summary->citations[ctx->before_count + own + k], ctx->after[k])) return false;
+    }
+    for (size_t k = 0; k < summary->citation_count; k++) {
+        if (k < ctx->before_count || k >= ctx->before_count + own) free(summary->citations[k].key);
+    }
+    memmove(summary->citations, summary->citations + ctx->before_count, own * sizeof(apex_section_citation));
+    summary->citation_count = own;
+    return true;
+}
+
+static bool session_block_matches(const apex_session_block *block, uint64_t hash,
+                                  const char *text, size_t len) {
+    return block->hash == hash && block->source_len == len &&
+           memcmp(block->source, text, len) == 0;
+}
+
+/* Convert block i from text. The section's own abbreviation definitions
+ * are already in the prepended definitions, so they are left out to keep
+ * the document's order. */
+static bool session_render_block(apex_session *session, const session_doc *doc,
+                                 apex_session_block *blocks, size_t count, size_t i,
+                                 const char *text, size_t len, uint64_t hash) {
+    apex_session_block *block = &blocks[i];
+    session_context ctx;
+    if (!session_context_build(doc, blocks, count, i, block->html != NULL, &ctx)) return false;
+
+    session_buf source = {0};
+    session_buf defs = {0};
+    bool ok = session_buf_append(&source, session->refdefs ? session->refdefs : "", session->refdefs_len);
+    if (ok && doc->notes.len > 0) {
+        ok = session_buf_blank_line(&source) &&
+             session_buf_append(&source, doc->notes.data, doc->note_bounds[i]) &&
+             session_buf_append(&source, doc->notes.data + doc->note_bounds[i + 1],
+                                doc->notes.len - doc->note_bounds[i + 1]);
+    }
+    if (ok && ctx.lead.len) {
+        ok = session_buf_blank_line(&source) && session_buf_append(&source, ctx.lead.data, ctx.lead.len);
+    }
+    if (ok && session_mode_has_abbreviations(session->options.mode)) {
+        ok = session_split_abbr_defs(text, len, &defs, &source);
+    } else if (ok) {
+        ok = session_buf_append(&source, text, len);
+    }
+    if (ok && ctx.trail.len) {
+        ok = session_buf_blank_line(&source) && session_buf_append(&source, ctx.trail.data, ctx.trail.len);
+    }
+    free(defs.data);
+    if (!ok) {
+        free(source.data);
+        session_context_free(&ctx);
+        return false;
+    }
+
+    apex_options options = session->options;
+    if (doc->cites && !ctx.bibliography) options.suppress_bibliography = true;
+    apex_section_summary summary = {0};
+    summary.expand_toc = ctx.expand_toc;
+    summary.toc_entries = doc->toc;
+    summary.toc_entry_count = doc->toc_count;
+
+    char *html = apex_converter_convert_section(session->converter, source.data, source.len,
+                                                &options, &summary);
+    free(source.data);
+    session->last_rendered++;
+    size_t html_len = html ? strlen(html) : 0;
+    ok = html && !summary.failed && session_finish_block(html, &html_len, &ctx, &summary);
+    session_context_free(&ctx);
+    summary.toc_entries = NULL;
+    summary.toc_entry_count = 0;
+    summary.expand_toc = false;
+    if (!ok) {
+        apex_free_string(html);
+        apex_section_summary_clear(&summary);
+        return false;
+    }
+
+    session_block_clear(block);
+    block->html = html;
+    block->html_len = html_len;
+    block->hash = hash;
+    block->summary = summary;
+    block->source = malloc(len + 1);
+    if (!block->source) return false;
+    memcpy(block->source, text, len);
+    block->source[len] = '\0';
+    block->source_len = len;
+
+    /* Record what the section depends on, now that its summary is known */
+    if (!session_context_build(doc, blocks, count, i, true, &ctx)) return false;
+    block->context = ctx.hash;
+    session_context_free(&ctx);
+    return true;
+}
+
+/* Convert the whole document; the block cache is left as it was */
+static char *session_render_full(apex_session *session, const char *markdown, size_t len) {
+    session->last_rendered++;
+    return apex_converter_convert(session->converter, markdown, len);
+}
+
+apex_session *apex_session_new(const apex_options *options) {
+    apex_session *session = calloc(1, sizeof(apex_session));
+    if (!session) return NULL;
+
+    session->options = options ? *options : apex_options_default();
+    session->converter = apex_converter_new(&session->options);
+    if (!session->converter) {
+        free(session);
+        return NULL;
+    }
+    return session;
+}
+
+char *apex_session_render(apex_session *session, const char *markdown, size_t len) {
+    if (!session) return NULL;
+    if (!markdown) {
+        markdown = "";
+        len = 0;
+    }
+    session->last_rendered = 0;
+
+    const apex_options *options = &session->options;
+    bool abbreviations = session_mode_has_abbreviations(options->mode);
+    if (!session_options_cacheable(options) ||
+        session_has_metadata(markdown, len, options->mode) ||
+        session_has_global_syntax(markdown, len, abbreviations, options->enable_footnotes)) {
+        return session_render_full(session, markdown, len);
+    }
+
+    apex_chunk_plan plan;
+    if (!apex_plan_sections(markdown, len, &plan)) {
+        return session_render_full(session, markdown, len);
+    }
+
+    /* Definitions to prepend: the planner's reference definitions, then
+     * every abbreviation definition in document order (the planner can
+     * take "[>abbr]:" for a reference definition, so those are moved) */
+    session_buf defs = {0};
+    bool defs_ok = true;
+    if (abbreviations) {
+        session_buf abbr_defs = {0};
+        defs_ok = session_split_abbr_defs(plan.refdefs ? plan.refdefs : "", plan.refdefs_len, &abbr_defs, &defs) &&
+                  session_split_abbr_defs(markdown, len, &defs, NULL);
+        free(abbr_defs.data);
+    } else if (plan.refdefs_len) {
+        defs_ok = session_buf_append(&defs, plan.refdefs, plan.refdefs_len);
+    }
+
+    /* Footnote definitions move between sections, and citations need
+     * every section to leave apex_process_citations() outside code */
+    session_doc doc = {0};
+    doc.cites = options->enable_citations && (options->bibliography_files || options->csl_file) &&
+                (options->mode == APEX_MODE_MULTIMARKDOWN || apex_mode_is_unified_family(options->mode));
+    if (defs_ok && options->enable_footnotes) {
+        defs_ok = session_scan_notes(markdown, len, &plan, &doc, doc.cites) &&
+                  (doc.notes.len == 0 || (!options->random_footnote_ids && !options->page_break_before_footnotes));
+    }
+    if (defs_ok && doc.cites) {
+        defs_ok = session_code_state_closed(defs.data ? defs.data : "", defs.len) &&
+                  session_code_state_closed(doc.notes.data ? doc.notes.data : "", doc.notes.len);
+        for (size_t i = 0; defs_ok && i < plan.count; i++) {
+            size_t end = (i + 1 < plan.count) ? plan.offsets[i + 1] : len;
+            defs_ok = session_code_state_closed(markdown + plan.offsets[i], end - plan.offsets[i]);
+        }
+    }
+    if (!defs_ok) {
+        free(defs.data);
+        session_doc_free(&doc);
+        apex_chunk_plan_free(&plan);
+        return session_render_full(session, markdown, len);
+    }
+
+    /* New definitions change every section's output */
+    if (defs.len != session->refdefs_len ||
+        (defs.len && memcmp(defs.data, session->refdefs, defs.len) != 0)) {
+        session_clear(session);
+        session->refdefs = defs.data;
+        session->refdefs_len = defs.len;
+    } else {
+        free(defs.data);
+    }
+
+    size_t count = plan.count;
+    apex_session_block *blocks = calloc(count, sizeof(apex_session_block));
+    uint64_t *hashes = malloc(count * sizeof(uint64_t));
+    if (!blocks || !hashes) {
+        free(blocks);
+        free(hashes);
+        session_doc_free(&doc);
+        apex_chunk_plan_free(&plan);
+        return session_render_full(session, markdown, len);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        size_t end = (i + 1 < count) ? plan.offsets[i + 1] : len;
+        hashes[i] = session_hash(markdown + plan.offsets[i], end - plan.offsets[i]);
+    }
+
+    /* Unchanged sections before and after the edit keep their HTML */
+    size_t old_count = session->block_count;
+    size_t prefix = 0;
+    while (prefix < count && prefix < old_count) {
+        size_t end = (prefix + 1 < count) ? plan.offsets[prefix + 1] : len;
+        if (!session_block_matches(&session->blocks[prefix], hashes[prefix],
+                                   markdown + plan.offsets[prefix], end - plan.offsets[prefix])) {
+            break;
+        }
+        blocks[prefix] = session->blocks[prefix];
+        memset(&session->blocks[prefix], 0, sizeof(apex_session_block));
+        prefix++;
+    }
+    size_t suffix = 0;
+    while (suffix < count - prefix && suffix < old_count - prefix) {
+        size_t ni = count - 1 - suffix;
+        size_t oi = old_count - 1 - suffix;
+        size_t end = (ni + 1 < count) ? plan.offsets[ni + 1] : len;
+        if (!session_block_matches(&session->blocks[oi], hashes[ni],
+                                   markdown + plan.offsets[ni], end - plan.offsets[ni])) {
+            break;
+        }
+        blocks[ni] = session->blocks[oi];
+        memset(&session->blocks[oi], 0, sizeof(apex_session_block));
+        suffix++;
+    }
+
+    /* Replace the old cache with the new block list */
+    for (size_t i = 0; i < old_count; i++) {
+        session_block_clear(&session->blocks[i]);
+    }
+    free(session->blocks);
+    session->blocks = blocks;
+    session->block_count = count;
+
+    /* Convert the edited sections, then every section whose context from
+     * the rest of the document changed with them */
+    bool ok = session_doc_update(&doc, blocks, count, options);
+    for (size_t i = prefix; ok && i < count - suffix; i++) {
+        size_t end = (i + 1 < count) ? plan.offsets[i + 1] : len;
+        ok = session_render_block(session, &doc, blocks, count, i, markdown + plan.offsets[i],
+                                  end - plan.offsets[i], hashes[i]);
+    }
+    ok = ok && session_doc_update(&doc, blocks, count, options);
+    for (size_t i = 0; ok && i < count; i++) {
+        session_context ctx;
+        ok = session_context_build(&doc, blocks, count, i, true, &ctx);
+        if (ok && ctx.hash != blocks[i].context) {
+            size_t end = (i + 1 < count) ? plan.offsets[i + 1] : len;
+            ok = session_render_block(session, &doc, blocks, count, i, markdown + plan.offsets[i],
+                                      end - plan.offsets[i], hashes[i]);
+        }
+        if (ok) session_context_free(&ctx);
+    }
+    free(hashes);
+    session_doc_free(&doc);
+    apex_chunk_plan_free(&plan);
+
+    if (!ok) {
+        session_clear(session);
+        return session_render_full(session, markdown, len);
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += blocks[i].html_len;
+    }
+    char *html = malloc(total + 1);
+    if (!html) return NULL;
+    char *w = html;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(w, blocks[i].html, blocks[i].html_len);
+        w += blocks[i].html_len;
+    }
+    *w = '\0';
+    return html;
+}
+
+size_t apex_session_last_rendered(const apex_session *session) {
+    return session ? session->last_rendered : 0;
+}
+
+void apex_session_free(apex_session *session) {
+    if (!session) return;
+    session_clear(session);
+    apex_converter_free(session->converter);
+    free(session);
+}
@@ -0,0 +1,149 @@
+/**
+ * Conversion Statistics
+ */
+
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Per-thread running totals; timers take differences */
+static __thread size_t tls_allocations = 0;
+static __thread uint64_t tls_subprocess_ns = 0;
+static __thread size_t tls_subprocesses = 0;
+
+uint64_t apex_stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void stats_timer_start(apex_stats_timer *timer, apex_stats *stats, const char *name, size_t bytes_in) {
+    timer->stats = stats;
+    timer->name = name;
+    timer->bytes_in = bytes_in;
+    timer->allocations = tls_allocations;
+    timer->subprocess_ns = tls_subprocess_ns;
+    timer->subprocesses = tls_subprocesses;
+    timer->start_ns = apex_stats_now_ns();
+}
+
+void apex_stats_begin(apex_stats *stats, apex_stats_timer *timer, size_t input_len) {
+    memset(stats, 0, sizeof(*stats));
+    stats_timer_start(timer, stats, NULL, input_len);
+}
+
+void apex_stats_finish(apex_stats_timer *timer, size_t output_len) {
+    apex_stats *stats = timer->stats;
+    stats->elapsed_ns = apex_stats_now_ns() - timer->start_ns;
+    stats->bytes_in = timer->bytes_in;
+    stats->bytes_out = output_len;
+    stats->cmark_allocations = tls_allocations - timer->allocations;
+    stats->subprocess_ns = tls_subprocess_ns - timer->subprocess_ns;
+    stats->subprocesses = tls_subprocesses - timer->subprocesses;
+}
+
+void apex_stats_stage_begin(apex_stats_timer *timer, apex_stats *stats, const char *name, const char *input) {
+    stats_timer_start(timer, stats, name, input ? strlen(input) : 0);
+}
+
+void apex_stats_stage_end(apex_stats_timer *timer, const char *output) {
+    uint64_t elapsed = apex_stats_now_ns() - timer->start_ns;
+    apex_stats *stats = timer->stats;
+
+    apex_stage_stats *stage = NULL;
+    for (size_t i = 0; i < stats->stage_count; i++) {
+        if (stats->stages[i].name == timer->name || strcmp(stats->stages[i].name, timer->name) == 0) {
+            stage = &stats->stages[i];
+            break;
+        }
+    }
+    if (!stage) {
+        if (stats->stage_count >= APEX_STATS_MAX_STAGES) return;
+        stage = &stats->stages[stats->stage_count++];
+        stage->name = timer->name;
+    }
+
+    stage->calls++;
+    stage->elapsed_ns += elapsed;
+    stage->bytes_in += timer->bytes_in;
+    stage->bytes_out += output ? strlen(output) : timer->bytes_in;
+    stage->cmark_allocations += tls_allocations - timer->allocations;
+    stage->subprocess_ns += tls_subprocess_ns - timer->subprocess_ns;
+}
+
+static void *stats_calloc(size_t count, size_t size) {
+    tls_allocations++;
+    void *ptr = calloc(count, size);
+    if (!ptr) abort();  /* Same as cmark's default allocator */
+    return ptr;
+}
+
+static void *stats_realloc(void *ptr, size_t size) {
+    tls_allocations++;
+    void *new_ptr = realloc(ptr, size);
+    if (!new_ptr) abort();
+    return new_ptr;
+}
+
+static cmark_mem stats_mem = { stats_calloc, stats_realloc, free };
+
+cmark_mem *apex_stats_allocator(void) {
+    return &stats_mem;
+}
+
+uint64_t apex_stats_subprocess_begin(void) {
+    return apex_stats_now_ns();
+}
+
+void apex_stats_subprocess_end(uint64_t start_ns) {
+    tls_subprocess_ns += apex_stats_now_ns() - start_ns;
+    tls_subprocesses++;
+}
+
+void apex_stats_print(const apex_stats *stats, FILE *out) {
+    for (size_t i = 0; i < stats->stage_count; i++) {
+        fprintf(out, "[PROFILE] %-30s: %8.2f ms\n",
+                stats->stages[i].name, stats->stages[i].elapsed_ns / 1e6);
+    }
+    fprintf(out, "[PROFILE] %-30s: %8.2f ms\n", "total", stats->elapsed_ns / 1e6);
+    fprintf(out, "[PROFILE] %-30s: %8s\n", "---", "---");
+}
+
+char *apex_stats_to_json(const apex_stats *stats) {
+    if (!stats) return NULL;
+
+    /* Stage names are identifiers, so nothing needs escaping */
+    size_t cap = 256;
+    for (size_t i = 0; i < stats->stage_count; i++) {
+        cap += strlen(stats->stages[i].name) + 200;
+    }
+    char *json = malloc(cap);
+    if (!json) return NULL;
+
+    size_t used = (size_t)snprintf(json, cap,
+                                   "{\"elapsed_ns\":%llu,\"bytes_in\":%zu,\"bytes_out\":%zu,"
+                                   "\"cmark_allocations\":%zu,\"subprocess_ns\":%llu,\"subprocesses\":%zu,"
+                                   "\"stages\":[",
+                                   (unsigned long long)stats->elapsed_ns, stats->bytes_in, stats->bytes_out,
+                                   stats->cmark_allocations, (unsigned long long)stats->subprocess_ns,
+                                   stats->subprocesses);
+    for (size_t i = 0; i < stats->stage_count && used < cap; i++) {
+        const apex_stage_stats *stage = &stats->stages[i];
+        used += (size_t)snprintf(json + used, cap - used,
+                                 "%s{\"name\":\"%s\",\"calls\":%zu,\"elapsed_ns\":%llu,"
+                                 "\"bytes_in\":%zu,\"bytes_out\":%zu,\"cmark_allocations\":%zu,"
+                                 "\"subprocess_ns\":%llu}",
+                                 i ? "," : "", stage->name, stage->calls,
+                                 (unsigned long long)stage->elapsed_ns, stage->bytes_in,
+                                 stage->bytes_out, stage->cmark_allocations,
+                                 (unsigned long long)stage->subprocess_ns);
+    }
+    if (used + 3 > cap) {
+        free(json);
+        return NULL;
+    }
+    memcpy(json + used, "]}", 3);
+    return json;
+}
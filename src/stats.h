@@ -0,0 +1,85 @@
+/**
+ * Conversion Statistics
+ *
+ * Fills apex_options.stats while a conversion runs. Every stage of the
+ * pipeline is bracketed by PROFILE_START/PROFILE_END in apex.c, which call
+ * into here only when statistics were requested.
+ *
+ * Allocations are counted by handing the parser an allocator that counts
+ * calloc and realloc calls, so they cover document nodes and cmark buffers.
+ * Subprocess time is added up by the code that runs plugins, AST filters
+ * and highlighters. Both counters are per thread and always on; the cost
+ * is a few instructions per allocation and a clock read per subprocess.
+ */
+
+#ifndef APEX_STATS_H
+#define APEX_STATS_H
+
+#include "apex/apex.h"
+#include "cmark-gfm.h"
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* One running stage (or the whole conversion) */
+typedef struct {
+    apex_stats *stats;
+    const char *name;
+    uint64_t start_ns;
+    size_t bytes_in;
+    size_t allocations;
+    uint64_t subprocess_ns;
+    size_t subprocesses;
+} apex_stats_timer;
+
+/**
+ * Monotonic clock in nanoseconds
+ */
+uint64_t apex_stats_now_ns(void);
+
+/**
+ * Clear stats and start timing a conversion of input_len bytes
+ */
+void apex_stats_begin(apex_stats *stats, apex_stats_timer *timer, size_t input_len);
+
+/**
+ * Finish a conversion that produced output_len bytes
+ */
+void apex_stats_finish(apex_stats_timer *timer, size_t output_len);
+
+/**
+ * Start a stage. input is the text the stage works on, or NULL if it
+ * works on the document tree.
+ */
+void apex_stats_stage_begin(apex_stats_timer *timer, apex_stats *stats, const char *name, const char *input);
+
+/**
+ * End a stage. output is the text it produced, or NULL if it left its
+ * input as is.
+ */
+void apex_stats_stage_end(apex_stats_timer *timer, const char *output);
+
+/**
+ * Allocator that counts calloc and realloc calls for the statistics
+ */
+cmark_mem *apex_stats_allocator(void);
+
+/**
+ * Bracket an external command: pass the value returned by _begin to _end
+ */
+uint64_t apex_stats_subprocess_begin(void);
+void apex_stats_subprocess_end(uint64_t start_ns);
+
+/**
+ * Write stats as "[PROFILE]" lines in milliseconds (the APEX_PROFILE format)
+ */
+void apex_stats_print(const apex_stats *stats, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APEX_STATS_H */
@@ -0,0 +1,303 @@
+/**
+ * In-process Benchmark
+ *
+ * Converts fixture documents held in memory, so the numbers measure the
+ * library rather than process start-up. Each fixture is converted in each
+ * mode many times after a warm-up; the report gives the p50/p90/p99 time
+ * per conversion, throughput, and the median time of every pipeline stage
+ * (from apex_options.stats, in a separate pass so the timed runs don't pay
+ * for the bookkeeping).
+ *
+ * Usage: apex_bench [-n iterations] [-w warmup] [-s max seconds per case]
+ *                   [-m mode[,mode...]] [--json] [file.md ...]
+ *
+ * Without files, the standard fixtures (comprehensive_test.md, large_doc.md,
+ * speed.md) are used. --json prints one object per line, one line per
+ * fixture and mode, so results from two commits can be compared with diff.
+ */
+
+#include "apex/apex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef APEX_BENCH_FIXTURES_DIR
+#define APEX_BENCH_FIXTURES_DIR "tests/fixtures"
+#endif
+
+#define BENCH_TOP_STAGES 8
+
+static const char *default_fixtures[] = { "comprehensive_test.md", "large_doc.md", "speed.md" };
+
+static const struct {
+    const char *name;
+    apex_mode_t mode;
+} bench_modes[] = {
+    { "commonmark", APEX_MODE_COMMONMARK },
+    { "gfm", APEX_MODE_GFM },
+    { "multimarkdown", APEX_MODE_MULTIMARKDOWN },
+    { "kramdown", APEX_MODE_KRAMDOWN },
+    { "unified", APEX_MODE_UNIFIED },
+};
+#define BENCH_MODE_COUNT (sizeof(bench_modes) / sizeof(bench_modes[0]))
+
+typedef struct {
+    int iterations;
+    int warmup;
+    double max_seconds;
+    bool json;
+} bench_config;
+
+typedef struct {
+    const char *name;
+    uint64_t median_ns;
+} bench_stage;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(fp);
+        return NULL;
+    }
+    char *buf = malloc((size_t)size + 1);
+    if (buf) {
+        *len = fread(buf, 1, (size_t)size, fp);
+        buf[*len] = '\0';
+    }
+    fclose(fp);
+    return buf;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Nearest-rank percentile of sorted samples */
+static uint64_t percentile(const uint64_t *sorted, size_t count, double p) {
+    if (count == 0) return 0;
+    size_t rank = (size_t)(p / 100.0 * (double)count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+static int compare_stage_desc(const void *a, const void *b) {
+    uint64_t x = ((const bench_stage *)a)->median_ns;
+    uint64_t y = ((const bench_stage *)b)->median_ns;
+    return x > y ? -1 : x < y;
+}
+
+/* Median time of each stage over `runs` conversions with statistics on, in pipeline order */
+static size_t bench_stages(const char *doc, size_t len, const apex_options *base, int runs,
+                           bench_stage *out) {
+    apex_options opts = *base;
+    apex_stats stats;
+    opts.stats = &stats;
+
+    uint64_t *samples = calloc((size_t)runs * APEX_STATS_MAX_STAGES, sizeof(uint64_t));
+    const char *names[APEX_STATS_MAX_STAGES];
+    size_t stage_count = 0;
+    if (!samples) return 0;
+
+    for (int r = 0; r < runs; r++) {
+        apex_free_string(apex_markdown_to_html(doc, len, &opts));
+        if (r == 0) {
+            stage_count = stats.stage_count;
+            for (size_t i = 0; i < stage_count; i++) names[i] = stats.stages[i].name;
+        }
+        /* The same input runs the same stages, in the same order */
+        for (size_t i = 0; i < stage_count && i < stats.stage_count; i++) {
+            samples[i * (size_t)runs + (size_t)r] = stats.stages[i].elapsed_ns;
+        }
+    }
+
+    for (size_t i = 0; i < stage_count; i++) {
+        uint64_t *row = samples + i * (size_t)runs;
+        qsort(row, (size_t)runs, sizeof(uint64_t), compare_u64);
+        out[i].name = names[i];
+        out[i].median_ns = percentile(row, (size_t)runs, 50);
+    }
+    free(samples);
+    return stage_count;
+}
+
+static void bench_case(const char *label, const char *doc, size_t len, const char *mode_name,
+                       apex_mode_t mode, const bench_config *config) {
+    apex_options opts = apex_options_for_mode(mode);
+    opts.base_directory = APEX_BENCH_FIXTURES_DIR;
+
+    for (int i = 0; i < config->warmup; i++) {
+        apex_free_string(apex_markdown_to_html(doc, len, &opts));
+    }
+
+    uint64_t *samples = malloc((size_t)config->iterations * sizeof(uint64_t));
+    if (!samples) return;
+    uint64_t budget_ns = (uint64_t)(config->max_seconds * 1e9);
+    uint64_t started = now_ns();
+    size_t count = 0;
+    size_t output_len = 0;
+    for (int i = 0; i < config->iterations; i++) {
+        uint64_t t0 = now_ns();
+        char *html = apex_markdown_to_html(doc, len, &opts);
+        samples[count++] = now_ns() - t0;
+        if (i == 0 && html) output_len = strlen(html);
+        apex_free_string(html);
+        /* Slow cases stop at the time budget, after a minimum sample */
+        if (count >= 20 && now_ns() - started > budget_ns) break;
+    }
+    qsort(samples, count, sizeof(uint64_t), compare_u64);
+    uint64_t p50 = percentile(samples, count, 50);
+    uint64_t p90 = percentile(samples, count, 90);
+    uint64_t p99 = percentile(samples, count, 99);
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++) total += samples[i];
+    double mean = count ? (double)total / (double)count : 0;
+    double mb_per_s = p50 ? ((double)len / 1e6) / ((double)p50 / 1e9) : 0;
+    free(samples);
+
+    int stage_runs = (int)(count < 200 ? count : 200);
+    bench_stage stages[APEX_STATS_MAX_STAGES];
+    size_t stage_count = bench_stages(doc, len, &opts, stage_runs > 0 ? stage_runs : 1, stages);
+
+    if (config->json) {
+        printf("{\"fixture\":\"%s\",\"mode\":\"%s\",\"bytes\":%zu,\"output_bytes\":%zu,"
+               "\"iterations\":%zu,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,"
+               "\"mean_ns\":%.0f,\"mb_per_s\":%.2f,\"stages\":{",
+               label, mode_name, len, output_len, count,
+               (unsigned long long)p50, (unsigned long long)p90, (unsigned long long)p99,
+               mean, mb_per_s);
+        for (size_t i = 0; i < stage_count; i++) {
+            printf("%s\"%s\":%llu", i ? "," : "", stages[i].name, (unsigned long long)stages[i].median_ns);
+        }
+        printf("}}\n");
+        return;
+    }
+
+    printf("| %-24s | %-13s | %8.1f | %6zu | %9.1f | %9.1f | %9.1f | %8.2f |\n",
+           label, mode_name, len / 1024.0, count, p50 / 1e3, p90 / 1e3, p99 / 1e3, mb_per_s);
+    /* The slowest stages */
+    qsort(stages, stage_count, sizeof(bench_stage), compare_stage_desc);
+    for (size_t i = 0; i < stage_count && i < BENCH_TOP_STAGES; i++) {
+        printf("|   %-22s |               |          |        | %9.1f |           |           |          |\n",
+               stages[i].name, stages[i].median_ns / 1e3);
+    }
+}
+
+/* Whether a comma-separated list has this entry */
+static bool list_has(const char *list, const char *name, size_t name_len) {
+    for (const char *p = list; *p; ) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len == name_len && strncmp(p, name, len) == 0) return true;
+        if (!end) break;
+        p = end + 1;
+    }
+    return false;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "Usage: %s [-n iterations] [-w warmup] [-s max seconds per case] "
+            "[-m mode[,mode...]] [--json] [file.md ...]\n"
+            "Modes: commonmark, gfm, multimarkdown, kramdown, unified (default: all)\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    bench_config config = { 2000, 200, 30.0, false };
+    const char *mode_list = NULL;
+    const char **files = calloc((size_t)argc, sizeof(char *));
+    size_t file_count = 0;
+    if (!files) return 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            config.iterations = atoi(argv[++i]);
+            if (config.iterations <= 0) config.iterations = 1;
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            config.warmup = atoi(argv[++i]);
+            if (config.warmup < 0) config.warmup = 0;
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            config.max_seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            mode_list = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0) {
+            config.json = true;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            free(files);
+            return 1;
+        } else {
+            files[file_count++] = argv[i];
+        }
+    }
+
+    /* Reject unknown mode names rather than silently benchmarking nothing */
+    for (const char *p = mode_list; p && *p; ) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        bool known = false;
+        for (size_t m = 0; m < BENCH_MODE_COUNT; m++) {
+            if (strlen(bench_modes[m].name) == len && strncmp(p, bench_modes[m].name, len) == 0) known = true;
+        }
+        if (!known) {
+            fprintf(stderr, "Unknown mode '%.*s'\n", (int)len, p);
+            usage(argv[0]);
+            free(files);
+            return 1;
+        }
+        p = end ? end + 1 : p + len;
+    }
+
+    size_t fixture_count = file_count ? file_count : sizeof(default_fixtures) / sizeof(default_fixtures[0]);
+    if (!config.json) {
+        printf("%d iterations (%d warm-up, at most %.0f s per case); times in microseconds, "
+               "stage rows are medians\n\n", config.iterations, config.warmup, config.max_seconds);
+        printf("| %-24s | %-13s | %8s | %6s | %9s | %9s | %9s | %8s |\n",
+               "Fixture", "Mode", "KB", "Runs", "p50", "p90", "p99", "MB/s");
+        printf("|--------------------------|---------------|----------|--------|-----------|"
+               "-----------|-----------|----------|\n");
+    }
+
+    int status = 0;
+    for (size_t f = 0; f < fixture_count; f++) {
+        char path[1024];
+        const char *label;
+        if (file_count) {
+            snprintf(path, sizeof(path), "%s", files[f]);
+            label = strrchr(files[f], '/') ? strrchr(files[f], '/') + 1 : files[f];
+        } else {
+            snprintf(path, sizeof(path), "%s/%s", APEX_BENCH_FIXTURES_DIR, default_fixtures[f]);
+            label = default_fixtures[f];
+        }
+        size_t len = 0;
+        char *doc = read_file(path, &len);
+        if (!doc) {
+            fprintf(stderr, "Cannot read %s\n", path);
+            status = 1;
+            continue;
+        }
+        for (size_t m = 0; m < BENCH_MODE_COUNT; m++) {
+            if (mode_list && !list_has(mode_list, bench_modes[m].name, strlen(bench_modes[m].name))) continue;
+            bench_case(label, doc, len, bench_modes[m].name, bench_modes[m].mode, &config);
+        }
+        free(doc);
+    }
+
+    free(files);
+    return status;
+}
@@ -0,0 +1,115 @@
+/**
+ * Converter Benchmark
+ *
+ * Measures the per-document setup that a reusable apex_converter removes:
+ * the same small document is converted with apex_markdown_to_html() and
+ * with apex_converter_convert(), and the mean time per call is reported.
+ *
+ * Usage: apex_bench_converter [file.md] [iterations]
+ */
+
+#include "apex/apex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* A short comment, the kind of input where setup cost dominates */
+static const char *default_doc =
+    "Thanks for the review! I fixed the **typo** in `apex.c` and added a test.\n"
+    "\n"
+    "- [x] rebase on main\n"
+    "- [ ] update the [changelog](CHANGELOG.md) :smile:\n";
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(fp);
+        return NULL;
+    }
+    char *buf = malloc((size_t)size + 1);
+    if (buf) {
+        *len = fread(buf, 1, (size_t)size, fp);
+        buf[*len] = '\0';
+    }
+    fclose(fp);
+    return buf;
+}
+
+static double bench_one_shot(const char *doc, size_t len, const apex_options *opts, int iterations) {
+    double start = now_us();
+    for (int i = 0; i < iterations; i++) {
+        apex_free_string(apex_markdown_to_html(doc, len, opts));
+    }
+    return (now_us() - start) / iterations;
+}
+
+static double bench_converter(const char *doc, size_t len, const apex_options *opts, int iterations) {
+    double start = now_us();
+    apex_converter *converter = apex_converter_new(opts);
+    if (!converter) return -1;
+    for (int i = 0; i < iterations; i++) {
+        apex_free_string(apex_converter_convert(converter, doc, len));
+    }
+    apex_converter_free(converter);
+    return (now_us() - start) / iterations;
+}
+
+static void run(const char *label, const char *doc, size_t len, const apex_options *opts, int iterations) {
+    /* Warm up caches and the allocator */
+    bench_one_shot(doc, len, opts, iterations / 10 + 1);
+
+    double one_shot = bench_one_shot(doc, len, opts, iterations);
+    double reused = bench_converter(doc, len, opts, iterations);
+    printf("| %-28s | %12.2f | %12.2f | %12.2f |\n",
+           label, one_shot, reused, one_shot - reused);
+}
+
+int main(int argc, char **argv) {
+    const char *doc = default_doc;
+    size_t len = strlen(default_doc);
+    char *file_doc = NULL;
+    int iterations = 20000;
+
+    if (argc > 1) {
+        file_doc = read_file(argv[1], &len);
+        if (!file_doc) {
+            fprintf(stderr, "Cannot read %s\n", argv[1]);
+            return 1;
+        }
+        doc = file_doc;
+        iterations = 200;
+    }
+    if (argc > 2) {
+        iterations = atoi(argv[2]);
+        if (iterations <= 0) iterations = 1;
+    }
+
+    printf("Input: %s (%zu bytes), %d iterations\n\n",
+           file_doc ? argv[1] : "built-in comment", len, iterations);
+    printf("| %-28s | %12s | %12s | %12s |\n", "Options", "one-shot us", "converter us", "saved us");
+    printf("|------------------------------|--------------|--------------|--------------|\n");
+
+    apex_options opts = apex_options_default();
+    run("unified (defaults)", doc, len, &opts, iterations);
+
+    opts.enable_plugins = true;
+    run("unified + plugins", doc, len, &opts, iterations);
+
+    opts = apex_options_for_mode(APEX_MODE_GFM);
+    run("gfm", doc, len, &opts, iterations);
+
+    free(file_doc);
+    return 0;
+}
@@ -0,0 +1,386 @@
+/**
+ * Scaling Benchmark
+ *
+ * Generates documents of one syntax family (tables, footnotes, emoji,
+ * abbreviations, definition lists, headings, wiki links, citations) at
+ * sizes from 1 KB up to 100 MB, converts each with apex_options.stats set,
+ * and fits the growth exponent of every pipeline stage: the slope of
+ * log(time) against log(size). A linear stage has an exponent near 1, a
+ * quadratic one near 2. Stages above the threshold are flagged.
+ *
+ * Usage: apex_bench_scaling [-f family[,family...]] [--min KB] [--max KB]
+ *                           [-r repeats] [-s max seconds per conversion]
+ *                           [-t threshold] [--json]
+ *
+ * A family stops growing once one conversion takes longer than -s seconds,
+ * so a quadratic stage does not hold the sweep up for hours. Times under
+ * BENCH_MIN_FIT_NS are left out of the fit, since there the clock and
+ * fixed costs dominate.
+ */
+
+#include "apex/apex.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_MAX_SIZES 16
+#define BENCH_MIN_FIT_NS 50000ULL
+
+/* Growable text buffer for the generators */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} bench_buf;
+
+static bool buf_appendf(bench_buf *buf, const char *fmt, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf->data + buf->len, buf->cap - buf->len, fmt, args);
+        va_end(args);
+        if (n < 0) return false;
+        if ((size_t)n < buf->cap - buf->len) {
+            buf->len += (size_t)n;
+            return true;
+        }
+        size_t cap = buf->cap ? buf->cap * 2 : 4096;
+        while (cap - buf->len <= (size_t)n) cap *= 2;
+        char *data = realloc(buf->data, cap);
+        if (!data) return false;
+        buf->data = data;
+        buf->cap = cap;
+    }
+}
+
+/* Generators: each appends unit i of its family */
+
+static void gen_table(bench_buf *buf, size_t i) {
+    if (i % 20 == 0) {
+        buf_appendf(buf, "\n| Name | Count | Notes |\n|:-----|------:|-------|\n");
+    }
+    buf_appendf(buf, "| item %zu | %zu | *cell* with `code` |\n", i, i * 7);
+}
+
+static void gen_footnote(bench_buf *buf, size_t i) {
+    buf_appendf(buf, "A claim that needs a source[^n%zu].\n\n[^n%zu]: The source for claim %zu.\n\n", i, i, i);
+}
+
+static void gen_emoji(bench_buf *buf, size_t i) {
+    static const char *names[] = { "smile", "heart", "rocket", "tada", "thumbsup", "fire", "star", "warning" };
+    buf_appendf(buf, "Paragraph %zu with :%s: and :%s: in it.\n\n", i, names[i % 8], names[(i + 3) % 8]);
+}
+
+static void gen_abbreviation(bench_buf *buf, size_t i) {
+    buf_appendf(buf, "*[AB%zu]: Abbreviation number %zu\n\nThe AB%zu and AB%zu terms appear here.\n\n",
+                i, i, i, i / 2);
+}
+
+static void gen_definition(bench_buf *buf, size_t i) {
+    buf_appendf(buf, "Term %zu\n: The definition of term %zu with *emphasis*.\n\n", i, i);
+}
+
+static void gen_heading(bench_buf *buf, size_t i) {
+    /* A TOC marker in inline code per section: skipped, but each one is checked */
+    buf_appendf(buf, "## Section %zu\n\nText of section %zu, showing `{{TOC}}` as code.\n\n", i, i);
+}
+
+static void gen_wiki_link(bench_buf *buf, size_t i) {
+    buf_appendf(buf, "See [[Page %zu]] and [[Other Page %zu|the other one]].\n\n", i, i / 2);
+}
+
+static void gen_citation(bench_buf *buf, size_t i) {
+    buf_appendf(buf, "As shown before [@key%zu], and again [@key%zu, p. 4].\n\n", i, i / 2);
+}
+
+typedef struct {
+    const char *name;
+    void (*unit)(bench_buf *buf, size_t i);
+    const char *epilogue;
+} bench_family;
+
+static const bench_family families[] = {
+    { "tables", gen_table, NULL },
+    { "footnotes", gen_footnote, NULL },
+    { "emoji", gen_emoji, NULL },
+    { "abbreviations", gen_abbreviation, NULL },
+    { "definition_lists", gen_definition, NULL },
+    { "headings", gen_heading, "<!--TOC-->\n" },
+    { "wiki_links", gen_wiki_link, NULL },
+    { "citations", gen_citation, NULL },
+};
+#define BENCH_FAMILY_COUNT (sizeof(families) / sizeof(families[0]))
+
+/* Document of at least target bytes; *units is the number of units written */
+static char *generate(const bench_family *family, size_t target, size_t *len, size_t *units) {
+    bench_buf buf = { NULL, 0, 0 };
+    size_t i = 0;
+    buf_appendf(&buf, "# %s\n\n", family->name);
+    while (buf.len < target) family->unit(&buf, i++);
+    if (family->epilogue) buf_appendf(&buf, "%s", family->epilogue);
+    *len = buf.len;
+    *units = i;
+    return buf.data;
+}
+
+/* BibTeX file with an entry for every key the citation generator uses */
+static bool write_bibliography(const char *path, size_t units) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return false;
+    for (size_t i = 0; i < units; i++) {
+        fprintf(fp, "@article{key%zu,\n  author = {Author, Number %zu},\n  title = {Title %zu},\n"
+                    "  journal = {Journal},\n  year = {%zu}\n}\n\n", i, i, i, 1900 + i % 120);
+    }
+    return fclose(fp) == 0;
+}
+
+/* One fitted series: time per size for a stage */
+typedef struct {
+    const char *name;
+    size_t points;
+    double bytes[BENCH_MAX_SIZES];
+    uint64_t ns[BENCH_MAX_SIZES];
+} bench_series;
+
+typedef struct {
+    bench_series series[APEX_STATS_MAX_STAGES + 1];
+    size_t count;
+} bench_results;
+
+static bench_series *results_series(bench_results *results, const char *name) {
+    for (size_t i = 0; i < results->count; i++) {
+        if (strcmp(results->series[i].name, name) == 0) return &results->series[i];
+    }
+    if (results->count >= sizeof(results->series) / sizeof(results->series[0])) return NULL;
+    bench_series *series = &results->series[results->count++];
+    memset(series, 0, sizeof(*series));
+    series->name = name;
+    return series;
+}
+
+static void series_add(bench_series *series, double bytes, uint64_t ns) {
+    if (!series || series->points >= BENCH_MAX_SIZES) return;
+    series->bytes[series->points] = bytes;
+    series->ns[series->points] = ns;
+    series->points++;
+}
+
+/* Least-squares slope of log(ns) on log(bytes); false if under three usable points */
+static bool series_exponent(const bench_series *series, double *exponent) {
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < series->points; i++) {
+        if (series->ns[i] < BENCH_MIN_FIT_NS) continue;
+        double x = log(series->bytes[i]);
+        double y = log((double)series->ns[i]);
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+        n++;
+    }
+    if (n < 3) return false;
+    double denom = (double)n * sxx - sx * sx;
+    if (denom <= 0) return false;
+    *exponent = ((double)n * sxy - sx * sy) / denom;
+    return true;
+}
+
+typedef struct {
+    size_t min_bytes;
+    size_t max_bytes;
+    int repeats;
+    double max_seconds;
+    double threshold;
+    bool json;
+} bench_config;
+
+/* Sweep one family; returns the number of superlinear stages */
+static int bench_family_run(const bench_family *family, const bench_config *config, const char *tmp_dir) {
+    bench_results *results = calloc(1, sizeof(bench_results));
+    if (!results) return 0;
+
+    char bib_path[1024];
+    snprintf(bib_path, sizeof(bib_path), "%s/refs.bib", tmp_dir);
+    char *bib_files[] = { bib_path, NULL };
+
+    apex_options opts = apex_options_for_mode(APEX_MODE_UNIFIED);
+    opts.base_directory = tmp_dir;
+    opts.enable_wiki_links = true;
+    apex_stats stats, best;
+    opts.stats = &stats;
+
+    /* Sizes grow by 4x and end exactly at the maximum */
+    for (size_t target = config->min_bytes; ; target *= 4) {
+        if (target > config->max_bytes) target = config->max_bytes;
+
+        size_t len = 0, units = 0;
+        char *doc = generate(family, target, &len, &units);
+        if (!doc) break;
+        if (family->unit == gen_citation) {
+            if (!write_bibliography(bib_path, units)) {
+                free(doc);
+                break;
+            }
+            opts.bibliography_files = bib_files;
+        }
+
+        /* Fastest of the repeats, per stage, is the least noisy */
+        for (int r = 0; r < config->repeats; r++) {
+            apex_free_string(apex_markdown_to_html(doc, len, &opts));
+            if (r == 0) {
+                best = stats;
+                continue;
+            }
+            if (stats.elapsed_ns < best.elapsed_ns) best.elapsed_ns = stats.elapsed_ns;
+            for (size_t i = 0; i < stats.stage_count && i < best.stage_count; i++) {
+                if (stats.stages[i].elapsed_ns < best.stages[i].elapsed_ns) {
+                    best.stages[i].elapsed_ns = stats.stages[i].elapsed_ns;
+                }
+            }
+        }
+        free(doc);
+
+        series_add(results_series(results, "total"), (double)len, best.elapsed_ns);
+        for (size_t i = 0; i < best.stage_count; i++) {
+            series_add(results_series(results, best.stages[i].name), (double)len, best.stages[i].elapsed_ns);
+        }
+        if (!config->json) {
+            fprintf(stderr, "  %-16s %10zu bytes  %10.2f ms\n", family->name, len, best.elapsed_ns / 1e6);
+        }
+
+        if (target >= config->max_bytes) break;
+        if ((double)best.elapsed_ns / 1e9 > config->max_seconds) break;
+    }
+    unlink(bib_path);
+
+    int flagged = 0;
+    for (size_t i = 0; i < results->count; i++) {
+        const bench_series *series = &results->series[i];
+        double exponent = 0;
+        bool fitted = series_exponent(series, &exponent);
+        bool superlinear = fitted && exponent > config->threshold;
+        if (superlinear) flagged++;
+        uint64_t last_ns = series->points ? series->ns[series->points - 1] : 0;
+        double last_bytes = series->points ? series->bytes[series->points - 1] : 0;
+
+        if (config->json) {
+            printf("{\"family\":\"%s\",\"stage\":\"%s\",\"points\":%zu,", family->name, series->name,
+                   series->points);
+            if (fitted) printf("\"exponent\":%.3f,", exponent);
+            else printf("\"exponent\":null,");
+            printf("\"max_bytes\":%.0f,\"max_ns\":%llu,\"superlinear\":%s}\n", last_bytes,
+                   (unsigned long long)last_ns, superlinear ? "true" : "false");
+            continue;
+        }
+        /* Stages too fast to fit are noise; leave them out of the table */
+        if (!fitted) continue;
+        printf("| %-16s | %-30s | %8.2f | %12.1f | %10.2f | %-11s |\n", family->name, series->name,
+               exponent, last_bytes / 1024.0, last_ns / 1e6, superlinear ? "SUPERLINEAR" : "");
+    }
+
+    free(results);
+    return flagged;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "Usage: %s [-f family[,family...]] [--min KB] [--max KB] [-r repeats] "
+            "[-s max seconds per conversion] [-t threshold] [--json]\n"
+            "Families:", argv0);
+    for (size_t i = 0; i < BENCH_FAMILY_COUNT; i++) fprintf(stderr, " %s", families[i].name);
+    fprintf(stderr, " (default: all)\n");
+}
+
+/* Whether a comma-separated list has this entry */
+static bool list_has(const char *list, const char *name) {
+    size_t name_len = strlen(name);
+    for (const char *p = list; *p; ) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len == name_len && strncmp(p, name, len) == 0) return true;
+        if (!end) break;
+        p = end + 1;
+    }
+    return false;
+}
+
+int main(int argc, char **argv) {
+    bench_config config = { 1024, 100 * 1024 * 1024, 3, 10.0, 1.25, false };
+    const char *family_list = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            family_list = argv[++i];
+        } else if (strcmp(argv[i], "--min") == 0 && i + 1 < argc) {
+            config.min_bytes = (size_t)atol(argv[++i]) * 1024;
+        } else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) {
+            config.max_bytes = (size_t)atol(argv[++i]) * 1024;
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            config.repeats = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            config.max_seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            config.threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0) {
+            config.json = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.repeats < 1) config.repeats = 1;
+    if (config.min_bytes == 0) config.min_bytes = 1024;
+    if (config.max_bytes < config.min_bytes) config.max_bytes = config.min_bytes;
+
+    if (family_list) {
+        for (const char *p = family_list; *p; ) {
+            const char *end = strchr(p, ',');
+            size_t len = end ? (size_t)(end - p) : strlen(p);
+            bool known = false;
+            for (size_t f = 0; f < BENCH_FAMILY_COUNT; f++) {
+                if (strlen(families[f].name) == len && strncmp(p, families[f].name, len) == 0) known = true;
+            }
+            if (!known) {
+                fprintf(stderr, "Unknown family '%.*s'\n", (int)len, p);
+                usage(argv[0]);
+                return 1;
+            }
+            p = end ? end + 1 : p + len;
+        }
+    }
+
+    char dir_template[] = "/tmp/apex-bench-scaling-XXXXXX";
+    char *tmp_dir = mkdtemp(dir_template);
+    if (!tmp_dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    if (!config.json) {
+        printf("Growth exponent of each stage (1 = linear, 2 = quadratic); flagged above %.2f\n\n",
+               config.threshold);
+        printf("| %-16s | %-30s | %8s | %12s | %10s | %-11s |\n", "Family", "Stage", "Exponent",
+               "Largest KB", "Time ms", "");
+        printf("|------------------|--------------------------------|----------|--------------|"
+               "------------|-------------|\n");
+        fflush(stdout);
+    }
+
+    int flagged = 0;
+    for (size_t f = 0; f < BENCH_FAMILY_COUNT; f++) {
+        if (family_list && !list_has(family_list, families[f].name)) continue;
+        flagged += bench_family_run(&families[f], &config, tmp_dir);
+        fflush(stdout);
+    }
+    rmdir(tmp_dir);
+
+    if (!config.json) {
+        printf("\n%d superlinear stage%s\n", flagged, flagged == 1 ? "" : "s");
+    }
+    return 0;
+}
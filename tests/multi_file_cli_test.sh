@@ -60,5 +60,192 @@ grep -q '^# Section 1\.1' "$COMBINE_OUT" || {
 
 echo "SUMMARY.md combine test passed."
 
+echo
+echo "== Testing batch mode (--output-dir, --jobs) =="
+
+BATCH_OUT="$TMPDIR/batch"
+"$APEX_BIN" --output-dir "$BATCH_OUT" -j 4 "$FIXTURES"
+
+for name in intro chapter1 section1_1 SUMMARY; do
+	[[ -f "$BATCH_OUT/$name.html" ]] || {
+		echo "batch: missing $name.html"
+		exit 1
+	}
+done
+"$APEX_BIN" "$FIXTURES/intro.md" | cmp -s - "$BATCH_OUT/intro.html" || {
+	echo "batch: intro.html differs from single-file output"
+	exit 1
+}
+
+if "$APEX_BIN" --output-dir "$BATCH_OUT" "$FIXTURES/intro.md" "$TMPDIR/missing.md" 2>/dev/null; then
+	echo "batch: expected failure exit status for a missing input"
+	exit 1
+fi
+
+# Inputs with the same name in different directories collide
+mkdir -p "$TMPDIR/dup/a" "$TMPDIR/dup/b"
+printf '# A\n' >"$TMPDIR/dup/a/readme.md"
+printf '# B\n' >"$TMPDIR/dup/b/readme.md"
+if "$APEX_BIN" --output-dir "$TMPDIR/dup-out" "$TMPDIR/dup/a/readme.md" "$TMPDIR/dup/b/readme.md" 2>/dev/null; then
+	echo "batch: expected failure for colliding output names"
+	exit 1
+fi
+[[ ! -e "$TMPDIR/dup-out/readme.html" ]] || {
+	echo "batch: colliding inputs should not be converted"
+	exit 1
+}
+
+# A project config next to the input applies as it does for a single file
+mkdir -p "$TMPDIR/proj/.apex"
+printf 'title: From Config\n' >"$TMPDIR/proj/.apex/config.yml"
+printf 'Body\n' >"$TMPDIR/proj/doc.md"
+(cd "$TMPDIR" && "$APEX_BIN" --output-dir "$TMPDIR/proj-out" -s "$TMPDIR/proj/doc.md")
+(cd "$TMPDIR" && "$APEX_BIN" -s "$TMPDIR/proj/doc.md") | cmp -s - "$TMPDIR/proj-out/doc.html" || {
+	echo "batch: per-directory project config not applied"
+	exit 1
+}
+
+# --bibliography resolves from each file's directory, with or without front matter
+for side in left right; do
+	mkdir -p "$TMPDIR/bib/$side"
+	printf '@book{key,\n  author = {Author %s},\n  title = {Title %s},\n  year = {2001}\n}\n' "$side" "$side" >"$TMPDIR/bib/$side/refs.bib"
+done
+printf 'See [@key].\n\n<!-- REFERENCES -->\n' >"$TMPDIR/bib/left/doc.md"
+printf -- '---\ntitle: Right\n---\n\nSee [@key].\n\n<!-- REFERENCES -->\n' >"$TMPDIR/bib/right/doc2.md"
+(cd "$TMPDIR" && "$APEX_BIN" --output-dir "$TMPDIR/bib-out" --bibliography refs.bib "$TMPDIR/bib/left/doc.md" "$TMPDIR/bib/right/doc2.md")
+for pair in left/doc right/doc2; do
+	(cd "$TMPDIR" && "$APEX_BIN" --bibliography refs.bib "$TMPDIR/bib/$pair.md") | cmp -s - "$TMPDIR/bib-out/${pair#*/}.html" || {
+		echo "batch: bibliography for $pair not resolved from its directory"
+		exit 1
+	}
+done
+grep -q "Author right" "$TMPDIR/bib-out/doc2.html" || {
+	echo "batch: front matter document lost its directory's bibliography"
+	exit 1
+}
+
+echo "Batch mode test passed."
+
+echo "== Testing --daemon with forwarding client =="
+
+DAEMON_SOCK="$TMPDIR/apex.sock"
+"$APEX_BIN" --daemon --socket "$DAEMON_SOCK" -j 2 2>/dev/null &
+DAEMON_PID=$!
+trap 'kill "$DAEMON_PID" 2>/dev/null || true; rm -rf "$TMPDIR"' EXIT
+
+for _ in $(seq 50); do
+	[[ -S "$DAEMON_SOCK" ]] && break
+	sleep 0.1
+done
+[[ -S "$DAEMON_SOCK" ]] || {
+	echo "daemon: socket was not created"
+	exit 1
+}
+
+"$APEX_BIN" "$FIXTURES/intro.md" >"$TMPDIR/local.html"
+APEX_SOCKET="$DAEMON_SOCK" "$APEX_BIN" "$FIXTURES/intro.md" >"$TMPDIR/daemon.html"
+cmp -s "$TMPDIR/local.html" "$TMPDIR/daemon.html" || {
+	echo "daemon: forwarded output differs from local output"
+	exit 1
+}
+
+"$APEX_BIN" -s --title Daemon "$FIXTURES/intro.md" >"$TMPDIR/local-standalone.html"
+"$APEX_BIN" --socket "$DAEMON_SOCK" -s --title Daemon "$FIXTURES/intro.md" >"$TMPDIR/daemon-standalone.html"
+cmp -s "$TMPDIR/local-standalone.html" "$TMPDIR/daemon-standalone.html" || {
+	echo "daemon: standalone output differs from local output"
+	exit 1
+}
+
+# Both conversions above were answered by the daemon, not a local fallback
+"$APEX_BIN" --socket "$DAEMON_SOCK" --daemon-status | grep -q "served=2" || {
+	echo "daemon: expected two conversions served by the daemon"
+	exit 1
+}
+
+# A title with a line break can't go in a header line: converted locally
+"$APEX_BIN" --socket "$DAEMON_SOCK" -s --title $'Two\nLines' "$FIXTURES/intro.md" >/dev/null
+"$APEX_BIN" --socket "$DAEMON_SOCK" --daemon-status | grep -q "served=2" || {
+	echo "daemon: multi-line title should not be forwarded"
+	exit 1
+}
+
+# The project config is found from the client's side, for files and stdin
+(cd "$TMPDIR" && "$APEX_BIN" --socket "$DAEMON_SOCK" -s "$TMPDIR/proj/doc.md") | cmp -s - "$TMPDIR/proj-out/doc.html" || {
+	echo "daemon: project config next to the input not applied"
+	exit 1
+}
+(cd "$TMPDIR/proj" && "$APEX_BIN" -s <doc.md) >"$TMPDIR/proj-stdin-local.html"
+(cd "$TMPDIR/proj" && "$APEX_BIN" --socket "$DAEMON_SOCK" -s <doc.md) | cmp -s - "$TMPDIR/proj-stdin-local.html" || {
+	echo "daemon: project config in the client's directory not applied to stdin"
+	exit 1
+}
+grep -q "From Config" "$TMPDIR/proj-stdin-local.html" || {
+	echo "daemon: expected the project config title"
+	exit 1
+}
+
+# -o through the daemon replaces the file via a temporary file, like a local -o
+mkdir -p "$TMPDIR/daemon-out"
+echo "old contents" >"$TMPDIR/daemon-out/doc.html"
+"$APEX_BIN" --socket "$DAEMON_SOCK" -o "$TMPDIR/daemon-out/doc.html" "$FIXTURES/intro.md"
+cmp -s "$TMPDIR/local.html" "$TMPDIR/daemon-out/doc.html" || {
+	echo "daemon: -o output differs from local output"
+	exit 1
+}
+if [[ "$(ls "$TMPDIR/daemon-out")" != "doc.html" ]]; then
+	echo "daemon: -o left a temporary file behind"
+	exit 1
+fi
+
+kill "$DAEMON_PID"
+wait "$DAEMON_PID" 2>/dev/null || true
+
+if "$APEX_BIN" --socket "$DAEMON_SOCK" --daemon-status 2>/dev/null; then
+	echo "daemon: status should fail with no daemon running"
+	exit 1
+fi
+
+# With the daemon gone the client converts locally
+APEX_SOCKET="$DAEMON_SOCK" "$APEX_BIN" "$FIXTURES/intro.md" | cmp -s - "$TMPDIR/local.html" || {
+	echo "daemon: local fallback output differs"
+	exit 1
+}
+
+echo "Daemon mode test passed."
+
+echo
+echo "== Testing --cache-dir =="
+CACHE_DIR="$TMPDIR/cache"
+"$APEX_BIN" --cache-dir "$CACHE_DIR" --cache-stats "$FIXTURES/intro.md" >"$TMPDIR/cached1.html" 2>"$TMPDIR/cache1.log"
+"$APEX_BIN" --cache-dir "$CACHE_DIR" --cache-stats "$FIXTURES/intro.md" >"$TMPDIR/cached2.html" 2>"$TMPDIR/cache2.log"
+cmp -s "$TMPDIR/local.html" "$TMPDIR/cached1.html" && cmp -s "$TMPDIR/local.html" "$TMPDIR/cached2.html" || {
+	echo "cache: cached output differs from uncached output"
+	exit 1
+}
+grep -q "0 hits, 1 misses" "$TMPDIR/cache1.log" || {
+	echo "cache: first run should miss"
+	exit 1
+}
+grep -q "1 hits, 0 misses" "$TMPDIR/cache2.log" || {
+	echo "cache: second run should hit"
+	exit 1
+}
+
+echo "Cache test passed."
+
+echo
+echo "== Testing --profile-json =="
+"$APEX_BIN" --profile-json "$FIXTURES/intro.md" >"$TMPDIR/profiled.html" 2>"$TMPDIR/profile.log"
+cmp -s "$TMPDIR/local.html" "$TMPDIR/profiled.html" || {
+	echo "profile: output differs from unprofiled output"
+	exit 1
+}
+grep -q '"stats":{"elapsed_ns":[0-9]*,.*"name":"parsing"' "$TMPDIR/profile.log" || {
+	echo "profile: missing statistics line"
+	exit 1
+}
+
+echo "Profile test passed."
+
 echo
 echo "All multi-file CLI tests passed."
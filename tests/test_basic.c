@@ -4,6 +4,7 @@
 
 #include "test_helpers.h"
 #include "apex/apex.h"
+#include "../src/feature_scan.h"
 #include <string.h>
 
 void test_basic_markdown(void) {
@@ -31,6 +32,44 @@ void test_basic_markdown(void) {
     assert_contains(html, "<ul>", "Unordered list");
     assert_contains(html, "<li>Item 1</li>", "List item");
     apex_free_string(html);
+
+    /* Feature sniffing: pairs are recognized across any trigger byte */
+    const char *sniff = "a {.x} (!idx) ^[n] b==c";
+    apex_feature_bits bits = apex_scan_features(sniff, strlen(sniff));
+    test_result((bits & APEX_FEATURE_IAL) && (bits & APEX_FEATURE_INDEX) &&
+                (bits & APEX_FEATURE_FOOTNOTE) && (bits & APEX_FEATURE_DOUBLE_EQUALS),
+                "Feature scan finds trigger pairs");
+    test_result(!(bits & (APEX_FEATURE_CRITIC | APEX_FEATURE_DOUBLE_COLON | APEX_FEATURE_COLON)),
+                "Feature scan reports no absent features");
+    test_result(apex_scan_features("plain text only.", 16) == 0, "Feature scan of plain prose is empty");
+    const char *tables = "<b>a | b</b>\n```table\n";
+    bits = apex_scan_features(tables, strlen(tables));
+    test_result((bits & APEX_FEATURE_PIPE) && (bits & APEX_FEATURE_LT) && (bits & APEX_FEATURE_FENCE),
+                "Feature scan finds table and HTML triggers");
+
+    /* A buffer reused at the same address must be rescanned once invalidated */
+    char reused[16] = "no triggers";
+    apex_feature_set fs;
+    apex_feature_set_init(&fs, reused);
+    strcpy(reused, "a | b");
+    apex_features_invalidate(&fs);
+    test_result(apex_features_any(&fs, reused, APEX_FEATURE_PIPE),
+                "Feature set rescans a reused buffer after invalidation");
+
+    /* A bit already seen answers without a rescan; exact queries rescan */
+    strcpy(reused, "plain");
+    apex_features_invalidate(&fs);
+    test_result(apex_features_any(&fs, reused, APEX_FEATURE_PIPE) && fs.stale,
+                "Feature set keeps a seen bit without rescanning");
+    test_result(apex_features_get(&fs, reused) == 0 && !fs.stale,
+                "Feature set rescans for exact bits");
+
+    /* Triggers past the first SIMD block and at the end of the text */
+    const char *long_prose = "Plain prose that runs on for well over one block. Then a|";
+    test_result(apex_scan_features(long_prose, strlen(long_prose)) == APEX_FEATURE_PIPE,
+                "Feature scan finds a trigger after whole blocks of prose");
+    test_result(apex_scan_features(long_prose, strlen(long_prose) - 1) == 0,
+                "Feature scan stops at its length");
     
     bool had_failures = suite_end(suite_failures);
     print_suite_title("Basic Markdown Tests", had_failures, false);
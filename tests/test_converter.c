@@ -0,0 +1,198 @@
+/**
+ * Converter Equivalence Tests
+ *
+ * Converts every fixture with one reused apex_converter per option set and
+ * checks each result against apex_markdown_to_html() with the same options.
+ * Each converter runs over the fixtures twice, so state left behind by one
+ * conversion (math and footnote extensions, the loaded bibliography) would
+ * show up as a difference in a later one.
+ */
+
+#include "test_helpers.h"
+#include "apex/apex.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define CONVERTER_MAX_FIXTURES 128
+#define CONVERTER_ROUNDS 2
+
+typedef struct {
+    char *paths[CONVERTER_MAX_FIXTURES];
+    size_t count;
+} converter_fixtures;
+
+static char *converter_read_file(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(fp);
+        return NULL;
+    }
+    char *buf = malloc((size_t)size + 1);
+    if (buf) {
+        size_t n = fread(buf, 1, (size_t)size, fp);
+        buf[n] = '\0';
+    }
+    fclose(fp);
+    return buf;
+}
+
+static int converter_path_cmp(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Collect every .md file under dir */
+static void converter_collect(converter_fixtures *fixtures, const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            converter_collect(fixtures, path);
+            continue;
+        }
+        size_t len = strlen(path);
+        if (len > 3 && strcmp(path + len - 3, ".md") == 0 &&
+            fixtures->count < CONVERTER_MAX_FIXTURES) {
+            fixtures->paths[fixtures->count++] = strdup(path);
+        }
+    }
+    closedir(d);
+}
+
+/* Citations, math and footnotes in one document */
+static const char *converter_inline_doc =
+    "# Equivalence\n"
+    "\n"
+    "See [@doe99] and [@smith2000, p. 4] for $e^{i\\pi} + 1 = 0$.[^n]\n"
+    "\n"
+    "$$\n"
+    "\\int_0^1 x\\,dx\n"
+    "$$\n"
+    "\n"
+    "[^n]: A note with $x^2$.\n"
+    "\n"
+    "| Left | Right |\n"
+    "|------|-------|\n"
+    "| :centered: | plain |\n"
+    "\n"
+    "<!-- REFERENCES -->\n";
+
+/* Convert every input with a reused converter and compare with one-shot
+ * conversions. With doc_options, the converter is created from options
+ * and each input is converted with doc_options. */
+static void converter_check(const apex_options *options, const apex_options *doc_options,
+                            char **docs, const char **labels, size_t count, const char *name) {
+    const apex_options *effective = doc_options ? doc_options : options;
+    char **expected = calloc(count, sizeof(char *));
+    if (!expected) return;
+    for (size_t i = 0; i < count; i++) {
+        if (docs[i]) expected[i] = apex_markdown_to_html(docs[i], strlen(docs[i]), effective);
+    }
+
+    apex_converter *converter = apex_converter_new(options);
+    test_resultf(converter != NULL, "Converter: create %s converter", name);
+    if (converter) {
+        int mismatches = 0;
+        for (int round = 0; round < CONVERTER_ROUNDS; round++) {
+            for (size_t i = 0; i < count; i++) {
+                if (!docs[i]) continue;
+                char *actual = doc_options
+                    ? apex_converter_convert_with_options(converter, docs[i], strlen(docs[i]), doc_options)
+                    : apex_converter_convert(converter, docs[i], strlen(docs[i]));
+                if (!expected[i] || !actual || strcmp(expected[i], actual) != 0) {
+                    if (mismatches == 0) {
+                        test_resultf(false, "Converter: %s output for %s differs (round %d)",
+                                     name, labels[i], round + 1);
+                    }
+                    mismatches++;
+                }
+                apex_free_string(actual);
+            }
+        }
+        test_resultf(mismatches == 0,
+                     "Converter: %s converter matches apex_markdown_to_html over %zu inputs x %d rounds",
+                     name, count, CONVERTER_ROUNDS);
+        apex_converter_free(converter);
+    }
+
+    for (size_t i = 0; i < count; i++) apex_free_string(expected[i]);
+    free(expected);
+}
+
+void test_converter_equivalence(void) {
+    int suite_failures = suite_start();
+    print_suite_title("Converter Equivalence Tests", false, true);
+
+    converter_fixtures fixtures = {0};
+    converter_collect(&fixtures, "tests/fixtures");
+    test_resultf(fixtures.count > 0, "Converter: found %zu fixtures", fixtures.count);
+    qsort(fixtures.paths, fixtures.count, sizeof(char *), converter_path_cmp);
+
+    size_t count = fixtures.count + 1;
+    char **docs = calloc(count, sizeof(char *));
+    const char **labels = calloc(count, sizeof(char *));
+    if (docs && labels) {
+        for (size_t i = 0; i < fixtures.count; i++) {
+            docs[i] = converter_read_file(fixtures.paths[i]);
+            labels[i] = fixtures.paths[i];
+        }
+        docs[fixtures.count] = strdup(converter_inline_doc);
+        labels[fixtures.count] = "inline citations and math";
+
+        const char *bib_files[] = { "tests/test_refs.bib", NULL };
+        const apex_mode_t modes[] = {
+            APEX_MODE_UNIFIED, APEX_MODE_MULTIMARKDOWN, APEX_MODE_GFM, APEX_MODE_COMMONMARK
+        };
+        const char *mode_names[] = { "unified", "multimarkdown", "gfm", "commonmark" };
+
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            apex_options options = apex_options_for_mode(modes[m]);
+            converter_check(&options, NULL, docs, labels, count, mode_names[m]);
+        }
+
+        /* Bibliography, math and footnotes loaded once and shared by every conversion */
+        apex_options options = apex_options_for_mode(APEX_MODE_UNIFIED);
+        options.enable_citations = true;
+        options.enable_math = true;
+        options.enable_footnotes = true;
+        options.bibliography_files = (char **)bib_files;
+        converter_check(&options, NULL, docs, labels, count, "bibliography and math");
+
+        /* Per-document options that change what the converter loaded: the
+         * bibliography and tables extension must follow the document */
+        apex_options plain = apex_options_for_mode(APEX_MODE_UNIFIED);
+        plain.enable_citations = true;
+        apex_options with_bib = plain;
+        with_bib.bibliography_files = (char **)bib_files;
+        with_bib.per_cell_alignment = !plain.per_cell_alignment;
+        converter_check(&plain, &with_bib, docs, labels, count, "per-document bibliography");
+        converter_check(&with_bib, &plain, docs, labels, count, "per-document no bibliography");
+
+        const char *base_bib[] = { "test_refs.bib", NULL };
+        apex_options based = with_bib;
+        based.bibliography_files = (char **)base_bib;
+        based.base_directory = "tests";
+        converter_check(&with_bib, &based, docs, labels, count, "per-document base directory");
+
+        for (size_t i = 0; i < count; i++) free(docs[i]);
+    }
+    free(docs);
+    free(labels);
+    for (size_t i = 0; i < fixtures.count; i++) free(fixtures.paths[i]);
+
+    bool had_failures = suite_end(suite_failures);
+    print_suite_title("Converter Equivalence Tests", had_failures, false);
+}
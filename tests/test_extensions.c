@@ -1392,6 +1392,46 @@ void test_definition_lists(void) {
     assert_contains(html, "<a href=\"https://example.com\"", "Reference link in definition has href");
     apex_free_string(html);
 
+    /* Reference definitions are gathered once: earlier, later, titled on the next line, not in code */
+    const char *many_refs = "[one]: https://one.example\n\n"
+                            "First [one]\n: Uses [two] and [three]\n\n"
+                            "Second\n: Uses [fake]\n\n"
+                            "```\n[fake]: https://fake.example\n```\n\n"
+                            "[two]: https://two.example\n"
+                            "[three]:\n  https://three.example\n  \"Three title\"\n";
+    html = apex_markdown_to_html(many_refs, strlen(many_refs), &opts);
+    assert_contains(html, "<a href=\"https://one.example\">one</a>", "Term resolves reference defined before");
+    assert_contains(html, "<a href=\"https://two.example\">two</a>", "Definition resolves reference defined after");
+    assert_contains(html, "<a href=\"https://three.example\" title=\"Three title\">three</a>",
+                    "Definition resolves multi-line reference");
+    assert_not_contains(html, "https://fake.example\">", "Reference inside code block is not used");
+    apex_free_string(html);
+
+    /* Definitions inside list items count; indented code does not */
+    const char *container_refs = "- [item]: https://item.example\n\n"
+                                 "Text\n\n"
+                                 "    [code]: https://code.example\n\n"
+                                 "Term\n: Uses [item] and [code]\n";
+    html = apex_markdown_to_html(container_refs, strlen(container_refs), &opts);
+    assert_contains(html, "<a href=\"https://item.example\">item</a>", "Definition resolves reference in list item");
+    assert_not_contains(html, "https://code.example\">", "Reference in indented code is not used");
+    apex_free_string(html);
+
+    /* Definitions right after a setext heading, a thematic break or an HTML block */
+    const char *block_end_refs = "Title\n=====\n[setext]: https://setext.example\n\n"
+                                 "Sub\n---\n[dash]: https://dash.example\n\n"
+                                 "***\n[rule]: https://rule.example\n\n"
+                                 "<!-- note -->\n[html]: https://html.example\n\n"
+                                 "<pre>\n\n[inside]: https://inside.example\n</pre>\n\n"
+                                 "Term\n: Uses [setext], [dash], [rule], [html] and [inside]\n";
+    html = apex_markdown_to_html(block_end_refs, strlen(block_end_refs), &opts);
+    assert_contains(html, "<a href=\"https://setext.example\">setext</a>", "Definition after a setext heading");
+    assert_contains(html, "<a href=\"https://dash.example\">dash</a>", "Definition after a --- underline");
+    assert_contains(html, "<a href=\"https://rule.example\">rule</a>", "Definition after a thematic break");
+    assert_contains(html, "<a href=\"https://html.example\">html</a>", "Definition after an HTML block");
+    assert_not_contains(html, "https://inside.example\">", "Reference inside an HTML block is not used");
+    apex_free_string(html);
+
     /* Test definition list with blank line between term and first definition */
     const char *blank_before = "Term\n\n: definition 1\n: definition 2";
     html = apex_markdown_to_html(blank_before, strlen(blank_before), &opts);
@@ -1803,6 +1843,23 @@ void test_html_markdown_attributes(void) {
     assert_not_contains(html, "See footnote[^note]", "markdown=\"1\" footnote not left literal");
     apex_free_string(html);
 
+    /* Many blocks share one definition index and parser; labels match case-insensitively */
+    const char *many_blocks =
+        "<div markdown=\"1\">\n*First* uses [one][Ref One].\n</div>\n\n"
+        "<div markdown=\"1\">\n<div markdown=\"1\">\n*Nested* uses [two][ref  two].\n</div>\n</div>\n\n"
+        "<div markdown=\"1\">\n[Local][three]\n\n[three]: https://example.com/local\n</div>\n\n"
+        "[ref one]: https://example.com/one\n"
+        "[Ref Two]: https://example.com/two\n"
+        "[three]: https://example.com/global\n";
+    html = apex_markdown_to_html(many_blocks, strlen(many_blocks), &opts);
+    assert_contains(html, "<em>First</em> uses <a href=\"https://example.com/one\">one</a>",
+                    "markdown=\"1\" first block resolves its reference");
+    assert_contains(html, "<em>Nested</em> uses <a href=\"https://example.com/two\">two</a>",
+                    "markdown=\"1\" nested block resolves its reference");
+    assert_contains(html, "<a href=\"https://example.com/local\">Local</a>",
+                    "markdown=\"1\" definition inside the block wins");
+    apex_free_string(html);
+
     bool had_failures = suite_end(suite_failures);
     print_suite_title("HTML Markdown Attributes Tests", had_failures, false);
 }
@@ -2220,6 +2277,34 @@ void test_abbreviations(void) {
         test_result(false, "Allocate issue #31 long-line regression input");
     }
 
+    /* Code, tags, and partial words are left alone */
+    const char *protected_doc = "*[API]: Application Programming Interface\n\n"
+                                "The [API](API.html) and `API` and APIs.";
+    html = apex_markdown_to_html(protected_doc, strlen(protected_doc), &opts);
+    assert_contains(html, "href=\"API.html\"", "Abbreviation not replaced inside attribute");
+    assert_contains(html, "<code>API</code>", "Abbreviation not replaced inside code");
+    assert_contains(html, "APIs", "Abbreviation not replaced inside longer word");
+    assert_contains(html, "<abbr title=\"Application Programming Interface\">API</abbr></a>", "Abbreviation replaced in link text");
+    apex_free_string(html);
+
+    /* Many definitions, including ones that share prefixes and suffixes */
+    char *many_abbrs = malloc(32 * 300 + 64);
+    if (many_abbrs) {
+        char *p = many_abbrs;
+        for (int i = 0; i < 300; i++) {
+            p += snprintf(p, 32, "*[AB%dX]: Expansion %d\n", i, i);
+        }
+        strcpy(p, "\nAB1X, AB10X, AB100X and AB299X but not AB1.");
+        html = apex_markdown_to_html(many_abbrs, strlen(many_abbrs), &opts);
+        assert_contains(html, "<abbr title=\"Expansion 1\">AB1X</abbr>", "Shortest of many abbreviations");
+        assert_contains(html, "<abbr title=\"Expansion 10\">AB10X</abbr>", "Prefix-sharing abbreviation");
+        assert_contains(html, "<abbr title=\"Expansion 100\">AB100X</abbr>", "Longest prefix-sharing abbreviation");
+        assert_contains(html, "<abbr title=\"Expansion 299\">AB299X</abbr>", "Last of many abbreviations");
+        assert_contains(html, "not AB1.", "Undefined prefix left alone");
+        apex_free_string(html);
+        free(many_abbrs);
+    }
+
     bool had_failures = suite_end(suite_failures);
     print_suite_title("Abbreviations Tests", had_failures, false);
 }
@@ -2391,6 +2476,15 @@ void test_emoji(void) {
     assert_contains(html, ":rocket:", "Second emoji preserved in indented block");
     apex_free_string(html);
 
+    /* Autocorrect finds the closest name; names too far from any emoji are left alone */
+    apex_options unified = apex_options_for_mode(APEX_MODE_UNIFIED);
+    const char *typos = "Launch :rockett: and :thumbsupp: but not :qqqqqqqqqqqqqqqq:";
+    html = apex_markdown_to_html(typos, strlen(typos), &unified);
+    assert_contains(html, "🚀", "Autocorrect fixes a one-letter typo");
+    assert_contains(html, "👍", "Autocorrect fixes a trailing extra letter");
+    assert_contains(html, ":qqqqqqqqqqqqqqqq:", "Autocorrect leaves distant names alone");
+    apex_free_string(html);
+
     bool had_failures = suite_end(suite_failures);
     print_suite_title("Emoji Tests", had_failures, false);
 }
@@ -3158,6 +3252,20 @@ void test_insert_syntax(void) {
     assert_contains(html, "class=\"class1 class2\"", "Insert with multiple classes");
     apex_free_string(html);
 
+    /* Test insert whose IAL closes on a later line */
+    const char *split_ial = "Text ++inserted++{: .class1\n.class2} here\n\nNext ++one++\n";
+    html = apex_markdown_to_html(split_ial, strlen(split_ial), &opts);
+    assert_contains(html, "class=\"class1 class2\">inserted</ins>", "Insert with IAL closed on a later line");
+    assert_contains(html, "<ins>one</ins>", "Insert after a multi-line IAL");
+    apex_free_string(html);
+
+    /* Test insert with an IAL that never closes */
+    const char *open_ial = "Text ++inserted++{: .class\nand ++more++\n";
+    html = apex_markdown_to_html(open_ial, strlen(open_ial), &opts);
+    assert_contains(html, "<ins>inserted</ins>{: .class", "Unclosed IAL is left as text");
+    assert_contains(html, "<ins>more</ins>", "Insert after an unclosed IAL");
+    apex_free_string(html);
+
     /* Test insert does not interfere with CriticMarkup */
     opts.enable_critic_markup = true;
     opts.critic_mode = 2;  /* CRITIC_MARKUP */
@@ -3191,6 +3299,14 @@ void test_insert_syntax(void) {
     assert_contains(html, "<em>italic</em>", "Markdown inside insert with IAL processed");
     apex_free_string(html);
 
+    /* Highlights and inserts share one pass; code state carries across lines */
+    const char *fused = "==marked== and ++added++\n\n```\n==code== ++code++\n```\n\n++after++ ==fence==";
+    html = apex_markdown_to_html(fused, strlen(fused), &opts);
+    assert_contains(html, "<mark>marked</mark> and <ins>added</ins>", "Highlight and insert on one line");
+    assert_contains(html, "==code== ++code++", "Neither converted in fenced code");
+    assert_contains(html, "<ins>after</ins> <mark>fence</mark>", "Both converted after the fence");
+    apex_free_string(html);
+
     bool had_failures = suite_end(suite_failures);
     print_suite_title("Insert Syntax Tests", had_failures, false);
 }
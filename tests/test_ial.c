@@ -4,7 +4,9 @@
 
 #include "test_helpers.h"
 #include "apex/apex.h"
+#include "../src/attr_pool.h"
 #include <string.h>
+#include <stdlib.h>
 
 void test_ial(void) {
     int suite_failures = suite_start();
@@ -168,6 +170,71 @@ void test_ial(void) {
     assert_not_contains(html, "<p>{: .lead }</p>", "Fenced div IAL: IAL paragraph removed");
     apex_free_string(html);
 
+    /* Attributes attach to their own node, not to earlier tags of the same name */
+    const char *code_after_block = "```\nblock\n```\n\nUse `code`{:.k} here.";
+    html = apex_markdown_to_html(code_after_block, strlen(code_after_block), &opts);
+    assert_contains(html, "<pre><code>block", "Inline code IAL: code block untouched");
+    assert_contains(html, "<code class=\"k\">code</code>", "Inline code IAL: applied to inline code");
+    apex_free_string(html);
+
+    const char *same_text = "Same\n{: .first}\n\nSame\n{: .second}";
+    html = apex_markdown_to_html(same_text, strlen(same_text), &opts);
+    assert_contains(html, "<p class=\"first\">Same</p>\n<p class=\"second\">Same</p>", "Block IAL: identical paragraphs keep their own attributes");
+    apex_free_string(html);
+
+    /* Attributes inside footnote definitions */
+    const char *footnote_ial = "Text[^n].\n\n[^n]: Noted.\n    {: .x}\n\n    Second ![pic](p.png){: width=\"40\"}";
+    html = apex_markdown_to_html(footnote_ial, strlen(footnote_ial), &opts);
+    assert_contains(html, "<p class=\"x\">Noted.</p>", "Footnote IAL: class on footnote paragraph");
+    assert_contains(html, "width=\"40\"", "Footnote IAL: image attributes inside footnote");
+    assert_contains(html, "footnote-backref", "Footnote IAL: backref still rendered");
+    assert_not_contains(html, "{: .x}", "Footnote IAL: IAL removed");
+    apex_free_string(html);
+
+    /* Typed view of serialized node attributes */
+    apex_attributes *typed = apex_attributes_from_html(" id=\"x\" class=\"a  b\" colspan=\"3\" data-id='y' data-remove");
+    test_result(typed && typed->id && strcmp(typed->id, "x") == 0, "Typed attributes: id parsed");
+    test_result(typed && typed->class_count == 2 && apex_attributes_has_class(typed, "b"),
+                "Typed attributes: class list split");
+    test_result(apex_attributes_get_int(typed, "colspan", 1) == 3 && apex_attributes_get_int(typed, "rowspan", 1) == 1,
+                "Typed attributes: integer values with fallback");
+    test_result(apex_attributes_get(typed, "data-id") && strcmp(apex_attributes_get(typed, "data-id"), "y") == 0,
+                "Typed attributes: data-id kept apart from id");
+    test_result(!apex_attributes_has(typed, "data-remove"), "Typed attributes: bare word is not a marker");
+    apex_free_attributes(typed);
+
+    /* Raw cell text left in user_data is not mistaken for spans */
+    typed = apex_attributes_from_html("rowspan and colspan");
+    test_result(typed && !apex_attributes_has(typed, "rowspan") && !apex_attributes_has(typed, "colspan"),
+                "Typed attributes: raw text naming spans has no span attributes");
+    apex_free_attributes(typed);
+    typed = apex_attributes_from_html(" data-remove=\"\"");
+    test_result(apex_attributes_has(typed, "data-remove"), "Typed attributes: empty value still present");
+    apex_free_attributes(typed);
+
+    /* IAL attributes stored on the node; merging keeps what the node has */
+    cmark_node *heading = cmark_node_new(CMARK_NODE_HEADING);
+    apex_node_set_attributes(heading, parse_ial_content("#first .a", 9));
+    apex_node_add_attributes(heading, parse_ial_content("#second .a .b data-x=1", 22));
+    const apex_attributes *stored = apex_node_attributes(heading);
+    test_result(stored && stored->id && strcmp(stored->id, "first") == 0,
+                "Node attributes: merge keeps the node's id");
+    test_result(stored && stored->class_count == 2 && apex_attributes_has_class(stored, "b") &&
+                apex_attributes_has(stored, "data-x"),
+                "Node attributes: merge adds missing classes and keys");
+    char *serialized = attributes_to_html(stored);
+    assert_contains(serialized, "id=\"first\" class=\"a b\" data-x=\"1\"", "Node attributes: serialized once in tag order");
+    free(serialized);
+    cmark_node_free(heading);
+
+    /* A heading with an IAL and a manual ID gets one id attribute */
+    const char *both_ids = "## Title [manual] {: .lead}";
+    html = apex_markdown_to_html(both_ids, strlen(both_ids), &opts);
+    assert_contains(html, "class=\"lead\"", "Node attributes: heading IAL class kept with manual ID");
+    test_result(html && strstr(html, "id=\"") && !strstr(strstr(html, "id=\"") + 4, "id=\""),
+                "Node attributes: heading has a single id attribute");
+    apex_free_string(html);
+
     bool had_failures = suite_end(suite_failures);
     print_suite_title("IAL Tests", had_failures, false);
 }
@@ -59,6 +59,23 @@ void test_marked_integration_features(void) {
     assert_contains(html, "class=\"poetry\"", "Poetry class applies to indented code blocks");
     apex_free_string(html);
 
+    /* Test that a later language block does not suppress poetry on an earlier plain block */
+    html = apex_markdown_to_html("```\nplain\n```\n\n```python\npass\n```", 33, &opts);
+    assert_contains(html, "<pre><code class=\"poetry\">plain", "Poetry class is decided per code block");
+    apex_free_string(html);
+
+    /* ...nor does an earlier one suppress it on a later plain block */
+    html = apex_markdown_to_html("```python\npass\n```\n\n```\nplain\n```", 33, &opts);
+    assert_contains(html, "<pre><code class=\"poetry\">plain", "Poetry class on a plain block after a language block");
+    apex_free_string(html);
+
+    /* Raw HTML comments are left alone */
+    const char *poetry_comment = "<!-- <pre><code>x</code></pre> -->\n\n    indented\n";
+    html = apex_markdown_to_html(poetry_comment, strlen(poetry_comment), &opts);
+    assert_contains(html, "<!-- <pre><code>x</code></pre> -->", "Poetry class is not added inside comments");
+    assert_contains(html, "<pre><code class=\"poetry\">indented", "Poetry class after a comment");
+    apex_free_string(html);
+
     /* Test markdown-in-html toggle */
     opts = apex_options_default();
     opts.enable_markdown_in_html = true;
@@ -214,6 +231,18 @@ void test_marked_integration_features(void) {
     assert_not_contains(html, "<mark class=\"critic\">", "Proofreader does not process code blocks");
     apex_free_string(html);
 
+    /* Test proofreader marker closed on a later line */
+    html = apex_markdown_to_html("Start ==spans\ntwo lines== end.", 30, &opts);
+    assert_contains(html, "<mark class=\"critic\">spans", "Proofreader highlight can span lines");
+    apex_free_string(html);
+
+    /* Test hashtags and proofreader running in the same pass */
+    opts.enable_hashtags = true;
+    html = apex_markdown_to_html("A #tag and ==mark== here.", 25, &opts);
+    assert_contains(html, "<span class=\"mkhashtag\">#tag</span>", "Hashtags run alongside proofreader");
+    assert_contains(html, "<mark class=\"critic\">mark</mark>", "Proofreader runs alongside hashtags");
+    apex_free_string(html);
+
     /* Test HR page break */
     opts = apex_options_default();
     opts.hr_page_break = true;
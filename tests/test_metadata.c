@@ -245,6 +245,13 @@ void test_mmd_metadata_keys(void) {
     assert_contains(html, "Header 1</h3>", "HTML Header Level: h1 content in h3 tag");
     apex_free_string(html);
 
+    /* Levels past h6 clamp; headers in code are left alone */
+    const char *clamp_doc = "Base Header Level: 3\n\n##### Deep\n\n    <h1>code</h1>\n";
+    html = apex_markdown_to_html(clamp_doc, strlen(clamp_doc), &opts);
+    assert_contains(html, "Deep</h6>", "Base Header Level: h5 clamps to h6");
+    assert_contains(html, "&lt;h1&gt;code&lt;/h1&gt;", "Base Header Level: code untouched");
+    apex_free_string(html);
+
     /* Test Language metadata in standalone document */
     opts.standalone = true;
     const char *language_doc = "Language: fr\n\n# Bonjour";
@@ -364,6 +371,61 @@ void test_mmd_metadata_keys(void) {
     assert_not_contains(html, "......", "MMD delimiter block: dot closer not rendered in body");
     apex_free_string(html);
 
+    /* Lookups ignore case and spaces; an exact match beats a space-only one */
+    char *meta_text = strdup("HTMLHeader: first\nHTML Header: second\nKey 150: value\n\nBody");
+    char *meta_ptr = meta_text;
+    apex_metadata_item *items = apex_extract_metadata_for_mode(&meta_ptr, APEX_MODE_MULTIMARKDOWN);
+    const char *meta_value = apex_metadata_get(items, "html header");
+    test_result(meta_value && strcmp(meta_value, "second") == 0, "Metadata get: case-insensitive exact match wins");
+    meta_value = apex_metadata_get(items, "htmlheader");
+    test_result(meta_value && strcmp(meta_value, "first") == 0, "Metadata get: exact match on unspaced key");
+    meta_value = apex_metadata_get(items, "KEY150");
+    test_result(meta_value && strcmp(meta_value, "value") == 0, "Metadata get: normalized match");
+    test_result(apex_metadata_get(items, "missing") == NULL, "Metadata get: missing key");
+    apex_free_metadata(items);
+    free(meta_text);
+
+    /* Many keys */
+    size_t many_len = 300 * 32 + 16;
+    char *many_meta = malloc(many_len);
+    if (many_meta) {
+        char *w = many_meta;
+        for (int i = 0; i < 300; i++) {
+            w += snprintf(w, 32, "Key Number %d: v%d\n", i, i);
+        }
+        strcpy(w, "\nBody");
+        char *many_ptr = many_meta;
+        items = apex_extract_metadata_for_mode(&many_ptr, APEX_MODE_MULTIMARKDOWN);
+        bool all_found = true;
+        for (int i = 0; i < 300; i++) {
+            char key[32], expected[16];
+            snprintf(key, sizeof(key), "keynumber%d", i);
+            snprintf(expected, sizeof(expected), "v%d", i);
+            meta_value = apex_metadata_get(items, key);
+            if (!meta_value || strcmp(meta_value, expected) != 0) all_found = false;
+        }
+        test_result(all_found, "Metadata get: 300 keys all found");
+        apex_free_metadata(items);
+        free(many_meta);
+    }
+
+    /* A list built by hand has no index, even where an indexed list was just freed */
+    meta_text = strdup("Title: indexed\n\nBody");
+    meta_ptr = meta_text;
+    items = apex_extract_metadata_for_mode(&meta_ptr, APEX_MODE_MULTIMARKDOWN);
+    apex_free_metadata(items);
+    free(meta_text);
+    apex_metadata_item *hand = malloc(sizeof(apex_metadata_item));
+    if (hand) {
+        hand->key = strdup("Author");
+        hand->value = strdup("by hand");
+        hand->next = NULL;
+        meta_value = apex_metadata_get(hand, "author");
+        test_result(meta_value && strcmp(meta_value, "by hand") == 0, "Metadata get: list built by hand");
+        test_result(apex_metadata_get(hand, "title") == NULL, "Metadata get: no stale index for a reused address");
+        apex_free_metadata(hand);
+    }
+
     bool had_failures = suite_end(suite_failures);
     print_suite_title("MultiMarkdown Metadata Keys Tests", had_failures, false);
 }
@@ -624,6 +686,34 @@ void test_metadata_transforms(void) {
     assert_contains(html, "Hello", "Simple metadata replacement still works");
     apex_free_string(html);
 
+    /* References cached on the first text resolve against other metadata */
+    char *tpl_meta_a = strdup("Title: first post\nTags: x;y\n\nBody");
+    char *tpl_meta_b = strdup("Title: second\n\nBody");
+    char *tpl_ptr_a = tpl_meta_a;
+    char *tpl_ptr_b = tpl_meta_b;
+    apex_metadata_item *meta_a = apex_extract_metadata_for_mode(&tpl_ptr_a, APEX_MODE_MULTIMARKDOWN);
+    apex_metadata_item *meta_b = apex_extract_metadata_for_mode(&tpl_ptr_b, APEX_MODE_MULTIMARKDOWN);
+    const char *tpl_text =
+        "[%title:upper] / [%tags:split([;,]):join(+)] / [%title:replace(regex:[aeiou],_)] [%nope";
+    apex_metadata_cache *tpl_cache = apex_metadata_cache_new();
+    char *rendered = apex_metadata_replace_variables(tpl_text, meta_a, &opts, tpl_cache);
+    test_result(rendered && strcmp(rendered, "FIRST POST / x+y / f_rst p_st [%nope") == 0,
+                "Metadata references render transforms");
+    free(rendered);
+    rendered = apex_metadata_replace_variables(tpl_text, meta_b, &opts, tpl_cache);
+    test_result(rendered && strcmp(rendered, "SECOND / [%tags:split([;,]):join(+)] / s_c_nd [%nope") == 0,
+                "Cached metadata references keep missing keys");
+    free(rendered);
+    rendered = apex_metadata_replace_variables(tpl_text, meta_a, &opts, NULL);
+    test_result(rendered && strcmp(rendered, "FIRST POST / x+y / f_rst p_st [%nope") == 0,
+                "Metadata references render without a shared cache");
+    free(rendered);
+    apex_metadata_cache_free(tpl_cache);
+    apex_free_metadata(meta_a);
+    apex_free_metadata(meta_b);
+    free(tpl_meta_a);
+    free(tpl_meta_b);
+
     bool had_failures = suite_end(suite_failures);
     print_suite_title("Metadata Transforms Tests", had_failures, false);
 }
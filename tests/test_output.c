@@ -9,6 +9,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <dirent.h>
 
 void test_toc(void) {
     int suite_failures = suite_start();
@@ -585,6 +587,133 @@ void test_xhtml_output(void) {
     print_suite_title("XHTML Output Mode Tests", had_failures, false);
 }
 
+/* Sink that collects the output and counts the pieces it was given */
+typedef struct {
+    char *data;
+    size_t len;
+    int calls;
+    int fail_after;      /* Stop after this many pieces, or -1 */
+} stream_capture;
+
+static int stream_capture_write(void *user_data, const char *data, size_t len) {
+    stream_capture *capture = user_data;
+    if (capture->fail_after >= 0 && capture->calls >= capture->fail_after) return -1;
+    char *grown = realloc(capture->data, capture->len + len + 1);
+    if (!grown) return -1;
+    memcpy(grown + capture->len, data, len);
+    capture->data = grown;
+    capture->len += len;
+    capture->data[capture->len] = '\0';
+    capture->calls++;
+    return 0;
+}
+
+/* Stream a document and compare it with apex_markdown_to_html() */
+static void stream_check(const char *markdown, const apex_options *opts, int min_calls, const char *label) {
+    char *expected = apex_markdown_to_html(markdown, strlen(markdown), opts);
+    stream_capture capture = { NULL, 0, 0, -1 };
+    int rc = apex_markdown_to_sink(markdown, strlen(markdown), opts, stream_capture_write, &capture);
+    test_resultf(rc == 0 && expected && capture.data && strcmp(expected, capture.data) == 0,
+                 "Streaming: %s matches string output", label);
+    test_resultf(capture.calls >= min_calls, "Streaming: %s written in at least %d piece(s) (got %d)",
+                 label, min_calls, capture.calls);
+    apex_free_string(expected);
+    free(capture.data);
+}
+
+void test_streaming_output(void) {
+    int suite_failures = suite_start();
+    print_suite_title("Streaming Output Tests", false, true);
+
+    const char *doc =
+        "# Title\n\n"
+        "Some *text* and a table:\n\n"
+        "| a | b |\n"
+        "|---|---|\n"
+        "| 1 | 2 |\n\n"
+        "---\n\n"
+        "Done.\n";
+    const char *meta_doc =
+        "Title: Meta\n"
+        "HTML Header: <meta name=\"x\" content=\"y\">\n"
+        "HTML Footer: <p>footer</p>\n\n"
+        "# Heading\n\nBody.\n";
+    char *scripts[] = { "<script src=\"a.js\"></script>", NULL };
+
+    apex_options opts = apex_options_default();
+    stream_check(doc, &opts, 1, "fragment");
+
+    opts.standalone = true;
+    opts.document_title = "Stream";
+    stream_check(doc, &opts, 3, "standalone document");
+
+    opts.xhtml = true;
+    stream_check(doc, &opts, 3, "standalone XHTML");
+
+    opts = apex_options_for_mode(APEX_MODE_MULTIMARKDOWN);
+    opts.standalone = true;
+    opts.script_tags = scripts;
+    stream_check(meta_doc, &opts, 3, "metadata header, footer and scripts");
+
+    opts.standalone = false;
+    stream_check(doc, &opts, 2, "fragment with scripts");
+
+    opts = apex_options_default();
+    opts.standalone = true;
+    opts.pretty = true;
+    stream_check(doc, &opts, 1, "pretty document");
+
+    opts = apex_options_default();
+    opts.output_format = APEX_OUTPUT_MARKDOWN;
+    stream_check(doc, &opts, 1, "markdown output");
+
+    /* A long body is finished and written in segments */
+    size_t big_cap = 400 * 1024;
+    char *big = malloc(big_cap);
+    if (big) {
+        size_t big_len = 0;
+        for (int i = 0; big_len + 512 < big_cap; i++) {
+            big_len += (size_t)snprintf(big + big_len, big_cap - big_len,
+                                        "## Part %d\n\nText with a<br>break and ![i](x.png).\n\n"
+                                        "| a | b |\n|---|---|\n| %d | --- |\n\n"
+                                        "```\n<p>\n\n</p>\n```\n\n",
+                                        i, i);
+        }
+        opts = apex_options_default();
+        opts.standalone = true;
+        stream_check(big, &opts, 5, "long standalone body");
+        opts.xhtml = true;
+        stream_check(big, &opts, 5, "long standalone XHTML body");
+        free(big);
+    }
+
+    /* A sink that fails stops the conversion */
+    opts = apex_options_default();
+    opts.standalone = true;
+    stream_capture capture = { NULL, 0, 0, 1 };
+    int rc = apex_markdown_to_sink(doc, strlen(doc), &opts, stream_capture_write, &capture);
+    test_result(rc == -1 && capture.calls == 1, "Streaming: failing sink reports an error");
+    free(capture.data);
+
+    /* File descriptor output */
+    FILE *fp = tmpfile();
+    if (fp) {
+        rc = apex_markdown_to_fd(doc, strlen(doc), &opts, fileno(fp));
+        char *expected = apex_markdown_to_html(doc, strlen(doc), &opts);
+        char buffer[8192];
+        rewind(fp);
+        size_t n = fread(buffer, 1, sizeof(buffer) - 1, fp);
+        buffer[n] = '\0';
+        test_result(rc == 0 && expected && strcmp(buffer, expected) == 0,
+                    "Streaming: file descriptor output matches string output");
+        apex_free_string(expected);
+        fclose(fp);
+    }
+
+    bool had_failures = suite_end(suite_failures);
+    print_suite_title("Streaming Output Tests", had_failures, false);
+}
+
 /**
  * Test terminal and terminal256 output format: ANSI output, list markers, and terminal_width option.
  */
@@ -1510,6 +1639,70 @@ void test_citations(void) {
         apex_free_string(html);
     }
 
+    /* Parsed-bibliography cache: written on the first load, reused after,
+     * and ignored once the file changes */
+    {
+        char dir_template[] = "/tmp/apex-bib-cache-XXXXXX";
+        char *dir = mkdtemp(dir_template);
+        if (dir) {
+            char bib_path[1024], cache_dir[1024];
+            snprintf(bib_path, sizeof(bib_path), "%s/refs.bib", dir);
+            snprintf(cache_dir, sizeof(cache_dir), "%s/cache", dir);
+            FILE *fp = fopen(bib_path, "w");
+            if (fp) {
+                fputs("@book{cached1, title = {First Title}, author = {Ann Author}, year = {2001}}\n", fp);
+                fclose(fp);
+            }
+
+            apex_options cached = apex_options_default();
+            cached.mode = APEX_MODE_UNIFIED;
+            cached.enable_citations = true;
+            const char *cached_bibs[] = { bib_path, NULL };
+            cached.bibliography_files = (char **)cached_bibs;
+            const char *cite_cached = "See [@cached1].";
+
+            html = apex_markdown_to_html(cite_cached, strlen(cite_cached), &cached);
+            char *uncached_html = html;
+            cached.bibliography_cache_dir = cache_dir;
+            html = apex_markdown_to_html(cite_cached, strlen(cite_cached), &cached);
+            test_result(html && uncached_html && strcmp(html, uncached_html) == 0,
+                        "Bibliography cache: first load matches uncached output");
+            apex_free_string(html);
+
+            size_t cache_files = 0;
+            DIR *d = opendir(cache_dir);
+            if (d) {
+                struct dirent *de;
+                while ((de = readdir(d))) {
+                    if (strstr(de->d_name, ".bibcache") && de->d_name[0] != '.') cache_files++;
+                }
+                closedir(d);
+            }
+            test_result(cache_files == 1, "Bibliography cache: one cache file written");
+
+            html = apex_markdown_to_html(cite_cached, strlen(cite_cached), &cached);
+            test_result(html && uncached_html && strcmp(html, uncached_html) == 0,
+                        "Bibliography cache: cached load matches uncached output");
+            apex_free_string(html);
+            apex_free_string(uncached_html);
+
+            fp = fopen(bib_path, "w");
+            if (fp) {
+                fputs("@book{cached1, title = {Edited Title}, author = {Ann Author}, year = {2001}}\n", fp);
+                fclose(fp);
+            }
+            html = apex_markdown_to_html(cite_cached, strlen(cite_cached), &cached);
+            assert_contains(html, "Edited Title", "Bibliography cache: edited file is parsed again");
+            apex_free_string(html);
+
+            char rm_cmd[1200];
+            snprintf(rm_cmd, sizeof(rm_cmd), "rm -rf '%s'", dir);
+            system(rm_cmd);
+        } else {
+            test_result(false, "Bibliography cache: create temp directory");
+        }
+    }
+
     bool had_failures = suite_end(suite_failures);
     print_suite_title("Citation and Bibliography Tests", had_failures, false);
 }
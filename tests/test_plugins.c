@@ -174,6 +174,19 @@ static void plugin_test_cb(void *vctx) {
     assert_contains(html, "SUPPORT_DIR=", "plugins: handler saw APEX_SUPPORT_DIR");
     assert_contains(html, "POST_RENDER_FILE=/tmp/apex-test-input.md", "plugins: post_render saw APEX_FILE_PATH");
 
+    /* A converter loads the same plugins once and must produce the same output, every time */
+    apex_converter *converter = apex_converter_new(&opts);
+    test_result(converter != NULL, "plugins: create converter");
+    if (converter) {
+        for (int round = 1; round <= 2; round++) {
+            char *reused = apex_converter_convert(converter, md, strlen(md));
+            test_resultf(html && reused && strcmp(html, reused) == 0,
+                         "plugins: converter round %d matches apex_markdown_to_html", round);
+            apex_free_string(reused);
+        }
+        apex_converter_free(converter);
+    }
+
     apex_free_string(html);
 }
 
@@ -0,0 +1,114 @@
+/**
+ * Render Cache Tests
+ *
+ * Converts through an apex_render_cache in a temporary directory and checks
+ * hits and misses: repeated input, changed options, an edited transcluded
+ * file, a second handle on the same directory, and options that can't be
+ * cached. Every result is compared with a direct conversion.
+ */
+
+#include "test_helpers.h"
+#include "apex/apex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void cache_write_file(const char *path, const char *text) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return;
+    fputs(text, fp);
+    fclose(fp);
+}
+
+/* Convert through the cache, compare with a direct conversion and check which counter moved */
+static void cache_check(apex_render_cache *cache, const char *markdown, const apex_options *options,
+                        const char *expect_counter, const char *label) {
+    apex_render_cache_stats before, after;
+    apex_render_cache_get_stats(cache, &before);
+
+    size_t len = strlen(markdown);
+    char *expected = apex_markdown_to_html(markdown, len, options);
+    char *actual = apex_render_cache_convert(cache, NULL, markdown, len, options);
+    test_resultf(expected && actual && strcmp(expected, actual) == 0,
+                 "Render cache: %s matches direct conversion", label);
+    apex_free_string(expected);
+    apex_free_string(actual);
+
+    apex_render_cache_get_stats(cache, &after);
+    size_t moved = 0;
+    if (strcmp(expect_counter, "hit") == 0) moved = after.hits - before.hits;
+    else if (strcmp(expect_counter, "miss") == 0) moved = after.misses - before.misses;
+    else moved = after.bypassed - before.bypassed;
+    test_resultf(moved == 1, "Render cache: %s is a %s", label, expect_counter);
+}
+
+void test_render_cache(void) {
+    int suite_failures = suite_start();
+    print_suite_title("Render Cache Tests", false, true);
+
+    char dir_template[] = "/tmp/apex-render-cache-XXXXXX";
+    char *dir = mkdtemp(dir_template);
+    if (!dir) {
+        test_result(false, "Render cache: create temp directory");
+        bool had_failures = suite_end(suite_failures);
+        print_suite_title("Render Cache Tests", had_failures, false);
+        return;
+    }
+
+    char cache_dir[1024], include_path[1024];
+    snprintf(cache_dir, sizeof(cache_dir), "%s/cache", dir);
+    snprintf(include_path, sizeof(include_path), "%s/part.md", dir);
+    cache_write_file(include_path, "Included *text*.\n");
+
+    apex_render_cache *cache = apex_render_cache_open(cache_dir, 0);
+    test_result(cache != NULL, "Render cache: open");
+    if (cache) {
+        apex_options options = apex_options_default();
+        options.base_directory = dir;
+        const char *doc = "# Title\n\nBefore\n\n<<[part.md]\n\nAfter\n";
+
+        cache_check(cache, doc, &options, "miss", "first conversion");
+        cache_check(cache, doc, &options, "hit", "repeated conversion");
+        cache_check(cache, "# Other\n", &options, "miss", "different input");
+
+        apex_options changed = options;
+        changed.generate_header_ids = !changed.generate_header_ids;
+        cache_check(cache, doc, &changed, "miss", "changed option");
+        cache_check(cache, doc, &options, "hit", "original option again");
+
+        /* Editing the transcluded file invalidates the entry */
+        cache_write_file(include_path, "Included text that was *edited*.\n");
+        cache_check(cache, doc, &options, "miss", "edited include");
+        cache_check(cache, doc, &options, "hit", "edited include again");
+
+        /* Terminal output isn't cached */
+        apex_options terminal = options;
+        terminal.output_format = APEX_OUTPUT_TERMINAL;
+        apex_render_cache_stats before, after;
+        apex_render_cache_get_stats(cache, &before);
+        char *out = apex_render_cache_convert(cache, NULL, doc, strlen(doc), &terminal);
+        apex_render_cache_get_stats(cache, &after);
+        test_result(out != NULL && after.bypassed == before.bypassed + 1,
+                    "Render cache: terminal output bypasses the cache");
+        apex_free_string(out);
+
+        apex_render_cache_close(cache);
+
+        /* A second handle sees entries stored by the first */
+        cache = apex_render_cache_open(cache_dir, 0);
+        test_result(cache != NULL, "Render cache: reopen");
+        if (cache) {
+            cache_check(cache, doc, &options, "hit", "entry from earlier handle");
+            apex_render_cache_close(cache);
+        }
+    }
+
+    char rm_cmd[1200];
+    snprintf(rm_cmd, sizeof(rm_cmd), "rm -rf '%s'", dir);
+    system(rm_cmd);
+
+    bool had_failures = suite_end(suite_failures);
+    print_suite_title("Render Cache Tests", had_failures, false);
+}
@@ -77,6 +77,7 @@ void test_advanced_footnotes(void);
 void test_standalone_output(void);
 void test_pretty_html(void);
 void test_xhtml_output(void);
+void test_streaming_output(void);
 void test_header_ids(void);
 void test_image_captions(void);
 void test_indices(void);
@@ -86,6 +87,12 @@ void test_marked_integration_features(void);
 void test_plugins_integration(void);
 void test_ast_json_parser(void);
 void test_escaping_repro(void);
+void test_concurrent_conversions(void);
+void test_parallel_parse(void);
+void test_incremental_session(void);
+void test_render_cache(void);
+void test_converter_equivalence(void);
+void test_conversion_stats(void);
 
 /**
  * Test suite registry
@@ -151,6 +158,7 @@ static test_suite suites[] = {
     { "standalone_output",             test_standalone_output },
     { "pretty_html",                   test_pretty_html },
     { "xhtml_output",                  test_xhtml_output },
+    { "streaming_output",              test_streaming_output },
     { "header_ids",                    test_header_ids },
     { "image_captions",                test_image_captions },
     { "image_embedding",               test_image_embedding },
@@ -164,6 +172,12 @@ static test_suite suites[] = {
     { "ast_json",                      test_ast_json_parser },
     { "escaping_repro",                test_escaping_repro },
     { "escaping",                      test_escaping_repro },
+    { "threads",                       test_concurrent_conversions },
+    { "parallel_parse",                test_parallel_parse },
+    { "session",                       test_incremental_session },
+    { "render_cache",                  test_render_cache },
+    { "converter",                     test_converter_equivalence },
+    { "stats",                         test_conversion_stats },
 };
 
 static const size_t suite_count = sizeof(suites) / sizeof(suites[0]);
@@ -0,0 +1,199 @@
+/**
+ * Incremental Session Tests
+ *
+ * Renders a document through apex_session while editing it and checks each
+ * result against a full apex_markdown_to_html() conversion, along with the
+ * number of sections the session had to convert again.
+ */
+
+#include "test_helpers.h"
+#include "apex/apex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SESSION_SECTIONS 40
+
+/* Build the test document; `edited` gets `edit` (or a different paragraph),
+ * `extra` is inserted after section 20 */
+static char *session_build_doc_edit(int edited, const char *edit, const char *extra, const char *tail) {
+    size_t cap = SESSION_SECTIONS * 512 + (extra ? strlen(extra) : 0) + (tail ? strlen(tail) : 0) +
+                 (edit ? strlen(edit) : 0) + 1;
+    char *doc = malloc(cap);
+    if (!doc) return NULL;
+    size_t used = 0;
+    for (int i = 0; i < SESSION_SECTIONS; i++) {
+        used += (size_t)snprintf(doc + used, cap - used,
+                                 "# Section %d\n"
+                                 "\n"
+                                 "Paragraph %d with *emphasis*, `code` and a [link][home]%s.\n"
+                                 "\n"
+                                 "- one\n"
+                                 "- two\n"
+                                 "\n"
+                                 "```\n"
+                                 "\n"
+                                 "# inside a fence %d\n"
+                                 "```\n"
+                                 "\n",
+                                 i, i, i == edited ? (edit ? edit : " that was edited") : "", i);
+        if (i == 20 && extra) {
+            used += (size_t)snprintf(doc + used, cap - used, "%s", extra);
+        }
+    }
+    if (tail) used += (size_t)snprintf(doc + used, cap - used, "%s", tail);
+    return doc;
+}
+
+static char *session_build_doc(int edited, const char *extra, const char *tail) {
+    return session_build_doc_edit(edited, NULL, extra, tail);
+}
+
+/* Render doc through the session and compare with a full conversion */
+static void session_check(apex_session *session, const apex_options *options, const char *doc,
+                          long expect_rendered, const char *label) {
+    size_t len = strlen(doc);
+    char *expected = apex_markdown_to_html(doc, len, options);
+    char *actual = apex_session_render(session, doc, len);
+    test_resultf(expected && actual && strcmp(expected, actual) == 0,
+                 "Session: %s matches full conversion", label);
+    if (expect_rendered >= 0) {
+        size_t rendered = apex_session_last_rendered(session);
+        test_resultf(rendered == (size_t)expect_rendered,
+                     "Session: %s converted %ld section(s) (got %zu)", label, expect_rendered, rendered);
+    }
+    apex_free_string(expected);
+    apex_free_string(actual);
+}
+
+void test_incremental_session(void) {
+    int suite_failures = suite_start();
+    print_suite_title("Incremental Session Tests", false, true);
+
+    const apex_mode_t modes[] = { APEX_MODE_UNIFIED, APEX_MODE_GFM };
+    const char *refdef = "[home]: https://example.com/\n\n";
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        apex_options options = apex_options_for_mode(modes[m]);
+        apex_session *session = apex_session_new(&options);
+        test_result(session != NULL, "Session: create");
+        if (!session) continue;
+
+        char *doc = session_build_doc(-1, NULL, NULL);
+        session_check(session, &options, doc, SESSION_SECTIONS, "first render");
+        session_check(session, &options, doc, 0, "unchanged text");
+        free(doc);
+
+        doc = session_build_doc(7, NULL, NULL);
+        session_check(session, &options, doc, 1, "edit in one section");
+        free(doc);
+
+        doc = session_build_doc(7, "# Inserted\n\nNew text.\n\n", NULL);
+        session_check(session, &options, doc, 1, "inserted section");
+        free(doc);
+
+        /* A new reference definition changes how every section parses */
+        doc = session_build_doc(7, "# Inserted\n\nNew text.\n\n", refdef);
+        session_check(session, &options, doc, SESSION_SECTIONS + 1, "new reference definition");
+        free(doc);
+
+        /* Same heading twice: Apex doesn't number repeated ids, so the
+         * section converts alone */
+        doc = session_build_doc(7, "# Section 3\n\nDuplicate heading.\n\n", refdef);
+        session_check(session, &options, doc, 1, "duplicate heading");
+        free(doc);
+
+        /* Abbreviation definitions apply to every section, like reference definitions */
+        const char *abbr_tail = "[home]: https://example.com/\n\n*[HTML]: Hyper Text Markup Language\n";
+        doc = session_build_doc(7, "# Abbr\n\nUses HTML.\n\n", abbr_tail);
+        session_check(session, &options, doc, -1, "abbreviation definition");
+        free(doc);
+
+        doc = session_build_doc(7, "# Abbr\n\nUses HTML again.\n\n", abbr_tail);
+        session_check(session, &options, doc, 1, "edit using an abbreviation");
+        free(doc);
+
+        /* The TOC section is converted again when a heading changes; GFM
+         * doesn't expand TOC markers */
+        const char *toc = "# Contents\n\n<!--TOC-->\n\n";
+        doc = session_build_doc(7, toc, "# Tail\n\nEnd.\n");
+        session_check(session, &options, doc, -1, "TOC marker");
+        free(doc);
+
+        doc = session_build_doc(-1, toc, "# Tail\n\nEnd.\n");
+        session_check(session, &options, doc, 1, "edit beside a TOC");
+        free(doc);
+
+        doc = session_build_doc(-1, toc, "# Tail renamed\n\nEnd.\n");
+        session_check(session, &options, doc, modes[m] == APEX_MODE_GFM ? 1 : 2, "heading listed in a TOC");
+        free(doc);
+
+        /* "Status:" without a value is text, not metadata */
+        char *body = session_build_doc(-1, NULL, NULL);
+        char *with_status = body ? malloc(strlen(body) + 16) : NULL;
+        if (with_status) {
+            snprintf(with_status, strlen(body) + 16, "Status:\n\n%s", body);
+            session_check(session, &options, with_status, -1, "colon on the first line");
+            size_t first = strlen("Status:\n\n");
+            char *edited = session_build_doc(7, NULL, NULL);
+            if (edited) {
+                snprintf(with_status + first, strlen(body) + 16 - first, "%s", edited);
+                session_check(session, &options, with_status, 1, "edit after a colon on the first line");
+                free(edited);
+            }
+        }
+        free(with_status);
+        free(body);
+
+        session_check(session, &options, "", -1, "empty document");
+
+        apex_session_free(session);
+    }
+
+    /* Footnotes: definitions are shared and numbers follow the references
+     * of earlier sections */
+    apex_options options = apex_options_for_mode(APEX_MODE_UNIFIED);
+    apex_session *session = apex_session_new(&options);
+    if (session) {
+        const char *notes = "# Notes\n\nText.[^n] More.[^m]\n\n[^n]: A note.\n\n[^m]: Another note.\n\n";
+        char *doc = session_build_doc(7, notes, refdef);
+        session_check(session, &options, doc, SESSION_SECTIONS + 1, "footnotes");
+        free(doc);
+
+        doc = session_build_doc(-1, notes, refdef);
+        session_check(session, &options, doc, 1, "edit beside footnotes");
+        free(doc);
+
+        /* Section 7 now references the note first: it, the notes section
+         * and the last section (with the list of notes) change */
+        doc = session_build_doc_edit(7, " citing[^m]", notes, refdef);
+        session_check(session, &options, doc, 3, "earlier footnote reference");
+        free(doc);
+        apex_session_free(session);
+    }
+
+    /* Citations: the bibliography section repeats the others' citations */
+    const char *bib_files[] = { "tests/test_refs.bib", NULL };
+    options.enable_citations = true;
+    options.bibliography_files = (char **)bib_files;
+    session = apex_session_new(&options);
+    if (session) {
+        const char *cites = "# Cites\n\nSee [@doe99] and @smith2000.\n\n";
+        char *doc = session_build_doc(7, cites, refdef);
+        session_check(session, &options, doc, -1, "citations");
+        free(doc);
+
+        doc = session_build_doc(-1, cites, refdef);
+        session_check(session, &options, doc, 1, "edit beside citations");
+        free(doc);
+
+        doc = session_build_doc_edit(7, " citing [@smith2000]", cites, refdef);
+        session_check(session, &options, doc, 2, "new citation");
+        free(doc);
+        apex_session_free(session);
+    }
+
+    bool had_failures = suite_end(suite_failures);
+    print_suite_title("Incremental Session Tests", had_failures, false);
+}
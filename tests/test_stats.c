@@ -0,0 +1,93 @@
+/**
+ * Conversion Statistics Tests
+ *
+ * Converts documents with apex_options.stats set and checks the totals,
+ * the per-stage entries and the JSON form.
+ */
+
+#include "test_helpers.h"
+#include "apex/apex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const apex_stage_stats *stats_find_stage(const apex_stats *stats, const char *name) {
+    for (size_t i = 0; i < stats->stage_count; i++) {
+        if (strcmp(stats->stages[i].name, name) == 0) return &stats->stages[i];
+    }
+    return NULL;
+}
+
+static int stats_count_bytes(void *user_data, const char *data, size_t len) {
+    (void)data;
+    *(size_t *)user_data += len;
+    return 0;
+}
+
+void test_conversion_stats(void) {
+    int suite_failures = suite_start();
+    print_suite_title("Conversion Statistics Tests", false, true);
+
+    const char *doc = "# Title\n\nSome *text* with ==highlights== and a [link](https://example.com).\n\n"
+                      "| a | b |\n|---|---|\n| 1 | 2 |\n";
+    size_t doc_len = strlen(doc);
+
+    apex_options opts = apex_options_default();
+    apex_stats stats;
+    memset(&stats, 0xff, sizeof(stats));
+    opts.stats = &stats;
+
+    char *html = apex_markdown_to_html(doc, doc_len, &opts);
+    test_result(html != NULL, "Stats: conversion succeeds");
+    if (html) {
+        test_result(stats.bytes_in == doc_len, "Stats: bytes_in is the input length");
+        test_result(stats.bytes_out == strlen(html), "Stats: bytes_out is the output length");
+        test_result(stats.elapsed_ns > 0, "Stats: total time recorded");
+        test_result(stats.stage_count > 0 && stats.stage_count <= APEX_STATS_MAX_STAGES,
+                    "Stats: stages recorded");
+
+        const apex_stage_stats *parsing = stats_find_stage(&stats, "parsing");
+        const apex_stage_stats *rendering = stats_find_stage(&stats, "rendering");
+        test_result(parsing && parsing->calls == 1, "Stats: parsing stage ran once");
+        test_result(parsing && parsing->cmark_allocations > 0, "Stats: parsing counts AST allocations");
+        test_result(rendering && rendering->bytes_in == 0 && rendering->bytes_out > 0,
+                    "Stats: rendering produces text from the tree");
+        test_result(stats.cmark_allocations >= (parsing ? parsing->cmark_allocations : 0),
+                    "Stats: total allocations cover the stages");
+
+        uint64_t stage_ns = 0;
+        for (size_t i = 0; i < stats.stage_count; i++) stage_ns += stats.stages[i].elapsed_ns;
+        test_result(stage_ns <= stats.elapsed_ns, "Stats: stage times fit in the total");
+        test_result(stats.subprocesses == 0 && stats.subprocess_ns == 0,
+                    "Stats: no subprocesses without plugins or highlighters");
+
+        char *json = apex_stats_to_json(&stats);
+        test_result(json != NULL, "Stats: JSON created");
+        if (json) {
+            assert_contains(json, "\"stages\":[{\"name\":\"", "Stats: JSON lists stages");
+            assert_contains(json, "\"name\":\"parsing\",\"calls\":1,", "Stats: JSON has the parsing stage");
+            test_result(json[strlen(json) - 1] == '}', "Stats: JSON object is closed");
+            apex_free_string(json);
+        }
+    }
+    apex_free_string(html);
+
+    /* Streaming: bytes_out counts what went to the sink */
+    opts.standalone = true;
+    size_t written = 0;
+    int rc = apex_markdown_to_sink(doc, doc_len, &opts, stats_count_bytes, &written);
+    test_result(rc == 0 && written > 0 && stats.bytes_out == written,
+                "Stats: streamed conversion reports bytes written");
+    test_result(stats_find_stage(&stats, "standalone_wrap") != NULL,
+                "Stats: standalone wrap is a stage");
+
+    /* Empty input still overwrites the previous numbers */
+    html = apex_markdown_to_html("", 0, &opts);
+    test_result(html && stats.stage_count == 0 && stats.bytes_out == 0,
+                "Stats: empty input resets statistics");
+    apex_free_string(html);
+
+    bool had_failures = suite_end(suite_failures);
+    print_suite_title("Conversion Statistics Tests", had_failures, false);
+}
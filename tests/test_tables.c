@@ -179,6 +179,38 @@ void test_advanced_tables(void) {
     assert_contains(html, "<tfoot>", "Tfoot: footer section opened");
     assert_contains(html, "F1", "Tfoot: footer content present");
     assert_not_contains(html, "===", "Tfoot: === marker row removed");
+    assert_contains(html, "</tbody>\n<tfoot>\n<tr>", "Tfoot: tbody closed before footer opens");
+    assert_contains(html, "</tfoot>\n</table>", "Tfoot: footer closed before table");
+    apex_free_string(html);
+
+    /* Spans, tfoot and caption are written while rendering, so they combine in one table */
+    const char *combined_table =
+        "[Totals]\n"
+        "\n"
+        "| H1 | H2 |\n"
+        "|----|----|\n"
+        "| A  | B  |\n"
+        "| ^^ | C  |\n"
+        "| === | === |\n"
+        "| Sum ||\n";
+    html = apex_markdown_to_html(combined_table, strlen(combined_table), &tfoot_opts);
+    assert_contains(html, "<figure class=\"table-figure\">", "Combined table: wrapped in figure");
+    assert_contains(html, "<figcaption>Totals</figcaption>", "Combined table: caption rendered");
+    assert_not_contains(html, "<p>[Totals]</p>", "Combined table: caption paragraph not rendered");
+    assert_not_contains(html, "data-caption", "Combined table: caption not left as an attribute");
+    assert_contains(html, "<td rowspan=\"2\">A</td>", "Combined table: rowspan applied");
+    assert_not_contains(html, "^^", "Combined table: rowspan marker removed");
+    assert_contains(html, "<tfoot>\n<tr>\n<td colspan=\"2\">Sum</td>", "Combined table: colspan inside tfoot");
+    apex_free_string(html);
+
+    /* Cell text naming a span or marker is content, not an attribute */
+    const char *span_words_table = "| H1 | H2 |\n|----|----|"
+                                   "\n| rowspan | colspan data-remove |"
+                                   "\n| A | B |";
+    html = apex_markdown_to_html(span_words_table, strlen(span_words_table), &opts);
+    assert_contains(html, "<td>rowspan</td>", "Cell text rowspan rendered as text");
+    assert_contains(html, "<td>colspan data-remove</td>", "Cell text colspan data-remove kept");
+    assert_not_contains(html, "<td rowspan>", "Cell text rowspan not used as an attribute");
     apex_free_string(html);
 
     /* Test colspan with consecutive pipes (|||) */
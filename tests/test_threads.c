@@ -0,0 +1,351 @@
+/**
+ * Concurrency Tests
+ *
+ * Converts the same documents on several threads at once and checks that
+ * every result matches the single-threaded output byte for byte.
+ */
+
+#include "test_helpers.h"
+#include "apex/apex.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THREAD_COUNT 8
+#define THREAD_ROUNDS 4
+
+typedef struct {
+    const char *label;
+    char *markdown;
+    apex_options options;
+    char *expected;
+} thread_case;
+
+typedef struct {
+    thread_case *cases;
+    size_t case_count;
+    const apex_converter *converter;  /* Shared by all threads, or NULL */
+    int mismatches;
+} thread_job;
+
+/* Exercises the stages that used to keep state in globals */
+static const char *threads_inline_doc =
+    "# Concurrency\n"
+    "\n"
+    "\\{\\{TOC\\}\\} stays literal.\n"
+    "\n"
+    "{{TOC}}\n"
+    "\n"
+    "## Table\n"
+    "\n"
+    "| Left | Right |\n"
+    "|------|------:|\n"
+    "| :centered: | value |\n"
+    "| spans || \n"
+    "\n"
+    "> [!NOTE] Callout\n"
+    "> body\n"
+    "\n"
+    "Term\n"
+    ": Definition with ==highlight== and ^sup^ and {++insert++}.\n"
+    "\n"
+    "A #hashtag, a [[Wiki Link]] and a footnote.[^1]\n"
+    "\n"
+    "~~struck~~ text, $x^2$ inline math and www.example.com autolinked.\n"
+    "\n"
+    "[^1]: The note.\n";
+
+static char *threads_read_file(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(fp);
+        return NULL;
+    }
+    char *buf = malloc((size_t)size + 1);
+    if (buf) {
+        size_t n = fread(buf, 1, (size_t)size, fp);
+        buf[n] = '\0';
+    }
+    fclose(fp);
+    return buf;
+}
+
+static void *threads_worker(void *arg) {
+    thread_job *job = (thread_job *)arg;
+    for (int round = 0; round < THREAD_ROUNDS; round++) {
+        for (size_t i = 0; i < job->case_count; i++) {
+            thread_case *tc = &job->cases[i];
+            size_t len = strlen(tc->markdown);
+            char *html = job->converter
+                ? apex_converter_convert(job->converter, tc->markdown, len)
+                : apex_markdown_to_html(tc->markdown, len, &tc->options);
+            if (!html || strcmp(html, tc->expected) != 0) {
+                job->mismatches++;
+            }
+            apex_free_string(html);
+        }
+    }
+    return NULL;
+}
+
+/* Strikethrough, math and autolinks register inline trigger characters in
+ * cmark's process-wide tables, so every input carries all three */
+static const char *threads_inline_triggers =
+    "\n\n~~gone~~ and $a+b$ and https://example.com/x and ~~more~~ $$c$$\n";
+
+static char *threads_with_triggers(char *markdown) {
+    if (!markdown) return NULL;
+    size_t len = strlen(markdown);
+    size_t extra = strlen(threads_inline_triggers);
+    char *out = realloc(markdown, len + extra + 1);
+    if (!out) {
+        free(markdown);
+        return NULL;
+    }
+    memcpy(out + len, threads_inline_triggers, extra + 1);
+    return out;
+}
+
+static apex_options threads_options(apex_mode_t mode) {
+    apex_options options = apex_options_for_mode(mode);
+    options.enable_strikethrough = true;
+    options.enable_math = true;
+    options.enable_autolink = true;
+    return options;
+}
+
+/* Run job on THREAD_COUNT threads; returns the total number of mismatches */
+static int threads_run(thread_case *cases, size_t case_count, const apex_converter *converter) {
+    pthread_t threads[THREAD_COUNT];
+    thread_job jobs[THREAD_COUNT];
+    int started = 0;
+
+    for (int t = 0; t < THREAD_COUNT; t++) {
+        jobs[t].cases = cases;
+        jobs[t].case_count = case_count;
+        jobs[t].converter = converter;
+        jobs[t].mismatches = 0;
+        if (pthread_create(&threads[t], NULL, threads_worker, &jobs[t]) != 0) break;
+        started++;
+    }
+
+    int mismatches = 0;
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+        mismatches += jobs[t].mismatches;
+    }
+    return started == THREAD_COUNT ? mismatches : -1;
+}
+
+void test_concurrent_conversions(void) {
+    int suite_failures = suite_start();
+    print_suite_title("Concurrent Conversion Tests", false, true);
+
+    const char *fixtures[] = {
+        "tests/fixtures/comprehensive_test.md",
+        "tests/fixtures/speed.md",
+        "tests/fixtures/obsidian-callouts.md",
+    };
+    const size_t fixture_count = sizeof(fixtures) / sizeof(fixtures[0]);
+
+    thread_case cases[8];
+    size_t case_count = 0;
+
+    for (size_t i = 0; i < fixture_count; i++) {
+        char *markdown = threads_read_file(fixtures[i]);
+        if (!markdown) {
+            test_resultf(false, "Concurrency: read fixture %s", fixtures[i]);
+            continue;
+        }
+        cases[case_count].label = fixtures[i];
+        cases[case_count].markdown = threads_with_triggers(markdown);
+        cases[case_count].options = threads_options(APEX_MODE_UNIFIED);
+        case_count++;
+    }
+
+    cases[case_count].label = "inline unified";
+    cases[case_count].markdown = strdup(threads_inline_doc);
+    cases[case_count].options = threads_options(APEX_MODE_UNIFIED);
+    case_count++;
+
+    /* Same input with per-cell alignment off, run alongside the unified case */
+    cases[case_count].label = "inline multimarkdown";
+    cases[case_count].markdown = strdup(threads_inline_doc);
+    cases[case_count].options = threads_options(APEX_MODE_MULTIMARKDOWN);
+    case_count++;
+
+    cases[case_count].label = "inline gfm";
+    cases[case_count].markdown = strdup(threads_inline_doc);
+    cases[case_count].options = threads_options(APEX_MODE_GFM);
+    case_count++;
+
+    /* Serial reference output */
+    for (size_t i = 0; i < case_count; i++) {
+        thread_case *tc = &cases[i];
+        tc->expected = tc->markdown
+            ? apex_markdown_to_html(tc->markdown, strlen(tc->markdown), &tc->options)
+            : NULL;
+        test_resultf(tc->expected && strstr(tc->expected, "<del>") && strstr(tc->expected, "class=\"math inline\""),
+                     "Concurrency: serial reference for %s has strikethrough and math", tc->label);
+    }
+
+    int mismatches = threads_run(cases, case_count, NULL);
+    test_resultf(mismatches == 0,
+                 "Concurrency: %d threads x %d rounds of apex_markdown_to_html match serial output (%d mismatches)",
+                 THREAD_COUNT, THREAD_ROUNDS, mismatches);
+
+    /* One converter shared by every thread */
+    apex_converter *converter = apex_converter_new(&cases[0].options);
+    test_result(converter != NULL, "Concurrency: create shared converter");
+    if (converter) {
+        thread_case *shared = &cases[case_count - 3]; /* inline unified */
+        mismatches = threads_run(shared, 1, converter);
+        test_resultf(mismatches == 0,
+                     "Concurrency: shared apex_converter matches serial output (%d mismatches)",
+                     mismatches);
+        apex_converter_free(converter);
+    }
+
+    for (size_t i = 0; i < case_count; i++) {
+        free(cases[i].markdown);
+        apex_free_string(cases[i].expected);
+    }
+
+    bool had_failures = suite_end(suite_failures);
+    print_suite_title("Concurrent Conversion Tests", had_failures, false);
+}
+
+/* One section of the generated document; every construct a cut must not split */
+static const char *parallel_section_fmt =
+    "# Section %d\n"
+    "\n"
+    "See [the manual][manual], [later][late-%d] and [dup]. A *fine* paragraph with `code`.\n"
+    "\n"
+    "```\n"
+    "code before a blank\n"
+    "\n"
+    "# not a heading %d\n"
+    "```\n"
+    "\n"
+    "<!--\n"
+    "\n"
+    "# commented out %d\n"
+    "-->\n"
+    "\n"
+    "- item one\n"
+    "- item two\n"
+    "\n"
+    "  continued item\n"
+    "\n"
+    "| A | B |\n"
+    "|---|---|\n"
+    "| %d | x |\n"
+    "\n"
+    "## Details %d\n"
+    "\n"
+    "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore\n"
+    "et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut\n"
+    "aliquip ex ea commodo consequat. Duis aute irure dolor in reprehenderit in voluptate velit esse.\n"
+    "\n"
+    "[late-%d]: https://example.com/late/%d\n"
+    "[dup]: https://example.com/dup/%d\n"
+    "\n";
+
+void test_parallel_parse(void) {
+    int suite_failures = suite_start();
+    print_suite_title("Parallel Parse Tests", false, true);
+
+    const int sections = 120;
+    size_t cap = (size_t)sections * 1200 + 256;
+    char *generated = malloc(cap);
+    size_t used = 0;
+    if (generated) {
+        used += (size_t)snprintf(generated, cap, "[manual]: https://example.com/manual\n\n");
+        for (int i = 0; i < sections && used < cap; i++) {
+            used += (size_t)snprintf(generated + used, cap - used, parallel_section_fmt,
+                                     i, i, i, i, i, i, i, i, i);
+        }
+    }
+    test_result(generated != NULL && used < cap, "Parallel parse: generate document");
+
+    const char *labels[] = {
+        "generated",
+        "tests/fixtures/large_doc.md",
+        "tests/fixtures/comprehensive_test.md",
+    };
+    char *docs[] = {
+        generated,
+        threads_read_file(labels[1]),
+        threads_read_file(labels[2]),
+    };
+    const apex_mode_t modes[] = { APEX_MODE_UNIFIED, APEX_MODE_GFM, APEX_MODE_COMMONMARK };
+
+    for (size_t d = 0; d < sizeof(docs) / sizeof(docs[0]); d++) {
+        if (!docs[d]) {
+            test_resultf(false, "Parallel parse: read %s", labels[d]);
+            continue;
+        }
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            apex_options serial = apex_options_for_mode(modes[m]);
+            apex_options chunked = serial;
+            chunked.parse_threads = 4;
+
+            size_t len = strlen(docs[d]);
+            char *expected = apex_markdown_to_html(docs[d], len, &serial);
+            char *actual = apex_markdown_to_html(docs[d], len, &chunked);
+            test_resultf(expected && actual && strcmp(expected, actual) == 0,
+                         "Parallel parse: %s (mode %d) matches serial output", labels[d], (int)modes[m]);
+            apex_free_string(expected);
+            apex_free_string(actual);
+        }
+        free(docs[d]);
+    }
+
+    /* Chunks full of strikethrough and math, parsed on several threads by
+     * several conversions at once: one chunk finishing must not clear the
+     * ~ or $ triggers another chunk is still using */
+    const int trigger_sections = 1200;
+    size_t trigger_cap = (size_t)trigger_sections * 160 + 1;
+    char *trigger_doc = malloc(trigger_cap);
+    size_t trigger_used = 0;
+    for (int i = 0; trigger_doc && i < trigger_sections && trigger_used < trigger_cap; i++) {
+        trigger_used += (size_t)snprintf(trigger_doc + trigger_used, trigger_cap - trigger_used,
+                                         "# Part %d\n\n~~old %d~~ new, $x_%d^2$ and ~~a~~ $b$ ~~c~~ $d$.\n\n",
+                                         i, i, i);
+    }
+    test_result(trigger_doc && trigger_used < trigger_cap, "Parallel parse: generate trigger document");
+    if (trigger_doc && trigger_used < trigger_cap) {
+        thread_case trigger_case;
+        trigger_case.label = "triggers";
+        trigger_case.markdown = trigger_doc;
+        trigger_case.options = threads_options(APEX_MODE_UNIFIED);
+        trigger_case.expected = apex_markdown_to_html(trigger_doc, trigger_used, &trigger_case.options);
+        test_result(trigger_case.expected && strstr(trigger_case.expected, "<del>old 1199</del>"),
+                    "Parallel parse: serial trigger reference");
+
+        trigger_case.options.parse_threads = 8;
+        int mismatches = threads_run(&trigger_case, 1, NULL);
+        test_resultf(mismatches == 0,
+                     "Parallel parse: concurrent chunked parses keep strikethrough and math (%d mismatches)",
+                     mismatches);
+
+        /* Chunks of one converter share its math extension */
+        apex_converter *converter = apex_converter_new(&trigger_case.options);
+        char *converted = converter ? apex_converter_convert(converter, trigger_doc, trigger_used) : NULL;
+        test_result(converted && trigger_case.expected && strcmp(converted, trigger_case.expected) == 0,
+                    "Parallel parse: chunked converter parse matches serial output");
+        apex_free_string(converted);
+        apex_converter_free(converter);
+        apex_free_string(trigger_case.expected);
+    }
+    free(trigger_doc);
+
+    bool had_failures = suite_end(suite_failures);
+    print_suite_title("Parallel Parse Tests", had_failures, false);
+}
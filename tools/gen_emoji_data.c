@@ -0,0 +1,341 @@
+/**
+ * Emoji Table Generator
+ *
+ * Reads src/extensions/github-emoji.txt and writes emoji_data.h: the
+ * name-sorted complete_emoji_map plus two minimal perfect hashes over it,
+ * one from name to entry and one from unicode sequence to the preferred
+ * name (the longest, so "thumbsup" wins over "+1"). See emoji_hash.h for
+ * the hash scheme.
+ *
+ * Usage: gen_emoji_data github-emoji.txt emoji_data.h
+ *
+ * The CMake build runs this for every build; the checked-in
+ * src/extensions/emoji_data.h is the same output for builds without that
+ * step, and is refreshed by running the generator over it.
+ */
+
+#include "../src/extensions/emoji_hash.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char *name;
+    char *unicode;    /* NULL if image-based */
+    char *image_url;  /* NULL if unicode-based */
+} gen_entry;
+
+static char *dup_range(const char *start, const char *end) {
+    size_t len = (size_t)(end - start);
+    char *copy = malloc(len + 1);
+    if (!copy) {
+        fprintf(stderr, "gen_emoji_data: out of memory\n");
+        exit(1);
+    }
+    memcpy(copy, start, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+/* Cell text between two pipes, trimmed */
+static const char *cell(const char *p, const char **start, const char **end) {
+    const char *bar = strchr(p, '|');
+    if (!bar) return NULL;
+    const char *s = p;
+    const char *e = bar;
+    while (s < e && isspace((unsigned char)*s)) s++;
+    while (e > s && isspace((unsigned char)e[-1])) e--;
+    *start = s;
+    *end = e;
+    return bar + 1;
+}
+
+/*
+ * Rows look like "| :name: | glyph | \U1F604 |". The glyph cell is the
+ * emoji itself, an <img> tag for GitHub's image-only emoji, or the :name:
+ * again for emoji with neither (those are skipped).
+ */
+static bool parse_row(const char *line, gen_entry *entry) {
+    const char *p = strchr(line, '|');
+    const char *name_s, *name_e, *glyph_s, *glyph_e;
+    if (!p) return false;
+    p = cell(p + 1, &name_s, &name_e);
+    if (!p) return false;
+    p = cell(p, &glyph_s, &glyph_e);
+    if (!p) return false;
+    if (name_e - name_s < 3 || *name_s != ':' || name_e[-1] != ':') return false;
+
+    entry->unicode = NULL;
+    entry->image_url = NULL;
+    if (strncmp(glyph_s, "<img", 4) == 0) {
+        const char *src = strstr(glyph_s, "src=\"");
+        if (!src || src > glyph_e) return false;
+        src += 5;
+        const char *src_end = strchr(src, '"');
+        if (!src_end || src_end > glyph_e) return false;
+        entry->image_url = dup_range(src, src_end);
+    } else if (glyph_s < glyph_e && *glyph_s != ':') {
+        entry->unicode = dup_range(glyph_s, glyph_e);
+    } else {
+        return false;
+    }
+    entry->name = dup_range(name_s + 1, name_e - 1);
+    return true;
+}
+
+static int compare_entry(const void *a, const void *b) {
+    return strcmp(((const gen_entry *)a)->name, ((const gen_entry *)b)->name);
+}
+
+typedef struct {
+    size_t bucket;
+    size_t *members;
+    size_t count;
+} gen_bucket;
+
+static int compare_bucket_size(const void *a, const void *b) {
+    const gen_bucket *x = a, *y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return x->bucket < y->bucket ? -1 : x->bucket > y->bucket;
+}
+
+/*
+ * Hash and displace: place the largest buckets first, trying seeds until
+ * every key in the bucket lands on a free slot. slots[i] receives
+ * values[key] for the key placed in slot i.
+ */
+static bool build_perfect_hash(const char **keys, const size_t *values, size_t n, size_t bucket_count,
+                               uint16_t *seeds, size_t *slots) {
+    gen_bucket *buckets = calloc(bucket_count, sizeof(gen_bucket));
+    bool *used = calloc(n, sizeof(bool));
+    size_t *tried = malloc(n * sizeof(size_t));
+    if (!buckets || !used || !tried) return false;
+
+    for (size_t b = 0; b < bucket_count; b++) {
+        buckets[b].bucket = b;
+        buckets[b].members = malloc(n * sizeof(size_t));
+        if (!buckets[b].members) return false;
+    }
+    for (size_t k = 0; k < n; k++) {
+        gen_bucket *bucket = &buckets[emoji_hash(keys[k], strlen(keys[k]), 0) % bucket_count];
+        bucket->members[bucket->count++] = k;
+    }
+    qsort(buckets, bucket_count, sizeof(gen_bucket), compare_bucket_size);
+
+    bool ok = true;
+    for (size_t b = 0; b < bucket_count && ok; b++) {
+        gen_bucket *bucket = &buckets[b];
+        seeds[bucket->bucket] = 0;
+        if (bucket->count == 0) continue;
+
+        bool placed = false;
+        for (uint32_t seed = 1; seed <= UINT16_MAX && !placed; seed++) {
+            size_t m = 0;
+            for (; m < bucket->count; m++) {
+                const char *key = keys[bucket->members[m]];
+                size_t slot = emoji_hash(key, strlen(key), seed) % n;
+                bool clash = used[slot];
+                for (size_t j = 0; j < m && !clash; j++) clash = tried[j] == slot;
+                if (clash) break;
+                tried[m] = slot;
+            }
+            if (m < bucket->count) continue;
+            for (m = 0; m < bucket->count; m++) {
+                used[tried[m]] = true;
+                slots[tried[m]] = values[bucket->members[m]];
+            }
+            seeds[bucket->bucket] = (uint16_t)seed;
+            placed = true;
+        }
+        ok = placed;
+    }
+
+    for (size_t b = 0; b < bucket_count; b++) free(buckets[b].members);
+    free(buckets);
+    free(used);
+    free(tried);
+    return ok;
+}
+
+static void write_string(FILE *out, const char *s) {
+    if (!s) {
+        fputs("NULL", out);
+        return;
+    }
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static void write_u16_array(FILE *out, const char *decl, const uint16_t *values, size_t count) {
+    fprintf(out, "%s = {", decl);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(out, "%s%u,", i % 12 == 0 ? "\n    " : " ", (unsigned)values[i]);
+    }
+    fputs("\n};\n", out);
+}
+
+static void write_slot_array(FILE *out, const char *decl, const size_t *values, size_t count) {
+    uint16_t *narrow = malloc(count * sizeof(uint16_t));
+    if (!narrow) exit(1);
+    for (size_t i = 0; i < count; i++) narrow[i] = (uint16_t)values[i];
+    write_u16_array(out, decl, narrow, count);
+    free(narrow);
+}
+
+/* Build one perfect hash and write its seeds and slots as PREFIX_BUCKETS, prefix_seeds, prefix_slots */
+static bool write_hash(FILE *out, const char *macro, const char *prefix, const char **keys,
+                       const size_t *values, size_t n) {
+    size_t bucket_count = n / 2 ? n / 2 : 1;
+    uint16_t *seeds = calloc(bucket_count, sizeof(uint16_t));
+    size_t *slots = calloc(n, sizeof(size_t));
+    if (!seeds || !slots || !build_perfect_hash(keys, values, n, bucket_count, seeds, slots)) {
+        free(seeds);
+        free(slots);
+        return false;
+    }
+
+    char decl[128];
+    fprintf(out, "#define %s_BUCKETS %zu\n#define %s_SLOTS %zu\n\n", macro, bucket_count, macro, n);
+    snprintf(decl, sizeof(decl), "static const uint16_t %s_seeds[%s_BUCKETS]", prefix, macro);
+    write_u16_array(out, decl, seeds, bucket_count);
+    fputs("\n", out);
+    snprintf(decl, sizeof(decl), "static const uint16_t %s_slots[%s_SLOTS]", prefix, macro);
+    write_slot_array(out, decl, slots, n);
+
+    free(seeds);
+    free(slots);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s github-emoji.txt emoji_data.h\n", argv[0]);
+        return 1;
+    }
+
+    FILE *in = fopen(argv[1], "r");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    size_t count = 0, capacity = 1024;
+    gen_entry *entries = malloc(capacity * sizeof(gen_entry));
+    if (!entries) return 1;
+    char line[4096];
+    while (fgets(line, sizeof(line), in)) {
+        if (count >= capacity) {
+            capacity *= 2;
+            gen_entry *grown = realloc(entries, capacity * sizeof(gen_entry));
+            if (!grown) return 1;
+            entries = grown;
+        }
+        if (parse_row(line, &entries[count])) count++;
+    }
+    fclose(in);
+    if (count == 0 || count > UINT16_MAX) {
+        fprintf(stderr, "gen_emoji_data: %zu entries in %s\n", count, argv[1]);
+        return 1;
+    }
+    qsort(entries, count, sizeof(gen_entry), compare_entry);
+    for (size_t i = 1; i < count; i++) {
+        if (strcmp(entries[i - 1].name, entries[i].name) == 0) {
+            fprintf(stderr, "gen_emoji_data: duplicate name %s\n", entries[i].name);
+            return 1;
+        }
+    }
+
+    /* Name hash: every entry */
+    const char **name_keys = malloc(count * sizeof(char *));
+    size_t *name_values = malloc(count * sizeof(size_t));
+    /* Unicode hash: each distinct sequence, to the entry with the longest name */
+    const char **unicode_keys = malloc(count * sizeof(char *));
+    size_t *unicode_values = malloc(count * sizeof(size_t));
+    size_t unicode_count = 0, image_count = 0;
+    if (!name_keys || !name_values || !unicode_keys || !unicode_values) return 1;
+    for (size_t i = 0; i < count; i++) {
+        name_keys[i] = entries[i].name;
+        name_values[i] = i;
+        if (!entries[i].unicode) {
+            image_count++;
+            continue;
+        }
+        size_t u = 0;
+        while (u < unicode_count && strcmp(unicode_keys[u], entries[i].unicode) != 0) u++;
+        if (u == unicode_count) {
+            unicode_keys[unicode_count] = entries[i].unicode;
+            unicode_values[unicode_count++] = i;
+        } else if (strlen(entries[i].name) > strlen(entries[unicode_values[u]].name)) {
+            unicode_values[u] = i;
+        }
+    }
+
+    FILE *out = fopen(argv[2], "w");
+    if (!out) {
+        perror(argv[2]);
+        return 1;
+    }
+    fprintf(out,
+            "/**\n"
+            " * Complete GitHub Emoji Database\n"
+            " * Generated from github-emoji.txt by tools/gen_emoji_data.c - do not edit\n"
+            " * Total: %zu emoji mappings (%zu unicode, %zu image-based)\n"
+            " */\n\n"
+            "#ifndef APEX_EMOJI_DATA_H\n"
+            "#define APEX_EMOJI_DATA_H\n\n"
+            "#include <stdint.h>\n\n"
+            "typedef struct {\n"
+            "    const char *name;\n"
+            "    const char *unicode;  /* NULL if image-based */\n"
+            "    const char *image_url; /* NULL if unicode-based */\n"
+            "} emoji_entry;\n\n"
+            "/* Complete emoji map - alphabetically sorted */\n"
+            "static const emoji_entry complete_emoji_map[] = {\n",
+            count, count - image_count, image_count);
+
+    char group = 0;
+    for (size_t i = 0; i < count; i++) {
+        char first = (char)toupper((unsigned char)entries[i].name[0]);
+        if (i == 0 || first != group) {
+            fprintf(out, "%s    /* %c */\n", i ? "\n" : "", first);
+            group = first;
+        }
+        fputs("    {", out);
+        write_string(out, entries[i].name);
+        fputs(", ", out);
+        write_string(out, entries[i].unicode);
+        fputs(", ", out);
+        write_string(out, entries[i].image_url);
+        fputs("},\n", out);
+    }
+    fputs("\n    {NULL, NULL, NULL}  /* Terminator */\n};\n\n", out);
+
+    fputs("/* Name lookup: perfect hash (emoji_hash.h) to the complete_emoji_map index */\n", out);
+    bool ok = write_hash(out, "EMOJI_NAME", "emoji_name", name_keys, name_values, count);
+    fputs("\n/* Reverse lookup: unicode sequence to the index of its longest name */\n", out);
+    ok = ok && write_hash(out, "EMOJI_UNICODE", "emoji_unicode", unicode_keys, unicode_values, unicode_count);
+    fputs("\n#endif /* APEX_EMOJI_DATA_H */\n", out);
+    if (fclose(out) != 0 || !ok) {
+        fprintf(stderr, "gen_emoji_data: could not write %s\n", argv[2]);
+        remove(argv[2]);
+        return 1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        free(entries[i].name);
+        free(entries[i].unicode);
+        free(entries[i].image_url);
+    }
+    free(entries);
+    free(name_keys);
+    free(name_values);
+    free(unicode_keys);
+    free(unicode_values);
+    return 0;
+}